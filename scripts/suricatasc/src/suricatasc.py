@@ -200,6 +200,22 @@ class SuricataSC:
                         else:
                             arguments = {}
                             arguments["variable"] = variable
+                    elif "profiling-sample-set" in command:
+                        try:
+                            [cmd, mode, value] = command.split(' ', 2)
+                        except:
+                            print "Error: arguments to command '%s' is missing" % (command)
+                            continue
+                        if cmd != "profiling-sample-set" or mode not in ("count", "time"):
+                            print "Error: invalid command '%s'" % (command)
+                            continue
+                        else:
+                            arguments = {}
+                            arguments["mode"] = mode
+                            if mode == "count":
+                                arguments["rate"] = int(value)
+                            else:
+                                arguments["interval"] = int(value)
                     else:
                         cmd = command
                 else:
@@ -63,6 +63,9 @@
 
 #include "util-spm.h"
 #include "util-unittest.h"
+#include "util-misc.h"
+
+#include "conf.h"
 
 #include "app-layer-dcerpc.h"
 
@@ -153,6 +156,66 @@ void printUUID(char *type, DCERPCUuidEntry *uuid) {
             uuid->versionminor);
 }
 
+/** max bytes of stub data buffered per flow and direction */
+static uint32_t dcerpc_stub_data_limit = DCERPC_STUB_DATA_DEFAULT_LIMIT;
+
+/**
+ * \brief Set the max bytes of stub data buffered per flow and direction.
+ *
+ * \param limit limit in bytes, 0 for the default
+ */
+void DCERPCStubDataSetLimit(uint32_t limit) {
+    if (limit == 0)
+        limit = DCERPC_STUB_DATA_DEFAULT_LIMIT;
+    dcerpc_stub_data_limit = limit;
+}
+
+/**
+ * \brief Append a stub fragment to a stub data buffer.
+ *
+ * The buffer grows geometrically, so a stub spread over many fragments
+ * isn't reallocated and copied for each of them. Stub data past the
+ * limit is not buffered.
+ *
+ * \param buffer pointer to the stub data buffer
+ * \param len pointer to the length of the buffered stub data
+ * \param size pointer to the allocated size of the buffer
+ * \param data stub fragment
+ * \param data_len length of the stub fragment
+ *
+ * \retval bytes of the fragment that were buffered
+ */
+uint32_t DCERPCStubDataAppend(uint8_t **buffer, uint32_t *len, uint32_t *size,
+                              uint8_t *data, uint32_t data_len) {
+    uint32_t limit = dcerpc_stub_data_limit;
+
+    if (*len >= limit)
+        return 0;
+    if (data_len > limit - *len)
+        data_len = limit - *len;
+
+    if (*len + data_len > *size) {
+        uint32_t new_size = (*size < DCERPC_STUB_DATA_MIN_SIZE) ?
+                            DCERPC_STUB_DATA_MIN_SIZE : *size;
+        while (new_size < *len + data_len && new_size < limit / 2)
+            new_size *= 2;
+        if (new_size < *len + data_len)
+            new_size = limit;
+
+        uint8_t *ptr = SCRealloc(*buffer, new_size);
+        if (ptr == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+            return 0;
+        }
+        *buffer = ptr;
+        *size = new_size;
+    }
+
+    memcpy(*buffer + *len, data, data_len);
+    *len += data_len;
+    return data_len;
+}
+
 /**
  * \brief DCERPCParseSecondaryAddr reads secondaryaddrlen bytes from the BIND_ACK
  * DCERPC call.
@@ -1182,6 +1245,7 @@ static uint32_t StubDataParser(DCERPC *dcerpc, uint8_t *input, uint32_t input_le
     SCEnter();
     uint8_t **stub_data_buffer = NULL;
     uint32_t *stub_data_buffer_len = NULL;
+    uint32_t *stub_data_buffer_size = NULL;
     uint8_t *stub_data_fresh = NULL;
     uint16_t stub_len = 0;
 
@@ -1189,12 +1253,14 @@ static uint32_t StubDataParser(DCERPC *dcerpc, uint8_t *input, uint32_t input_le
     if (dcerpc->dcerpchdr.type == REQUEST) {
         stub_data_buffer = &dcerpc->dcerpcrequest.stub_data_buffer;
         stub_data_buffer_len = &dcerpc->dcerpcrequest.stub_data_buffer_len;
+        stub_data_buffer_size = &dcerpc->dcerpcrequest.stub_data_buffer_size;
         stub_data_fresh = &dcerpc->dcerpcrequest.stub_data_fresh;
 
     /* response PDU.  Retrieve the response stub buffer */
     } else {
         stub_data_buffer = &dcerpc->dcerpcresponse.stub_data_buffer;
         stub_data_buffer_len = &dcerpc->dcerpcresponse.stub_data_buffer_len;
+        stub_data_buffer_size = &dcerpc->dcerpcresponse.stub_data_buffer_size;
         stub_data_fresh = &dcerpc->dcerpcresponse.stub_data_fresh;
     }
 
@@ -1230,16 +1296,10 @@ static uint32_t StubDataParser(DCERPC *dcerpc, uint8_t *input, uint32_t input_le
         dcerpc->pdu_fragged = 1;
     }
 
-    *stub_data_buffer = SCRealloc(*stub_data_buffer, *stub_data_buffer_len + stub_len);
-    if (*stub_data_buffer == NULL) {
-        SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
-        goto end;
+    if (DCERPCStubDataAppend(stub_data_buffer, stub_data_buffer_len,
+                stub_data_buffer_size, input, stub_len) > 0) {
+        *stub_data_fresh = 1;
     }
-    memcpy(*stub_data_buffer + *stub_data_buffer_len, input, stub_len);
-
-    *stub_data_fresh = 1;
-    /* length of the buffered stub */
-    *stub_data_buffer_len += stub_len;
     /* To see the total reassembled stubdata */
     //hexdump(*stub_data_buffer, *stub_data_buffer_len);
 
@@ -1255,7 +1315,6 @@ static uint32_t StubDataParser(DCERPC *dcerpc, uint8_t *input, uint32_t input_le
     }
 #endif
 
-end:
     SCReturnUInt((uint32_t)stub_len);
 }
 
@@ -1965,11 +2024,13 @@ static void DCERPCStateFree(void *s) {
         SCFree(sstate->dcerpc.dcerpcrequest.stub_data_buffer);
         sstate->dcerpc.dcerpcrequest.stub_data_buffer = NULL;
         sstate->dcerpc.dcerpcrequest.stub_data_buffer_len = 0;
+        sstate->dcerpc.dcerpcrequest.stub_data_buffer_size = 0;
     }
     if (sstate->dcerpc.dcerpcresponse.stub_data_buffer != NULL) {
         SCFree(sstate->dcerpc.dcerpcresponse.stub_data_buffer);
         sstate->dcerpc.dcerpcresponse.stub_data_buffer = NULL;
         sstate->dcerpc.dcerpcresponse.stub_data_buffer_len = 0;
+        sstate->dcerpc.dcerpcresponse.stub_data_buffer_size = 0;
     }
 
     if (s) {
@@ -1978,9 +2039,31 @@ static void DCERPCStateFree(void *s) {
     }
 }
 
+/**
+ * \brief Get the stub data limit from the config. It's shared by the tcp
+ *        and udp dcerpc parsers and dcerpc over smb.
+ */
+static void DCERPCConfigure(void) {
+    char *str = NULL;
+    uint32_t limit = 0;
+
+    if (ConfGet("app-layer.protocols.dcerpc.stub-data-limit", &str) == 1) {
+        if (ParseSizeStringU32(str, &limit) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing stub-data-limit "
+                       "from conf file - %s.  Killing engine", str);
+            exit(EXIT_FAILURE);
+        }
+    }
+    DCERPCStubDataSetLimit(limit);
+
+    SCLogDebug("dcerpc stub data limit %"PRIu32, dcerpc_stub_data_limit);
+}
+
 void RegisterDCERPCParsers(void) {
     char *proto_name = "dcerpc";
 
+    DCERPCConfigure();
+
     if (AppLayerProtoDetectionEnabled(proto_name)) {
         AlpProtoAdd(&alp_proto_ctx, proto_name, IPPROTO_TCP, ALPROTO_DCERPC, "|05 00|", 2, 0, STREAM_TOSERVER);
         /* toclient direction */
@@ -6249,6 +6332,67 @@ end:
     return result;
 }
 
+/**
+ * \test Stub data buffer growth and limit.
+ */
+int DCERPCParserTest20(void)
+{
+    int result = 0;
+    uint8_t frag[100];
+    uint8_t *buffer = NULL;
+    uint32_t len = 0;
+    uint32_t size = 0;
+    uint32_t reallocs = 0;
+    uint32_t i;
+
+    memset(frag, 0x41, sizeof(frag));
+    DCERPCStubDataSetLimit(1000);
+
+    /* 9 frags, 900 bytes: 256 -> 512 -> 1000 (limit) */
+    for (i = 0; i < 9; i++) {
+        uint32_t old_size = size;
+        if (DCERPCStubDataAppend(&buffer, &len, &size, frag,
+                    sizeof(frag)) != sizeof(frag)) {
+            printf("frag %"PRIu32" not buffered: ", i);
+            goto end;
+        }
+        if (size != old_size)
+            reallocs++;
+    }
+    if (len != 900 || size != 1000 || reallocs != 3) {
+        printf("len %"PRIu32" size %"PRIu32" reallocs %"PRIu32", expected "
+               "900, 1000 and 3: ", len, size, reallocs);
+        goto end;
+    }
+
+    /* only 100 bytes left before the limit */
+    if (DCERPCStubDataAppend(&buffer, &len, &size, frag, 50) != 50 ||
+        DCERPCStubDataAppend(&buffer, &len, &size, frag, sizeof(frag)) != 50 ||
+        DCERPCStubDataAppend(&buffer, &len, &size, frag, sizeof(frag)) != 0) {
+        printf("limit not enforced: ");
+        goto end;
+    }
+    if (len != 1000 || size != 1000) {
+        printf("len %"PRIu32" size %"PRIu32", expected 1000: ", len, size);
+        goto end;
+    }
+
+    /* a new stub reuses the buffer */
+    len = 0;
+    if (DCERPCStubDataAppend(&buffer, &len, &size, frag, sizeof(frag)) !=
+            sizeof(frag) || size != 1000) {
+        printf("buffer not reused: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (buffer != NULL)
+        SCFree(buffer);
+    DCERPCStubDataSetLimit(0);
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 void DCERPCParserRegisterTests(void) {
@@ -6272,6 +6416,7 @@ void DCERPCParserRegisterTests(void) {
     UtRegisterTest("DCERPCParserTest17", DCERPCParserTest17, 1);
     UtRegisterTest("DCERPCParserTest18", DCERPCParserTest18, 1);
     UtRegisterTest("DCERPCParserTest19", DCERPCParserTest19, 1);
+    UtRegisterTest("DCERPCParserTest20", DCERPCParserTest20, 1);
 #endif /* UNITTESTS */
 
     return;
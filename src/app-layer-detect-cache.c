@@ -0,0 +1,622 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Cache of app layer detection results per server endpoint.
+ *
+ * The cache is a hash of rows, each with its own lock and a few entries
+ * that are evicted in LRU order. An entry keeps the last detection result
+ * for a server address, port and ip protocol and the number of flows in a
+ * row that had that result. Once detection gave up on enough flows to the
+ * same server, new flows to it skip detection until the entry times out.
+ * Once enough flows to a server were detected as the same protocol, new
+ * flows to it first check only that protocol's patterns and probing parser
+ * and fall back to full detection if that doesn't confirm it.
+ *
+ * Entries are only refreshed by a detection result, not by a lookup, so a
+ * server that changes the service it runs is picked up again after the
+ * timeout.
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "conf.h"
+
+#include "app-layer-protos.h"
+#include "app-layer-detect-cache.h"
+
+#include "flow.h"
+
+#include "util-byte.h"
+#include "util-debug.h"
+#include "util-hash-lookup3.h"
+#include "util-random.h"
+#include "util-unittest.h"
+
+#define ALP_CACHE_DEFAULT_ROWS          4096
+#define ALP_CACHE_DEFAULT_TIMEOUT       600
+#define ALP_CACHE_DEFAULT_MIN_FAILED    3
+#define ALP_CACHE_DEFAULT_MIN_DETECTED  10
+
+AlpCache *alp_cache = NULL;
+
+static AlpCache *AlpCacheAlloc(uint32_t rows, uint32_t timeout,
+        uint16_t min_failed, uint16_t min_detected)
+{
+    AlpCache *c = SCMalloc(sizeof(AlpCache));
+    if (unlikely(c == NULL))
+        return NULL;
+    memset(c, 0x00, sizeof(AlpCache));
+
+    c->row = SCMallocAligned(rows * sizeof(AlpCacheRow), CLS);
+    if (unlikely(c->row == NULL)) {
+        SCFree(c);
+        return NULL;
+    }
+    memset(c->row, 0x00, rows * sizeof(AlpCacheRow));
+
+    uint32_t i;
+    for (i = 0; i < rows; i++) {
+        SCSpinInit(&c->row[i].s, 0);
+    }
+
+    unsigned int seed = RandomTimePreseed();
+    c->hash_rand = (uint32_t)rand_r(&seed);
+    c->rows = rows;
+    c->timeout = timeout;
+    c->min_failed = min_failed;
+    c->min_detected = min_detected;
+    SC_ATOMIC_INIT(c->hits);
+    SC_ATOMIC_INIT(c->updates);
+    SC_ATOMIC_INIT(c->confirmed);
+    return c;
+}
+
+static void AlpCacheFree(AlpCache *c)
+{
+    uint32_t i;
+    for (i = 0; i < c->rows; i++) {
+        SCSpinDestroy(&c->row[i].s);
+    }
+    SCFreeAligned(c->row);
+    SC_ATOMIC_DESTROY(c->hits);
+    SC_ATOMIC_DESTROY(c->updates);
+    SC_ATOMIC_DESTROY(c->confirmed);
+    SCFree(c);
+}
+
+/**
+ *  \brief set up the cache from the app-layer.detection-cache config
+ */
+void AlpCacheInit(void)
+{
+    int enabled = 0;
+    if (ConfGetBool("app-layer.detection-cache.enabled", &enabled) != 1 ||
+            enabled == 0)
+        return;
+
+    uint32_t rows = ALP_CACHE_DEFAULT_ROWS;
+    uint32_t timeout = ALP_CACHE_DEFAULT_TIMEOUT;
+    uint32_t min_failed = ALP_CACHE_DEFAULT_MIN_FAILED;
+    uint32_t min_detected = ALP_CACHE_DEFAULT_MIN_DETECTED;
+    uint32_t configval = 0;
+    char *conf_val;
+
+    if ((ConfGet("app-layer.detection-cache.rows", &conf_val)) == 1)
+    {
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                                    conf_val) > 0 && configval > 0) {
+            rows = configval;
+        }
+    }
+    if ((ConfGet("app-layer.detection-cache.timeout", &conf_val)) == 1)
+    {
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                                    conf_val) > 0 && configval > 0) {
+            timeout = configval;
+        }
+    }
+    if ((ConfGet("app-layer.detection-cache.min-failed", &conf_val)) == 1)
+    {
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                                    conf_val) > 0 && configval > 0 &&
+                configval <= UINT16_MAX) {
+            min_failed = configval;
+        }
+    }
+    if ((ConfGet("app-layer.detection-cache.min-detected", &conf_val)) == 1)
+    {
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                                    conf_val) > 0 && configval > 0 &&
+                configval <= UINT16_MAX) {
+            min_detected = configval;
+        }
+    }
+
+    alp_cache = AlpCacheAlloc(rows, timeout, (uint16_t)min_failed,
+            (uint16_t)min_detected);
+    if (alp_cache == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "allocating the app layer detection "
+                "cache failed, continuing without it");
+        return;
+    }
+
+    SCLogInfo("app layer detection cache: %"PRIu32" rows (%"PRIuMAX" bytes), "
+            "timeout %"PRIu32"s, min-failed %"PRIu32", min-detected %"PRIu32,
+            rows, (uintmax_t)(rows * sizeof(AlpCacheRow)), timeout,
+            min_failed, min_detected);
+}
+
+void AlpCacheDestroy(void)
+{
+    if (alp_cache == NULL)
+        return;
+
+    SCLogInfo("app layer detection cache: %"PRIu64" hits, %"PRIu64" updates, "
+            "%"PRIu64" confirmed", SC_ATOMIC_GET(alp_cache->hits),
+            SC_ATOMIC_GET(alp_cache->updates),
+            SC_ATOMIC_GET(alp_cache->confirmed));
+
+    AlpCacheFree(alp_cache);
+    alp_cache = NULL;
+}
+
+/** \internal
+ *  \brief get the row of the server endpoint of a flow. The server is the
+ *         destination of the first packet of the flow.
+ */
+static inline AlpCacheRow *AlpCacheGetRow(AlpCache *c, Flow *f, uint8_t ipproto)
+{
+    uint32_t key[5];
+    key[0] = f->dst.addr_data32[0];
+    key[1] = f->dst.addr_data32[1];
+    key[2] = f->dst.addr_data32[2];
+    key[3] = f->dst.addr_data32[3];
+    key[4] = ((uint32_t)f->dp << 8) | ipproto;
+
+    uint32_t hash = hashword(key, 5, c->hash_rand);
+    return &c->row[hash % c->rows];
+}
+
+static inline int AlpCacheEntryMatch(AlpCacheEntry *e, Flow *f, uint8_t ipproto)
+{
+    return (e->alproto != ALPROTO_UNKNOWN &&
+            e->port == f->dp && e->ipproto == ipproto &&
+            e->addr[0] == f->dst.addr_data32[0] &&
+            e->addr[1] == f->dst.addr_data32[1] &&
+            e->addr[2] == f->dst.addr_data32[2] &&
+            e->addr[3] == f->dst.addr_data32[3]);
+}
+
+/**
+ *  \brief look up the server endpoint of a flow
+ *
+ *  \param c cache
+ *  \param f flow
+ *  \param ipproto ip protocol
+ *  \param ts current time in seconds
+ *  \param r entry copy, only set on a hit
+ *
+ *  \retval 1 hit
+ *  \retval 0 no entry or timed out
+ */
+int AlpCacheLookup(AlpCache *c, Flow *f, uint8_t ipproto, uint32_t ts,
+        AlpCacheEntry *r)
+{
+    AlpCacheRow *row = AlpCacheGetRow(c, f, ipproto);
+    int hit = 0;
+
+    SCSpinLock(&row->s);
+    int i;
+    for (i = 0; i < ALP_CACHE_WAYS; i++) {
+        AlpCacheEntry *e = &row->e[i];
+        if (AlpCacheEntryMatch(e, f, ipproto)) {
+            if (ts <= e->ts + c->timeout) {
+                *r = *e;
+                hit = 1;
+            }
+            break;
+        }
+    }
+    SCSpinUnlock(&row->s);
+    return hit;
+}
+
+/**
+ *  \brief store the detection result of a flow for its server endpoint
+ *
+ *  If the entry already has this result its count is increased, otherwise
+ *  the result replaces it. New entries take an unused or timed out entry
+ *  of the row, or else the least recently updated one.
+ *
+ *  \param c cache
+ *  \param f flow
+ *  \param ipproto ip protocol
+ *  \param alproto detected protocol or ALPROTO_FAILED
+ *  \param ts current time in seconds
+ */
+void AlpCacheUpdate(AlpCache *c, Flow *f, uint8_t ipproto, uint16_t alproto,
+        uint32_t ts)
+{
+    AlpCacheRow *row = AlpCacheGetRow(c, f, ipproto);
+    AlpCacheEntry *e = NULL;
+
+    SCSpinLock(&row->s);
+    int i;
+    for (i = 0; i < ALP_CACHE_WAYS; i++) {
+        if (AlpCacheEntryMatch(&row->e[i], f, ipproto)) {
+            e = &row->e[i];
+            break;
+        }
+    }
+
+    if (e != NULL && ts <= e->ts + c->timeout && e->alproto == alproto) {
+        if (e->cnt < UINT16_MAX)
+            e->cnt++;
+    } else {
+        if (e == NULL) {
+            e = &row->e[0];
+            for (i = 0; i < ALP_CACHE_WAYS; i++) {
+                if (row->e[i].alproto == ALPROTO_UNKNOWN) {
+                    e = &row->e[i];
+                    break;
+                }
+                if (row->e[i].ts < e->ts)
+                    e = &row->e[i];
+            }
+            e->addr[0] = f->dst.addr_data32[0];
+            e->addr[1] = f->dst.addr_data32[1];
+            e->addr[2] = f->dst.addr_data32[2];
+            e->addr[3] = f->dst.addr_data32[3];
+            e->port = f->dp;
+            e->ipproto = ipproto;
+        }
+        e->alproto = alproto;
+        e->cnt = 1;
+    }
+    e->ts = ts;
+    SCSpinUnlock(&row->s);
+
+    (void) SC_ATOMIC_ADD(c->updates, 1);
+}
+
+/**
+ *  \brief check if detection gave up on enough recent flows to the server
+ *         of this flow to skip it. Only the first call for a flow does a
+ *         lookup. If the server has a confident alproto instead the flow
+ *         is flagged for AlpCacheGetProto.
+ *
+ *  \param f locked flow
+ *  \param ipproto ip protocol
+ *
+ *  \retval 1 skip detection
+ *  \retval 0 run detection
+ */
+int AlpCacheSkipDetection(Flow *f, uint8_t ipproto)
+{
+    AlpCache *c = alp_cache;
+    if (c == NULL || (f->alp_cache_flags & ALP_CACHE_CHECKED))
+        return 0;
+    f->alp_cache_flags |= ALP_CACHE_CHECKED;
+
+    AlpCacheEntry e;
+    if (AlpCacheLookup(c, f, ipproto, (uint32_t)f->lastts_sec, &e) == 0)
+        return 0;
+
+    if (e.alproto == ALPROTO_FAILED && e.cnt >= c->min_failed) {
+        SCLogDebug("flow %p: detection gave up on %"PRIu16" flows to this "
+                "server, skipping it", f, e.cnt);
+        /* don't let this flow count as another give up */
+        f->alp_cache_flags |= ALP_CACHE_UPDATED;
+        (void) SC_ATOMIC_ADD(c->hits, 1);
+        return 1;
+    }
+    if (e.alproto != ALPROTO_FAILED && e.cnt >= c->min_detected)
+        f->alp_cache_flags |= ALP_CACHE_CANDIDATE;
+    return 0;
+}
+
+/**
+ *  \brief get the alproto the server of this flow was detected as by
+ *         enough recent flows. Until a result is stored for the flow, the
+ *         entry is looked up again for every call so that a short first
+ *         chunk can be confirmed later.
+ *
+ *  \param f locked flow
+ *  \param ipproto ip protocol
+ *
+ *  \retval alproto to confirm, ALPROTO_UNKNOWN if there is none
+ */
+uint16_t AlpCacheGetProto(Flow *f, uint8_t ipproto)
+{
+    AlpCache *c = alp_cache;
+    if (c == NULL || !(f->alp_cache_flags & ALP_CACHE_CANDIDATE) ||
+            (f->alp_cache_flags & ALP_CACHE_UPDATED))
+        return ALPROTO_UNKNOWN;
+
+    AlpCacheEntry e;
+    if (AlpCacheLookup(c, f, ipproto, (uint32_t)f->lastts_sec, &e) == 1 &&
+            e.alproto != ALPROTO_FAILED && e.cnt >= c->min_detected)
+        return e.alproto;
+
+    f->alp_cache_flags &= ~ALP_CACHE_CANDIDATE;
+    return ALPROTO_UNKNOWN;
+}
+
+/**
+ *  \brief store the final detection result of a flow, once per flow
+ *
+ *  \param f locked flow
+ *  \param ipproto ip protocol
+ *  \param alproto detected protocol or ALPROTO_FAILED
+ */
+void AlpCacheFlowResult(Flow *f, uint8_t ipproto, uint16_t alproto)
+{
+    AlpCache *c = alp_cache;
+    if (c == NULL || (f->alp_cache_flags & ALP_CACHE_UPDATED))
+        return;
+    f->alp_cache_flags |= ALP_CACHE_UPDATED;
+
+    AlpCacheUpdate(c, f, ipproto, alproto, (uint32_t)f->lastts_sec);
+}
+
+#ifdef UNITTESTS
+
+static void AlpCacheTestFlow(Flow *f, uint32_t addr, uint16_t port)
+{
+    memset(f, 0x00, sizeof(*f));
+    f->dst.addr_data32[0] = addr;
+    f->dp = port;
+}
+
+/**
+ *  \test detection is only skipped after min_failed give ups and an entry
+ *        times out
+ */
+static int AlpCacheTest01(void)
+{
+    int result = 0;
+    AlpCacheEntry e;
+    Flow f;
+
+    AlpCache *c = AlpCacheAlloc(16, 10, 2, 2);
+    if (c == NULL)
+        return 0;
+
+    AlpCacheTestFlow(&f, 0x01020304, 8080);
+    if (AlpCacheLookup(c, &f, IPPROTO_TCP, 100, &e) != 0) {
+        printf("hit on empty cache: ");
+        goto end;
+    }
+
+    AlpCacheUpdate(c, &f, IPPROTO_TCP, ALPROTO_FAILED, 100);
+    AlpCacheUpdate(c, &f, IPPROTO_TCP, ALPROTO_FAILED, 101);
+    if (AlpCacheLookup(c, &f, IPPROTO_TCP, 105, &e) != 1 ||
+            e.alproto != ALPROTO_FAILED || e.cnt != 2) {
+        printf("expected failed entry with cnt 2: ");
+        goto end;
+    }
+
+    /* other port, other ipproto */
+    f.dp = 8081;
+    if (AlpCacheLookup(c, &f, IPPROTO_TCP, 105, &e) != 0) {
+        printf("hit for other port: ");
+        goto end;
+    }
+    f.dp = 8080;
+    if (AlpCacheLookup(c, &f, IPPROTO_UDP, 105, &e) != 0) {
+        printf("hit for other ipproto: ");
+        goto end;
+    }
+
+    /* a detection resets the count */
+    AlpCacheUpdate(c, &f, IPPROTO_TCP, ALPROTO_HTTP, 106);
+    if (AlpCacheLookup(c, &f, IPPROTO_TCP, 106, &e) != 1 ||
+            e.alproto != ALPROTO_HTTP || e.cnt != 1) {
+        printf("expected http entry with cnt 1: ");
+        goto end;
+    }
+
+    /* timeout */
+    if (AlpCacheLookup(c, &f, IPPROTO_TCP, 117, &e) != 0) {
+        printf("hit on timed out entry: ");
+        goto end;
+    }
+    AlpCacheUpdate(c, &f, IPPROTO_TCP, ALPROTO_HTTP, 117);
+    if (AlpCacheLookup(c, &f, IPPROTO_TCP, 117, &e) != 1 || e.cnt != 1) {
+        printf("timed out entry should restart at cnt 1: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    AlpCacheFree(c);
+    return result;
+}
+
+/**
+ *  \test a full row evicts the least recently updated entry
+ */
+static int AlpCacheTest02(void)
+{
+    int result = 0;
+    AlpCacheEntry e;
+    Flow f;
+
+    /* single row so all servers collide */
+    AlpCache *c = AlpCacheAlloc(1, 1000, 1, 1);
+    if (c == NULL)
+        return 0;
+
+    uint16_t port;
+    for (port = 1; port <= ALP_CACHE_WAYS; port++) {
+        AlpCacheTestFlow(&f, 0x0a000001, port);
+        AlpCacheUpdate(c, &f, IPPROTO_TCP, ALPROTO_FAILED, 100 + port);
+    }
+    /* refresh port 1 so port 2 is the oldest */
+    AlpCacheTestFlow(&f, 0x0a000001, 1);
+    AlpCacheUpdate(c, &f, IPPROTO_TCP, ALPROTO_FAILED, 200);
+
+    AlpCacheTestFlow(&f, 0x0a000001, 100);
+    AlpCacheUpdate(c, &f, IPPROTO_TCP, ALPROTO_FAILED, 201);
+
+    AlpCacheTestFlow(&f, 0x0a000001, 2);
+    if (AlpCacheLookup(c, &f, IPPROTO_TCP, 201, &e) != 0) {
+        printf("oldest entry not evicted: ");
+        goto end;
+    }
+    for (port = 1; port <= ALP_CACHE_WAYS; port++) {
+        if (port == 2)
+            continue;
+        AlpCacheTestFlow(&f, 0x0a000001, port);
+        if (AlpCacheLookup(c, &f, IPPROTO_TCP, 201, &e) != 1) {
+            printf("entry for port %u evicted: ", port);
+            goto end;
+        }
+    }
+    AlpCacheTestFlow(&f, 0x0a000001, 100);
+    if (AlpCacheLookup(c, &f, IPPROTO_TCP, 201, &e) != 1) {
+        printf("new entry missing: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    AlpCacheFree(c);
+    return result;
+}
+
+/**
+ *  \test flow level wrappers look up and update once per flow
+ */
+static int AlpCacheTest03(void)
+{
+    int result = 0;
+    Flow f;
+
+    AlpCache *saved = alp_cache;
+    alp_cache = AlpCacheAlloc(16, 100, 2, 2);
+    if (alp_cache == NULL)
+        goto end;
+
+    int i;
+    for (i = 0; i < 2; i++) {
+        AlpCacheTestFlow(&f, 0x0a000002, 5555);
+        f.lastts_sec = 1000 + i;
+        if (AlpCacheSkipDetection(&f, IPPROTO_TCP) != 0) {
+            printf("flow %d skipped detection: ", i);
+            goto end;
+        }
+        AlpCacheFlowResult(&f, IPPROTO_TCP, ALPROTO_FAILED);
+        /* second result of the same flow is ignored */
+        AlpCacheFlowResult(&f, IPPROTO_TCP, ALPROTO_FAILED);
+    }
+
+    AlpCacheTestFlow(&f, 0x0a000002, 5555);
+    f.lastts_sec = 1002;
+    if (AlpCacheSkipDetection(&f, IPPROTO_TCP) != 1) {
+        printf("third flow should skip detection: ");
+        goto end;
+    }
+    if (SC_ATOMIC_GET(alp_cache->hits) != 1 ||
+            SC_ATOMIC_GET(alp_cache->updates) != 2) {
+        printf("hits %"PRIu64" updates %"PRIu64": ",
+                SC_ATOMIC_GET(alp_cache->hits),
+                SC_ATOMIC_GET(alp_cache->updates));
+        goto end;
+    }
+    /* only the first call looks */
+    if (AlpCacheSkipDetection(&f, IPPROTO_TCP) != 0) {
+        printf("second check of the flow should not skip: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (alp_cache != NULL)
+        AlpCacheFree(alp_cache);
+    alp_cache = saved;
+    return result;
+}
+
+/**
+ *  \test a server with a confident alproto flags new flows as candidates
+ */
+static int AlpCacheTest04(void)
+{
+    int result = 0;
+    Flow f;
+
+    AlpCache *saved = alp_cache;
+    alp_cache = AlpCacheAlloc(16, 100, 2, 2);
+    if (alp_cache == NULL)
+        goto end;
+
+    AlpCacheTestFlow(&f, 0x0a000003, 8000);
+    f.lastts_sec = 1000;
+    AlpCacheFlowResult(&f, IPPROTO_TCP, ALPROTO_HTTP);
+
+    /* one detection is not enough */
+    AlpCacheTestFlow(&f, 0x0a000003, 8000);
+    f.lastts_sec = 1001;
+    if (AlpCacheSkipDetection(&f, IPPROTO_TCP) != 0 ||
+            AlpCacheGetProto(&f, IPPROTO_TCP) != ALPROTO_UNKNOWN) {
+        printf("candidate after a single detection: ");
+        goto end;
+    }
+    AlpCacheFlowResult(&f, IPPROTO_TCP, ALPROTO_HTTP);
+
+    AlpCacheTestFlow(&f, 0x0a000003, 8000);
+    f.lastts_sec = 1002;
+    if (AlpCacheSkipDetection(&f, IPPROTO_TCP) != 0) {
+        printf("detected server should not skip detection: ");
+        goto end;
+    }
+    if (AlpCacheGetProto(&f, IPPROTO_TCP) != ALPROTO_HTTP ||
+            AlpCacheGetProto(&f, IPPROTO_TCP) != ALPROTO_HTTP) {
+        printf("expected http candidate: ");
+        goto end;
+    }
+
+    /* once the flow has its result it's no longer a candidate */
+    AlpCacheFlowResult(&f, IPPROTO_TCP, ALPROTO_HTTP);
+    if (AlpCacheGetProto(&f, IPPROTO_TCP) != ALPROTO_UNKNOWN) {
+        printf("candidate after the flow result: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (alp_cache != NULL)
+        AlpCacheFree(alp_cache);
+    alp_cache = saved;
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void AlpCacheRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("AlpCacheTest01", AlpCacheTest01, 1);
+    UtRegisterTest("AlpCacheTest02", AlpCacheTest02, 1);
+    UtRegisterTest("AlpCacheTest03", AlpCacheTest03, 1);
+    UtRegisterTest("AlpCacheTest04", AlpCacheTest04, 1);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,81 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Cache of app layer detection results per server endpoint.
+ */
+
+#ifndef __APP_LAYER_DETECT_CACHE_H__
+#define __APP_LAYER_DETECT_CACHE_H__
+
+#include "flow.h"
+
+/** entries per cache row, a row is evicted in LRU order */
+#define ALP_CACHE_WAYS      4
+
+/** Flow::alp_cache_flags */
+#define ALP_CACHE_CHECKED   0x01    /**< cache was consulted for the flow */
+#define ALP_CACHE_UPDATED   0x02    /**< flow result was stored in the cache */
+#define ALP_CACHE_CANDIDATE 0x04    /**< server has a confident alproto */
+
+/** detection result of a server endpoint */
+typedef struct AlpCacheEntry_ {
+    uint32_t addr[4];
+    uint16_t port;
+    uint8_t ipproto;
+    uint8_t pad0;
+    uint16_t alproto;       /**< ALPROTO_FAILED if detection gave up,
+                                 ALPROTO_UNKNOWN if the entry is unused */
+    uint16_t cnt;           /**< flows in a row that had this result */
+    uint32_t ts;            /**< last update */
+} AlpCacheEntry;
+
+typedef struct AlpCacheRow_ {
+    SCSpinlock s;
+    AlpCacheEntry e[ALP_CACHE_WAYS];
+} __attribute__((aligned(CLS))) AlpCacheRow;
+
+typedef struct AlpCache_ {
+    uint32_t rows;
+    uint32_t timeout;       /**< seconds an entry is valid after its update */
+    uint16_t min_failed;    /**< give ups before detection is skipped */
+    uint16_t min_detected;  /**< detections before the alproto is assumed */
+    uint32_t hash_rand;
+    AlpCacheRow *row;
+
+    SC_ATOMIC_DECLARE(uint64_t, hits);
+    SC_ATOMIC_DECLARE(uint64_t, updates);
+    SC_ATOMIC_DECLARE(uint64_t, confirmed);
+} AlpCache;
+
+/** the cache, NULL if disabled */
+extern AlpCache *alp_cache;
+
+void AlpCacheInit(void);
+void AlpCacheDestroy(void);
+
+int AlpCacheLookup(AlpCache *, Flow *, uint8_t, uint32_t, AlpCacheEntry *);
+void AlpCacheUpdate(AlpCache *, Flow *, uint8_t, uint16_t, uint32_t);
+int AlpCacheSkipDetection(Flow *, uint8_t);
+uint16_t AlpCacheGetProto(Flow *, uint8_t);
+void AlpCacheFlowResult(Flow *, uint8_t, uint16_t);
+
+void AlpCacheRegisterTests(void);
+
+#endif /* __APP_LAYER_DETECT_CACHE_H__ */
@@ -57,6 +57,7 @@
 #include "app-layer-protos.h"
 #include "app-layer-parser.h"
 #include "app-layer-detect-proto.h"
+#include "app-layer-detect-cache.h"
 
 #include "util-spm.h"
 #include "util-cuda.h"
@@ -94,7 +95,7 @@ void AlpProtoInit(AlpProtoDetectCtx *ctx) {
  *  \param proto the proto id
  *  \initonly
  */
-static void AlpProtoAddSignature(AlpProtoDetectCtx *ctx, DetectContentData *co, uint16_t ip_proto, uint16_t proto) {
+static void AlpProtoAddSignature(AlpProtoDetectCtx *ctx, DetectContentData *co, uint16_t ip_proto, uint16_t proto, uint8_t flags) {
     AlpProtoSignature *s = SCMalloc(sizeof(AlpProtoSignature));
     if (unlikely(s == NULL)) {
         SCLogError(SC_ERR_FATAL, "Error allocating memory. Signature not loaded. Not enough memory so.. exiting..");
@@ -104,6 +105,7 @@ static void AlpProtoAddSignature(AlpProtoDetectCtx *ctx, DetectContentData *co,
 
     s->ip_proto = ip_proto;
     s->proto = proto;
+    s->flags = flags & (STREAM_TOSERVER | STREAM_TOCLIENT);
     s->co = co;
 
     if (ctx->head == NULL) {
@@ -226,6 +228,8 @@ void AlpProtoAdd(AlpProtoDetectCtx *ctx, char *name, uint16_t ip_proto, uint16_t
 
     if (depth > dir->max_len)
         dir->max_len = depth;
+    if (cd->content_len > dir->max_pat_len)
+        dir->max_pat_len = cd->content_len;
 
     /* set the min_len for the stream engine to set the min smsg size for app
        layer*/
@@ -233,7 +237,8 @@ void AlpProtoAdd(AlpProtoDetectCtx *ctx, char *name, uint16_t ip_proto, uint16_t
         dir->min_len = depth;
 
     /* finally turn into a signature and add to the ctx */
-    AlpProtoAddSignature(ctx, cd, ip_proto, al_proto);
+    AlpProtoAddSignature(ctx, cd, ip_proto, al_proto,
+            (flags & STREAM_TOCLIENT) ? STREAM_TOCLIENT : STREAM_TOSERVER);
 }
 
 #ifdef UNITTESTS
@@ -256,6 +261,7 @@ void AlpProtoDestroy() {
     AlpProtoFreeSignature(alp_proto_ctx.head);
     AppLayerFreeProbingParsers(alp_proto_ctx.probing_parsers);
     alp_proto_ctx.probing_parsers = NULL;
+    AlpCacheDestroy();
 
     SCReturn;
 }
@@ -340,10 +346,88 @@ void AppLayerDetectProtoThreadInit(void) {
     AlpProtoInit(&alp_proto_ctx);
     RegisterAppLayerParsers();
     AlpProtoFinalizeGlobal(&alp_proto_ctx);
+    AlpCacheInit();
 
     return;
 }
 
+/** \internal
+ *  \brief results of the probing parsers for one chunk, so that the probing
+ *         parser of a proto runs once per chunk when it both confirms a
+ *         pattern hit and probes the port.
+ *
+ *  Like the probing parser masks of the flow this uses a bit per alproto.
+ */
+typedef struct AlpProbeCache_ {
+    uint32_t done;
+    uint16_t result[ALPROTO_MAX];
+} AlpProbeCache;
+
+/** \internal
+ *  \brief run a probing parser, through the cache if it is the probing
+ *         parser the proto is mapped to
+ */
+static uint16_t AlpProbe(AlpProbeCache *pc, ProbingParserFPtr ProbingParser,
+        uint16_t alproto, uint8_t dir, uint8_t *buf, uint32_t buflen)
+{
+    if (pc == NULL || ProbingParser != al_proto_table[alproto].PPAlprotoMap[dir])
+        return ProbingParser(buf, buflen, NULL);
+
+    if (!(pc->done & (1 << alproto))) {
+        pc->result[alproto] = ProbingParser(buf, buflen, NULL);
+        pc->done |= (1 << alproto);
+    }
+    return pc->result[alproto];
+}
+
+/** \internal
+ *  \brief search the patterns of a direction and verify the hits
+ *
+ *  \param start offset in buf to start the search at, hits are verified
+ *               against all of buf
+ *  \param searchlen offset in buf to end the search at
+ *  \param pm_results if not NULL the protos are added to it in match order
+ *  \param pm_matches number of protos in pm_results
+ *
+ *  \retval mask bit per alproto that matched
+ */
+static uint32_t AlpProtoPMSearch(AlpProtoDetectCtx *ctx,
+        AlpProtoDetectDirection *dir, AlpProtoDetectDirectionThread *tdir,
+        uint8_t *buf, uint16_t buflen, uint16_t start, uint16_t searchlen,
+        uint8_t ipproto, uint16_t *pm_results, uint16_t *pm_matches)
+{
+    uint32_t mask = 0;
+
+    /* do the mpm search */
+    uint32_t search_cnt = mpm_table[dir->mpm_ctx.mpm_type].Search(&dir->mpm_ctx,
+            &tdir->mpm_ctx, &tdir->pmq, buf + start, searchlen - start);
+    SCLogDebug("search cnt %" PRIu32 "", search_cnt);
+
+    uint32_t s_cnt;
+    for (s_cnt = 0; search_cnt > 0 && s_cnt < tdir->pmq.pattern_id_array_cnt; s_cnt++) {
+        AlpProtoSignature *s = ctx->map[tdir->pmq.pattern_id_array[s_cnt]];
+        SCLogDebug("array count is %"PRIu32" patid %"PRIu16"",
+                   tdir->pmq.pattern_id_array_cnt,
+                   tdir->pmq.pattern_id_array[s_cnt]);
+        while (s != NULL) {
+            uint16_t proto = AlpProtoMatchSignature(s, buf, buflen, ipproto);
+            if (proto != ALPROTO_UNKNOWN && !(mask & (1 << proto))) {
+                if (pm_results != NULL)
+                    pm_results[(*pm_matches)++] = proto;
+                mask |= (1 << proto);
+            }
+            s = s->map_next;
+        }
+    }
+
+    PmqReset(&tdir->pmq);
+
+    if (mpm_table[dir->mpm_ctx.mpm_type].Cleanup != NULL) {
+        mpm_table[dir->mpm_ctx.mpm_type].Cleanup(&tdir->mpm_ctx);
+    }
+    return mask;
+}
+
 /**
  *  \brief Get the app layer proto based on a buffer using a Patter matcher
  *         parser.
@@ -383,50 +467,14 @@ uint16_t AppLayerDetectGetProtoPMParser(AlpProtoDetectCtx *ctx,
         max_len = ctx->toclient.max_len;
     }
 
-    if (dir->id == 0) {
-        goto end;
-    }
-
-    /* see if we can limit the data we inspect */
-    uint16_t searchlen = buflen;
-    if (searchlen > dir->max_len)
-        searchlen = dir->max_len;
-
-    uint32_t search_cnt = 0;
-
-    /* do the mpm search */
-    search_cnt = mpm_table[dir->mpm_ctx.mpm_type].Search(&dir->mpm_ctx,
-                                                         &tdir->mpm_ctx,
-                                                         &tdir->pmq, buf,
-                                                         searchlen);
-    SCLogDebug("search cnt %" PRIu32 "", search_cnt);
-    if (search_cnt == 0)
-        goto end;
-
-    /* alproto bit field */
-    uint8_t pm_results_bf[ALPROTO_MAX / 8];
-    memset(pm_results_bf, 0, sizeof(pm_results_bf));
-
-    for (uint8_t s_cnt = 0; s_cnt < search_cnt; s_cnt++) {
-        AlpProtoSignature *s = ctx->map[tdir->pmq.pattern_id_array[s_cnt]];
-        SCLogDebug("array count is %"PRIu32" patid %"PRIu16"",
-                   tdir->pmq.pattern_id_array_cnt,
-                   tdir->pmq.pattern_id_array[s_cnt]);
-        while (s != NULL) {
-            uint16_t proto = AlpProtoMatchSignature(s, buf, buflen, ipproto);
-            if (proto != ALPROTO_UNKNOWN && !(pm_results_bf[proto / 8] & (1 << (proto % 8))) ) {
-                pm_results[pm_matches++] = proto;
-                pm_results_bf[proto / 8] |= 1 << (proto % 8);
-            }
-            s = s->map_next;
-        }
-    }
-
-end:
-    PmqReset(&tdir->pmq);
+    if (dir->id != 0) {
+        /* see if we can limit the data we inspect */
+        uint16_t searchlen = buflen;
+        if (searchlen > dir->max_len)
+            searchlen = dir->max_len;
 
-    if (mpm_table[dir->mpm_ctx.mpm_type].Cleanup != NULL) {
-        mpm_table[dir->mpm_ctx.mpm_type].Cleanup(&tdir->mpm_ctx);
+        (void)AlpProtoPMSearch(ctx, dir, tdir, buf, buflen, 0, searchlen,
+                ipproto, pm_results, &pm_matches);
     }
 #if 0
     printf("AppLayerDetectGetProto: returning %" PRIu16 " (%s): ", proto, flags & STREAM_TOCLIENT ? "TOCLIENT" : "TOSERVER");
@@ -488,13 +536,16 @@ end:
     SCReturnUInt(pm_matches);
 }
 
-/**
- * \brief Call the probing parser if it exists for this src or dst port.
+/** \internal
+ *  \brief Call the probing parsers for the port
+ *
+ *  \param pc probing parser results of this chunk or NULL
  */
-uint16_t AppLayerDetectGetProtoProbingParser(AlpProtoDetectCtx *ctx, Flow *f,
-                                             uint8_t *buf, uint32_t buflen,
-                                             uint8_t flags, uint8_t ipproto)
+static uint16_t AlpProtoProbingParser(AlpProtoDetectCtx *ctx, Flow *f,
+        uint8_t *buf, uint32_t buflen, uint8_t flags, uint8_t ipproto,
+        AlpProbeCache *pc)
 {
+    uint8_t dir = (flags & STREAM_TOSERVER) ? 0 : 1;
     AppLayerProbingParserPort *pp_port = NULL;
     AppLayerProbingParserElement *pe = NULL;
     uint32_t *al_proto_masks;
@@ -529,7 +580,8 @@ uint16_t AppLayerDetectGetProtoProbingParser(AlpProtoDetectCtx *ctx, Flow *f,
             continue;
         }
 
-        int alproto = pe->ProbingParser(buf, buflen, NULL);
+        int alproto = AlpProbe(pc, pe->ProbingParser, pe->al_proto, dir,
+                buf, buflen);
         if (alproto != ALPROTO_UNKNOWN && alproto != ALPROTO_FAILED)
             return alproto;
         if (alproto == ALPROTO_FAILED ||
@@ -554,9 +606,94 @@ uint16_t AppLayerDetectGetProtoProbingParser(AlpProtoDetectCtx *ctx, Flow *f,
     return ALPROTO_UNKNOWN;
 }
 
+/**
+ * \brief Call the probing parser if it exists for this src or dst port.
+ */
+uint16_t AppLayerDetectGetProtoProbingParser(AlpProtoDetectCtx *ctx, Flow *f,
+                                             uint8_t *buf, uint32_t buflen,
+                                             uint8_t flags, uint8_t ipproto)
+{
+    return AlpProtoProbingParser(ctx, f, buf, buflen, flags, ipproto, NULL);
+}
+
+/**
+ *  \brief Confirm the app layer proto a flow is expected to have by
+ *         checking only the patterns and probing parser of that proto.
+ *
+ *  \param ctx     Global app layer detection context.
+ *  \param f       Pointer to the flow.
+ *  \param buf     Pointer to the buffer to inspect.
+ *  \param buflen  Lenght of the buffer.
+ *  \param flags   Flags.
+ *  \param ipproto IP proto.
+ *  \param alproto App layer proto to confirm.
+ *
+ *  \retval alproto if confirmed, ALPROTO_UNKNOWN otherwise
+ */
+uint16_t AppLayerDetectConfirmProto(AlpProtoDetectCtx *ctx, Flow *f,
+                                    uint8_t *buf, uint32_t buflen,
+                                    uint8_t flags, uint8_t ipproto,
+                                    uint16_t alproto)
+{
+    uint8_t dir = (flags & STREAM_TOSERVER) ? 0 : 1;
+    uint16_t searchlen = (buflen > UINT16_MAX) ? UINT16_MAX : (uint16_t)buflen;
+
+    AlpProtoSignature *s = ctx->head;
+    for ( ; s != NULL; s = s->next) {
+        if (s->proto != alproto || !(s->flags & flags))
+            continue;
+
+        if (AlpProtoMatchSignature(s, buf, searchlen, ipproto) != alproto)
+            continue;
+
+        if (al_proto_table[alproto].PPAlprotoMap[dir] != NULL &&
+            al_proto_table[alproto].PPAlprotoMap[dir](buf, buflen, NULL) != alproto)
+            continue;
+
+        return alproto;
+    }
+
+    /* protos that are only detected by their probing parser */
+    AppLayerProbingParserPort *pp_port = AppLayerGetProbingParsers(ctx->probing_parsers,
+            ipproto, (flags & STREAM_TOSERVER) ? f->dp : f->sp);
+    if (pp_port == NULL)
+        return ALPROTO_UNKNOWN;
+
+    AppLayerProbingParserElement *pe = (flags & STREAM_TOSERVER) ?
+        pp_port->toserver : pp_port->toclient;
+    for ( ; pe != NULL; pe = pe->next) {
+        if (pe->al_proto != alproto || buflen < pe->min_depth)
+            continue;
+
+        if (pe->ProbingParser(buf, buflen, NULL) == alproto)
+            return alproto;
+    }
+
+    return ALPROTO_UNKNOWN;
+}
+
 /**
  *  \brief Get the app layer proto.
  *
+ *  If the server of the flow was detected as the same proto by enough
+ *  recent flows, only that proto is checked first.
+ *
+ *  Otherwise the patterns and the probing parsers are evaluated in a single
+ *  pass over the chunk:
+ *  - the patterns are only searched in the bytes an earlier chunk of the
+ *    stream didn't cover yet. TCP chunks always start at the start of the
+ *    stream, other protos get a new buffer per chunk and are searched
+ *    fully.
+ *  - pattern hits that their probing parser didn't confirm yet are kept in
+ *    the flow and checked again on the next chunk, until the pattern
+ *    search is done for the direction.
+ *  - the probing parsers of the port run in the same pass. A probing
+ *    parser that both confirms a pattern hit and probes the port runs
+ *    once.
+ *
+ *  Pattern hits take precedence over the probing parsers, the lowest
+ *  matching proto wins.
+ *
  *  \param ctx    Global app layer detection context.
  *  \param tctx   Thread app layer detection context.
  *  \param f      Pointer to the flow.
@@ -571,23 +708,66 @@ uint16_t AppLayerDetectGetProto(AlpProtoDetectCtx *ctx,
                                 uint8_t *buf, uint32_t buflen,
                                 uint8_t flags, uint8_t ipproto)
 {
+    uint16_t cached = AlpCacheGetProto(f, ipproto);
+    if (cached != ALPROTO_UNKNOWN &&
+        AppLayerDetectConfirmProto(ctx, f, buf, buflen, flags, ipproto, cached) == cached) {
+        (void) SC_ATOMIC_ADD(alp_cache->confirmed, 1);
+        return cached;
+    }
+
+    uint8_t dir = (flags & STREAM_TOSERVER) ? 0 : 1;
+    AlpProtoDetectDirection *pm_dir = dir ? &ctx->toclient : &ctx->toserver;
+    AlpProtoDetectDirectionThread *tdir = dir ? &tctx->toclient : &tctx->toserver;
+    AlpProbeCache pc;
+    uint32_t pending = 0;
+    uint16_t alproto;
+
+    pc.done = 0;
+
     if (!FLOW_IS_PM_DONE(f, flags)) {
-        uint16_t pm_results[ALPROTO_MAX];
-        uint16_t pm_matches = AppLayerDetectGetProtoPMParser(ctx, tctx, f, buf, buflen, flags, ipproto, pm_results);
-        uint8_t dir = (flags & STREAM_TOSERVER) ? 0 : 1;
-        for (uint16_t i = 0; i < pm_matches; i++) {
-            if (al_proto_table[pm_results[i]].PPAlprotoMap[dir] != NULL) {
-                if (pm_results[i] != al_proto_table[pm_results[i]].PPAlprotoMap[dir](buf, buflen, NULL)) {
-                    /* \todo set event - Needs some deliberation */
-                    continue;
-                }
+        uint16_t searched = 0;
+        if (ipproto == IPPROTO_TCP) {
+            searched = f->alproto_pm_searched[dir];
+            pending = f->alproto_pm_pending[dir];
+        }
+
+        uint16_t searchlen = (buflen > pm_dir->max_len) ? pm_dir->max_len : (uint16_t)buflen;
+        if (pm_dir->id != 0 && searchlen > searched) {
+            /* overlap with the searched part for the patterns that
+             * continue into the new bytes */
+            uint16_t start = 0;
+            if (searched >= pm_dir->max_pat_len)
+                start = searched - (pm_dir->max_pat_len - 1);
+
+            pending |= AlpProtoPMSearch(ctx, pm_dir, tdir, buf,
+                    (buflen > UINT16_MAX) ? UINT16_MAX : (uint16_t)buflen,
+                    start, searchlen, ipproto, NULL, NULL);
+        }
+
+        for (alproto = 1; pending != 0 && alproto < ALPROTO_MAX; alproto++) {
+            if (!(pending & (1 << alproto)))
+                continue;
+
+            ProbingParserFPtr ProbingParser = al_proto_table[alproto].PPAlprotoMap[dir];
+            if (ProbingParser == NULL ||
+                AlpProbe(&pc, ProbingParser, alproto, dir, buf, buflen) == alproto) {
+                return alproto;
             }
+            /* \todo set event - Needs some deliberation */
+        }
 
-            return pm_results[i];
+        if (buflen >= pm_dir->max_len) {
+            FLOW_SET_PM_DONE(f, flags);
+            pending = 0;
+        }
+        if (ipproto == IPPROTO_TCP) {
+            f->alproto_pm_searched[dir] = (searchlen > searched) ? searchlen : searched;
+            f->alproto_pm_pending[dir] = pending;
         }
     }
+
     if (!FLOW_IS_PP_DONE(f, flags))
-        return AppLayerDetectGetProtoProbingParser(ctx, f, buf, buflen, flags, ipproto);
+        return AlpProtoProbingParser(ctx, f, buf, buflen, flags, ipproto, &pc);
     return ALPROTO_UNKNOWN;
 }
 
@@ -1193,6 +1373,124 @@ int AlpDetectTest14(void) {
     return r;
 }
 
+/**
+ * \test confirming an expected proto only accepts its own patterns in
+ *       the right direction
+ */
+int AlpDetectTest15(void) {
+    uint8_t l7data[] = "GET / HTTP/1.1\r\n";
+    uint8_t l7data_ftp[] = "USER anonymous\r\n";
+    int r = 1;
+    AlpProtoDetectCtx ctx;
+    Flow f;
+
+    memset(&f, 0x00, sizeof(f));
+    AlpProtoInit(&ctx);
+
+    AlpProtoAdd(&ctx, "http", IPPROTO_TCP, ALPROTO_HTTP, "GET", 3, 0, STREAM_TOSERVER);
+    AlpProtoAdd(&ctx, "http", IPPROTO_TCP, ALPROTO_HTTP, "HTTP", 4, 0, STREAM_TOCLIENT);
+    AlpProtoAdd(&ctx, "ftp", IPPROTO_TCP, ALPROTO_FTP, "USER ", 5, 0, STREAM_TOSERVER);
+
+    AlpProtoFinalizeGlobal(&ctx);
+
+    if (AppLayerDetectConfirmProto(&ctx, &f, l7data, sizeof(l7data) - 1,
+                STREAM_TOSERVER, IPPROTO_TCP, ALPROTO_HTTP) != ALPROTO_HTTP) {
+        printf("http not confirmed: ");
+        r = 0;
+    }
+    if (AppLayerDetectConfirmProto(&ctx, &f, l7data_ftp, sizeof(l7data_ftp) - 1,
+                STREAM_TOSERVER, IPPROTO_TCP, ALPROTO_HTTP) != ALPROTO_UNKNOWN) {
+        printf("ftp data confirmed as http: ");
+        r = 0;
+    }
+    if (AppLayerDetectConfirmProto(&ctx, &f, l7data, sizeof(l7data) - 1,
+                STREAM_TOCLIENT, IPPROTO_TCP, ALPROTO_HTTP) != ALPROTO_UNKNOWN) {
+        printf("toserver pattern confirmed toclient: ");
+        r = 0;
+    }
+    if (AppLayerDetectConfirmProto(&ctx, &f, l7data, sizeof(l7data) - 1,
+                STREAM_TOSERVER, IPPROTO_UDP, ALPROTO_HTTP) != ALPROTO_UNKNOWN) {
+        printf("tcp pattern confirmed for udp: ");
+        r = 0;
+    }
+
+    AlpProtoTestDestroy(&ctx);
+    return r;
+}
+
+static int alp_detect_test16_probes = 0;
+
+static uint16_t AlpDetectTest16ProbingParser(uint8_t *input, uint32_t ilen,
+        uint32_t *offset)
+{
+    alp_detect_test16_probes++;
+    return (ilen >= 10) ? ALPROTO_TEST : ALPROTO_UNKNOWN;
+}
+
+/**
+ * \test single pass detection: a probing parser that confirms a pattern
+ *       and probes the port runs once per chunk, a hit that isn't
+ *       confirmed yet is kept for the next chunk of the stream and the
+ *       next chunk only searches the new bytes.
+ */
+int AlpDetectTest16(void) {
+    uint8_t l7data[] = "xxTESTyyzzzz";
+    int r = 0;
+    AlpProtoDetectCtx ctx;
+    AlpProtoDetectThreadCtx tctx;
+    Flow f;
+    ProbingParserFPtr saved = al_proto_table[ALPROTO_TEST].PPAlprotoMap[0];
+
+    memset(&f, 0x00, sizeof(f));
+    f.dp = 1234;
+    AlpProtoInit(&ctx);
+
+    AlpProtoAdd(&ctx, "test", IPPROTO_TCP, ALPROTO_TEST, "TEST", 16, 0, STREAM_TOSERVER);
+    AppLayerRegisterProbingParser(&ctx, IPPROTO_TCP, "1234", "test", ALPROTO_TEST,
+            1, 0, STREAM_TOSERVER, AlpDetectTest16ProbingParser);
+    AppLayerMapProbingParserAgainstAlproto(ALPROTO_TEST, STREAM_TOSERVER,
+            AlpDetectTest16ProbingParser);
+
+    AlpProtoFinalizeGlobal(&ctx);
+    AlpProtoFinalizeThread(&ctx, &tctx);
+
+    alp_detect_test16_probes = 0;
+    if (AppLayerDetectGetProto(&ctx, &tctx, &f, l7data, 8, STREAM_TOSERVER,
+                IPPROTO_TCP) != ALPROTO_UNKNOWN) {
+        printf("detected on the first chunk: ");
+        goto end;
+    }
+    if (alp_detect_test16_probes != 1) {
+        printf("probing parser ran %d times, expected 1: ", alp_detect_test16_probes);
+        goto end;
+    }
+    if (!(f.alproto_pm_pending[0] & (1 << ALPROTO_TEST)) ||
+        f.alproto_pm_searched[0] != 8 || FLOW_IS_PM_DONE(&f, STREAM_TOSERVER)) {
+        printf("pattern hit not kept: ");
+        goto end;
+    }
+
+    /* the pattern isn't in the new bytes, the kept hit is confirmed */
+    if (AppLayerDetectGetProto(&ctx, &tctx, &f, l7data, sizeof(l7data) - 1,
+                STREAM_TOSERVER, IPPROTO_TCP) != ALPROTO_TEST) {
+        printf("not detected on the second chunk: ");
+        goto end;
+    }
+    if (alp_detect_test16_probes != 2) {
+        printf("probing parser ran %d times, expected 2: ", alp_detect_test16_probes);
+        goto end;
+    }
+
+    r = 1;
+end:
+    al_proto_table[ALPROTO_TEST].PPAlprotoMap[0] = saved;
+    mpm_table[ctx.toserver.mpm_ctx.mpm_type].DestroyThreadCtx(&ctx.toserver.mpm_ctx,
+            &tctx.toserver.mpm_ctx);
+    PmqFree(&tctx.toserver.pmq);
+    AlpProtoTestDestroy(&ctx);
+    return r;
+}
+
 /** \test test if the engine detect the proto and match with it */
 static int AlpDetectTestSig1(void)
 {
@@ -1673,6 +1971,8 @@ void AlpDetectRegisterTests(void) {
     UtRegisterTest("AlpDetectTest12", AlpDetectTest12, 1);
     UtRegisterTest("AlpDetectTest13", AlpDetectTest13, 1);
     UtRegisterTest("AlpDetectTest14", AlpDetectTest14, 1);
+    UtRegisterTest("AlpDetectTest15", AlpDetectTest15, 1);
+    UtRegisterTest("AlpDetectTest16", AlpDetectTest16, 1);
     UtRegisterTest("AlpDetectTestSig1", AlpDetectTestSig1, 1);
     UtRegisterTest("AlpDetectTestSig2", AlpDetectTestSig2, 1);
     UtRegisterTest("AlpDetectTestSig3", AlpDetectTestSig3, 1);
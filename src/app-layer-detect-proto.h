@@ -34,6 +34,7 @@
 typedef struct AlpProtoSignature_ {
     uint16_t ip_proto;                     /**< protocol (TCP/UDP) */
     uint16_t proto;                     /**< protocol */
+    uint8_t flags;                      /**< STREAM_TOSERVER or STREAM_TOCLIENT */
     DetectContentData *co;              /**< content match that needs to match */
     struct AlpProtoSignature_ *next;    /**< next signature */
     struct AlpProtoSignature_ *map_next;    /**< next signature with same id */
@@ -48,6 +49,7 @@ typedef struct AlpProtoDetectDirection_ {
                                          protocol */
     uint16_t max_len;              /**< max length of all patterns, so we can
                                          limit the search */
+    uint16_t max_pat_len;          /**< max content length of the patterns */
     uint16_t min_len;              /**< min length of all patterns, so we can
                                          tell the stream engine to feed data
                                          to app layer as soon as it has min
@@ -95,6 +97,8 @@ uint16_t AppLayerDetectGetProtoPMParser(AlpProtoDetectCtx *ctx,
 uint16_t AppLayerDetectGetProtoProbingParser(AlpProtoDetectCtx *, Flow *,
                                              uint8_t *, uint32_t,
                                              uint8_t, uint8_t);
+uint16_t AppLayerDetectConfirmProto(AlpProtoDetectCtx *, Flow *, uint8_t *,
+                                    uint32_t, uint8_t, uint8_t, uint16_t);
 uint16_t AppLayerDetectGetProto(AlpProtoDetectCtx *, AlpProtoDetectThreadCtx *,
                                 Flow *, uint8_t *, uint32_t,
                                 uint8_t, uint8_t);
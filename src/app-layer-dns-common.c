@@ -24,6 +24,7 @@
 #include "suricata-common.h"
 #include "app-layer-parser.h"
 #include "app-layer-dns-common.h"
+#include "app-layer-slab.h"
 #ifdef DEBUG
 #include "util-print.h"
 #endif
@@ -128,7 +129,7 @@ void DNSSetEvent(DNSState *s, uint8_t e) {
  *  \brief Allocate a DNS TX
  *  \retval tx or NULL */
 DNSTransaction *DNSTransactionAlloc(const uint16_t tx_id) {
-    DNSTransaction *tx = SCMalloc(sizeof(DNSTransaction));
+    DNSTransaction *tx = AppLayerSlabAlloc(sizeof(DNSTransaction));
     if (tx == NULL)
         return NULL;
     memset(tx, 0x00, sizeof(DNSTransaction));
@@ -148,21 +149,21 @@ static void DNSTransactionFree(DNSTransaction *tx) {
     DNSQueryEntry *q = NULL;
     while ((q = TAILQ_FIRST(&tx->query_list))) {
         TAILQ_REMOVE(&tx->query_list, q, next);
-        SCFree(q);
+        AppLayerSlabFree(q, sizeof(DNSQueryEntry) + q->len);
     }
 
     DNSAnswerEntry *a = NULL;
     while ((a = TAILQ_FIRST(&tx->answer_list))) {
         TAILQ_REMOVE(&tx->answer_list, a, next);
-        SCFree(a);
+        AppLayerSlabFree(a, sizeof(DNSAnswerEntry) + a->fqdn_len + a->data_len);
     }
     while ((a = TAILQ_FIRST(&tx->authority_list))) {
         TAILQ_REMOVE(&tx->authority_list, a, next);
-        SCFree(a);
+        AppLayerSlabFree(a, sizeof(DNSAnswerEntry) + a->fqdn_len + a->data_len);
     }
 
     AppLayerDecoderEventsFreeEvents(tx->decoder_events);
-    SCFree(tx);
+    AppLayerSlabFree(tx, sizeof(DNSTransaction));
 }
 
 /**
@@ -225,7 +226,7 @@ DNSTransaction *DNSTransactionFindByTxId(const DNSState *dns_state, const uint16
 }
 
 void *DNSStateAlloc(void) {
-    void *s = SCMalloc(sizeof(DNSState));
+    void *s = AppLayerSlabAlloc(sizeof(DNSState));
     if (unlikely(s == NULL))
         return NULL;
 
@@ -250,7 +251,7 @@ void DNSStateFree(void *s) {
         if (dns_state->buffer != NULL)
             SCFree(dns_state->buffer);
 
-        SCFree(s);
+        AppLayerSlabFree(s, sizeof(DNSState));
         s = NULL;
     }
 }
@@ -328,7 +329,7 @@ void DNSStoreQueryInState(DNSState *dns_state, const uint8_t *fqdn, const uint16
         SCLogDebug("new tx %u with internal id %u", tx->tx_id, tx->tx_num);
     }
 
-    DNSQueryEntry *q = SCMalloc(sizeof(DNSQueryEntry) + fqdn_len);
+    DNSQueryEntry *q = AppLayerSlabAlloc(sizeof(DNSQueryEntry) + fqdn_len);
     if (q == NULL)
         return;
     q->type = type;
@@ -356,7 +357,7 @@ void DNSStoreAnswerInState(DNSState *dns_state, const int rtype, const uint8_t *
 
     }
 
-    DNSAnswerEntry *q = SCMalloc(sizeof(DNSAnswerEntry) + fqdn_len + data_len);
+    DNSAnswerEntry *q = AppLayerSlabAlloc(sizeof(DNSAnswerEntry) + fqdn_len + data_len);
     if (q == NULL)
         return;
     q->type = type;
@@ -79,7 +79,7 @@ int HTPFileOpen(HtpState *s, uint8_t *filename, uint16_t filename_len,
         uint8_t *data, uint32_t data_len, uint16_t txid, uint8_t direction)
 {
     int retval = 0;
-    uint8_t flags = 0;
+    uint16_t flags = 0;
     FileContainer *files = NULL;
     FileContainer *files_opposite = NULL;
 
@@ -116,6 +116,16 @@ int HTPFileOpen(HtpState *s, uint8_t *filename, uint16_t filename_len,
             flags |= FILE_NOMD5;
         }
 
+        if (s->f->flags & FLOW_FILE_NO_SHA1_TC) {
+            SCLogDebug("no sha1 for this flow in toclient direction, so none for this file");
+            flags |= FILE_NOSHA1;
+        }
+
+        if (s->f->flags & FLOW_FILE_NO_SHA256_TC) {
+            SCLogDebug("no sha256 for this flow in toclient direction, so none for this file");
+            flags |= FILE_NOSHA256;
+        }
+
         if (!(flags & FILE_STORE) && (s->f->flags & FLOW_FILE_NO_STORE_TC)) {
             flags |= FILE_NOSTORE;
         }
@@ -145,6 +155,16 @@ int HTPFileOpen(HtpState *s, uint8_t *filename, uint16_t filename_len,
             flags |= FILE_NOMD5;
         }
 
+        if (s->f->flags & FLOW_FILE_NO_SHA1_TS) {
+            SCLogDebug("no sha1 for this flow in toserver direction, so none for this file");
+            flags |= FILE_NOSHA1;
+        }
+
+        if (s->f->flags & FLOW_FILE_NO_SHA256_TS) {
+            SCLogDebug("no sha256 for this flow in toserver direction, so none for this file");
+            flags |= FILE_NOSHA256;
+        }
+
         if (!(flags & FILE_STORE) && (s->f->flags & FLOW_FILE_NO_STORE_TS)) {
             flags |= FILE_NOSTORE;
         }
@@ -615,8 +635,17 @@ static int HTPFileParserTest03(void) {
         goto end;
     }
 
-    if (http_state->files_ts->head->chunks_head->len != 11) {
-        printf("filedata len not 11 but %u: ", http_state->files_ts->head->chunks_head->len);
+    /* the file data was in two body chunks, it is passed on as it comes in */
+    if (http_state->files_ts->head->size != 11) {
+        printf("filedata len not 11 but %"PRIu64": ", http_state->files_ts->head->size);
+        goto end;
+    }
+
+    FileData *fd = http_state->files_ts->head->chunks_head;
+    if (fd == NULL || fd->next == NULL ||
+            fd->len != 4 || memcmp(fd->data, "file", 4) != 0 ||
+            fd->next->len != 7 || memcmp(fd->next->data, "content", 7) != 0) {
+        printf("unexpected filedata chunks: ");
         goto end;
     }
 
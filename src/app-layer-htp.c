@@ -56,6 +56,7 @@
 #include "app-layer-htp-body.h"
 #include "app-layer-htp-file.h"
 #include "app-layer-htp-libhtp.h"
+#include "app-layer-slab.h"
 
 #include "util-spm.h"
 #include "util-debug.h"
@@ -235,7 +236,7 @@ static void *HTPStateAlloc(void)
 {
     SCEnter();
 
-    HtpState *s = SCMalloc(sizeof(HtpState));
+    HtpState *s = AppLayerSlabAlloc(sizeof(HtpState));
     if (unlikely(s == NULL))
         goto error;
 
@@ -252,13 +253,18 @@ static void *HTPStateAlloc(void)
     SCReturnPtr((void *)s, "void");
 
 error:
-    if (s != NULL) {
-        SCFree(s);
-    }
-
     SCReturnPtr(NULL, "void");
 }
 
+static void HtpMultipartFree(HtpMultipartState *mp)
+{
+    if (mp != NULL) {
+        if (mp->hdr != NULL)
+            SCFree(mp->hdr);
+        SCFree(mp);
+    }
+}
+
 static void HtpTxUserDataFree(HtpTxUserData *htud) {
     if (htud) {
         HtpBodyFree(&htud->request_body);
@@ -268,9 +274,14 @@ static void HtpTxUserDataFree(HtpTxUserData *htud) {
             SCFree(htud->request_headers_raw);
         if (htud->response_headers_raw)
             SCFree(htud->response_headers_raw);
+        if (htud->request_hdrs.buffer)
+            SCFree(htud->request_hdrs.buffer);
+        if (htud->response_hdrs.buffer)
+            SCFree(htud->response_hdrs.buffer);
         if (htud->boundary)
             SCFree(htud->boundary);
-        SCFree(htud);
+        HtpMultipartFree(htud->multipart);
+        AppLayerSlabFree(htud, sizeof(HtpTxUserData));
     }
 }
 
@@ -313,7 +324,7 @@ void HTPStateFree(void *state)
 
     FileContainerFree(s->files_ts);
     FileContainerFree(s->files_tc);
-    SCFree(s);
+    AppLayerSlabFree(s, sizeof(HtpState));
 
 #ifdef DEBUG
     SCMutexLock(&htp_state_mem_lock);
@@ -1028,49 +1039,6 @@ static int HtpRequestBodySetupMultipart(htp_tx_data_t *d, HtpTxUserData *htud) {
     SCReturnInt(0);
 }
 
-/**
- *  \brief Setup boundary buffers
- */
-static int HtpRequestBodySetupBoundary(HtpTxUserData *htud,
-        uint8_t **expected_boundary, uint8_t *expected_boundary_len,
-        uint8_t **expected_boundary_end, uint8_t *expected_boundary_end_len)
-{
-    uint8_t *eb = NULL;
-    uint8_t *ebe = NULL;
-
-    uint8_t eb_len = htud->boundary_len + 2;
-    eb = (uint8_t *)SCMalloc(eb_len);
-    if (eb == NULL) {
-        goto error;
-    }
-    memset(eb, '-', eb_len);
-    memcpy(eb + 2, htud->boundary, htud->boundary_len);
-
-    uint8_t ebe_len = htud->boundary_len + 4;
-    ebe = (uint8_t *)SCMalloc(ebe_len);
-    if (ebe == NULL) {
-        goto error;
-    }
-    memset(ebe, '-', ebe_len);
-    memcpy(ebe + 2, htud->boundary, htud->boundary_len);
-
-    *expected_boundary = eb;
-    *expected_boundary_len = eb_len;
-    *expected_boundary_end = ebe;
-    *expected_boundary_end_len = ebe_len;
-
-    SCReturnInt(0);
-
-error:
-    if (eb != NULL) {
-        SCFree(eb);
-    }
-    if (ebe != NULL) {
-        SCFree(ebe);
-    }
-    SCReturnInt(-1);
-}
-
 #define C_D_HDR "content-disposition:"
 #define C_D_HDR_LEN 20
 #define C_T_HDR "content-type:"
@@ -1156,346 +1124,292 @@ static void HtpRequestBodyMultipartParseHeader(HtpState *hstate,
 }
 
 /**
- *  \brief Create a single buffer from the HtpBodyChunks in our list
+ *  \brief Set up the multipart parser of a tx
+ *
+ *  The delimiter is "\r\n--<boundary>". The body is treated as if it was
+ *  preceded by a CRLF, so that a boundary at the very start of the body
+ *  matches as well.
  *
- *  \param htud transaction user data
- *  \param chunks_buffers pointer to pass back the buffer to the caller
- *  \param chunks_buffer_len pointer to pass back the buffer length to the caller
+ *  \retval 0 ok
+ *  \retval -1 error
  */
-static void HtpRequestBodyReassemble(HtpTxUserData *htud,
-        uint8_t **chunks_buffer, uint32_t *chunks_buffer_len)
+static int HtpMultipartSetup(HtpTxUserData *htud)
 {
-    uint8_t *buf = NULL;
-    uint32_t buf_len = 0;
-    HtpBodyChunk *cur = htud->request_body.first;
-
-    for ( ; cur != NULL; cur = cur->next) {
-        SCLogDebug("chunk %p", cur);
-
-        /* skip body chunks entirely before what we parsed already */
-        if ((uint64_t )cur->stream_offset + cur->len <= htud->request_body.body_parsed) {
-            SCLogDebug("skipping chunk");
-            continue;
-        }
-
-        SCLogDebug("cur->stream_offset %"PRIu64", cur->len %"PRIu32", body_parsed %"PRIu64,
-            cur->stream_offset, cur->len, htud->request_body.body_parsed);
+    HtpMultipartState *mp = SCMalloc(sizeof(HtpMultipartState));
+    if (unlikely(mp == NULL))
+        return -1;
+    memset(mp, 0x00, sizeof(HtpMultipartState));
+
+    mp->delim_len = htud->boundary_len + 4;
+    mp->delim[0] = '\r';
+    mp->delim[1] = '\n';
+    mp->delim[2] = '-';
+    mp->delim[3] = '-';
+    memcpy(mp->delim + 4, htud->boundary, htud->boundary_len);
+
+    /* failure function to continue a partial match after a mismatch */
+    uint8_t k = 0;
+    uint8_t i;
+    mp->fail[0] = 0;
+    for (i = 1; i < mp->delim_len; i++) {
+        while (k > 0 && mp->delim[i] != mp->delim[k])
+            k = mp->fail[k - 1];
+        if (mp->delim[i] == mp->delim[k])
+            k++;
+        mp->fail[i] = k;
+    }
+
+    mp->state = HTP_MULTIPART_STATE_DATA;
+    mp->match = 2;
+    mp->virt = 2;
+
+    htud->multipart = mp;
+    return 0;
+}
 
-        if (cur->stream_offset < htud->request_body.body_parsed &&
-                cur->stream_offset + cur->len >= htud->request_body.body_parsed) {
-            SCLogDebug("use part");
+/**
+ *  \brief Hand part data to the file that is open
+ */
+static void HtpMultipartStoreData(HtpState *hstate, HtpTxUserData *htud,
+        uint8_t *data, uint32_t data_len)
+{
+    if (data_len == 0)
+        return;
 
-            uint32_t toff = htud->request_body.body_parsed - cur->stream_offset;
-            uint32_t tlen = (cur->stream_offset + cur->len) - htud->request_body.body_parsed;
+    htud->multipart->data_len += data_len;
 
-            buf_len += tlen;
-            if ((buf = SCRealloc(buf, buf_len)) == NULL) {
-                buf_len = 0;
-                break;
-            }
-            memcpy(buf + buf_len - tlen, cur->data + toff, tlen);
+    if ((htud->tsflags & HTP_FILENAME_SET) && !(htud->tsflags & HTP_DONTSTORE)) {
+#ifdef PRINT
+        printf("FILEDATA START: \n");
+        PrintRawDataFp(stdout, data, data_len);
+        printf("FILEDATA END: \n");
+#endif
+        if (HTPFileStoreChunk(hstate, data, data_len, STREAM_TOSERVER) == -2) {
+            /* we know for sure we're not storing the file */
+            htud->tsflags |= HTP_DONTSTORE;
+        }
+    }
+}
 
+/**
+ *  \brief Pass on the part data of a chunk that is known not to be part of
+ *         the delimiter
+ *
+ *  The data before 'end' is part data. That includes the bytes of a partial
+ *  delimiter match from the previous chunk(s) that are released again. Those
+ *  are a prefix of the delimiter, so they are taken from there.
+ *
+ *  \param data chunk
+ *  \param data_start offset in the chunk where the part data starts
+ *  \param end offset in the chunk where the part data ends, negative if it
+ *             ends before the chunk
+ *  \param carry delimiter bytes matched before data_start
+ */
+static void HtpMultipartFlushData(HtpState *hstate, HtpTxUserData *htud,
+        uint8_t *data, uint32_t data_start, int64_t end, uint32_t carry)
+{
+    HtpMultipartState *mp = htud->multipart;
+
+    int64_t rel = (int64_t)carry + (end - (int64_t)data_start);
+    if (rel > (int64_t)carry)
+        rel = carry;
+    if (rel > 0) {
+        if (rel > mp->virt) {
+            HtpMultipartStoreData(hstate, htud, mp->delim + mp->virt,
+                    (uint32_t)rel - mp->virt);
+            mp->virt = 0;
         } else {
-            SCLogDebug("use entire chunk");
-
-            buf_len += cur->len;
-            if ((buf = SCRealloc(buf, buf_len)) == NULL) {
-                buf_len = 0;
-                break;
-            }
-            memcpy(buf + buf_len - cur->len, cur->data, cur->len);
+            mp->virt -= (uint8_t)rel;
         }
     }
 
-    *chunks_buffer = buf;
-    *chunks_buffer_len = buf_len;
+    if (end > (int64_t)data_start) {
+        HtpMultipartStoreData(hstate, htud, data + data_start,
+                (uint32_t)(end - data_start));
+    }
 }
 
-int HtpRequestBodyHandleMultipart(HtpState *hstate, HtpTxUserData *htud,
-                                  void *tx, uint8_t *chunks_buffer, uint32_t chunks_buffer_len)
+/**
+ *  \brief Headers of a part are complete, open the file if it has a filename
+ */
+static void HtpMultipartPartStart(HtpState *hstate, HtpTxUserData *htud)
 {
-    int result = 0;
-    uint8_t *expected_boundary = NULL;
-    uint8_t *expected_boundary_end = NULL;
-    uint8_t expected_boundary_len = 0;
-    uint8_t expected_boundary_end_len = 0;
-    int tx_progress = 0;
-
-#ifdef PRINT
-    printf("CHUNK START: \n");
-    PrintRawDataFp(stdout, chunks_buffer, chunks_buffer_len);
-    printf("CHUNK END: \n");
-#endif
-
-    if (HtpRequestBodySetupBoundary(htud, &expected_boundary, &expected_boundary_len,
-                &expected_boundary_end, &expected_boundary_end_len) < 0) {
-        goto end;
+    HtpMultipartState *mp = htud->multipart;
+    uint8_t *filename = NULL;
+    uint16_t filename_len = 0;
+    uint8_t *filetype = NULL;
+    uint16_t filetype_len = 0;
+
+    /* strip the CRLF's that end the headers */
+    uint32_t header_len = mp->hdr_len;
+    while (header_len > 0 &&
+            (mp->hdr[header_len - 1] == '\r' || mp->hdr[header_len - 1] == '\n'))
+        header_len--;
+
+    if (header_len > 0) {
+        HtpRequestBodyMultipartParseHeader(hstate, mp->hdr, header_len,
+                &filename, &filename_len, &filetype, &filetype_len);
     }
 
-    /* search for the header start, header end and form end */
-    uint8_t *header_start = Bs2bmSearch(chunks_buffer, chunks_buffer_len,
-            expected_boundary, expected_boundary_len);
-    uint8_t *header_end = NULL;
-    if (header_start != NULL) {
-        header_end = Bs2bmSearch(header_start, chunks_buffer_len - (header_start - chunks_buffer),
-                (uint8_t *)"\r\n\r\n", 4);
+    if (filename != NULL) {
+        SCLogDebug("we have a filename");
+
+        int result = HTPFileOpen(hstate, filename, filename_len,
+                NULL, 0, hstate->transaction_cnt, STREAM_TOSERVER);
+        if (result != -1) {
+            htud->tsflags |= HTP_FILENAME_SET;
+            if (result == -2)
+                htud->tsflags |= HTP_DONTSTORE;
+            else
+                htud->tsflags &= ~HTP_DONTSTORE;
+        }
     }
-    uint8_t *form_end = Bs2bmSearch(chunks_buffer, chunks_buffer_len,
-            expected_boundary_end, expected_boundary_end_len);
 
-    SCLogDebug("header_start %p, header_end %p, form_end %p", header_start,
-            header_end, form_end);
+    mp->hdr_len = 0;
+    mp->data_len = 0;
+}
 
-    /* we currently only handle multipart for ts.  When we support it for tc,
-     * we will need to supply right direction */
-    tx_progress = AppLayerGetAlstateProgress(ALPROTO_HTTP, tx, 0);
-    /* if we're in the file storage process, deal with that now */
+/**
+ *  \brief Delimiter found: the current part is complete
+ */
+static void HtpMultipartPartEnd(HtpState *hstate, HtpTxUserData *htud)
+{
     if (htud->tsflags & HTP_FILENAME_SET) {
-        if (header_start != NULL || form_end != NULL || (tx_progress > HTP_REQUEST_BODY)) {
-            SCLogDebug("reached the end of the file");
-
-            uint8_t *filedata = chunks_buffer;
-            uint32_t filedata_len = 0;
-            uint8_t flags = 0;
-
-            if (header_start < form_end || (header_start != NULL && form_end == NULL)) {
-                filedata_len = header_start - filedata - 2; /* 0d 0a */
-            } else if (form_end != NULL && form_end < header_start) {
-                filedata_len = form_end - filedata;
-            } else if (form_end != NULL && form_end == header_start) {
-                filedata_len = form_end - filedata - 2; /* 0d 0a */
-            } else if (tx_progress > HTP_RESPONSE_BODY) {
-                filedata_len = chunks_buffer_len;
-                flags = FILE_TRUNCATED;
-            }
-
-            if (filedata_len > chunks_buffer_len) {
-                AppLayerDecoderEventsSetEvent(hstate->f,
-                        HTTP_DECODER_EVENT_MULTIPART_GENERIC_ERROR);
-                goto end;
-            }
-#ifdef PRINT
-            printf("FILEDATA (final chunk) START: \n");
-            PrintRawDataFp(stdout, filedata, filedata_len);
-            printf("FILEDATA (final chunk) END: \n");
-#endif
-            if (!(htud->tsflags & HTP_DONTSTORE)) {
-                if (HTPFileClose(hstate, filedata, filedata_len, flags,
-                            STREAM_TOSERVER) == -1)
-                {
-                    goto end;
-                }
-            }
-
-            htud->tsflags &=~ HTP_FILENAME_SET;
-
-            /* fall through */
-        } else {
-            SCLogDebug("not yet at the end of the file");
+        if (htud->multipart->data_len == 0) {
+            AppLayerDecoderEventsSetEvent(hstate->f,
+                    HTTP_DECODER_EVENT_MULTIPART_NO_FILEDATA);
+        }
+        if (!(htud->tsflags & HTP_DONTSTORE)) {
+            (void)HTPFileClose(hstate, NULL, 0, 0, STREAM_TOSERVER);
+        }
+        htud->tsflags &= ~HTP_FILENAME_SET;
+    }
+}
 
-            if (chunks_buffer_len > expected_boundary_end_len) {
-                uint8_t *filedata = chunks_buffer;
-                uint32_t filedata_len = chunks_buffer_len - expected_boundary_len;
+/**
+ *  \brief Parse a chunk of a multipart/form-data request body
+ *
+ *  The parser keeps its state in the tx between chunks, so each body byte
+ *  is looked at once. File data is passed to the file API straight from the
+ *  chunk, except for the few bytes of a partial delimiter match at the end
+ *  of a chunk, those are passed on once the next chunk shows they are data.
+ *
+ *  \param hstate http state
+ *  \param htud tx user data, with the boundary set up
+ *  \param data body chunk
+ *  \param data_len length of the chunk
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int HtpRequestBodyHandleMultipart(HtpState *hstate, HtpTxUserData *htud,
+        uint8_t *data, uint32_t data_len)
+{
 #ifdef PRINT
-                printf("FILEDATA (part) START: \n");
-                PrintRawDataFp(stdout, filedata, filedata_len);
-                printf("FILEDATA (part) END: \n");
+    printf("CHUNK START: \n");
+    PrintRawDataFp(stdout, data, data_len);
+    printf("CHUNK END: \n");
 #endif
 
-                if (!(htud->tsflags & HTP_DONTSTORE)) {
-                    result = HTPFileStoreChunk(hstate, filedata,
-                            filedata_len, STREAM_TOSERVER);
-                    if (result == -1) {
-                        goto end;
-                    } else if (result == -2) {
-                        /* we know for sure we're not storing the file */
-                        htud->tsflags |= HTP_DONTSTORE;
-                    }
-                }
-
-                htud->request_body.body_parsed += filedata_len;
-            } else {
-                SCLogDebug("chunk too small to already process in part");
-            }
+    if (htud->boundary == NULL || htud->boundary_len == 0)
+        return -1;
 
-            goto end;
-        }
+    if (htud->multipart == NULL) {
+        if (HtpMultipartSetup(htud) < 0)
+            return -1;
     }
+    HtpMultipartState *mp = htud->multipart;
 
-    while (header_start != NULL && header_end != NULL &&
-            header_end != form_end &&
-            header_start < (chunks_buffer + chunks_buffer_len) &&
-            header_end < (chunks_buffer + chunks_buffer_len) &&
-            header_start < header_end)
-    {
-        uint8_t *filename = NULL;
-        uint16_t filename_len = 0;
-        uint8_t *filetype = NULL;
-        uint16_t filetype_len = 0;
-
-        uint32_t header_len = header_end - header_start;
-        SCLogDebug("header_len %u", header_len);
-        uint8_t *header = header_start;
+    uint32_t carry = (mp->state == HTP_MULTIPART_STATE_DATA) ? mp->match : 0;
+    uint32_t data_start = 0;
+    uint32_t i;
 
-        /* skip empty records */
-        if (expected_boundary_len == header_len) {
-            goto next;
-        } else if ((uint32_t)(expected_boundary_len + 2) <= header_len) {
-            header_len -= (expected_boundary_len + 2);
-            header = header_start + (expected_boundary_len + 2); // + for 0d 0a
-        }
-
-        HtpRequestBodyMultipartParseHeader(hstate, header, header_len,
-                &filename, &filename_len, &filetype, &filetype_len);
-
-        if (filename != NULL) {
-            uint8_t *filedata = NULL;
-            uint32_t filedata_len = 0;
+    for (i = 0; i < data_len && mp->state != HTP_MULTIPART_STATE_DONE; i++) {
+        uint8_t c = data[i];
 
-            SCLogDebug("we have a filename");
+        switch (mp->state) {
+            case HTP_MULTIPART_STATE_DATA:
+                while (mp->match > 0 && mp->delim[mp->match] != c)
+                    mp->match = mp->fail[mp->match - 1];
+                if (mp->delim[mp->match] == c)
+                    mp->match++;
 
-            htud->tsflags |= HTP_FILENAME_SET;
-            htud->tsflags &= ~HTP_DONTSTORE;
-
-            SCLogDebug("header_end %p", header_end);
-            SCLogDebug("form_end %p", form_end);
+                if (mp->match == mp->delim_len) {
+                    SCLogDebug("delimiter at offset %u", i);
+                    HtpMultipartFlushData(hstate, htud, data, data_start,
+                            (int64_t)i + 1 - mp->delim_len, carry);
+                    HtpMultipartPartEnd(hstate, htud);
 
-            /* everything until the final boundary is the file */
-            if (form_end != NULL) {
-                filedata = header_end + 4;
-                if (form_end == filedata) {
-                    AppLayerDecoderEventsSetEvent(hstate->f,
-                            HTTP_DECODER_EVENT_MULTIPART_NO_FILEDATA);
-                    goto end;
-                } else if (form_end < filedata) {
-                    AppLayerDecoderEventsSetEvent(hstate->f,
-                            HTTP_DECODER_EVENT_MULTIPART_GENERIC_ERROR);
-                    goto end;
+                    mp->match = 0;
+                    mp->virt = 0;
+                    carry = 0;
+                    mp->state = HTP_MULTIPART_STATE_BOUNDARY;
                 }
+                break;
 
-                filedata_len = form_end - (header_end + 4 + 2);
-                SCLogDebug("filedata_len %"PRIuMAX, (uintmax_t)filedata_len);
-
-                /* or is it? */
-                uint8_t *header_next = Bs2bmSearch(filedata, filedata_len,
-                        expected_boundary, expected_boundary_len);
-                if (header_next != NULL) {
-                    filedata_len -= (form_end - header_next);
-                }
-
-                if (filedata_len > chunks_buffer_len) {
-                    AppLayerDecoderEventsSetEvent(hstate->f,
-                            HTTP_DECODER_EVENT_MULTIPART_GENERIC_ERROR);
-                    goto end;
-                }
-                SCLogDebug("filedata_len %"PRIuMAX, (uintmax_t)filedata_len);
-#ifdef PRINT
-                printf("FILEDATA START: \n");
-                PrintRawDataFp(stdout, filedata, filedata_len);
-                printf("FILEDATA END: \n");
-#endif
-
-                result = HTPFileOpen(hstate, filename, filename_len,
-                            filedata, filedata_len, hstate->transaction_cnt,
-                            STREAM_TOSERVER);
-                if (result == -1) {
-                    goto end;
-                } else if (result == -2) {
-                    htud->tsflags |= HTP_DONTSTORE;
-                } else {
-                    if (HTPFileClose(hstate, NULL, 0, 0, STREAM_TOSERVER) == -1) {
-                        goto end;
+            case HTP_MULTIPART_STATE_BOUNDARY:
+            case HTP_MULTIPART_STATE_BOUNDARY_DASH:
+                if (c == '-') {
+                    if (mp->state == HTP_MULTIPART_STATE_BOUNDARY_DASH) {
+                        SCLogDebug("form end at offset %u", i);
+                        mp->state = HTP_MULTIPART_STATE_DONE;
+                    } else {
+                        mp->state = HTP_MULTIPART_STATE_BOUNDARY_DASH;
                     }
+                    break;
                 }
-
-                htud->request_body.body_parsed += (header_end - chunks_buffer);
-                htud->tsflags &= ~HTP_FILENAME_SET;
-            } else {
-                SCLogDebug("chunk doesn't contain form end");
-
-                filedata = header_end + 4;
-                filedata_len = chunks_buffer_len - (filedata - chunks_buffer);
-                SCLogDebug("filedata_len %u (chunks_buffer_len %u)", filedata_len, chunks_buffer_len);
-
-                if (filedata_len > chunks_buffer_len) {
-                    AppLayerDecoderEventsSetEvent(hstate->f,
-                            HTTP_DECODER_EVENT_MULTIPART_GENERIC_ERROR);
-                    goto end;
+                mp->state = HTP_MULTIPART_STATE_BOUNDARY_LINE;
+                /* fall through */
+            case HTP_MULTIPART_STATE_BOUNDARY_LINE:
+                if (c == '\n') {
+                    /* the CRLF of the boundary line counts towards the
+                     * CRLFCRLF that ends the headers, so that a part
+                     * without headers is handled too */
+                    mp->hdr_len = 0;
+                    mp->hdr_match = 2;
+                    mp->state = HTP_MULTIPART_STATE_HEADERS;
                 }
+                break;
 
-#ifdef PRINT
-                printf("FILEDATA START: \n");
-                PrintRawDataFp(stdout, filedata, filedata_len);
-                printf("FILEDATA END: \n");
-#endif
-                /* form doesn't end in this chunk, but part might. Lets
-                 * see if have another coming up */
-                uint8_t *header_next = Bs2bmSearch(filedata, filedata_len,
-                        expected_boundary, expected_boundary_len);
-                SCLogDebug("header_next %p", header_next);
-                if (header_next == NULL) {
-                    /* no, but we'll handle the file data when we see the
-                     * form_end */
-
-                    SCLogDebug("more file data to come");
-
-                    uint32_t offset = (header_end + 4) - chunks_buffer;
-                    SCLogDebug("offset %u", offset);
-                    htud->request_body.body_parsed += offset;
-
-                    result = HTPFileOpen(hstate, filename, filename_len,
-                            NULL, 0, hstate->transaction_cnt,
-                            STREAM_TOSERVER);
-                    if (result == -1) {
-                        goto end;
-                    } else if (result == -2) {
-                        htud->tsflags |= HTP_DONTSTORE;
-                    }
-                } else if (header_next - filedata > 2) {
-                    filedata_len = header_next - filedata - 2;
-                    SCLogDebug("filedata_len %u", filedata_len);
-
-                    result = HTPFileOpen(hstate, filename, filename_len,
-                            filedata, filedata_len, hstate->transaction_cnt,
-                            STREAM_TOSERVER);
-                    if (result == -1) {
-                        goto end;
-                    } else if (result == -2) {
-                        htud->tsflags |= HTP_DONTSTORE;
-                    } else {
-                        if (HTPFileClose(hstate, NULL, 0, 0, STREAM_TOSERVER) == -1) {
-                            goto end;
-                        }
+            case HTP_MULTIPART_STATE_HEADERS:
+                if (mp->hdr_len < HTP_MULTIPART_HEADER_MAX) {
+                    if (mp->hdr_len == mp->hdr_size) {
+                        uint32_t size = mp->hdr_size ? mp->hdr_size * 2 : 256;
+                        uint8_t *ptr = SCRealloc(mp->hdr, size);
+                        if (unlikely(ptr == NULL))
+                            return -1;
+                        mp->hdr = ptr;
+                        mp->hdr_size = size;
                     }
+                    mp->hdr[mp->hdr_len++] = c;
+                }
 
-                    htud->tsflags &= ~HTP_FILENAME_SET;
-                    htud->request_body.body_parsed += (header_end - chunks_buffer);
+                if (c == "\r\n\r\n"[mp->hdr_match])
+                    mp->hdr_match++;
+                else
+                    mp->hdr_match = (c == '\r') ? 1 : 0;
+
+                if (mp->hdr_match == 4) {
+                    HtpMultipartPartStart(hstate, htud);
+
+                    /* the CRLF that ends the headers is the start of the
+                     * delimiter if the part is empty */
+                    mp->match = 2;
+                    mp->virt = 2;
+                    carry = 2;
+                    data_start = i + 1;
+                    mp->state = HTP_MULTIPART_STATE_DATA;
                 }
-            }
-        }
-next:
-        SCLogDebug("header_start %p, header_end %p, form_end %p",
-                header_start, header_end, form_end);
-
-        /* Search next boundary entry after the start of body */
-        uint32_t cursizeread = header_end - chunks_buffer;
-        header_start = Bs2bmSearch(header_end + 4,
-                chunks_buffer_len - (cursizeread + 4),
-                expected_boundary, expected_boundary_len);
-        if (header_start != NULL) {
-            header_end = Bs2bmSearch(header_end + 4,
-                    chunks_buffer_len - (cursizeread + 4),
-                    (uint8_t *) "\r\n\r\n", 4);
+                break;
         }
     }
-end:
-    if (expected_boundary != NULL) {
-        SCFree(expected_boundary);
-    }
-    if (expected_boundary_end != NULL) {
-        SCFree(expected_boundary_end);
+
+    if (mp->state == HTP_MULTIPART_STATE_DATA) {
+        HtpMultipartFlushData(hstate, htud, data, data_start,
+                (int64_t)i - mp->match, carry);
     }
 
+    htud->request_body.body_parsed += data_len;
     SCLogDebug("htud->request_body.body_parsed %"PRIu64, htud->request_body.body_parsed);
     return 0;
 }
@@ -1717,7 +1631,7 @@ int HTPCallbackRequestBodyData(htp_tx_data_t *d)
 
     HtpTxUserData *tx_ud = (HtpTxUserData *) htp_tx_get_user_data(d->tx);
     if (tx_ud == NULL) {
-        tx_ud = SCMalloc(sizeof(HtpTxUserData));
+        tx_ud = AppLayerSlabAlloc(sizeof(HtpTxUserData));
         if (unlikely(tx_ud == NULL)) {
             SCReturnInt(HTP_OK);
         }
@@ -1764,30 +1678,13 @@ int HTPCallbackRequestBodyData(htp_tx_data_t *d)
 
         HtpBodyAppendChunk(tx_ud, &tx_ud->request_body, (uint8_t *)d->data, len);
 
-        uint8_t *chunks_buffer = NULL;
-        uint32_t chunks_buffer_len = 0;
-
         if (tx_ud->request_body_type == HTP_BODY_REQUEST_MULTIPART) {
             /* multi-part body handling starts here */
             if (!(tx_ud->tsflags & HTP_BOUNDARY_SET)) {
                 goto end;
             }
 
-            HtpRequestBodyReassemble(tx_ud, &chunks_buffer, &chunks_buffer_len);
-            if (chunks_buffer == NULL) {
-                goto end;
-            }
-#ifdef PRINT
-            printf("REASSCHUNK START: \n");
-            PrintRawDataFp(stdout, chunks_buffer, chunks_buffer_len);
-            printf("REASSCHUNK END: \n");
-#endif
-
-            HtpRequestBodyHandleMultipart(hstate, tx_ud, d->tx, chunks_buffer, chunks_buffer_len);
-
-            if (chunks_buffer != NULL) {
-                SCFree(chunks_buffer);
-            }
+            HtpRequestBodyHandleMultipart(hstate, tx_ud, (uint8_t *)d->data, len);
         } else if (tx_ud->request_body_type == HTP_BODY_REQUEST_POST) {
             HtpRequestBodyHandlePOST(hstate, tx_ud, d->tx, (uint8_t *)d->data, (uint32_t)d->len);
         } else if (tx_ud->request_body_type == HTP_BODY_REQUEST_PUT) {
@@ -1831,7 +1728,7 @@ int HTPCallbackResponseBodyData(htp_tx_data_t *d)
 
     HtpTxUserData *tx_ud = (HtpTxUserData *) htp_tx_get_user_data(d->tx);
     if (tx_ud == NULL) {
-        tx_ud = SCMalloc(sizeof(HtpTxUserData));
+        tx_ud = AppLayerSlabAlloc(sizeof(HtpTxUserData));
         if (unlikely(tx_ud == NULL)) {
             SCReturnInt(HTP_OK);
         }
@@ -2001,7 +1898,7 @@ static int HTPCallbackRequestLine(htp_tx_t *tx)
     if (request_uri_normalized == NULL)
         return HTP_OK;
 
-    tx_ud = SCMalloc(sizeof(*tx_ud));
+    tx_ud = AppLayerSlabAlloc(sizeof(*tx_ud));
     if (tx_ud == NULL) {
         bstr_free(request_uri_normalized);
         return HTP_OK;
@@ -2046,7 +1943,7 @@ static int HTPCallbackRequestHeaderData(htp_tx_data_t *tx_data)
 
     HtpTxUserData *tx_ud = htp_tx_get_user_data(tx_data->tx);
     if (tx_ud == NULL) {
-        tx_ud = SCMalloc(sizeof(*tx_ud));
+        tx_ud = AppLayerSlabAlloc(sizeof(*tx_ud));
         if (tx_ud == NULL)
             return HTP_OK;
         memset(tx_ud, 0, sizeof(*tx_ud));
@@ -2078,7 +1975,7 @@ static int HTPCallbackResponseHeaderData(htp_tx_data_t *tx_data)
 
     HtpTxUserData *tx_ud = htp_tx_get_user_data(tx_data->tx);
     if (tx_ud == NULL) {
-        tx_ud = SCMalloc(sizeof(*tx_ud));
+        tx_ud = AppLayerSlabAlloc(sizeof(*tx_ud));
         if (tx_ud == NULL)
             return HTP_OK;
         memset(tx_ud, 0, sizeof(*tx_ud));
@@ -2099,6 +1996,161 @@ static int HTPCallbackResponseHeaderData(htp_tx_data_t *tx_data)
     return HTP_OK;
 }
 
+/**
+ * \internal
+ * \brief Build the normalized header buffer and the index of the
+ *        well-known headers. All values are copied, so the result doesn't
+ *        depend on the libhtp header table that may change later.
+ *
+ * \param hdrs headers to build
+ * \param headers libhtp header table
+ * \param flags STREAM_TOSERVER or STREAM_TOCLIENT
+ *
+ * \retval 0 ok
+ * \retval -1 out of memory
+ */
+static int HTPTxBuildHeaders(HtpTxHeaders *hdrs, htp_table_t *headers,
+                             uint8_t flags)
+{
+    char *cookie = (flags & STREAM_TOSERVER) ? "cookie" : "set-cookie";
+    size_t cookie_len = (flags & STREAM_TOSERVER) ? 6 : 10;
+    size_t cnt = htp_table_size(headers);
+    htp_header_t *cookie_h = NULL;
+    uint32_t len = 0;
+    size_t i;
+
+    memset(hdrs->value, 0x00, sizeof(hdrs->value));
+    memset(hdrs->value_len, 0x00, sizeof(hdrs->value_len));
+    hdrs->built = 0;
+
+    /* size the buffer up front, the extra 4 bytes are for ": " and "\r\n" */
+    for (i = 0; i < cnt; i++) {
+        htp_header_t *h = htp_table_get_index(headers, i, NULL);
+        size_t name_len = bstr_size(h->name);
+
+        if (name_len == cookie_len &&
+            SCMemcmpLowercase(cookie, bstr_ptr(h->name), cookie_len) == 0) {
+            if (cookie_h == NULL) {
+                cookie_h = h;
+                len += bstr_size(h->value);
+            }
+            continue;
+        }
+        len += name_len + bstr_size(h->value) + 4;
+    }
+
+    if (len > 0) {
+        uint8_t *ptr = SCRealloc(hdrs->buffer, len);
+        if (ptr == NULL) {
+            hdrs->buffer_len = 0;
+            return -1;
+        }
+        hdrs->buffer = ptr;
+    }
+    hdrs->buffer_len = 0;
+
+    for (i = 0; i < cnt; i++) {
+        htp_header_t *h = htp_table_get_index(headers, i, NULL);
+        size_t name_len = bstr_size(h->name);
+        size_t value_len = bstr_size(h->value);
+        uint8_t *name = bstr_ptr(h->name);
+
+        if (name_len == cookie_len &&
+            SCMemcmpLowercase(cookie, name, cookie_len) == 0) {
+            continue;
+        }
+
+        memcpy(hdrs->buffer + hdrs->buffer_len, name, name_len);
+        hdrs->buffer_len += name_len;
+        hdrs->buffer[hdrs->buffer_len++] = ':';
+        hdrs->buffer[hdrs->buffer_len++] = ' ';
+
+        /* index the value as copied into the buffer */
+        int idx = -1;
+        if (name_len == 10 &&
+            SCMemcmpLowercase("user-agent", name, 10) == 0)
+            idx = HTP_HDR_USER_AGENT;
+        else if (name_len == 4 &&
+            SCMemcmpLowercase("host", name, 4) == 0)
+            idx = HTP_HDR_HOST;
+        if (idx >= 0 && hdrs->value[idx] == NULL) {
+            hdrs->value[idx] = hdrs->buffer + hdrs->buffer_len;
+            hdrs->value_len[idx] = value_len;
+        }
+
+        memcpy(hdrs->buffer + hdrs->buffer_len, bstr_ptr(h->value), value_len);
+        hdrs->buffer_len += value_len;
+        hdrs->buffer[hdrs->buffer_len++] = '\r';
+        hdrs->buffer[hdrs->buffer_len++] = '\n';
+    }
+
+    /* the (Set-)Cookie value goes after the http_header part */
+    if (cookie_h != NULL) {
+        uint8_t *value = hdrs->buffer + hdrs->buffer_len;
+        memcpy(value, bstr_ptr(cookie_h->value), bstr_size(cookie_h->value));
+        hdrs->value[HTP_HDR_COOKIE] = value;
+        hdrs->value_len[HTP_HDR_COOKIE] = bstr_size(cookie_h->value);
+    }
+
+    hdrs->built = 1;
+    return 0;
+}
+
+/**
+ * \brief Get the headers of a transaction for inspection.
+ *
+ * The normalized header buffer and the index of the well-known headers
+ * are built on the first call after the headers are complete and are
+ * cached in the tx user data. They are rebuilt when the progress of the
+ * tx changed since, so headers and values added by trailers are picked
+ * up. Once the request or response is complete they don't change anymore.
+ *
+ * \param tx the transaction
+ * \param flags STREAM_TOSERVER for the request headers, STREAM_TOCLIENT
+ *              for the response headers
+ *
+ * \retval hdrs headers, NULL if not complete yet or on error
+ */
+HtpTxHeaders *HTPTxGetHeaders(htp_tx_t *tx, uint8_t flags)
+{
+    htp_table_t *headers;
+    HtpTxHeaders *hdrs;
+    int progress;
+
+    if (flags & STREAM_TOSERVER) {
+        progress = HTPStateGetAlstateProgress(tx, 0);
+        if (progress <= HTP_REQUEST_HEADERS)
+            return NULL;
+        headers = tx->request_headers;
+    } else {
+        progress = HTPStateGetAlstateProgress(tx, 1);
+        if (progress <= HTP_RESPONSE_HEADERS)
+            return NULL;
+        headers = tx->response_headers;
+    }
+    if (headers == NULL)
+        return NULL;
+
+    HtpTxUserData *tx_ud = htp_tx_get_user_data(tx);
+    if (tx_ud == NULL) {
+        tx_ud = AppLayerSlabAlloc(sizeof(*tx_ud));
+        if (tx_ud == NULL)
+            return NULL;
+        memset(tx_ud, 0, sizeof(*tx_ud));
+        htp_tx_set_user_data(tx, tx_ud);
+    }
+    hdrs = (flags & STREAM_TOSERVER) ? &tx_ud->request_hdrs :
+                                       &tx_ud->response_hdrs;
+
+    if (hdrs->built && hdrs->progress == (uint8_t)progress)
+        return hdrs;
+
+    if (HTPTxBuildHeaders(hdrs, headers, flags) < 0)
+        return NULL;
+    hdrs->progress = (uint8_t)progress;
+    return hdrs;
+}
+
 /*
  * We have a similar set function called HTPConfigSetDefaultsPhase1.
  */
@@ -4807,8 +4859,6 @@ static int HTPBodyReassemblyTest01(void)
     memset(&flow, 0x00, sizeof(flow));
     AppLayerParserStateStore parser;
     memset(&parser, 0x00, sizeof(parser));
-    htp_tx_t tx;
-    memset(&tx, 0, sizeof(tx));
 
     hstate.f = &flow;
     flow.alparser = &parser;
@@ -4816,33 +4866,125 @@ static int HTPBodyReassemblyTest01(void)
     uint8_t chunk1[] = "--e5a320f21416a02493a0a6f561b1c494\r\nContent-Disposition: form-data; name=\"uploadfile\"; filename=\"D2GUef.jpg\"\r";
     uint8_t chunk2[] = "POST /uri HTTP/1.1\r\nHost: hostname.com\r\nKeep-Alive: 115\r\nAccept-Charset: utf-8\r\nUser-Agent: Mozilla/5.0 (X11; Linux i686; rv:9.0.1) Gecko/20100101 Firefox/9.0.1\r\nAccept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\nConnection: keep-alive\r\nContent-length: 68102\r\nReferer: http://otherhost.com\r\nAccept-Encoding: gzip\r\nContent-Type: multipart/form-data; boundary=e5a320f21416a02493a0a6f561b1c494\r\nCookie: blah\r\nAccept-Language: us\r\n\r\n--e5a320f21416a02493a0a6f561b1c494\r\nContent-Disposition: form-data; name=\"uploadfile\"; filename=\"D2GUef.jpg\"\r";
 
+    uint8_t boundary[] = "e5a320f21416a02493a0a6f561b1c494";
+    htud.boundary = boundary;
+    htud.boundary_len = sizeof(boundary) - 1;
+
     int r = HtpBodyAppendChunk(&htud, &htud.request_body, (uint8_t *)chunk1, sizeof(chunk1)-1);
     BUG_ON(r != 0);
+    HtpRequestBodyHandleMultipart(&hstate, &htud, chunk1, sizeof(chunk1)-1);
     r = HtpBodyAppendChunk(&htud, &htud.request_body, (uint8_t *)chunk2, sizeof(chunk2)-1);
     BUG_ON(r != 0);
+    HtpRequestBodyHandleMultipart(&hstate, &htud, chunk2, sizeof(chunk2)-1);
 
-    uint8_t *chunks_buffer = NULL;
-    uint32_t chunks_buffer_len = 0;
-
-    HtpRequestBodyReassemble(&htud, &chunks_buffer, &chunks_buffer_len);
-    if (chunks_buffer == NULL) {
+    if (htud.request_body.content_len_so_far != 669) {
+        printf("htud.request_body.content_len_so_far %"PRIu64": ", htud.request_body.content_len_so_far);
         goto end;
     }
-#ifdef PRINT
-    printf("REASSCHUNK START: \n");
-    PrintRawDataFp(stdout, chunks_buffer, chunks_buffer_len);
-    printf("REASSCHUNK END: \n");
-#endif
-
-    HtpRequestBodyHandleMultipart(&hstate, &htud, &tx, chunks_buffer, chunks_buffer_len);
 
-    if (htud.request_body.content_len_so_far != 669) {
-        printf("htud.request_body.content_len_so_far %"PRIu64": ", htud.request_body.content_len_so_far);
+    /* the garbage headers end in the second chunk, directly followed by
+     * a delimiter: the file is empty */
+    if (hstate.files_ts == NULL || hstate.files_ts->head == NULL ||
+            hstate.files_ts->head != hstate.files_ts->tail ||
+            hstate.files_ts->head->state != FILE_STATE_CLOSED ||
+            hstate.files_ts->head->size != 0) {
+        printf("expected a single empty closed file: ");
         goto end;
     }
 
+    result = 1;
+end:
+    HtpMultipartFree(htud.multipart);
+    HtpBodyFree(&htud.request_body);
     if (hstate.files_ts != NULL)
-        goto end;
+        FileContainerFree(hstate.files_ts);
+    return result;
+}
+
+/** \test multipart body parsed at once and byte by byte: partial delimiters
+ *        in the file data are file data, the result is the same */
+static int HTPBodyMultipartTest01(void)
+{
+    int result = 0;
+    uint8_t body[] = "preamble\r\n"
+                     "--BND\r\n"
+                     "Content-Disposition: form-data; name=\"a\"\r\n"
+                     "\r\n"
+                     "value\r\n"
+                     "--BND\r\n"
+                     "Content-Disposition: form-data; name=\"f\"; filename=\"f.txt\"\r\n"
+                     "Content-Type: text/plain\r\n"
+                     "\r\n"
+                     "ab\r\n--BN\r\r\n-x\r\n"
+                     "--BND--\r\n"
+                     "epilogue\r\n--BND\r\n";
+    uint32_t body_len = sizeof(body) - 1;
+    uint8_t expected[] = "ab\r\n--BN\r\r\n-x";
+    uint32_t expected_len = sizeof(expected) - 1;
+    uint8_t boundary[] = "BND";
+    int step;
+
+    for (step = 0; step < 2; step++) {
+        HtpTxUserData htud;
+        memset(&htud, 0x00, sizeof(htud));
+        HtpState hstate;
+        memset(&hstate, 0x00, sizeof(hstate));
+        Flow flow;
+        memset(&flow, 0x00, sizeof(flow));
+        AppLayerParserStateStore parser;
+        memset(&parser, 0x00, sizeof(parser));
+        uint8_t filedata[64];
+        uint32_t filedata_len = 0;
+        int ok = 0;
+
+        hstate.f = &flow;
+        flow.alparser = &parser;
+        htud.boundary = boundary;
+        htud.boundary_len = sizeof(boundary) - 1;
+
+        if (step == 0) {
+            HtpRequestBodyHandleMultipart(&hstate, &htud, body, body_len);
+        } else {
+            uint32_t u;
+            for (u = 0; u < body_len; u++)
+                HtpRequestBodyHandleMultipart(&hstate, &htud, body + u, 1);
+        }
+
+        if (hstate.files_ts == NULL || hstate.files_ts->head == NULL ||
+                hstate.files_ts->head != hstate.files_ts->tail ||
+                hstate.files_ts->head->state != FILE_STATE_CLOSED) {
+            printf("step %d: expected a single closed file: ", step);
+            goto next;
+        }
+
+        FileData *fd = hstate.files_ts->head->chunks_head;
+        for ( ; fd != NULL; fd = fd->next) {
+            if (filedata_len + fd->len > sizeof(filedata))
+                goto next;
+            memcpy(filedata + filedata_len, fd->data, fd->len);
+            filedata_len += fd->len;
+        }
+        if (filedata_len != expected_len ||
+                memcmp(filedata, expected, expected_len) != 0) {
+            printf("step %d: filedata mismatch: ", step);
+            PrintRawDataFp(stdout, filedata, filedata_len);
+            goto next;
+        }
+
+        if (htud.request_body.body_parsed != body_len) {
+            printf("step %d: body_parsed %"PRIu64": ", step,
+                    htud.request_body.body_parsed);
+            goto next;
+        }
+
+        ok = 1;
+next:
+        HtpMultipartFree(htud.multipart);
+        if (hstate.files_ts != NULL)
+            FileContainerFree(hstate.files_ts);
+        if (!ok)
+            goto end;
+    }
 
     result = 1;
 end:
@@ -5071,6 +5213,187 @@ end:
     HtpConfigRestoreBackup();
     return result;
 }
+/** \test Test the normalized header buffer and the index of the
+ *        well-known headers of a tx.
+ */
+int HTPParserTest15(void) {
+    int result = 0;
+    Flow *f = NULL;
+    HtpState *http_state = NULL;
+    uint8_t httpbuf1[] = "GET / HTTP/1.1\r\nHost: www.example.org\r\n"
+                         "Cookie: id=1\r\nUser-Agent: Victor/1.0\r\n\r\n";
+    uint32_t httplen1 = sizeof(httpbuf1) - 1; /* minus the \0 */
+    uint8_t expected[] = "Host: www.example.org\r\nUser-Agent: Victor/1.0\r\n";
+    TcpSession ssn;
+
+    memset(&ssn, 0, sizeof(ssn));
+
+    f = UTHBuildFlow(AF_INET, "1.2.3.4", "1.2.3.5", 1024, 80);
+    if (f == NULL)
+        goto end;
+    f->protoctx = &ssn;
+
+    StreamTcpInitConfig(TRUE);
+
+    SCMutexLock(&f->m);
+    int r = AppLayerParse(NULL, f, ALPROTO_HTTP, STREAM_TOSERVER|STREAM_START|
+                          STREAM_EOF, httpbuf1, httplen1);
+    if (r != 0) {
+        printf("toserver chunk 1 returned %" PRId32 ", expected 0: ", r);
+        SCMutexUnlock(&f->m);
+        goto end;
+    }
+    SCMutexUnlock(&f->m);
+
+    http_state = f->alstate;
+    if (http_state == NULL) {
+        printf("no http state: ");
+        goto end;
+    }
+
+    htp_tx_t *tx = HTPStateGetTx(http_state, 0);
+    HtpTxHeaders *hdrs = HTPTxGetHeaders(tx, STREAM_TOSERVER);
+    if (hdrs == NULL) {
+        printf("no headers: ");
+        goto end;
+    }
+    if (hdrs->buffer_len != sizeof(expected) - 1 ||
+        memcmp(hdrs->buffer, expected, hdrs->buffer_len) != 0) {
+        printf("unexpected header buffer: ");
+        PrintRawDataFp(stdout, hdrs->buffer, hdrs->buffer_len);
+        goto end;
+    }
+    if (hdrs->value_len[HTP_HDR_USER_AGENT] != 10 ||
+        memcmp(hdrs->value[HTP_HDR_USER_AGENT], "Victor/1.0", 10) != 0 ||
+        hdrs->value_len[HTP_HDR_HOST] != 15 ||
+        memcmp(hdrs->value[HTP_HDR_HOST], "www.example.org", 15) != 0 ||
+        hdrs->value_len[HTP_HDR_COOKIE] != 4 ||
+        memcmp(hdrs->value[HTP_HDR_COOKIE], "id=1", 4) != 0) {
+        printf("unexpected header index: ");
+        goto end;
+    }
+
+    /* the next inspection gets the cached headers */
+    uint8_t *buffer = hdrs->buffer;
+    if (HTPTxGetHeaders(tx, STREAM_TOSERVER) != hdrs || hdrs->buffer != buffer) {
+        printf("headers rebuilt: ");
+        goto end;
+    }
+
+    /* no response yet */
+    if (HTPTxGetHeaders(tx, STREAM_TOCLIENT) != NULL) {
+        printf("response headers while there is no response: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    StreamTcpFreeConfig(TRUE);
+    if (http_state != NULL)
+        HTPStateFree(http_state);
+    UTHFreeFlow(f);
+    return result;
+}
+
+/** \test Test that headers repeated in the trailer of a chunked request
+ *        are picked up by the cached headers.
+ */
+int HTPParserTest16(void) {
+    int result = 0;
+    Flow *f = NULL;
+    HtpState *http_state = NULL;
+    uint8_t httpbuf1[] = "POST / HTTP/1.1\r\nHost: www.example.org\r\n"
+                         "Cookie: a=1\r\nUser-Agent: Victor/1.0\r\n"
+                         "Transfer-Encoding: chunked\r\n\r\n"
+                         "4\r\nabcd\r\n";
+    uint32_t httplen1 = sizeof(httpbuf1) - 1; /* minus the \0 */
+    uint8_t httpbuf2[] = "0\r\nUser-Agent: Evil\r\nCookie: b=2\r\n\r\n";
+    uint32_t httplen2 = sizeof(httpbuf2) - 1; /* minus the \0 */
+    TcpSession ssn;
+
+    memset(&ssn, 0, sizeof(ssn));
+
+    f = UTHBuildFlow(AF_INET, "1.2.3.4", "1.2.3.5", 1024, 80);
+    if (f == NULL)
+        goto end;
+    f->protoctx = &ssn;
+
+    StreamTcpInitConfig(TRUE);
+
+    SCMutexLock(&f->m);
+    int r = AppLayerParse(NULL, f, ALPROTO_HTTP, STREAM_TOSERVER|STREAM_START,
+                          httpbuf1, httplen1);
+    if (r != 0) {
+        printf("toserver chunk 1 returned %" PRId32 ", expected 0: ", r);
+        SCMutexUnlock(&f->m);
+        goto end;
+    }
+    SCMutexUnlock(&f->m);
+
+    http_state = f->alstate;
+    if (http_state == NULL) {
+        printf("no http state: ");
+        goto end;
+    }
+
+    htp_tx_t *tx = HTPStateGetTx(http_state, 0);
+    HtpTxHeaders *hdrs = HTPTxGetHeaders(tx, STREAM_TOSERVER);
+    if (hdrs == NULL) {
+        printf("no headers: ");
+        goto end;
+    }
+    if (hdrs->value_len[HTP_HDR_USER_AGENT] != 10 ||
+        memcmp(hdrs->value[HTP_HDR_USER_AGENT], "Victor/1.0", 10) != 0 ||
+        hdrs->value_len[HTP_HDR_COOKIE] != 3 ||
+        memcmp(hdrs->value[HTP_HDR_COOKIE], "a=1", 3) != 0) {
+        printf("unexpected header index before the trailer: ");
+        goto end;
+    }
+
+    SCMutexLock(&f->m);
+    r = AppLayerParse(NULL, f, ALPROTO_HTTP, STREAM_TOSERVER|STREAM_EOF,
+                      httpbuf2, httplen2);
+    if (r != 0) {
+        printf("toserver chunk 2 returned %" PRId32 ", expected 0: ", r);
+        SCMutexUnlock(&f->m);
+        goto end;
+    }
+    SCMutexUnlock(&f->m);
+
+    /* libhtp adds the repeated headers to the values of the existing ones */
+    hdrs = HTPTxGetHeaders(tx, STREAM_TOSERVER);
+    if (hdrs == NULL) {
+        printf("no headers after the trailer: ");
+        goto end;
+    }
+    uint32_t ua_len = hdrs->value_len[HTP_HDR_USER_AGENT];
+    uint32_t cookie_len = hdrs->value_len[HTP_HDR_COOKIE];
+    if (ua_len <= 10 ||
+        memcmp(hdrs->value[HTP_HDR_USER_AGENT] + ua_len - 4, "Evil", 4) != 0) {
+        printf("trailer user agent not in the index: ");
+        goto end;
+    }
+    if (cookie_len <= 3 ||
+        memcmp(hdrs->value[HTP_HDR_COOKIE] + cookie_len - 3, "b=2", 3) != 0) {
+        printf("trailer cookie not in the index: ");
+        goto end;
+    }
+    /* the cookie is a copy as well */
+    if (hdrs->value[HTP_HDR_COOKIE] < hdrs->buffer ||
+        hdrs->value[HTP_HDR_COOKIE] > hdrs->buffer + hdrs->buffer_len) {
+        printf("cookie value doesn't point into the header buffer: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    StreamTcpFreeConfig(TRUE);
+    if (http_state != NULL)
+        HTPStateFree(http_state);
+    UTHFreeFlow(f);
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 /**
@@ -5105,9 +5428,12 @@ void HTPParserRegisterTests(void) {
     UtRegisterTest("HTPParserDecodingTest05", HTPParserDecodingTest05, 1);
 
     UtRegisterTest("HTPBodyReassemblyTest01", HTPBodyReassemblyTest01, 1);
+    UtRegisterTest("HTPBodyMultipartTest01", HTPBodyMultipartTest01, 1);
 
     UtRegisterTest("HTPSegvTest01", HTPSegvTest01, 1);
     UtRegisterTest("HTPParserTest14", HTPParserTest14, 1);
+    UtRegisterTest("HTPParserTest15", HTPParserTest15, 1);
+    UtRegisterTest("HTPParserTest16", HTPParserTest16, 1);
 
     HTPFileParserRegisterTests();
 #endif /* UNITTESTS */
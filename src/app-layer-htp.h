@@ -185,6 +185,70 @@ typedef struct HtpBody_ {
 #define HTP_RULE_NEED_TYPE          HTP_TX_HAS_TYPE
 #define HTP_RULE_NEED_FILECONTENT   HTP_TX_HAS_FILECONTENT
 
+/** multipart/form-data parser states */
+#define HTP_MULTIPART_STATE_DATA            0   /**< preamble or part data,
+                                                     looking for the delimiter */
+#define HTP_MULTIPART_STATE_BOUNDARY        1   /**< right after the delimiter */
+#define HTP_MULTIPART_STATE_BOUNDARY_DASH   2   /**< seen one '-' after it */
+#define HTP_MULTIPART_STATE_BOUNDARY_LINE   3   /**< skipping to the end of the
+                                                     boundary line */
+#define HTP_MULTIPART_STATE_HEADERS         4   /**< part headers */
+#define HTP_MULTIPART_STATE_DONE            5   /**< close delimiter seen */
+
+/** max size of the headers of a part we buffer, the rest is ignored */
+#define HTP_MULTIPART_HEADER_MAX            8192U
+
+/** State of the multipart/form-data parser of a request body. The body is
+ *  parsed as it comes in, the state keeps the position in the form and the
+ *  partial delimiter match across body chunks. */
+typedef struct HtpMultipartState_ {
+    uint8_t state;
+    uint8_t delim_len;                  /**< length of "\r\n--<boundary>" */
+    uint8_t match;                      /**< delimiter bytes matched */
+    uint8_t virt;                       /**< leading matched bytes that are
+                                             not part data: the CRLF that ends
+                                             the part headers */
+    uint8_t hdr_match;                  /**< bytes of the header end matched */
+    uint8_t delim[HTP_BOUNDARY_MAX + 4];
+    uint8_t fail[HTP_BOUNDARY_MAX + 4]; /**< delimiter failure function */
+
+    uint32_t data_len;                  /**< data bytes of the current part */
+
+    uint8_t *hdr;                       /**< headers of the current part */
+    uint32_t hdr_len;
+    uint32_t hdr_size;
+} HtpMultipartState;
+
+/** well-known headers indexed by HtpTxHeaders */
+enum {
+    HTP_HDR_USER_AGENT = 0,
+    HTP_HDR_HOST,
+    HTP_HDR_COOKIE,         /**< Cookie in requests, Set-Cookie in responses */
+
+    /* must be last */
+    HTP_HDR_MAX,
+};
+
+/** Headers of one direction of a transaction as the detection engine
+ *  inspects them. Built once the headers are complete, then shared by
+ *  all inspections of the transaction. */
+typedef struct HtpTxHeaders_ {
+    /** "name: value\r\n" for each header except (Set-)Cookie, for
+     *  http_header. The (Set-)Cookie value is stored after it. */
+    uint8_t *buffer;
+    uint32_t buffer_len;    /**< length of the http_header part */
+    /** tx progress when built. Trailers add to the headers or to the
+     *  values of existing ones, so the headers are rebuilt when the
+     *  progress changes. */
+    uint8_t progress;
+    uint8_t built;
+
+    /** values of the well-known headers by HTP_HDR_*, pointing into
+     *  buffer. NULL if the header isn't present. */
+    uint8_t *value[HTP_HDR_MAX];
+    uint32_t value_len[HTP_HDR_MAX];
+} HtpTxHeaders;
+
 /** Now the Body Chunks will be stored per transaction, at
   * the tx user data */
 typedef struct HtpTxUserData_ {
@@ -201,12 +265,18 @@ typedef struct HtpTxUserData_ {
     uint32_t request_headers_raw_len;
     uint32_t response_headers_raw_len;
 
+    HtpTxHeaders request_hdrs;
+    HtpTxHeaders response_hdrs;
+
     /** Holds the boundary identificator string if any (used on
      *  multipart/form-data only)
      */
     uint8_t *boundary;
     uint8_t boundary_len;
 
+    /** multipart/form-data parser, set up by the first body chunk */
+    HtpMultipartState *multipart;
+
     uint8_t tsflags;
     uint8_t tcflags;
 
@@ -250,6 +320,7 @@ void HTPAtExitPrintStats(void);
 void HTPFreeConfig(void);
 
 htp_tx_t *HTPTransactionMain(const HtpState *);
+HtpTxHeaders *HTPTxGetHeaders(htp_tx_t *, uint8_t);
 
 int HTPCallbackRequestBodyData(htp_tx_data_t *);
 int HtpTransactionGetLoggableId(Flow *);
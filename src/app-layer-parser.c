@@ -45,6 +45,7 @@
 #include "app-layer.h"
 #include "app-layer-protos.h"
 #include "app-layer-parser.h"
+#include "app-layer-slab.h"
 #include "app-layer-smb.h"
 #include "app-layer-smb2.h"
 #include "app-layer-dcerpc.h"
@@ -73,8 +74,23 @@ AppLayerProto al_proto_table[ALPROTO_MAX];   /**< Application layer protocol
 static AppLayerParserTableElement al_parser_table[MAX_PARSERS];
 static uint16_t al_max_parsers = 0; /* incremented for every registered parser */
 
+#ifdef TLS
+/** Per thread cache of result elements. The field parsers get and return
+ *  the elements within a single AppLayerDoParse call, so the elements
+ *  never leave the thread and no lock is needed. */
+typedef struct AlpResultElmtCache_ {
+    AppLayerParserResultElmt *head;
+    uint32_t len;
+} AlpResultElmtCache;
+
+/** elements kept per thread, more are freed on return */
+#define ALP_RESULT_ELMT_CACHE_MAX 250
+
+static __thread AlpResultElmtCache al_result_cache = { NULL, 0 };
+#else
 static Pool *al_result_pool = NULL;
 static SCMutex al_result_pool_mutex = SCMUTEX_INITIALIZER;
+#endif /* TLS */
 #ifdef DEBUG
 static uint32_t al_result_pool_elmts = 0;
 #endif /* DEBUG */
@@ -230,6 +246,19 @@ static void AlpResultElmtPoolCleanup(void *e)
 
 static AppLayerParserResultElmt *AlpGetResultElmt(void)
 {
+#ifdef TLS
+    AppLayerParserResultElmt *e = al_result_cache.head;
+    if (e != NULL) {
+        al_result_cache.head = e->next;
+        al_result_cache.len--;
+    } else {
+        e = (AppLayerParserResultElmt *)AlpResultElmtPoolAlloc();
+        if (e == NULL) {
+            return NULL;
+        }
+        memset(e, 0x00, sizeof(*e));
+    }
+#else
     SCMutexLock(&al_result_pool_mutex);
     AppLayerParserResultElmt *e = (AppLayerParserResultElmt *)PoolGet(al_result_pool);
     SCMutexUnlock(&al_result_pool_mutex);
@@ -237,6 +266,7 @@ static AppLayerParserResultElmt *AlpGetResultElmt(void)
     if (e == NULL) {
         return NULL;
     }
+#endif /* TLS */
     e->next = NULL;
     return e;
 }
@@ -252,9 +282,41 @@ static void AlpReturnResultElmt(AppLayerParserResultElmt *e)
     e->data_len = 0;
     e->next = NULL;
 
+#ifdef TLS
+    if (al_result_cache.len >= ALP_RESULT_ELMT_CACHE_MAX) {
+        AlpResultElmtPoolCleanup(e);
+        SCFree(e);
+        return;
+    }
+    e->next = al_result_cache.head;
+    al_result_cache.head = e;
+    al_result_cache.len++;
+#else
     SCMutexLock(&al_result_pool_mutex);
     PoolReturn(al_result_pool, (void *)e);
     SCMutexUnlock(&al_result_pool_mutex);
+#endif /* TLS */
+}
+
+/**
+ *  \brief free the result elements and objects cached by the calling
+ *         thread, to be called when a thread that runs the app layer
+ *         parsers exits
+ */
+void AppLayerParserThreadCleanup(void)
+{
+    AppLayerSlabThreadCleanup();
+#ifdef TLS
+    AppLayerParserResultElmt *e = al_result_cache.head;
+    while (e != NULL) {
+        AppLayerParserResultElmt *next = e->next;
+        AlpResultElmtPoolCleanup(e);
+        SCFree(e);
+        e = next;
+    }
+    al_result_cache.head = NULL;
+    al_result_cache.len = 0;
+#endif /* TLS */
 }
 
 static void AlpAppendResultElmt(AppLayerParserResult *r, AppLayerParserResultElmt *e)
@@ -1152,10 +1214,16 @@ int AppLayerParse(void *local_data, Flow *f, uint8_t proto,
                         flags & STREAM_TOCLIENT ? 1 : 0);
                 StreamTcpSetSessionNoReassemblyFlag(ssn,
                         flags & STREAM_TOSERVER ? 1 : 0);
+
+                if (parser_state->flags & APP_LAYER_PARSER_BYPASS)
+                    StreamTcpSetSessionBypassFlag(ssn);
             }
         }
     }
 
+    if ((parser_state->flags & APP_LAYER_PARSER_NO_BYPASS) && ssn != NULL)
+        StreamTcpSetSessionNoBypassFlag(ssn);
+
     /* next, see if we can get rid of transactions now */
     AppLayerTransactionsCleanup(p, parser_state_store, app_layer_state);
 
@@ -1386,12 +1454,14 @@ void RegisterAppLayerParsers(void)
     memset(&al_proto_table, 0, sizeof(al_proto_table));
     memset(&al_parser_table, 0, sizeof(al_parser_table));
 
-    /** setup result pool
-     * \todo Per thread pool */
+#ifndef TLS
+    /** setup result pool, with TLS each thread caches its own elements */
     al_result_pool = PoolInit(1000, 250,
             sizeof(AppLayerParserResultElmt),
             AlpResultElmtPoolAlloc, NULL, NULL,
             AlpResultElmtPoolCleanup, NULL);
+#endif
+    AppLayerSlabInit();
 
     RegisterHTPParsers();
     RegisterSSLParsers();
@@ -2414,6 +2484,70 @@ void AppLayerParserRestoreAlprotoTable(void)
     return;
 }
 
+/**
+ * \test Test that result elements are reused from the thread's cache and
+ *       that the cache is bounded.
+ */
+static int AppLayerParserTest03(void)
+{
+    int result = 0;
+    uint32_t i;
+    AppLayerParserResult r = { NULL, NULL, 0 };
+
+    AppLayerParserThreadCleanup();
+
+    uint8_t *data = SCMalloc(4);
+    if (data == NULL)
+        goto end;
+    if (AlpStoreField(&r, 1, data, 4, 1) != 0 ||
+        AlpStoreField(&r, 2, (uint8_t *)"abc", 3, 0) != 0) {
+        printf("storing fields failed: ");
+        goto end;
+    }
+    /* elements go back in list order, so the last one is on top */
+    AppLayerParserResultElmt *last = r.tail;
+    AppLayerParserResultCleanup(&r);
+    if (r.head != NULL || r.cnt != 0) {
+        printf("result not cleaned up: ");
+        goto end;
+    }
+
+#ifdef TLS
+    if (al_result_cache.len != 2) {
+        printf("cache len %u, expected 2: ", al_result_cache.len);
+        goto end;
+    }
+
+    /* the element comes back clean */
+    AppLayerParserResultElmt *e = AlpGetResultElmt();
+    if (e == NULL || e != last || e->flags != 0 || e->data_ptr != NULL) {
+        printf("element not reused: ");
+        goto end;
+    }
+    AlpReturnResultElmt(e);
+
+    for (i = 0; i < ALP_RESULT_ELMT_CACHE_MAX + 10; i++) {
+        if (AlpStoreField(&r, 1, (uint8_t *)"abc", 3, 0) != 0)
+            goto end;
+    }
+    AppLayerParserResultCleanup(&r);
+    if (al_result_cache.len != ALP_RESULT_ELMT_CACHE_MAX) {
+        printf("cache len %u, expected %u: ", al_result_cache.len,
+                ALP_RESULT_ELMT_CACHE_MAX);
+        goto end;
+    }
+#else
+    (void)last;
+    (void)i;
+#endif /* TLS */
+
+    result = 1;
+end:
+    AppLayerParserResultCleanup(&r);
+    AppLayerParserThreadCleanup();
+    return result;
+}
+
 /**
  * \test Test the deallocation of app layer parser memory on occurance of
  *       error in the parsing process.
@@ -3036,6 +3170,7 @@ void AppLayerParserRegisterTests(void)
 
     UtRegisterTest("AppLayerParserTest01", AppLayerParserTest01, 1);
     UtRegisterTest("AppLayerParserTest02", AppLayerParserTest02, 1);
+    UtRegisterTest("AppLayerParserTest03", AppLayerParserTest03, 1);
     UtRegisterTest("AppLayerProbingParserTest01",
                    AppLayerProbingParserTest01, 1);
 #endif /* UNITTESTS */
@@ -113,6 +113,12 @@ typedef struct AppLayerParserResult_ {
 #define APP_LAYER_PARSER_NO_REASSEMBLY  0x10    /**< Flag to indicate no more
                                                      packets reassembly for this
                                                      session */
+#define APP_LAYER_PARSER_BYPASS         0x20    /**< Flag to indicate the rest
+                                                     of the session is bypassed,
+                                                     set with NO_REASSEMBLY */
+#define APP_LAYER_PARSER_NO_BYPASS      0x40    /**< Flag to indicate rules need
+                                                     the rest of the session, it
+                                                     must not be bypassed */
 
 #define APP_LAYER_TRANSACTION_EOF       0x01    /**< Session done, last transaction
                                                      as well */
@@ -235,6 +241,7 @@ struct AlpProtoDetectCtx_;
 /* prototypes */
 void AppLayerParsersInitPostProcess(void);
 void RegisterAppLayerParsers(void);
+void AppLayerParserThreadCleanup(void);
 void AppLayerParserRegisterTests(void);
 
 /* registration */
@@ -0,0 +1,580 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Allocator for the small objects of the app layer parsers: the per flow
+ * states and the transactions.
+ *
+ * Objects up to APP_LAYER_SLAB_MAX_SIZE are rounded up to a power of two
+ * size class. Freed objects are kept in a per thread list per class and
+ * handed out again by the next allocation of that class on the thread, so
+ * under connection churn most allocations don't hit malloc. Each list is
+ * bounded, beyond that objects are freed.
+ *
+ * Objects may be freed on another thread than the one that allocated them,
+ * e.g. by the flow manager on timeout. Each object has a header pointing
+ * to the cache of the allocating thread, and such frees are pushed lock
+ * free onto a return list of that cache. The owner takes the whole return
+ * list when its own list of the class runs empty, so the objects go back
+ * to the thread that keeps allocating them instead of piling up on the
+ * freeing thread.
+ *
+ * The caches are never freed while the engine runs, as objects may still
+ * point to them. The cache of an exited thread is handed to the next new
+ * thread.
+ *
+ * All objects handed out are counted against app-layer.memcap.
+ */
+
+#include "suricata-common.h"
+#include "conf.h"
+
+#include "app-layer-slab.h"
+
+#include "util-atomic.h"
+#include "util-debug.h"
+#include "util-misc.h"
+#include "util-unittest.h"
+
+#ifdef TLS
+typedef struct AppLayerSlabObj_ {
+    struct AppLayerSlabObj_ *next;
+} AppLayerSlabObj;
+
+typedef struct AppLayerSlabCache_ {
+    /** objects freed by the owner thread, only used by the owner */
+    AppLayerSlabObj *head[APP_LAYER_SLAB_CLASSES];
+    uint32_t len[APP_LAYER_SLAB_CLASSES];
+
+    /** objects freed by other threads. Pushed by them, taken all at once
+     *  by the owner. As only the owner takes, and always takes all, the
+     *  pushes don't suffer from ABA. */
+    AppLayerSlabObj *returned[APP_LAYER_SLAB_CLASSES];
+    uint32_t returned_len[APP_LAYER_SLAB_CLASSES];
+
+    /** owner thread exited, protected by al_slab_caches_m */
+    int orphan;
+    struct AppLayerSlabCache_ *next;
+} AppLayerSlabCache;
+
+/** header in front of the objects of the size classes */
+typedef union AppLayerSlabHdr_ {
+    AppLayerSlabCache *owner;   /**< cache of the allocating thread */
+    uint64_t pad[2];            /**< keep the objects 16 byte aligned */
+} AppLayerSlabHdr;
+
+#define APP_LAYER_SLAB_HDR(ptr) ((AppLayerSlabHdr *)(ptr) - 1)
+
+static __thread AppLayerSlabCache *al_slab_cache = NULL;
+
+/** all caches, for reuse by new threads and for the final cleanup */
+static AppLayerSlabCache *al_slab_caches = NULL;
+static SCMutex al_slab_caches_m = SCMUTEX_INITIALIZER;
+#endif /* TLS */
+
+/** 0 means no limit */
+static uint64_t app_layer_memcap = 0;
+
+SC_ATOMIC_DECLARE(uint64_t, app_layer_memuse);
+SC_ATOMIC_DECLARE(uint64_t, app_layer_memcap_cnt);
+/** objects of the size classes that had to be malloc'd */
+SC_ATOMIC_DECLARE(uint64_t, app_layer_slab_malloc_cnt);
+/** objects freed on another thread and returned to their owner */
+SC_ATOMIC_DECLARE(uint64_t, app_layer_slab_returned_cnt);
+
+/**
+ *  \brief set up the memcap from the app-layer.memcap config
+ */
+void AppLayerSlabInit(void)
+{
+    SC_ATOMIC_INIT(app_layer_memuse);
+    SC_ATOMIC_INIT(app_layer_memcap_cnt);
+    SC_ATOMIC_INIT(app_layer_slab_malloc_cnt);
+    SC_ATOMIC_INIT(app_layer_slab_returned_cnt);
+
+    char *conf_val;
+    if ((ConfGet("app-layer.memcap", &conf_val)) == 1)
+    {
+        if (ParseSizeStringU64(conf_val, &app_layer_memcap) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing app-layer.memcap "
+                       "from conf file - %s.  Killing engine",
+                       conf_val);
+            exit(EXIT_FAILURE);
+        }
+        SCLogInfo("app-layer \"memcap\": %"PRIu64, app_layer_memcap);
+    }
+}
+
+#ifdef TLS
+/** \internal
+ *  \brief take all objects other threads returned to a cache
+ *
+ *  \retval list of objects, linked by next
+ */
+static AppLayerSlabObj *AppLayerSlabCacheTakeReturned(AppLayerSlabCache *cache,
+        int c, uint32_t *cnt)
+{
+    AppLayerSlabObj *list;
+
+    do {
+        list = cache->returned[c];
+    } while (list != NULL && SCAtomicCompareAndSwap(&cache->returned[c], list, NULL) == 0);
+
+    uint32_t n = 0;
+    AppLayerSlabObj *o;
+    for (o = list; o != NULL; o = o->next)
+        n++;
+    if (n > 0)
+        (void) SCAtomicSubAndFetch(&cache->returned_len[c], n);
+
+    *cnt = n;
+    return list;
+}
+
+/** \internal
+ *  \brief free all objects of a cache */
+static void AppLayerSlabCacheFlush(AppLayerSlabCache *cache)
+{
+    int c;
+    for (c = 0; c < APP_LAYER_SLAB_CLASSES; c++) {
+        uint32_t cnt;
+        AppLayerSlabObj *lists[2] = { cache->head[c],
+            AppLayerSlabCacheTakeReturned(cache, c, &cnt) };
+        int l;
+        for (l = 0; l < 2; l++) {
+            AppLayerSlabObj *o = lists[l];
+            while (o != NULL) {
+                AppLayerSlabObj *next = o->next;
+                SCFree(APP_LAYER_SLAB_HDR(o));
+                o = next;
+            }
+        }
+        cache->head[c] = NULL;
+        cache->len[c] = 0;
+    }
+}
+
+/** \internal
+ *  \brief get the cache of the calling thread, setting it up if needed
+ *
+ *  \retval cache or NULL if it can't be allocated
+ */
+static AppLayerSlabCache *AppLayerSlabThreadCache(void)
+{
+    AppLayerSlabCache *cache = al_slab_cache;
+    if (likely(cache != NULL))
+        return cache;
+
+    SCMutexLock(&al_slab_caches_m);
+    for (cache = al_slab_caches; cache != NULL; cache = cache->next) {
+        if (cache->orphan) {
+            cache->orphan = 0;
+            break;
+        }
+    }
+    if (cache == NULL) {
+        cache = SCMalloc(sizeof(AppLayerSlabCache));
+        if (likely(cache != NULL)) {
+            memset(cache, 0x00, sizeof(AppLayerSlabCache));
+            cache->next = al_slab_caches;
+            al_slab_caches = cache;
+        }
+    }
+    SCMutexUnlock(&al_slab_caches_m);
+
+    al_slab_cache = cache;
+    return cache;
+}
+
+/** \internal
+ *  \brief hand an object freed by another thread back to its owner
+ *
+ *  \retval 1 returned
+ *  \retval 0 the return list is full, the caller frees the object
+ */
+static int AppLayerSlabReturn(AppLayerSlabCache *owner, int c, AppLayerSlabObj *o)
+{
+    if (SCAtomicAddAndFetch(&owner->returned_len[c], 1) > APP_LAYER_SLAB_CACHE_MAX) {
+        (void) SCAtomicSubAndFetch(&owner->returned_len[c], 1);
+        return 0;
+    }
+
+    AppLayerSlabObj *head;
+    do {
+        head = owner->returned[c];
+        o->next = head;
+    } while (SCAtomicCompareAndSwap(&owner->returned[c], head, o) == 0);
+
+    (void) SC_ATOMIC_ADD(app_layer_slab_returned_cnt, 1);
+    return 1;
+}
+#endif /* TLS */
+
+void AppLayerSlabDestroy(void)
+{
+    SCLogInfo("app-layer memuse %"PRIu64", memcap reached %"PRIu64" times, "
+            "%"PRIu64" objects malloc'd, %"PRIu64" returned to their thread",
+            SC_ATOMIC_GET(app_layer_memuse),
+            SC_ATOMIC_GET(app_layer_memcap_cnt),
+            SC_ATOMIC_GET(app_layer_slab_malloc_cnt),
+            SC_ATOMIC_GET(app_layer_slab_returned_cnt));
+
+    AppLayerSlabThreadCleanup();
+#ifdef TLS
+    /* all threads are gone, and so are the objects pointing to the caches */
+    SCMutexLock(&al_slab_caches_m);
+    AppLayerSlabCache *cache = al_slab_caches;
+    while (cache != NULL) {
+        AppLayerSlabCache *next = cache->next;
+        AppLayerSlabCacheFlush(cache);
+        SCFree(cache);
+        cache = next;
+    }
+    al_slab_caches = NULL;
+    SCMutexUnlock(&al_slab_caches_m);
+#endif /* TLS */
+}
+
+/**
+ *  \brief free the objects cached by the calling thread, to be called when
+ *         a thread that runs or frees app layer states exits
+ */
+void AppLayerSlabThreadCleanup(void)
+{
+#ifdef TLS
+    AppLayerSlabCache *cache = al_slab_cache;
+    if (cache == NULL)
+        return;
+
+    al_slab_cache = NULL;
+    AppLayerSlabCacheFlush(cache);
+
+    /* other threads may still return objects to it, so keep it for the
+     * next thread */
+    SCMutexLock(&al_slab_caches_m);
+    cache->orphan = 1;
+    SCMutexUnlock(&al_slab_caches_m);
+#endif /* TLS */
+}
+
+/** \internal
+ *  \brief get the size class of an object
+ *
+ *  \retval class or -1 if the object is too big for the slab caches
+ */
+static inline int AppLayerSlabClass(size_t size)
+{
+    if (size > APP_LAYER_SLAB_MAX_SIZE)
+        return -1;
+
+    int c = 0;
+    size_t csize = 1 << APP_LAYER_SLAB_MIN_SHIFT;
+    while (csize < size) {
+        csize <<= 1;
+        c++;
+    }
+    return c;
+}
+
+/**
+ *  \brief allocate an app layer object
+ *
+ *  \param size object size
+ *
+ *  \retval ptr uninitialized object or NULL on memcap or alloc failure
+ */
+void *AppLayerSlabAlloc(size_t size)
+{
+    int c = AppLayerSlabClass(size);
+    size_t asize = (c >= 0) ? ((size_t)1 << (APP_LAYER_SLAB_MIN_SHIFT + c)) : size;
+
+    if (app_layer_memcap != 0 &&
+            SC_ATOMIC_GET(app_layer_memuse) + asize > app_layer_memcap) {
+        (void) SC_ATOMIC_ADD(app_layer_memcap_cnt, 1);
+        return NULL;
+    }
+
+    void *ptr = NULL;
+#ifdef TLS
+    if (c >= 0) {
+        AppLayerSlabCache *cache = AppLayerSlabThreadCache();
+        if (cache != NULL && cache->head[c] == NULL && cache->returned[c] != NULL) {
+            uint32_t cnt;
+            cache->head[c] = AppLayerSlabCacheTakeReturned(cache, c, &cnt);
+            cache->len[c] = cnt;
+        }
+        if (cache != NULL && cache->head[c] != NULL) {
+            AppLayerSlabObj *o = cache->head[c];
+            cache->head[c] = o->next;
+            cache->len[c]--;
+            ptr = o;
+        } else {
+            AppLayerSlabHdr *hdr = SCMalloc(sizeof(AppLayerSlabHdr) + asize);
+            if (unlikely(hdr == NULL))
+                return NULL;
+            hdr->owner = cache;
+            ptr = hdr + 1;
+            (void) SC_ATOMIC_ADD(app_layer_slab_malloc_cnt, 1);
+        }
+    }
+#endif /* TLS */
+    if (ptr == NULL) {
+        ptr = SCMalloc(asize);
+        if (unlikely(ptr == NULL))
+            return NULL;
+    }
+
+    (void) SC_ATOMIC_ADD(app_layer_memuse, asize);
+    return ptr;
+}
+
+/**
+ *  \brief free an app layer object
+ *
+ *  \param ptr object from AppLayerSlabAlloc, may be NULL
+ *  \param size size that was passed to AppLayerSlabAlloc
+ */
+void AppLayerSlabFree(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        return;
+
+    int c = AppLayerSlabClass(size);
+    size_t asize = (c >= 0) ? ((size_t)1 << (APP_LAYER_SLAB_MIN_SHIFT + c)) : size;
+    (void) SC_ATOMIC_SUB(app_layer_memuse, asize);
+
+#ifdef TLS
+    if (c >= 0) {
+        AppLayerSlabHdr *hdr = APP_LAYER_SLAB_HDR(ptr);
+        AppLayerSlabCache *owner = hdr->owner;
+        AppLayerSlabObj *o = (AppLayerSlabObj *)ptr;
+
+        if (owner != NULL && owner == al_slab_cache) {
+            if (owner->len[c] < APP_LAYER_SLAB_CACHE_MAX) {
+                o->next = owner->head[c];
+                owner->head[c] = o;
+                owner->len[c]++;
+                return;
+            }
+        } else if (owner != NULL) {
+            if (AppLayerSlabReturn(owner, c, o) == 1)
+                return;
+        }
+        SCFree(hdr);
+        return;
+    }
+#endif /* TLS */
+    SCFree(ptr);
+}
+
+uint64_t AppLayerSlabMemuse(void)
+{
+    return SC_ATOMIC_GET(app_layer_memuse);
+}
+
+#ifdef UNITTESTS
+
+/**
+ *  \test size classes and memuse accounting
+ */
+static int AppLayerSlabTest01(void)
+{
+    if (AppLayerSlabClass(1) != 0 || AppLayerSlabClass(32) != 0 ||
+            AppLayerSlabClass(33) != 1 || AppLayerSlabClass(72) != 2 ||
+            AppLayerSlabClass(512) != 4 || AppLayerSlabClass(513) != -1) {
+        printf("bad size class: ");
+        return 0;
+    }
+
+    uint64_t memuse = AppLayerSlabMemuse();
+    void *p1 = AppLayerSlabAlloc(72);
+    void *p2 = AppLayerSlabAlloc(1000);
+    if (p1 == NULL || p2 == NULL) {
+        AppLayerSlabFree(p1, 72);
+        AppLayerSlabFree(p2, 1000);
+        return 0;
+    }
+    memset(p1, 0xff, 72);
+    memset(p2, 0xff, 1000);
+
+    if (AppLayerSlabMemuse() != memuse + 128 + 1000) {
+        printf("memuse %"PRIu64" != %"PRIu64": ", AppLayerSlabMemuse(),
+                memuse + 128 + 1000);
+        AppLayerSlabFree(p1, 72);
+        AppLayerSlabFree(p2, 1000);
+        return 0;
+    }
+
+    AppLayerSlabFree(p1, 72);
+    AppLayerSlabFree(p2, 1000);
+    if (AppLayerSlabMemuse() != memuse) {
+        printf("memuse %"PRIu64" != %"PRIu64" after free: ",
+                AppLayerSlabMemuse(), memuse);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ *  \test freed objects are reused by the next alloc of the same class and
+ *        the memcap is enforced
+ */
+static int AppLayerSlabTest02(void)
+{
+    int result = 0;
+    uint64_t saved_memcap = app_layer_memcap;
+
+    void *p1 = AppLayerSlabAlloc(100);
+    if (p1 == NULL)
+        goto end;
+    AppLayerSlabFree(p1, 100);
+
+    /* same class: 128 */
+    void *p2 = AppLayerSlabAlloc(120);
+#ifdef TLS
+    if (p2 != p1) {
+        printf("cached object not reused: ");
+        AppLayerSlabFree(p2, 120);
+        goto end;
+    }
+#endif
+    AppLayerSlabFree(p2, 120);
+
+    app_layer_memcap = AppLayerSlabMemuse() + 64;
+    void *p3 = AppLayerSlabAlloc(64);
+    void *p4 = AppLayerSlabAlloc(64);
+    if (p3 == NULL || p4 != NULL) {
+        printf("memcap not enforced: ");
+        AppLayerSlabFree(p3, 64);
+        AppLayerSlabFree(p4, 64);
+        goto end;
+    }
+    AppLayerSlabFree(p3, 64);
+
+    result = 1;
+end:
+    app_layer_memcap = saved_memcap;
+    return result;
+}
+
+#ifdef TLS
+#define APP_LAYER_SLAB_TEST_OBJS 16
+
+typedef struct AppLayerSlabTestCtx_ {
+    void *objs[APP_LAYER_SLAB_TEST_OBJS];
+    int result;
+} AppLayerSlabTestCtx;
+
+static void *AppLayerSlabTestFreeThread(void *arg)
+{
+    AppLayerSlabTestCtx *ctx = (AppLayerSlabTestCtx *)arg;
+    int i;
+
+    for (i = 0; i < APP_LAYER_SLAB_TEST_OBJS; i++)
+        AppLayerSlabFree(ctx->objs[i], 100);
+    AppLayerSlabThreadCleanup();
+    return NULL;
+}
+
+/* allocs the objects, has another thread free them and checks they come
+ * back to this thread */
+static void *AppLayerSlabTestOwnerThread(void *arg)
+{
+    AppLayerSlabTestCtx *ctx = (AppLayerSlabTestCtx *)arg;
+    void *objs[APP_LAYER_SLAB_TEST_OBJS];
+    pthread_t t;
+    int i, j;
+
+    memset(objs, 0x00, sizeof(objs));
+    for (i = 0; i < APP_LAYER_SLAB_TEST_OBJS; i++) {
+        ctx->objs[i] = AppLayerSlabAlloc(100);
+        if (ctx->objs[i] == NULL)
+            goto end;
+    }
+
+    uint64_t returned = SC_ATOMIC_GET(app_layer_slab_returned_cnt);
+    if (pthread_create(&t, NULL, AppLayerSlabTestFreeThread, ctx) != 0)
+        goto end;
+    pthread_join(t, NULL);
+
+    if (SC_ATOMIC_GET(app_layer_slab_returned_cnt) != returned + APP_LAYER_SLAB_TEST_OBJS) {
+        printf("%"PRIu64" objects returned, expected %d: ",
+                SC_ATOMIC_GET(app_layer_slab_returned_cnt) - returned,
+                APP_LAYER_SLAB_TEST_OBJS);
+        goto end;
+    }
+
+    /* the returned objects are reused, no mallocs */
+    uint64_t mallocs = SC_ATOMIC_GET(app_layer_slab_malloc_cnt);
+    for (i = 0; i < APP_LAYER_SLAB_TEST_OBJS; i++) {
+        objs[i] = AppLayerSlabAlloc(100);
+        for (j = 0; j < APP_LAYER_SLAB_TEST_OBJS; j++) {
+            if (objs[i] == ctx->objs[j])
+                break;
+        }
+        if (j == APP_LAYER_SLAB_TEST_OBJS) {
+            printf("object %d is not one of the returned ones: ", i);
+            goto end;
+        }
+    }
+    if (SC_ATOMIC_GET(app_layer_slab_malloc_cnt) != mallocs) {
+        printf("%"PRIu64" mallocs, expected none: ",
+                SC_ATOMIC_GET(app_layer_slab_malloc_cnt) - mallocs);
+        goto end;
+    }
+
+    ctx->result = 1;
+end:
+    for (i = 0; i < APP_LAYER_SLAB_TEST_OBJS; i++)
+        AppLayerSlabFree(objs[i], 100);
+    AppLayerSlabThreadCleanup();
+    return NULL;
+}
+#endif /* TLS */
+
+/**
+ *  \test objects freed on another thread go back to the thread that
+ *        allocated them
+ */
+static int AppLayerSlabTest03(void)
+{
+#ifdef TLS
+    AppLayerSlabTestCtx ctx;
+    pthread_t t;
+
+    memset(&ctx, 0x00, sizeof(ctx));
+    if (pthread_create(&t, NULL, AppLayerSlabTestOwnerThread, &ctx) != 0)
+        return 0;
+    pthread_join(t, NULL);
+    return ctx.result;
+#else
+    return 1;
+#endif /* TLS */
+}
+
+#endif /* UNITTESTS */
+
+void AppLayerSlabRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("AppLayerSlabTest01", AppLayerSlabTest01, 1);
+    UtRegisterTest("AppLayerSlabTest02", AppLayerSlabTest02, 1);
+    UtRegisterTest("AppLayerSlabTest03", AppLayerSlabTest03, 1);
+#endif /* UNITTESTS */
+}
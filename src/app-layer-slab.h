@@ -0,0 +1,41 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __APP_LAYER_SLAB_H__
+#define __APP_LAYER_SLAB_H__
+
+/** size classes of the slab caches: 32, 64, ... 512 bytes. Larger objects
+ *  are allocated directly. */
+#define APP_LAYER_SLAB_MIN_SHIFT    5
+#define APP_LAYER_SLAB_CLASSES      5
+#define APP_LAYER_SLAB_MAX_SIZE     (1 << (APP_LAYER_SLAB_MIN_SHIFT + APP_LAYER_SLAB_CLASSES - 1))
+
+/** objects cached per size class per thread, more are freed */
+#define APP_LAYER_SLAB_CACHE_MAX    1024
+
+void AppLayerSlabInit(void);
+void AppLayerSlabDestroy(void);
+void AppLayerSlabThreadCleanup(void);
+
+void *AppLayerSlabAlloc(size_t);
+void AppLayerSlabFree(void *, size_t);
+
+uint64_t AppLayerSlabMemuse(void);
+
+void AppLayerSlabRegisterTests(void);
+
+#endif /* __APP_LAYER_SLAB_H__ */
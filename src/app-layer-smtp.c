@@ -35,6 +35,7 @@
 #include "app-layer-protos.h"
 #include "app-layer-parser.h"
 #include "app-layer-smtp.h"
+#include "app-layer-slab.h"
 
 #include "util-debug.h"
 #include "util-byte.h"
@@ -42,6 +43,9 @@
 #include "util-byte.h"
 #include "util-unittest-helper.h"
 #include "util-memcmp.h"
+#include "util-misc.h"
+#include "util-file.h"
+#include "util-decode-mime.h"
 #include "flow-util.h"
 
 #include "detect-engine.h"
@@ -110,11 +114,24 @@ SCEnumCharMap smtp_decoder_event_table[ ] = {
       SMTP_DECODER_EVENT_TLS_REJECTED },
     { "DATA_COMMAND_REJECTED",
       SMTP_DECODER_EVENT_DATA_COMMAND_REJECTED },
+
+    /* MIME events */
+    { "MIME_INVALID_BASE64",
+      SMTP_DECODER_EVENT_MIME_INVALID_BASE64 },
+    { "MIME_INVALID_QP",
+      SMTP_DECODER_EVENT_MIME_INVALID_QP },
+    { "MIME_LONG_HEADER",
+      SMTP_DECODER_EVENT_MIME_LONG_HEADER },
+    { "MIME_TOO_DEEP",
+      SMTP_DECODER_EVENT_MIME_TOO_DEEP },
     { NULL,                      -1 },
 };
 
 #define SMTP_MPM DEFAULT_MPM
 
+/** decode the mails after DATA and extract attachments */
+static int smtp_decode_mime = 1;
+
 static MpmCtx *smtp_mpm_ctx = NULL;
 MpmThreadCtx *smtp_mpm_thread_ctx;
 
@@ -454,6 +471,89 @@ static int SMTPProcessCommandBDAT(SMTPState *state, Flow *f,
     SCReturnInt(0);
 }
 
+/**
+ * \internal
+ * \brief Turn the anomalies the MIME parser found into decoder events.
+ */
+static void SMTPSetMimeEvents(SMTPState *state, Flow *f)
+{
+    MimeDecParseState *mds = state->mime_state;
+
+    if (mds->anomalies == 0)
+        return;
+
+    if (mds->anomalies & MIME_DEC_ANOM_INVALID_BASE64)
+        AppLayerDecoderEventsSetEvent(f, SMTP_DECODER_EVENT_MIME_INVALID_BASE64);
+    if (mds->anomalies & MIME_DEC_ANOM_INVALID_QP)
+        AppLayerDecoderEventsSetEvent(f, SMTP_DECODER_EVENT_MIME_INVALID_QP);
+    if (mds->anomalies & MIME_DEC_ANOM_LONG_HEADER)
+        AppLayerDecoderEventsSetEvent(f, SMTP_DECODER_EVENT_MIME_LONG_HEADER);
+    if (mds->anomalies & MIME_DEC_ANOM_TOO_DEEP)
+        AppLayerDecoderEventsSetEvent(f, SMTP_DECODER_EVENT_MIME_TOO_DEEP);
+
+    mds->anomalies = 0;
+}
+
+/**
+ * \internal
+ * \brief Start the tx of the next mail.
+ *
+ * \retval tx the new tx, or NULL on alloc failure
+ */
+static SMTPTransaction *SMTPTransactionNew(SMTPState *state)
+{
+    SMTPTransaction *tx = AppLayerSlabAlloc(sizeof(SMTPTransaction));
+    if (unlikely(tx == NULL))
+        return NULL;
+    memset(tx, 0, sizeof(SMTPTransaction));
+
+    tx->tx_id = state->tx_cnt++;
+    TAILQ_INSERT_TAIL(&state->tx_list, tx, next);
+    state->curr_tx = tx;
+
+    return tx;
+}
+
+/**
+ * \internal
+ * \brief Pass a line of the mail to the MIME parser, which extracts the
+ *        attachments into the file container of the state.
+ */
+static void SMTPProcessMimeLine(SMTPState *state, Flow *f)
+{
+    uint8_t *line = state->current_line;
+    uint32_t line_len = state->current_line_len;
+
+    if (state->curr_tx == NULL)
+        return;
+    if (state->files_ts == NULL) {
+        state->files_ts = FileContainerAlloc();
+        if (state->files_ts == NULL)
+            return;
+    }
+    if (state->mime_state == NULL) {
+        state->mime_state = MimeDecInitParser(f, state->files_ts,
+                state->curr_tx->tx_id, &state->mime_decoded);
+        if (state->mime_state == NULL)
+            return;
+    }
+
+    /* undo the dot stuffing, rfc 5321 4.5.2 */
+    if (line_len > 0 && line[0] == '.') {
+        line++;
+        line_len--;
+    }
+
+    MimeDecParseLine(state->mime_state, line, line_len);
+    SMTPSetMimeEvents(state, f);
+
+    /* let the detection engine inspect the new attachment */
+    if (state->mime_state->flags & MIME_DEC_FILE_NEW) {
+        state->mime_state->flags &= ~MIME_DEC_FILE_NEW;
+        state->flags |= SMTP_FLAG_NEW_FILE_TX_TS;
+    }
+}
+
 static int SMTPProcessCommandDATA(SMTPState *state, Flow *f,
                                   AppLayerParserState *pstate)
 {
@@ -471,6 +571,20 @@ static int SMTPProcessCommandDATA(SMTPState *state, Flow *f,
          * the command buffer to be used by the reply handler to match
          * the reply received */
         SMTPInsertCommandIntoCommandBuffer(SMTP_COMMAND_DATA_MODE, state, f);
+
+        if (state->mime_state != NULL) {
+            MimeDecParseComplete(state->mime_state);
+            SMTPSetMimeEvents(state, f);
+            MimeDecDeInitParser(state->mime_state);
+            state->mime_state = NULL;
+        }
+        /* the mail is complete, the tx of the next one is opened when
+         * more data comes in */
+        if (state->curr_tx != NULL)
+            state->curr_tx->done = 1;
+        state->curr_tx = NULL;
+    } else if (smtp_decode_mime) {
+        SMTPProcessMimeLine(state, f);
     }
 
     return 0;
@@ -689,6 +803,11 @@ static int SMTPParse(int direction, Flow *f, SMTPState *state,
     state->direction = direction;
     state->thread_local_data = local_data;
 
+    /* open the tx of the next mail. The detection engine only inspects
+     * the state while a tx is in progress. */
+    if (state->curr_tx == NULL)
+        SMTPTransactionNew(state);
+
     /* toserver */
     if (direction == 0) {
         while (SMTPGetLine(state) >= 0) {
@@ -739,7 +858,7 @@ static int SMTPParseServerRecord(Flow *f, void *alstate,
  */
 static void *SMTPStateAlloc(void)
 {
-    SMTPState *smtp_state = SCMalloc(sizeof(SMTPState));
+    SMTPState *smtp_state = AppLayerSlabAlloc(sizeof(SMTPState));
     if (unlikely(smtp_state == NULL))
         return NULL;
     memset(smtp_state, 0, sizeof(SMTPState));
@@ -747,11 +866,13 @@ static void *SMTPStateAlloc(void)
     smtp_state->cmds = SCMalloc(sizeof(uint8_t) *
                                 SMTP_COMMAND_BUFFER_STEPS);
     if (smtp_state->cmds == NULL) {
-        SCFree(smtp_state);
+        AppLayerSlabFree(smtp_state, sizeof(SMTPState));
         return NULL;
     }
     smtp_state->cmds_buffer_len = SMTP_COMMAND_BUFFER_STEPS;
 
+    TAILQ_INIT(&smtp_state->tx_list);
+
     return smtp_state;
 }
 
@@ -795,8 +916,20 @@ static void SMTPStateFree(void *p)
     if (smtp_state->tc_current_line_db) {
         SCFree(smtp_state->tc_db);
     }
+    if (smtp_state->mime_state != NULL) {
+        MimeDecDeInitParser(smtp_state->mime_state);
+    }
+    if (smtp_state->files_ts != NULL) {
+        FileContainerFree(smtp_state->files_ts);
+    }
+
+    SMTPTransaction *tx;
+    while ((tx = TAILQ_FIRST(&smtp_state->tx_list)) != NULL) {
+        TAILQ_REMOVE(&smtp_state->tx_list, tx, next);
+        AppLayerSlabFree(tx, sizeof(SMTPTransaction));
+    }
 
-    SCFree(smtp_state);
+    AppLayerSlabFree(smtp_state, sizeof(SMTPState));
 
     return;
 }
@@ -834,6 +967,132 @@ static void SMTPSetMpmState(void)
     mpm_table[SMTP_MPM].Prepare(smtp_mpm_ctx);
 }
 
+/** \internal
+ *  \brief get files callback
+ *  \param state state ptr
+ *  \param direction flow direction
+ *  \retval files files ptr, only mails to the server carry files
+ */
+static FileContainer *SMTPStateGetFiles(void *state, uint8_t direction)
+{
+    if (state == NULL)
+        return NULL;
+
+    SMTPState *smtp_state = (SMTPState *)state;
+
+    if (direction & STREAM_TOCLIENT)
+        return NULL;
+    return smtp_state->files_ts;
+}
+
+/**
+ * \internal
+ * \brief Free the tx with id tx_id. The tx of the mail in progress is
+ *        never freed here.
+ */
+static void SMTPStateTransactionFree(void *state, uint64_t tx_id)
+{
+    SMTPState *smtp_state = (SMTPState *)state;
+    SMTPTransaction *tx = NULL;
+
+    TAILQ_FOREACH(tx, &smtp_state->tx_list, next) {
+        if (tx->tx_id < tx_id)
+            continue;
+        if (tx->tx_id > tx_id || tx == smtp_state->curr_tx)
+            break;
+
+        TAILQ_REMOVE(&smtp_state->tx_list, tx, next);
+        AppLayerSlabFree(tx, sizeof(SMTPTransaction));
+        break;
+    }
+}
+
+static void *SMTPGetTx(void *state, uint64_t tx_id)
+{
+    SMTPState *smtp_state = (SMTPState *)state;
+    SMTPTransaction *tx = NULL;
+
+    if (smtp_state->curr_tx != NULL && smtp_state->curr_tx->tx_id == tx_id)
+        return smtp_state->curr_tx;
+
+    TAILQ_FOREACH(tx, &smtp_state->tx_list, next) {
+        if (tx->tx_id == tx_id)
+            return tx;
+    }
+
+    return NULL;
+}
+
+static uint64_t SMTPGetTxCnt(void *state)
+{
+    return ((SMTPState *)state)->tx_cnt;
+}
+
+/** a mail is complete in both directions once its end has been seen */
+static int SMTPGetAlstateProgress(void *tx, uint8_t direction)
+{
+    return ((SMTPTransaction *)tx)->done;
+}
+
+static int SMTPGetAlstateProgressCompletionStatus(uint8_t direction)
+{
+    return 1;
+}
+
+/**
+ * \internal
+ * \brief Read the MIME decoding settings from the config.
+ */
+static void SMTPConfigure(void)
+{
+    MimeDecConfig config = *MimeDecGetConfig();
+    int val;
+    char *str;
+
+    ConfNode *node = ConfGetNode("app-layer.protocols.smtp.mime");
+    if (node == NULL)
+        return;
+
+    if (ConfGetChildValueBool(node, "decode-mime", &val) == 1)
+        smtp_decode_mime = val;
+    if (ConfGetChildValueBool(node, "decode-base64", &val) == 1)
+        config.decode_base64 = val;
+    if (ConfGetChildValueBool(node, "decode-quoted-printable", &val) == 1)
+        config.decode_quoted_printable = val;
+
+    if (ConfGetChildValue(node, "decode-depth", &str) == 1) {
+        if (ParseSizeStringU32(str, &config.decode_depth) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
+                    "app-layer.protocols.smtp.mime.decode-depth "
+                    "from conf file - %s.  Killing engine", str);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (ConfGetChildValue(node, "flow-decode-depth", &str) == 1) {
+        if (ParseSizeStringU64(str, &config.flow_depth) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
+                    "app-layer.protocols.smtp.mime.flow-decode-depth "
+                    "from conf file - %s.  Killing engine", str);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (ConfGetChildValue(node, "header-value-depth", &str) == 1) {
+        if (ParseSizeStringU32(str, &config.header_depth) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
+                    "app-layer.protocols.smtp.mime.header-value-depth "
+                    "from conf file - %s.  Killing engine", str);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    MimeDecSetConfig(&config);
+
+    SCLogInfo("smtp mime decoding %s, decode-depth %"PRIu32", "
+            "flow-decode-depth %"PRIu64", header-value-depth %"PRIu32,
+            smtp_decode_mime ? "enabled" : "disabled",
+            config.decode_depth, config.flow_depth, config.header_depth);
+}
+
 int SMTPStateGetEventInfo(const char *event_name,
                           int *event_id, AppLayerEventType *event_type)
 {
@@ -882,6 +1141,18 @@ void RegisterSMTPParsers(void)
 
         AppLayerRegisterLocalStorageFunc(ALPROTO_SMTP, SMTPLocalStorageAlloc,
                                          SMTPLocalStorageFree);
+
+        AppLayerRegisterGetFilesFunc(ALPROTO_SMTP, SMTPStateGetFiles);
+
+        AppLayerRegisterTxFreeFunc(ALPROTO_SMTP, SMTPStateTransactionFree);
+        AppLayerRegisterGetTx(ALPROTO_SMTP, SMTPGetTx);
+        AppLayerRegisterGetTxCnt(ALPROTO_SMTP, SMTPGetTxCnt);
+        AppLayerRegisterGetAlstateProgressFunc(ALPROTO_SMTP,
+                                               SMTPGetAlstateProgress);
+        AppLayerRegisterGetAlstateProgressCompletionStatus(ALPROTO_SMTP,
+                SMTPGetAlstateProgressCompletionStatus);
+
+        SMTPConfigure();
     } else {
         SCLogInfo("Parsed disabled for %s protocol. Protocol detection"
                   "still on.", proto_name);
@@ -3548,6 +3819,265 @@ end:
     return result;
 }
 
+/**
+ * \test Test the extraction of a base64 encoded attachment from a mail,
+ *       with the mail split over two chunks and dot stuffing.
+ */
+int SMTPParserTest14(void)
+{
+    int result = 0;
+    Flow f;
+    int r = 0;
+
+    uint8_t request1[] = "EHLO boo.com\r\n";
+    uint32_t request1_len = sizeof(request1) - 1;
+    uint8_t reply1[] = "250 ok\r\n";
+    uint32_t reply1_len = sizeof(reply1) - 1;
+    uint8_t request2[] = "DATA\r\n";
+    uint32_t request2_len = sizeof(request2) - 1;
+    uint8_t reply2[] = "354 go ahead\r\n";
+    uint32_t reply2_len = sizeof(reply2) - 1;
+    uint8_t request3[] =
+        "Subject: test\r\n"
+        "Content-Type: multipart/mixed; boundary=\"frontier\"\r\n"
+        "\r\n"
+        "..this line was dot stuffed\r\n"
+        "--frontier\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n"
+        "body\r\n"
+        "--frontier\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "Content-Disposition: attachment; filename=\"test.bin\"\r\n"
+        "Content-Transfer-Encoding: base64\r\n"
+        "\r\n"
+        "VGhpcyBpcyBhIHRlc3Qgb2YgdGhlIGJh";
+    uint32_t request3_len = sizeof(request3) - 1;
+    uint8_t request4[] =
+        "c2U2NCBkZWNvZGVyIQ==\r\n"
+        "--frontier--\r\n"
+        ".\r\n";
+    uint32_t request4_len = sizeof(request4) - 1;
+
+    struct {
+        uint8_t *buf;
+        uint32_t len;
+        uint8_t flags;
+    } steps[] = {
+        { request1, request1_len, STREAM_TOSERVER | STREAM_START },
+        { reply1, reply1_len, STREAM_TOCLIENT | STREAM_START },
+        { request2, request2_len, STREAM_TOSERVER },
+        { reply2, reply2_len, STREAM_TOCLIENT },
+        { request3, request3_len, STREAM_TOSERVER },
+        { request4, request4_len, STREAM_TOSERVER },
+    };
+    uint32_t i;
+
+    TcpSession ssn;
+    void *thread_local_data = SMTPLocalStorageAlloc();
+
+    memset(&f, 0, sizeof(f));
+    memset(&ssn, 0, sizeof(ssn));
+
+    FLOW_INITIALIZE(&f);
+    f.protoctx = (void *)&ssn;
+
+    StreamTcpInitConfig(TRUE);
+
+    for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        SCMutexLock(&f.m);
+        r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, steps[i].flags,
+                          steps[i].buf, steps[i].len);
+        if (r != 0) {
+            printf("smtp check returned %" PRId32 ", expected 0 at step %u: ",
+                    r, i);
+            SCMutexUnlock(&f.m);
+            goto end;
+        }
+        SCMutexUnlock(&f.m);
+    }
+
+    SMTPState *smtp_state = f.alstate;
+    if (smtp_state == NULL) {
+        printf("no smtp state: ");
+        goto end;
+    }
+    if (smtp_state->mime_state != NULL || smtp_state->tx_cnt != 1 ||
+        smtp_state->curr_tx != NULL) {
+        printf("mail not completed: ");
+        goto end;
+    }
+
+    FileContainer *ffc = smtp_state->files_ts;
+    if (ffc == NULL || ffc->head == NULL || ffc->head->next != NULL) {
+        printf("expected exactly one file: ");
+        goto end;
+    }
+
+    File *ff = ffc->head;
+    if (ff->name_len != 8 || memcmp(ff->name, "test.bin", 8) != 0) {
+        printf("bad file name: ");
+        goto end;
+    }
+    if (ff->state != FILE_STATE_CLOSED || ff->size != 37 || ff->txid != 0) {
+        printf("file state %d size %"PRIu64" txid %"PRIu64": ",
+                ff->state, ff->size, ff->txid);
+        goto end;
+    }
+    if (ff->chunks_head == NULL ||
+            memcmp(ff->chunks_head->data, "This is a test of the ba", 24) != 0) {
+        printf("bad file data: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    StreamTcpFreeConfig(TRUE);
+    SMTPLocalStorageFree(thread_local_data);
+    FLOW_DESTROY(&f);
+    return result;
+}
+
+/**
+ * \test Test that the file keywords inspect the attachments of a mail.
+ */
+int SMTPParserTest15(void)
+{
+    int result = 0;
+    Signature *s = NULL;
+    ThreadVars th_v;
+    Packet *p = NULL;
+    Flow f;
+    TcpSession ssn;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    DetectEngineCtx *de_ctx = NULL;
+    int r = 0;
+
+    uint8_t request1[] = "EHLO boo.com\r\n";
+    uint32_t request1_len = sizeof(request1) - 1;
+    uint8_t reply1[] = "250 ok\r\n";
+    uint32_t reply1_len = sizeof(reply1) - 1;
+    uint8_t request2[] = "DATA\r\n";
+    uint32_t request2_len = sizeof(request2) - 1;
+    uint8_t reply2[] = "354 go ahead\r\n";
+    uint32_t reply2_len = sizeof(reply2) - 1;
+    uint8_t request3[] =
+        "Subject: test\r\n"
+        "Content-Type: multipart/mixed; boundary=\"frontier\"\r\n"
+        "\r\n"
+        "--frontier\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "Content-Disposition: attachment; filename=\"test.bin\"\r\n"
+        "Content-Transfer-Encoding: base64\r\n"
+        "\r\n"
+        "VGhpcyBpcyBhIHRlc3Qgb2YgdGhlIGJhc2U2NCBkZWNvZGVyIQ==\r\n";
+    uint32_t request3_len = sizeof(request3) - 1;
+    uint8_t request4[] =
+        "--frontier--\r\n"
+        ".\r\n";
+    uint32_t request4_len = sizeof(request4) - 1;
+
+    struct {
+        uint8_t *buf;
+        uint32_t len;
+        uint8_t flags;
+    } steps[] = {
+        { request1, request1_len, STREAM_TOSERVER | STREAM_START },
+        { reply1, reply1_len, STREAM_TOCLIENT | STREAM_START },
+        { request2, request2_len, STREAM_TOSERVER },
+        { reply2, reply2_len, STREAM_TOCLIENT },
+        { request3, request3_len, STREAM_TOSERVER },
+        { request4, request4_len, STREAM_TOSERVER },
+    };
+    uint32_t i;
+    int alerted = 0;
+
+    memset(&th_v, 0, sizeof(th_v));
+    memset(&f, 0, sizeof(f));
+    memset(&ssn, 0, sizeof(ssn));
+
+    p = UTHBuildPacket(NULL, 0, IPPROTO_TCP);
+
+    FLOW_INITIALIZE(&f);
+    f.protoctx = (void *)&ssn;
+    p->flow = &f;
+    p->flowflags |= FLOW_PKT_TOSERVER;
+    p->flowflags |= FLOW_PKT_ESTABLISHED;
+    p->flags |= PKT_HAS_FLOW|PKT_STREAM_EST;
+    f.alproto = ALPROTO_SMTP;
+
+    StreamTcpInitConfig(TRUE);
+    void *thread_local_data = SMTPLocalStorageAlloc();
+
+    de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL)
+        goto end;
+
+    de_ctx->flags |= DE_QUIET;
+
+    s = DetectEngineAppendSig(de_ctx, "alert smtp any any -> any any "
+                              "(msg:\"SMTP attachment\"; "
+                              "filename:\"test.bin\"; sid:1;)");
+    if (s == NULL)
+        goto end;
+    s = DetectEngineAppendSig(de_ctx, "alert smtp any any -> any any "
+                              "(msg:\"SMTP other attachment\"; "
+                              "filename:\"other.bin\"; sid:2;)");
+    if (s == NULL)
+        goto end;
+
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        SCMutexLock(&f.m);
+        r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, steps[i].flags,
+                          steps[i].buf, steps[i].len);
+        if (r != 0) {
+            printf("smtp check returned %" PRId32 ", expected 0 at step %u: ",
+                    r, i);
+            SCMutexUnlock(&f.m);
+            goto end;
+        }
+        SCMutexUnlock(&f.m);
+
+        if (!(steps[i].flags & STREAM_TOSERVER))
+            continue;
+
+        /* do detect */
+        SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+
+        if (PacketAlertCheck(p, 1))
+            alerted++;
+        if (PacketAlertCheck(p, 2)) {
+            printf("sid 2 matched.  It shouldn't match: ");
+            goto end;
+        }
+    }
+
+    if (alerted != 1) {
+        printf("sid 1 alerted %d times, expected 1: ", alerted);
+        goto end;
+    }
+
+    result = 1;
+
+end:
+    if (de_ctx != NULL) {
+        SigGroupCleanup(de_ctx);
+        SigCleanSignatures(de_ctx);
+        if (det_ctx != NULL)
+            DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+        DetectEngineCtxFree(de_ctx);
+    }
+
+    StreamTcpFreeConfig(TRUE);
+    SMTPLocalStorageFree(thread_local_data);
+    FLOW_DESTROY(&f);
+    UTHFreePackets(&p, 1);
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 void SMTPParserRegisterTests(void)
@@ -3566,6 +4096,8 @@ void SMTPParserRegisterTests(void)
     UtRegisterTest("SMTPParserTest11", SMTPParserTest11, 1);
     UtRegisterTest("SMTPParserTest12", SMTPParserTest12, 1);
     UtRegisterTest("SMTPParserTest13", SMTPParserTest13, 1);
+    UtRegisterTest("SMTPParserTest14", SMTPParserTest14, 1);
+    UtRegisterTest("SMTPParserTest15", SMTPParserTest15, 1);
 #endif /* UNITTESTS */
 
     return;
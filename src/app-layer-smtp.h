@@ -25,6 +25,9 @@
 #define __APP_LAYER_SMTP_H__
 
 #include "decode-events.h"
+#include "queue.h"
+#include "util-file.h"
+#include "util-decode-mime.h"
 
 enum {
     SMTP_DECODER_EVENT_INVALID_REPLY,
@@ -36,8 +39,28 @@ enum {
     SMTP_DECODER_EVENT_NO_SERVER_WELCOME_MESSAGE,
     SMTP_DECODER_EVENT_TLS_REJECTED,
     SMTP_DECODER_EVENT_DATA_COMMAND_REJECTED,
+
+    /* MIME events */
+    SMTP_DECODER_EVENT_MIME_INVALID_BASE64,
+    SMTP_DECODER_EVENT_MIME_INVALID_QP,
+    SMTP_DECODER_EVENT_MIME_LONG_HEADER,
+    SMTP_DECODER_EVENT_MIME_TOO_DEEP,
 };
 
+/** a new file was opened in the mail in progress */
+#define SMTP_FLAG_NEW_FILE_TX_TS    0x01
+
+/** a mail sent in a DATA/BDAT sequence, the attachments it carries are
+ *  tagged with its tx_id */
+typedef struct SMTPTransaction_ {
+    /** id of this tx, starts at 0 */
+    uint64_t tx_id;
+    /** the end of the mail has been seen */
+    uint8_t done;
+
+    TAILQ_ENTRY(SMTPTransaction_) next;
+} SMTPTransaction;
+
 typedef struct SMTPState_ {
     /* current input that is being parsed */
     uint8_t *input;
@@ -89,6 +112,21 @@ typedef struct SMTPState_ {
      *  handler */
     uint16_t cmds_idx;
 
+    /** MIME parser of the mail in progress after DATA */
+    MimeDecParseState *mime_state;
+    /** attachments extracted from the mails */
+    FileContainer *files_ts;
+    /** bytes decoded from the attachments of all the mails */
+    uint64_t mime_decoded;
+    /** list of txs, the last one is the mail in progress */
+    TAILQ_HEAD(, SMTPTransaction_) tx_list;
+    /** tx of the mail in progress */
+    SMTPTransaction *curr_tx;
+    /** number of txs created, the id of the next tx */
+    uint64_t tx_cnt;
+    /** SMTP_FLAG_* */
+    uint8_t flags;
+
 } SMTPState;
 
 void RegisterSMTPParsers(void);
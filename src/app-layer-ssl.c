@@ -39,6 +39,7 @@
 #include "app-layer-protos.h"
 #include "app-layer-parser.h"
 #include "app-layer-ssl.h"
+#include "app-layer-slab.h"
 
 #include "app-layer-tls-handshake.h"
 
@@ -73,10 +74,17 @@ SCEnumCharMap tls_decoder_event_table[ ] = {
 
 typedef struct SslConfig_ {
     int no_reassemble;
+    /** stop reassembly and payload inspection once the session is
+     *  encrypted, the rest is accounted as bypassed */
+    int encrypted_bypass;
 } SslConfig;
 
 SslConfig ssl_config;
 
+/** number of detection engines with rules that use the tls.no_bypass
+ *  keyword. While there are any, encrypted sessions are not bypassed. */
+SC_ATOMIC_DECLARE(uint32_t, ssl_no_bypass_cnt);
+
 /* SSLv3 record types */
 #define SSLV3_CHANGE_CIPHER_SPEC      20
 #define SSLV3_ALERT_PROTOCOL          21
@@ -442,6 +450,47 @@ static int SSLv2ParseRecord(uint8_t direction, SSLState *ssl_state,
     return (input - initial_input);
 }
 
+/**
+ *  \brief register a detection engine that has rules with the
+ *         tls.no_bypass keyword, which need the packets of the session
+ *         after the handshake
+ */
+void SSLNoBypassRegister(void)
+{
+    (void) SC_ATOMIC_ADD(ssl_no_bypass_cnt, 1);
+}
+
+void SSLNoBypassDeregister(void)
+{
+    (void) SC_ATOMIC_SUB(ssl_no_bypass_cnt, 1);
+}
+
+/**
+ *  \internal
+ *  \brief both sides of the session are encrypted: the parser is done and
+ *         payload inspection is disabled. Depending on the config
+ *         reassembly is stopped too, and unless rules opted out the rest
+ *         of the session is bypassed.
+ */
+static void SSLSetEncrypted(AppLayerParserState *pstate)
+{
+    pstate->flags |= APP_LAYER_PARSER_DONE;
+    pstate->flags |= APP_LAYER_PARSER_NO_INSPECTION;
+    if (ssl_config.no_reassemble == 1)
+        pstate->flags |= APP_LAYER_PARSER_NO_REASSEMBLY;
+
+    if (SC_ATOMIC_GET(ssl_no_bypass_cnt) > 0) {
+        /* also keeps the stream engine from bypassing the session once
+         * neither direction is reassembled anymore */
+        SCLogDebug("rules with tls.no_bypass loaded, not bypassing");
+        pstate->flags |= APP_LAYER_PARSER_NO_BYPASS;
+        return;
+    }
+
+    if (ssl_config.encrypted_bypass == 1)
+        pstate->flags |= (APP_LAYER_PARSER_NO_REASSEMBLY|APP_LAYER_PARSER_BYPASS);
+}
+
 static int SSLv2Decode(uint8_t direction, SSLState *ssl_state,
                        AppLayerParserState *pstate, uint8_t *input,
                        uint32_t input_len)
@@ -635,10 +684,7 @@ static int SSLv2Decode(uint8_t direction, SSLState *ssl_state,
 
                 if ((ssl_state->flags & SSL_AL_FLAG_SSL_CLIENT_SSN_ENCRYPTED) &&
                     (ssl_state->flags & SSL_AL_FLAG_SSL_SERVER_SSN_ENCRYPTED)) {
-                    pstate->flags |= APP_LAYER_PARSER_DONE;
-                    pstate->flags |= APP_LAYER_PARSER_NO_INSPECTION;
-                    if (ssl_config.no_reassemble == 1)
-                        pstate->flags |= APP_LAYER_PARSER_NO_REASSEMBLY;
+                    SSLSetEncrypted(pstate);
                     SCLogDebug("SSLv2 No reassembly & inspection has been set");
                 }
             }
@@ -710,10 +756,7 @@ static int SSLv3Decode(uint8_t direction, SSLState *ssl_state,
             if ((ssl_state->flags & SSL_AL_FLAG_CLIENT_CHANGE_CIPHER_SPEC) &&
                 (ssl_state->flags & SSL_AL_FLAG_SERVER_CHANGE_CIPHER_SPEC)) {
                 /* set flags */
-                pstate->flags |= APP_LAYER_PARSER_DONE;
-                pstate->flags |= APP_LAYER_PARSER_NO_INSPECTION;
-                if (ssl_config.no_reassemble == 1)
-                    pstate->flags |= APP_LAYER_PARSER_NO_REASSEMBLY;
+                SSLSetEncrypted(pstate);
             }
 
             break;
@@ -944,7 +987,7 @@ int SSLParseServerRecord(Flow *f, void *alstate, AppLayerParserState *pstate,
  */
 void *SSLStateAlloc(void)
 {
-    void *ssl_state = SCMalloc(sizeof(SSLState));
+    void *ssl_state = AppLayerSlabAlloc(sizeof(SSLState));
     if (unlikely(ssl_state == NULL))
         return NULL;
     memset(ssl_state, 0, sizeof(SSLState));
@@ -989,7 +1032,7 @@ void SSLStateFree(void *p)
     }
     TAILQ_INIT(&ssl_state->server_connp.certs);
 
-    SCFree(ssl_state);
+    AppLayerSlabFree(ssl_state, sizeof(SSLState));
 
     return;
 }
@@ -1032,6 +1075,8 @@ void RegisterSSLParsers(void)
 {
     char *proto_name = "tls";
 
+    SC_ATOMIC_INIT(ssl_no_bypass_cnt);
+
     /** SSLv2  and SSLv23*/
     if (AppLayerProtoDetectionEnabled(proto_name)) {
         AlpProtoAdd(&alp_proto_ctx, proto_name, IPPROTO_TCP, ALPROTO_TLS, "|01 00 02|", 5, 2, STREAM_TOSERVER);
@@ -1111,6 +1156,10 @@ void RegisterSSLParsers(void)
             if (ConfGetBool("app-layer.protocols.tls.no-reassemble", &ssl_config.no_reassemble) != 1)
                 ssl_config.no_reassemble = 1;
         }
+
+        if (ConfGetBool("app-layer.protocols.tls.encrypted-bypass",
+                    &ssl_config.encrypted_bypass) != 1)
+            ssl_config.encrypted_bypass = 1;
     } else {
         SCLogInfo("Parsed disabled for %s protocol. Protocol detection"
                   "still on.", proto_name);
@@ -3296,6 +3345,7 @@ static int SSLParserTest23(void)
     AppLayerParserStateStore *parser_state_store =
         (AppLayerParserStateStore *)f.alparser;
     AppLayerParserState *parser_state = &parser_state_store->to_server;
+
     if (!(parser_state->flags & APP_LAYER_PARSER_NO_INSPECTION) &&
         !(ssn.client.flags & STREAMTCP_STREAM_FLAG_NOREASSEMBLY) &&
         !(ssn.server.flags & STREAMTCP_STREAM_FLAG_NOREASSEMBLY)) {
@@ -3310,6 +3360,35 @@ static int SSLParserTest23(void)
         goto end;
     }
 
+    if (SC_ATOMIC_GET(ssl_no_bypass_cnt) > 0) {
+        /* rules opted out of the bypass */
+        if (ssn.flags & STREAMTCP_FLAG_APP_LAYER_BYPASS) {
+            printf("session shouldn't be bypassed\n");
+            result = 0;
+            goto end;
+        }
+
+        /* neither is the stream engine allowed to bypass it, although
+         * both directions are no longer reassembled */
+        int bypass = stream_config.bypass;
+        stream_config.bypass = 1;
+        ssn.state = TCP_ESTABLISHED;
+        if (!(ssn.flags & STREAMTCP_FLAG_NO_BYPASS) ||
+            StreamTcpCheckBypass(&ssn)) {
+            printf("stream.bypass shouldn't bypass the session\n");
+            result = 0;
+        }
+        stream_config.bypass = bypass;
+        goto end;
+    }
+
+    if (ssl_config.encrypted_bypass == 1 &&
+        !(ssn.flags & STREAMTCP_FLAG_APP_LAYER_BYPASS)) {
+        printf("session should be bypassed\n");
+        result = 0;
+        goto end;
+    }
+
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
@@ -3800,6 +3879,18 @@ end:
     return result;
 }
 
+/**
+ * \test Encrypted sessions are not bypassed when rules use tls.no_bypass,
+ *       but payload inspection is still disabled.
+ */
+static int SSLParserTest26(void)
+{
+    SSLNoBypassRegister();
+    int result = SSLParserTest23();
+    SSLNoBypassDeregister();
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 void SSLParserRegisterTests(void)
@@ -3832,6 +3923,7 @@ void SSLParserRegisterTests(void)
     UtRegisterTest("SSLParserTest23", SSLParserTest23, 1);
     UtRegisterTest("SSLParserTest24", SSLParserTest24, 1);
     UtRegisterTest("SSLParserTest25", SSLParserTest25, 1);
+    UtRegisterTest("SSLParserTest26", SSLParserTest26, 1);
 
     UtRegisterTest("SSLParserMultimsgTest01", SSLParserMultimsgTest01, 1);
     UtRegisterTest("SSLParserMultimsgTest02", SSLParserMultimsgTest02, 1);
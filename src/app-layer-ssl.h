@@ -148,6 +148,8 @@ typedef struct SSLState_ {
 } SSLState;
 
 void RegisterSSLParsers(void);
+void SSLNoBypassRegister(void);
+void SSLNoBypassDeregister(void);
 void SSLParserRegisterTests(void);
 
 #endif /* __APP_LAYER_SSL_H__ */
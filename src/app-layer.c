@@ -27,6 +27,7 @@
 
 #include "app-layer.h"
 #include "app-layer-detect-proto.h"
+#include "app-layer-detect-cache.h"
 #include "stream-tcp-reassemble.h"
 #include "stream-tcp-private.h"
 #include "stream-tcp-inline.h"
@@ -183,6 +184,16 @@ int AppLayerHandleTCPData(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
         }
 #endif
 
+        /* detection recently gave up on flows to this server */
+        if (*alproto_otherdir == ALPROTO_UNKNOWN &&
+                AlpCacheSkipDetection(f, IPPROTO_TCP) == 1) {
+            FlowSetSessionNoApplayerInspectionFlag(f);
+            StreamTcpSetStreamFlagAppProtoDetectionCompleted(&ssn->server);
+            StreamTcpSetStreamFlagAppProtoDetectionCompleted(&ssn->client);
+            ssn->data_first_seen_dir = APP_LAYER_DATA_ALREADY_SENT_TO_APP_LAYER;
+            goto end;
+        }
+
         PACKET_PROFILING_APP_PD_START(dp_ctx);
         *alproto = AppLayerDetectGetProto(&alp_proto_ctx, dp_ctx, f,
                                           data, data_len, flags, IPPROTO_TCP);
@@ -315,6 +326,8 @@ int AppLayerHandleTCPData(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
                     StreamTcpResetStreamFlagAppProtoDetectionCompleted(stream);
                     FLOW_RESET_PM_DONE(f, flags);
                     FLOW_RESET_PP_DONE(f, flags);
+                    f->alproto_pm_searched[dir] = 0;
+                    f->alproto_pm_pending[dir] = 0;
                     r = 0;
                     goto end;
                 }
@@ -322,6 +335,7 @@ int AppLayerHandleTCPData(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
 
             /* Set a value that is neither STREAM_TOSERVER, nor STREAM_TOCLIENT */
             ssn->data_first_seen_dir = APP_LAYER_DATA_ALREADY_SENT_TO_APP_LAYER;
+            AlpCacheFlowResult(f, IPPROTO_TCP, *alproto);
 
             PACKET_PROFILING_APP_START(dp_ctx, *alproto);
             r = AppLayerParse(dp_ctx->alproto_local_storage[*alproto], f, *alproto, flags, data + data_al_so_far, data_len - data_al_so_far);
@@ -377,6 +391,7 @@ int AppLayerHandleTCPData(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
                     StreamTcpSetStreamFlagAppProtoDetectionCompleted(&ssn->server);
                     StreamTcpSetStreamFlagAppProtoDetectionCompleted(&ssn->client);
                     ssn->data_first_seen_dir = APP_LAYER_DATA_ALREADY_SENT_TO_APP_LAYER;
+                    AlpCacheFlowResult(f, IPPROTO_TCP, ALPROTO_FAILED);
                 }
             }
         }
@@ -520,7 +535,11 @@ int AppLayerHandleUdp(AlpProtoDetectThreadCtx *dp_ctx, Flow *f, Packet *p)
      * initializer message, we run proto detection.
      * We receive 2 stream init msgs (one for each direction) but we
      * only run the proto detection once. */
-    if (f->alproto == ALPROTO_UNKNOWN && !(f->flags & FLOW_ALPROTO_DETECT_DONE)) {
+    if (f->alproto == ALPROTO_UNKNOWN && !(f->flags & FLOW_ALPROTO_DETECT_DONE) &&
+            AlpCacheSkipDetection(f, IPPROTO_UDP) == 1) {
+        /* detection recently gave up on flows to this server */
+        f->flags |= FLOW_ALPROTO_DETECT_DONE;
+    } else if (f->alproto == ALPROTO_UNKNOWN && !(f->flags & FLOW_ALPROTO_DETECT_DONE)) {
         SCLogDebug("Detecting AL proto on udp mesg (len %" PRIu32 ")",
                     p->payload_len);
 
@@ -531,6 +550,7 @@ int AppLayerHandleUdp(AlpProtoDetectThreadCtx *dp_ctx, Flow *f, Packet *p)
 
         if (f->alproto != ALPROTO_UNKNOWN) {
             f->flags |= FLOW_ALPROTO_DETECT_DONE;
+            AlpCacheFlowResult(f, IPPROTO_UDP, f->alproto);
 
             PACKET_PROFILING_APP_START(dp_ctx, f->alproto);
             r = AppLayerParse(dp_ctx->alproto_local_storage[f->alproto], f, f->alproto, flags,
@@ -538,6 +558,7 @@ int AppLayerHandleUdp(AlpProtoDetectThreadCtx *dp_ctx, Flow *f, Packet *p)
             PACKET_PROFILING_APP_END(dp_ctx, f->alproto);
         } else {
             f->flags |= FLOW_ALPROTO_DETECT_DONE;
+            AlpCacheFlowResult(f, IPPROTO_UDP, ALPROTO_FAILED);
             SCLogDebug("ALPROTO_UNKNOWN flow %p", f);
         }
     } else {
@@ -35,6 +35,8 @@
 #include "util-privs.h"
 #include "util-signal.h"
 #include "unix-manager.h"
+#include "detect.h"
+#include "detect-engine-rulestats.h"
 
 /** \todo Get the default log directory from some global resource. */
 #define SC_PERF_DEFAULT_LOG_FILENAME "stats.log"
@@ -51,6 +53,24 @@ static char sc_counter_enabled = TRUE;
 /** append or overwrite? 1: append, 0: overwrite */
 static char sc_counter_append = TRUE;
 
+/** size of the buckets of a histogram counter, padded to the cache line */
+#define SC_PERF_HIST_ALLOC_SIZE \
+    (((SC_PERF_HIST_SIZE * sizeof(uint64_t) + CLS - 1) / CLS) * CLS)
+
+/** The global value of a counter is only written by the thread owning the
+ *  counter and read by the outputs without a lock. The values are 64 bit
+ *  integers and doubles, which a plain access can tear on 32 bit platforms,
+ *  so they're stored and loaded atomically. No ordering is needed. */
+#define SC_PERF_STORE(ptr, val) do { \
+        __typeof__(*(ptr)) sc_perf_store_val_ = (val); \
+        __atomic_store((ptr), &sc_perf_store_val_, __ATOMIC_RELAXED); \
+    } while (0)
+#define SC_PERF_LOAD(ptr) ({ \
+        __typeof__(*(ptr)) sc_perf_load_val_; \
+        __atomic_load((ptr), &sc_perf_load_val_, __ATOMIC_RELAXED); \
+        sc_perf_load_val_; \
+    })
+
 /**
  * \brief Adds a value of type uint64_t to the local counter.
  *
@@ -260,6 +280,94 @@ void SCPerfCounterSetDouble(uint16_t id, SCPerfCounterArray *pca,
     return;
 }
 
+/**
+ * \brief Gets the histogram bucket a value falls in
+ *
+ * \param x the value
+ *
+ * \retval bucket index, < SC_PERF_HIST_BUCKETS, or SC_PERF_HIST_OVERFLOW if
+ *         x is (1 << SC_PERF_HIST_MAX_BITS) or more
+ */
+uint32_t SCPerfHistogramBucket(uint64_t x)
+{
+    uint32_t msb = 0;
+    uint32_t shift = 0;
+
+    if (x < (1 << SC_PERF_HIST_SUB_BITS))
+        return (uint32_t)x;
+
+    if (x >= (1ULL << SC_PERF_HIST_MAX_BITS))
+        return SC_PERF_HIST_OVERFLOW;
+
+    msb = 63 - __builtin_clzll(x);
+    shift = msb - SC_PERF_HIST_SUB_BITS;
+
+    /* the power of 2 selects the group of buckets, the bits right below the
+     * highest bit select the bucket in the group */
+    return ((shift + 1) << SC_PERF_HIST_SUB_BITS) +
+           (uint32_t)((x >> shift) & ((1 << SC_PERF_HIST_SUB_BITS) - 1));
+}
+
+/**
+ * \brief Gets the highest value that falls in a histogram bucket
+ *
+ * \param b the bucket index
+ *
+ * \retval the inclusive upper bound of the bucket.  UINT64_MAX for the
+ *         overflow bucket, as that one holds all values that are too large.
+ */
+uint64_t SCPerfHistogramBucketMax(uint32_t b)
+{
+    uint32_t shift = 0;
+    uint64_t mant = 0;
+
+    if (b >= SC_PERF_HIST_OVERFLOW)
+        return UINT64_MAX;
+
+    if (b < (1 << SC_PERF_HIST_SUB_BITS))
+        return b;
+
+    shift = (b >> SC_PERF_HIST_SUB_BITS) - 1;
+    mant = (1 << SC_PERF_HIST_SUB_BITS) + (b & ((1 << SC_PERF_HIST_SUB_BITS) - 1));
+
+    return (mant << shift) + ((1ULL << shift) - 1);
+}
+
+/**
+ * \brief Records a value in a local histogram counter
+ *
+ * \param id  ID of the counter as set by the API
+ * \param pca Counter array that holds the local counter for this TM
+ * \param x   Value to record, e.g. cpu ticks spent
+ */
+void SCPerfCounterRecordHistogram(uint16_t id, SCPerfCounterArray *pca,
+                                  uint64_t x)
+{
+    SCPCAElem *pcae = NULL;
+
+    if (!pca) {
+        SCLogDebug("counterarray is NULL");
+        return;
+    }
+
+    if ((id < 1) || (id > pca->size)) {
+        SCLogDebug("counter doesn't exist");
+        return;
+    }
+
+    pcae = &pca->head[id];
+    if (pcae->hist == NULL) {
+        SCLogDebug("counter is not a histogram");
+        return;
+    }
+
+    pcae->hist[SCPerfHistogramBucket(x)]++;
+    pcae->hist[SC_PERF_HIST_SUM] += x;
+    pcae->ui64_cnt++;
+
+    return;
+}
+
 /**
  * \brief Get the filename with path to the stats log file.
  *
@@ -383,6 +491,12 @@ static void SCPerfInitOPCtx(void)
         exit(EXIT_FAILURE);
     }
 
+    /* init the lock used by the snapshot */
+    if (SCMutexInit(&sc_perf_op_ctx->snapshot_lock, NULL) != 0) {
+        SCLogError(SC_ERR_INITIALIZATION, "error initializing snapshot mutex");
+        exit(EXIT_FAILURE);
+    }
+
     SCReturn;
 }
 
@@ -419,6 +533,15 @@ static void SCPerfReleaseOPCtx()
         pctmi = temp;
     }
 
+    if (sc_perf_op_ctx->snapshot.elems != NULL)
+        SCFree(sc_perf_op_ctx->snapshot.elems);
+
+    if (sc_perf_op_ctx->snapshot.hist != NULL)
+        SCFree(sc_perf_op_ctx->snapshot.hist);
+
+    SCMutexDestroy(&sc_perf_op_ctx->pctmi_lock);
+    SCMutexDestroy(&sc_perf_op_ctx->snapshot_lock);
+
     SCFree(sc_perf_op_ctx);
     sc_perf_op_ctx = NULL;
 
@@ -479,6 +602,7 @@ static void *SCPerfMgmtThread(void *arg)
         SCCtrlMutexUnlock(tv_local->ctrl_mutex);
 
         SCPerfOutputCounters();
+        DetectRuleStatsMerge();
 
         if (TmThreadsCheckFlag(tv_local, THV_KILL)) {
             run = 0;
@@ -718,7 +842,7 @@ static void SCPerfReleaseCounter(SCPerfCounter *pc)
 
         if (pc->value != NULL) {
             if (pc->value->cvalue != NULL)
-                SCFree(pc->value->cvalue);
+                SCFreeAligned(pc->value->cvalue);
 
             SCFree(pc->value);
         }
@@ -729,6 +853,9 @@ static void SCPerfReleaseCounter(SCPerfCounter *pc)
         if (pc->type_q != NULL)
             SCFree(pc->type_q);
 
+        if (pc->hist != NULL)
+            SCFreeAligned(pc->hist);
+
         SCFree(pc);
     }
 
@@ -841,6 +968,16 @@ static uint16_t SCPerfRegisterQualifiedCounter(char *cname, char *tm_name,
         }
     }
 
+    /* histograms count the recorded values, the buckets are kept separately */
+    if (pc->type_q->type & SC_PERF_TYPE_Q_HISTOGRAM) {
+        type = SC_PERF_TYPE_UINT64;
+        if ( (pc->hist = SCMallocAligned(SC_PERF_HIST_ALLOC_SIZE, CLS)) == NULL) {
+            SCPerfReleaseCounter(pc);
+            return 0;
+        }
+        memset(pc->hist, 0, SC_PERF_HIST_ALLOC_SIZE);
+    }
+
     /* allocate memory to hold this counter value */
     pc->value->type = type;
     switch (pc->value->type) {
@@ -854,7 +991,9 @@ static uint16_t SCPerfRegisterQualifiedCounter(char *cname, char *tm_name,
             break;
     }
 
-    if ( (pc->value->cvalue = SCMalloc(pc->value->size)) == NULL)
+    /* the value is written by the thread owning this counter, so give it a
+     * cache line of its own to not share it with counters of other threads */
+    if ( (pc->value->cvalue = SCMallocAligned(CLS, CLS)) == NULL)
         return 0;
     memset(pc->value->cvalue, 0, pc->value->size);
 
@@ -875,6 +1014,10 @@ static uint16_t SCPerfRegisterQualifiedCounter(char *cname, char *tm_name,
  *        SCPerfCounterArray to its corresponding global counterpart.  Used
  *        internally by SCPerfUpdateCounterArray()
  *
+ *        Only the thread owning the counter array writes the global counter,
+ *        so this is done without a lock.  The outputs read the global counter
+ *        while it's being updated.
+ *
  * \param pcae     Pointer to the SCPerfCounterArray which holds the local
  *                 versions of the counters
  * \param reset_lc Flag which indicates if the values of the local counters
@@ -885,12 +1028,29 @@ static void SCPerfCopyCounterValue(SCPCAElem *pcae, int reset_lc)
     SCPerfCounter *pc = NULL;
     double d_temp = 0;
     uint64_t ui64_temp = 0;
+    double secs = 0;
 
     struct timeval curr_ts;
 
     uint64_t u = 0;
 
     pc = pcae->pc;
+
+    /* publish the buckets before the count */
+    if (pcae->hist != NULL && pc->hist != NULL) {
+        for (u = 0; u < SC_PERF_HIST_SIZE; u++)
+            SC_PERF_STORE(&pc->hist[u], pcae->hist[u]);
+
+        if (reset_lc)
+            memset(pcae->hist, 0, SC_PERF_HIST_SIZE * sizeof(uint64_t));
+    }
+
+    if (pc->type_q->type & SC_PERF_TYPE_Q_TIMEBASED) {
+        TimeGet(&curr_ts);
+        secs = ((curr_ts.tv_sec + curr_ts.tv_usec / 1000000.0) -
+                (pcae->ts.tv_sec + pcae->ts.tv_usec / 1000000.0));
+    }
+
     switch (pc->value->type) {
         case SC_PERF_TYPE_UINT64:
             ui64_temp = pcae->ui64_cnt;
@@ -902,22 +1062,21 @@ static void SCPerfCopyCounterValue(SCPCAElem *pcae, int reset_lc)
                 if (pcae->syncs != 0)
                     ui64_temp /= pcae->syncs;
 
-                *((uint64_t *)pc->value->cvalue) = ui64_temp;
+                SC_PERF_STORE((uint64_t *)pc->value->cvalue, ui64_temp);
             } else if (pc->type_q->type & SC_PERF_TYPE_Q_TIMEBASED) {
-                /* we have a timebased counter.  Awesome.  Time for some more processing */
-                TimeGet(&curr_ts);
-                pc->type_q->tbc_secs += ((curr_ts.tv_sec + curr_ts.tv_usec / 1000000.0) -
-                                         (pcae->ts.tv_sec + pcae->ts.tv_usec / 1000000.0));
-
                 /* special treatment for timebased counters.  We add instead of
-                 * copying to the global counters.  The job of resetting the
-                 * global counters is done by the output function */
-                *((uint64_t *)pc->value->cvalue) += ui64_temp;
+                 * copying to the global counters.  The output keeps track of
+                 * the part it has already seen, so the global counter is
+                 * never reset */
+                SC_PERF_STORE((uint64_t *)pc->value->cvalue,
+                              *((uint64_t *)pc->value->cvalue) + ui64_temp);
+                SC_PERF_STORE(&pc->type_q->tbc_secs,
+                              pc->type_q->tbc_secs + secs);
                 pcae->ui64_cnt = 0;
                 /* reset it to the current time */
-                TimeGet(&pcae->ts);
+                pcae->ts = curr_ts;
             } else {
-                *((uint64_t *)pc->value->cvalue) = ui64_temp;
+                SC_PERF_STORE((uint64_t *)pc->value->cvalue, ui64_temp);
             }
 
             if (reset_lc)
@@ -934,22 +1093,21 @@ static void SCPerfCopyCounterValue(SCPCAElem *pcae, int reset_lc)
                 if (pcae->syncs != 0)
                     d_temp /= pcae->syncs;
 
-                *((double *)pc->value->cvalue) = d_temp;
+                SC_PERF_STORE((double *)pc->value->cvalue, d_temp);
             } else if (pc->type_q->type & SC_PERF_TYPE_Q_TIMEBASED) {
-                /* we have a timebased counter.  Awesome.  Time for some more processing */
-                TimeGet(&curr_ts);
-                pc->type_q->tbc_secs += ((curr_ts.tv_sec + curr_ts.tv_usec / 1000000.0) -
-                                         (pcae->ts.tv_sec + pcae->ts.tv_usec / 1000000.0));
-
                 /* special treatment for timebased counters.  We add instead of
-                 * copying to the global counters.  The job of resetting the
-                 * global counters is done by the output function */
-                *((double *)pc->value->cvalue) += d_temp;
+                 * copying to the global counters.  The output keeps track of
+                 * the part it has already seen, so the global counter is
+                 * never reset */
+                SC_PERF_STORE((double *)pc->value->cvalue,
+                              *((double *)pc->value->cvalue) + d_temp);
+                SC_PERF_STORE(&pc->type_q->tbc_secs,
+                              pc->type_q->tbc_secs + secs);
                 pcae->d_cnt = 0;
                 /* reset it to the current time */
-                TimeGet(&pcae->ts);
+                pcae->ts = curr_ts;
             } else {
-                *((double *)pc->value->cvalue) = d_temp;
+                SC_PERF_STORE((double *)pc->value->cvalue, d_temp);
             }
 
             if (reset_lc)
@@ -965,11 +1123,11 @@ static void SCPerfCopyCounterValue(SCPCAElem *pcae, int reset_lc)
  * \brief Calculates counter value that should be sent as output
  *
  *        If we aren't dealing with timebased counters, we just return the
- *        the counter value.  In case of Timebased counters, if we haven't
- *        crossed the interval, we display the current value without any
- *        modifications.  If we have crossed the limit, we calculate the counter
- *        value for the time period and also return 1, to indicate that the
- *        counter value can be reset after use
+ *        the counter value.  In case of Timebased counters, we calculate the
+ *        counter value for the time period since the last output.  The global
+ *        counter is left untouched, instead the part of it that was used is
+ *        remembered.  So only one output should call this for a counter, which
+ *        is taken care of by the snapshot.
  *
  * \param pc Pointer to the PerfCounter for which the timebased counter has to
  *           be calculated
@@ -977,56 +1135,187 @@ static void SCPerfCopyCounterValue(SCPCAElem *pcae, int reset_lc)
 static void SCPerfOutputCalculateCounterValue(SCPerfCounter *pc, void *cvalue_op)
 {
     double divisor = 0;
+    double secs = 0;
+    uint64_t ui64_temp = 0;
+    double d_temp = 0;
+
+    /* if we don't have a Timebased counter, we just read the value */
+    if ( !(pc->type_q->type & SC_PERF_TYPE_Q_TIMEBASED)) {
+        switch (pc->value->type) {
+            case SC_PERF_TYPE_UINT64:
+                *((uint64_t *)cvalue_op) = SC_PERF_LOAD((uint64_t *)pc->value->cvalue);
+
+                break;
+            case SC_PERF_TYPE_DOUBLE:
+                *((double *)cvalue_op) = SC_PERF_LOAD((double *)pc->value->cvalue);
+
+                break;
+        }
+        return;
+    }
+
+    secs = SC_PERF_LOAD(&pc->type_q->tbc_secs);
+    divisor = (secs - pc->type_q->tbc_secs_out) / pc->type_q->total_secs;
+    pc->type_q->tbc_secs_out = secs;
 
     switch (pc->value->type) {
         case SC_PERF_TYPE_UINT64:
-            *((uint64_t *)cvalue_op) = *((uint64_t *)pc->value->cvalue);
+            ui64_temp = SC_PERF_LOAD((uint64_t *)pc->value->cvalue);
+            *((uint64_t *)cvalue_op) = ui64_temp - pc->type_q->ui64_out;
+            pc->type_q->ui64_out = ui64_temp;
+
+            if (divisor > 0)
+                *((uint64_t *)cvalue_op) /= divisor;
 
             break;
         case SC_PERF_TYPE_DOUBLE:
-            *((double *)cvalue_op) = *((double *)pc->value->cvalue);
+            d_temp = SC_PERF_LOAD((double *)pc->value->cvalue);
+            *((double *)cvalue_op) = d_temp - pc->type_q->d_out;
+            pc->type_q->d_out = d_temp;
+
+            if (divisor > 0)
+                *((double *)cvalue_op) /= divisor;
 
             break;
     }
 
-    /* if we don't have a Timebased counter, we are out of here */
-    if ( !(pc->type_q->type & SC_PERF_TYPE_Q_TIMEBASED))
-        return;
+    return;
+}
+
+/**
+ * \internal
+ * \brief Gets a new, zeroed element at the end of the snapshot
+ *
+ * \retval elem the element or NULL on memory error
+ */
+static SCPerfSnapshotElem *SCPerfSnapshotNewElem(SCPerfSnapshot *snap)
+{
+    SCPerfSnapshotElem *elem = NULL;
 
-    //if (pc->type_q->tbc_secs < pc->type_q->total_secs)
-    //    return;
+    if (snap->size == snap->alloc) {
+        uint32_t alloc = snap->alloc ? snap->alloc * 2 : 64;
 
-    divisor = pc->type_q->tbc_secs/pc->type_q->total_secs;
-    divisor += ((double)(pc->type_q->tbc_secs % pc->type_q->total_secs)/
-                pc->type_q->total_secs);
+        elem = SCRealloc(snap->elems, alloc * sizeof(SCPerfSnapshotElem));
+        if (elem == NULL)
+            return NULL;
 
-    switch (pc->value->type) {
-        case SC_PERF_TYPE_UINT64:
-            *((uint64_t *)cvalue_op) /= divisor;
+        snap->elems = elem;
+        snap->alloc = alloc;
+    }
 
-            break;
-        case SC_PERF_TYPE_DOUBLE:
-            *((double *)cvalue_op) /= divisor;
+    elem = &snap->elems[snap->size++];
+    memset(elem, 0, sizeof(SCPerfSnapshotElem));
+    elem->hist = -1;
+    return elem;
+}
 
-            break;
+/**
+ * \internal
+ * \brief Gets new, zeroed buckets at the end of the snapshot
+ *
+ * \retval idx index of the buckets or -1 on memory error
+ */
+static int SCPerfSnapshotNewHist(SCPerfSnapshot *snap)
+{
+    uint64_t *hist = NULL;
+
+    if (snap->hist_size == snap->hist_alloc) {
+        uint32_t alloc = snap->hist_alloc ? snap->hist_alloc * 2 : 8;
+
+        hist = SCRealloc(snap->hist, alloc * SC_PERF_HIST_SIZE * sizeof(uint64_t));
+        if (hist == NULL)
+            return -1;
+
+        snap->hist = hist;
+        snap->hist_alloc = alloc;
     }
 
-    pc->type_q->tbc_secs = 0;
-    /* reset the local counter back to 0 */
-    memset(pc->value->cvalue, 0, pc->value->size);
+    memset(&snap->hist[snap->hist_size * SC_PERF_HIST_SIZE], 0,
+           SC_PERF_HIST_SIZE * sizeof(uint64_t));
+    return (int)snap->hist_size++;
+}
+
+/**
+ * \internal
+ * \brief Adds the global buckets of a histogram counter to the snapshot
+ *        buckets at index idx
+ */
+static void SCPerfSnapshotAddHist(SCPerfSnapshot *snap, int idx, SCPerfCounter *pc)
+{
+    uint64_t *hist = &snap->hist[idx * SC_PERF_HIST_SIZE];
+    uint32_t u = 0;
+
+    for (u = 0; u < SC_PERF_HIST_SIZE; u++)
+        hist[u] += SC_PERF_LOAD(&pc->hist[u]);
 
     return;
 }
 
 /**
- * \brief The file output interface for the Perf Counter api
+ * \internal
+ * \brief Adds the values of all the displayed counters of a SCPerfContext to
+ *        the snapshot
+ *
+ * \param snap    the snapshot
+ * \param pctx    the tv's SCPerfContext
+ * \param tv_name name of the thread the counters belong to
+ *
+ * \retval  0 on success
+ * \retval -1 on memory error
  */
-static int SCPerfOutputCounterFileIface()
+static int SCPerfSnapshotAddContext(SCPerfSnapshot *snap, SCPerfContext *pctx,
+                                    const char *tv_name)
+{
+    SCPerfCounter *pc = NULL;
+    SCPerfSnapshotElem *elem = NULL;
+
+    for (pc = pctx->head; pc != NULL; pc = pc->next) {
+        if (pc->disp == 0 || pc->value == NULL)
+            continue;
+
+        if ((elem = SCPerfSnapshotNewElem(snap)) == NULL)
+            return -1;
+
+        elem->tv_name = tv_name;
+        elem->tm_name = pc->name->tm_name;
+        elem->cname = pc->name->cname;
+        elem->type = pc->value->type;
+
+        if (pc->hist != NULL) {
+            if ((elem->hist = SCPerfSnapshotNewHist(snap)) < 0)
+                return -1;
+            SCPerfSnapshotAddHist(snap, elem->hist, pc);
+        }
+
+        switch (pc->value->type) {
+            case SC_PERF_TYPE_UINT64:
+                SCPerfOutputCalculateCounterValue(pc, &elem->ui64);
+                break;
+            case SC_PERF_TYPE_DOUBLE:
+                SCPerfOutputCalculateCounterValue(pc, &elem->d);
+                break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \internal
+ * \brief Adds the values of the counters of all instances of a tm to the
+ *        snapshot, summing up the values of the instances
+ *
+ * \param snap  the snapshot
+ * \param pctmi the clubbed tm instances
+ *
+ * \retval  0 on success
+ * \retval -1 on memory error
+ */
+static int SCPerfSnapshotAddClubbed(SCPerfSnapshot *snap, SCPerfClubTMInst *pctmi)
 {
-    ThreadVars *tv = NULL;
-    SCPerfClubTMInst *pctmi = NULL;
     SCPerfCounter *pc = NULL;
     SCPerfCounter **pc_heads = NULL;
+    SCPerfSnapshotElem *elem = NULL;
 
     uint64_t ui64_temp = 0;
     uint64_t ui64_result = 0;
@@ -1034,25 +1323,239 @@ static int SCPerfOutputCounterFileIface()
     double double_temp = 0;
     double double_result = 0;
 
-    struct timeval tval;
-    struct tm *tms;
-
     uint32_t u = 0;
     int flag = 0;
+    int hist = -1;
+
+    if (pctmi->size == 0)
+        return 0;
+
+    if ((pc_heads = SCMalloc(pctmi->size * sizeof(SCPerfCounter *))) == NULL)
+        return -1;
+    memset(pc_heads, 0, pctmi->size * sizeof(SCPerfCounter *));
+
+    for (u = 0; u < pctmi->size; u++) {
+        pc_heads[u] = pctmi->head[u]->head;
+
+        while(pc_heads[u] != NULL && strcmp(pctmi->tm_name, pc_heads[u]->name->tm_name)) {
+            pc_heads[u] = pc_heads[u]->next;
+        }
+    }
+
+    flag = 1;
+    while(flag) {
+        ui64_result = 0;
+        double_result = 0;
+        if (pc_heads[0] == NULL)
+            break;
+        pc = pc_heads[0];
+
+        hist = -1;
+        if (pc->hist != NULL && pc->disp != 0) {
+            if ((hist = SCPerfSnapshotNewHist(snap)) < 0) {
+                SCFree(pc_heads);
+                return -1;
+            }
+        }
+
+        for (u = 0; u < pctmi->size; u++) {
+            if (pc_heads[u] == NULL) {
+                flag = 0;
+                continue;
+            }
+
+            if (hist >= 0 && pc_heads[u]->hist != NULL)
+                SCPerfSnapshotAddHist(snap, hist, pc_heads[u]);
+
+            switch (pc->value->type) {
+                case SC_PERF_TYPE_UINT64:
+                    SCPerfOutputCalculateCounterValue(pc_heads[u], &ui64_temp);
+                    ui64_result += ui64_temp;
+
+                    break;
+                case SC_PERF_TYPE_DOUBLE:
+                    SCPerfOutputCalculateCounterValue(pc_heads[u], &double_temp);
+                    double_result += double_temp;
+
+                    break;
+            }
+
+            pc_heads[u] = pc_heads[u]->next;
+
+            if (pc_heads[u] == NULL ||
+                (pc_heads[0] != NULL &&
+                    strcmp(pctmi->tm_name, pc_heads[0]->name->tm_name))) {
+                flag = 0;
+            }
+        }
+
+        if (pc->disp == 0 || pc->value == NULL)
+            continue;
+
+        if ((elem = SCPerfSnapshotNewElem(snap)) == NULL) {
+            SCFree(pc_heads);
+            return -1;
+        }
+
+        elem->tv_name = pctmi->tm_name;
+        elem->tm_name = pctmi->tm_name;
+        elem->cname = pc->name->cname;
+        elem->type = pc->value->type;
+        elem->hist = hist;
+
+        switch (pc->value->type) {
+            case SC_PERF_TYPE_UINT64:
+                elem->ui64 = ui64_result;
+                break;
+            case SC_PERF_TYPE_DOUBLE:
+                elem->d = double_result;
+                break;
+        }
+    }
+
+    SCFree(pc_heads);
+    return 0;
+}
+
+/**
+ * \internal
+ * \brief Aggregates the global counters of all threads into the snapshot.
+ *        The threads are not stopped or locked while doing so, the values
+ *        are read as the threads update them.
+ *
+ *        Must be called with sc_perf_op_ctx->snapshot_lock held.
+ *
+ * \retval 1 on success
+ * \retval 0 on failure
+ */
+static int SCPerfSnapshotBuild(SCPerfSnapshot *snap)
+{
+    ThreadVars *tv = NULL;
+    SCPerfClubTMInst *pctmi = NULL;
+    uint32_t u = 0;
+    int r = 0;
+
+    snap->size = 0;
+    snap->hist_size = 0;
+    snap->clubbed = sc_perf_op_ctx->club_tm;
+    gettimeofday(&snap->ts, NULL);
+
+    if (sc_perf_op_ctx->club_tm == 0) {
+        for (u = 0; u < TVT_MAX; u++) {
+            for (tv = tv_root[u]; tv != NULL; tv = tv->next) {
+                if (SCPerfSnapshotAddContext(snap, &tv->sc_perf_pctx, tv->name) < 0)
+                    return 0;
+            }
+        }
+
+        return 1;
+    }
+
+    SCMutexLock(&sc_perf_op_ctx->pctmi_lock);
+    for (pctmi = sc_perf_op_ctx->pctmi; pctmi != NULL; pctmi = pctmi->next) {
+        if ((r = SCPerfSnapshotAddClubbed(snap, pctmi)) < 0)
+            break;
+    }
+    SCMutexUnlock(&sc_perf_op_ctx->pctmi_lock);
+
+    return (r == 0);
+}
+
+/**
+ * \brief Gets a copy of the last aggregated counter values.  If nothing
+ *        has been aggregated yet, this is done first.
+ *
+ * \retval snap copy of the snapshot, to be freed by SCPerfSnapshotFree()
+ * \retval NULL if the perf counter api isn't initialized or on memory error
+ */
+SCPerfSnapshot *SCPerfSnapshotGet(void)
+{
+    SCPerfSnapshot *snap = NULL;
+
+    if (sc_perf_op_ctx == NULL)
+        return NULL;
+
+    if ((snap = SCMalloc(sizeof(SCPerfSnapshot))) == NULL)
+        return NULL;
+    memset(snap, 0, sizeof(SCPerfSnapshot));
+
+    SCMutexLock(&sc_perf_op_ctx->snapshot_lock);
+
+    if (sc_perf_op_ctx->snapshot.ts.tv_sec == 0)
+        SCPerfSnapshotBuild(&sc_perf_op_ctx->snapshot);
+
+    snap->ts = sc_perf_op_ctx->snapshot.ts;
+    snap->clubbed = sc_perf_op_ctx->snapshot.clubbed;
+
+    if (sc_perf_op_ctx->snapshot.size > 0) {
+        snap->elems = SCMalloc(sc_perf_op_ctx->snapshot.size *
+                               sizeof(SCPerfSnapshotElem));
+        if (snap->elems == NULL) {
+            SCMutexUnlock(&sc_perf_op_ctx->snapshot_lock);
+            SCFree(snap);
+            return NULL;
+        }
+        memcpy(snap->elems, sc_perf_op_ctx->snapshot.elems,
+               sc_perf_op_ctx->snapshot.size * sizeof(SCPerfSnapshotElem));
+        snap->size = snap->alloc = sc_perf_op_ctx->snapshot.size;
+    }
+
+    if (sc_perf_op_ctx->snapshot.hist_size > 0) {
+        snap->hist = SCMalloc(sc_perf_op_ctx->snapshot.hist_size *
+                              SC_PERF_HIST_SIZE * sizeof(uint64_t));
+        if (snap->hist == NULL) {
+            SCMutexUnlock(&sc_perf_op_ctx->snapshot_lock);
+            SCPerfSnapshotFree(snap);
+            return NULL;
+        }
+        memcpy(snap->hist, sc_perf_op_ctx->snapshot.hist,
+               sc_perf_op_ctx->snapshot.hist_size * SC_PERF_HIST_SIZE * sizeof(uint64_t));
+        snap->hist_size = snap->hist_alloc = sc_perf_op_ctx->snapshot.hist_size;
+    }
+
+    SCMutexUnlock(&sc_perf_op_ctx->snapshot_lock);
+    return snap;
+}
+
+/**
+ * \brief Frees a snapshot returned by SCPerfSnapshotGet()
+ */
+void SCPerfSnapshotFree(SCPerfSnapshot *snap)
+{
+    if (snap != NULL) {
+        if (snap->elems != NULL)
+            SCFree(snap->elems);
+
+        if (snap->hist != NULL)
+            SCFree(snap->hist);
+
+        SCFree(snap);
+    }
+
+    return;
+}
+
+/**
+ * \brief The file output interface for the Perf Counter api
+ *
+ * \param snap the snapshot to write
+ */
+static int SCPerfOutputCounterFileIface(SCPerfSnapshot *snap)
+{
+    SCPerfSnapshotElem *elem = NULL;
+    struct tm *tms;
+    uint32_t u = 0;
 
     if (sc_perf_op_ctx->fp == NULL) {
         SCLogDebug("perf_op_ctx->fp is NULL");
         return 0;
     }
 
-    memset(&tval, 0, sizeof(struct timeval));
-
-    gettimeofday(&tval, NULL);
     struct tm local_tm;
-    tms = SCLocalTime(tval.tv_sec, &local_tm);
+    tms = SCLocalTime(snap->ts.tv_sec, &local_tm);
 
     /* Calculate the Engine uptime */
-    int up_time = (int)difftime(tval.tv_sec, sc_start_time);
+    int up_time = (int)difftime(snap->ts.tv_sec, sc_start_time);
     int sec = up_time % 60;     // Seconds in a minute
     int in_min = up_time / 60;
     int min = in_min % 60;      // Minutes in a hour
@@ -1073,149 +1576,251 @@ static int SCPerfOutputCounterFileIface()
     fprintf(sc_perf_op_ctx->fp, "----------------------------------------------"
             "---------------------\n");
 
-    if (sc_perf_op_ctx->club_tm == 0) {
-        for (u = 0; u < TVT_MAX; u++) {
-            tv = tv_root[u];
-            //if (pc_heads == NULL || pc_heads[u] == NULL)
-            //    continue;
-
-            while (tv != NULL) {
-                SCMutexLock(&tv->sc_perf_pctx.m);
-                pc = tv->sc_perf_pctx.head;
-
-                while (pc != NULL) {
-                    if (pc->disp == 0 || pc->value == NULL) {
-                        pc = pc->next;
-                        continue;
-                    }
-
-                    switch (pc->value->type) {
-                        case SC_PERF_TYPE_UINT64:
-                            SCPerfOutputCalculateCounterValue(pc,
-                                    &ui64_temp);
-                            fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | "
-                                    "%-" PRIu64 "\n", pc->name->cname,
-                                    pc->name->tm_name, ui64_temp);
-                            break;
-                        case SC_PERF_TYPE_DOUBLE:
-                            SCPerfOutputCalculateCounterValue(pc,
-                                    &double_temp);
-                            fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s |"
-                                    " %-lf\n", pc->name->cname,
-                                    pc->name->tm_name, double_temp);
-                            break;
-                    }
-
-                    pc = pc->next;
-                }
+    for (u = 0; u < snap->size; u++) {
+        elem = &snap->elems[u];
 
-                SCMutexUnlock(&tv->sc_perf_pctx.m);
-                tv = tv->next;
-            }
-            fflush(sc_perf_op_ctx->fp);
+        switch (elem->type) {
+            case SC_PERF_TYPE_UINT64:
+                fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | %-" PRIu64 "\n",
+                        elem->cname, elem->tm_name, elem->ui64);
+                break;
+            case SC_PERF_TYPE_DOUBLE:
+                if (snap->clubbed)
+                    fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | %0.0lf\n",
+                            elem->cname, elem->tm_name, elem->d);
+                else
+                    fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | %-lf\n",
+                            elem->cname, elem->tm_name, elem->d);
+                break;
         }
-
-        return 1;
     }
 
-    pctmi = sc_perf_op_ctx->pctmi;
-    while (pctmi != NULL) {
-        if ((pc_heads = SCMalloc(pctmi->size * sizeof(SCPerfCounter *))) == NULL)
-            return 0;
-        memset(pc_heads, 0, pctmi->size * sizeof(SCPerfCounter *));
+    fflush(sc_perf_op_ctx->fp);
+    return 1;
+}
 
-        for (u = 0; u < pctmi->size; u++) {
-            pc_heads[u] = pctmi->head[u]->head;
+/** growing text buffer used for the metrics exposition */
+typedef struct SCPerfTextBuffer_ {
+    char *buf;
+    size_t size;
+    size_t len;
+    int error;
+} SCPerfTextBuffer;
+
+/**
+ * \internal
+ * \brief Appends formatted text to the buffer, growing it as needed
+ */
+static void SCPerfTextAppend(SCPerfTextBuffer *tb, const char *fmt, ...)
+{
+    va_list ap;
+    int r = 0;
 
-            SCMutexLock(&pctmi->head[u]->m);
+    if (tb->error)
+        return;
 
-            while(pc_heads[u] != NULL && strcmp(pctmi->tm_name, pc_heads[u]->name->tm_name)) {
-                pc_heads[u] = pc_heads[u]->next;
-            }
+    while (1) {
+        va_start(ap, fmt);
+        r = vsnprintf(tb->buf + tb->len, tb->size - tb->len, fmt, ap);
+        va_end(ap);
+
+        if (r < 0) {
+            tb->error = 1;
+            return;
         }
 
-        flag = 1;
-        while(flag) {
-            ui64_result = 0;
-            double_result = 0;
-            if (pc_heads[0] == NULL)
+        if ((size_t)r < tb->size - tb->len) {
+            tb->len += r;
+            return;
+        }
+
+        size_t size = tb->size * 2;
+        if (size < tb->len + r + 1)
+            size = tb->len + r + 1;
+
+        char *buf = SCRealloc(tb->buf, size);
+        if (buf == NULL) {
+            tb->error = 1;
+            return;
+        }
+        tb->buf = buf;
+        tb->size = size;
+    }
+}
+
+/**
+ * \internal
+ * \brief Appends a label value, escaping backslashes, quotes and newlines
+ */
+static void SCPerfTextAppendLabel(SCPerfTextBuffer *tb, const char *str)
+{
+    for ( ; *str != '\0'; str++) {
+        switch (*str) {
+            case '\\':
+                SCPerfTextAppend(tb, "\\\\");
+                break;
+            case '"':
+                SCPerfTextAppend(tb, "\\\"");
                 break;
-            pc = pc_heads[0];
+            case '\n':
+                SCPerfTextAppend(tb, "\\n");
+                break;
+            default:
+                SCPerfTextAppend(tb, "%c", *str);
+                break;
+        }
+    }
+}
 
-            for (u = 0; u < pctmi->size; u++) {
-                switch (pc->value->type) {
-                    case SC_PERF_TYPE_UINT64:
-                        SCPerfOutputCalculateCounterValue(pc_heads[u], &ui64_temp);
-                        ui64_result += ui64_temp;
+/**
+ * \internal
+ * \brief Converts a counter name into a metric name, e.g. "decoder.pkts"
+ *        becomes "suricata_decoder_pkts"
+ */
+static void SCPerfMetricName(const char *cname, char *name, size_t name_size)
+{
+    size_t u = 0;
 
-                        break;
-                    case SC_PERF_TYPE_DOUBLE:
-                        SCPerfOutputCalculateCounterValue(pc_heads[u], &double_temp);
-                        double_result += double_temp;
+    strlcpy(name, "suricata_", name_size);
+    u = strlen(name);
 
-                        break;
-                }
+    for ( ; *cname != '\0' && u < name_size - 1; cname++, u++) {
+        if (isalnum((unsigned char)*cname) || *cname == '_' || *cname == ':')
+            name[u] = *cname;
+        else
+            name[u] = '_';
+    }
+    name[u] = '\0';
+}
 
-                if (pc_heads[u] != NULL)
-                    pc_heads[u] = pc_heads[u]->next;
+static int SCPerfSnapshotElemCompare(const void *a, const void *b)
+{
+    const SCPerfSnapshotElem *e1 = *(const SCPerfSnapshotElem **)a;
+    const SCPerfSnapshotElem *e2 = *(const SCPerfSnapshotElem **)b;
+    int r = strcmp(e1->cname, e2->cname);
 
-                if (pc_heads[u] == NULL ||
-                    (pc_heads[0] != NULL &&
-                        strcmp(pctmi->tm_name, pc_heads[0]->name->tm_name))) {
-                    flag = 0;
-                }
-            }
+    if (r != 0)
+        return r;
 
-            if (pc->disp == 0 || pc->value == NULL)
-                continue;
+    /* keep the order of the snapshot for the same counter */
+    return (e1 < e2) ? -1 : (e1 > e2);
+}
 
-            switch (pc->value->type) {
-                case SC_PERF_TYPE_UINT64:
-                    fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | %-" PRIu64 "\n",
-                            pc->name->cname, pctmi->tm_name, ui64_result);
+/**
+ * \brief Renders a snapshot in the Prometheus/OpenMetrics text exposition
+ *        format.  All values of a counter are grouped, with the thread (or
+ *        the tm if the counters are clubbed) as label.  Empty histogram
+ *        buckets are left out.
+ *
+ * \param snap the snapshot
+ *
+ * \retval text allocated string, to be freed by the caller
+ * \retval NULL on memory error
+ */
+char *SCPerfSnapshotToText(const SCPerfSnapshot *snap)
+{
+    SCPerfTextBuffer tb;
+    const SCPerfSnapshotElem **sorted = NULL;
+    const SCPerfSnapshotElem *elem = NULL;
+    const char *prev_cname = NULL;
+    const uint64_t *hist = NULL;
+    char name[256];
+    uint64_t cum = 0;
+    uint32_t u = 0;
+    uint32_t b = 0;
 
-                    break;
-                case SC_PERF_TYPE_DOUBLE:
-                    fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | %0.0lf\n",
-                            pc->name->cname, pctmi->tm_name, double_result);
+    memset(&tb, 0, sizeof(tb));
+    tb.size = 4096;
+    if ((tb.buf = SCMalloc(tb.size)) == NULL)
+        return NULL;
+    tb.buf[0] = '\0';
 
-                    break;
-            }
+    if (snap->size > 0) {
+        if ((sorted = SCMalloc(snap->size * sizeof(SCPerfSnapshotElem *))) == NULL) {
+            SCFree(tb.buf);
+            return NULL;
         }
+        for (u = 0; u < snap->size; u++)
+            sorted[u] = &snap->elems[u];
+        qsort(sorted, snap->size, sizeof(SCPerfSnapshotElem *),
+              SCPerfSnapshotElemCompare);
+    }
 
-        for (u = 0; u < pctmi->size; u++)
-            SCMutexUnlock(&pctmi->head[u]->m);
+    for (u = 0; u < snap->size; u++) {
+        elem = sorted[u];
 
-        pctmi = pctmi->next;
+        SCPerfMetricName(elem->cname, name, sizeof(name));
+        if (prev_cname == NULL || strcmp(prev_cname, elem->cname) != 0) {
+            SCPerfTextAppend(&tb, "# TYPE %s %s\n", name,
+                             elem->hist >= 0 ? "histogram" : "untyped");
+            prev_cname = elem->cname;
+        }
 
-        SCFree(pc_heads);
+        if (elem->hist < 0) {
+            SCPerfTextAppend(&tb, "%s{thread=\"", name);
+            SCPerfTextAppendLabel(&tb, elem->tv_name);
+            if (elem->type == SC_PERF_TYPE_DOUBLE)
+                SCPerfTextAppend(&tb, "\"} %f\n", elem->d);
+            else
+                SCPerfTextAppend(&tb, "\"} %" PRIu64 "\n", elem->ui64);
+            continue;
+        }
+
+        hist = &snap->hist[elem->hist * SC_PERF_HIST_SIZE];
+        cum = 0;
+        for (b = 0; b < SC_PERF_HIST_BUCKETS; b++) {
+            if (hist[b] == 0)
+                continue;
+            cum += hist[b];
 
-        fflush(sc_perf_op_ctx->fp);
+            SCPerfTextAppend(&tb, "%s_bucket{thread=\"", name);
+            SCPerfTextAppendLabel(&tb, elem->tv_name);
+            SCPerfTextAppend(&tb, "\",le=\"%" PRIu64 "\"} %" PRIu64 "\n",
+                             SCPerfHistogramBucketMax(b), cum);
+        }
+
+        /* the overflow bucket is the +Inf one */
+        cum += hist[SC_PERF_HIST_OVERFLOW];
+        SCPerfTextAppend(&tb, "%s_bucket{thread=\"", name);
+        SCPerfTextAppendLabel(&tb, elem->tv_name);
+        SCPerfTextAppend(&tb, "\",le=\"+Inf\"} %" PRIu64 "\n", cum);
+
+        SCPerfTextAppend(&tb, "%s_sum{thread=\"", name);
+        SCPerfTextAppendLabel(&tb, elem->tv_name);
+        SCPerfTextAppend(&tb, "\"} %" PRIu64 "\n", hist[SC_PERF_HIST_SUM]);
+
+        SCPerfTextAppend(&tb, "%s_count{thread=\"", name);
+        SCPerfTextAppendLabel(&tb, elem->tv_name);
+        SCPerfTextAppend(&tb, "\"} %" PRIu64 "\n", cum);
     }
 
-    return 1;
-}
+    SCPerfTextAppend(&tb, "# EOF\n");
 
-#ifdef BUILD_UNIX_SOCKET
-/**
- * \brief The file output interface for the Perf Counter api
- */
-TmEcode SCPerfOutputCounterSocket(json_t *cmd,
-                               json_t *answer, void *data)
-{
-    ThreadVars *tv = NULL;
-    SCPerfClubTMInst *pctmi = NULL;
-    SCPerfCounter *pc = NULL;
-    SCPerfCounter **pc_heads = NULL;
+    if (sorted != NULL)
+        SCFree(sorted);
 
-    uint64_t ui64_temp = 0;
-    uint64_t ui64_result = 0;
+    if (tb.error) {
+        SCFree(tb.buf);
+        return NULL;
+    }
 
-    double double_temp = 0;
-    double double_result = 0;
+    return tb.buf;
+}
 
+#ifdef BUILD_UNIX_SOCKET
+/**
+ * \brief The unix socket output interface for the Perf Counter api. Uses
+ *        the values of the last aggregation.
+ */
+TmEcode SCPerfOutputCounterSocket(json_t *cmd,
+                               json_t *answer, void *data)
+{
+    SCPerfSnapshot *snap = NULL;
+    SCPerfSnapshotElem *elem = NULL;
+    json_t *tm_array = NULL;
+    json_t *jdata = NULL;
+    const char *tv_name = NULL;
     uint32_t u = 0;
-    int flag = 0;
 
     if (sc_perf_op_ctx == NULL) {
         json_object_set_new(answer, "message",
@@ -1223,169 +1828,90 @@ TmEcode SCPerfOutputCounterSocket(json_t *cmd,
         return TM_ECODE_FAILED;
     }
 
-    if (sc_perf_op_ctx->club_tm == 0) {
-        json_t *tm_array;
-
-        tm_array = json_object();
-        if (tm_array == NULL) {
-            json_object_set_new(answer, "message",
-                    json_string("internal error at json object creation"));
-            return TM_ECODE_FAILED;
-        }
-
-
-        for (u = 0; u < TVT_MAX; u++) {
-            tv = tv_root[u];
-            //if (pc_heads == NULL || pc_heads[u] == NULL)
-            //    continue;
-
-
-            while (tv != NULL) {
-                SCMutexLock(&tv->sc_perf_pctx.m);
-                pc = tv->sc_perf_pctx.head;
-                json_t *jdata;
-                int filled = 0;
-                jdata = json_object();
-                if (jdata == NULL) {
-                    json_decref(tm_array);
-                    json_object_set_new(answer, "message",
-                            json_string("internal error at json object creation"));
-                    SCMutexUnlock(&tv->sc_perf_pctx.m);
-                    return TM_ECODE_FAILED;
-                }
-
-                while (pc != NULL) {
-                    if (pc->disp == 0 || pc->value == NULL) {
-                        pc = pc->next;
-                        continue;
-                    }
-
-                    switch (pc->value->type) {
-                        case SC_PERF_TYPE_UINT64:
-                            SCPerfOutputCalculateCounterValue(pc,
-                                    &ui64_temp);
-                            json_object_set_new(jdata, pc->name->cname, json_integer(ui64_temp));
-                            filled = 1;
-                            break;
-                        case SC_PERF_TYPE_DOUBLE:
-                            SCPerfOutputCalculateCounterValue(pc,
-                                    &double_temp);
-                            json_object_set_new(jdata, pc->name->cname, json_real(double_temp));
-                            filled = 1;
-                            break;
-                    }
-                    pc = pc->next;
-                }
-
-                SCMutexUnlock(&tv->sc_perf_pctx.m);
-                if (filled == 1) {
-                    json_object_set_new(tm_array, tv->name, jdata);
-                }
-                tv = tv->next;
-            }
-        }
-
-        json_object_set_new(answer, "message", tm_array);
-        return TM_ECODE_OK;
+    if ((snap = SCPerfSnapshotGet()) == NULL) {
+        json_object_set_new(answer, "message",
+                json_string("internal memory error"));
+        return TM_ECODE_FAILED;
     }
 
-    json_t *tm_array;
-
     tm_array = json_object();
     if (tm_array == NULL) {
+        SCPerfSnapshotFree(snap);
         json_object_set_new(answer, "message",
                 json_string("internal error at json object creation"));
         return TM_ECODE_FAILED;
     }
 
-    pctmi = sc_perf_op_ctx->pctmi;
-    while (pctmi != NULL) {
-        json_t *jdata;
-        int filled = 0;
+    /* the values of a thread or tm are grouped in the snapshot */
+    u = 0;
+    while (u < snap->size) {
+        tv_name = snap->elems[u].tv_name;
+
         jdata = json_object();
         if (jdata == NULL) {
             json_decref(tm_array);
+            SCPerfSnapshotFree(snap);
             json_object_set_new(answer, "message",
                     json_string("internal error at json object creation"));
             return TM_ECODE_FAILED;
         }
-        if ((pc_heads = SCMalloc(pctmi->size * sizeof(SCPerfCounter *))) == NULL) {
-            json_decref(tm_array);
-            json_object_set_new(answer, "message",
-                    json_string("internal memory error"));
-            return TM_ECODE_FAILED;
-        }
-        memset(pc_heads, 0, pctmi->size * sizeof(SCPerfCounter *));
-
-        for (u = 0; u < pctmi->size; u++) {
-            pc_heads[u] = pctmi->head[u]->head;
 
-            SCMutexLock(&pctmi->head[u]->m);
+        for ( ; u < snap->size && snap->elems[u].tv_name == tv_name; u++) {
+            elem = &snap->elems[u];
 
-            while(pc_heads[u] != NULL && strcmp(pctmi->tm_name, pc_heads[u]->name->tm_name)) {
-                pc_heads[u] = pc_heads[u]->next;
+            switch (elem->type) {
+                case SC_PERF_TYPE_UINT64:
+                    json_object_set_new(jdata, elem->cname, json_integer(elem->ui64));
+                    break;
+                case SC_PERF_TYPE_DOUBLE:
+                    json_object_set_new(jdata, elem->cname, json_real(elem->d));
+                    break;
             }
         }
 
-        flag = 1;
-        while(flag) {
-            ui64_result = 0;
-            double_result = 0;
-            if (pc_heads[0] == NULL)
-                break;
-            pc = pc_heads[0];
-
-            for (u = 0; u < pctmi->size; u++) {
-                switch (pc->value->type) {
-                    case SC_PERF_TYPE_UINT64:
-                        SCPerfOutputCalculateCounterValue(pc_heads[u], &ui64_temp);
-                        ui64_result += ui64_temp;
-
-                        break;
-                    case SC_PERF_TYPE_DOUBLE:
-                        SCPerfOutputCalculateCounterValue(pc_heads[u], &double_temp);
-                        double_result += double_temp;
-
-                        break;
-                }
+        json_object_set_new(tm_array, tv_name, jdata);
+    }
 
-                if (pc_heads[u] != NULL)
-                    pc_heads[u] = pc_heads[u]->next;
+    SCPerfSnapshotFree(snap);
 
-                if (pc_heads[u] == NULL ||
-                    (pc_heads[0] != NULL &&
-                        strcmp(pctmi->tm_name, pc_heads[0]->name->tm_name))) {
-                    flag = 0;
-                }
-            }
+    json_object_set_new(answer, "message", tm_array);
+    return TM_ECODE_OK;
+}
 
-            if (pc->disp == 0 || pc->value == NULL)
-                continue;
+/**
+ * \brief The unix socket command returning the counters in the
+ *        Prometheus/OpenMetrics text format, as a single string.  Uses
+ *        the values of the last aggregation.
+ */
+TmEcode SCPerfOutputMetricsSocket(json_t *cmd,
+                               json_t *answer, void *data)
+{
+    SCPerfSnapshot *snap = NULL;
+    char *text = NULL;
 
-            switch (pc->value->type) {
-                case SC_PERF_TYPE_UINT64:
-                    filled = 1;
-                    json_object_set_new(jdata, pc->name->cname, json_integer(ui64_result));
-                    break;
-                case SC_PERF_TYPE_DOUBLE:
-                    filled = 1;
-                    json_object_set_new(jdata, pc->name->cname, json_real(double_result));
-                    break;
-            }
-        }
+    if (sc_perf_op_ctx == NULL) {
+        json_object_set_new(answer, "message",
+                json_string("No performance counter context"));
+        return TM_ECODE_FAILED;
+    }
 
-        for (u = 0; u < pctmi->size; u++)
-            SCMutexUnlock(&pctmi->head[u]->m);
-        if (filled == 1) {
-            json_object_set_new(tm_array, pctmi->tm_name, jdata);
-        }
-        pctmi = pctmi->next;
+    if ((snap = SCPerfSnapshotGet()) == NULL) {
+        json_object_set_new(answer, "message",
+                json_string("internal memory error"));
+        return TM_ECODE_FAILED;
+    }
 
-        SCFree(pc_heads);
+    text = SCPerfSnapshotToText(snap);
+    SCPerfSnapshotFree(snap);
 
+    if (text == NULL) {
+        json_object_set_new(answer, "message",
+                json_string("internal memory error"));
+        return TM_ECODE_FAILED;
     }
 
-    json_object_set_new(answer, "message", tm_array);
+    json_object_set_new(answer, "message", json_string(text));
+    SCFree(text);
 
     return TM_ECODE_OK;
 }
@@ -1557,6 +2083,32 @@ uint16_t SCPerfTVRegisterIntervalCounter(char *cname, struct ThreadVars_ *tv,
     return id;
 }
 
+/**
+ * \brief Registers a histogram counter.  Values are recorded using
+ *        SCPerfCounterRecordHistogram(), the value of the counter is the
+ *        number of values recorded
+ *
+ * \param cname Name of the counter, to be registered
+ * \param tv    Pointer to the ThreadVars instance for which the counter would
+ *              be registered
+ * \param desc  Description of this counter
+ *
+ * \retval id Counter id for the newly registered counter, or the already
+ *            present counter
+ */
+uint16_t SCPerfTVRegisterHistogramCounter(char *cname, struct ThreadVars_ *tv,
+                                          char *desc)
+{
+    uint16_t id = SCPerfRegisterQualifiedCounter(cname,
+                                                 (tv->thread_group_name != NULL) ? tv->thread_group_name : tv->name,
+                                                 SC_PERF_TYPE_UINT64, desc,
+                                                 &tv->sc_perf_pctx,
+                                                 SC_PERF_TYPE_Q_HISTOGRAM,
+                                                 NULL);
+
+    return id;
+}
+
 /**
  * \brief Registers a normal, unqualified counter
  *
@@ -1663,6 +2215,31 @@ uint16_t SCPerfRegisterIntervalCounter(char *cname, char *tm_name, int type,
     return id;
 }
 
+/**
+ * \brief Registers a histogram counter
+ *
+ * \param cname   Name of the counter, to be registered
+ * \param tm_name Name of the engine module under which the counter has to be
+ *                registered
+ * \param desc    Description of this counter
+ * \param pctx    SCPerfContext corresponding to the tm_name key under which the
+ *                key has to be registered
+ *
+ * \retval id Counter id for the newly registered counter, or the already
+ *            present counter
+ */
+uint16_t SCPerfRegisterHistogramCounter(char *cname, char *tm_name, char *desc,
+                                        SCPerfContext *pctx)
+{
+    uint16_t id = SCPerfRegisterQualifiedCounter(cname, tm_name,
+                                                 SC_PERF_TYPE_UINT64, desc,
+                                                 pctx,
+                                                 SC_PERF_TYPE_Q_HISTOGRAM,
+                                                 NULL);
+
+    return id;
+}
+
 /**
  * \brief Adds a TM to the clubbed TM table.  Multiple instances of the same TM
  *        are stacked together in a PCTMI container.
@@ -1780,6 +2357,7 @@ SCPerfCounterArray *SCPerfGetCounterArrayRange(uint16_t s_id, uint16_t e_id,
     SCPerfCounter *pc = NULL;
     SCPerfCounterArray *pca = NULL;
     uint32_t i = 0;
+    size_t size = 0;
 
     if (pctx == NULL) {
         SCLogDebug("pctx is NULL");
@@ -1800,9 +2378,15 @@ SCPerfCounterArray *SCPerfGetCounterArrayRange(uint16_t s_id, uint16_t e_id,
         return NULL;
     memset(pca, 0, sizeof(SCPerfCounterArray));
 
-    if ( (pca->head = SCMalloc(sizeof(SCPCAElem) * (e_id - s_id  + 2))) == NULL)
+    /* the array is only touched by the thread owning it, align and pad it to
+     * the cache line so it doesn't share one with anything else */
+    size = sizeof(SCPCAElem) * (e_id - s_id  + 2);
+    size = ((size + CLS - 1) / CLS) * CLS;
+    if ( (pca->head = SCMallocAligned(size, CLS)) == NULL) {
+        SCFree(pca);
         return NULL;
-    memset(pca->head, 0, sizeof(SCPCAElem) * (e_id - s_id  + 2));
+    }
+    memset(pca->head, 0, size);
 
     pc = pctx->head;
     while (pc->id != s_id)
@@ -1814,6 +2398,15 @@ SCPerfCounterArray *SCPerfGetCounterArrayRange(uint16_t s_id, uint16_t e_id,
         pca->head[i].id = pc->id;
         if (pc->type_q->type & SC_PERF_TYPE_Q_TIMEBASED)
             TimeGet(&pca->head[i].ts);
+        if (pc->type_q->type & SC_PERF_TYPE_Q_HISTOGRAM) {
+            pca->head[i].hist = SCMallocAligned(SC_PERF_HIST_ALLOC_SIZE, CLS);
+            if (pca->head[i].hist == NULL) {
+                pca->size = i - 1;
+                SCPerfReleasePCA(pca);
+                return NULL;
+            }
+            memset(pca->head[i].hist, 0, SC_PERF_HIST_ALLOC_SIZE);
+        }
         pc = pc->next;
         i++;
     }
@@ -1877,7 +2470,8 @@ int SCPerfCounterDisplay(uint16_t id, SCPerfContext *pctx, int disp)
 }
 
 /**
- * \brief Syncs the counter array with the global counter variables
+ * \brief Syncs the counter array with the global counter variables.
+ *        Lockless, must only be called by the thread owning the array.
  *
  * \param pca      Pointer to the SCPerfCounterArray
  * \param pctx     Pointer the the tv's SCPerfContext
@@ -1900,7 +2494,8 @@ int SCPerfUpdateCounterArray(SCPerfCounterArray *pca, SCPerfContext *pctx,
 
     pcae = pca->head;
 
-    SCMutexLock(&pctx->m);
+    /* no lock needed, we're the only writer of the global counters of this
+     * context.  The outputs read them while we update them. */
     pc = pctx->head;
 
     for (i = 1; i <= pca->size; i++) {
@@ -1919,8 +2514,6 @@ int SCPerfUpdateCounterArray(SCPerfCounterArray *pca, SCPerfContext *pctx,
         }
     }
 
-    SCMutexUnlock(&pctx->m);
-
     pctx->perf_flag = 0;
 
     return 1;
@@ -1967,9 +2560,19 @@ double SCPerfGetLocalCounterValue(uint16_t id, SCPerfCounterArray *pca)
  */
 void SCPerfOutputCounters()
 {
+    SCPerfSnapshot *snap = &sc_perf_op_ctx->snapshot;
+
+    /* aggregate once, the snapshot is then used by all outputs including
+     * the unix socket */
+    SCMutexLock(&sc_perf_op_ctx->snapshot_lock);
+    if (SCPerfSnapshotBuild(snap) == 0) {
+        SCMutexUnlock(&sc_perf_op_ctx->snapshot_lock);
+        return;
+    }
+
     switch (sc_perf_op_ctx->iface) {
         case SC_PERF_IFACE_FILE:
-            SCPerfOutputCounterFileIface();
+            SCPerfOutputCounterFileIface(snap);
 
             break;
         case SC_PERF_IFACE_CONSOLE:
@@ -1981,6 +2584,7 @@ void SCPerfOutputCounters()
 
             break;
     }
+    SCMutexUnlock(&sc_perf_op_ctx->snapshot_lock);
 
     return;
 }
@@ -2022,9 +2626,16 @@ void SCPerfReleasePerfCounterS(SCPerfCounter *head)
  */
 void SCPerfReleasePCA(SCPerfCounterArray *pca)
 {
+    uint32_t i = 0;
+
     if (pca != NULL) {
-        if (pca->head != NULL)
-            SCFree(pca->head);
+        if (pca->head != NULL) {
+            for (i = 1; i <= pca->size; i++) {
+                if (pca->head[i].hist != NULL)
+                    SCFreeAligned(pca->head[i].hist);
+            }
+            SCFreeAligned(pca->head);
+        }
 
         SCFree(pca);
     }
@@ -2639,6 +3250,276 @@ static int SCPerfTestIntervalQual18()
 
     return result;
 }
+
+/**
+ * \test the output doesn't reset the global value of a timebased counter
+ */
+static int SCPerfTestIntervalQual19()
+{
+    ThreadVars tv;
+    SCPerfCounterArray *pca = NULL;
+    double d_temp = 0;
+    int result = 1;
+
+    uint16_t id1;
+
+    memset(&tv, 0, sizeof(ThreadVars));
+
+    id1 = SCPerfRegisterIntervalCounter("t1", "c1", SC_PERF_TYPE_DOUBLE, NULL,
+                                        &tv.sc_perf_pctx, "3s");
+
+    pca = SCPerfGetAllCountersArray(&tv.sc_perf_pctx);
+
+    SCPerfCounterAddDouble(id1, pca, 1);
+    SCPerfCounterAddDouble(id1, pca, 2);
+    SCPerfCounterAddDouble(id1, pca, 3);
+
+    /* forward the time 3 seconds */
+    TimeSetIncrementTime(3);
+
+    SCPerfUpdateCounterArray(pca, &tv.sc_perf_pctx, 0);
+
+    SCPerfOutputCalculateCounterValue(tv.sc_perf_pctx.head, &d_temp);
+    result &= (d_temp == 6);
+    result &= (6 == *((double *)tv.sc_perf_pctx.head->value->cvalue));
+
+    /* nothing new since the last output */
+    SCPerfOutputCalculateCounterValue(tv.sc_perf_pctx.head, &d_temp);
+    result &= (d_temp == 0);
+
+    SCPerfCounterAddDouble(id1, pca, 3);
+
+    /* forward the time 3 seconds */
+    TimeSetIncrementTime(3);
+
+    SCPerfUpdateCounterArray(pca, &tv.sc_perf_pctx, 0);
+
+    SCPerfOutputCalculateCounterValue(tv.sc_perf_pctx.head, &d_temp);
+    result &= (d_temp == 3);
+    result &= (9 == *((double *)tv.sc_perf_pctx.head->value->cvalue));
+
+    SCPerfReleasePerfCounterS(tv.sc_perf_pctx.head);
+    SCPerfReleasePCA(pca);
+
+    return result;
+}
+
+/**
+ * \test snapshot of the global counters of a thread
+ */
+static int SCPerfTestSnapshot20()
+{
+    ThreadVars tv;
+    SCPerfCounterArray *pca = NULL;
+    SCPerfSnapshot snap;
+    int result = 0;
+
+    uint16_t id1, id2, id3;
+
+    memset(&tv, 0, sizeof(ThreadVars));
+    memset(&snap, 0, sizeof(SCPerfSnapshot));
+
+    id1 = SCPerfRegisterCounter("c1", "t1", SC_PERF_TYPE_UINT64, NULL,
+                                &tv.sc_perf_pctx);
+    id2 = SCPerfRegisterCounter("c2", "t1", SC_PERF_TYPE_UINT64, NULL,
+                                &tv.sc_perf_pctx);
+    id3 = SCPerfRegisterMaxCounter("c3", "t1", SC_PERF_TYPE_DOUBLE, NULL,
+                                   &tv.sc_perf_pctx);
+    SCPerfCounterDisplay(id2, &tv.sc_perf_pctx, 0);
+
+    pca = SCPerfGetAllCountersArray(&tv.sc_perf_pctx);
+    if (pca == NULL)
+        goto end;
+
+    if (((uintptr_t)pca->head % CLS) != 0) {
+        printf("counter array not cache line aligned: ");
+        goto end;
+    }
+
+    SCPerfCounterAddUI64(id1, pca, 10);
+    SCPerfCounterIncr(id2, pca);
+    SCPerfCounterSetDouble(id3, pca, 2.5);
+
+    /* not synced yet */
+    if (SCPerfSnapshotAddContext(&snap, &tv.sc_perf_pctx, "tv1") != 0)
+        goto end;
+    if (snap.size != 2 || snap.elems[0].ui64 != 0) {
+        printf("snap.size %u: ", snap.size);
+        goto end;
+    }
+
+    SCPerfUpdateCounterArray(pca, &tv.sc_perf_pctx, 0);
+
+    snap.size = 0;
+    if (SCPerfSnapshotAddContext(&snap, &tv.sc_perf_pctx, "tv1") != 0)
+        goto end;
+    if (snap.size != 2) {
+        printf("snap.size %u: ", snap.size);
+        goto end;
+    }
+
+    if (strcmp(snap.elems[0].cname, "c1") != 0 ||
+        strcmp(snap.elems[0].tm_name, "t1") != 0 ||
+        strcmp(snap.elems[0].tv_name, "tv1") != 0 ||
+        snap.elems[0].type != SC_PERF_TYPE_UINT64 ||
+        snap.elems[0].ui64 != 10) {
+        printf("elem 0 wrong: ");
+        goto end;
+    }
+
+    if (strcmp(snap.elems[1].cname, "c3") != 0 ||
+        snap.elems[1].type != SC_PERF_TYPE_DOUBLE ||
+        snap.elems[1].d != 2.5) {
+        printf("elem 1 wrong: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (snap.elems != NULL)
+        SCFree(snap.elems);
+    SCPerfReleasePerfCounterS(tv.sc_perf_pctx.head);
+    SCPerfReleasePCA(pca);
+    return result;
+}
+
+/**
+ * \test histogram buckets cover all values without gaps
+ */
+static int SCPerfTestHistogram21()
+{
+    uint64_t values[] = { 0, 1, 3, 4, 5, 7, 8, 9, 10, 15, 16, 1000, 123456789,
+                          (7ULL << (SC_PERF_HIST_MAX_BITS - 3)),
+                          (1ULL << SC_PERF_HIST_MAX_BITS) - 1 };
+    uint32_t u = 0;
+    uint32_t b = 0;
+
+    for (u = 0; u < sizeof(values) / sizeof(values[0]); u++) {
+        b = SCPerfHistogramBucket(values[u]);
+        if (b >= SC_PERF_HIST_BUCKETS) {
+            printf("value %"PRIu64" bucket %u out of range: ", values[u], b);
+            return 0;
+        }
+        if (SCPerfHistogramBucketMax(b) < values[u] ||
+            (b > 0 && SCPerfHistogramBucketMax(b - 1) >= values[u])) {
+            printf("value %"PRIu64" in wrong bucket %u: ", values[u], b);
+            return 0;
+        }
+    }
+
+    /* every bucket starts right after the previous one */
+    for (b = 1; b < SC_PERF_HIST_BUCKETS; b++) {
+        if (SCPerfHistogramBucket(SCPerfHistogramBucketMax(b - 1) + 1) != b ||
+            SCPerfHistogramBucket(SCPerfHistogramBucketMax(b)) != b) {
+            printf("bucket %u: ", b);
+            return 0;
+        }
+    }
+
+    /* the last regular bucket ends right below the overflow bucket */
+    if (SCPerfHistogramBucketMax(SC_PERF_HIST_BUCKETS - 1) !=
+            (1ULL << SC_PERF_HIST_MAX_BITS) - 1) {
+        printf("last bucket ends at %"PRIu64": ",
+               SCPerfHistogramBucketMax(SC_PERF_HIST_BUCKETS - 1));
+        return 0;
+    }
+
+    if (SCPerfHistogramBucket(1ULL << SC_PERF_HIST_MAX_BITS) != SC_PERF_HIST_OVERFLOW ||
+        SCPerfHistogramBucket(UINT64_MAX) != SC_PERF_HIST_OVERFLOW ||
+        SCPerfHistogramBucketMax(SC_PERF_HIST_OVERFLOW) != UINT64_MAX)
+        return 0;
+
+    return 1;
+}
+
+/**
+ * \test histogram recording, syncing and text exposition
+ */
+static int SCPerfTestHistogram22()
+{
+    ThreadVars tv;
+    SCPerfCounterArray *pca = NULL;
+    SCPerfSnapshot snap;
+    char *text = NULL;
+    int result = 0;
+
+    uint16_t id1, id2;
+
+    memset(&tv, 0, sizeof(ThreadVars));
+    memset(&snap, 0, sizeof(SCPerfSnapshot));
+
+    id1 = SCPerfRegisterHistogramCounter("t1.ticks", "t1", NULL,
+                                         &tv.sc_perf_pctx);
+    id2 = SCPerfRegisterCounter("t1.pkts", "t1", SC_PERF_TYPE_UINT64, NULL,
+                                &tv.sc_perf_pctx);
+
+    pca = SCPerfGetAllCountersArray(&tv.sc_perf_pctx);
+    if (pca == NULL || pca->head[id1].hist == NULL || pca->head[id2].hist != NULL)
+        goto end;
+
+    SCPerfCounterRecordHistogram(id1, pca, 2);
+    SCPerfCounterRecordHistogram(id1, pca, 2);
+    SCPerfCounterRecordHistogram(id1, pca, 9);
+    SCPerfCounterRecordHistogram(id1, pca, 1ULL << 50);
+    /* last regular bucket, not the overflow one */
+    SCPerfCounterRecordHistogram(id1, pca, (1ULL << SC_PERF_HIST_MAX_BITS) - 1);
+    /* not a histogram */
+    SCPerfCounterRecordHistogram(id2, pca, 1);
+    SCPerfCounterIncr(id2, pca);
+
+    SCPerfUpdateCounterArray(pca, &tv.sc_perf_pctx, 0);
+
+    if (*((uint64_t *)tv.sc_perf_pctx.head->value->cvalue) != 5 ||
+        tv.sc_perf_pctx.head->hist[2] != 2 ||
+        tv.sc_perf_pctx.head->hist[8] != 1 ||
+        tv.sc_perf_pctx.head->hist[SC_PERF_HIST_BUCKETS - 1] != 1 ||
+        tv.sc_perf_pctx.head->hist[SC_PERF_HIST_OVERFLOW] != 1 ||
+        tv.sc_perf_pctx.head->hist[SC_PERF_HIST_SUM] !=
+            12 + (1ULL << 50) + (1ULL << SC_PERF_HIST_MAX_BITS)) {
+        printf("global histogram wrong: ");
+        goto end;
+    }
+
+    if (SCPerfSnapshotAddContext(&snap, &tv.sc_perf_pctx, "W#01") != 0)
+        goto end;
+    if (snap.size != 2 || snap.hist_size != 1 || snap.elems[0].hist != 0 ||
+        snap.elems[1].hist != -1) {
+        printf("snapshot wrong: ");
+        goto end;
+    }
+
+    text = SCPerfSnapshotToText(&snap);
+    if (text == NULL)
+        goto end;
+
+    if (strstr(text, "# TYPE suricata_t1_ticks histogram\n") == NULL ||
+        strstr(text, "suricata_t1_ticks_bucket{thread=\"W#01\",le=\"2\"} 2\n") == NULL ||
+        strstr(text, "suricata_t1_ticks_bucket{thread=\"W#01\",le=\"9\"} 3\n") == NULL ||
+        strstr(text, "suricata_t1_ticks_bucket{thread=\"W#01\",le=\"1099511627775\"} 4\n") == NULL ||
+        strstr(text, "suricata_t1_ticks_bucket{thread=\"W#01\",le=\"+Inf\"} 5\n") == NULL ||
+        strstr(text, "suricata_t1_ticks_count{thread=\"W#01\"} 5\n") == NULL ||
+        strstr(text, "# TYPE suricata_t1_pkts untyped\n") == NULL ||
+        strstr(text, "suricata_t1_pkts{thread=\"W#01\"} 1\n") == NULL) {
+        printf("text wrong: \"%s\": ", text);
+        goto end;
+    }
+
+    /* the counters are sorted by name */
+    if (strstr(text, "suricata_t1_pkts") > strstr(text, "suricata_t1_ticks"))
+        goto end;
+
+    result = 1;
+end:
+    if (text != NULL)
+        SCFree(text);
+    if (snap.elems != NULL)
+        SCFree(snap.elems);
+    if (snap.hist != NULL)
+        SCFree(snap.hist);
+    SCPerfReleasePerfCounterS(tv.sc_perf_pctx.head);
+    SCPerfReleasePCA(pca);
+    return result;
+}
 #endif
 
 void SCPerfRegisterTests()
@@ -2663,5 +3544,9 @@ void SCPerfRegisterTests()
     UtRegisterTest("SCPerfTestIntervalQual16", SCPerfTestIntervalQual16, 1);
     UtRegisterTest("SCPerfTestIntervalQual17", SCPerfTestIntervalQual17, 1);
     UtRegisterTest("SCPerfTestIntervalQual18", SCPerfTestIntervalQual18, 1);
+    UtRegisterTest("SCPerfTestIntervalQual19", SCPerfTestIntervalQual19, 1);
+    UtRegisterTest("SCPerfTestSnapshot20", SCPerfTestSnapshot20, 1);
+    UtRegisterTest("SCPerfTestHistogram21", SCPerfTestHistogram21, 1);
+    UtRegisterTest("SCPerfTestHistogram22", SCPerfTestHistogram22, 1);
 #endif
 }
@@ -52,9 +52,25 @@ enum {
     SC_PERF_TYPE_Q_AVERAGE = 0x02,
     SC_PERF_TYPE_Q_MAXIMUM = 0x04,
     SC_PERF_TYPE_Q_TIMEBASED = 0x08,
-    SC_PERF_TYPE_Q_MAX = 0x10,
+    SC_PERF_TYPE_Q_HISTOGRAM = 0x10,
+    SC_PERF_TYPE_Q_MAX = 0x20,
 };
 
+/* Histogram counters use log-linear buckets.  Values below
+ * (1 << SC_PERF_HIST_SUB_BITS) have a bucket each, every power of 2 above
+ * that is split in (1 << SC_PERF_HIST_SUB_BITS) buckets, up to
+ * (1 << SC_PERF_HIST_MAX_BITS).  Larger values go to a separate overflow
+ * bucket. */
+#define SC_PERF_HIST_SUB_BITS   2
+#define SC_PERF_HIST_MAX_BITS   40
+#define SC_PERF_HIST_BUCKETS    ((SC_PERF_HIST_MAX_BITS - SC_PERF_HIST_SUB_BITS + 1) \
+                                 << SC_PERF_HIST_SUB_BITS)
+#define SC_PERF_HIST_OVERFLOW   SC_PERF_HIST_BUCKETS
+/* the sum of all recorded values */
+#define SC_PERF_HIST_SUM        (SC_PERF_HIST_BUCKETS + 1)
+/* the buckets, the overflow bucket and the sum */
+#define SC_PERF_HIST_SIZE       (SC_PERF_HIST_BUCKETS + 2)
+
 /**
  * \brief Different output interfaces made available by the Perf counter API
  */
@@ -96,8 +112,17 @@ typedef struct SCPerfCounterTypeQ_ {
 
     /* the time interval that corresponds to the value stored for this counter.
      * Used for time_based_counters(tbc).  This represents the time period over
-     * which the value in this counter was accumulated. */
-    uint8_t tbc_secs;
+     * which the value in this counter was accumulated.  Only written by the
+     * thread owning the counter, it keeps growing like the value itself */
+    double tbc_secs;
+
+    /* value and interval as seen by the last output.  Only touched by the
+     * output side, so the output never has to reset the global counter */
+    double tbc_secs_out;
+    union {
+        uint64_t ui64_out;
+        double d_out;
+    };
 } SCPerfCounterTypeQ;
 
 /**
@@ -122,6 +147,10 @@ typedef struct SCPerfCounter_ {
     /* counter qualifier */
     SCPerfCounterTypeQ *type_q;
 
+    /* buckets and sum of a histogram counter, the value holds the count.
+     * Like the value, only written by the thread owning the counter */
+    uint64_t *hist;
+
     /* the next perfcounter for this tv's tm instance */
     struct SCPerfCounter_ *next;
 } SCPerfCounter;
@@ -138,9 +167,6 @@ typedef struct SCPerfContext_ {
 
     /* holds the total no of counters already assigned for this perf context */
     uint16_t curr_id;
-
-    /* mutex to prevent simultaneous access during update_counter/output_stat */
-    SCMutex m;
 } SCPerfContext;
 
 /**
@@ -167,6 +193,9 @@ typedef struct SCPCAElem_ {
     /* timestamp to indicate the time, when the counter was last used to update
      * the global counter.  It is used for timebased counter calculations */
     struct timeval ts;
+
+    /* local buckets and sum of a histogram counter, NULL otherwise */
+    uint64_t *hist;
 } SCPCAElem;
 
 /**
@@ -174,7 +203,8 @@ typedef struct SCPCAElem_ {
  *        registered
  */
 typedef struct SCPerfCounterArray_ {
-    /* points to the array holding PCAElems */
+    /* points to the array holding PCAElems.  The array is cache line aligned
+     * and padded, as it's only ever touched by the thread owning it */
     SCPCAElem *head;
 
     /* no of PCAElems in head */
@@ -197,6 +227,45 @@ typedef struct SCPerfClubTMInst_ {
 /**
  * \brief Holds the output interface context for the counter api
  */
+/** a single counter value in a SCPerfSnapshot */
+typedef struct SCPerfSnapshotElem_ {
+    /* name of the thread, or the tm name if the counters are clubbed */
+    const char *tv_name;
+    const char *tm_name;
+    const char *cname;
+
+    /* SC_PERF_TYPE_UINT64 or SC_PERF_TYPE_DOUBLE */
+    uint32_t type;
+
+    union {
+        uint64_t ui64;
+        double d;
+    };
+
+    /* index of the buckets in SCPerfSnapshot::hist if this is a histogram
+     * counter, -1 otherwise */
+    int hist;
+} SCPerfSnapshotElem;
+
+/** binary snapshot of all counters, as built by the last aggregation.  The
+ *  names point to the registered counters and are not copied. */
+typedef struct SCPerfSnapshot_ {
+    /* time of the aggregation */
+    struct timeval ts;
+
+    /* values of the same tm instances are clubbed */
+    int clubbed;
+
+    SCPerfSnapshotElem *elems;
+    uint32_t size;
+    uint32_t alloc;
+
+    /* buckets of the histogram counters, SC_PERF_HIST_SIZE values each */
+    uint64_t *hist;
+    uint32_t hist_size;
+    uint32_t hist_alloc;
+} SCPerfSnapshot;
+
 typedef struct SCPerfOPIfaceContext_ {
     /* the iface to be used for output */
     uint32_t iface;
@@ -213,6 +282,10 @@ typedef struct SCPerfOPIfaceContext_ {
 
     SCPerfClubTMInst *pctmi;
     SCMutex pctmi_lock;
+
+    /* the last aggregated values, shared by all outputs */
+    SCPerfSnapshot snapshot;
+    SCMutex snapshot_lock;
 } SCPerfOPIfaceContext;
 
 /* the initialization functions */
@@ -225,6 +298,7 @@ uint16_t SCPerfTVRegisterAvgCounter(char *, struct ThreadVars_ *, int, char *);
 uint16_t SCPerfTVRegisterMaxCounter(char *, struct ThreadVars_ *, int, char *);
 uint16_t SCPerfTVRegisterIntervalCounter(char *, struct ThreadVars_ *, int,
                                          char *, char *);
+uint16_t SCPerfTVRegisterHistogramCounter(char *, struct ThreadVars_ *, char *);
 
 /* the non-ThreadVars counter registration functions */
 uint16_t SCPerfRegisterCounter(char *, char *, int, char *, SCPerfContext *);
@@ -232,6 +306,7 @@ uint16_t SCPerfRegisterAvgCounter(char *, char *, int, char *, SCPerfContext *);
 uint16_t SCPerfRegisterMaxCounter(char *, char *, int, char *, SCPerfContext *);
 uint16_t SCPerfRegisterIntervalCounter(char *, char *, int, char *,
                                        SCPerfContext *, char *);
+uint16_t SCPerfRegisterHistogramCounter(char *, char *, char *, SCPerfContext *);
 
 /* utility functions */
 int SCPerfAddToClubbedTMTable(char *, SCPerfContext *);
@@ -244,6 +319,10 @@ double SCPerfGetLocalCounterValue(uint16_t, SCPerfCounterArray *);
 
 void SCPerfOutputCounters(void);
 
+SCPerfSnapshot *SCPerfSnapshotGet(void);
+void SCPerfSnapshotFree(SCPerfSnapshot *);
+char *SCPerfSnapshotToText(const SCPerfSnapshot *);
+
 /* functions used to free the resources alloted by the Perf counter API */
 void SCPerfReleaseResources(void);
 void SCPerfReleasePerfCounterS(SCPerfCounter *);
@@ -258,6 +337,10 @@ void SCPerfRegisterTests(void);
 /* functions used to update local counter values */
 void SCPerfCounterAddUI64(uint16_t, SCPerfCounterArray *, uint64_t);
 void SCPerfCounterAddDouble(uint16_t, SCPerfCounterArray *, double);
+void SCPerfCounterRecordHistogram(uint16_t, SCPerfCounterArray *, uint64_t);
+
+uint32_t SCPerfHistogramBucket(uint64_t);
+uint64_t SCPerfHistogramBucketMax(uint32_t);
 
 #define SCPerfSyncCounters(tv, reset_lc) \
     SCPerfUpdateCounterArray((tv)->sc_perf_pca, &(tv)->sc_perf_pctx, (reset_lc)); \
@@ -273,6 +356,8 @@ void SCPerfCounterAddDouble(uint16_t, SCPerfCounterArray *, double);
 #include <jansson.h>
 TmEcode SCPerfOutputCounterSocket(json_t *cmd,
                                json_t *answer, void *data);
+TmEcode SCPerfOutputMetricsSocket(json_t *cmd,
+                               json_t *answer, void *data);
 #endif
 
 #endif /* __COUNTERS_H__ */
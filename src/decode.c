@@ -112,6 +112,7 @@ Packet *PacketGetFromAlloc(void)
     SCLogDebug("allocated a new packet only using alloc...");
 
     PACKET_PROFILING_START(p);
+    PACKET_PROFILING_SAMPLE_START(p);
     return p;
 }
 
@@ -126,6 +127,22 @@ void PacketFreeOrRelease(Packet *p)
         PacketPoolReturnPacket(p);
 }
 
+/**
+ *  \brief Ask the capture method to bypass the rest of the packet's flow
+ *
+ *  \param p packet of the bypassed flow
+ *
+ *  \retval 1 the capture method will stop passing us the flow's packets
+ *  \retval 0 not supported, the flow is only bypassed locally
+ */
+int PacketBypassCallback(Packet *p)
+{
+    if (p->BypassPacketsFlow == NULL)
+        return 0;
+
+    return p->BypassPacketsFlow(p);
+}
+
 /**
  *  \brief Get a packet. We try to get a packet from the packetpool first, but
  *         if that is empty we alloc a packet that is free'd again after
@@ -147,6 +164,7 @@ Packet *PacketGetFromQueueOrAlloc(void)
         p = PacketGetFromAlloc();
     } else {
         PACKET_PROFILING_START(p);
+        PACKET_PROFILING_SAMPLE_START(p);
     }
 
     return p;
@@ -333,6 +333,13 @@ typedef struct PktProfiling_ {
 
 #endif /* PROFILING */
 
+/** \brief Per pkt storage of the sampling profiler, ticks_start is 0
+ *         if the packet is not sampled */
+typedef struct PktProfilingSample_ {
+    uint64_t ticks_start;
+    uint64_t tmm_ticks_start;
+} PktProfilingSample;
+
 /* forward declartion since Packet struct definition requires this */
 struct PacketQueue_;
 
@@ -421,6 +428,10 @@ typedef struct Packet_
     /** The release function for packet structure and data */
     void (*ReleasePacket)(struct Packet_ *);
 
+    /** capture method callback to bypass the rest of the packet's flow
+     *  in the capture itself, NULL if the method can't. */
+    int (*BypassPacketsFlow)(struct Packet_ *);
+
     /* pkt vars */
     PktVar *pktvar;
 
@@ -506,6 +517,7 @@ typedef struct Packet_
 #ifdef PROFILING
     PktProfiling profile;
 #endif
+    PktProfilingSample profile_sample;
 #ifdef __SC_CUDA_SUPPORT__
     CudaPacketVars cuda_pkt_vars;
 #endif
@@ -663,6 +675,7 @@ typedef struct DecodeThreadVars_
         (p)->ts.tv_usec = 0;                    \
         (p)->datalink = 0;                      \
         (p)->action = 0;                        \
+        (p)->BypassPacketsFlow = NULL;          \
         if ((p)->pktvar != NULL) {              \
             PktVarFree((p)->pktvar);            \
             (p)->pktvar = NULL;                 \
@@ -714,6 +727,7 @@ typedef struct DecodeThreadVars_
         (p)->livedev = NULL;                    \
         PACKET_RESET_CHECKSUMS((p));            \
         PACKET_PROFILING_RESET((p));            \
+        (p)->profile_sample.ticks_start = 0;    \
     } while (0)
 
 #define PACKET_RECYCLE(p) PACKET_DO_RECYCLE((p))
@@ -805,6 +819,7 @@ Packet *PacketGetFromQueueOrAlloc(void);
 Packet *PacketGetFromAlloc(void);
 void PacketFree(Packet *p);
 void PacketFreeOrRelease(Packet *p);
+int PacketBypassCallback(Packet *p);
 int PacketCopyData(Packet *p, uint8_t *pktdata, int pktlen);
 int PacketSetData(Packet *p, uint8_t *pktdata, int pktlen);
 int PacketCopyDataOffset(Packet *p, int offset, uint8_t *data, int datalen);
@@ -933,6 +948,8 @@ void AddressDebugPrint(Address *);
 
 #define PKT_IS_FRAGMENT                 (1<<19)     /**< Packet is a fragment */
 
+#define PKT_FLOW_BYPASSED               (1<<20)     /**< Packet belongs to a bypassed flow */
+
 /** \brief return 1 if the packet is a pseudo packet */
 #define PKT_IS_PSEUDOPKT(p) ((p)->flags & PKT_PSEUDO_STREAM_END)
 
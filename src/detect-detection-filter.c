@@ -403,7 +403,7 @@ static int DetectDetectionFilterTestSig1(void) {
     int result = 0;
     int alerts = 0;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset(&th_v, 0, sizeof(th_v));
 
@@ -452,7 +452,7 @@ static int DetectDetectionFilterTestSig1(void) {
 
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -474,7 +474,7 @@ static int DetectDetectionFilterTestSig2(void) {
     int alerts = 0;
     struct timeval ts;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -529,7 +529,7 @@ static int DetectDetectionFilterTestSig2(void) {
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -546,7 +546,7 @@ static int DetectDetectionFilterTestSig3(void) {
     int drops = 0;
     struct timeval ts;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -626,7 +626,7 @@ static int DetectDetectionFilterTestSig3(void) {
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 #endif /* UNITTESTS */
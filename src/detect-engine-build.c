@@ -0,0 +1,730 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Helpers for SigGroupBuild(): a small worker pool to spread the
+ * independent parts of the build (mpm preparation, sgh finalization)
+ * over multiple cpus, and the build profile that records how long
+ * each stage took.
+ *
+ * The pool is only used during the build. The calling thread takes
+ * part in the work itself, so a pool of 1 simply runs everything
+ * inline.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+
+#include "detect.h"
+#include "detect-engine.h"
+#include "detect-engine-build.h"
+#include "detect-engine-mpm.h"
+#include "detect-parse.h"
+
+#include "util-mpm.h"
+#include "util-cpu.h"
+#include "util-atomic.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+/** don't bother spawning threads for less items than this */
+#define DETECT_ENGINE_BUILD_MIN_ITEMS 2
+
+typedef struct DetectEngineBuildJob_ {
+    DetectEngineCtx *de_ctx;
+    void **items;
+    uint32_t items_cnt;
+    DetectEngineBuildFunc Func;
+
+    /** next item to hand out */
+    SC_ATOMIC_DECLARE(uint32_t, next);
+    /** number of items for which Func returned an error */
+    SC_ATOMIC_DECLARE(uint32_t, errors);
+} DetectEngineBuildJob;
+
+/**
+ *  \brief get the number of threads to use for building the detection
+ *         engine.
+ *
+ *  Uses the detect-engine.build-threads setting if it was set, otherwise
+ *  the number of online cpus.
+ */
+uint16_t DetectEngineBuildGetThreads(DetectEngineCtx *de_ctx)
+{
+    if (de_ctx->build_threads > 0)
+        return de_ctx->build_threads;
+
+    uint16_t ncpus = UtilCpuGetNumProcessorsOnline();
+    if (ncpus == 0)
+        ncpus = 1;
+    return ncpus;
+}
+
+static void *DetectEngineBuildWorker(void *data)
+{
+    DetectEngineBuildJob *job = (DetectEngineBuildJob *)data;
+
+    while (1) {
+        /* SC_ATOMIC_ADD returns the new value */
+        uint32_t idx = SC_ATOMIC_ADD(job->next, 1) - 1;
+        if (idx >= job->items_cnt)
+            break;
+
+        if (job->items[idx] == NULL)
+            continue;
+
+        if (job->Func(job->de_ctx, job->items[idx]) < 0) {
+            (void)SC_ATOMIC_ADD(job->errors, 1);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  \brief Run Func on each item of an array, using up to 'threads'
+ *         threads. Items are handed out one by one, so expensive and
+ *         cheap items balance out over the threads.
+ *
+ *  \param de_ctx detection engine ctx, passed to Func
+ *  \param threads max number of threads to use, including the caller
+ *  \param items array of items. NULL items are skipped.
+ *  \param items_cnt number of items in the array
+ *  \param Func function to call for each item. Must only modify data
+ *              owned by the item.
+ *
+ *  \retval 0 ok
+ *  \retval -1 Func failed for one or more items
+ */
+int DetectEngineBuildRunParallel(DetectEngineCtx *de_ctx, uint16_t threads,
+        void **items, uint32_t items_cnt, DetectEngineBuildFunc Func)
+{
+    DetectEngineBuildJob job;
+    pthread_t *tids = NULL;
+    uint16_t spawned = 0;
+    uint16_t i;
+
+    if (items == NULL || items_cnt == 0)
+        return 0;
+
+    memset(&job, 0x00, sizeof(job));
+    job.de_ctx = de_ctx;
+    job.items = items;
+    job.items_cnt = items_cnt;
+    job.Func = Func;
+    SC_ATOMIC_INIT(job.next);
+    SC_ATOMIC_INIT(job.errors);
+
+    if (threads > items_cnt)
+        threads = (uint16_t)items_cnt;
+
+    if (threads > 1 && items_cnt >= DETECT_ENGINE_BUILD_MIN_ITEMS) {
+        tids = SCMalloc((threads - 1) * sizeof(pthread_t));
+        if (tids != NULL) {
+            for (i = 0; i < threads - 1; i++) {
+                if (pthread_create(&tids[i], NULL, DetectEngineBuildWorker, &job) != 0) {
+                    SCLogWarning(SC_ERR_THREAD_CREATE, "failed to create detect "
+                            "engine build thread: %s. Continuing with %u threads",
+                            strerror(errno), spawned + 1);
+                    break;
+                }
+                spawned++;
+            }
+        }
+    }
+
+    /* the caller is a worker as well */
+    (void)DetectEngineBuildWorker(&job);
+
+    for (i = 0; i < spawned; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    if (tids != NULL)
+        SCFree(tids);
+
+    uint32_t errors = SC_ATOMIC_GET(job.errors);
+    SC_ATOMIC_DESTROY(job.next);
+    SC_ATOMIC_DESTROY(job.errors);
+
+    if (errors > 0) {
+        SCLogError(SC_ERR_DETECT_PREPARE, "%u of %u items failed to build",
+                errors, items_cnt);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  \brief queue a mpm ctx for preparation
+ *
+ *  Preparing a mpm ctx (building the state tables, hashes, etc) is the
+ *  most expensive part of SigGroupBuild(). Each ctx is independent, so
+ *  we collect them while the sgh's are built and prepare them together
+ *  in DetectEngineBuildPrepareMpmCtxs().
+ */
+void DetectEngineBuildQueueMpmCtx(DetectEngineCtx *de_ctx, MpmCtx *mpm_ctx)
+{
+    if (mpm_ctx == NULL || mpm_table[mpm_ctx->mpm_type].Prepare == NULL)
+        return;
+
+    if (de_ctx->mpm_prepare_array_cnt == de_ctx->mpm_prepare_array_size) {
+        uint32_t size = de_ctx->mpm_prepare_array_size + 64;
+        MpmCtx **ptr = SCRealloc(de_ctx->mpm_prepare_array, size * sizeof(MpmCtx *));
+        if (ptr == NULL) {
+            /* can't queue it, so prepare it right away */
+            mpm_table[mpm_ctx->mpm_type].Prepare(mpm_ctx);
+            return;
+        }
+        de_ctx->mpm_prepare_array = ptr;
+        de_ctx->mpm_prepare_array_size = size;
+    }
+
+    de_ctx->mpm_prepare_array[de_ctx->mpm_prepare_array_cnt++] = mpm_ctx;
+}
+
+static int DetectEngineBuildPrepareMpmCtx(DetectEngineCtx *de_ctx, void *data)
+{
+    MpmCtx *mpm_ctx = (MpmCtx *)data;
+
+    if (mpm_table[mpm_ctx->mpm_type].Prepare(mpm_ctx) < 0)
+        return -1;
+    return 0;
+}
+
+static uint32_t DetectEngineBuildMpmCtxHash(HashTable *ht, void *data, uint16_t datalen)
+{
+    MpmCtx *mpm_ctx = (MpmCtx *)data;
+    return (uint32_t)(mpm_ctx->pattern_hash % ht->array_size);
+}
+
+static char DetectEngineBuildMpmCtxCompare(void *data1, uint16_t len1,
+        void *data2, uint16_t len2)
+{
+    return (char)MpmCtxIsEqual((MpmCtx *)data1, (MpmCtx *)data2);
+}
+
+/**
+ *  \internal
+ *  \brief On reload, let queued ctxs that have the same patterns as a ctx
+ *         of the engine we reload from use that ctx instead of preparing
+ *         their own copy.
+ *
+ *  \param prepare array that is filled with the ctxs that still need to
+ *                 be prepared
+ *
+ *  \retval cnt number of ctxs in the prepare array
+ */
+static uint32_t DetectEngineBuildShareMpmCtxs(DetectEngineCtx *de_ctx,
+        MpmCtx **prepare)
+{
+    DetectEngineCtx *src = de_ctx->reload_src;
+    uint32_t cnt = 0, shared = 0;
+    HashTable *ht = NULL;
+    uint32_t i;
+
+#ifdef __SC_CUDA_SUPPORT__
+    if (de_ctx->mpm_matcher == MPM_AC_CUDA)
+        src = NULL;
+#endif
+    if (src != NULL && src->mpm_prepare_array_cnt > 0) {
+        ht = HashTableInit(src->mpm_prepare_array_cnt,
+                DetectEngineBuildMpmCtxHash, DetectEngineBuildMpmCtxCompare, NULL);
+        if (ht != NULL) {
+            for (i = 0; i < src->mpm_prepare_array_cnt; i++) {
+                if (HashTableAdd(ht, src->mpm_prepare_array[i], sizeof(MpmCtx)) != 0) {
+                    HashTableFree(ht);
+                    ht = NULL;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < de_ctx->mpm_prepare_array_cnt; i++) {
+        MpmCtx *mpm_ctx = de_ctx->mpm_prepare_array[i];
+        MpmCtx *old = NULL;
+
+        if (ht != NULL)
+            old = HashTableLookup(ht, mpm_ctx, sizeof(MpmCtx));
+
+        if (old != NULL) {
+            MpmCtxShare(mpm_ctx, old);
+            shared++;
+        } else {
+            prepare[cnt++] = mpm_ctx;
+        }
+    }
+
+    if (ht != NULL) {
+        HashTableFree(ht);
+
+        if (!(de_ctx->flags & DE_QUIET)) {
+            SCLogInfo("%u of %u mpm ctxs shared with the previous detection "
+                    "engine", shared, de_ctx->mpm_prepare_array_cnt);
+        }
+    }
+    return cnt;
+}
+
+static int DetectEngineBuildMpmCtxCompareTables(const void *a, const void *b)
+{
+    const MpmCtx *ca = *(const MpmCtx **)a;
+    const MpmCtx *cb = *(const MpmCtx **)b;
+
+    if (ca->ctx == cb->ctx)
+        return 0;
+    return ((uintptr_t)ca->ctx < (uintptr_t)cb->ctx) ? -1 : 1;
+}
+
+/**
+ *  \internal
+ *  \brief Memory used by the matcher tables of a list of ctxs. Tables
+ *         that are shared by several ctxs are counted once.
+ */
+static uint64_t DetectEngineBuildMpmMemory(MpmCtx **array, uint32_t cnt)
+{
+    uint64_t size = 0;
+    uint32_t i;
+
+    if (cnt == 0)
+        return 0;
+
+    MpmCtx **sorted = SCMalloc(cnt * sizeof(MpmCtx *));
+    if (sorted == NULL)
+        return 0;
+    memcpy(sorted, array, cnt * sizeof(MpmCtx *));
+    qsort(sorted, cnt, sizeof(MpmCtx *), DetectEngineBuildMpmCtxCompareTables);
+
+    for (i = 0; i < cnt; i++) {
+        if (i > 0 && sorted[i]->ctx == sorted[i - 1]->ctx)
+            continue;
+        size += sorted[i]->memory_size;
+    }
+    SCFree(sorted);
+    return size;
+}
+
+/**
+ *  \internal
+ *  \brief Record the mpm memory of the engine and, on reload, the peak
+ *         while both engines are alive: all tables of the engine we
+ *         reload from plus the tables only the new engine uses.
+ *
+ *  \param own the ctxs that were prepared for this engine
+ */
+static void DetectEngineBuildMpmMemoryStats(DetectEngineCtx *de_ctx,
+        MpmCtx **own, uint32_t own_cnt)
+{
+    DetectEngineCtx *src = de_ctx->reload_src;
+
+    de_ctx->mpm_memory = DetectEngineBuildMpmMemory(de_ctx->mpm_prepare_array,
+            de_ctx->mpm_prepare_array_cnt);
+    if (src == NULL) {
+        de_ctx->reload_mpm_memory_peak = 0;
+        return;
+    }
+
+    de_ctx->reload_mpm_memory_peak = DetectEngineBuildMpmMemory(
+            src->mpm_prepare_array, src->mpm_prepare_array_cnt) +
+        DetectEngineBuildMpmMemory(own, own_cnt);
+
+    if (!(de_ctx->flags & DE_QUIET) && de_ctx->mpm_memory > 0) {
+        uint64_t pct = de_ctx->reload_mpm_memory_peak * 100 / de_ctx->mpm_memory;
+        SCLogInfo("rule reload: mpm memory %"PRIu64" KiB, peak while both "
+                "engines are alive %"PRIu64" KiB (%"PRIu64"%%)",
+                de_ctx->mpm_memory / 1024,
+                de_ctx->reload_mpm_memory_peak / 1024, pct);
+    }
+}
+
+/**
+ *  \brief prepare all queued mpm ctxs.
+ *
+ *  The queue is kept until SigGroupCleanup(), as it's the list of all
+ *  mpm ctxs of the engine: an engine reloading from this one uses it to
+ *  find ctxs it can share. The pattern lists recorded for the ctxs are
+ *  only needed for the share pass, after it they're replaced by a digest.
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int DetectEngineBuildPrepareMpmCtxs(DetectEngineCtx *de_ctx)
+{
+    uint16_t threads = DetectEngineBuildGetThreads(de_ctx);
+
+    if (de_ctx->mpm_prepare_array_cnt == 0)
+        return 0;
+
+    if (mpm_table[de_ctx->mpm_matcher].flags & MPM_TABLE_FLAG_PREPARE_SERIAL) {
+        SCLogDebug("mpm %s doesn't support parallel preparation",
+                mpm_table[de_ctx->mpm_matcher].name);
+        threads = 1;
+    }
+#ifdef __SC_CUDA_SUPPORT__
+    /* the cuda context is pushed to the current thread only */
+    if (de_ctx->mpm_matcher == MPM_AC_CUDA)
+        threads = 1;
+#endif
+
+    MpmCtx **prepare = SCMalloc(de_ctx->mpm_prepare_array_cnt * sizeof(MpmCtx *));
+    if (prepare == NULL)
+        return -1;
+
+    uint32_t cnt = DetectEngineBuildShareMpmCtxs(de_ctx, prepare);
+
+    int r = DetectEngineBuildRunParallel(de_ctx, threads, (void **)prepare,
+            cnt, DetectEngineBuildPrepareMpmCtx);
+
+    uint32_t i;
+    for (i = 0; i < de_ctx->mpm_prepare_array_cnt; i++)
+        MpmCtxReleasePatterns(de_ctx->mpm_prepare_array[i]);
+
+    if (r == 0)
+        DetectEngineBuildMpmMemoryStats(de_ctx, prepare, cnt);
+
+    SCFree(prepare);
+    return r;
+}
+
+void DetectEngineBuildFreeMpmQueue(DetectEngineCtx *de_ctx)
+{
+    if (de_ctx->mpm_prepare_array != NULL)
+        SCFree(de_ctx->mpm_prepare_array);
+    de_ctx->mpm_prepare_array = NULL;
+    de_ctx->mpm_prepare_array_cnt = 0;
+    de_ctx->mpm_prepare_array_size = 0;
+}
+
+void DetectEngineBuildProfileStart(DetectEngineCtx *de_ctx,
+        DetectEngineBuildProfile *profile)
+{
+    memset(profile, 0x00, sizeof(*profile));
+    profile->threads = DetectEngineBuildGetThreads(de_ctx);
+    gettimeofday(&profile->start_ts, NULL);
+    profile->stage_ts = profile->start_ts;
+}
+
+/**
+ *  \brief close the current stage and record its duration
+ *
+ *  \param name stage name, must be a static string
+ *  \param items number of items processed by the stage, or 0
+ */
+void DetectEngineBuildProfileStage(DetectEngineBuildProfile *profile,
+        const char *name, uint32_t items)
+{
+    struct timeval ts;
+    gettimeofday(&ts, NULL);
+
+    if (profile->stage_cnt < DETECT_ENGINE_BUILD_PROFILE_MAX) {
+        DetectEngineBuildProfileEntry *stage = &profile->stages[profile->stage_cnt++];
+        stage->name = name;
+        stage->items = items;
+        stage->usecs = (uint64_t)(ts.tv_sec - profile->stage_ts.tv_sec) * 1000000ULL +
+            (ts.tv_usec - profile->stage_ts.tv_usec);
+    }
+    profile->stage_ts = ts;
+}
+
+/**
+ *  \brief log the build profile
+ */
+void DetectEngineBuildProfileLog(DetectEngineCtx *de_ctx,
+        DetectEngineBuildProfile *profile)
+{
+    uint64_t total = (uint64_t)(profile->stage_ts.tv_sec - profile->start_ts.tv_sec) * 1000000ULL +
+        (profile->stage_ts.tv_usec - profile->start_ts.tv_usec);
+    uint16_t i;
+
+    if (de_ctx->flags & DE_QUIET)
+        return;
+
+    SCLogInfo("detect engine build profile: %u threads, total %"PRIu64" ms",
+            profile->threads, total / 1000);
+
+    for (i = 0; i < profile->stage_cnt; i++) {
+        DetectEngineBuildProfileEntry *stage = &profile->stages[i];
+        if (stage->items > 0) {
+            SCLogInfo("  %-16s %8"PRIu64" ms (%u items)", stage->name,
+                    stage->usecs / 1000, stage->items);
+        } else {
+            SCLogInfo("  %-16s %8"PRIu64" ms", stage->name, stage->usecs / 1000);
+        }
+    }
+}
+
+/* UNITTESTS */
+#ifdef UNITTESTS
+
+static int DetectEngineBuildTestIncr(DetectEngineCtx *de_ctx, void *data)
+{
+    uint32_t *cnt = (uint32_t *)data;
+    (void)SCAtomicFetchAndAdd(cnt, 1);
+    return 0;
+}
+
+static int DetectEngineBuildTestFail(DetectEngineCtx *de_ctx, void *data)
+{
+    uint32_t *cnt = (uint32_t *)data;
+    return (*cnt == 1) ? -1 : 0;
+}
+
+/**
+ * \test every item is handed out exactly once
+ */
+static int DetectEngineBuildTest01(void)
+{
+    uint32_t cnts[1000];
+    void *items[1000];
+    int result = 0;
+    uint32_t i;
+
+    memset(cnts, 0x00, sizeof(cnts));
+    for (i = 0; i < 1000; i++) {
+        items[i] = &cnts[i];
+    }
+    items[500] = NULL;
+
+    if (DetectEngineBuildRunParallel(NULL, 8, items, 1000,
+                DetectEngineBuildTestIncr) != 0)
+        goto end;
+
+    for (i = 0; i < 1000; i++) {
+        if (cnts[i] != (i == 500 ? 0 : 1)) {
+            printf("item %u processed %u times: ", i, cnts[i]);
+            goto end;
+        }
+    }
+
+    result = 1;
+end:
+    return result;
+}
+
+/**
+ * \test errors of a single item are reported
+ */
+static int DetectEngineBuildTest02(void)
+{
+    uint32_t cnts[64];
+    void *items[64];
+    uint32_t i;
+
+    memset(cnts, 0x00, sizeof(cnts));
+    for (i = 0; i < 64; i++) {
+        items[i] = &cnts[i];
+    }
+    cnts[10] = 1;
+
+    if (DetectEngineBuildRunParallel(NULL, 4, items, 64,
+                DetectEngineBuildTestFail) != -1)
+        return 0;
+
+    cnts[10] = 0;
+    if (DetectEngineBuildRunParallel(NULL, 4, items, 64,
+                DetectEngineBuildTestFail) != 0)
+        return 0;
+
+    return 1;
+}
+
+/**
+ * \test build the engine with multiple threads and make sure the
+ *       prepared mpm ctxs match.
+ */
+static int DetectEngineBuildTest03(void)
+{
+    int result = 0;
+    uint8_t *buf = (uint8_t *)"GET /one/two HTTP/1.0\r\n"
+                              "Host: three\r\n\r\n";
+    uint16_t buflen = strlen((char *)buf);
+    Packet *p[2] = { NULL, NULL };
+    char *sigs[4];
+    uint32_t sid[4] = { 1, 2, 3, 4 };
+    uint32_t results[8] = {
+        1, 1, 0, 1,
+        1, 0, 1, 0,
+    };
+
+    p[0] = UTHBuildPacketSrcDstPorts(buf, buflen, IPPROTO_TCP, 1024, 80);
+    p[1] = UTHBuildPacketSrcDstPorts(buf, buflen, IPPROTO_TCP, 1024, 8080);
+    if (p[0] == NULL || p[1] == NULL)
+        goto end;
+
+    sigs[0] = "alert tcp any any -> any any (content:\"/one/\"; sid:1;)";
+    sigs[1] = "alert tcp any any -> any 80 (content:\"Host\"; sid:2;)";
+    sigs[2] = "alert tcp any any -> any !80 (content:\"three\"; sid:3;)";
+    sigs[3] = "alert tcp any any -> any 80 (content:\"two\"; content:\"HTTP\"; sid:4;)";
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL)
+        goto end;
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->build_threads = 4;
+
+    if (UTHAppendSigs(de_ctx, sigs, 4) == 0)
+        goto cleanup;
+
+    result = UTHMatchPacketsWithResults(de_ctx, p, 2, sid, results, 4);
+
+    /* queue is kept as the list of mpm ctxs of the engine */
+    if (de_ctx->mpm_prepare_array == NULL || de_ctx->mpm_prepare_array_cnt == 0)
+        result = 0;
+
+cleanup:
+    SigGroupCleanup(de_ctx);
+    if (de_ctx->mpm_prepare_array != NULL || de_ctx->mpm_prepare_array_cnt != 0)
+        result = 0;
+    SigCleanSignatures(de_ctx);
+    DetectEngineCtxFree(de_ctx);
+end:
+    UTHFreePackets(p, 2);
+    return result;
+}
+
+/**
+ * \test reload: mpm ctxs of the old engine are shared with the new one
+ *       and remain usable after the old engine is freed.
+ */
+static int DetectEngineBuildTest04(void)
+{
+    int result = 0;
+    uint8_t *buf = (uint8_t *)"GET /one/two HTTP/1.0\r\n"
+                              "Host: three\r\n\r\n";
+    uint16_t buflen = strlen((char *)buf);
+    Packet *p = NULL;
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    DetectEngineCtx *old_de_ctx = NULL;
+    DetectEngineCtx *de_ctx = NULL;
+    char *sigs[3];
+    uint32_t i, shared = 0;
+
+    memset(&th_v, 0, sizeof(th_v));
+
+    p = UTHBuildPacketSrcDstPorts(buf, buflen, IPPROTO_TCP, 1024, 80);
+    if (p == NULL)
+        goto end;
+
+    sigs[0] = "alert tcp any any -> any any (content:\"/one/\"; sid:1;)";
+    sigs[1] = "alert tcp any any -> any 80 (content:\"Host\"; sid:2;)";
+    sigs[2] = "alert tcp any any -> any 8080 (content:\"three\"; sid:3;)";
+
+    MpmSetRecordPatterns(1);
+
+    old_de_ctx = DetectEngineCtxInit();
+    if (old_de_ctx == NULL)
+        goto end;
+    old_de_ctx->flags |= DE_QUIET;
+    if (UTHAppendSigs(old_de_ctx, sigs, 3) == 0)
+        goto end;
+    SigGroupBuild(old_de_ctx);
+
+    de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL)
+        goto end;
+    de_ctx->flags |= DE_QUIET;
+    if (DetectEngineReloadStart(de_ctx, old_de_ctx) != 0)
+        goto end;
+    if (UTHAppendSigs(de_ctx, sigs, 3) == 0)
+        goto end;
+    SigGroupBuild(de_ctx);
+    DetectEngineReloadDone(de_ctx);
+
+    if (de_ctx->reload_src != NULL) {
+        printf("reload state not updated: ");
+        goto end;
+    }
+
+    for (i = 0; i < de_ctx->mpm_prepare_array_cnt; i++) {
+        if (de_ctx->mpm_prepare_array[i]->refcnt != NULL)
+            shared++;
+    }
+    if (shared == 0 || shared != de_ctx->mpm_prepare_array_cnt) {
+        printf("%u of %u mpm ctxs shared: ", shared, de_ctx->mpm_prepare_array_cnt);
+        goto end;
+    }
+
+    /* pattern copies are released once the engines are built */
+    for (i = 0; i < de_ctx->mpm_prepare_array_cnt; i++) {
+        if (de_ctx->mpm_prepare_array[i]->patterns != NULL) {
+            printf("pattern list kept: ");
+            goto end;
+        }
+    }
+    for (i = 0; i < old_de_ctx->mpm_prepare_array_cnt; i++) {
+        if (old_de_ctx->mpm_prepare_array[i]->patterns != NULL) {
+            printf("pattern list of the old engine kept: ");
+            goto end;
+        }
+    }
+
+    /* nothing changed, so nothing was built twice */
+    if (de_ctx->mpm_memory == 0 ||
+        de_ctx->reload_mpm_memory_peak * 10 > de_ctx->mpm_memory * 12) {
+        printf("reload peak %"PRIu64" for %"PRIu64" steady: ",
+                de_ctx->reload_mpm_memory_peak, de_ctx->mpm_memory);
+        goto end;
+    }
+
+    /* the new engine must work without the old one */
+    SigGroupCleanup(old_de_ctx);
+    SigCleanSignatures(old_de_ctx);
+    DetectEngineCtxFree(old_de_ctx);
+    old_de_ctx = NULL;
+
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+
+    if (!PacketAlertCheck(p, 1) || !PacketAlertCheck(p, 2) ||
+        PacketAlertCheck(p, 3)) {
+        printf("wrong alerts: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (det_ctx != NULL)
+        DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    if (old_de_ctx != NULL) {
+        SigGroupCleanup(old_de_ctx);
+        SigCleanSignatures(old_de_ctx);
+        DetectEngineCtxFree(old_de_ctx);
+    }
+    if (de_ctx != NULL) {
+        SigGroupCleanup(de_ctx);
+        SigCleanSignatures(de_ctx);
+        DetectEngineCtxFree(de_ctx);
+    }
+    UTHFreePackets(&p, 1);
+    MpmSetRecordPatterns(0);
+    return result;
+}
+#endif /* UNITTESTS */
+
+void DetectEngineBuildRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("DetectEngineBuildTest01", DetectEngineBuildTest01, 1);
+    UtRegisterTest("DetectEngineBuildTest02", DetectEngineBuildTest02, 1);
+    UtRegisterTest("DetectEngineBuildTest03", DetectEngineBuildTest03, 1);
+    UtRegisterTest("DetectEngineBuildTest04", DetectEngineBuildTest04, 1);
+#endif /* UNITTESTS */
+}
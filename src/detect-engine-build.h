@@ -0,0 +1,56 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __DETECT_ENGINE_BUILD_H__
+#define __DETECT_ENGINE_BUILD_H__
+
+/** max number of stages we keep timings for in the build profile */
+#define DETECT_ENGINE_BUILD_PROFILE_MAX 16
+
+typedef struct DetectEngineBuildProfileEntry_ {
+    const char *name;
+    uint64_t usecs;
+    uint32_t items;     /**< number of items processed, 0 if not applicable */
+} DetectEngineBuildProfileEntry;
+
+/** \brief timings of a single SigGroupBuild() run */
+typedef struct DetectEngineBuildProfile_ {
+    struct timeval start_ts;
+    struct timeval stage_ts;
+    uint16_t threads;
+    uint16_t stage_cnt;
+    DetectEngineBuildProfileEntry stages[DETECT_ENGINE_BUILD_PROFILE_MAX];
+} DetectEngineBuildProfile;
+
+/** function called for each item by the build worker pool */
+typedef int (*DetectEngineBuildFunc)(DetectEngineCtx *, void *);
+
+uint16_t DetectEngineBuildGetThreads(DetectEngineCtx *);
+int DetectEngineBuildRunParallel(DetectEngineCtx *, uint16_t, void **, uint32_t,
+        DetectEngineBuildFunc);
+
+void DetectEngineBuildQueueMpmCtx(DetectEngineCtx *, MpmCtx *);
+int DetectEngineBuildPrepareMpmCtxs(DetectEngineCtx *);
+void DetectEngineBuildFreeMpmQueue(DetectEngineCtx *);
+
+void DetectEngineBuildProfileStart(DetectEngineCtx *, DetectEngineBuildProfile *);
+void DetectEngineBuildProfileStage(DetectEngineBuildProfile *, const char *, uint32_t);
+void DetectEngineBuildProfileLog(DetectEngineCtx *, DetectEngineBuildProfile *);
+
+void DetectEngineBuildRegisterTests(void);
+
+#endif /* __DETECT_ENGINE_BUILD_H__ */
@@ -65,7 +65,7 @@ int DetectEngineInspectDcePayload(DetectEngineCtx *de_ctx,
     SCEnter();
     DCERPCState *dcerpc_state = (DCERPCState *)alstate;
     uint8_t *dce_stub_data = NULL;
-    uint16_t dce_stub_data_len;
+    uint32_t dce_stub_data_len;
     int r = 0;
 
     if (s->sm_lists[DETECT_SM_LIST_DMATCH] == NULL || dcerpc_state == NULL) {
@@ -51,6 +51,7 @@
 #include "app-layer-smb.h"
 #include "app-layer-dcerpc-common.h"
 #include "app-layer-dcerpc.h"
+#include "app-layer-smtp.h"
 
 #include "util-unittest.h"
 #include "util-unittest-helper.h"
@@ -126,6 +127,18 @@ static int DetectFileInspect(ThreadVars *tv, DetectEngineThreadCtx *det_ctx,
                 break;
             }
 
+            if ((s->file_flags & FILE_SIG_NEED_SHA1) && (!(file->flags & FILE_SHA1))) {
+                SCLogDebug("sig needs file sha1, but we don't have any");
+                r = 0;
+                break;
+            }
+
+            if ((s->file_flags & FILE_SIG_NEED_SHA256) && (!(file->flags & FILE_SHA256))) {
+                SCLogDebug("sig needs file sha256, but we don't have any");
+                r = 0;
+                break;
+            }
+
             if ((s->file_flags & FILE_SIG_NEED_SIZE) && file->state < FILE_STATE_CLOSED) {
                 SCLogDebug("sig needs filesize, but state < FILE_STATE_CLOSED");
                 r = 0;
@@ -237,3 +250,49 @@ int DetectFileInspectHttp(ThreadVars *tv,
 
     return r;
 }
+
+/**
+ *  \brief Inspect the file inspecting keywords against the attachments of
+ *         the SMTP transactions (mails).
+ *
+ *  \param tv thread vars
+ *  \param det_ctx detection engine thread ctx
+ *  \param f flow
+ *  \param s signature to inspect
+ *  \param alstate state
+ *  \param flags direction flag
+ *
+ *  \retval 0 no match
+ *  \retval 1 match
+ *  \retval 2 can't match
+ *  \retval 3 can't match filestore signature
+ *
+ *  \note flow should be locked when this function's called.
+ */
+int DetectFileInspectSmtp(ThreadVars *tv,
+                          DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx,
+                          Signature *s, Flow *f, uint8_t flags, void *alstate,
+                          void *tx, uint64_t tx_id)
+{
+    SMTPState *smtp_state = (SMTPState *)alstate;
+
+    /* mails only carry files to the server */
+    if (flags & STREAM_TOCLIENT)
+        return DETECT_ENGINE_INSPECT_SIG_NO_MATCH;
+
+    /* inspect the attachments of this mail */
+    det_ctx->tx_id = tx_id;
+
+    int match = DetectFileInspect(tv, det_ctx, f, s, flags, smtp_state->files_ts);
+    if (match == 1) {
+        return DETECT_ENGINE_INSPECT_SIG_MATCH;
+    } else if (match == 2) {
+        SCLogDebug("sid %u can't match on this transaction", s->id);
+        return DETECT_ENGINE_INSPECT_SIG_CANT_MATCH;
+    } else if (match == 3) {
+        SCLogDebug("sid %u can't match on this transaction (filestore sig)", s->id);
+        return DETECT_ENGINE_INSPECT_SIG_CANT_MATCH_FILESTORE;
+    }
+
+    return DETECT_ENGINE_INSPECT_SIG_NO_MATCH;
+}
@@ -60,30 +60,15 @@ int DetectEngineRunHttpCookieMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
                                  void *txv, uint64_t idx)
 {
     uint32_t cnt = 0;
-    htp_tx_t *tx = (htp_tx_t *)txv;
-    if (tx->request_headers == NULL)
+    HtpTxHeaders *hdrs = HTPTxGetHeaders((htp_tx_t *)txv, flags);
+    if (hdrs == NULL || hdrs->value[HTP_HDR_COOKIE] == NULL) {
+        SCLogDebug("HTTP (Set-)Cookie header not present in this tx");
         goto end;
-
-    htp_header_t *h = NULL;
-    if (flags & STREAM_TOSERVER) {
-        h = (htp_header_t *)htp_table_get_c(tx->request_headers,
-                                            "Cookie");
-        if (h == NULL) {
-            SCLogDebug("HTTP cookie header not present in this request");
-            goto end;
-        }
-    } else {
-        h = (htp_header_t *)htp_table_get_c(tx->response_headers,
-                                            "Set-Cookie");
-        if (h == NULL) {
-            SCLogDebug("HTTP Set-Cookie header not present in this request");
-            goto end;
-        }
     }
 
     cnt = HttpCookiePatternSearch(det_ctx,
-                                  (uint8_t *)bstr_ptr(h->value),
-                                  bstr_len(h->value), flags);
+                                  hdrs->value[HTP_HDR_COOKIE],
+                                  hdrs->value_len[HTP_HDR_COOKIE], flags);
  end:
     return cnt;
 }
@@ -109,21 +94,10 @@ int DetectEngineInspectHttpCookie(ThreadVars *tv,
                                   void *txv, uint64_t tx_id)
 {
     htp_tx_t *tx = (htp_tx_t *)txv;
-    htp_header_t *h = NULL;
-    if (flags & STREAM_TOSERVER) {
-        h = (htp_header_t *)htp_table_get_c(tx->request_headers,
-                                            "Cookie");
-        if (h == NULL) {
-            SCLogDebug("HTTP cookie header not present in this request");
-            goto end;
-        }
-    } else {
-        h = (htp_header_t *)htp_table_get_c(tx->response_headers,
-                                            "Set-Cookie");
-        if (h == NULL) {
-            SCLogDebug("HTTP Set-Cookie header not present in this request");
-            goto end;
-        }
+    HtpTxHeaders *hdrs = HTPTxGetHeaders(tx, flags);
+    if (hdrs == NULL || hdrs->value[HTP_HDR_COOKIE] == NULL) {
+        SCLogDebug("HTTP (Set-)Cookie header not present in this tx");
+        goto end;
     }
 
     det_ctx->buffer_offset = 0;
@@ -131,8 +105,8 @@ int DetectEngineInspectHttpCookie(ThreadVars *tv,
     det_ctx->inspection_recursion_counter = 0;
     int r = DetectEngineContentInspection(de_ctx, det_ctx, s, s->sm_lists[DETECT_SM_LIST_HCDMATCH],
                                           f,
-                                          (uint8_t *)bstr_ptr(h->value),
-                                          bstr_len(h->value),
+                                          hdrs->value[HTP_HDR_COOKIE],
+                                          hdrs->value_len[HTP_HDR_COOKIE],
                                           0,
                                           DETECT_ENGINE_CONTENT_INSPECTION_MODE_HCD, NULL);
     if (r == 1)
@@ -61,19 +61,14 @@ int DetectEngineRunHttpUAMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
                              void *txv, uint64_t idx)
 {
     uint32_t cnt = 0;
-    htp_tx_t *tx = (htp_tx_t *)txv;
-    if (tx->request_headers == NULL)
-        goto end;
-
-    htp_header_t *h = (htp_header_t *)htp_table_get_c(tx->request_headers,
-                                                      "User-Agent");
-    if (h == NULL) {
+    HtpTxHeaders *hdrs = HTPTxGetHeaders((htp_tx_t *)txv, STREAM_TOSERVER);
+    if (hdrs == NULL || hdrs->value[HTP_HDR_USER_AGENT] == NULL) {
         SCLogDebug("HTTP user agent header not present in this request");
         goto end;
     }
     cnt = HttpUAPatternSearch(det_ctx,
-                              (uint8_t *)bstr_ptr(h->value),
-                              bstr_len(h->value), flags);
+                              hdrs->value[HTP_HDR_USER_AGENT],
+                              hdrs->value_len[HTP_HDR_USER_AGENT], flags);
 
  end:
     return cnt;
@@ -100,9 +95,8 @@ int DetectEngineInspectHttpUA(ThreadVars *tv,
                               void *txv, uint64_t tx_id)
 {
     htp_tx_t *tx = (htp_tx_t *)txv;
-    htp_header_t *h = (htp_header_t *)htp_table_get_c(tx->request_headers,
-                                                      "User-Agent");
-    if (h == NULL) {
+    HtpTxHeaders *hdrs = HTPTxGetHeaders(tx, STREAM_TOSERVER);
+    if (hdrs == NULL || hdrs->value[HTP_HDR_USER_AGENT] == NULL) {
         SCLogDebug("HTTP user agent header not present in this request");
         goto end;
     }
@@ -112,8 +106,8 @@ int DetectEngineInspectHttpUA(ThreadVars *tv,
     det_ctx->inspection_recursion_counter = 0;
     int r = DetectEngineContentInspection(de_ctx, det_ctx, s, s->sm_lists[DETECT_SM_LIST_HUADMATCH],
                                           f,
-                                          (uint8_t *)bstr_ptr(h->value),
-                                          bstr_len(h->value),
+                                          hdrs->value[HTP_HDR_USER_AGENT],
+                                          hdrs->value_len[HTP_HDR_USER_AGENT],
                                           0,
                                           DETECT_ENGINE_CONTENT_INSPECTION_MODE_HUAD, NULL);
     if (r == 1)
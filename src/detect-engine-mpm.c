@@ -34,6 +34,7 @@
 #include "detect-engine.h"
 #include "detect-engine-siggroup.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-build.h"
 #include "detect-engine-iponly.h"
 #include "detect-parse.h"
 #include "util-mpm.h"
@@ -794,7 +795,7 @@ void StreamPatternCleanup(ThreadVars *t, DetectEngineThreadCtx *det_ctx, StreamM
 
 void PatternMatchDestroy(MpmCtx *mpm_ctx, uint16_t mpm_matcher) {
     SCLogDebug("mpm_ctx %p, mpm_matcher %"PRIu16"", mpm_ctx, mpm_matcher);
-    mpm_table[mpm_matcher].DestroyCtx(mpm_ctx);
+    MpmDestroyCtx(mpm_ctx);
 }
 
 void PatternMatchPrepare(MpmCtx *mpm_ctx, uint16_t mpm_matcher) {
@@ -824,8 +825,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
                    sh->mpm_proto_tcp_ctx_ts, sh);
         if (sh->mpm_proto_tcp_ctx_ts != NULL &&
             !sh->mpm_proto_tcp_ctx_ts->global) {
-            mpm_table[sh->mpm_proto_tcp_ctx_ts->mpm_type].
-                DestroyCtx(sh->mpm_proto_tcp_ctx_ts);
+            MpmDestroyCtx(sh->mpm_proto_tcp_ctx_ts);
             SCFree(sh->mpm_proto_tcp_ctx_ts);
         }
         /* ready for reuse */
@@ -835,8 +835,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
                    sh->mpm_proto_tcp_ctx_tc, sh);
         if (sh->mpm_proto_tcp_ctx_tc != NULL &&
             !sh->mpm_proto_tcp_ctx_tc->global) {
-            mpm_table[sh->mpm_proto_tcp_ctx_tc->mpm_type].
-                DestroyCtx(sh->mpm_proto_tcp_ctx_tc);
+            MpmDestroyCtx(sh->mpm_proto_tcp_ctx_tc);
             SCFree(sh->mpm_proto_tcp_ctx_tc);
         }
         /* ready for reuse */
@@ -846,8 +845,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
                    sh->mpm_proto_udp_ctx_ts, sh);
         if (sh->mpm_proto_udp_ctx_ts != NULL &&
             !sh->mpm_proto_udp_ctx_ts->global) {
-            mpm_table[sh->mpm_proto_udp_ctx_ts->mpm_type].
-                DestroyCtx(sh->mpm_proto_udp_ctx_ts);
+            MpmDestroyCtx(sh->mpm_proto_udp_ctx_ts);
             SCFree(sh->mpm_proto_udp_ctx_ts);
         }
         /* ready for reuse */
@@ -857,8 +855,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
                    sh->mpm_proto_udp_ctx_tc, sh);
         if (sh->mpm_proto_udp_ctx_tc != NULL &&
             !sh->mpm_proto_udp_ctx_tc->global) {
-            mpm_table[sh->mpm_proto_udp_ctx_tc->mpm_type].
-                DestroyCtx(sh->mpm_proto_udp_ctx_tc);
+            MpmDestroyCtx(sh->mpm_proto_udp_ctx_tc);
             SCFree(sh->mpm_proto_udp_ctx_tc);
         }
         /* ready for reuse */
@@ -868,8 +865,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
                    sh->mpm_proto_other_ctx, sh);
         if (sh->mpm_proto_other_ctx != NULL &&
             !sh->mpm_proto_other_ctx->global) {
-            mpm_table[sh->mpm_proto_other_ctx->mpm_type].
-                DestroyCtx(sh->mpm_proto_other_ctx);
+            MpmDestroyCtx(sh->mpm_proto_other_ctx);
             SCFree(sh->mpm_proto_other_ctx);
         }
         /* ready for reuse */
@@ -881,7 +877,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
         if (sh->mpm_uri_ctx_ts != NULL) {
             SCLogDebug("destroying mpm_uri_ctx %p (sh %p)", sh->mpm_uri_ctx_ts, sh);
             if (!sh->mpm_uri_ctx_ts->global) {
-                mpm_table[sh->mpm_uri_ctx_ts->mpm_type].DestroyCtx(sh->mpm_uri_ctx_ts);
+                MpmDestroyCtx(sh->mpm_uri_ctx_ts);
                 SCFree(sh->mpm_uri_ctx_ts);
             }
             /* ready for reuse */
@@ -895,7 +891,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
         if (sh->mpm_stream_ctx_ts != NULL) {
             SCLogDebug("destroying mpm_stream_ctx %p (sh %p)", sh->mpm_stream_ctx_ts, sh);
             if (!sh->mpm_stream_ctx_ts->global) {
-                mpm_table[sh->mpm_stream_ctx_ts->mpm_type].DestroyCtx(sh->mpm_stream_ctx_ts);
+                MpmDestroyCtx(sh->mpm_stream_ctx_ts);
                 SCFree(sh->mpm_stream_ctx_ts);
             }
             /* ready for reuse */
@@ -904,7 +900,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
         if (sh->mpm_stream_ctx_tc != NULL) {
             SCLogDebug("destroying mpm_stream_ctx %p (sh %p)", sh->mpm_stream_ctx_tc, sh);
             if (!sh->mpm_stream_ctx_tc->global) {
-                mpm_table[sh->mpm_stream_ctx_tc->mpm_type].DestroyCtx(sh->mpm_stream_ctx_tc);
+                MpmDestroyCtx(sh->mpm_stream_ctx_tc);
                 SCFree(sh->mpm_stream_ctx_tc);
             }
             /* ready for reuse */
@@ -915,7 +911,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_hcbd_ctx_ts != NULL) {
         if (sh->mpm_hcbd_ctx_ts != NULL) {
             if (!sh->mpm_hcbd_ctx_ts->global) {
-                mpm_table[sh->mpm_hcbd_ctx_ts->mpm_type].DestroyCtx(sh->mpm_hcbd_ctx_ts);
+                MpmDestroyCtx(sh->mpm_hcbd_ctx_ts);
                 SCFree(sh->mpm_hcbd_ctx_ts);
             }
             sh->mpm_hcbd_ctx_ts = NULL;
@@ -925,7 +921,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_hsbd_ctx_tc != NULL) {
         if (sh->mpm_hsbd_ctx_tc != NULL) {
             if (!sh->mpm_hsbd_ctx_tc->global) {
-                mpm_table[sh->mpm_hsbd_ctx_tc->mpm_type].DestroyCtx(sh->mpm_hsbd_ctx_tc);
+                MpmDestroyCtx(sh->mpm_hsbd_ctx_tc);
                 SCFree(sh->mpm_hsbd_ctx_tc);
             }
             sh->mpm_hsbd_ctx_tc = NULL;
@@ -935,14 +931,14 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_hhd_ctx_ts != NULL || sh->mpm_hhd_ctx_tc != NULL) {
         if (sh->mpm_hhd_ctx_ts != NULL) {
             if (!sh->mpm_hhd_ctx_ts->global) {
-                mpm_table[sh->mpm_hhd_ctx_ts->mpm_type].DestroyCtx(sh->mpm_hhd_ctx_ts);
+                MpmDestroyCtx(sh->mpm_hhd_ctx_ts);
                 SCFree(sh->mpm_hhd_ctx_ts);
             }
             sh->mpm_hhd_ctx_ts = NULL;
         }
         if (sh->mpm_hhd_ctx_tc != NULL) {
             if (!sh->mpm_hhd_ctx_tc->global) {
-                mpm_table[sh->mpm_hhd_ctx_tc->mpm_type].DestroyCtx(sh->mpm_hhd_ctx_tc);
+                MpmDestroyCtx(sh->mpm_hhd_ctx_tc);
                 SCFree(sh->mpm_hhd_ctx_tc);
             }
             sh->mpm_hhd_ctx_tc = NULL;
@@ -952,14 +948,14 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_hrhd_ctx_ts != NULL || sh->mpm_hrhd_ctx_tc != NULL) {
         if (sh->mpm_hrhd_ctx_ts != NULL) {
             if (!sh->mpm_hrhd_ctx_ts->global) {
-                mpm_table[sh->mpm_hrhd_ctx_ts->mpm_type].DestroyCtx(sh->mpm_hrhd_ctx_ts);
+                MpmDestroyCtx(sh->mpm_hrhd_ctx_ts);
                 SCFree(sh->mpm_hrhd_ctx_ts);
             }
             sh->mpm_hrhd_ctx_ts = NULL;
         }
         if (sh->mpm_hrhd_ctx_tc != NULL) {
             if (!sh->mpm_hrhd_ctx_tc->global) {
-                mpm_table[sh->mpm_hrhd_ctx_tc->mpm_type].DestroyCtx(sh->mpm_hrhd_ctx_tc);
+                MpmDestroyCtx(sh->mpm_hrhd_ctx_tc);
                 SCFree(sh->mpm_hrhd_ctx_tc);
             }
             sh->mpm_hrhd_ctx_tc = NULL;
@@ -969,7 +965,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_hmd_ctx_ts != NULL) {
         if (sh->mpm_hmd_ctx_ts != NULL) {
             if (!sh->mpm_hmd_ctx_ts->global) {
-                mpm_table[sh->mpm_hmd_ctx_ts->mpm_type].DestroyCtx(sh->mpm_hmd_ctx_ts);
+                MpmDestroyCtx(sh->mpm_hmd_ctx_ts);
                 SCFree(sh->mpm_hmd_ctx_ts);
             }
             sh->mpm_hmd_ctx_ts = NULL;
@@ -979,14 +975,14 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_hcd_ctx_ts != NULL || sh->mpm_hcd_ctx_tc != NULL) {
         if (sh->mpm_hcd_ctx_ts != NULL) {
             if (!sh->mpm_hcd_ctx_ts->global) {
-                mpm_table[sh->mpm_hcd_ctx_ts->mpm_type].DestroyCtx(sh->mpm_hcd_ctx_ts);
+                MpmDestroyCtx(sh->mpm_hcd_ctx_ts);
                 SCFree(sh->mpm_hcd_ctx_ts);
             }
             sh->mpm_hcd_ctx_ts = NULL;
         }
         if (sh->mpm_hcd_ctx_tc != NULL) {
             if (!sh->mpm_hcd_ctx_tc->global) {
-                mpm_table[sh->mpm_hcd_ctx_tc->mpm_type].DestroyCtx(sh->mpm_hcd_ctx_tc);
+                MpmDestroyCtx(sh->mpm_hcd_ctx_tc);
                 SCFree(sh->mpm_hcd_ctx_tc);
             }
             sh->mpm_hcd_ctx_tc = NULL;
@@ -996,7 +992,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_hrud_ctx_ts != NULL) {
         if (sh->mpm_hrud_ctx_ts != NULL) {
             if (!sh->mpm_hrud_ctx_ts->global) {
-                mpm_table[sh->mpm_hrud_ctx_ts->mpm_type].DestroyCtx(sh->mpm_hrud_ctx_ts);
+                MpmDestroyCtx(sh->mpm_hrud_ctx_ts);
                 SCFree(sh->mpm_hrud_ctx_ts);
             }
             sh->mpm_hrud_ctx_ts = NULL;
@@ -1006,7 +1002,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_hsmd_ctx_tc != NULL) {
         if (sh->mpm_hsmd_ctx_tc != NULL) {
             if (!sh->mpm_hsmd_ctx_tc->global) {
-                mpm_table[sh->mpm_hsmd_ctx_tc->mpm_type].DestroyCtx(sh->mpm_hsmd_ctx_tc);
+                MpmDestroyCtx(sh->mpm_hsmd_ctx_tc);
                 SCFree(sh->mpm_hsmd_ctx_tc);
             }
             sh->mpm_hsmd_ctx_tc = NULL;
@@ -1016,7 +1012,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_hscd_ctx_tc != NULL) {
         if (sh->mpm_hscd_ctx_tc != NULL) {
             if (!sh->mpm_hscd_ctx_tc->global) {
-                mpm_table[sh->mpm_hscd_ctx_tc->mpm_type].DestroyCtx(sh->mpm_hscd_ctx_tc);
+                MpmDestroyCtx(sh->mpm_hscd_ctx_tc);
                 SCFree(sh->mpm_hscd_ctx_tc);
             }
             sh->mpm_hscd_ctx_tc = NULL;
@@ -1026,7 +1022,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     if (sh->mpm_huad_ctx_ts != NULL) {
         if (sh->mpm_huad_ctx_ts != NULL) {
             if (!sh->mpm_huad_ctx_ts->global) {
-                mpm_table[sh->mpm_huad_ctx_ts->mpm_type].DestroyCtx(sh->mpm_huad_ctx_ts);
+                MpmDestroyCtx(sh->mpm_huad_ctx_ts);
                 SCFree(sh->mpm_huad_ctx_ts);
             }
             sh->mpm_huad_ctx_ts = NULL;
@@ -1036,7 +1032,7 @@ void PatternMatchDestroyGroup(SigGroupHead *sh) {
     /* dns query */
     if (sh->mpm_dnsquery_ctx_ts != NULL) {
         if (!sh->mpm_dnsquery_ctx_ts->global) {
-            mpm_table[sh->mpm_dnsquery_ctx_ts->mpm_type].DestroyCtx(sh->mpm_dnsquery_ctx_ts);
+            MpmDestroyCtx(sh->mpm_dnsquery_ctx_ts);
             SCFree(sh->mpm_dnsquery_ctx_ts);
         }
         sh->mpm_dnsquery_ctx_ts = NULL;
@@ -1189,31 +1185,27 @@ static void PopulateMpmHelperAddPatternToPktCtx(MpmCtx *mpm_ctx,
 {
     if (cd->flags & DETECT_CONTENT_NOCASE) {
         if (chop) {
-            mpm_table[mpm_ctx->mpm_type].
-                AddPatternNocase(mpm_ctx,
-                                 cd->content + cd->fp_chop_offset,
-                                 cd->fp_chop_len,
-                                 0, 0, cd->id, s->num, flags);
+            MpmAddPatternCI(mpm_ctx,
+                            cd->content + cd->fp_chop_offset,
+                            cd->fp_chop_len,
+                            0, 0, cd->id, s->num, flags);
         } else {
-            mpm_table[mpm_ctx->mpm_type].
-                AddPatternNocase(mpm_ctx,
-                                 cd->content,
-                                 cd->content_len,
-                                 0, 0, cd->id, s->num, flags);
+            MpmAddPatternCI(mpm_ctx,
+                            cd->content,
+                            cd->content_len,
+                            0, 0, cd->id, s->num, flags);
         }
     } else {
         if (chop) {
-            mpm_table[mpm_ctx->mpm_type].
-                AddPattern(mpm_ctx,
-                           cd->content + cd->fp_chop_offset,
-                           cd->fp_chop_len,
-                           0, 0, cd->id, s->num, flags);
+            MpmAddPatternCS(mpm_ctx,
+                            cd->content + cd->fp_chop_offset,
+                            cd->fp_chop_len,
+                            0, 0, cd->id, s->num, flags);
         } else {
-            mpm_table[mpm_ctx->mpm_type].
-                AddPattern(mpm_ctx,
-                           cd->content,
-                           cd->content_len,
-                           0, 0, cd->id, s->num, flags);
+            MpmAddPatternCS(mpm_ctx,
+                            cd->content,
+                            cd->content_len,
+                            0, 0, cd->id, s->num, flags);
         }
     }
 
@@ -1295,33 +1287,29 @@ static void PopulateMpmAddPatternToMpm(DetectEngineCtx *de_ctx,
                 if (SignatureHasStreamContent(s)) {
                     if (cd->flags & DETECT_CONTENT_NOCASE) {
                         if (s->flags & SIG_FLAG_TOSERVER) {
-                            mpm_table[sgh->mpm_stream_ctx_ts->mpm_type].
-                                AddPatternNocase(sgh->mpm_stream_ctx_ts,
-                                                 cd->content + cd->fp_chop_offset,
-                                                 cd->fp_chop_len,
-                                                 0, 0, cd->id, s->num, flags);
+                            MpmAddPatternCI(sgh->mpm_stream_ctx_ts,
+                                            cd->content + cd->fp_chop_offset,
+                                            cd->fp_chop_len,
+                                            0, 0, cd->id, s->num, flags);
                         }
                         if (s->flags & SIG_FLAG_TOCLIENT) {
-                            mpm_table[sgh->mpm_stream_ctx_tc->mpm_type].
-                                AddPatternNocase(sgh->mpm_stream_ctx_tc,
-                                                 cd->content + cd->fp_chop_offset,
-                                                 cd->fp_chop_len,
-                                                 0, 0, cd->id, s->num, flags);
+                            MpmAddPatternCI(sgh->mpm_stream_ctx_tc,
+                                            cd->content + cd->fp_chop_offset,
+                                            cd->fp_chop_len,
+                                            0, 0, cd->id, s->num, flags);
                         }
                     } else {
                         if (s->flags & SIG_FLAG_TOSERVER) {
-                            mpm_table[sgh->mpm_stream_ctx_ts->mpm_type].
-                                AddPattern(sgh->mpm_stream_ctx_ts,
-                                           cd->content + cd->fp_chop_offset,
-                                           cd->fp_chop_len,
-                                           0, 0, cd->id, s->num, flags);
+                            MpmAddPatternCS(sgh->mpm_stream_ctx_ts,
+                                            cd->content + cd->fp_chop_offset,
+                                            cd->fp_chop_len,
+                                            0, 0, cd->id, s->num, flags);
                         }
                         if (s->flags & SIG_FLAG_TOCLIENT) {
-                            mpm_table[sgh->mpm_stream_ctx_tc->mpm_type].
-                                AddPattern(sgh->mpm_stream_ctx_tc,
-                                           cd->content + cd->fp_chop_offset,
-                                           cd->fp_chop_len,
-                                           0, 0, cd->id, s->num, flags);
+                            MpmAddPatternCS(sgh->mpm_stream_ctx_tc,
+                                            cd->content + cd->fp_chop_offset,
+                                            cd->fp_chop_len,
+                                            0, 0, cd->id, s->num, flags);
                         }
                     }
                     /* tell matcher we are inspecting stream */
@@ -1385,29 +1373,25 @@ static void PopulateMpmAddPatternToMpm(DetectEngineCtx *de_ctx,
                     /* add the content to the "packet" mpm */
                     if (cd->flags & DETECT_CONTENT_NOCASE) {
                         if (s->flags & SIG_FLAG_TOSERVER) {
-                            mpm_table[sgh->mpm_stream_ctx_ts->mpm_type].
-                                AddPatternNocase(sgh->mpm_stream_ctx_ts,
-                                                 cd->content, cd->content_len,
-                                                 0, 0, cd->id, s->num, flags);
+                            MpmAddPatternCI(sgh->mpm_stream_ctx_ts,
+                                            cd->content, cd->content_len,
+                                            0, 0, cd->id, s->num, flags);
                         }
                         if (s->flags & SIG_FLAG_TOCLIENT) {
-                            mpm_table[sgh->mpm_stream_ctx_tc->mpm_type].
-                                AddPatternNocase(sgh->mpm_stream_ctx_tc,
-                                                 cd->content, cd->content_len,
-                                                 0, 0, cd->id, s->num, flags);
+                            MpmAddPatternCI(sgh->mpm_stream_ctx_tc,
+                                            cd->content, cd->content_len,
+                                            0, 0, cd->id, s->num, flags);
                         }
                     } else {
                         if (s->flags & SIG_FLAG_TOSERVER) {
-                            mpm_table[sgh->mpm_stream_ctx_ts->mpm_type].
-                                AddPattern(sgh->mpm_stream_ctx_ts,
-                                           cd->content, cd->content_len,
-                                           0, 0, cd->id, s->num, flags);
+                            MpmAddPatternCS(sgh->mpm_stream_ctx_ts,
+                                            cd->content, cd->content_len,
+                                            0, 0, cd->id, s->num, flags);
                         }
                         if (s->flags & SIG_FLAG_TOCLIENT) {
-                            mpm_table[sgh->mpm_stream_ctx_tc->mpm_type].
-                                AddPattern(sgh->mpm_stream_ctx_tc,
-                                           cd->content, cd->content_len,
-                                           0, 0, cd->id, s->num, flags);
+                            MpmAddPatternCS(sgh->mpm_stream_ctx_tc,
+                                            cd->content, cd->content_len,
+                                            0, 0, cd->id, s->num, flags);
                         }
                     }
                     /* tell matcher we are inspecting stream */
@@ -1569,33 +1553,29 @@ static void PopulateMpmAddPatternToMpm(DetectEngineCtx *de_ctx,
                 /* add the content to the mpm */
                 if (cd->flags & DETECT_CONTENT_NOCASE) {
                     if (mpm_ctx_ts != NULL) {
-                        mpm_table[mpm_ctx_ts->mpm_type].
-                            AddPatternNocase(mpm_ctx_ts,
-                                             cd->content + cd->fp_chop_offset,
-                                             cd->fp_chop_len,
-                                             0, 0, cd->id, s->num, flags);
+                        MpmAddPatternCI(mpm_ctx_ts,
+                                        cd->content + cd->fp_chop_offset,
+                                        cd->fp_chop_len,
+                                        0, 0, cd->id, s->num, flags);
                     }
                     if (mpm_ctx_tc != NULL) {
-                        mpm_table[mpm_ctx_tc->mpm_type].
-                            AddPatternNocase(mpm_ctx_tc,
-                                             cd->content + cd->fp_chop_offset,
-                                             cd->fp_chop_len,
-                                             0, 0, cd->id, s->num, flags);
+                        MpmAddPatternCI(mpm_ctx_tc,
+                                        cd->content + cd->fp_chop_offset,
+                                        cd->fp_chop_len,
+                                        0, 0, cd->id, s->num, flags);
                     }
                 } else {
                     if (mpm_ctx_ts != NULL) {
-                        mpm_table[mpm_ctx_ts->mpm_type].
-                            AddPattern(mpm_ctx_ts,
-                                       cd->content + cd->fp_chop_offset,
-                                       cd->fp_chop_len,
-                                       0, 0, cd->id, s->num, flags);
+                        MpmAddPatternCS(mpm_ctx_ts,
+                                        cd->content + cd->fp_chop_offset,
+                                        cd->fp_chop_len,
+                                        0, 0, cd->id, s->num, flags);
                     }
                     if (mpm_ctx_tc != NULL) {
-                        mpm_table[mpm_ctx_tc->mpm_type].
-                            AddPattern(mpm_ctx_tc,
-                                       cd->content + cd->fp_chop_offset,
-                                       cd->fp_chop_len,
-                                       0, 0, cd->id, s->num, flags);
+                        MpmAddPatternCS(mpm_ctx_tc,
+                                        cd->content + cd->fp_chop_offset,
+                                        cd->fp_chop_len,
+                                        0, 0, cd->id, s->num, flags);
                     }
                 }
             } else {
@@ -1608,29 +1588,25 @@ static void PopulateMpmAddPatternToMpm(DetectEngineCtx *de_ctx,
                 /* add the content to the "uri" mpm */
                 if (cd->flags & DETECT_CONTENT_NOCASE) {
                     if (mpm_ctx_ts != NULL) {
-                        mpm_table[mpm_ctx_ts->mpm_type].
-                            AddPatternNocase(mpm_ctx_ts,
-                                             cd->content, cd->content_len,
-                                             0, 0, cd->id, s->num, flags);
+                        MpmAddPatternCI(mpm_ctx_ts,
+                                        cd->content, cd->content_len,
+                                        0, 0, cd->id, s->num, flags);
                     }
                     if (mpm_ctx_tc != NULL) {
-                        mpm_table[mpm_ctx_tc->mpm_type].
-                            AddPatternNocase(mpm_ctx_tc,
-                                             cd->content, cd->content_len,
-                                             0, 0, cd->id, s->num, flags);
+                        MpmAddPatternCI(mpm_ctx_tc,
+                                        cd->content, cd->content_len,
+                                        0, 0, cd->id, s->num, flags);
                     }
                 } else {
                     if (mpm_ctx_ts != NULL) {
-                        mpm_table[mpm_ctx_ts->mpm_type].
-                            AddPattern(mpm_ctx_ts,
-                                       cd->content, cd->content_len,
-                                       0, 0, cd->id, s->num, flags);
+                        MpmAddPatternCS(mpm_ctx_ts,
+                                        cd->content, cd->content_len,
+                                        0, 0, cd->id, s->num, flags);
                     }
                     if (mpm_ctx_tc != NULL) {
-                        mpm_table[mpm_ctx_tc->mpm_type].
-                            AddPattern(mpm_ctx_tc,
-                                       cd->content, cd->content_len,
-                                       0, 0, cd->id, s->num, flags);
+                        MpmAddPatternCS(mpm_ctx_tc,
+                                        cd->content, cd->content_len,
+                                        0, 0, cd->id, s->num, flags);
                     }
                 }
             }
@@ -2311,10 +2287,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_proto_tcp_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_proto_tcp_ctx_ts->mpm_type].Prepare != NULL) {
-                         mpm_table[sh->mpm_proto_tcp_ctx_ts->mpm_type].
-                             Prepare(sh->mpm_proto_tcp_ctx_ts);
-                     }
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_proto_tcp_ctx_ts);
                  }
              }
          }
@@ -2324,10 +2297,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_proto_tcp_ctx_tc = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_proto_tcp_ctx_tc->mpm_type].Prepare != NULL) {
-                         mpm_table[sh->mpm_proto_tcp_ctx_tc->mpm_type].
-                             Prepare(sh->mpm_proto_tcp_ctx_tc);
-                     }
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_proto_tcp_ctx_tc);
                  }
              }
          }
@@ -2338,10 +2308,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_proto_udp_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_proto_udp_ctx_ts->mpm_type].Prepare != NULL) {
-                         mpm_table[sh->mpm_proto_udp_ctx_ts->mpm_type].
-                             Prepare(sh->mpm_proto_udp_ctx_ts);
-                     }
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_proto_udp_ctx_ts);
                  }
              }
          }
@@ -2351,10 +2318,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_proto_udp_ctx_tc = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_proto_udp_ctx_tc->mpm_type].Prepare != NULL) {
-                         mpm_table[sh->mpm_proto_udp_ctx_tc->mpm_type].
-                             Prepare(sh->mpm_proto_udp_ctx_tc);
-                     }
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_proto_udp_ctx_tc);
                  }
              }
          }
@@ -2365,10 +2329,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_proto_other_ctx = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_proto_other_ctx->mpm_type].Prepare != NULL) {
-                         mpm_table[sh->mpm_proto_other_ctx->mpm_type].
-                             Prepare(sh->mpm_proto_other_ctx);
-                     }
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_proto_other_ctx);
                  }
              }
          }
@@ -2379,8 +2340,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_stream_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_stream_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_stream_ctx_ts->mpm_type].Prepare(sh->mpm_stream_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_stream_ctx_ts);
                  }
              }
          }
@@ -2390,8 +2350,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_stream_ctx_tc = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_stream_ctx_tc->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_stream_ctx_tc->mpm_type].Prepare(sh->mpm_stream_ctx_tc);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_stream_ctx_tc);
                  }
              }
          }
@@ -2402,8 +2361,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_uri_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_uri_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_uri_ctx_ts->mpm_type].Prepare(sh->mpm_uri_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_uri_ctx_ts);
                  }
              }
          }
@@ -2414,8 +2372,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hcbd_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hcbd_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hcbd_ctx_ts->mpm_type].Prepare(sh->mpm_hcbd_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hcbd_ctx_ts);
                  }
              }
          }
@@ -2426,8 +2383,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hsbd_ctx_tc = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hsbd_ctx_tc->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hsbd_ctx_tc->mpm_type].Prepare(sh->mpm_hsbd_ctx_tc);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hsbd_ctx_tc);
                  }
              }
          }
@@ -2438,8 +2394,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hhd_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hhd_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hhd_ctx_ts->mpm_type].Prepare(sh->mpm_hhd_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hhd_ctx_ts);
                  }
              }
          }
@@ -2449,8 +2404,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hhd_ctx_tc = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hhd_ctx_tc->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hhd_ctx_tc->mpm_type].Prepare(sh->mpm_hhd_ctx_tc);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hhd_ctx_tc);
                  }
              }
          }
@@ -2461,8 +2415,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hrhd_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hrhd_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hrhd_ctx_ts->mpm_type].Prepare(sh->mpm_hrhd_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hrhd_ctx_ts);
                  }
              }
          }
@@ -2472,8 +2425,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hrhd_ctx_tc = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hrhd_ctx_tc->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hrhd_ctx_tc->mpm_type].Prepare(sh->mpm_hrhd_ctx_tc);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hrhd_ctx_tc);
                  }
              }
          }
@@ -2484,8 +2436,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hmd_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hmd_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hmd_ctx_ts->mpm_type].Prepare(sh->mpm_hmd_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hmd_ctx_ts);
                  }
              }
          }
@@ -2496,8 +2447,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hcd_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hcd_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hcd_ctx_ts->mpm_type].Prepare(sh->mpm_hcd_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hcd_ctx_ts);
                  }
              }
          }
@@ -2507,8 +2457,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hcd_ctx_tc = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hcd_ctx_tc->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hcd_ctx_tc->mpm_type].Prepare(sh->mpm_hcd_ctx_tc);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hcd_ctx_tc);
                  }
              }
          }
@@ -2519,8 +2468,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hrud_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hrud_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hrud_ctx_ts->mpm_type].Prepare(sh->mpm_hrud_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hrud_ctx_ts);
                  }
              }
          }
@@ -2531,8 +2479,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hsmd_ctx_tc = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hsmd_ctx_tc->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hsmd_ctx_tc->mpm_type].Prepare(sh->mpm_hsmd_ctx_tc);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hsmd_ctx_tc);
                  }
              }
          }
@@ -2543,8 +2490,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hscd_ctx_tc = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hscd_ctx_tc->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hscd_ctx_tc->mpm_type].Prepare(sh->mpm_hscd_ctx_tc);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hscd_ctx_tc);
                  }
              }
          }
@@ -2555,8 +2501,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_huad_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_huad_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_huad_ctx_ts->mpm_type].Prepare(sh->mpm_huad_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_huad_ctx_ts);
                  }
              }
          }
@@ -2567,8 +2512,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hhhd_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hhhd_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hhhd_ctx_ts->mpm_type].Prepare(sh->mpm_hhhd_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hhhd_ctx_ts);
                  }
              }
          }
@@ -2579,8 +2523,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_hrhhd_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_hrhhd_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_hrhhd_ctx_ts->mpm_type].Prepare(sh->mpm_hrhhd_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_hrhhd_ctx_ts);
                  }
              }
          }
@@ -2591,8 +2534,7 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                  sh->mpm_dnsquery_ctx_ts = NULL;
              } else {
                  if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL) {
-                     if (mpm_table[sh->mpm_dnsquery_ctx_ts->mpm_type].Prepare != NULL)
-                         mpm_table[sh->mpm_dnsquery_ctx_ts->mpm_type].Prepare(sh->mpm_dnsquery_ctx_ts);
+                     DetectEngineBuildQueueMpmCtx(de_ctx, sh->mpm_dnsquery_ctx_ts);
                  }
              }
          }
@@ -2812,10 +2754,66 @@ typedef struct DetectFPAndItsId_ {
     uint8_t *content;
 } DetectFPAndItsId;
 
+static uint32_t DetectFPAndItsIdHashFunc(HashTable *ht, void *data, uint16_t datalen)
+{
+    DetectFPAndItsId *e = (DetectFPAndItsId *)data;
+    uint32_t hash = e->content_len + e->sm_list;
+    uint16_t u;
+
+    for (u = 0; u < e->content_len; u++) {
+        hash += e->content[u];
+    }
+
+    return hash % ht->array_size;
+}
+
+static char DetectFPAndItsIdCompare(void *data1, uint16_t len1, void *data2,
+                                    uint16_t len2)
+{
+    DetectFPAndItsId *e1 = (DetectFPAndItsId *)data1;
+    DetectFPAndItsId *e2 = (DetectFPAndItsId *)data2;
+
+    if (e1->content_len != e2->content_len || e1->sm_list != e2->sm_list)
+        return 0;
+
+    return (SCMemcmp(e1->content, e2->content, e1->content_len) == 0);
+}
+
+/**
+ * \internal
+ * \brief Create a lookup hash for the fast pattern ids of the engine we
+ *        are reloading from.
+ */
+static HashTable *DetectFPAndItsIdReloadHashInit(DetectEngineCtx *src)
+{
+    if (src->fp_ids == NULL || src->fp_ids_cnt == 0)
+        return NULL;
+
+    HashTable *ht = HashTableInit(4096, DetectFPAndItsIdHashFunc,
+                                  DetectFPAndItsIdCompare, NULL);
+    if (ht == NULL)
+        return NULL;
+
+    uint32_t i;
+    for (i = 0; i < src->fp_ids_cnt; i++) {
+        if (HashTableAdd(ht, &src->fp_ids[i], sizeof(DetectFPAndItsId)) != 0) {
+            HashTableFree(ht);
+            return NULL;
+        }
+    }
+
+    return ht;
+}
+
 /**
  * \brief Figured out the FP and their respective content ids for all the
  *        sigs in the engine.
  *
+ *        If the engine is reloaded from another one, patterns that exist
+ *        in both keep their id and new patterns get an id above the
+ *        highest id of the old engine. This way the mpm ctxs of unchanged
+ *        groups are identical and can be shared with the old engine.
+ *
  * \param de_ctx Detection engine context.
  *
  * \retval  0 On success.
@@ -2826,6 +2824,7 @@ int DetectSetFastPatternAndItsId(DetectEngineCtx *de_ctx)
     uint32_t struct_total_size = 0;
     uint32_t content_total_size = 0;
     Signature *s = NULL;
+    HashTable *reload_ht = NULL;
 
     for (s = de_ctx->sig_list; s != NULL; s = s->next) {
         s->mpm_sm = RetrieveFPForSigV2(s);
@@ -2836,14 +2835,25 @@ int DetectSetFastPatternAndItsId(DetectEngineCtx *de_ctx)
         }
     }
 
+    if (de_ctx->fp_ids != NULL) {
+        SCFree(de_ctx->fp_ids);
+        de_ctx->fp_ids = NULL;
+        de_ctx->fp_ids_cnt = 0;
+    }
+
     /* array hash buffer - i've run out of ideas to name it */
     uint8_t *ahb = SCMalloc(sizeof(uint8_t) * (struct_total_size + content_total_size));
     if (ahb == NULL)
         return -1;
 
+    if (de_ctx->reload_src != NULL)
+        reload_ht = DetectFPAndItsIdReloadHashInit(de_ctx->reload_src);
+
+assign:
+    ;
     uint8_t *content = NULL;
     uint8_t content_len = 0;
-    PatIntId max_id = 0;
+    uint32_t max_id = reload_ht ? de_ctx->reload_src->max_fp_id : 0;
     DetectFPAndItsId *struct_offset = (DetectFPAndItsId *)ahb;
     uint8_t *content_offset = ahb + struct_total_size;
     for (s = de_ctx->sig_list; s != NULL; s = s->next) {
@@ -2874,21 +2884,43 @@ int DetectSetFastPatternAndItsId(DetectEngineCtx *de_ctx)
                 continue;
             }
 
-            struct_offset->id = max_id++;
-            cd->id = struct_offset->id;
             struct_offset->content_len = content_len;
             struct_offset->sm_list = sm_list;
             struct_offset->content = content_offset;
-            content_offset += content_len;
             memcpy(struct_offset->content, content, content_len);
 
+            DetectFPAndItsId *old = NULL;
+            if (reload_ht != NULL) {
+                old = HashTableLookup(reload_ht, struct_offset, sizeof(DetectFPAndItsId));
+            }
+            if (old != NULL) {
+                struct_offset->id = old->id;
+            } else {
+                if (reload_ht != NULL && max_id >= UINT16_MAX) {
+                    /* out of ids, start over without reusing the old ones */
+                    SCLogInfo("fast pattern ids exhausted, not reusing the "
+                              "ids of the previous detection engine");
+                    HashTableFree(reload_ht);
+                    reload_ht = NULL;
+                    goto assign;
+                }
+                struct_offset->id = max_id++;
+            }
+            cd->id = struct_offset->id;
+            content_offset += content_len;
+
             struct_offset++;
         } /* if (s->mpm_sm != NULL) */
     } /* for */
 
+    if (reload_ht != NULL)
+        HashTableFree(reload_ht);
+
     de_ctx->max_fp_id = max_id;
 
-    SCFree(ahb);
+    /* keep the ids around so that a reload can reuse them */
+    de_ctx->fp_ids = (DetectFPAndItsId *)ahb;
+    de_ctx->fp_ids_cnt = struct_offset - (DetectFPAndItsId *)ahb;
 
     return 0;
 }
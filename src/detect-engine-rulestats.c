@@ -0,0 +1,801 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Per rule cost accounting that is part of every build.
+ *
+ * Each detect thread counts the checks and matches per rule in its own
+ * array. Only 1 in 'sample-rate' checks is timed, so the cost per check
+ * is a sampled average and the total cost is estimated from it. The
+ * counters are only written by their thread; the stats thread reads them
+ * to build the merged view, writes the top N to the log and the unix
+ * socket serves the same view on request.
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "conf.h"
+#include "decode.h"
+
+#include "detect.h"
+#include "detect-engine.h"
+#include "detect-engine-rulestats.h"
+
+#include "util-conf.h"
+#include "util-byte.h"
+#include "util-debug.h"
+#include "util-time.h"
+#include "util-unittest.h"
+
+#define RULE_STATS_DEFAULT_SAMPLE_RATE  64
+#define RULE_STATS_DEFAULT_LIMIT        20
+
+enum {
+    RULE_STATS_SORT_BY_TICKS = 0,
+    RULE_STATS_SORT_BY_AVG_TICKS,
+    RULE_STATS_SORT_BY_CHECKS,
+    RULE_STATS_SORT_BY_MATCHES,
+    RULE_STATS_SORT_BY_MAX_TICKS,
+};
+
+static const char *rule_stats_sort_names[] = {
+    "ticks", "avgticks", "checks", "matches", "maxticks", NULL,
+};
+
+/** rule ids, copied from the sig array when the ctx is set up */
+typedef struct DetectRuleStatsRule_ {
+    uint32_t sid;
+    uint32_t gid;
+    uint32_t rev;
+} DetectRuleStatsRule;
+
+/** per detect engine ctx */
+typedef struct DetectRuleStatsCtx_ {
+    uint32_t size;
+    DetectRuleStatsRule *rules;
+    DetectRuleStatsData *retired;   /**< totals of threads that are gone */
+    DetectRuleStatsData *merged;    /**< retired + live threads, last merge */
+    DetectRuleStatsThread *threads; /**< live threads */
+} DetectRuleStatsCtx;
+
+typedef struct DetectRuleStatsSummary_ {
+    uint32_t num;
+    uint64_t ticks;         /**< estimated: avg ticks * checks */
+    double avgticks;
+    uint64_t checks;
+    uint64_t matches;
+    uint64_t samples;
+    uint64_t max;
+} DetectRuleStatsSummary;
+
+static int rule_stats_enabled = 0;
+uint32_t rule_stats_sample_rate = RULE_STATS_DEFAULT_SAMPLE_RATE;
+static int rule_stats_sort_order = RULE_STATS_SORT_BY_TICKS;
+static uint32_t rule_stats_limit = RULE_STATS_DEFAULT_LIMIT;
+static char *rule_stats_file_name = NULL;
+static const char *rule_stats_file_mode = "a";
+
+/** protects the active ctx and the thread lists, never taken per packet */
+static SCMutex rule_stats_lock = SCMUTEX_INITIALIZER;
+/** ctx of the detect engine in use, the one the stats thread merges */
+static DetectRuleStatsCtx *rule_stats_active = NULL;
+
+/**
+ *  \brief read the 'profiling.rule-stats' config
+ */
+void DetectRuleStatsGlobalInit(void)
+{
+    ConfNode *conf;
+    const char *val;
+    int i;
+
+    conf = ConfGetNode("profiling.rule-stats");
+    if (conf == NULL || !ConfNodeChildValueIsTrue(conf, "enabled"))
+        return;
+
+    val = ConfNodeLookupChildValue(conf, "sort");
+    if (val != NULL) {
+        for (i = 0; rule_stats_sort_names[i] != NULL; i++) {
+            if (strcmp(val, rule_stats_sort_names[i]) == 0)
+                break;
+        }
+        if (rule_stats_sort_names[i] == NULL) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT,
+                    "Invalid rule-stats sort order: %s", val);
+            exit(EXIT_FAILURE);
+        }
+        rule_stats_sort_order = i;
+    }
+
+    val = ConfNodeLookupChildValue(conf, "limit");
+    if (val != NULL) {
+        if (ByteExtractStringUint32(&rule_stats_limit, 10,
+                    (uint16_t)strlen(val), val) <= 0) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "Invalid rule-stats limit: %s", val);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    val = ConfNodeLookupChildValue(conf, "sample-rate");
+    if (val != NULL) {
+        if (ByteExtractStringUint32(&rule_stats_sample_rate, 10,
+                    (uint16_t)strlen(val), val) <= 0 || rule_stats_sample_rate == 0) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT,
+                    "Invalid rule-stats sample-rate: %s", val);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    const char *filename = ConfNodeLookupChildValue(conf, "filename");
+    if (filename != NULL) {
+        char *log_dir = ConfigGetLogDirectory();
+
+        rule_stats_file_name = SCMalloc(PATH_MAX);
+        if (unlikely(rule_stats_file_name == NULL)) {
+            SCLogError(SC_ERR_MEM_ALLOC, "can't duplicate file name");
+            exit(EXIT_FAILURE);
+        }
+        snprintf(rule_stats_file_name, PATH_MAX, "%s/%s", log_dir, filename);
+
+        const char *v = ConfNodeLookupChildValue(conf, "append");
+        if (v == NULL || ConfValIsTrue(v)) {
+            rule_stats_file_mode = "a";
+        } else {
+            rule_stats_file_mode = "w";
+        }
+    }
+
+    rule_stats_enabled = 1;
+    SCLogInfo("rule stats enabled, timing 1 in %"PRIu32" rule checks",
+            rule_stats_sample_rate);
+}
+
+static inline void DetectRuleStatsDataAdd(DetectRuleStatsData *dst,
+        const DetectRuleStatsData *src)
+{
+    dst->checks += src->checks;
+    dst->matches += src->matches;
+    dst->ticks += src->ticks;
+    dst->samples += src->samples;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+/**
+ *  \internal
+ *  \brief rebuild the merged view from the retired totals and the live
+ *         threads. Caller holds rule_stats_lock.
+ *
+ *  The thread arrays are read while their threads update them. The
+ *  counters only grow, so a merge is at most a few checks behind.
+ */
+static void DetectRuleStatsMergeCtx(DetectRuleStatsCtx *ctx)
+{
+    DetectRuleStatsThread *t;
+    uint32_t i;
+
+    memcpy(ctx->merged, ctx->retired, ctx->size * sizeof(DetectRuleStatsData));
+
+    for (t = ctx->threads; t != NULL; t = t->next) {
+        for (i = 0; i < t->size && i < ctx->size; i++) {
+            DetectRuleStatsDataAdd(&ctx->merged[i], &t->data[i]);
+        }
+    }
+}
+
+static int DetectRuleStatsSortByTicks(const void *a, const void *b)
+{
+    const DetectRuleStatsSummary *s0 = a;
+    const DetectRuleStatsSummary *s1 = b;
+    return s1->ticks > s0->ticks ? 1 : (s1->ticks < s0->ticks ? -1 : 0);
+}
+
+static int DetectRuleStatsSortByAvgTicks(const void *a, const void *b)
+{
+    const DetectRuleStatsSummary *s0 = a;
+    const DetectRuleStatsSummary *s1 = b;
+    return s1->avgticks > s0->avgticks ? 1 : (s1->avgticks < s0->avgticks ? -1 : 0);
+}
+
+static int DetectRuleStatsSortByChecks(const void *a, const void *b)
+{
+    const DetectRuleStatsSummary *s0 = a;
+    const DetectRuleStatsSummary *s1 = b;
+    return s1->checks > s0->checks ? 1 : (s1->checks < s0->checks ? -1 : 0);
+}
+
+static int DetectRuleStatsSortByMatches(const void *a, const void *b)
+{
+    const DetectRuleStatsSummary *s0 = a;
+    const DetectRuleStatsSummary *s1 = b;
+    return s1->matches > s0->matches ? 1 : (s1->matches < s0->matches ? -1 : 0);
+}
+
+static int DetectRuleStatsSortByMaxTicks(const void *a, const void *b)
+{
+    const DetectRuleStatsSummary *s0 = a;
+    const DetectRuleStatsSummary *s1 = b;
+    return s1->max > s0->max ? 1 : (s1->max < s0->max ? -1 : 0);
+}
+
+/**
+ *  \internal
+ *  \brief summarize the merged view, sorted by the configured order
+ *
+ *  \param cnt number of rules in the summary, only checked rules are in it
+ *  \param total_ticks estimated ticks of all rules
+ *
+ *  \retval summary array to be freed by the caller or NULL
+ */
+static DetectRuleStatsSummary *DetectRuleStatsSummarize(DetectRuleStatsCtx *ctx,
+        uint32_t *cnt, uint64_t *total_ticks)
+{
+    DetectRuleStatsSummary *summary;
+    uint32_t i, n = 0;
+
+    *cnt = 0;
+    *total_ticks = 0;
+
+    if (ctx->size == 0)
+        return NULL;
+
+    summary = SCMalloc(ctx->size * sizeof(DetectRuleStatsSummary));
+    if (unlikely(summary == NULL))
+        return NULL;
+
+    for (i = 0; i < ctx->size; i++) {
+        const DetectRuleStatsData *d = &ctx->merged[i];
+        if (d->checks == 0)
+            continue;
+
+        DetectRuleStatsSummary *s = &summary[n++];
+        memset(s, 0, sizeof(*s));
+        s->num = i;
+        s->checks = d->checks;
+        s->matches = d->matches;
+        s->samples = d->samples;
+        s->max = d->max;
+        if (d->samples > 0) {
+            s->avgticks = (double)d->ticks / (double)d->samples;
+            s->ticks = (uint64_t)(s->avgticks * (double)d->checks);
+        }
+        *total_ticks += s->ticks;
+    }
+
+    switch (rule_stats_sort_order) {
+        case RULE_STATS_SORT_BY_TICKS:
+            qsort(summary, n, sizeof(*summary), DetectRuleStatsSortByTicks);
+            break;
+        case RULE_STATS_SORT_BY_AVG_TICKS:
+            qsort(summary, n, sizeof(*summary), DetectRuleStatsSortByAvgTicks);
+            break;
+        case RULE_STATS_SORT_BY_CHECKS:
+            qsort(summary, n, sizeof(*summary), DetectRuleStatsSortByChecks);
+            break;
+        case RULE_STATS_SORT_BY_MATCHES:
+            qsort(summary, n, sizeof(*summary), DetectRuleStatsSortByMatches);
+            break;
+        case RULE_STATS_SORT_BY_MAX_TICKS:
+            qsort(summary, n, sizeof(*summary), DetectRuleStatsSortByMaxTicks);
+            break;
+    }
+
+    *cnt = n;
+    return summary;
+}
+
+/**
+ *  \internal
+ *  \brief append the top N of the merged view to the log file.
+ *         Caller holds rule_stats_lock.
+ */
+static void DetectRuleStatsWriteLog(DetectRuleStatsCtx *ctx)
+{
+    DetectRuleStatsSummary *summary;
+    uint32_t cnt, i;
+    uint64_t total_ticks;
+    struct timeval tval;
+    struct tm local_tm;
+    struct tm *tms;
+    FILE *fp;
+
+    if (rule_stats_file_name == NULL)
+        return;
+
+    summary = DetectRuleStatsSummarize(ctx, &cnt, &total_ticks);
+    if (summary == NULL)
+        return;
+
+    fp = fopen(rule_stats_file_name, rule_stats_file_mode);
+    if (fp == NULL) {
+        SCLogError(SC_ERR_FOPEN, "failed to open %s: %s", rule_stats_file_name,
+                strerror(errno));
+        SCFree(summary);
+        return;
+    }
+    gettimeofday(&tval, NULL);
+    tms = SCLocalTime(tval.tv_sec, &local_tm);
+
+    fprintf(fp, "  ----------------------------------------------"
+            "----------------------------\n");
+    fprintf(fp, "  Date: %" PRId32 "/%" PRId32 "/%04d -- "
+            "%02d:%02d:%02d. Sorted by %s, 1 in %"PRIu32" checks timed\n",
+            tms->tm_mon + 1, tms->tm_mday, tms->tm_year + 1900,
+            tms->tm_hour, tms->tm_min, tms->tm_sec,
+            rule_stats_sort_names[rule_stats_sort_order], rule_stats_sample_rate);
+    fprintf(fp, "  ----------------------------------------------"
+            "----------------------------\n");
+    fprintf(fp, "   %-8s %-12s %-8s %-8s %-14s %-6s %-12s %-10s %-10s %-11s %-11s\n",
+            "Num", "Rule", "Gid", "Rev", "Est. Ticks", "%", "Checks", "Matches",
+            "Samples", "Avg Ticks", "Max Ticks");
+    fprintf(fp, "  -------- "
+        "------------ "
+        "-------- "
+        "-------- "
+        "-------------- "
+        "------ "
+        "------------ "
+        "---------- "
+        "---------- "
+        "----------- "
+        "----------- "
+        "\n");
+
+    for (i = 0; i < cnt && i < rule_stats_limit; i++) {
+        const DetectRuleStatsRule *r = &ctx->rules[summary[i].num];
+        double percent = total_ticks ?
+            (double)summary[i].ticks / (double)total_ticks * 100 : 0;
+
+        fprintf(fp, "  %-8"PRIu32" %-12"PRIu32" %-8"PRIu32" %-8"PRIu32" %-14"PRIu64
+                " %-6.2f %-12"PRIu64" %-10"PRIu64" %-10"PRIu64" %-11.2f %-11"PRIu64"\n",
+                i + 1, r->sid, r->gid, r->rev, summary[i].ticks, percent,
+                summary[i].checks, summary[i].matches, summary[i].samples,
+                summary[i].avgticks, summary[i].max);
+    }
+    fprintf(fp, "\n");
+
+    fclose(fp);
+    SCFree(summary);
+}
+
+static void DetectRuleStatsFreeCtx(DetectRuleStatsCtx *ctx)
+{
+    if (ctx == NULL)
+        return;
+
+    if (ctx->rules != NULL)
+        SCFree(ctx->rules);
+    if (ctx->retired != NULL)
+        SCFree(ctx->retired);
+    if (ctx->merged != NULL)
+        SCFree(ctx->merged);
+    SCFree(ctx);
+}
+
+/**
+ *  \brief setup the rule stats for a detect engine, called once the
+ *         signatures have their internal ids. The engine becomes the
+ *         one the stats thread reports on.
+ */
+void DetectRuleStatsInitCtx(DetectEngineCtx *de_ctx)
+{
+    DetectRuleStatsCtx *ctx;
+    uint32_t i;
+
+    if (!rule_stats_enabled || de_ctx->sig_array_len == 0)
+        return;
+
+    ctx = SCMalloc(sizeof(DetectRuleStatsCtx));
+    if (unlikely(ctx == NULL))
+        goto error;
+    memset(ctx, 0, sizeof(DetectRuleStatsCtx));
+
+    ctx->size = de_ctx->sig_array_len;
+    ctx->rules = SCMalloc(ctx->size * sizeof(DetectRuleStatsRule));
+    ctx->retired = SCMalloc(ctx->size * sizeof(DetectRuleStatsData));
+    ctx->merged = SCMalloc(ctx->size * sizeof(DetectRuleStatsData));
+    if (ctx->rules == NULL || ctx->retired == NULL || ctx->merged == NULL)
+        goto error;
+
+    memset(ctx->rules, 0, ctx->size * sizeof(DetectRuleStatsRule));
+    memset(ctx->retired, 0, ctx->size * sizeof(DetectRuleStatsData));
+    memset(ctx->merged, 0, ctx->size * sizeof(DetectRuleStatsData));
+
+    for (i = 0; i < ctx->size; i++) {
+        Signature *s = de_ctx->sig_array[i];
+        if (s == NULL)
+            continue;
+        ctx->rules[i].sid = s->id;
+        ctx->rules[i].gid = s->gid;
+        ctx->rules[i].rev = s->rev;
+    }
+
+    de_ctx->rule_stats_ctx = ctx;
+
+    SCMutexLock(&rule_stats_lock);
+    rule_stats_active = ctx;
+    SCMutexUnlock(&rule_stats_lock);
+
+    SCLogDebug("rule stats set up for %"PRIu32" rules", ctx->size);
+    return;
+
+error:
+    SCLogError(SC_ERR_MEM_ALLOC, "failed to set up the rule stats");
+    DetectRuleStatsFreeCtx(ctx);
+}
+
+/**
+ *  \brief write the final report and free the rule stats of a detect
+ *         engine. Threads still attached are detached.
+ */
+void DetectRuleStatsDestroyCtx(DetectEngineCtx *de_ctx)
+{
+    DetectRuleStatsCtx *ctx = de_ctx->rule_stats_ctx;
+    DetectRuleStatsThread *t;
+
+    if (ctx == NULL)
+        return;
+
+    SCMutexLock(&rule_stats_lock);
+    if (rule_stats_active == ctx)
+        rule_stats_active = NULL;
+
+    DetectRuleStatsMergeCtx(ctx);
+    DetectRuleStatsWriteLog(ctx);
+
+    for (t = ctx->threads; t != NULL; t = t->next)
+        t->ctx = NULL;
+    SCMutexUnlock(&rule_stats_lock);
+
+    DetectRuleStatsFreeCtx(ctx);
+    de_ctx->rule_stats_ctx = NULL;
+}
+
+/**
+ *  \brief give a detect thread its counter block
+ */
+void DetectRuleStatsThreadSetup(DetectEngineCtx *de_ctx,
+        DetectEngineThreadCtx *det_ctx)
+{
+    DetectRuleStatsCtx *ctx = de_ctx->rule_stats_ctx;
+    DetectRuleStatsThread *t;
+
+    if (ctx == NULL)
+        return;
+
+    t = SCMalloc(sizeof(DetectRuleStatsThread));
+    if (unlikely(t == NULL))
+        return;
+    memset(t, 0, sizeof(DetectRuleStatsThread));
+
+    /* aligned so threads don't share the lines they write to */
+    t->data = SCMallocAligned(ctx->size * sizeof(DetectRuleStatsData), CLS);
+    if (unlikely(t->data == NULL)) {
+        SCFree(t);
+        return;
+    }
+    memset(t->data, 0, ctx->size * sizeof(DetectRuleStatsData));
+    t->size = ctx->size;
+    t->ctx = ctx;
+
+    SCMutexLock(&rule_stats_lock);
+    t->next = ctx->threads;
+    ctx->threads = t;
+    SCMutexUnlock(&rule_stats_lock);
+
+    det_ctx->rule_stats = t;
+}
+
+/**
+ *  \brief fold a detect thread's counters into the retired totals and
+ *         free its block
+ */
+void DetectRuleStatsThreadCleanup(DetectEngineThreadCtx *det_ctx)
+{
+    DetectRuleStatsThread *t = det_ctx->rule_stats;
+    uint32_t i;
+
+    if (t == NULL)
+        return;
+
+    SCMutexLock(&rule_stats_lock);
+    DetectRuleStatsCtx *ctx = t->ctx;
+    if (ctx != NULL) {
+        DetectRuleStatsThread **pt = &ctx->threads;
+        while (*pt != NULL && *pt != t)
+            pt = &(*pt)->next;
+        if (*pt == t)
+            *pt = t->next;
+
+        for (i = 0; i < t->size && i < ctx->size; i++) {
+            DetectRuleStatsDataAdd(&ctx->retired[i], &t->data[i]);
+        }
+    }
+    SCMutexUnlock(&rule_stats_lock);
+
+    SCFreeAligned(t->data);
+    SCFree(t);
+    det_ctx->rule_stats = NULL;
+}
+
+/**
+ *  \brief merge the per thread counters of the active detect engine and
+ *         log the top N. Called by the stats thread every interval.
+ */
+void DetectRuleStatsMerge(void)
+{
+    if (!rule_stats_enabled)
+        return;
+
+    SCMutexLock(&rule_stats_lock);
+    if (rule_stats_active != NULL) {
+        DetectRuleStatsMergeCtx(rule_stats_active);
+        DetectRuleStatsWriteLog(rule_stats_active);
+    }
+    SCMutexUnlock(&rule_stats_lock);
+}
+
+#ifdef BUILD_UNIX_SOCKET
+/**
+ *  \brief unix socket command returning the top N rules of the active
+ *         detect engine
+ */
+TmEcode DetectRuleStatsSocket(json_t *cmd, json_t *answer, void *data)
+{
+    DetectRuleStatsSummary *summary = NULL;
+    uint32_t cnt = 0, i;
+    uint64_t total_ticks = 0;
+    json_t *jdata;
+    json_t *jrules;
+
+    if (!rule_stats_enabled) {
+        json_object_set_new(answer, "message", json_string("rule stats are disabled"));
+        return TM_ECODE_FAILED;
+    }
+
+    jdata = json_object();
+    jrules = json_array();
+    if (jdata == NULL || jrules == NULL) {
+        if (jdata != NULL)
+            json_decref(jdata);
+        if (jrules != NULL)
+            json_decref(jrules);
+        json_object_set_new(answer, "message",
+                json_string("internal error at json object creation"));
+        return TM_ECODE_FAILED;
+    }
+
+    SCMutexLock(&rule_stats_lock);
+    if (rule_stats_active != NULL) {
+        DetectRuleStatsMergeCtx(rule_stats_active);
+        summary = DetectRuleStatsSummarize(rule_stats_active, &cnt, &total_ticks);
+
+        for (i = 0; summary != NULL && i < cnt && i < rule_stats_limit; i++) {
+            const DetectRuleStatsRule *r = &rule_stats_active->rules[summary[i].num];
+            json_t *jr = json_object();
+            if (jr == NULL)
+                break;
+
+            json_object_set_new(jr, "sid", json_integer(r->sid));
+            json_object_set_new(jr, "gid", json_integer(r->gid));
+            json_object_set_new(jr, "rev", json_integer(r->rev));
+            json_object_set_new(jr, "checks", json_integer(summary[i].checks));
+            json_object_set_new(jr, "matches", json_integer(summary[i].matches));
+            json_object_set_new(jr, "samples", json_integer(summary[i].samples));
+            json_object_set_new(jr, "ticks_estimated", json_integer(summary[i].ticks));
+            json_object_set_new(jr, "ticks_avg", json_real(summary[i].avgticks));
+            json_object_set_new(jr, "ticks_max", json_integer(summary[i].max));
+            json_object_set_new(jr, "percent", json_real(total_ticks ?
+                        (double)summary[i].ticks / (double)total_ticks * 100 : 0));
+            json_array_append_new(jrules, jr);
+        }
+    }
+    SCMutexUnlock(&rule_stats_lock);
+
+    if (summary != NULL)
+        SCFree(summary);
+
+    json_object_set_new(jdata, "sort", json_string(rule_stats_sort_names[rule_stats_sort_order]));
+    json_object_set_new(jdata, "sample_rate", json_integer(rule_stats_sample_rate));
+    json_object_set_new(jdata, "rules_checked", json_integer(cnt));
+    json_object_set_new(jdata, "rules", jrules);
+    json_object_set_new(answer, "message", jdata);
+    return TM_ECODE_OK;
+}
+#endif /* BUILD_UNIX_SOCKET */
+
+#ifdef UNITTESTS
+
+/** \internal
+ *  \brief set up a minimal detect engine with 'n' rules, sid 1..n */
+static int DetectRuleStatsTestSetup(DetectEngineCtx *de_ctx, Signature *sigs,
+        Signature **array, uint32_t n)
+{
+    uint32_t i;
+
+    memset(de_ctx, 0, sizeof(*de_ctx));
+    for (i = 0; i < n; i++) {
+        memset(&sigs[i], 0, sizeof(Signature));
+        sigs[i].num = i;
+        sigs[i].id = i + 1;
+        sigs[i].gid = 1;
+        sigs[i].rev = 1;
+        array[i] = &sigs[i];
+    }
+    de_ctx->sig_array = array;
+    de_ctx->sig_array_len = n;
+
+    rule_stats_enabled = 1;
+    rule_stats_sample_rate = 2;
+    DetectRuleStatsInitCtx(de_ctx);
+    return (de_ctx->rule_stats_ctx != NULL);
+}
+
+static void DetectRuleStatsTestCleanup(void)
+{
+    rule_stats_enabled = 0;
+    rule_stats_sample_rate = RULE_STATS_DEFAULT_SAMPLE_RATE;
+    rule_stats_sort_order = RULE_STATS_SORT_BY_TICKS;
+}
+
+/** \test checks and matches of two threads are merged, a thread that goes
+ *        away keeps counting in the totals */
+static int DetectRuleStatsTest01(void)
+{
+    DetectEngineCtx de_ctx;
+    DetectEngineThreadCtx det_ctx1, det_ctx2;
+    Signature sigs[3];
+    Signature *array[3];
+    DetectRuleStatsCtx *ctx;
+    int i;
+    int result = 0;
+
+    memset(&det_ctx1, 0, sizeof(det_ctx1));
+    memset(&det_ctx2, 0, sizeof(det_ctx2));
+
+    if (!DetectRuleStatsTestSetup(&de_ctx, sigs, array, 3))
+        goto end;
+    ctx = de_ctx.rule_stats_ctx;
+
+    DetectRuleStatsThreadSetup(&de_ctx, &det_ctx1);
+    DetectRuleStatsThreadSetup(&de_ctx, &det_ctx2);
+    if (det_ctx1.rule_stats == NULL || det_ctx2.rule_stats == NULL)
+        goto end;
+
+    for (i = 0; i < 10; i++) {
+        RULE_STATS_START(&det_ctx1);
+        RULE_STATS_END(&det_ctx1, &sigs[0], (i < 3));
+    }
+    for (i = 0; i < 4; i++) {
+        RULE_STATS_START(&det_ctx2);
+        RULE_STATS_END(&det_ctx2, &sigs[0], 0);
+    }
+    {
+        RULE_STATS_START(&det_ctx2);
+        RULE_STATS_END(&det_ctx2, &sigs[2], 1);
+    }
+
+    /* 1 in 2 checks is timed */
+    if (det_ctx1.rule_stats->data[0].samples != 5) {
+        printf("samples %"PRIu64", expected 5: ", det_ctx1.rule_stats->data[0].samples);
+        goto end;
+    }
+
+    DetectRuleStatsThreadCleanup(&det_ctx2);
+    if (det_ctx2.rule_stats != NULL || ctx->threads != det_ctx1.rule_stats ||
+            ctx->threads->next != NULL)
+        goto end;
+
+    DetectRuleStatsMerge();
+
+    if (ctx->merged[0].checks != 14 || ctx->merged[0].matches != 3 ||
+            ctx->merged[1].checks != 0 ||
+            ctx->merged[2].checks != 1 || ctx->merged[2].matches != 1) {
+        printf("merged %"PRIu64"/%"PRIu64" %"PRIu64" %"PRIu64"/%"PRIu64": ",
+                ctx->merged[0].checks, ctx->merged[0].matches,
+                ctx->merged[1].checks, ctx->merged[2].checks,
+                ctx->merged[2].matches);
+        goto end;
+    }
+
+    result = 1;
+end:
+    DetectRuleStatsThreadCleanup(&det_ctx1);
+    DetectRuleStatsThreadCleanup(&det_ctx2);
+    DetectRuleStatsDestroyCtx(&de_ctx);
+    DetectRuleStatsTestCleanup();
+    return result;
+}
+
+/** \test summary skips unchecked rules and follows the sort order */
+static int DetectRuleStatsTest02(void)
+{
+    DetectEngineCtx de_ctx;
+    DetectEngineThreadCtx det_ctx;
+    Signature sigs[3];
+    Signature *array[3];
+    DetectRuleStatsSummary *summary = NULL;
+    DetectRuleStatsThread *t;
+    uint32_t cnt = 0;
+    uint64_t total = 0;
+    int result = 0;
+
+    memset(&det_ctx, 0, sizeof(det_ctx));
+
+    if (!DetectRuleStatsTestSetup(&de_ctx, sigs, array, 3))
+        goto end;
+
+    DetectRuleStatsThreadSetup(&de_ctx, &det_ctx);
+    if ((t = det_ctx.rule_stats) == NULL)
+        goto end;
+
+    /* rule 1: many cheap checks, rule 3: few expensive ones */
+    t->data[0].checks = 1000;
+    t->data[0].samples = 10;
+    t->data[0].ticks = 100;
+    t->data[0].max = 20;
+    t->data[2].checks = 10;
+    t->data[2].matches = 10;
+    t->data[2].samples = 5;
+    t->data[2].ticks = 50000;
+    t->data[2].max = 20000;
+
+    SCMutexLock(&rule_stats_lock);
+    DetectRuleStatsMergeCtx(de_ctx.rule_stats_ctx);
+    summary = DetectRuleStatsSummarize(de_ctx.rule_stats_ctx, &cnt, &total);
+    SCMutexUnlock(&rule_stats_lock);
+
+    if (summary == NULL || cnt != 2)
+        goto end;
+    /* 10 * 10000 estimated ticks beat 1000 * 10 */
+    if (summary[0].num != 2 || summary[0].ticks != 100000 ||
+            summary[1].num != 0 || summary[1].ticks != 10000 || total != 110000) {
+        printf("order %u/%"PRIu64" %u/%"PRIu64" total %"PRIu64": ", summary[0].num,
+                summary[0].ticks, summary[1].num, summary[1].ticks, total);
+        goto end;
+    }
+    SCFree(summary);
+
+    rule_stats_sort_order = RULE_STATS_SORT_BY_CHECKS;
+    SCMutexLock(&rule_stats_lock);
+    summary = DetectRuleStatsSummarize(de_ctx.rule_stats_ctx, &cnt, &total);
+    SCMutexUnlock(&rule_stats_lock);
+
+    if (summary == NULL || cnt != 2 || summary[0].num != 0)
+        goto end;
+
+    result = 1;
+end:
+    if (summary != NULL)
+        SCFree(summary);
+    DetectRuleStatsThreadCleanup(&det_ctx);
+    DetectRuleStatsDestroyCtx(&de_ctx);
+    DetectRuleStatsTestCleanup();
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void DetectRuleStatsRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("DetectRuleStatsTest01", DetectRuleStatsTest01, 1);
+    UtRegisterTest("DetectRuleStatsTest02", DetectRuleStatsTest02, 1);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,104 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Per rule cost accounting that is part of every build.
+ */
+
+#ifndef __DETECT_ENGINE_RULESTATS_H__
+#define __DETECT_ENGINE_RULESTATS_H__
+
+#include "util-cpu.h"
+
+/** per rule counters, one array per detect thread indexed by Signature::num */
+typedef struct DetectRuleStatsData_ {
+    uint64_t checks;
+    uint64_t matches;
+    uint64_t ticks;         /**< ticks of the sampled checks */
+    uint64_t samples;       /**< number of sampled checks */
+    uint64_t max;           /**< max ticks of a sampled check */
+} DetectRuleStatsData;
+
+/** per detect thread block, hangs off the DetectEngineThreadCtx */
+typedef struct DetectRuleStatsThread_ {
+    uint32_t countdown;     /**< checks until the next sampled check */
+    uint32_t size;
+    DetectRuleStatsData *data;
+
+    struct DetectRuleStatsCtx_ *ctx;
+    struct DetectRuleStatsThread_ *next;
+} DetectRuleStatsThread;
+
+extern uint32_t rule_stats_sample_rate;
+
+void DetectRuleStatsGlobalInit(void);
+void DetectRuleStatsInitCtx(DetectEngineCtx *);
+void DetectRuleStatsDestroyCtx(DetectEngineCtx *);
+void DetectRuleStatsThreadSetup(DetectEngineCtx *, DetectEngineThreadCtx *);
+void DetectRuleStatsThreadCleanup(DetectEngineThreadCtx *);
+void DetectRuleStatsMerge(void);
+void DetectRuleStatsRegisterTests(void);
+
+#ifdef BUILD_UNIX_SOCKET
+#include <jansson.h>
+TmEcode DetectRuleStatsSocket(json_t *, json_t *, void *);
+#endif
+
+/**
+ *  \brief account a rule check, the ticks are only taken for the
+ *         sampled checks
+ */
+static inline void DetectRuleStatsUpdate(DetectRuleStatsThread *rs,
+        uint32_t num, uint64_t ticks_start, int match)
+{
+    if (unlikely(num >= rs->size))
+        return;
+
+    DetectRuleStatsData *d = &rs->data[num];
+    d->checks++;
+    if (match == 1)
+        d->matches++;
+
+    if (ticks_start != 0) {
+        uint64_t ticks_end = UtilCpuGetTicks();
+        if (ticks_end > ticks_start) {
+            uint64_t ticks = ticks_end - ticks_start;
+            d->ticks += ticks;
+            d->samples++;
+            if (ticks > d->max)
+                d->max = ticks;
+        }
+    }
+}
+
+#define RULE_STATS_START(det_ctx)                                       \
+    uint64_t rule_stats_ticks_ = 0;                                     \
+    if ((det_ctx)->rule_stats != NULL &&                                \
+            (det_ctx)->rule_stats->countdown-- == 0) {                  \
+        (det_ctx)->rule_stats->countdown = rule_stats_sample_rate - 1;  \
+        rule_stats_ticks_ = UtilCpuGetTicks();                          \
+    }
+
+#define RULE_STATS_END(det_ctx, s, m)                                   \
+    if ((det_ctx)->rule_stats != NULL) {                                \
+        DetectRuleStatsUpdate((det_ctx)->rule_stats, (s)->num,          \
+                rule_stats_ticks_, (m));                                \
+    }
+
+#endif /* __DETECT_ENGINE_RULESTATS_H__ */
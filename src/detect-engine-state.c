@@ -53,6 +53,7 @@
 
 #include "detect.h"
 #include "detect-engine.h"
+#include "detect-engine-rulestats.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-dcepayload.h"
@@ -70,6 +71,7 @@
 #include "app-layer-dcerpc-common.h"
 #include "app-layer-dcerpc.h"
 #include "app-layer-dns-common.h"
+#include "app-layer-smtp.h"
 
 #include "util-unittest.h"
 #include "util-unittest-helper.h"
@@ -155,10 +157,28 @@ static int DeStateStoreFilestoreSigsCantMatch(SigGroupHead *sgh, DetectEngineSta
 
 static void DeStateResetFileInspection(Flow *f, uint16_t alproto, void *alstate, uint8_t direction)
 {
-    if (f == NULL || alproto != ALPROTO_HTTP || alstate == NULL || f->de_state == NULL)
+    if (f == NULL || alstate == NULL || f->de_state == NULL)
+        return;
+    if (alproto != ALPROTO_HTTP && alproto != ALPROTO_SMTP)
         return;
 
     FLOWLOCK_WRLOCK(f);
+
+    if (alproto == ALPROTO_SMTP) {
+        SMTPState *smtp_state = (SMTPState *)alstate;
+
+        /* mails only carry files to the server */
+        if ((direction & STREAM_TOSERVER) &&
+            (smtp_state->flags & SMTP_FLAG_NEW_FILE_TX_TS)) {
+            SCLogDebug("new file in the TS direction");
+            smtp_state->flags &= ~SMTP_FLAG_NEW_FILE_TX_TS;
+            f->de_state->dir_state[0].flags |= DETECT_ENGINE_STATE_FLAG_FILE_TS_NEW;
+        }
+
+        FLOWLOCK_UNLOCK(f);
+        return;
+    }
+
     HtpState *htp_state = (HtpState *)alstate;
 
     if (direction & STREAM_TOSERVER) {
@@ -329,7 +349,10 @@ int DeStateDetectStartDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
                 if (AppLayerGetAlstateProgress(alproto, tx, direction) <
                     AppLayerGetAlstateProgressCompletionStatus(alproto, direction)) {
                     store_de_state = 1;
-                    if (engine == NULL || inspect_flags & DE_STATE_FLAG_SIG_CANT_MATCH)
+                    /* if none of the engines applied to the sig, its app
+                     * keywords (if any) still need to be inspected */
+                    if ((engine == NULL && total_matches > 0) ||
+                        inspect_flags & DE_STATE_FLAG_SIG_CANT_MATCH)
                         inspect_flags |= DE_STATE_FLAG_FULL_INSPECT;
                 }
             }
@@ -559,6 +582,7 @@ void DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
             match = 0;
 
             RULE_PROFILING_START;
+            RULE_STATS_START(det_ctx);
 
             if (alproto_supports_txs) {
                 FLOWLOCK_WRLOCK(f);
@@ -568,6 +592,7 @@ void DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
                     if (htp_state->conn == NULL) {
                         FLOWLOCK_UNLOCK(f);
                         RULE_PROFILING_END(det_ctx, s, match);
+                        RULE_STATS_END(det_ctx, s, match);
                         goto end;
                     }
                 }
@@ -577,6 +602,7 @@ void DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
                 if (inspect_tx == NULL) {
                     FLOWLOCK_UNLOCK(f);
                     RULE_PROFILING_END(det_ctx, s, match);
+                    RULE_STATS_END(det_ctx, s, match);
                     goto end;
                 }
                 while (engine != NULL) {
@@ -633,6 +659,7 @@ void DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
                     }
             }
             RULE_PROFILING_END(det_ctx, s, match);
+            RULE_STATS_END(det_ctx, s, match);
 
             if (s->sm_lists[DETECT_SM_LIST_AMATCH] != NULL) {
                 if (sm == NULL || inspect_flags & DE_STATE_FLAG_SIG_CANT_MATCH) {
@@ -685,7 +712,8 @@ void DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
 
 end:
     if (f->de_state != NULL)
-        dir_state->flags &= ~DETECT_ENGINE_STATE_FLAG_FILE_TC_NEW;
+        dir_state->flags &= ~(DETECT_ENGINE_STATE_FLAG_FILE_TC_NEW |
+                              DETECT_ENGINE_STATE_FLAG_FILE_TS_NEW);
 
     if (reset_de_state)
         DetectEngineStateReset(f->de_state, flags);
@@ -720,6 +748,63 @@ void DetectEngineStateReset(DetectEngineState *state, uint8_t direction)
     return;
 }
 
+/**
+ *  \internal
+ *  \brief Map the stored state of one direction to a reloaded engine.
+ *
+ *  \retval 1 all stored sigs are unchanged, state is mapped
+ *  \retval 0 a stored sig changed, state is untouched
+ */
+static int DeStateReloadRemapDirection(DetectEngineCtx *de_ctx,
+        DetectEngineStateDirection *dir_state)
+{
+    DeStateStore *store;
+    SigIntId sid;
+    SigMatch *nm;
+    SigIntId i;
+    int remap;
+
+    /* check all items before changing any */
+    for (remap = 0; remap < 2; remap++) {
+        store = dir_state->head;
+        for (i = 0; i < dir_state->cnt; i++) {
+            if (i > 0 && i % DE_STATE_CHUNK_SIZE == 0)
+                store = store->next;
+            if (store == NULL)
+                return 0;
+
+            DeStateStoreItem *item = &store->store[i % DE_STATE_CHUNK_SIZE];
+            if (!DetectEngineReloadMapSig(de_ctx, item->sid, &sid) ||
+                !DetectEngineReloadMapSigMatch(de_ctx, item->nm, &nm))
+                return 0;
+
+            if (remap) {
+                item->sid = sid;
+                item->nm = nm;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ *  \brief Carry the detection state of a flow over from the engine de_ctx
+ *         was reloaded from. A direction is kept if all the sigs it has
+ *         state for are unchanged, otherwise it's reset.
+ *
+ *  \param state the flow's state, must be locked by the caller
+ */
+void DeStateReloadRemap(DetectEngineCtx *de_ctx, DetectEngineState *state)
+{
+    if (state == NULL)
+        return;
+
+    if (!DeStateReloadRemapDirection(de_ctx, &state->dir_state[0]))
+        DetectEngineStateReset(state, STREAM_TOSERVER);
+    if (!DeStateReloadRemapDirection(de_ctx, &state->dir_state[1]))
+        DetectEngineStateReset(state, STREAM_TOCLIENT);
+}
+
 /** \brief get string for match enum */
 const char *DeStateMatchResultToString(DeStateMatchResult res)
 {
@@ -1835,6 +1920,102 @@ end:
     return result;
 }
 
+static Signature *DeStateTestGetSig(DetectEngineCtx *de_ctx, uint32_t sid)
+{
+    Signature *s;
+    for (s = de_ctx->sig_list; s != NULL; s = s->next) {
+        if (s->id == sid)
+            return s;
+    }
+    return NULL;
+}
+
+/**
+ * \test on reload a direction keeps its state if it only refers to
+ *       unchanged sigs, and is reset otherwise.
+ */
+static int DeStateReloadTest01(void)
+{
+    DetectEngineCtx *old_de_ctx = NULL;
+    DetectEngineCtx *de_ctx = NULL;
+    DetectEngineState *state = NULL;
+    Signature *s1, *s2, *n1;
+    char *old_sigs[2];
+    char *new_sigs[3];
+    int result = 0;
+
+    old_sigs[0] = "alert tls any any -> any any (tls.version:1.0; sid:1;)";
+    old_sigs[1] = "alert tls any any -> any any (tls.version:1.1; sid:2;)";
+    /* sid 3 is new, sid 2 changed without a rev bump */
+    new_sigs[0] = "alert tls any any -> any any (tls.version:1.2; sid:3;)";
+    new_sigs[1] = old_sigs[0];
+    new_sigs[2] = "alert tls any any -> any any (tls.version:1.2; sid:2;)";
+
+    old_de_ctx = DetectEngineCtxInit();
+    if (old_de_ctx == NULL)
+        goto end;
+    old_de_ctx->flags |= DE_QUIET;
+    if (UTHAppendSigs(old_de_ctx, old_sigs, 2) == 0)
+        goto end;
+    SigGroupBuild(old_de_ctx);
+
+    de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL)
+        goto end;
+    de_ctx->flags |= DE_QUIET;
+    if (DetectEngineReloadStart(de_ctx, old_de_ctx) != 0)
+        goto end;
+    if (UTHAppendSigs(de_ctx, new_sigs, 3) == 0)
+        goto end;
+    SigGroupBuild(de_ctx);
+    DetectEngineReloadDone(de_ctx);
+
+    s1 = DeStateTestGetSig(old_de_ctx, 1);
+    s2 = DeStateTestGetSig(old_de_ctx, 2);
+    n1 = DeStateTestGetSig(de_ctx, 1);
+    if (s1 == NULL || s2 == NULL || n1 == NULL)
+        goto end;
+
+    state = DetectEngineStateAlloc();
+    if (state == NULL)
+        goto end;
+
+    /* to server: only the unchanged sig, inspected up to its app layer match */
+    DeStateSignatureAppend(state, s1, s1->sm_lists[DETECT_SM_LIST_AMATCH],
+            0, STREAM_TOSERVER);
+    /* to client: the unchanged and the changed sig */
+    DeStateSignatureAppend(state, s1, NULL, DE_STATE_FLAG_FULL_INSPECT,
+            STREAM_TOCLIENT);
+    DeStateSignatureAppend(state, s2, NULL, 0, STREAM_TOCLIENT);
+
+    DeStateReloadRemap(de_ctx, state);
+
+    if (state->dir_state[0].cnt != 1 ||
+        state->dir_state[0].head->store[0].sid != n1->num ||
+        state->dir_state[0].head->store[0].nm != n1->sm_lists[DETECT_SM_LIST_AMATCH]) {
+        printf("to server state not mapped: ");
+        goto end;
+    }
+    if (state->dir_state[1].cnt != 0) {
+        printf("to client state not reset: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (state != NULL)
+        DetectEngineStateFree(state);
+    if (old_de_ctx != NULL) {
+        SigGroupCleanup(old_de_ctx);
+        DetectEngineCtxFree(old_de_ctx);
+    }
+    if (de_ctx != NULL) {
+        SigGroupCleanup(de_ctx);
+        DetectEngineCtxFree(de_ctx);
+    }
+    return result;
+}
+
 #endif
 
 void DeStateRegisterTests(void)
@@ -1850,6 +2031,7 @@ void DeStateRegisterTests(void)
     UtRegisterTest("DeStateSigTest05", DeStateSigTest05, 1);
     UtRegisterTest("DeStateSigTest06", DeStateSigTest06, 1);
     UtRegisterTest("DeStateSigTest07", DeStateSigTest07, 1);
+    UtRegisterTest("DeStateReloadTest01", DeStateReloadTest01, 1);
 #endif
 
     return;
@@ -207,6 +207,14 @@ void DeStateUpdateInspectTransactionId(Flow *f, uint8_t direction);
  */
 void DetectEngineStateReset(DetectEngineState *state, uint8_t direction);
 
+/**
+ * \brief Map a DetectEngineState to the engine it was reloaded to.
+ *
+ * \param de_ctx    The reloaded engine.
+ * \param state     Pointer to the state(LOCKED).
+ */
+void DeStateReloadRemap(DetectEngineCtx *de_ctx, DetectEngineState *state);
+
 void DeStateRegisterTests(void);
 
 #endif /* __DETECT_ENGINE_STATE_H__ */
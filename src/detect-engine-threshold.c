@@ -40,9 +40,6 @@
 #include "detect.h"
 #include "flow.h"
 
-#include "host.h"
-#include "host-storage.h"
-
 #include "detect-parse.h"
 #include "detect-engine-sigorder.h"
 
@@ -58,7 +55,12 @@
 #include "detect-content.h"
 #include "detect-uricontent.h"
 
+#include "conf.h"
 #include "util-hash.h"
+#include "util-hash-lookup3.h"
+#include "util-byte.h"
+#include "util-misc.h"
+#include "util-random.h"
 #include "util-time.h"
 #include "util-error.h"
 #include "util-debug.h"
@@ -66,22 +68,162 @@
 #include "util-var-name.h"
 #include "tm-threads.h"
 
-static int threshold_id = -1; /**< host storage id for thresholds */
+#define THRESHOLD_DEFAULT_HASHSIZE  4096
+#define THRESHOLD_DEFAULT_MEMCAP    (16 * 1024 * 1024)
 
-int ThresholdHostStorageId(void) {
-    return threshold_id;
-}
+/** \brief row of the threshold hash. Each row has its own lock, so
+ *         alerts for different sids or addresses rarely contend. The
+ *         counters are protected by the row lock as well. */
+typedef struct ThresholdHashRow_ {
+    SCMutex lock;
+    DetectThresholdEntry *head;
+    uint32_t entries;       /**< entries in this row */
+    uint64_t lookups;       /**< lookups done in this row */
+    uint64_t evictions;     /**< entries evicted because of the memcap */
+} __attribute__((aligned(CLS))) ThresholdHashRow;
+
+typedef struct ThresholdConfig_ {
+    uint64_t memcap;
+    uint32_t hash_size;
+    uint32_t hash_rand;
+} ThresholdConfig;
+
+/** table holding the by_src and by_dst threshold state, keyed
+ *  by sid, gid, track and address */
+static ThresholdHashRow *threshold_hash = NULL;
+static ThresholdConfig threshold_config;
+
+SC_ATOMIC_DECLARE(unsigned long long int, threshold_memuse);
+
+#define THRESHOLD_CHECK_MEMCAP(size) \
+    ((((uint64_t)SC_ATOMIC_GET(threshold_memuse) + (uint64_t)(size)) <= threshold_config.memcap))
 
+/**
+ *  \brief Set up the threshold table, using the "threshold" section of
+ *         the config for the memcap and hash size.
+ */
 void ThresholdInit(void) {
-    threshold_id = HostStorageRegister("threshold", sizeof(void *), NULL, ThresholdListFree);
-    if (threshold_id == -1) {
-        SCLogError(SC_ERR_HOST_INIT, "Can't initiate host storage for thresholding");
+    char *conf_val;
+    uint32_t configval = 0;
+    uint32_t u;
+
+    if (threshold_hash != NULL)
+        return;
+
+    SC_ATOMIC_INIT(threshold_memuse);
+
+    unsigned int seed = RandomTimePreseed();
+    threshold_config.hash_rand = (int)(THRESHOLD_DEFAULT_HASHSIZE *
+            (rand_r(&seed) / RAND_MAX + 1.0));
+    threshold_config.hash_size = THRESHOLD_DEFAULT_HASHSIZE;
+    threshold_config.memcap = THRESHOLD_DEFAULT_MEMCAP;
+
+    if ((ConfGet("threshold.memcap", &conf_val)) == 1) {
+        if (ParseSizeStringU64(conf_val, &threshold_config.memcap) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing threshold.memcap "
+                       "from conf file - %s.  Killing engine", conf_val);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if ((ConfGet("threshold.hash-size", &conf_val)) == 1) {
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                                    conf_val) > 0 && configval > 0) {
+            threshold_config.hash_size = configval;
+        } else {
+            WarnInvalidConfEntry("threshold.hash-size", "%"PRIu32,
+                    threshold_config.hash_size);
+        }
+    }
+
+    uint64_t hash_size = threshold_config.hash_size * sizeof(ThresholdHashRow);
+    if (!(THRESHOLD_CHECK_MEMCAP(hash_size))) {
+        SCLogError(SC_ERR_THRESHOLD_SETUP, "allocating threshold hash failed: "
+                "max threshold memcap is smaller than projected hash size. "
+                "Memcap: %"PRIu64", Hash table size %"PRIu64". Calculate "
+                "total hash size by multiplying \"threshold.hash-size\" with "
+                "%"PRIuMAX", which is the hash bucket size.",
+                threshold_config.memcap, hash_size,
+                (uintmax_t)sizeof(ThresholdHashRow));
+        exit(EXIT_FAILURE);
+    }
+
+    threshold_hash = SCMalloc(hash_size);
+    if (unlikely(threshold_hash == NULL)) {
+        SCLogError(SC_ERR_FATAL, "Fatal error encountered in ThresholdInit. Exiting...");
         exit(EXIT_FAILURE);
     }
+    memset(threshold_hash, 0, hash_size);
+
+    for (u = 0; u < threshold_config.hash_size; u++) {
+        SCMutexInit(&threshold_hash[u].lock, NULL);
+    }
+    (void) SC_ATOMIC_ADD(threshold_memuse, hash_size);
+
+    SCLogDebug("threshold hash: %"PRIu32" rows, memcap %"PRIu64,
+            threshold_config.hash_size, threshold_config.memcap);
 }
 
-int ThresholdHostHasThreshold(Host *host) {
-    return HostGetStorageById(host, threshold_id) ? 1 : 0;
+/**
+ *  \brief Free the threshold table and all its entries.
+ *  \warning Not thread safe
+ */
+void ThresholdShutdown(void) {
+    uint32_t u;
+
+    if (threshold_hash == NULL)
+        return;
+
+    for (u = 0; u < threshold_config.hash_size; u++) {
+        ThresholdListFree(threshold_hash[u].head);
+        threshold_hash[u].head = NULL;
+        SCMutexDestroy(&threshold_hash[u].lock);
+    }
+    SCFree(threshold_hash);
+    threshold_hash = NULL;
+
+    SC_ATOMIC_DESTROY(threshold_memuse);
+}
+
+/**
+ *  \brief Get the threshold table counters. The row counters are read
+ *         without locking, so the totals are approximate.
+ */
+void ThresholdGetStats(ThresholdStats *stats) {
+    uint32_t u;
+
+    memset(stats, 0, sizeof(ThresholdStats));
+    if (threshold_hash == NULL)
+        return;
+
+    for (u = 0; u < threshold_config.hash_size; u++) {
+        stats->entries += threshold_hash[u].entries;
+        stats->lookups += threshold_hash[u].lookups;
+        stats->evictions += threshold_hash[u].evictions;
+    }
+    stats->memuse = SC_ATOMIC_GET(threshold_memuse);
+}
+
+static inline uint32_t ThresholdGetKey(uint32_t sid, uint32_t gid, int track, Address *a)
+{
+    uint32_t key[7];
+    uint32_t len = 3;
+
+    key[0] = sid;
+    key[1] = gid;
+    key[2] = (uint32_t)track;
+
+    if (a->family == AF_INET) {
+        key[3] = a->addr_data32[0];
+        len = 4;
+    } else if (a->family == AF_INET6) {
+        key[3] = a->addr_data32[0];
+        key[4] = a->addr_data32[1];
+        key[5] = a->addr_data32[2];
+        key[6] = a->addr_data32[3];
+        len = 7;
+    }
+
+    return hashword(key, len, threshold_config.hash_rand) % threshold_config.hash_size;
 }
 
 /**
@@ -128,51 +270,77 @@ DetectThresholdData *SigGetThresholdTypeIter(Signature *sig, Packet *p, SigMatch
 }
 
 /**
- * \brief Remove timeout threshold hash elements
+ *  \internal
  *
- * \param de_ctx Dectection Context
+ *  \brief Remove the timed out entries of a hash row
  *
+ *  \param hb threshold hash row *LOCKED*
+ *  \param tv timestamp
+ *
+ *  \retval cnt number of entries removed
  */
-
-int ThresholdTimeoutCheck(Host *host, struct timeval *tv)
+static uint32_t ThresholdHashRowTimeout(ThresholdHashRow *hb, struct timeval *tv)
 {
-    DetectThresholdEntry *tde = NULL;
-    DetectThresholdEntry *tmp = NULL;
+    DetectThresholdEntry *tmp = hb->head;
     DetectThresholdEntry *prev = NULL;
-    int retval = 1;
-
-    tmp = HostGetStorageById(host, threshold_id);
-    if (tmp == NULL)
-         return 1;
+    uint32_t cnt = 0;
 
-    prev = NULL;
     while (tmp != NULL) {
         if ((tv->tv_sec - tmp->tv_sec1) <= tmp->seconds) {
             prev = tmp;
             tmp = tmp->next;
-            retval = 0;
             continue;
         }
 
         /* timed out */
+        DetectThresholdEntry *tde = tmp;
+        tmp = tde->next;
+
+        if (prev != NULL)
+            prev->next = tmp;
+        else
+            hb->head = tmp;
+
+        SCFree(tde);
+        (void) SC_ATOMIC_SUB(threshold_memuse, sizeof(DetectThresholdEntry));
+        hb->entries--;
+        cnt++;
+    }
+
+    return cnt;
+}
+
+/**
+ *  \brief Remove timed out entries from the threshold table. Rows that
+ *         are locked by a detect thread are skipped until the next run.
+ *
+ *  \param tv timestamp
+ *
+ *  \retval cnt number of entries removed
+ */
+uint32_t ThresholdTimeoutHash(struct timeval *tv)
+{
+    uint32_t u;
+    uint32_t cnt = 0;
 
-        if (prev != NULL) {
-            prev->next = tmp->next;
+    if (threshold_hash == NULL)
+        return 0;
 
-            tde = tmp;
-            tmp = tde->next;
+    for (u = 0; u < threshold_config.hash_size; u++) {
+        ThresholdHashRow *hb = &threshold_hash[u];
 
-            SCFree(tde);
-        } else {
-            HostSetStorageById(host, threshold_id, tmp->next);
-            tde = tmp;
-            tmp = tde->next;
+        /* unlocked check, a stale value only delays the timeout */
+        if (hb->head == NULL)
+            continue;
 
-            SCFree(tde);
-        }
+        if (SCMutexTrylock(&hb->lock) != 0)
+            continue;
+
+        cnt += ThresholdHashRowTimeout(hb, tv);
+        SCMutexUnlock(&hb->lock);
     }
 
-    return retval;
+    return cnt;
 }
 
 static inline DetectThresholdEntry *DetectThresholdEntryAlloc(DetectThresholdData *td, Packet *p, uint32_t sid, uint32_t gid) {
@@ -182,6 +350,7 @@ static inline DetectThresholdEntry *DetectThresholdEntryAlloc(DetectThresholdDat
     if (unlikely(ste == NULL)) {
         SCReturnPtr(NULL, "DetectThresholdEntry");
     }
+    memset(ste, 0, sizeof(DetectThresholdEntry));
 
     ste->sid = sid;
     ste->gid = gid;
@@ -193,27 +362,118 @@ static inline DetectThresholdEntry *DetectThresholdEntryAlloc(DetectThresholdDat
     SCReturnPtr(ste, "DetectThresholdEntry");
 }
 
-static DetectThresholdEntry *ThresholdHostLookupEntry(Host *h, uint32_t sid, uint32_t gid)
+/**
+ *  \internal
+ *
+ *  \brief Find the entry for sid, gid, track and address in a hash row
+ *
+ *  \param hb threshold hash row *LOCKED*
+ */
+static DetectThresholdEntry *ThresholdLookupEntry(ThresholdHashRow *hb,
+        uint32_t sid, uint32_t gid, int track, Address *a)
 {
     DetectThresholdEntry *e;
 
-    for (e = HostGetStorageById(h, threshold_id); e != NULL; e = e->next) {
-        if (e->sid == sid && e->gid == gid)
+    hb->lookups++;
+
+    for (e = hb->head; e != NULL; e = e->next) {
+        if (e->sid == sid && e->gid == gid && e->track == track &&
+            CMP_ADDR(&e->addr, a))
             break;
     }
 
     return e;
 }
 
+/**
+ *  \internal
+ *
+ *  \brief Get a new entry and add it to a hash row. If the memcap is
+ *         reached, the entry of the row that was updated longest ago
+ *         is reused.
+ *
+ *  \param hb threshold hash row *LOCKED*
+ *
+ *  \retval e new entry or NULL if the memcap is reached and the row
+ *            has no entry to evict
+ */
+static DetectThresholdEntry *ThresholdNewEntry(ThresholdHashRow *hb,
+        DetectThresholdData *td, Packet *p, uint32_t sid, uint32_t gid, Address *a)
+{
+    DetectThresholdEntry *e = NULL;
+
+    if (THRESHOLD_CHECK_MEMCAP(sizeof(DetectThresholdEntry))) {
+        e = DetectThresholdEntryAlloc(td, p, sid, gid);
+        if (e == NULL)
+            return NULL;
+
+        (void) SC_ATOMIC_ADD(threshold_memuse, sizeof(DetectThresholdEntry));
+        e->next = hb->head;
+        hb->head = e;
+        hb->entries++;
+    } else {
+        DetectThresholdEntry *tmp;
+        for (tmp = hb->head; tmp != NULL; tmp = tmp->next) {
+            if (e == NULL || tmp->tv_sec1 < e->tv_sec1)
+                e = tmp;
+        }
+        if (e == NULL)
+            return NULL;
+
+        /* reuse in place, so it keeps its position in the row */
+        DetectThresholdEntry *next = e->next;
+        memset(e, 0, sizeof(DetectThresholdEntry));
+        e->next = next;
+        e->sid = sid;
+        e->gid = gid;
+        e->track = td->track;
+        e->seconds = td->seconds;
+        hb->evictions++;
+    }
+
+    COPY_ADDRESS(a, &e->addr);
+    return e;
+}
+
+/**
+ *  \brief Get a copy of the threshold entry for a sid and tracked address
+ *
+ *  \param e[out] copy of the entry, next pointer cleared
+ *
+ *  \retval 1 found
+ *  \retval 0 not found
+ */
+int ThresholdGetEntry(uint32_t sid, uint32_t gid, int track, Address *a,
+        DetectThresholdEntry *e)
+{
+    int r = 0;
+
+    if (threshold_hash == NULL)
+        return 0;
+
+    ThresholdHashRow *hb = &threshold_hash[ThresholdGetKey(sid, gid, track, a)];
+    SCMutexLock(&hb->lock);
+    DetectThresholdEntry *lookup = ThresholdLookupEntry(hb, sid, gid, track, a);
+    if (lookup != NULL) {
+        *e = *lookup;
+        e->next = NULL;
+        r = 1;
+    }
+    SCMutexUnlock(&hb->lock);
+    return r;
+}
+
 /**
  *  \retval 2 silent match (no alert but apply actions)
  *  \retval 1 normal match
  *  \retval 0 no match
  */
-int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint32_t sid, uint32_t gid) {
+static int ThresholdHandlePacket(ThresholdHashRow *hb, Address *a, Packet *p,
+        DetectThresholdData *td, uint32_t sid, uint32_t gid)
+{
     int ret = 0;
 
-    DetectThresholdEntry *lookup_tsh = ThresholdHostLookupEntry(h, sid, gid);
+    DetectThresholdEntry *lookup_tsh = ThresholdLookupEntry(hb, sid, gid, td->track, a);
     SCLogDebug("lookup_tsh %p sid %u gid %u", lookup_tsh, sid, gid);
 
     switch(td->type)   {
@@ -237,7 +497,7 @@ int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint3
                     ret = 1;
                 }
             } else {
-                DetectThresholdEntry *e = DetectThresholdEntryAlloc(td, p, sid, gid);
+                DetectThresholdEntry *e = ThresholdNewEntry(hb, td, p, sid, gid, a);
                 if (e == NULL) {
                     break;
                 }
@@ -246,9 +506,6 @@ int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint3
                 e->current_count = 1;
 
                 ret = 1;
-
-                e->next = HostGetStorageById(h, threshold_id);
-                HostSetStorageById(h, threshold_id, e);
             }
             break;
         }
@@ -272,16 +529,13 @@ int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint3
                 if (td->count == 1)  {
                     ret = 1;
                 } else {
-                    DetectThresholdEntry *e = DetectThresholdEntryAlloc(td, p, sid, gid);
+                    DetectThresholdEntry *e = ThresholdNewEntry(hb, td, p, sid, gid, a);
                     if (e == NULL) {
                         break;
                     }
 
                     e->current_count = 1;
                     e->tv_sec1 = p->ts.tv_sec;
-
-                    e->next = HostGetStorageById(h, threshold_id);
-                    HostSetStorageById(h, threshold_id, e);
                 }
             }
             break;
@@ -312,7 +566,7 @@ int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint3
                     }
                 }
             } else {
-                DetectThresholdEntry *e = DetectThresholdEntryAlloc(td, p, sid, gid);
+                DetectThresholdEntry *e = ThresholdNewEntry(hb, td, p, sid, gid, a);
                 if (e == NULL) {
                     break;
                 }
@@ -320,9 +574,6 @@ int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint3
                 e->current_count = 1;
                 e->tv_sec1 = p->ts.tv_sec;
 
-                e->next = HostGetStorageById(h, threshold_id);
-                HostSetStorageById(h, threshold_id, e);
-
                 /* for the first match we return 1 to
                  * indicate we should alert */
                 if (td->count == 1)  {
@@ -355,7 +606,7 @@ int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint3
                     lookup_tsh->current_count = 1;
                 }
             } else {
-                DetectThresholdEntry *e = DetectThresholdEntryAlloc(td, p, sid, gid);
+                DetectThresholdEntry *e = ThresholdNewEntry(hb, td, p, sid, gid, a);
                 if (e == NULL) {
                     break;
                 }
@@ -363,9 +614,6 @@ int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint3
                 e->current_count = 1;
                 e->tv_sec1 = p->ts.tv_sec;
                 e->tv_usec1 = p->ts.tv_usec;
-
-                e->next = HostGetStorageById(h, threshold_id);
-                HostSetStorageById(h, threshold_id, e);
             }
             break;
         }
@@ -444,7 +692,7 @@ int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint3
                     ret = 1;
                 }
 
-                DetectThresholdEntry *e = DetectThresholdEntryAlloc(td, p, sid, gid);
+                DetectThresholdEntry *e = ThresholdNewEntry(hb, td, p, sid, gid, a);
                 if (e == NULL) {
                     break;
                 }
@@ -452,9 +700,6 @@ int ThresholdHandlePacketHost(Host *h, Packet *p, DetectThresholdData *td, uint3
                 e->current_count = 1;
                 e->tv_sec1 = p->ts.tv_sec;
                 e->tv_timeout = 0;
-
-                e->next = HostGetStorageById(h, threshold_id);
-                HostSetStorageById(h, threshold_id, e);
             }
             break;
         }
@@ -594,18 +839,16 @@ int PacketAlertThreshold(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx
         SCReturnInt(0);
     }
 
-    if (td->track == TRACK_SRC) {
-        Host *src = HostGetHostFromHash(&p->src);
-        if (src) {
-            ret = ThresholdHandlePacketHost(src,p,td,s->id,s->gid);
-            HostRelease(src);
-        }
-    } else if (td->track == TRACK_DST) {
-        Host *dst = HostGetHostFromHash(&p->dst);
-        if (dst) {
-            ret = ThresholdHandlePacketHost(dst,p,td,s->id,s->gid);
-            HostRelease(dst);
-        }
+    if (td->track == TRACK_SRC || td->track == TRACK_DST) {
+        if (threshold_hash == NULL)
+            SCReturnInt(0);
+
+        Address *a = (td->track == TRACK_SRC) ? &p->src : &p->dst;
+        ThresholdHashRow *hb = &threshold_hash[ThresholdGetKey(s->id, s->gid, td->track, a)];
+
+        SCMutexLock(&hb->lock);
+        ret = ThresholdHandlePacket(hb, a, p, td, s->id, s->gid);
+        SCMutexUnlock(&hb->lock);
     } else if (td->track == TRACK_RULE) {
         SCMutexLock(&de_ctx->ths_ctx.threshold_table_lock);
         ret = ThresholdHandlePacketRule(de_ctx,p,td,s);
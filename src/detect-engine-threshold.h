@@ -26,12 +26,20 @@
 #define __DETECT_ENGINE_THRESHOLD_H__
 
 #include "detect.h"
-#include "host.h"
+#include "detect-threshold.h"
 
-void ThresholdInit(void);
+/** counters of the threshold table */
+typedef struct ThresholdStats_ {
+    uint64_t entries;
+    uint64_t lookups;
+    uint64_t evictions;
+    uint64_t memuse;
+} ThresholdStats;
 
-int ThresholdHostStorageId(void);
-int ThresholdHostHasThreshold(Host *);
+void ThresholdInit(void);
+void ThresholdShutdown(void);
+void ThresholdGetStats(ThresholdStats *);
+int ThresholdGetEntry(uint32_t, uint32_t, int, Address *, DetectThresholdEntry *);
 
 DetectThresholdData *SigGetThresholdTypeIter(Signature *, Packet *, SigMatch **, int list);
 int PacketAlertThreshold(DetectEngineCtx *, DetectEngineThreadCtx *,
@@ -40,7 +48,7 @@ int PacketAlertThreshold(DetectEngineCtx *, DetectEngineThreadCtx *,
 void ThresholdHashInit(DetectEngineCtx *);
 void ThresholdContextDestroy(DetectEngineCtx *);
 
-int ThresholdTimeoutCheck(Host *, struct timeval *);
+uint32_t ThresholdTimeoutHash(struct timeval *);
 void ThresholdListFree(void *ptr);
 
 #endif /* __DETECT_ENGINE_THRESHOLD_H__ */
@@ -30,6 +30,7 @@
 #include "conf-yaml-loader.h"
 
 #include "app-layer-htp.h"
+#include "app-layer-ssl.h"
 
 #include "detect-parse.h"
 #include "detect-engine-sigorder.h"
@@ -38,6 +39,7 @@
 #include "detect-engine-address.h"
 #include "detect-engine-port.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-build.h"
 #include "detect-engine-hcbd.h"
 #include "detect-engine-iponly.h"
 #include "detect-engine-tag.h"
@@ -59,6 +61,7 @@
 #include "detect-engine-dns.h"
 
 #include "detect-engine.h"
+#include "detect-engine-rulestats.h"
 #include "detect-engine-state.h"
 
 #include "detect-byte-extract.h"
@@ -238,6 +241,13 @@ void DetectEngineRegisterAppInspectionEngines(void)
           DE_STATE_FLAG_DNSQUERY_INSPECT,
           0,
           DetectEngineInspectDnsQueryName },
+        /* SMTP */
+        { ALPROTO_SMTP,
+          DETECT_SM_LIST_FILEMATCH,
+          DE_STATE_FLAG_FILE_TS_INSPECT,
+          DE_STATE_FLAG_FILE_TS_INSPECT,
+          0,
+          DetectFileInspectSmtp },
     };
 
     struct tmp_t data_toclient[] = {
@@ -390,6 +400,251 @@ void DetectEngineRegisterAppInspectionEngine(uint16_t alproto,
     return;
 }
 
+/**
+ *  \brief Set up a new detection engine to be an incremental reload of
+ *         the current one. Must be called before loading the signatures.
+ *
+ *  The variable name idx's of the current engine are copied, so flowbits
+ *  and flowvars of existing flows stay valid. During the build fast
+ *  pattern ids are reused and mpm ctxs with the same patterns are shared
+ *  with the current engine instead of being built again.
+ *
+ *  \param de_ctx new, empty detection engine
+ *  \param src the engine that is currently in use
+ *
+ *  \retval 0 ok
+ *  \retval -1 error, de_ctx will be built from scratch
+ */
+int DetectEngineReloadStart(DetectEngineCtx *de_ctx, DetectEngineCtx *src)
+{
+    if (src == NULL || de_ctx->sig_list != NULL)
+        return -1;
+
+    if (VariableNameCopyHash(de_ctx, src) != 0) {
+        /* start over with a clean name hash */
+        VariableNameFreeHash(de_ctx);
+        VariableNameInitHash(de_ctx);
+        return -1;
+    }
+
+    de_ctx->reload_src = src;
+    de_ctx->reload_src_id = src->id;
+    return 0;
+}
+
+/** old sigmatch and the same sigmatch in the reloaded engine */
+typedef struct DetectEngineReloadSmPair_ {
+    SigMatch *old;
+    SigMatch *new;
+} DetectEngineReloadSmPair;
+
+static uint32_t DetectEngineReloadSmHash(HashTable *ht, void *data, uint16_t len)
+{
+    DetectEngineReloadSmPair *pair = (DetectEngineReloadSmPair *)data;
+    return (uint32_t)(((uintptr_t)pair->old >> 4) % ht->array_size);
+}
+
+static char DetectEngineReloadSmCompare(void *data1, uint16_t len1,
+        void *data2, uint16_t len2)
+{
+    return ((DetectEngineReloadSmPair *)data1)->old ==
+        ((DetectEngineReloadSmPair *)data2)->old;
+}
+
+static uint32_t DetectEngineReloadSigHash(HashTable *ht, void *data, uint16_t len)
+{
+    Signature *s = (Signature *)data;
+    return (uint32_t)((s->sig_hash ^ s->id) % ht->array_size);
+}
+
+/** \internal \brief sigs with the same rule text, sid, gid and rev */
+static char DetectEngineReloadSigCompare(void *data1, uint16_t len1,
+        void *data2, uint16_t len2)
+{
+    Signature *s1 = (Signature *)data1;
+    Signature *s2 = (Signature *)data2;
+
+    return (s1->sig_hash == s2->sig_hash && s1->id == s2->id &&
+            s1->gid == s2->gid && s1->rev == s2->rev);
+}
+
+static void DetectEngineReloadSmFree(void *data)
+{
+    SCFree(data);
+}
+
+static void DetectEngineReloadFreeMaps(DetectEngineCtx *de_ctx)
+{
+    if (de_ctx->reload_sig_map != NULL)
+        SCFree(de_ctx->reload_sig_map);
+    de_ctx->reload_sig_map = NULL;
+    de_ctx->reload_sig_map_len = 0;
+
+    if (de_ctx->reload_sm_map != NULL)
+        HashTableFree(de_ctx->reload_sm_map);
+    de_ctx->reload_sm_map = NULL;
+}
+
+/**
+ *  \internal
+ *  \brief Map the sigs of the engine we reload from to the same, unchanged
+ *         sigs of the new engine, and their app layer sigmatches as well.
+ *
+ *  \retval cnt number of unchanged sigs
+ *  \retval -1 error
+ */
+static int DetectEngineReloadBuildMaps(DetectEngineCtx *de_ctx,
+        DetectEngineCtx *src)
+{
+    HashTable *sig_ht = NULL;
+    Signature *s;
+    int cnt = 0;
+
+    if (src->sig_array == NULL || src->sig_array_len == 0)
+        return 0;
+
+    de_ctx->reload_sig_map = SCMalloc(src->sig_array_len * sizeof(SigIntId));
+    if (de_ctx->reload_sig_map == NULL)
+        goto error;
+    memset(de_ctx->reload_sig_map, 0x00, src->sig_array_len * sizeof(SigIntId));
+    de_ctx->reload_sig_map_len = src->sig_array_len;
+
+    de_ctx->reload_sm_map = HashTableInit(4096, DetectEngineReloadSmHash,
+            DetectEngineReloadSmCompare, DetectEngineReloadSmFree);
+    if (de_ctx->reload_sm_map == NULL)
+        goto error;
+
+    sig_ht = HashTableInit(4096, DetectEngineReloadSigHash,
+            DetectEngineReloadSigCompare, NULL);
+    if (sig_ht == NULL)
+        goto error;
+    for (s = src->sig_list; s != NULL; s = s->next) {
+        if (HashTableAdd(sig_ht, s, sizeof(Signature)) != 0)
+            goto error;
+    }
+
+    for (s = de_ctx->sig_list; s != NULL; s = s->next) {
+        Signature *o = HashTableLookup(sig_ht, s, sizeof(Signature));
+        if (o == NULL || o->num >= src->sig_array_len ||
+            o->flags != s->flags || o->alproto != s->alproto)
+            continue;
+
+        /* the stored state points into the app layer match list */
+        SigMatch *osm = o->sm_lists[DETECT_SM_LIST_AMATCH];
+        SigMatch *nsm = s->sm_lists[DETECT_SM_LIST_AMATCH];
+        for ( ; osm != NULL && nsm != NULL; osm = osm->next, nsm = nsm->next) {
+            if (osm->type != nsm->type)
+                break;
+        }
+        if (osm != NULL || nsm != NULL)
+            continue;
+
+        osm = o->sm_lists[DETECT_SM_LIST_AMATCH];
+        nsm = s->sm_lists[DETECT_SM_LIST_AMATCH];
+        for ( ; osm != NULL; osm = osm->next, nsm = nsm->next) {
+            DetectEngineReloadSmPair *pair = SCMalloc(sizeof(*pair));
+            if (pair == NULL)
+                goto error;
+            pair->old = osm;
+            pair->new = nsm;
+            if (HashTableAdd(de_ctx->reload_sm_map, pair, sizeof(*pair)) != 0) {
+                SCFree(pair);
+                goto error;
+            }
+        }
+
+        de_ctx->reload_sig_map[o->num] = s->num + 1;
+        cnt++;
+    }
+
+    HashTableFree(sig_ht);
+    return cnt;
+
+error:
+    if (sig_ht != NULL)
+        HashTableFree(sig_ht);
+    DetectEngineReloadFreeMaps(de_ctx);
+    return -1;
+}
+
+/**
+ *  \brief Get the sig num in a reloaded engine of a sig of the engine it
+ *         was reloaded from.
+ *
+ *  \retval 1 sig is unchanged, num is set
+ *  \retval 0 sig changed or was removed
+ */
+int DetectEngineReloadMapSig(DetectEngineCtx *de_ctx, SigIntId old, SigIntId *num)
+{
+    if (de_ctx->reload_sig_map == NULL || old >= de_ctx->reload_sig_map_len ||
+        de_ctx->reload_sig_map[old] == 0)
+        return 0;
+
+    *num = de_ctx->reload_sig_map[old] - 1;
+    return 1;
+}
+
+/**
+ *  \brief Get the app layer sigmatch in a reloaded engine of a sigmatch
+ *         of an unchanged sig of the engine it was reloaded from. NULL
+ *         maps to NULL.
+ *
+ *  \retval 1 found, sm is set
+ *  \retval 0 not found
+ */
+int DetectEngineReloadMapSigMatch(DetectEngineCtx *de_ctx, SigMatch *old,
+        SigMatch **sm)
+{
+    DetectEngineReloadSmPair key, *pair;
+
+    if (old == NULL) {
+        *sm = NULL;
+        return 1;
+    }
+    if (de_ctx->reload_sm_map == NULL)
+        return 0;
+
+    key.old = old;
+    key.new = NULL;
+    pair = HashTableLookup(de_ctx->reload_sm_map, &key, sizeof(key));
+    if (pair == NULL)
+        return 0;
+
+    *sm = pair->new;
+    return 1;
+}
+
+/**
+ *  \brief Finish an incremental reload after the new engine is built.
+ *
+ *  Existing flows keep their flowbits and flowvars. Their detection state
+ *  refers to the sig nums and sigmatch lists of the old engine, which are
+ *  freed with it, so the unchanged sigs are mapped to the new engine here
+ *  while both are alive. Flows whose state only refers to unchanged sigs
+ *  keep it, see DeStateReloadRemap().
+ */
+void DetectEngineReloadDone(DetectEngineCtx *de_ctx)
+{
+    DetectEngineCtx *src = de_ctx->reload_src;
+
+    if (src != NULL) {
+        int cnt = DetectEngineReloadBuildMaps(de_ctx, src);
+        if (!(de_ctx->flags & DE_QUIET)) {
+            if (cnt < 0) {
+                SCLogInfo("rule reload: can't map the signatures, detection "
+                        "state of existing flows will be reset");
+            } else {
+                SCLogInfo("rule reload: %d of %u signatures unchanged, "
+                        "existing flows keep their detection state for them",
+                        cnt, de_ctx->sig_cnt);
+            }
+        }
+    }
+
+    /* the source engine will be freed soon */
+    de_ctx->reload_src = NULL;
+}
+
 static void *DetectEngineLiveRuleSwap(void *arg)
 {
     SCEnter();
@@ -488,6 +743,13 @@ static void *DetectEngineLiveRuleSwap(void *arg)
         goto error;
     }
 
+    /* only this thread frees the current engine, so it stays valid
+     * while we build the new one from it */
+    if (DetectEngineReloadStart(de_ctx, DetectEngineGetGlobalDeCtx()) != 0) {
+        SCLogInfo("rule reload: can't reuse the current detection engine, "
+                  "doing a full reload");
+    }
+
     SCClassConfLoadClassficationConfigFile(de_ctx);
     SCRConfLoadReferenceConfigFile(de_ctx);
 
@@ -508,6 +770,8 @@ static void *DetectEngineLiveRuleSwap(void *arg)
         pthread_exit(NULL);
     }
 
+    DetectEngineReloadDone(de_ctx);
+
     SCThresholdConfInitContext(de_ctx, NULL);
 
     /* start the process of swapping detect threads ctxs */
@@ -837,6 +1101,11 @@ void DetectEngineCtxFree(DetectEngineCtx *de_ctx) {
         de_ctx->profile_ctx = NULL;
     }
 #endif
+    DetectRuleStatsDestroyCtx(de_ctx);
+
+    if (de_ctx->flags & DE_TLS_NO_BYPASS) {
+        SSLNoBypassDeregister();
+    }
 
     /* Normally the hashes are freed elsewhere, but
      * to be sure look at them again here.
@@ -856,6 +1125,10 @@ void DetectEngineCtxFree(DetectEngineCtx *de_ctx) {
     SigCleanSignatures(de_ctx);
 
     VariableNameFreeHash(de_ctx);
+    DetectEngineBuildFreeMpmQueue(de_ctx);
+    DetectEngineReloadFreeMaps(de_ctx);
+    if (de_ctx->fp_ids != NULL)
+        SCFree(de_ctx->fp_ids);
     if (de_ctx->sig_array)
         SCFree(de_ctx->sig_array);
 
@@ -895,6 +1168,7 @@ static uint8_t DetectEngineCtxLoadConf(DetectEngineCtx *de_ctx) {
     const char *max_uniq_toserver_dp_groups_str = NULL;
 
     char *sgh_mpm_context = NULL;
+    char *build_threads = NULL;
 
     ConfNode *de_ctx_custom = ConfGetNode("detect-engine");
     ConfNode *opt = NULL;
@@ -905,6 +1179,8 @@ static uint8_t DetectEngineCtxLoadConf(DetectEngineCtx *de_ctx) {
                 de_ctx_profile = opt->head.tqh_first->val;
             } else if (strcmp(opt->val, "sgh-mpm-context") == 0) {
                 sgh_mpm_context = opt->head.tqh_first->val;
+            } else if (strcmp(opt->val, "build-threads") == 0) {
+                build_threads = opt->head.tqh_first->val;
             }
         }
     }
@@ -966,6 +1242,21 @@ static uint8_t DetectEngineCtxLoadConf(DetectEngineCtx *de_ctx) {
         de_ctx->sgh_mpm_context = ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL;
     }
 
+    /* detect-engine.build-threads option parsing, 0 means auto */
+    if (build_threads == NULL || strcmp(build_threads, "auto") == 0) {
+        de_ctx->build_threads = 0;
+    } else if (ByteExtractStringUint16(&de_ctx->build_threads, 10,
+                strlen(build_threads), (const char *)build_threads) <= 0) {
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "You have supplied an "
+                "invalid conf value for detect-engine.build-threads: "
+                "%s", build_threads);
+        exit(EXIT_FAILURE);
+    }
+
+    if (run_mode == RUNMODE_UNITTEST) {
+        de_ctx->build_threads = 1;
+    }
+
     opt = NULL;
     switch (profile) {
         case ENGINE_PROFILE_LOW:
@@ -1205,6 +1496,7 @@ static TmEcode ThreadCtxDoInit (DetectEngineCtx *de_ctx, DetectEngineThreadCtx *
 #ifdef PROFILING
     SCProfilingRuleThreadSetup(de_ctx->profile_ctx, det_ctx);
 #endif
+    DetectRuleStatsThreadSetup(de_ctx, det_ctx);
     SC_ATOMIC_INIT(det_ctx->so_far_used_by_detect);
 
     return TM_ECODE_OK;
@@ -1285,6 +1577,7 @@ TmEcode DetectEngineThreadCtxDeinit(ThreadVars *tv, void *data) {
 #ifdef PROFILING
     SCProfilingRuleThreadCleanup(det_ctx);
 #endif
+    DetectRuleStatsThreadCleanup(det_ctx);
 
     DetectEngineIPOnlyThreadDeinit(&det_ctx->io_ctx);
 
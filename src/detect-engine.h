@@ -57,6 +57,10 @@ void DetectEngineSpawnLiveRuleSwapMgmtThread(void);
 DetectEngineCtx *DetectEngineCtxInit(void);
 DetectEngineCtx *DetectEngineGetGlobalDeCtx(void);
 void DetectEngineCtxFree(DetectEngineCtx *);
+int DetectEngineReloadStart(DetectEngineCtx *, DetectEngineCtx *);
+void DetectEngineReloadDone(DetectEngineCtx *);
+int DetectEngineReloadMapSig(DetectEngineCtx *, SigIntId, SigIntId *);
+int DetectEngineReloadMapSigMatch(DetectEngineCtx *, SigMatch *, SigMatch **);
 
 TmEcode DetectEngineThreadCtxInit(ThreadVars *, void *, void **);
 TmEcode DetectEngineThreadCtxDeinit(ThreadVars *, void *);
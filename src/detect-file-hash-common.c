@@ -0,0 +1,264 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Common code for the filemd5, filesha1 and filesha256 keywords.
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "debug.h"
+#include "decode.h"
+
+#include "detect.h"
+#include "detect-parse.h"
+
+#include "detect-engine.h"
+#include "detect-engine-state.h"
+
+#include "flow.h"
+
+#include "util-debug.h"
+#include "util-file-hashlist.h"
+
+#include "app-layer.h"
+#include "app-layer-htp.h"
+
+#include "detect-file-hash-common.h"
+
+#ifdef HAVE_NSS
+
+/** \internal
+ *  \brief get the hash the keyword inspects from the file
+ *
+ *  \retval ptr hash or NULL if the file doesn't have it (yet)
+ */
+static const uint8_t *DetectFileHashGetHash(File *file, uint8_t type)
+{
+    switch (type) {
+        case DETECT_FILEMD5:
+            if (file->flags & FILE_MD5)
+                return file->md5;
+            break;
+        case DETECT_FILESHA1:
+            if (file->flags & FILE_SHA1)
+                return file->sha1;
+            break;
+        case DETECT_FILESHA256:
+            if (file->flags & FILE_SHA256)
+                return file->sha256;
+            break;
+    }
+    return NULL;
+}
+
+/**
+ * \brief match the file hash against the keyword's hash list
+ *
+ * \param t thread local vars
+ * \param det_ctx pattern matcher thread local data
+ * \param f *LOCKED* flow
+ * \param flags direction flags
+ * \param file file being inspected
+ * \param s signature being inspected
+ * \param m sigmatch that we will cast into DetectFileHashData
+ *
+ * \retval 0 no match
+ * \retval 1 match
+ */
+int DetectFileHashMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx,
+        Flow *f, uint8_t flags, File *file, Signature *s, SigMatch *m)
+{
+    SCEnter();
+    int ret = 0;
+    DetectFileHashData *filehash = (DetectFileHashData *)m->ctx;
+
+    if (file->txid < det_ctx->tx_id) {
+        SCReturnInt(0);
+    }
+
+    if (file->txid > det_ctx->tx_id) {
+        SCReturnInt(0);
+    }
+
+    if (file->state != FILE_STATE_CLOSED) {
+        SCReturnInt(0);
+    }
+
+    const uint8_t *hash = DetectFileHashGetHash(file, m->type);
+    if (hash != NULL) {
+        if (FileHashListLookup(filehash->hash, hash) == 1) {
+            if (filehash->negated == 0)
+                ret = 1;
+            else
+                ret = 0;
+        } else {
+            if (filehash->negated == 0)
+                ret = 0;
+            else
+                ret = 1;
+        }
+    }
+
+    SCReturnInt(ret);
+}
+
+/**
+ * \brief Parse the file hash keyword
+ *
+ * \param str Pointer to the user provided option
+ * \param hash_len length of the hashes in the list
+ * \param name keyword name for logging
+ *
+ * \retval filehash pointer to DetectFileHashData on success
+ * \retval NULL on failure
+ */
+static DetectFileHashData *DetectFileHashParse (char *str, uint16_t hash_len,
+        const char *name)
+{
+    DetectFileHashData *filehash = NULL;
+    char *filename = NULL;
+
+    filehash = SCMalloc(sizeof(DetectFileHashData));
+    if (unlikely(filehash == NULL))
+        goto error;
+
+    memset(filehash, 0x00, sizeof(DetectFileHashData));
+
+    if (strlen(str) && str[0] == '!') {
+        filehash->negated = 1;
+        str++;
+    }
+
+    /* get full filename */
+    filename = DetectLoadCompleteSigPath(str);
+    if (filename == NULL) {
+        goto error;
+    }
+
+    filehash->hash = FileHashListLoad(filename, hash_len);
+    if (filehash->hash == NULL) {
+        goto error;
+    }
+    SCLogInfo("%s: %u hashes, %"PRIu64" bytes of memory%s%s", name,
+            filehash->hash->count, FileHashListMemorySize(filehash->hash),
+            filehash->hash->map ? ", mapped" : "",
+            filehash->negated ? ", negated match" : "");
+
+    SCFree(filename);
+    return filehash;
+
+error:
+    if (filehash != NULL)
+        DetectFileHashFree(filehash);
+    if (filename != NULL)
+        SCFree(filename);
+    return NULL;
+}
+
+/**
+ * \brief this function is used to parse file hash options
+ * \brief into the current signature
+ *
+ * \param de_ctx pointer to the Detection Engine Context
+ * \param s pointer to the Current Signature
+ * \param str pointer to the user provided option
+ * \param type DETECT_FILEMD5, DETECT_FILESHA1 or DETECT_FILESHA256
+ *
+ * \retval 0 on Success
+ * \retval -1 on Failure
+ */
+int DetectFileHashSetup (DetectEngineCtx *de_ctx, Signature *s, char *str,
+        uint8_t type)
+{
+    DetectFileHashData *filehash = NULL;
+    SigMatch *sm = NULL;
+    uint16_t hash_len;
+    uint16_t need;
+
+    switch (type) {
+        case DETECT_FILEMD5:
+            hash_len = MD5_LENGTH;
+            need = FILE_SIG_NEED_MD5;
+            break;
+        case DETECT_FILESHA1:
+            hash_len = SHA1_LENGTH;
+            need = FILE_SIG_NEED_SHA1;
+            break;
+        case DETECT_FILESHA256:
+            hash_len = SHA256_LENGTH;
+            need = FILE_SIG_NEED_SHA256;
+            break;
+        default:
+            goto error;
+    }
+
+    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_HTTP &&
+        s->alproto != ALPROTO_SMTP) {
+        SCLogError(SC_ERR_CONFLICTING_RULE_KEYWORDS, "rule contains conflicting keywords.");
+        goto error;
+    }
+
+    filehash = DetectFileHashParse(str, hash_len, sigmatch_table[type].name);
+    if (filehash == NULL)
+        goto error;
+
+    /* Okay so far so good, lets get this into a SigMatch
+     * and put it in the Signature. */
+    sm = SigMatchAlloc();
+    if (sm == NULL)
+        goto error;
+
+    sm->type = type;
+    sm->ctx = (void *)filehash;
+
+    SigMatchAppendSMToList(s, sm, DETECT_SM_LIST_FILEMATCH);
+
+    AppLayerHtpNeedFileInspection();
+
+    /* files are extracted from http and smtp, default to http */
+    if (s->alproto == ALPROTO_UNKNOWN)
+        s->alproto = ALPROTO_HTTP;
+
+    s->file_flags |= (FILE_SIG_NEED_FILE|need);
+    return 0;
+
+error:
+    if (filehash != NULL)
+        DetectFileHashFree(filehash);
+    if (sm != NULL)
+        SCFree(sm);
+    return -1;
+}
+
+/**
+ * \brief this function will free memory associated with DetectFileHashData
+ *
+ * \param ptr pointer to DetectFileHashData
+ */
+void DetectFileHashFree(void *ptr) {
+    if (ptr != NULL) {
+        DetectFileHashData *filehash = (DetectFileHashData *)ptr;
+        if (filehash->hash != NULL)
+            FileHashListFree(filehash->hash);
+        SCFree(filehash);
+    }
+}
+
+#endif /* HAVE_NSS */
@@ -0,0 +1,36 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __DETECT_FILE_HASH_COMMON_H__
+#define __DETECT_FILE_HASH_COMMON_H__
+
+#include "util-file-hashlist.h"
+
+typedef struct DetectFileHashData_ {
+    FileHashList *hash;
+    int negated;
+} DetectFileHashData;
+
+/* prototypes */
+#ifdef HAVE_NSS
+int DetectFileHashMatch(ThreadVars *, DetectEngineThreadCtx *,
+        Flow *, uint8_t, File *, Signature *, SigMatch *);
+int DetectFileHashSetup(DetectEngineCtx *, Signature *, char *, uint8_t);
+void DetectFileHashFree(void *);
+#endif
+
+#endif /* __DETECT_FILE_HASH_COMMON_H__ */
@@ -132,19 +132,21 @@ int FilemagicGlobalLookup(File *file) {
 /**
  *  \brief run the magic check
  *
+ *  \param ctx thread's libmagic ctx
  *  \param file the file
+ *  \param counters thread's magic lookup counters
  *
  *  \retval -1 error
  *  \retval 0 ok
  */
-int FilemagicThreadLookup(magic_t *ctx, File *file) {
+int FilemagicThreadLookup(magic_t *ctx, File *file, MagicCounters *counters) {
     if (ctx == NULL || file == NULL || file->chunks_head == NULL) {
         SCReturnInt(-1);
     }
 
     /* initial chunk already matching our requirement */
     if (file->chunks_head->len >= FILEMAGIC_MIN_SIZE) {
-        file->magic = MagicThreadLookup(ctx, file->chunks_head->data, FILEMAGIC_MIN_SIZE);
+        file->magic = MagicThreadLookup(ctx, file->chunks_head->data, FILEMAGIC_MIN_SIZE, counters);
     } else {
         uint8_t *buf = SCMalloc(FILEMAGIC_MIN_SIZE);
         uint32_t size = 0;
@@ -161,12 +163,12 @@ int FilemagicThreadLookup(magic_t *ctx, File *file) {
                 size += copy_len;
 
                 if (size >= FILEMAGIC_MIN_SIZE) {
-                    file->magic = MagicThreadLookup(ctx, buf, size);
+                    file->magic = MagicThreadLookup(ctx, buf, size, counters);
                     break;
                 }
                 /* file is done but smaller than FILEMAGIC_MIN_SIZE */
                 if (ffd->next == NULL && file->state >= FILE_STATE_CLOSED) {
-                    file->magic = MagicThreadLookup(ctx, buf, size);
+                    file->magic = MagicThreadLookup(ctx, buf, size, counters);
                     break;
                 }
             }
@@ -211,7 +213,7 @@ static int DetectFilemagicMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx,
     }
 
     if (file->magic == NULL) {
-        FilemagicThreadLookup(&tfilemagic->ctx, file);
+        FilemagicThreadLookup(&tfilemagic->ctx, file, &tfilemagic->counters);
     }
 
     if (file->magic != NULL) {
@@ -346,6 +348,7 @@ error:
 static void DetectFilemagicThreadFree(void *ctx) {
     if (ctx != NULL) {
         DetectFilemagicThreadData *t = (DetectFilemagicThreadData *)ctx;
+        MagicCountersMerge(&t->counters);
         if (t->ctx)
             magic_close(t->ctx);
         SCFree(t);
@@ -389,15 +392,17 @@ static int DetectFilemagicSetup (DetectEngineCtx *de_ctx, Signature *s, char *st
 
     SigMatchAppendSMToList(s, sm, DETECT_SM_LIST_FILEMATCH);
 
-    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_HTTP) {
+    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_HTTP &&
+        s->alproto != ALPROTO_SMTP) {
         SCLogError(SC_ERR_CONFLICTING_RULE_KEYWORDS, "rule contains conflicting keywords.");
         goto error;
     }
 
     AppLayerHtpNeedFileInspection();
 
-    /** \todo remove this once we support more than http */
-    s->alproto = ALPROTO_HTTP;
+    /* files are extracted from http and smtp, default to http */
+    if (s->alproto == ALPROTO_UNKNOWN)
+        s->alproto = ALPROTO_HTTP;
 
     s->file_flags |= (FILE_SIG_NEED_FILE|FILE_SIG_NEED_MAGIC);
     return 0;
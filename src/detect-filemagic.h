@@ -26,9 +26,11 @@
 
 #include "util-spm-bm.h"
 #include <magic.h>
+#include "util-magic.h"
 
 typedef struct DetectFilemagicThreadData {
     magic_t ctx;
+    MagicCounters counters;
 } DetectFilemagicThreadData;
 
 typedef struct DetectFilemagicData {
@@ -0,0 +1,171 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "debug.h"
+#include "decode.h"
+
+#include "detect.h"
+#include "detect-parse.h"
+
+#include "detect-engine.h"
+
+#include "flow.h"
+
+#include "util-debug.h"
+
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+#include "app-layer.h"
+
+#include "detect-file-hash-common.h"
+#include "detect-filesha256.h"
+
+#ifndef HAVE_NSS
+
+static int DetectFileSha256SetupNoSupport (DetectEngineCtx *a, Signature *b, char *c) {
+    SCLogError(SC_ERR_NO_SHA256_SUPPORT, "no SHA256 calculation support built in, needed for filesha256 keyword");
+    return -1;
+}
+
+/**
+ * \brief Registration function for keyword: filesha256
+ */
+void DetectFileSha256Register(void) {
+    sigmatch_table[DETECT_FILESHA256].name = "filesha256";
+    sigmatch_table[DETECT_FILESHA256].FileMatch = NULL;
+    sigmatch_table[DETECT_FILESHA256].alproto = ALPROTO_HTTP;
+    sigmatch_table[DETECT_FILESHA256].Setup = DetectFileSha256SetupNoSupport;
+    sigmatch_table[DETECT_FILESHA256].Free  = NULL;
+    sigmatch_table[DETECT_FILESHA256].RegisterTests = NULL;
+    sigmatch_table[DETECT_FILESHA256].flags = SIGMATCH_NOT_BUILT;
+
+	SCLogDebug("registering filesha256 rule option");
+    return;
+}
+
+#else /* HAVE_NSS */
+
+static int DetectFileSha256Setup (DetectEngineCtx *, Signature *, char *);
+static void DetectFileSha256RegisterTests(void);
+
+/**
+ * \brief Registration function for keyword: filesha256
+ */
+void DetectFileSha256Register(void) {
+    sigmatch_table[DETECT_FILESHA256].name = "filesha256";
+    sigmatch_table[DETECT_FILESHA256].desc = "match file SHA256 against list of SHA256 checksums";
+    sigmatch_table[DETECT_FILESHA256].url = "https://redmine.openinfosecfoundation.org/projects/suricata/wiki/File-keywords#filesha256";
+    sigmatch_table[DETECT_FILESHA256].FileMatch = DetectFileHashMatch;
+    sigmatch_table[DETECT_FILESHA256].alproto = ALPROTO_HTTP;
+    sigmatch_table[DETECT_FILESHA256].Setup = DetectFileSha256Setup;
+    sigmatch_table[DETECT_FILESHA256].Free  = DetectFileHashFree;
+    sigmatch_table[DETECT_FILESHA256].RegisterTests = DetectFileSha256RegisterTests;
+
+	SCLogDebug("registering filesha256 rule option");
+    return;
+}
+
+/**
+ * \brief this function is used to parse filesha256 options
+ * \brief into the current signature
+ *
+ * \param de_ctx pointer to the Detection Engine Context
+ * \param s pointer to the Current Signature
+ * \param str pointer to the user provided "filesha256" option
+ *
+ * \retval 0 on Success
+ * \retval -1 on Failure
+ */
+static int DetectFileSha256Setup (DetectEngineCtx *de_ctx, Signature *s, char *str)
+{
+    return DetectFileHashSetup(de_ctx, s, str, DETECT_FILESHA256);
+}
+
+#ifdef UNITTESTS
+/** \test load a sha256 list through the keyword */
+static int DetectFileSha256Test01(void) {
+    int result = 0;
+    char filename[] = "/tmp/suricata-filesha256-XXXXXX";
+    char sig[128];
+    DetectEngineCtx *de_ctx = NULL;
+
+    int fd = mkstemp(filename);
+    if (fd < 0)
+        return 0;
+    FILE *fp = fdopen(fd, "w");
+    if (fp == NULL) {
+        close(fd);
+        goto end;
+    }
+    fprintf(fp, "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\n");
+    fclose(fp);
+
+    de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL)
+        goto end;
+
+    snprintf(sig, sizeof(sig), "alert http any any -> any any "
+            "(filesha256:%s; sid:1;)", filename);
+    de_ctx->sig_list = SigInit(de_ctx, sig);
+    if (de_ctx->sig_list == NULL) {
+        printf("sig parse failed: ");
+        goto end;
+    }
+    Signature *s = de_ctx->sig_list;
+    if (!(s->file_flags & FILE_SIG_NEED_SHA256) ||
+        s->sm_lists[DETECT_SM_LIST_FILEMATCH] == NULL ||
+        s->sm_lists[DETECT_SM_LIST_FILEMATCH]->type != DETECT_FILESHA256) {
+        printf("filesha256 not set up: ");
+        goto end;
+    }
+    DetectFileHashData *filehash = s->sm_lists[DETECT_SM_LIST_FILEMATCH]->ctx;
+    if (filehash->negated || filehash->hash->count != 1) {
+        printf("unexpected list: ");
+        goto end;
+    }
+
+    /* a sha256 list is not a md5 list */
+    snprintf(sig, sizeof(sig), "alert http any any -> any any "
+            "(filemd5:%s; sid:2;)", filename);
+    if (SigInit(de_ctx, sig) != NULL) {
+        printf("sha256 list accepted for filemd5: ");
+        goto end;
+    }
+    result = 1;
+end:
+    if (de_ctx != NULL)
+        DetectEngineCtxFree(de_ctx);
+    unlink(filename);
+    return result;
+}
+#endif
+
+void DetectFileSha256RegisterTests(void) {
+#ifdef UNITTESTS
+    UtRegisterTest("DetectFileSha256Test01", DetectFileSha256Test01, 1);
+#endif
+}
+
+#endif /* HAVE_NSS */
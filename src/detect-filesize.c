@@ -310,15 +310,17 @@ static int DetectFilesizeSetup (DetectEngineCtx *de_ctx, Signature *s, char *str
 
     SigMatchAppendSMToList(s, sm, DETECT_SM_LIST_FILEMATCH);
 
-    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_HTTP) {
+    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_HTTP &&
+        s->alproto != ALPROTO_SMTP) {
         SCLogError(SC_ERR_CONFLICTING_RULE_KEYWORDS, "rule contains conflicting keywords.");
         goto error;
     }
 
     AppLayerHtpNeedFileInspection();
 
-    /** \todo remove this once we support more than http */
-    s->alproto = ALPROTO_HTTP;
+    /* files are extracted from http and smtp, default to http */
+    if (s->alproto == ALPROTO_UNKNOWN)
+        s->alproto = ALPROTO_HTTP;
 
     s->file_flags |= (FILE_SIG_NEED_FILE|FILE_SIG_NEED_SIZE);
     SCReturnInt(0);
@@ -45,6 +45,7 @@
 #include "util-unittest-helper.h"
 
 #include "app-layer.h"
+#include "app-layer-smtp.h"
 
 #include "stream-tcp.h"
 
@@ -166,6 +167,10 @@ static int FilestorePostMatchWithOptions(Packet *p, Flow *f, DetectFilestoreData
                 FileStoreAllFilesForTx(htp_state->files_tc, tx_id);
             }
             htp_state->store_tx_id = tx_id;
+        } else if (f->alproto == ALPROTO_SMTP && f->alstate != NULL) {
+            SMTPState *smtp_state = f->alstate;
+            if (toserver_dir)
+                FileStoreAllFilesForTx(smtp_state->files_ts, tx_id);
         }
     } else if (this_flow) {
         /* flag flow all files will be stored */
@@ -179,6 +184,10 @@ static int FilestorePostMatchWithOptions(Packet *p, Flow *f, DetectFilestoreData
                 htp_state->flags |= HTP_FLAG_STORE_FILES_TC;
                 FileStoreAllFiles(htp_state->files_tc);
             }
+        } else if (f->alproto == ALPROTO_SMTP && f->alstate != NULL) {
+            SMTPState *smtp_state = f->alstate;
+            if (toserver_dir)
+                FileStoreAllFiles(smtp_state->files_ts);
         }
     } else {
         FileStoreFileById(fc, file_id);
@@ -409,14 +418,17 @@ static int DetectFilestoreSetup (DetectEngineCtx *de_ctx, Signature *s, char *st
     SigMatchAppendSMToList(s, sm, DETECT_SM_LIST_FILEMATCH);
     s->filestore_sm = sm;
 
-    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_HTTP) {
+    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_HTTP &&
+        s->alproto != ALPROTO_SMTP) {
         SCLogError(SC_ERR_CONFLICTING_RULE_KEYWORDS, "rule contains conflicting keywords.");
         goto error;
     }
 
     AppLayerHtpNeedFileInspection();
 
-    s->alproto = ALPROTO_HTTP;
+    /* files are extracted from http and smtp, default to http */
+    if (s->alproto == ALPROTO_UNKNOWN)
+        s->alproto = ALPROTO_HTTP;
 
     s->flags |= SIG_FLAG_FILESTORE;
     return 0;
@@ -751,7 +751,7 @@ static int FlowBitsTestSig06(void) {
     DetectEngineThreadCtx *det_ctx = NULL;
     DetectEngineCtx *de_ctx = NULL;
     Flow f;
-    GenericVar flowvar, *gv = NULL;
+    GenericVar flowvar;
     int result = 0;
     int idx = 0;
 
@@ -794,13 +794,8 @@ static int FlowBitsTestSig06(void) {
 
     idx = VariableNameGetIdx(de_ctx, "myflow", DETECT_FLOWBITS);
 
-    gv = p->flow->flowvar;
-
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-                result = 1;
-        }
-    }
+    if (FlowBitIsset(p->flow, idx) == 1)
+        result = 1;
 
     SigGroupCleanup(de_ctx);
     SigCleanSignatures(de_ctx);
@@ -808,7 +803,6 @@ static int FlowBitsTestSig06(void) {
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    if(gv) GenericVarFree(gv);
     FLOW_DESTROY(&f);
 
     SCFree(p);
@@ -828,7 +822,6 @@ end:
         DetectEngineCtxFree(de_ctx);
     }
 
-    if(gv) GenericVarFree(gv);
     FLOW_DESTROY(&f);
     SCFree(p);
     return result;
@@ -855,7 +848,7 @@ static int FlowBitsTestSig07(void) {
     DetectEngineThreadCtx *det_ctx = NULL;
     DetectEngineCtx *de_ctx = NULL;
     Flow f;
-    GenericVar flowvar, *gv = NULL;
+    GenericVar flowvar;
     int result = 0;
     int idx = 0;
 
@@ -900,13 +893,8 @@ static int FlowBitsTestSig07(void) {
 
     idx = VariableNameGetIdx(de_ctx, "myflow", DETECT_FLOWBITS);
 
-    gv = p->flow->flowvar;
-
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-                result = 1;
-        }
-    }
+    if (FlowBitIsset(p->flow, idx) == 1)
+        result = 1;
 
     SigGroupCleanup(de_ctx);
     SigCleanSignatures(de_ctx);
@@ -914,7 +902,6 @@ static int FlowBitsTestSig07(void) {
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    if(gv) GenericVarFree(gv);
     FLOW_DESTROY(&f);
 
     SCFree(p);
@@ -934,7 +921,6 @@ end:
         DetectEngineCtxFree(de_ctx);
     }
 
-    if(gv) GenericVarFree(gv);
     FLOW_DESTROY(&f);
 
     SCFree(p);
@@ -962,7 +948,7 @@ static int FlowBitsTestSig08(void) {
     DetectEngineThreadCtx *det_ctx = NULL;
     DetectEngineCtx *de_ctx = NULL;
     Flow f;
-    GenericVar flowvar, *gv = NULL;
+    GenericVar flowvar;
     int result = 0;
     int idx = 0;
 
@@ -1009,13 +995,8 @@ static int FlowBitsTestSig08(void) {
 
     idx = VariableNameGetIdx(de_ctx, "myflow", DETECT_FLOWBITS);
 
-    gv = p->flow->flowvar;
-
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-                result = 1;
-        }
-    }
+    if (FlowBitIsset(p->flow, idx) == 1)
+        result = 1;
 
     SigGroupCleanup(de_ctx);
     SigCleanSignatures(de_ctx);
@@ -1023,7 +1004,6 @@ static int FlowBitsTestSig08(void) {
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    if(gv) GenericVarFree(gv);
     FLOW_DESTROY(&f);
 
     SCFree(p);
@@ -1043,7 +1023,6 @@ end:
         DetectEngineCtxFree(de_ctx);
     }
 
-    if(gv) GenericVarFree(gv);
     FLOW_DESTROY(&f);
 
     SCFree(p);
@@ -835,6 +835,22 @@ error:
     return -1;
 }
 
+/** \internal \brief 64 bit FNV-1a over the rule text and the direction
+ *            the addresses are parsed in */
+static uint64_t SigParseHash(const char *sigstr, uint8_t addrs_direction)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint8_t *c;
+
+    for (c = (const uint8_t *)sigstr; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= addrs_direction;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
 /**
  *  \brief parse a signature
  *
@@ -851,6 +867,7 @@ int SigParse(DetectEngineCtx *de_ctx, Signature *s, char *sigstr, uint8_t addrs_
 
     char **basics;
     s->sig_str = sigstr;
+    s->sig_hash = SigParseHash(sigstr, addrs_direction);
 
     int ret = SigParseBasics(s, sigstr, &basics, addrs_direction);
     if (ret < 0 || basics == NULL) {
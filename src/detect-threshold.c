@@ -298,6 +298,7 @@ static void DetectThresholdFree(void *de_ptr)
 #include "detect-engine-mpm.h"
 #include "detect-engine-threshold.h"
 #include "util-time.h"
+#include "conf.h"
 #include "util-hashlist.h"
 
 /**
@@ -410,7 +411,7 @@ static int DetectThresholdTestSig1(void)
     int result = 0;
     int alerts = 0;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset(&th_v, 0, sizeof(th_v));
 
@@ -491,7 +492,7 @@ static int DetectThresholdTestSig1(void)
 
     UTHFreePackets(&p, 1);
 
-    HostShutdown();
+    ThresholdShutdown();
 end:
     return result;
 }
@@ -514,7 +515,7 @@ static int DetectThresholdTestSig2(void)
     int result = 0;
     int alerts = 0;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset(&th_v, 0, sizeof(th_v));
 
@@ -570,7 +571,7 @@ cleanup:
 
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -592,9 +593,9 @@ static int DetectThresholdTestSig3(void)
     int result = 0;
     int alerts = 0;
     struct timeval ts;
-    DetectThresholdEntry *lookup_tsh = NULL;
+    DetectThresholdEntry entry;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -624,19 +625,11 @@ static int DetectThresholdTestSig3(void)
     SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
     SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
 
-    Host *host = HostLookupHostFromHash(&p->dst);
-    if (host == NULL) {
-        printf("host not found: ");
+    if (ThresholdGetEntry(10, 1, TRACK_DST, &p->dst, &entry) == 0) {
+        printf("no threshold entry: ");
         goto cleanup;
     }
 
-    if (!(ThresholdHostHasThreshold(host))) {
-        HostRelease(host);
-        printf("host has no threshold: ");
-        goto cleanup;
-    }
-    HostRelease(host);
-
     TimeSetIncrementTime(200);
     TimeGet(&p->ts);
 
@@ -644,21 +637,12 @@ static int DetectThresholdTestSig3(void)
     SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
     SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
 
-    host = HostLookupHostFromHash(&p->dst);
-    if (host == NULL) {
-        printf("host not found: ");
+    if (ThresholdGetEntry(10, 1, TRACK_DST, &p->dst, &entry) == 0) {
+        printf("no threshold entry: ");
         goto cleanup;
     }
-    HostRelease(host);
 
-    lookup_tsh = HostGetStorageById(host, ThresholdHostStorageId());
-    if (lookup_tsh == NULL) {
-        HostRelease(host);
-        printf("lookup_tsh is NULL: ");
-        goto cleanup;
-    }
-
-    alerts = lookup_tsh->current_count;
+    alerts = entry.current_count;
 
     if (alerts == 3)
         result = 1;
@@ -675,7 +659,7 @@ cleanup:
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -698,7 +682,7 @@ static int DetectThresholdTestSig4(void)
     int alerts = 0;
     struct timeval ts;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -753,7 +737,7 @@ cleanup:
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -775,7 +759,7 @@ static int DetectThresholdTestSig5(void)
     int result = 0;
     int alerts = 0;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset(&th_v, 0, sizeof(th_v));
     p = UTHBuildPacketReal((uint8_t *)"A",1,IPPROTO_TCP, "1.1.1.1", "2.2.2.2", 1024, 80);
@@ -841,7 +825,7 @@ cleanup:
 
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -854,7 +838,7 @@ static int DetectThresholdTestSig6Ticks(void)
     int result = 0;
     int alerts = 0;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset(&th_v, 0, sizeof(th_v));
     p = UTHBuildPacketReal((uint8_t *)"A",1,IPPROTO_TCP, "1.1.1.1", "2.2.2.2", 1024, 80);
@@ -924,7 +908,7 @@ cleanup:
 
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -942,7 +926,7 @@ static int DetectThresholdTestSig7(void)
     int drops = 0;
     struct timeval ts;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -1018,7 +1002,7 @@ cleanup:
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -1036,7 +1020,7 @@ static int DetectThresholdTestSig8(void)
     int drops = 0;
     struct timeval ts;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -1112,7 +1096,7 @@ cleanup:
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -1129,7 +1113,7 @@ static int DetectThresholdTestSig9(void) {
     int drops = 0;
     struct timeval ts;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -1205,7 +1189,7 @@ cleanup:
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -1223,7 +1207,7 @@ static int DetectThresholdTestSig10(void)
     int drops = 0;
     struct timeval ts;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -1299,7 +1283,7 @@ cleanup:
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -1317,7 +1301,7 @@ static int DetectThresholdTestSig11(void)
     int drops = 0;
     struct timeval ts;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -1393,7 +1377,7 @@ cleanup:
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -1411,7 +1395,7 @@ static int DetectThresholdTestSig12(void)
     int drops = 0;
     struct timeval ts;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     memset (&ts, 0, sizeof(struct timeval));
     TimeGet(&ts);
@@ -1487,10 +1471,108 @@ cleanup:
     DetectEngineCtxFree(de_ctx);
 end:
     UTHFreePackets(&p, 1);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
+/**
+ * \test threshold table memcap: entries are evicted once the memcap is
+ *       reached, and timed out entries are removed.
+ */
+static int DetectThresholdTestSig13(void)
+{
+    Packet *p[3] = { NULL, NULL, NULL };
+    Signature *s = NULL;
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    DetectEngineCtx *de_ctx = NULL;
+    ThresholdStats stats;
+    DetectThresholdEntry entry;
+    struct timeval ts;
+    char memcap[32];
+    int result = 0;
+    int i;
+
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfSet("threshold.hash-size", "1", 1);
+
+    /* memuse right after init is the size of the table itself */
+    ThresholdInit();
+    ThresholdGetStats(&stats);
+    ThresholdShutdown();
+
+    snprintf(memcap, sizeof(memcap), "%"PRIu64,
+            stats.memuse + 2 * sizeof(DetectThresholdEntry));
+    ConfSet("threshold.memcap", memcap, 1);
+    ThresholdInit();
+
+    memset(&th_v, 0, sizeof(th_v));
+
+    p[0] = UTHBuildPacketReal((uint8_t *)"A",1,IPPROTO_TCP, "1.1.1.1", "2.2.2.1", 1024, 80);
+    p[1] = UTHBuildPacketReal((uint8_t *)"A",1,IPPROTO_TCP, "1.1.1.1", "2.2.2.2", 1024, 80);
+    p[2] = UTHBuildPacketReal((uint8_t *)"A",1,IPPROTO_TCP, "1.1.1.1", "2.2.2.3", 1024, 80);
+    if (p[0] == NULL || p[1] == NULL || p[2] == NULL)
+        goto end;
+
+    de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL)
+        goto end;
+    de_ctx->flags |= DE_QUIET;
+
+    s = de_ctx->sig_list = SigInit(de_ctx,"alert tcp any any -> any 80 (msg:\"Threshold limit\"; threshold: type limit, track by_dst, count 5, seconds 60; sid:10;)");
+    if (s == NULL)
+        goto end;
+
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    TimeGet(&ts);
+    for (i = 0; i < 3; i++) {
+        p[i]->ts = ts;
+        SigMatchSignatures(&th_v, de_ctx, det_ctx, p[i]);
+    }
+
+    ThresholdGetStats(&stats);
+    if (stats.entries != 2 || stats.evictions != 1 || stats.lookups != 3) {
+        printf("entries %"PRIu64" evictions %"PRIu64" lookups %"PRIu64": ",
+                stats.entries, stats.evictions, stats.lookups);
+        goto end;
+    }
+
+    if (ThresholdGetEntry(10, 1, TRACK_DST, &p[2]->dst, &entry) == 0) {
+        printf("newest entry not found: ");
+        goto end;
+    }
+
+    TimeSetIncrementTime(120);
+    TimeGet(&ts);
+    if (ThresholdTimeoutHash(&ts) != 2) {
+        printf("entries not timed out: ");
+        goto end;
+    }
+
+    ThresholdGetStats(&stats);
+    if (stats.entries != 0) {
+        printf("entries %"PRIu64" after timeout: ", stats.entries);
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (det_ctx != NULL)
+        DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    if (de_ctx != NULL) {
+        SigGroupCleanup(de_ctx);
+        SigCleanSignatures(de_ctx);
+        DetectEngineCtxFree(de_ctx);
+    }
+    UTHFreePackets(p, 3);
+    ThresholdShutdown();
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    return result;
+}
 #endif /* UNITTESTS */
 
 void ThresholdRegisterTests(void)
@@ -1513,6 +1595,7 @@ void ThresholdRegisterTests(void)
     UtRegisterTest("DetectThresholdTestSig10", DetectThresholdTestSig10, 1);
     UtRegisterTest("DetectThresholdTestSig11", DetectThresholdTestSig11, 1);
     UtRegisterTest("DetectThresholdTestSig12", DetectThresholdTestSig12, 1);
+    UtRegisterTest("DetectThresholdTestSig13", DetectThresholdTestSig13, 1);
 #endif /* UNITTESTS */
 }
 
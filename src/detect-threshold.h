@@ -74,6 +74,7 @@ typedef struct DetectThresholdEntry_ {
     uint32_t tv_usec1;       /**< Var for time control */
     uint32_t current_count; /**< Var for count control */
     int track;          /**< Track type: by_src, by_src */
+    Address addr;       /**< tracked address for by_src and by_dst */
 
     struct DetectThresholdEntry_ *next;
 } DetectThresholdEntry;
@@ -87,6 +87,7 @@ static int DetectTlsFingerprintSetup (DetectEngineCtx *, Signature *, char *);
 static void DetectTlsFingerprintFree(void *);
 static int DetectTlsStoreSetup (DetectEngineCtx *, Signature *, char *);
 static int DetectTlsStoreMatch (ThreadVars *, DetectEngineThreadCtx *, Flow *, uint8_t, void *, Signature *, SigMatch *);
+static int DetectTlsNoBypassSetup (DetectEngineCtx *, Signature *, char *);
 
 /**
  * \brief Registration function for keyword: tls.version
@@ -133,6 +134,16 @@ void DetectTlsRegister (void) {
     sigmatch_table[DETECT_AL_TLS_STORE].RegisterTests = NULL;
     sigmatch_table[DETECT_AL_TLS_STORE].flags |= SIGMATCH_NOOPT;
 
+    sigmatch_table[DETECT_AL_TLS_NO_BYPASS].name = "tls.no_bypass";
+    sigmatch_table[DETECT_AL_TLS_NO_BYPASS].desc = "keep inspecting the packets of TLS/SSL sessions after the handshake";
+    sigmatch_table[DETECT_AL_TLS_NO_BYPASS].Match = NULL;
+    sigmatch_table[DETECT_AL_TLS_NO_BYPASS].AppLayerMatch = NULL;
+    sigmatch_table[DETECT_AL_TLS_NO_BYPASS].alproto = ALPROTO_TLS;
+    sigmatch_table[DETECT_AL_TLS_NO_BYPASS].Setup = DetectTlsNoBypassSetup;
+    sigmatch_table[DETECT_AL_TLS_NO_BYPASS].Free  = NULL;
+    sigmatch_table[DETECT_AL_TLS_NO_BYPASS].RegisterTests = NULL;
+    sigmatch_table[DETECT_AL_TLS_NO_BYPASS].flags |= SIGMATCH_NOOPT;
+
     const char *eb;
     int eo;
     int opts = 0;
@@ -833,6 +844,30 @@ static int DetectTlsStoreMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, F
     SCReturnInt(1);
 }
 
+/**
+ * \brief this function is used to set up the tls.no_bypass keyword. The
+ *        tls parser doesn't bypass encrypted sessions while rules with it
+ *        are loaded, so their packet level matches see the whole session.
+ *
+ * \param de_ctx pointer to the Detection Engine Context
+ * \param s pointer to the Current Signature
+ * \param str unused, the keyword has no options
+ *
+ * \retval 0 on Success
+ * \retval -1 on Failure
+ */
+static int DetectTlsNoBypassSetup (DetectEngineCtx *de_ctx, Signature *s, char *str)
+{
+    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_TLS) {
+        SCLogError(SC_ERR_CONFLICTING_RULE_KEYWORDS, "rule contains conflicting keywords.");
+        return -1;
+    }
+
+    s->alproto = ALPROTO_TLS;
+    s->flags |= SIG_FLAG_TLS_NO_BYPASS;
+    return 0;
+}
+
 
 /**
  * \brief this function registers unit tests for DetectTlsIssuerDN
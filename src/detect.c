@@ -33,6 +33,7 @@
 
 #include "detect-parse.h"
 #include "detect-engine.h"
+#include "detect-engine-rulestats.h"
 
 #include "detect-engine-alert.h"
 #include "detect-engine-siggroup.h"
@@ -40,6 +41,7 @@
 #include "detect-engine-proto.h"
 #include "detect-engine-port.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-build.h"
 #include "detect-engine-iponly.h"
 #include "detect-engine-threshold.h"
 
@@ -101,6 +103,8 @@
 #include "detect-filestore.h"
 #include "detect-filemagic.h"
 #include "detect-filemd5.h"
+#include "detect-filesha1.h"
+#include "detect-filesha256.h"
 #include "detect-filesize.h"
 #include "detect-dsize.h"
 #include "detect-flowvar.h"
@@ -158,6 +162,7 @@
 #include "app-layer.h"
 #include "app-layer-protos.h"
 #include "app-layer-htp.h"
+#include "app-layer-ssl.h"
 #include "detect-tls.h"
 #include "detect-tls-version.h"
 #include "detect-ssh-proto-version.h"
@@ -1021,39 +1026,30 @@ static void DebugInspectIds(Packet *p, Flow *f, StreamMsg *smsg)
 
 static void AlertDebugLogModeSyncFlowbitsNamesToPacketStruct(Packet *p, DetectEngineCtx *de_ctx)
 {
-#define MALLOC_JUMP 5
-
     int i = 0;
+    uint32_t idx;
+    uint32_t max_idx = p->flow->flowbits_size * 8;
 
-    GenericVar *gv = p->flow->flowvar;
-
-    while (gv != NULL) {
-        i++;
-        gv = gv->next;
+    for (idx = 0; idx < max_idx; idx++) {
+        if (p->flow->flowbits[idx / 8] & (1 << (idx % 8)))
+            i++;
     }
     if (i == 0)
         return;
 
-    p->debuglog_flowbits_names_len = i;
-
-    p->debuglog_flowbits_names = SCMalloc(sizeof(char *) *
-                                          p->debuglog_flowbits_names_len);
+    p->debuglog_flowbits_names = SCMalloc(sizeof(char *) * i);
     if (p->debuglog_flowbits_names == NULL) {
         return;
     }
-    memset(p->debuglog_flowbits_names, 0,
-           sizeof(char *) * p->debuglog_flowbits_names_len);
+    memset(p->debuglog_flowbits_names, 0, sizeof(char *) * i);
+    p->debuglog_flowbits_names_len = i;
 
     i = 0;
-    gv = p->flow->flowvar;
-    while (gv != NULL) {
-        if (gv->type != DETECT_FLOWBITS) {
-            gv = gv->next;
+    for (idx = 0; idx < max_idx && i < p->debuglog_flowbits_names_len; idx++) {
+        if (!(p->flow->flowbits[idx / 8] & (1 << (idx % 8))))
             continue;
-        }
 
-        FlowBit *fb = (FlowBit *) gv;
-        char *name = VariableIdxGetName(de_ctx, fb->idx, fb->type);
+        char *name = VariableIdxGetName(de_ctx, (uint16_t)idx, DETECT_FLOWBITS);
         if (name != NULL) {
             p->debuglog_flowbits_names[i] = SCStrdup(name);
             if (p->debuglog_flowbits_names[i] == NULL) {
@@ -1061,21 +1057,6 @@ static void AlertDebugLogModeSyncFlowbitsNamesToPacketStruct(Packet *p, DetectEn
             }
             i++;
         }
-
-        if (i == p->debuglog_flowbits_names_len) {
-            p->debuglog_flowbits_names_len += MALLOC_JUMP;
-            p->debuglog_flowbits_names = SCRealloc(p->debuglog_flowbits_names,
-                                                   sizeof(char *) *
-                                                   p->debuglog_flowbits_names_len);
-            if (p->debuglog_flowbits_names == NULL) {
-                return;
-            }
-            memset(p->debuglog_flowbits_names +
-                   p->debuglog_flowbits_names_len - MALLOC_JUMP,
-                   0, sizeof(char *) * MALLOC_JUMP);
-        }
-
-        gv = gv->next;
     }
 
     return;
@@ -1092,9 +1073,7 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
     uint8_t sms_runflags = 0;   /* function flags */
     uint8_t alert_flags = 0;
     uint16_t alproto = ALPROTO_UNKNOWN;
-#ifdef PROFILING
     int smatch = 0; /* signature match: 1, no match: 0 */
-#endif
     uint32_t idx;
     uint8_t flags = 0;          /* flow/state flags */
     void *alstate = NULL;
@@ -1103,6 +1082,7 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
     SigMatch *sm = NULL;
     uint16_t alversion = 0;
     int reset_de_state = 0;
+    int remap_de_state = 0;
     int state_alert = 0;
     int alerts = 0;
     int app_decoder_events = 0;
@@ -1133,16 +1113,28 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
                 /* first time this flow is inspected, set id */
                 p->flow->de_ctx_id = de_ctx->id;
             } else if (p->flow->de_ctx_id != de_ctx->id) {
-                /* first time we inspect flow with this de_ctx, reset */
+                /* first time we inspect flow with this de_ctx. The sgh's
+                 * belong to the old de_ctx, so always reset those. */
                 p->flow->flags &= ~FLOW_SGH_TOSERVER;
                 p->flow->flags &= ~FLOW_SGH_TOCLIENT;
                 p->flow->sgh_toserver = NULL;
                 p->flow->sgh_toclient = NULL;
-                reset_de_state = 1;
+
+                /* the de_state refers to the sigmatches of the old de_ctx,
+                 * on an incremental reload those of unchanged sigs are
+                 * mapped to ours */
+                if (p->flow->de_ctx_id == de_ctx->reload_src_id) {
+                    remap_de_state = 1;
+                } else {
+                    reset_de_state = 1;
+
+                    /* variable idx's may be different */
+                    GenericVarFree(p->flow->flowvar);
+                    p->flow->flowvar = NULL;
+                    FlowBitsFree(p->flow);
+                }
 
                 p->flow->de_ctx_id = de_ctx->id;
-                GenericVarFree(p->flow->flowvar);
-                p->flow->flowvar = NULL;
             }
 
             /* set the iponly stuff */
@@ -1208,6 +1200,10 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
             SCMutexLock(&p->flow->de_state_m);
             DetectEngineStateReset(p->flow->de_state, (STREAM_TOSERVER|STREAM_TOCLIENT));
             SCMutexUnlock(&p->flow->de_state_m);
+        } else if (remap_de_state) {
+            SCMutexLock(&p->flow->de_state_m);
+            DeStateReloadRemap(de_ctx, p->flow->de_state);
+            SCMutexUnlock(&p->flow->de_state_m);
         }
 
         if (((p->flowflags & FLOW_PKT_TOSERVER) && !(p->flowflags & FLOW_PKT_TOSERVER_IPONLY_SET)) ||
@@ -1305,10 +1301,9 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
     /* inspect the sigs against the packet */
     for (idx = 0; idx < det_ctx->match_array_cnt; idx++) {
         RULE_PROFILING_START;
+        RULE_STATS_START(det_ctx);
         state_alert = 0;
-#ifdef PROFILING
         smatch = 0;
-#endif
 
         s = det_ctx->match_array[idx];
         SCLogDebug("inspecting signature id %"PRIu32"", s->id);
@@ -1318,7 +1313,7 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
          * can't match and we skip it. */
         if ((p->flags & PKT_HAS_FLOW) && (s->flags & SIG_FLAG_REQUIRE_FLOWVAR)) {
             FLOWLOCK_RDLOCK(p->flow);
-            int m  = p->flow->flowvar ? 1 : 0;
+            int m  = (p->flow->flowvar || p->flow->flowbits) ? 1 : 0;
             FLOWLOCK_UNLOCK(p->flow);
 
             /* no flowvars? skip this sig */
@@ -1511,9 +1506,7 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
             alert_flags |= PACKET_ALERT_FLAG_STATE_MATCH;
         }
 
-#ifdef PROFILING
         smatch = 1;
-#endif
 
         SigMatchSignaturesRunPostMatch(th_v, de_ctx, det_ctx, p, s);
 
@@ -1531,6 +1524,7 @@ next:
         DetectReplaceFree(det_ctx->replist);
         det_ctx->replist = NULL;
         RULE_PROFILING_END(det_ctx, s, smatch);
+        RULE_STATS_END(det_ctx, s, smatch);
 
         det_ctx->flags = 0;
         continue;
@@ -1562,7 +1556,6 @@ end:
 
     DetectEngineCleanHCBDBuffers(det_ctx);
     DetectEngineCleanHSBDBuffers(det_ctx);
-    DetectEngineCleanHHDBuffers(det_ctx);
 
     /* store the found sgh (or NULL) in the flow to save us from looking it
      * up again for the next packet. Also return any stream chunk we processed
@@ -1606,6 +1599,22 @@ end:
                     FileDisableMd5(p->flow, STREAM_TOSERVER);
                 }
 
+                /* see if this sgh requires us to consider file sha1 */
+                if (!FileForceSha1() && (p->flow->sgh_toserver == NULL ||
+                            !(p->flow->sgh_toserver->flags & SIG_GROUP_HEAD_HAVEFILESHA1)))
+                {
+                    SCLogDebug("disabling sha1 for flow");
+                    FileDisableSha1(p->flow, STREAM_TOSERVER);
+                }
+
+                /* see if this sgh requires us to consider file sha256 */
+                if (!FileForceSha256() && (p->flow->sgh_toserver == NULL ||
+                            !(p->flow->sgh_toserver->flags & SIG_GROUP_HEAD_HAVEFILESHA256)))
+                {
+                    SCLogDebug("disabling sha256 for flow");
+                    FileDisableSha256(p->flow, STREAM_TOSERVER);
+                }
+
                 /* see if this sgh requires us to consider filesize */
                 if (p->flow->sgh_toserver == NULL ||
                             !(p->flow->sgh_toserver->flags & SIG_GROUP_HEAD_HAVEFILESIZE))
@@ -1637,6 +1646,22 @@ end:
                     FileDisableMd5(p->flow, STREAM_TOCLIENT);
                 }
 
+                /* check if this flow needs sha1, if not disable it */
+                if (!FileForceSha1() && (p->flow->sgh_toclient == NULL ||
+                            !(p->flow->sgh_toclient->flags & SIG_GROUP_HEAD_HAVEFILESHA1)))
+                {
+                    SCLogDebug("disabling sha1 for flow");
+                    FileDisableSha1(p->flow, STREAM_TOCLIENT);
+                }
+
+                /* check if this flow needs sha256, if not disable it */
+                if (!FileForceSha256() && (p->flow->sgh_toclient == NULL ||
+                            !(p->flow->sgh_toclient->flags & SIG_GROUP_HEAD_HAVEFILESHA256)))
+                {
+                    SCLogDebug("disabling sha256 for flow");
+                    FileDisableSha256(p->flow, STREAM_TOCLIENT);
+                }
+
                 /* see if this sgh requires us to consider filesize */
                 if (p->flow->sgh_toclient == NULL ||
                             !(p->flow->sgh_toclient->flags & SIG_GROUP_HEAD_HAVEFILESIZE))
@@ -1818,6 +1843,42 @@ int SignatureIsFileMd5Inspecting(Signature *s) {
     return 0;
 }
 
+/**
+ *  \brief Check if a signature contains the filesha1 keyword.
+ *
+ *  \param s signature
+ *
+ *  \retval 0 no
+ *  \retval 1 yes
+ */
+int SignatureIsFileSha1Inspecting(Signature *s) {
+    if (s == NULL)
+        return 0;
+
+    if (s->file_flags & FILE_SIG_NEED_SHA1)
+        return 1;
+
+    return 0;
+}
+
+/**
+ *  \brief Check if a signature contains the filesha256 keyword.
+ *
+ *  \param s signature
+ *
+ *  \retval 0 no
+ *  \retval 1 yes
+ */
+int SignatureIsFileSha256Inspecting(Signature *s) {
+    if (s == NULL)
+        return 0;
+
+    if (s->file_flags & FILE_SIG_NEED_SHA256)
+        return 1;
+
+    return 0;
+}
+
 /**
  *  \brief Check if a signature contains the filesize keyword.
  *
@@ -2455,6 +2516,7 @@ int SigAddressPrepareStage1(DetectEngineCtx *de_ctx) {
     uint32_t cnt_payload = 0;
     uint32_t cnt_applayer = 0;
     uint32_t cnt_deonly = 0;
+    uint32_t cnt_tls_no_bypass = 0;
 
     //DetectAddressPrintMemory();
     //DetectSigGroupPrintMemory();
@@ -2515,6 +2577,12 @@ int SigAddressPrepareStage1(DetectEngineCtx *de_ctx) {
             cnt_applayer++;
         }
 
+        if (tmp_s->flags & SIG_FLAG_TLS_NO_BYPASS) {
+            SCLogDebug("Signature %"PRIu32" needs tls sessions after the "
+                    "handshake", tmp_s->id);
+            cnt_tls_no_bypass++;
+        }
+
 #ifdef DEBUG
         if (SCLogDebugEnabled()) {
             uint16_t colen = 0;
@@ -2573,6 +2641,17 @@ int SigAddressPrepareStage1(DetectEngineCtx *de_ctx) {
     //DetectSigGroupPrintMemory();
     //DetectPortPrintMemory();
 
+    /* the tls parser bypasses encrypted sessions, unless rules opted out */
+    if (cnt_tls_no_bypass > 0 && !(de_ctx->flags & DE_TLS_NO_BYPASS)) {
+        de_ctx->flags |= DE_TLS_NO_BYPASS;
+        SSLNoBypassRegister();
+
+        if (!(de_ctx->flags & DE_QUIET)) {
+            SCLogInfo("%"PRIu32" signatures use tls.no_bypass, encrypted "
+                    "sessions won't be bypassed", cnt_tls_no_bypass);
+        }
+    }
+
     if (!(de_ctx->flags & DE_QUIET)) {
         SCLogInfo("%" PRIu32 " signatures processed. %" PRIu32 " are IP-only "
                 "rules, %" PRIu32 " are inspecting packet payload, %"PRIu32
@@ -3935,26 +4014,33 @@ void DbgSghContainsSig(DetectEngineCtx *de_ctx, SigGroupHead *sgh, uint32_t sid)
     printf("\n");
 }
 
+/** \brief finalize a single sgh, called from the build worker pool */
+static int SigAddressPrepareStage4Sgh(DetectEngineCtx *de_ctx, void *data)
+{
+    SigGroupHead *sgh = (SigGroupHead *)data;
+
+    if (SigGroupHeadBuildHeadArray(de_ctx, sgh) < 0)
+        return -1;
+    SigGroupHeadSetFilemagicFlag(de_ctx, sgh);
+    SigGroupHeadSetFileMd5Flag(de_ctx, sgh);
+    SigGroupHeadSetFileSha1Flag(de_ctx, sgh);
+    SigGroupHeadSetFileSha256Flag(de_ctx, sgh);
+    SigGroupHeadSetFilesizeFlag(de_ctx, sgh);
+    SigGroupHeadSetFilestoreCount(de_ctx, sgh);
+    SCLogDebug("filestore count %u", sgh->filestore_cnt);
+    return 0;
+}
+
 /** \brief finalize preparing sgh's */
 int SigAddressPrepareStage4(DetectEngineCtx *de_ctx) {
     SCEnter();
 
     //SCLogInfo("sgh's %"PRIu32, de_ctx->sgh_array_cnt);
 
-    uint32_t idx = 0;
-
-    for (idx = 0; idx < de_ctx->sgh_array_cnt; idx++) {
-        SigGroupHead *sgh = de_ctx->sgh_array[idx];
-        if (sgh == NULL)
-            continue;
-
-        SigGroupHeadBuildHeadArray(de_ctx, sgh);
-        SigGroupHeadSetFilemagicFlag(de_ctx, sgh);
-        SigGroupHeadSetFileMd5Flag(de_ctx, sgh);
-        SigGroupHeadSetFilesizeFlag(de_ctx, sgh);
-        SigGroupHeadSetFilestoreCount(de_ctx, sgh);
-        SCLogDebug("filestore count %u", sgh->filestore_cnt);
-    }
+    /* each sgh is independent here, so spread them over the pool */
+    int r = DetectEngineBuildRunParallel(de_ctx, DetectEngineBuildGetThreads(de_ctx),
+            (void **)de_ctx->sgh_array, de_ctx->sgh_array_cnt,
+            SigAddressPrepareStage4Sgh);
 
     if (de_ctx->decoder_event_sgh != NULL) {
         SigGroupHeadBuildHeadArray(de_ctx, de_ctx->decoder_event_sgh);
@@ -3963,10 +4049,11 @@ int SigAddressPrepareStage4(DetectEngineCtx *de_ctx) {
     }
 
     SCFree(de_ctx->sgh_array);
+    de_ctx->sgh_array = NULL;
     de_ctx->sgh_array_cnt = 0;
     de_ctx->sgh_array_size = 0;
 
-    SCReturnInt(0);
+    SCReturnInt(r);
 }
 
 /* shortcut for debugging. If enabled Stage5 will
@@ -4280,6 +4367,48 @@ int SigAddressPrepareStage5(DetectEngineCtx *de_ctx) {
     return 0;
 }
 
+/**
+ * \brief Queue the mpm ctxs of the mpm ctx factory for preparation. Used
+ *        when all sgh's share a single mpm ctx per buffer type.
+ */
+static void SigGroupBuildQueueFactoryMpmCtxs(DetectEngineCtx *de_ctx)
+{
+    /* profile id and whether it has a toclient ctx as well */
+    const struct {
+        int32_t id;
+        int both;
+    } profiles[] = {
+        { de_ctx->sgh_mpm_context_proto_tcp_packet, 1 },
+        { de_ctx->sgh_mpm_context_proto_udp_packet, 1 },
+        { de_ctx->sgh_mpm_context_proto_other_packet, 0 },
+        { de_ctx->sgh_mpm_context_uri, 1 },
+        { de_ctx->sgh_mpm_context_hcbd, 1 },
+        { de_ctx->sgh_mpm_context_hsbd, 1 },
+        { de_ctx->sgh_mpm_context_hhd, 1 },
+        { de_ctx->sgh_mpm_context_hrhd, 1 },
+        { de_ctx->sgh_mpm_context_hmd, 1 },
+        { de_ctx->sgh_mpm_context_hcd, 1 },
+        { de_ctx->sgh_mpm_context_hrud, 1 },
+        { de_ctx->sgh_mpm_context_stream, 1 },
+        { de_ctx->sgh_mpm_context_hsmd, 1 },
+        { de_ctx->sgh_mpm_context_hscd, 1 },
+        { de_ctx->sgh_mpm_context_huad, 1 },
+        { de_ctx->sgh_mpm_context_hhhd, 1 },
+        { de_ctx->sgh_mpm_context_hrhhd, 1 },
+    };
+    uint32_t i;
+
+    for (i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        MpmCtx *mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, profiles[i].id, 0);
+        DetectEngineBuildQueueMpmCtx(de_ctx, mpm_ctx);
+
+        if (profiles[i].both) {
+            mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, profiles[i].id, 1);
+            DetectEngineBuildQueueMpmCtx(de_ctx, mpm_ctx);
+        }
+    }
+}
+
 /**
  * \brief Convert the signature list into the runtime match structure.
  *
@@ -4292,6 +4421,10 @@ int SigAddressPrepareStage5(DetectEngineCtx *de_ctx) {
 int SigGroupBuild(DetectEngineCtx *de_ctx)
 {
     Signature *s = de_ctx->sig_list;
+    DetectEngineBuildProfile profile;
+    uint32_t sgh_cnt;
+
+    DetectEngineBuildProfileStart(de_ctx, &profile);
 
     /* Assign the unique order id of signatures after sorting,
      * so the IP Only engine process them in order too.  Also
@@ -4313,28 +4446,34 @@ int SigGroupBuild(DetectEngineCtx *de_ctx)
     if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_SINGLE) {
         SigInitStandardMpmFactoryContexts(de_ctx);
     }
+    DetectEngineBuildProfileStage(&profile, "fast-pattern", de_ctx->signum);
 
     if (SigAddressPrepareStage1(de_ctx) != 0) {
         SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
         exit(EXIT_FAILURE);
     }
+    DetectEngineBuildProfileStage(&profile, "stage1", de_ctx->sig_cnt);
+
     if (SigAddressPrepareStage2(de_ctx) != 0) {
         SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
         exit(EXIT_FAILURE);
     }
+    DetectEngineBuildProfileStage(&profile, "stage2", 0);
 
     if (SigAddressPrepareStage3(de_ctx) != 0) {
         SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
         exit(EXIT_FAILURE);
     }
+    DetectEngineBuildProfileStage(&profile, "stage3", 0);
+
+    sgh_cnt = de_ctx->sgh_array_cnt;
     if (SigAddressPrepareStage4(de_ctx) != 0) {
         SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
         exit(EXIT_FAILURE);
     }
+    DetectEngineBuildProfileStage(&profile, "stage4", sgh_cnt);
 
     if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_SINGLE) {
-        MpmCtx *mpm_ctx = NULL;
-
 #ifdef __SC_CUDA_SUPPORT__
         if (PatternMatchDefaultMatcher() == MPM_AC_CUDA) {
             /* setting it to default.  You've gotta remove it once you fix the state table thing */
@@ -4354,179 +4493,18 @@ int SigGroupBuild(DetectEngineCtx *de_ctx)
         }
 #endif
 
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_tcp_packet, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_tcp_packet, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("packet- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_udp_packet, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_udp_packet, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("packet- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_other_packet, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("packet- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_uri, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_uri, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("uri- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hcbd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hcbd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hcbd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hsbd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hsbd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hsbd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hhd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hhd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hhd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hrhd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hrhd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hrhd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hmd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hmd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hmd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hcd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hcd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hcd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hrud, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hrud, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hrud- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_stream, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_stream, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("stream- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hsmd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hsmd- %d\n", mpm_ctx->pattern_cnt);
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hsmd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hsmd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hscd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hscd- %d\n", mpm_ctx->pattern_cnt);
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hscd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hscd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_huad, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("huad- %d\n", mpm_ctx->pattern_cnt);
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_huad, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("huad- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hhhd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hhhd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hhhd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hhhd- %d\n", mpm_ctx->pattern_cnt);
-
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hrhhd, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hrhhd- %d\n", mpm_ctx->pattern_cnt);
+        SigGroupBuildQueueFactoryMpmCtxs(de_ctx);
+    }
 
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_hrhhd, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        //printf("hrhhd- %d\n", mpm_ctx->pattern_cnt);
+    /* prepare the mpm ctxs queued by the sgh's or the factory above */
+    uint32_t mpm_cnt = de_ctx->mpm_prepare_array_cnt;
+    if (DetectEngineBuildPrepareMpmCtxs(de_ctx) != 0) {
+        SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
+        exit(EXIT_FAILURE);
+    }
+    DetectEngineBuildProfileStage(&profile, "mpm-prepare", mpm_cnt);
 
+    if (de_ctx->sgh_mpm_context == ENGINE_SGH_MPM_FACTORY_CONTEXT_SINGLE) {
 #ifdef __SC_CUDA_SUPPORT__
         if (PatternMatchDefaultMatcher() == MPM_AC_CUDA) {
             int r = SCCudaCtxPopCurrent(NULL);
@@ -4540,9 +4518,13 @@ int SigGroupBuild(DetectEngineCtx *de_ctx)
          * \todo Support this. */
         DetermineCudaStateTableSize(de_ctx);
 #endif
-
     }
 
+    DetectEngineBuildProfileLog(de_ctx, &profile);
+
+    /* size new flowbit bitmaps for all flowbits of this engine */
+    FlowBitSetMaxIdx(de_ctx->variable_flowbits_idx);
+
 //    SigAddressPrepareStage5(de_ctx);
 //    DetectAddressPrintMemory();
 //    DetectSigGroupPrintMemory();
@@ -4550,10 +4532,13 @@ int SigGroupBuild(DetectEngineCtx *de_ctx)
 #ifdef PROFILING
     SCProfilingRuleInitCounters(de_ctx);
 #endif
+    DetectRuleStatsInitCtx(de_ctx);
     return 0;
 }
 
 int SigGroupCleanup (DetectEngineCtx *de_ctx) {
+    /* the mpm ctxs in the queue are freed with the sgh's */
+    DetectEngineBuildFreeMpmQueue(de_ctx);
     SigAddressCleanupStage1(de_ctx);
 
     return 0;
@@ -4754,6 +4739,8 @@ void SigTableSetup(void) {
     DetectFilestoreRegister();
     DetectFilemagicRegister();
     DetectFileMd5Register();
+    DetectFileSha1Register();
+    DetectFileSha256Register();
     DetectFilesizeRegister();
     DetectAppLayerEventRegister();
     DetectHttpUARegister();
@@ -278,6 +278,8 @@ typedef struct DetectPort_ {
 #define SIG_FLAG_TOCLIENT               (1<<20)
 
 #define SIG_FLAG_TLSSTORE               (1<<21)
+#define SIG_FLAG_TLS_NO_BYPASS          (1<<22) /**< needs the packets of tls
+                                                     sessions after the handshake */
 
 /* signature init flags */
 #define SIG_FLAG_INIT_DEONLY         1  /**< decode event only signature */
@@ -311,9 +313,13 @@ typedef struct DetectPort_ {
 #define FILE_SIG_NEED_FILECONTENT   0x10
 #define FILE_SIG_NEED_MD5           0x20
 #define FILE_SIG_NEED_SIZE          0x40
+#define FILE_SIG_NEED_SHA1          0x80
+#define FILE_SIG_NEED_SHA256        0x100
 
 /* Detection Engine flags */
 #define DE_QUIET           0x01     /**< DE is quiet (esp for unittests) */
+#define DE_TLS_NO_BYPASS   0x04     /**< rules use tls.no_bypass, registered
+                                         with the tls parser */
 
 typedef struct IPOnlyCIDRItem_ {
     /* address data for this item */
@@ -400,7 +406,7 @@ typedef struct Signature_ {
 
     /** inline -- action */
     uint8_t action;
-    uint8_t file_flags;
+    uint16_t file_flags;
 
     /** ipv4 match arrays */
     uint16_t addr_dst_match4_cnt;
@@ -436,6 +442,10 @@ typedef struct Signature_ {
 
     int prio;
 
+    /** hash of the rule text and direction, used to find the sigs that
+     *  didn't change on a rule reload */
+    uint64_t sig_hash;
+
     /* holds all sm lists */
     struct SigMatch_ *sm_lists[DETECT_SM_LIST_MAX];
     /* holds all sm lists' tails */
@@ -624,6 +634,9 @@ typedef struct DetectEngineCtx_ {
     HashListTable *variable_names;
     HashListTable *variable_idxs;
     uint16_t variable_names_idx;
+    /** flowbits have their own idx space, used to index the per flow
+     *  flowbits bitmap */
+    uint16_t variable_flowbits_idx;
 
     /* hash table used to cull out duplicate sigs */
     HashListTable *dup_sig_hash_table;
@@ -666,6 +679,23 @@ typedef struct DetectEngineCtx_ {
      *  id sharing and id tracking. */
     MpmPatternIdStore *mpm_pattern_id_store;
     uint16_t max_fp_id;
+    /** fast patterns and their ids, kept so a reload can reuse the ids */
+    struct DetectFPAndItsId_ *fp_ids;
+    uint32_t fp_ids_cnt;
+
+    /** engine we are reloading from. Only set while loading the sigs
+     *  and building this engine. */
+    struct DetectEngineCtx_ *reload_src;
+    /** id of the engine we were reloaded from, 0 if none */
+    uint32_t reload_src_id;
+    /** set up at the end of an incremental reload, so flows of the engine
+     *  we were reloaded from keep the detection state of unchanged sigs:
+     *  sig num in that engine -> our sig num + 1, 0 if the sig changed */
+    SigIntId *reload_sig_map;
+    uint32_t reload_sig_map_len;
+    /** app layer sigmatches of that engine -> ours. The old pointers are
+     *  only used as keys, they're never dereferenced. */
+    HashTable *reload_sm_map;
 
     MpmCtxFactoryContainer *mpm_ctx_factory_container;
 
@@ -683,6 +713,18 @@ typedef struct DetectEngineCtx_ {
     uint32_t sgh_array_cnt;
     uint32_t sgh_array_size;
 
+    /* mpm ctxs waiting to be prepared at the end of SigGroupBuild */
+    MpmCtx **mpm_prepare_array;
+    uint32_t mpm_prepare_array_cnt;
+    uint32_t mpm_prepare_array_size;
+    /** memory used by the mpm tables of this engine, and on reload the
+     *  peak while this engine and the one we reload from are alive */
+    uint64_t mpm_memory;
+    uint64_t reload_mpm_memory_peak;
+
+    /* number of threads used by SigGroupBuild, 0 for auto */
+    uint16_t build_threads;
+
     int32_t sgh_mpm_context_proto_tcp_packet;
     int32_t sgh_mpm_context_proto_udp_packet;
     int32_t sgh_mpm_context_proto_other_packet;
@@ -726,6 +768,9 @@ typedef struct DetectEngineCtx_ {
 
     int detect_luajit_instances;
 
+    /** per rule cost accounting, NULL if disabled */
+    struct DetectRuleStatsCtx_ *rule_stats_ctx;
+
 #ifdef PROFILING
     struct SCProfileDetectCtx_ *profile_ctx;
 #endif
@@ -787,12 +832,6 @@ typedef struct DetectionEngineThreadCtx_ {
     uint16_t hcbd_buffers_size;
     uint16_t hcbd_buffers_list_len;
 
-    uint8_t **hhd_buffers;
-    uint32_t *hhd_buffers_len;
-    uint16_t hhd_buffers_size;
-    uint16_t hhd_buffers_list_len;
-    uint64_t hhd_start_tx_id;
-
     /** id for alert counter */
     uint16_t counter_alerts;
 
@@ -856,6 +895,9 @@ typedef struct DetectionEngineThreadCtx_ {
     void **keyword_ctxs_array;
     int keyword_ctxs_size;
 
+    /** per rule counters of this thread, NULL if disabled */
+    struct DetectRuleStatsThread_ *rule_stats;
+
 #ifdef PROFILING
     struct SCProfileData_ *rule_perf_data;
     int rule_perf_data_size;
@@ -919,6 +961,8 @@ typedef struct SigTableElmt_ {
 #define SIG_GROUP_HEAD_HAVEFILEMD5      (1 << 21)
 #define SIG_GROUP_HEAD_HAVEFILESIZE     (1 << 22)
 #define SIG_GROUP_HEAD_MPM_DNSQUERY     (1 << 23)
+#define SIG_GROUP_HEAD_HAVEFILESHA1     (1 << 24)
+#define SIG_GROUP_HEAD_HAVEFILESHA256   (1 << 25)
 
 typedef struct SigGroupHeadInitData_ {
     /* list of content containers
@@ -1084,6 +1128,7 @@ enum {
     DETECT_AL_TLS_ISSUERDN,
     DETECT_AL_TLS_FINGERPRINT,
     DETECT_AL_TLS_STORE,
+    DETECT_AL_TLS_NO_BYPASS,
 
     DETECT_AL_HTTP_COOKIE,
     DETECT_AL_HTTP_METHOD,
@@ -1123,6 +1168,8 @@ enum {
     DETECT_FILESTORE,
     DETECT_FILEMAGIC,
     DETECT_FILEMD5,
+    DETECT_FILESHA1,
+    DETECT_FILESHA256,
     DETECT_FILESIZE,
 
     DETECT_L3PROTO,
@@ -1174,6 +1221,8 @@ Signature *DetectGetTagSignature(void);
 int SignatureIsFilestoring(Signature *);
 int SignatureIsFilemagicInspecting(Signature *);
 int SignatureIsFileMd5Inspecting(Signature *);
+int SignatureIsFileSha1Inspecting(Signature *);
+int SignatureIsFileSha256Inspecting(Signature *);
 int SignatureIsFilesizeInspecting(Signature *);
 
 int DetectRegisterThreadCtxFuncs(DetectEngineCtx *, const char *name, void *(*InitFunc)(void *), void *data, void (*FreeFunc)(void *), int);
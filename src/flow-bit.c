@@ -24,7 +24,10 @@
  * but called that way because of Snort's flowbits.
  * It's a binary storage.
  *
- * \todo move away from a linked list implementation
+ * The bits are stored in a per flow bitmap indexed by the flowbit name
+ * idx. It's allocated when the first bit is set and grown when an idx
+ * beyond its size is set, e.g. after a rule reload added new flowbits.
+ *
  * \todo use different datatypes, such as string, int, etc.
  * \todo have more than one instance of the same var, and be able to match on a
  *       specific one, or one all at a time. So if a certain capture matches
@@ -42,91 +45,112 @@
 #include "util-debug.h"
 #include "util-unittest.h"
 
-/* get the flowbit with idx from the flow */
-static FlowBit *FlowBitGet(Flow *f, uint16_t idx) {
-    GenericVar *gv = f->flowvar;
-    for ( ; gv != NULL; gv = gv->next) {
-        if (gv->type == DETECT_FLOWBITS && gv->idx == idx) {
-            return (FlowBit *)gv;
-        }
+/** highest flowbit idx registered by a detection engine. Used to size
+ *  the bitmap of a flow when it's first allocated. Only ever grows. It's
+ *  written by the thread (re)loading the rules while the packet threads
+ *  read it, a stale read just means the bitmap is grown once more later
+ *  on. */
+SC_ATOMIC_DECLARE(uint16_t, flowbits_max_idx);
+
+void FlowBitInit(void) {
+    SC_ATOMIC_INIT(flowbits_max_idx);
+}
+
+/**
+ *  \brief Tell the flowbit storage about the highest flowbit idx in use.
+ *
+ *  \param idx highest flowbit name idx of the detection engine
+ */
+void FlowBitSetMaxIdx(uint16_t idx) {
+    uint16_t cur = SC_ATOMIC_GET(flowbits_max_idx);
+
+    while (idx > cur) {
+        if (SC_ATOMIC_CAS(&flowbits_max_idx, cur, idx))
+            break;
+        cur = SC_ATOMIC_GET(flowbits_max_idx);
     }
+}
+
+/* get the flowbit with idx from the flow */
+static int FlowBitGet(Flow *f, uint16_t idx) {
+    if ((uint32_t)(idx / 8) >= f->flowbits_size)
+        return 0;
+
+    return (f->flowbits[idx / 8] & (1 << (idx % 8))) ? 1 : 0;
+}
+
+/* make sure the bitmap of the flow is large enough to hold idx. The
+ * size is rounded up to a multiple of 64 bits. */
+static int FlowBitGrow(Flow *f, uint16_t idx) {
+    uint16_t max_idx = SC_ATOMIC_GET(flowbits_max_idx);
+    if (idx > max_idx)
+        max_idx = idx;
+    uint16_t size = ((max_idx / 64) + 1) * 8;
+
+    uint8_t *ptr = SCRealloc(f->flowbits, size);
+    if (unlikely(ptr == NULL))
+        return -1;
+
+    memset(ptr + f->flowbits_size, 0, size - f->flowbits_size);
+
+#ifdef FLOWBITS_STATS
+    SCMutexLock(&flowbits_mutex);
+    flowbits_memuse += (size - f->flowbits_size);
+    if (flowbits_memuse > flowbits_memuse_max)
+        flowbits_memuse_max = flowbits_memuse;
+    SCMutexUnlock(&flowbits_mutex);
+#endif /* FLOWBITS_STATS */
 
-    return NULL;
+    f->flowbits = ptr;
+    f->flowbits_size = size;
+    return 0;
 }
 
 /* add a flowbit to the flow */
 static void FlowBitAdd(Flow *f, uint16_t idx) {
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL) {
-        fb = SCMalloc(sizeof(FlowBit));
-        if (unlikely(fb == NULL))
+    if ((uint32_t)(idx / 8) >= f->flowbits_size) {
+        if (FlowBitGrow(f, idx) < 0)
             return;
+    }
 
-        fb->type = DETECT_FLOWBITS;
-        fb->idx = idx;
-        fb->next = NULL;
-        GenericVarAppend(&f->flowvar, (GenericVar *)fb);
+    f->flowbits[idx / 8] |= (1 << (idx % 8));
 
-        //printf("FlowBitAdd: adding flowbit with idx %" PRIu32 "\n", idx);
 #ifdef FLOWBITS_STATS
-        SCMutexLock(&flowbits_mutex);
-        flowbits_added++;
-        flowbits_memuse += sizeof(FlowBit);
-        if (flowbits_memuse > flowbits_memuse_max)
-            flowbits_memuse_max = flowbits_memuse;
-        SCMutexUnlock(&flowbits_mutex);
+    SCMutexLock(&flowbits_mutex);
+    flowbits_added++;
+    SCMutexUnlock(&flowbits_mutex);
 #endif /* FLOWBITS_STATS */
-    }
 }
 
 static void FlowBitRemove(Flow *f, uint16_t idx) {
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL)
+    if ((uint32_t)(idx / 8) >= f->flowbits_size)
         return;
 
-    GenericVarRemove(&f->flowvar, (GenericVar *)fb);
+    f->flowbits[idx / 8] &= ~(1 << (idx % 8));
 
-    //printf("FlowBitRemove: remove flowbit with idx %" PRIu32 "\n", idx);
 #ifdef FLOWBITS_STATS
     SCMutexLock(&flowbits_mutex);
     flowbits_removed++;
-    if (flowbits_memuse >= sizeof(FlowBit))
-        flowbits_memuse -= sizeof(FlowBit);
-    else {
-        printf("ERROR: flowbits memory usage going below 0!\n");
-        flowbits_memuse = 0;
-    }
     SCMutexUnlock(&flowbits_mutex);
 #endif /* FLOWBITS_STATS */
 }
 
 void FlowBitSet(Flow *f, uint16_t idx) {
     FLOWLOCK_WRLOCK(f);
-
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL) {
-        FlowBitAdd(f, idx);
-    }
-
+    FlowBitAdd(f, idx);
     FLOWLOCK_UNLOCK(f);
 }
 
 void FlowBitUnset(Flow *f, uint16_t idx) {
     FLOWLOCK_WRLOCK(f);
-
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb != NULL) {
-        FlowBitRemove(f, idx);
-    }
-
+    FlowBitRemove(f, idx);
     FLOWLOCK_UNLOCK(f);
 }
 
 void FlowBitToggle(Flow *f, uint16_t idx) {
     FLOWLOCK_WRLOCK(f);
 
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb != NULL) {
+    if (FlowBitGet(f, idx) == 1) {
         FlowBitRemove(f, idx);
     } else {
         FlowBitAdd(f, idx);
@@ -139,10 +163,7 @@ int FlowBitIsset(Flow *f, uint16_t idx) {
     int r = 0;
     FLOWLOCK_RDLOCK(f);
 
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb != NULL) {
-        r = 1;
-    }
+    r = FlowBitGet(f, idx);
 
     FLOWLOCK_UNLOCK(f);
     return r;
@@ -152,32 +173,34 @@ int FlowBitIsnotset(Flow *f, uint16_t idx) {
     int r = 0;
     FLOWLOCK_RDLOCK(f);
 
-    FlowBit *fb = FlowBitGet(f, idx);
-    if (fb == NULL) {
-        r = 1;
-    }
+    r = FlowBitGet(f, idx) ? 0 : 1;
 
     FLOWLOCK_UNLOCK(f);
     return r;
 }
 
-void FlowBitFree(FlowBit *fb) {
-    if (fb == NULL)
+/**
+ *  \brief Free the flowbits of a flow. Caller must hold the flow lock
+ *         or be the only user of the flow.
+ */
+void FlowBitsFree(Flow *f) {
+    if (f->flowbits == NULL)
         return;
 
-    SCFree(fb);
-
 #ifdef FLOWBITS_STATS
     SCMutexLock(&flowbits_mutex);
-    flowbits_removed++;
-    if (flowbits_memuse >= sizeof(FlowBit))
-        flowbits_memuse -= sizeof(FlowBit);
+    if (flowbits_memuse >= f->flowbits_size)
+        flowbits_memuse -= f->flowbits_size;
     else {
         printf("ERROR: flowbits memory usage going below 0!\n");
         flowbits_memuse = 0;
     }
     SCMutexUnlock(&flowbits_mutex);
 #endif /* FLOWBITS_STATS */
+
+    SCFree(f->flowbits);
+    f->flowbits = NULL;
+    f->flowbits_size = 0;
 }
 
 
@@ -191,11 +214,11 @@ static int FlowBitTest01 (void) {
 
     FlowBitAdd(&f, 0);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,0);
+    if (fb == 1)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -205,11 +228,11 @@ static int FlowBitTest02 (void) {
     Flow f;
     memset(&f, 0, sizeof(Flow));
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,0);
+    if (fb == 0)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -221,23 +244,23 @@ static int FlowBitTest03 (void) {
 
     FlowBitAdd(&f, 0);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb == NULL) {
-        printf("fb == NULL although it was just added: ");
+    int fb = FlowBitGet(&f,0);
+    if (fb == 0) {
+        printf("bit not set although it was just added: ");
         goto end;
     }
 
     FlowBitRemove(&f, 0);
 
     fb = FlowBitGet(&f,0);
-    if (fb != NULL) {
-        printf("fb != NULL although it was just removed: ");
+    if (fb == 1) {
+        printf("bit set although it was just removed: ");
         goto end;
     } else {
         ret = 1;
     }
 end:
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -252,11 +275,11 @@ static int FlowBitTest04 (void) {
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,0);
+    if (fb == 1)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -271,11 +294,11 @@ static int FlowBitTest05 (void) {
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,1);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,1);
+    if (fb == 1)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -290,11 +313,11 @@ static int FlowBitTest06 (void) {
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,2);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,2);
+    if (fb == 1)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -309,11 +332,11 @@ static int FlowBitTest07 (void) {
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,3);
-    if (fb != NULL)
+    int fb = FlowBitGet(&f,3);
+    if (fb == 1)
         ret = 1;
 
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -328,21 +351,21 @@ static int FlowBitTest08 (void) {
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,0);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,0);
+    if (fb == 0)
         goto end;
 
     FlowBitRemove(&f,0);
 
     fb = FlowBitGet(&f,0);
-    if (fb != NULL) {
-        printf("fb != NULL even though it was removed: ");
+    if (fb == 1) {
+        printf("bit set even though it was removed: ");
         goto end;
     }
 
     ret = 1;
 end:
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -357,21 +380,21 @@ static int FlowBitTest09 (void) {
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,1);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,1);
+    if (fb == 0)
         goto end;
 
     FlowBitRemove(&f,1);
 
     fb = FlowBitGet(&f,1);
-    if (fb != NULL) {
-        printf("fb != NULL even though it was removed: ");
+    if (fb == 1) {
+        printf("bit set even though it was removed: ");
         goto end;
     }
 
     ret = 1;
 end:
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -386,21 +409,21 @@ static int FlowBitTest10 (void) {
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,2);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,2);
+    if (fb == 0)
         goto end;
 
     FlowBitRemove(&f,2);
 
     fb = FlowBitGet(&f,2);
-    if (fb != NULL) {
-        printf("fb != NULL even though it was removed: ");
+    if (fb == 1) {
+        printf("bit set even though it was removed: ");
         goto end;
     }
 
     ret = 1;
 end:
-    GenericVarFree(f.flowvar);
+    FlowBitsFree(&f);
     return ret;
 }
 
@@ -415,21 +438,87 @@ static int FlowBitTest11 (void) {
     FlowBitAdd(&f, 2);
     FlowBitAdd(&f, 3);
 
-    FlowBit *fb = FlowBitGet(&f,3);
-    if (fb == NULL)
+    int fb = FlowBitGet(&f,3);
+    if (fb == 0)
         goto end;
 
     FlowBitRemove(&f,3);
 
     fb = FlowBitGet(&f,3);
-    if (fb != NULL) {
-        printf("fb != NULL even though it was removed: ");
+    if (fb == 1) {
+        printf("bit set even though it was removed: ");
+        goto end;
+    }
+
+    ret = 1;
+end:
+    FlowBitsFree(&f);
+    return ret;
+}
+
+/** \test bitmap grows for a new, higher idx and keeps the bits already set */
+static int FlowBitTest12 (void) {
+    int ret = 0;
+
+    Flow f;
+    memset(&f, 0, sizeof(Flow));
+
+    FlowBitAdd(&f, 3);
+    uint16_t size = f.flowbits_size;
+    if (size == 0 || FlowBitGet(&f, 3) != 1)
+        goto end;
+
+    /* a reload registered more flowbits */
+    FlowBitAdd(&f, (size * 8) + 10);
+    if (f.flowbits_size <= size) {
+        printf("bitmap didn't grow: ");
+        goto end;
+    }
+
+    if (FlowBitGet(&f, 3) != 1 || FlowBitGet(&f, (size * 8) + 10) != 1) {
+        printf("bit lost on grow: ");
         goto end;
     }
 
+    if (FlowBitGet(&f, (size * 8) + 9) != 0 || FlowBitGet(&f, 60000) != 0) {
+        printf("unexpected bit set: ");
+        goto end;
+    }
+
+    ret = 1;
+end:
+    FlowBitsFree(&f);
+    return ret;
+}
+
+/** \test set, toggle and unset through the locked api */
+static int FlowBitTest13 (void) {
+    int ret = 0;
+
+    Flow f;
+    memset(&f, 0, sizeof(Flow));
+    FLOW_INITIALIZE(&f);
+
+    if (FlowBitIsset(&f, 1) != 0 || FlowBitIsnotset(&f, 1) != 1)
+        goto end;
+    if (f.flowbits != NULL) {
+        printf("bitmap allocated by a read: ");
+        goto end;
+    }
+
+    FlowBitSet(&f, 1);
+    FlowBitToggle(&f, 2);
+    if (FlowBitIsset(&f, 1) != 1 || FlowBitIsset(&f, 2) != 1)
+        goto end;
+
+    FlowBitToggle(&f, 1);
+    FlowBitUnset(&f, 2);
+    if (FlowBitIsnotset(&f, 1) != 1 || FlowBitIsnotset(&f, 2) != 1)
+        goto end;
+
     ret = 1;
 end:
-    GenericVarFree(f.flowvar);
+    FLOW_DESTROY(&f);
     return ret;
 }
 
@@ -448,6 +537,8 @@ void FlowBitRegisterTests(void) {
     UtRegisterTest("FlowBitTest09", FlowBitTest09, 1);
     UtRegisterTest("FlowBitTest10", FlowBitTest10, 1);
     UtRegisterTest("FlowBitTest11", FlowBitTest11, 1);
+    UtRegisterTest("FlowBitTest12", FlowBitTest12, 1);
+    UtRegisterTest("FlowBitTest13", FlowBitTest13, 1);
 #endif /* UNITTESTS */
 }
 
@@ -27,15 +27,9 @@
 #include "flow.h"
 #include "util-var.h"
 
-typedef struct FlowBit_ {
-    uint8_t type; /* type, DETECT_FLOWBITS in this case */
-    GenericVar *next; /* right now just implement this as a list,
-                       * in the long run we have think of something
-                       * faster. */
-    uint16_t idx; /* name idx */
-} FlowBit;
-
-void FlowBitFree(FlowBit *);
+void FlowBitInit(void);
+void FlowBitSetMaxIdx(uint16_t);
+void FlowBitsFree(Flow *);
 void FlowBitRegisterTests(void);
 
 void FlowBitSet(Flow *, uint16_t);
@@ -35,6 +35,7 @@
 #include "flow-util.h"
 #include "flow-private.h"
 #include "flow-manager.h"
+#include "flow-wheel.h"
 #include "app-layer-parser.h"
 
 #include "util-time.h"
@@ -488,6 +489,8 @@ Flow *FlowGetFlowFromHash (Packet *p)
     /* get our hash bucket and lock it */
     FlowBucket *fb = &flow_hash[key];
     FBLOCK_LOCK(fb);
+    /* the row is touched, so the manager's hint is no longer valid */
+    fb->next_ts = 0;
 
     SCLogDebug("fb %p fb->head %p", fb, fb->head);
 
@@ -647,6 +650,7 @@ static Flow *FlowGetUsedFlow(void) {
 
         f->hnext = NULL;
         f->hprev = NULL;
+        FlowWheelRemove(f);
         f->fb = NULL;
         FBLOCK_UNLOCK(fb);
 
@@ -41,6 +41,9 @@
 typedef struct FlowBucket_ {
     Flow *head;
     Flow *tail;
+    /** no flow in this row times out before this second. Reset to 0 on
+     *  every lookup, set by the flow manager when it checked the row. */
+    uint32_t next_ts;
 #ifdef FBLOCK_MUTEX
     SCMutex m;
 #elif defined FBLOCK_SPIN
@@ -41,6 +41,7 @@
 #include "flow-private.h"
 #include "flow-timeout.h"
 #include "flow-manager.h"
+#include "flow-wheel.h"
 
 #include "stream-tcp-private.h"
 #include "stream-tcp-reassemble.h"
@@ -60,9 +61,11 @@
 #include "stream.h"
 
 #include "app-layer-parser.h"
+#include "app-layer-slab.h"
 
 #include "host-timeout.h"
 #include "defrag-timeout.h"
+#include "detect-engine-threshold.h"
 
 /* Run mode selected at suricata.c */
 extern int run_mode;
@@ -81,8 +84,21 @@ typedef struct FlowTimeoutCounters_ {
     uint32_t new;
     uint32_t est;
     uint32_t clo;
+    uint32_t byp;
+
+    uint32_t rows_checked;
+    uint32_t rows_skipped;
+    uint32_t flows_checked;
 } FlowTimeoutCounters;
 
+/** flow manager threads by instance, the instance selects the hash slice
+ *  of a manager. Set before the thread is spawned. */
+static ThreadVars *flowmgr_tv[FLOW_MAX_MANAGERS];
+/** thread names, tv->name is not copied */
+static char flowmgr_names[FLOW_MAX_MANAGERS][32];
+
+#define FLOW_MANAGER_THREAD_NAME "FlowManagerThread"
+
 /**
  * \brief Used to kill flow manager thread(s).
  *
@@ -94,7 +110,7 @@ void FlowKillFlowManagerThread(void)
     ThreadVars *tv = NULL;
     int cnt = 0;
 
-    SCCtrlCondSignal(&flow_manager_ctrl_cond);
+    SCCtrlCondBroadcast(&flow_manager_ctrl_cond);
 
     SCMutexLock(&tv_root_lock);
 
@@ -102,7 +118,8 @@ void FlowKillFlowManagerThread(void)
     tv = tv_root[TVT_MGMT];
 
     while (tv != NULL) {
-        if (strcasecmp(tv->name, "FlowManagerThread") == 0) {
+        if (strncasecmp(tv->name, FLOW_MANAGER_THREAD_NAME,
+                    strlen(FLOW_MANAGER_THREAD_NAME)) == 0) {
             TmThreadsSetFlag(tv, THV_KILL);
             TmThreadsSetFlag(tv, THV_DEINIT);
 
@@ -125,67 +142,6 @@ void FlowKillFlowManagerThread(void)
     return;
 }
 
-/** \internal
- *  \brief Get the flow's state
- *
- *  \param f flow
- *
- *  \retval state either FLOW_STATE_NEW, FLOW_STATE_ESTABLISHED or FLOW_STATE_CLOSED
- */
-static inline int FlowGetFlowState(Flow *f) {
-    if (flow_proto[f->protomap].GetProtoState != NULL) {
-        return flow_proto[f->protomap].GetProtoState(f->protoctx);
-    } else {
-        if ((f->flags & FLOW_TO_SRC_SEEN) && (f->flags & FLOW_TO_DST_SEEN))
-            return FLOW_STATE_ESTABLISHED;
-        else
-            return FLOW_STATE_NEW;
-    }
-}
-
-/** \internal
- *  \brief get timeout for flow
- *
- *  \param f flow
- *  \param state flow state
- *  \param emergency bool indicating emergency mode 1 yes, 0 no
- *
- *  \retval timeout timeout in seconds
- */
-static inline uint32_t FlowGetFlowTimeout(Flow *f, int state, int emergency) {
-    uint32_t timeout;
-
-    if (emergency) {
-        switch(state) {
-            default:
-            case FLOW_STATE_NEW:
-                timeout = flow_proto[f->protomap].emerg_new_timeout;
-                break;
-            case FLOW_STATE_ESTABLISHED:
-                timeout = flow_proto[f->protomap].emerg_est_timeout;
-                break;
-            case FLOW_STATE_CLOSED:
-                timeout = flow_proto[f->protomap].emerg_closed_timeout;
-                break;
-        }
-    } else { /* implies no emergency */
-        switch(state) {
-            default:
-            case FLOW_STATE_NEW:
-                timeout = flow_proto[f->protomap].new_timeout;
-                break;
-            case FLOW_STATE_ESTABLISHED:
-                timeout = flow_proto[f->protomap].est_timeout;
-                break;
-            case FLOW_STATE_CLOSED:
-                timeout = flow_proto[f->protomap].closed_timeout;
-                break;
-        }
-    }
-
-    return timeout;
-}
-
 /** \internal
  *  \brief check if a flow is timed out
  *
@@ -227,6 +183,11 @@ static int FlowManagerFlowTimedOut(Flow *f, struct timeval *ts) {
         return 0;
     }
 
+    /* a bypassed flow has nothing left to inspect */
+    if (f->bypass_flags & FLOW_BYPASS_LOCAL) {
+        return 1;
+    }
+
     int server = 0, client = 0;
     if (FlowForceReassemblyNeedReassmbly(f, &server, &client) == 1) {
         FlowForceReassemblyForFlowV2(f, server, client);
@@ -240,6 +201,58 @@ static int FlowManagerFlowTimedOut(Flow *f, struct timeval *ts) {
     return 1;
 }
 
+/** \internal
+ *  \brief remove a timed out flow from the hash and the wheel and move it
+ *         to the spare queue
+ *
+ *  \param f *LOCKED* flow, unlocked on return. Its bucket is *LOCKED*.
+ *  \param state flow state, for the counters
+ *  \param counters ptr to FlowTimeoutCounters structure
+ */
+static void FlowManagerFlowRemove(Flow *f, int state,
+        FlowTimeoutCounters *counters)
+{
+    /* remove from the hash */
+    if (f->hprev != NULL)
+        f->hprev->hnext = f->hnext;
+    if (f->hnext != NULL)
+        f->hnext->hprev = f->hprev;
+    if (f->fb->head == f)
+        f->fb->head = f->hnext;
+    if (f->fb->tail == f)
+        f->fb->tail = f->hprev;
+
+    f->hnext = NULL;
+    f->hprev = NULL;
+
+    FlowWheelRemove(f);
+
+    FlowClearMemory (f, f->protomap);
+
+    /* no one is referring to this flow, use_cnt 0, removed from hash
+     * so we can unlock it and move it back to the spare queue. */
+    FLOWLOCK_UNLOCK(f);
+
+    /* move to spare list */
+    FlowMoveToSpare(f);
+
+    switch (state) {
+        case FLOW_STATE_NEW:
+        default:
+            counters->new++;
+            break;
+        case FLOW_STATE_ESTABLISHED:
+            counters->est++;
+            break;
+        case FLOW_STATE_CLOSED:
+            counters->clo++;
+            break;
+        case FLOW_STATE_BYPASSED:
+            counters->byp++;
+            break;
+    }
+}
+
 /**
  *  \internal
  *
@@ -249,16 +262,22 @@ static int FlowManagerFlowTimedOut(Flow *f, struct timeval *ts) {
  *  \param ts timestamp
  *  \param emergency bool indicating emergency mode
  *  \param counters ptr to FlowTimeoutCounters structure
+ *  \param next_ts[out] second before which none of the remaining flows
+ *                      can time out, 0 if the row needs checking next time
  *
  *  \retval cnt timed out flows
  */
 static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
-        int emergency, FlowTimeoutCounters *counters)
+        int emergency, FlowTimeoutCounters *counters, uint32_t *next_ts)
 {
     uint32_t cnt = 0;
+    uint32_t row_ts = UINT32_MAX;
 
     do {
+        counters->flows_checked++;
+
         if (FLOWLOCK_TRYWRLOCK(f) != 0) {
+            row_ts = 0;
             f = f->hprev;
             continue;
         }
@@ -269,6 +288,16 @@ static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
 
         /* timeout logic goes here */
         if (FlowManagerFlowTimeout(f, state, ts, emergency) == 0) {
+            /* a flow in use by a packet may still change state, so
+             * only trust the timeout of idle flows */
+            if (SC_ATOMIC_GET(f->use_cnt) > 0) {
+                row_ts = 0;
+            } else {
+                uint32_t flow_ts = f->lastts_sec +
+                    FlowGetFlowTimeout(f, state, emergency) + 1;
+                if (flow_ts < row_ts)
+                    row_ts = flow_ts;
+            }
             FLOWLOCK_UNLOCK(f);
             f = f->hprev;
             continue;
@@ -277,62 +306,39 @@ static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
         /* check if the flow is fully timed out and
          * ready to be discarded. */
         if (FlowManagerFlowTimedOut(f, ts) == 1) {
-            /* remove from the hash */
-            if (f->hprev != NULL)
-                f->hprev->hnext = f->hnext;
-            if (f->hnext != NULL)
-                f->hnext->hprev = f->hprev;
-            if (f->fb->head == f)
-                f->fb->head = f->hnext;
-            if (f->fb->tail == f)
-                f->fb->tail = f->hprev;
-
-            f->hnext = NULL;
-            f->hprev = NULL;
-
-            FlowClearMemory (f, f->protomap);
-
-            /* no one is referring to this flow, use_cnt 0, removed from hash
-             * so we can unlock it and move it back to the spare queue. */
-            FLOWLOCK_UNLOCK(f);
-
-            /* move to spare list */
-            FlowMoveToSpare(f);
-
+            FlowManagerFlowRemove(f, state, counters);
             cnt++;
-
-            switch (state) {
-                case FLOW_STATE_NEW:
-                default:
-                    counters->new++;
-                    break;
-                case FLOW_STATE_ESTABLISHED:
-                    counters->est++;
-                    break;
-                case FLOW_STATE_CLOSED:
-                    counters->clo++;
-                    break;
-            }
         } else {
+            /* timed out but still referenced or awaiting reassembly */
+            row_ts = 0;
             FLOWLOCK_UNLOCK(f);
         }
 
         f = next_flow;
     } while (f != NULL);
 
+    *next_ts = row_ts;
     return cnt;
 }
 
 /**
  *  \brief time out flows from the hash
  *
+ *  Rows of which the next_ts hint lies in the future are skipped, except
+ *  in emergency mode where the timeouts are shorter than the ones the
+ *  hints were computed with.
+ *
  *  \param ts timestamp
  *  \param try_cnt number of flows to time out max (0 is unlimited)
+ *  \param hash_min first hash row to check
+ *  \param hash_max hash row to stop at (not checked)
  *  \param counters ptr to FlowTimeoutCounters structure
  *
  *  \retval cnt number of timed out flow
  */
-uint32_t FlowTimeoutHash(struct timeval *ts, uint32_t try_cnt, FlowTimeoutCounters *counters) {
+uint32_t FlowTimeoutHash(struct timeval *ts, uint32_t try_cnt,
+        uint32_t hash_min, uint32_t hash_max, FlowTimeoutCounters *counters)
+{
     uint32_t idx = 0;
     uint32_t cnt = 0;
     int emergency = 0;
@@ -340,19 +346,29 @@ uint32_t FlowTimeoutHash(struct timeval *ts, uint32_t try_cnt, FlowTimeoutCounte
     if (SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY)
         emergency = 1;
 
-    for (idx = 0; idx < flow_config.hash_size; idx++) {
+    for (idx = hash_min; idx < hash_max; idx++) {
         FlowBucket *fb = &flow_hash[idx];
 
+        /* unlocked peek, a stale value only costs us a check or a pass */
+        if (emergency == 0 && fb->next_ts > (uint32_t)ts->tv_sec) {
+            counters->rows_skipped++;
+            continue;
+        }
+
         if (FBLOCK_TRYLOCK(fb) != 0)
             continue;
 
         /* flow hash bucket is now locked */
+        counters->rows_checked++;
 
-        if (fb->tail == NULL)
+        if (fb->tail == NULL) {
+            fb->next_ts = UINT32_MAX;
             goto next;
+        }
 
         /* we have a flow, or more than one */
-        cnt += FlowManagerHashRowTimeout(fb->tail, ts, emergency, counters);
+        cnt += FlowManagerHashRowTimeout(fb->tail, ts, emergency, counters,
+                &fb->next_ts);
 
 next:
         FBLOCK_UNLOCK(fb);
@@ -364,6 +380,93 @@ next:
     return cnt;
 }
 
+/**
+ *  \brief time out the flows of a wheel that expire up to ts
+ *
+ *  Flows that got packets since they were scheduled are put back at their
+ *  new expiry. Flows we can't lock or that are still in use are retried
+ *  in the next second.
+ *
+ *  \param w wheel
+ *  \param ts timestamp
+ *  \param counters ptr to FlowTimeoutCounters structure
+ *
+ *  \retval cnt number of timed out flows
+ */
+uint32_t FlowTimeoutWheel(FlowWheel *w, struct timeval *ts,
+        FlowTimeoutCounters *counters)
+{
+    uint32_t cnt = 0;
+    int slot;
+
+    FWLOCK_LOCK(w);
+    while ((slot = FlowWheelAdvanceLocked(w, (uint32_t)ts->tv_sec)) >= 0) {
+        Flow *f;
+
+        while ((f = w->slots[slot]) != NULL) {
+            FlowWheelUnlinkLocked(w, f);
+            counters->flows_checked++;
+
+            /* wheel is locked, so we can only try the bucket and flow */
+            FlowBucket *fb = f->fb;
+            if (FBLOCK_TRYLOCK(fb) != 0) {
+                FlowWheelRetryLocked(w, f);
+                continue;
+            }
+            if (FLOWLOCK_TRYWRLOCK(f) != 0) {
+                FBLOCK_UNLOCK(fb);
+                FlowWheelRetryLocked(w, f);
+                continue;
+            }
+            f->wheel_ts = 0;
+            FWLOCK_UNLOCK(w);
+
+            int state = FlowGetFlowState(f);
+            if (FlowManagerFlowTimeout(f, state, ts, 0) == 0) {
+                /* had packets since, schedule at its real expiry */
+                uint32_t expire = (uint32_t)f->lastts_sec +
+                    FlowGetFlowTimeout(f, state, 0) + 1;
+                FWLOCK_LOCK(w);
+                FlowWheelInsertLocked(w, f, expire);
+                FWLOCK_UNLOCK(w);
+                FLOWLOCK_UNLOCK(f);
+            } else if (FlowManagerFlowTimedOut(f, ts) == 1) {
+                FlowManagerFlowRemove(f, state, counters);
+                cnt++;
+            } else {
+                /* still referenced or awaiting reassembly */
+                FWLOCK_LOCK(w);
+                FlowWheelInsertLocked(w, f, w->cur + 1);
+                FWLOCK_UNLOCK(w);
+                FLOWLOCK_UNLOCK(f);
+            }
+            FBLOCK_UNLOCK(fb);
+
+            FWLOCK_LOCK(w);
+        }
+    }
+    FWLOCK_UNLOCK(w);
+
+    return cnt;
+}
+
+/** \internal
+ *  \brief get the instance of a flow manager thread
+ *
+ *  The instance is the spawn index, so the slice a manager owns matches
+ *  the number in its thread name.
+ */
+static uint16_t FlowManagerInstance(ThreadVars *th_v)
+{
+    uint16_t i;
+    for (i = 0; i < flow_config.managers; i++) {
+        if (flowmgr_tv[i] == th_v)
+            return i;
+    }
+    BUG_ON(1);
+    return 0;
+}
+
 /** \brief Thread that manages the flow table and times out flows.
  *
  *  \param td ThreadVars casted to void ptr
@@ -377,6 +480,7 @@ void *FlowManagerThread(void *td)
 
     ThreadVars *th_v = (ThreadVars *)td;
     struct timeval ts;
+    struct timeval pass_start, pass_end;
     uint32_t established_cnt = 0, new_cnt = 0, closing_cnt = 0;
     int emerg = FALSE;
     int prev_emerg = FALSE;
@@ -405,6 +509,9 @@ void *FlowManagerThread(void *td)
     uint16_t flow_mgr_cnt_est = SCPerfTVRegisterCounter("flow_mgr.est_pruned", th_v,
             SC_PERF_TYPE_UINT64,
             "NULL");
+    uint16_t flow_mgr_cnt_byp = SCPerfTVRegisterCounter("flow_mgr.bypassed_pruned", th_v,
+            SC_PERF_TYPE_UINT64,
+            "NULL");
     uint16_t flow_mgr_memuse = SCPerfTVRegisterCounter("flow.memuse", th_v,
             SC_PERF_TYPE_Q_NORMAL,
             "NULL");
@@ -417,6 +524,38 @@ void *FlowManagerThread(void *td)
     uint16_t flow_emerg_mode_over = SCPerfTVRegisterCounter("flow.emerg_mode_over", th_v,
             SC_PERF_TYPE_UINT64,
             "NULL");
+    uint16_t threshold_entries = SCPerfTVRegisterCounter("threshold.entries", th_v,
+            SC_PERF_TYPE_Q_NORMAL,
+            "NULL");
+    uint16_t threshold_lookups = SCPerfTVRegisterCounter("threshold.lookups", th_v,
+            SC_PERF_TYPE_Q_NORMAL,
+            "NULL");
+    uint16_t threshold_evictions = SCPerfTVRegisterCounter("threshold.evictions", th_v,
+            SC_PERF_TYPE_Q_NORMAL,
+            "NULL");
+    uint16_t threshold_memuse = SCPerfTVRegisterCounter("threshold.memuse", th_v,
+            SC_PERF_TYPE_Q_NORMAL,
+            "NULL");
+    uint16_t flow_mgr_rows_checked = SCPerfTVRegisterCounter("flow_mgr.rows_checked", th_v,
+            SC_PERF_TYPE_UINT64,
+            "NULL");
+    uint16_t flow_mgr_rows_skipped = SCPerfTVRegisterCounter("flow_mgr.rows_skipped", th_v,
+            SC_PERF_TYPE_UINT64,
+            "NULL");
+    uint16_t flow_mgr_flows_checked = SCPerfTVRegisterCounter("flow_mgr.flows_checked", th_v,
+            SC_PERF_TYPE_UINT64,
+            "NULL");
+    uint16_t flow_mgr_pass_usecs = SCPerfTVRegisterHistogramCounter("flow_mgr.pass_usecs", th_v,
+            "NULL");
+
+    /* each manager owns a slice of the hash, the last one takes the
+     * remainder. Only the first manager does the global house keeping. */
+    uint16_t instance = FlowManagerInstance(th_v);
+    uint32_t slice = flow_config.hash_size / flow_config.managers;
+    uint32_t hash_min = instance * slice;
+    uint32_t hash_max = (instance == flow_config.managers - 1) ?
+        flow_config.hash_size : hash_min + slice;
+    uint32_t hash_pos = hash_min;
 
     if (th_v->thread_setup_flags != 0)
         TmThreadSetupOptions(th_v);
@@ -433,7 +572,10 @@ void *FlowManagerThread(void *td)
     }
 
     th_v->sc_perf_pca = SCPerfGetAllCountersArray(&th_v->sc_perf_pctx);
-    SCPerfAddToClubbedTMTable(th_v->name, &th_v->sc_perf_pctx);
+    SCPerfAddToClubbedTMTable(FLOW_MANAGER_THREAD_NAME, &th_v->sc_perf_pctx);
+
+    SCLogDebug("%s: hash rows %"PRIu32"-%"PRIu32, th_v->name, hash_min,
+            hash_max);
 
     /* Set the threads capability */
     th_v->cap_flags = 0;
@@ -458,7 +600,8 @@ void *FlowManagerThread(void *td)
 
                 SCLogDebug("Flow emergency mode entered...");
 
-                SCPerfCounterIncr(flow_emerg_mode_enter, th_v->sc_perf_pca);
+                if (instance == 0)
+                    SCPerfCounterIncr(flow_emerg_mode_enter, th_v->sc_perf_pca);
             }
         }
 
@@ -473,16 +616,70 @@ void *FlowManagerThread(void *td)
         }
 
         /* see if we still have enough spare flows */
-        FlowUpdateSpareFlows();
+        if (instance == 0)
+            FlowUpdateSpareFlows();
+
+        /* try to time out flows. The timing wheel only hands us the
+         * expiring flows. In emergency mode the timeouts are shorter than
+         * the ones the wheel was scheduled with, so we sweep the whole
+         * slice. Without the wheel we continue where the last pass
+         * stopped. */
+        FlowTimeoutCounters counters = { 0, 0, 0, 0, 0, 0, 0, };
+        int use_wheel = (flow_wheels != NULL && emerg == FALSE);
+        uint32_t rows = flow_config.rows_per_pass;
+        if (use_wheel) {
+            rows = 0;
+        } else if (emerg == TRUE || rows == 0 || rows >= hash_max - hash_min) {
+            hash_pos = hash_min;
+            rows = hash_max - hash_min;
+        }
 
-        /* try to time out flows */
-        FlowTimeoutCounters counters = { 0, 0, 0, };
-        FlowTimeoutHash(&ts, 0 /* check all */, &counters);
+        gettimeofday(&pass_start, NULL);
+        if (use_wheel)
+            FlowTimeoutWheel(&flow_wheels[instance], &ts, &counters);
+        while (rows > 0) {
+            uint32_t end = hash_pos + rows;
+            if (end > hash_max)
+                end = hash_max;
 
+            FlowTimeoutHash(&ts, 0 /* check all */, hash_pos, end, &counters);
+
+            rows -= (end - hash_pos);
+            hash_pos = (end == hash_max) ? hash_min : end;
+        }
+        gettimeofday(&pass_end, NULL);
+
+        SCPerfCounterAddUI64(flow_mgr_rows_checked, th_v->sc_perf_pca,
+                (uint64_t)counters.rows_checked);
+        SCPerfCounterAddUI64(flow_mgr_rows_skipped, th_v->sc_perf_pca,
+                (uint64_t)counters.rows_skipped);
+        SCPerfCounterAddUI64(flow_mgr_flows_checked, th_v->sc_perf_pca,
+                (uint64_t)counters.flows_checked);
+        SCPerfCounterRecordHistogram(flow_mgr_pass_usecs, th_v->sc_perf_pca,
+                (uint64_t)((pass_end.tv_sec - pass_start.tv_sec) * 1000000 +
+                (pass_end.tv_usec - pass_start.tv_usec)));
+        SCPerfCounterAddUI64(flow_mgr_cnt_clo, th_v->sc_perf_pca, (uint64_t)counters.clo);
+        SCPerfCounterAddUI64(flow_mgr_cnt_new, th_v->sc_perf_pca, (uint64_t)counters.new);
+        SCPerfCounterAddUI64(flow_mgr_cnt_est, th_v->sc_perf_pca, (uint64_t)counters.est);
+        SCPerfCounterAddUI64(flow_mgr_cnt_byp, th_v->sc_perf_pca, (uint64_t)counters.byp);
+
+        if (instance != 0) {
+            if (SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY) {
+                flow_update_delay_sec = FLOW_EMERG_MODE_UPDATE_DELAY_SEC;
+                flow_update_delay_nsec = FLOW_EMERG_MODE_UPDATE_DELAY_NSEC;
+            } else {
+                emerg = FALSE;
+                prev_emerg = FALSE;
+                flow_update_delay_sec = FLOW_NORMAL_MODE_UPDATE_DELAY_SEC;
+                flow_update_delay_nsec = FLOW_NORMAL_MODE_UPDATE_DELAY_NSEC;
+            }
+            goto wait;
+        }
 
         DefragTimeoutHash(&ts);
         //uint32_t hosts_pruned =
         HostTimeoutHash(&ts);
+        ThresholdTimeoutHash(&ts);
 /*
         SCPerfCounterAddUI64(flow_mgr_host_prune, th_v->sc_perf_pca, (uint64_t)hosts_pruned);
         uint32_t hosts_active = HostGetActiveCount();
@@ -490,9 +687,6 @@ void *FlowManagerThread(void *td)
         uint32_t hosts_spare = HostGetSpareCount();
         SCPerfCounterSetUI64(flow_mgr_host_spare, th_v->sc_perf_pca, (uint64_t)hosts_spare);
 */
-        SCPerfCounterAddUI64(flow_mgr_cnt_clo, th_v->sc_perf_pca, (uint64_t)counters.clo);
-        SCPerfCounterAddUI64(flow_mgr_cnt_new, th_v->sc_perf_pca, (uint64_t)counters.new);
-        SCPerfCounterAddUI64(flow_mgr_cnt_est, th_v->sc_perf_pca, (uint64_t)counters.est);
         long long unsigned int flow_memuse = SC_ATOMIC_GET(flow_memuse);
         SCPerfCounterSetUI64(flow_mgr_memuse, th_v->sc_perf_pca, (uint64_t)flow_memuse);
 
@@ -502,6 +696,13 @@ void *FlowManagerThread(void *td)
         FQLOCK_UNLOCK(&flow_spare_q);
         SCPerfCounterSetUI64(flow_mgr_spare, th_v->sc_perf_pca, (uint64_t)len);
 
+        ThresholdStats th_stats;
+        ThresholdGetStats(&th_stats);
+        SCPerfCounterSetUI64(threshold_entries, th_v->sc_perf_pca, th_stats.entries);
+        SCPerfCounterSetUI64(threshold_lookups, th_v->sc_perf_pca, th_stats.lookups);
+        SCPerfCounterSetUI64(threshold_evictions, th_v->sc_perf_pca, th_stats.evictions);
+        SCPerfCounterSetUI64(threshold_memuse, th_v->sc_perf_pca, th_stats.memuse);
+
         /* Don't fear, FlowManagerThread is here...
          * clear emergency bit if we have at least xx flows pruned. */
         if (emerg == TRUE) {
@@ -531,6 +732,7 @@ void *FlowManagerThread(void *td)
             }
         }
 
+wait:
         if (TmThreadsCheckFlag(th_v, THV_KILL)) {
             SCPerfSyncCounters(th_v, 0);
             break;
@@ -557,31 +759,48 @@ void *FlowManagerThread(void *td)
               "timed out, %"PRIu32" flows in closed state", new_cnt,
               established_cnt, closing_cnt);
 
+    /* states of timed out flows are freed by this thread */
+    AppLayerSlabThreadCleanup();
+
     TmThreadsSetFlag(th_v, THV_CLOSED);
     pthread_exit((void *) 0);
     return NULL;
 }
 
-/** \brief spawn the flow manager thread */
+/** \brief spawn the flow manager thread(s), flow.managers in the config */
 void FlowManagerThreadSpawn()
 {
     ThreadVars *tv_flowmgr = NULL;
+    uint16_t i;
 
     SCCtrlCondInit(&flow_manager_ctrl_cond, NULL);
     SCCtrlMutexInit(&flow_manager_ctrl_mutex, NULL);
 
-    tv_flowmgr = TmThreadCreateMgmtThread("FlowManagerThread",
-                                          FlowManagerThread, 0);
+    memset(flowmgr_tv, 0x00, sizeof(flowmgr_tv));
 
-    TmThreadSetCPU(tv_flowmgr, MANAGEMENT_CPU_SET);
+    for (i = 0; i < flow_config.managers; i++) {
+        if (i == 0) {
+            strlcpy(flowmgr_names[i], FLOW_MANAGER_THREAD_NAME,
+                    sizeof(flowmgr_names[i]));
+        } else {
+            snprintf(flowmgr_names[i], sizeof(flowmgr_names[i]), "%s%02"PRIu16,
+                    FLOW_MANAGER_THREAD_NAME, i);
+        }
 
-    if (tv_flowmgr == NULL) {
-        printf("ERROR: TmThreadsCreate failed\n");
-        exit(1);
-    }
-    if (TmThreadSpawn(tv_flowmgr) != TM_ECODE_OK) {
-        printf("ERROR: TmThreadSpawn failed\n");
-        exit(1);
+        tv_flowmgr = TmThreadCreateMgmtThread(flowmgr_names[i],
+                FlowManagerThread, 0);
+
+        if (tv_flowmgr == NULL) {
+            printf("ERROR: TmThreadsCreate failed\n");
+            exit(1);
+        }
+        TmThreadSetCPU(tv_flowmgr, MANAGEMENT_CPU_SET);
+        flowmgr_tv[i] = tv_flowmgr;
+
+        if (TmThreadSpawn(tv_flowmgr) != TM_ECODE_OK) {
+            printf("ERROR: TmThreadSpawn failed\n");
+            exit(1);
+        }
     }
 
     return;
@@ -837,7 +1056,7 @@ static int FlowMgrTest05 (void) {
     TimeGet(&ts);
     /* try to time out flows */
     FlowTimeoutCounters counters = { 0, 0, 0, };
-    FlowTimeoutHash(&ts, 0 /* check all */, &counters);
+    FlowTimeoutHash(&ts, 0 /* check all */, 0, flow_config.hash_size, &counters);
 
     if (flow_spare_q.len > 0) {
         result = 1;
@@ -848,6 +1067,112 @@ static int FlowMgrTest05 (void) {
 
     return result;
 }
+
+/**
+ *  \test  Test that a second pass skips the rows that were checked in
+ *         the first one, except in emergency mode.
+ *
+ *  \retval On success it returns 1 and on failure 0.
+ */
+static int FlowMgrTest06 (void) {
+    int result = 0;
+    struct timeval ts;
+
+    FlowInitConfig(FLOW_QUIET);
+
+    UTHBuildPacketOfFlows(0, 100, 0);
+    TimeGet(&ts);
+
+    FlowTimeoutCounters counters = { 0, 0, 0, 0, 0, 0, 0, };
+    FlowTimeoutHash(&ts, 0, 0, flow_config.hash_size, &counters);
+    if (counters.rows_checked != flow_config.hash_size ||
+        counters.rows_skipped != 0) {
+        printf("first pass: checked %u skipped %u: ",
+                counters.rows_checked, counters.rows_skipped);
+        goto end;
+    }
+
+    memset(&counters, 0, sizeof(counters));
+    FlowTimeoutHash(&ts, 0, 0, flow_config.hash_size, &counters);
+    if (counters.rows_checked != 0 ||
+        counters.rows_skipped != flow_config.hash_size) {
+        printf("second pass: checked %u skipped %u: ",
+                counters.rows_checked, counters.rows_skipped);
+        goto end;
+    }
+
+    /* a lookup invalidates the hint of its row */
+    UTHBuildPacketOfFlows(0, 1, 0);
+    memset(&counters, 0, sizeof(counters));
+    FlowTimeoutHash(&ts, 0, 0, flow_config.hash_size, &counters);
+    if (counters.rows_checked != 1) {
+        printf("third pass: checked %u: ", counters.rows_checked);
+        goto end;
+    }
+
+    SC_ATOMIC_OR(flow_flags, FLOW_EMERGENCY);
+    memset(&counters, 0, sizeof(counters));
+    FlowTimeoutHash(&ts, 0, 0, flow_config.hash_size, &counters);
+    SC_ATOMIC_AND(flow_flags, ~FLOW_EMERGENCY);
+    if (counters.rows_checked != flow_config.hash_size) {
+        printf("emergency pass: checked %u: ", counters.rows_checked);
+        goto end;
+    }
+
+    result = 1;
+end:
+    FlowShutdown();
+    return result;
+}
+
+/**
+ *  \test  Test that the timing wheel times out the flows once they
+ *         expire, visiting only those flows.
+ *
+ *  \retval On success it returns 1 and on failure 0.
+ */
+static int FlowMgrTest07 (void) {
+    int result = 0;
+    struct timeval ts;
+
+    FlowInitConfig(FLOW_QUIET);
+    if (flow_wheels == NULL) {
+        printf("no wheels: ");
+        goto end;
+    }
+
+    uint32_t spare = flow_spare_q.len;
+    UTHBuildPacketOfFlows(0, 100, 0);
+    if (flow_wheels[0].cnt != 100) {
+        printf("wheel has %u flows, expected 100: ", flow_wheels[0].cnt);
+        goto end;
+    }
+
+    /* nothing expires in the second of the packets */
+    memset(&ts, 0, sizeof(ts));
+    ts.tv_sec = flow_wheels[0].cur + 1;
+    FlowTimeoutCounters counters = { 0, 0, 0, 0, 0, 0, 0, };
+    if (FlowTimeoutWheel(&flow_wheels[0], &ts, &counters) != 0 ||
+        counters.flows_checked != 0) {
+        printf("flows expired early, checked %u: ", counters.flows_checked);
+        goto end;
+    }
+
+    ts.tv_sec += 4000;
+    memset(&counters, 0, sizeof(counters));
+    uint32_t cnt = FlowTimeoutWheel(&flow_wheels[0], &ts, &counters);
+    if (cnt != 100 || counters.flows_checked != 100 ||
+        flow_wheels[0].cnt != 0 || flow_spare_q.len != spare) {
+        printf("timed out %u, checked %u, left %u: ", cnt,
+                counters.flows_checked, flow_wheels[0].cnt);
+        goto end;
+    }
+
+    result = 1;
+end:
+    FlowShutdown();
+    return result;
+}
 #endif /* UNITTESTS */
 
 /**
@@ -860,5 +1185,7 @@ void FlowMgrRegisterTests (void) {
     UtRegisterTest("FlowMgrTest03 -- Timeout a flow in emergency having fresh TcpSession", FlowMgrTest03, 1);
     UtRegisterTest("FlowMgrTest04 -- Timeout a flow in emergency having TcpSession with segments", FlowMgrTest04, 1);
     UtRegisterTest("FlowMgrTest05 -- Test flow Allocations when it reach memcap", FlowMgrTest05, 1);
+    UtRegisterTest("FlowMgrTest06 -- Test skipping of rows by their timeout hint", FlowMgrTest06, 1);
+    UtRegisterTest("FlowMgrTest07 -- Test timing out flows from the timing wheel", FlowMgrTest07, 1);
 #endif /* UNITTESTS */
 }
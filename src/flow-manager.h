@@ -27,7 +27,7 @@
 /** flow manager scheduling condition */
 SCCtrlCondT flow_manager_ctrl_cond;
 SCCtrlMutex flow_manager_ctrl_mutex;
-#define FlowWakeupFlowManagerThread() SCCtrlCondSignal(&flow_manager_ctrl_cond)
+#define FlowWakeupFlowManagerThread() SCCtrlCondBroadcast(&flow_manager_ctrl_cond)
 
 void FlowManagerThreadSpawn(void);
 void FlowKillFlowManagerThread(void);
@@ -57,6 +57,9 @@
 #define FLOW_IPPROTO_ICMP_EMERG_NEW_TIMEOUT 10
 #define FLOW_IPPROTO_ICMP_EMERG_EST_TIMEOUT 100
 
+#define FLOW_DEFAULT_BYPASSED_TIMEOUT 100
+#define FLOW_DEFAULT_EMERG_BYPASSED_TIMEOUT 50
+
 enum {
     FLOW_PROTO_DEFAULT = 0,
     FLOW_PROTO_TCP,
@@ -84,6 +87,76 @@ FlowConfig flow_config;
 /** flow memuse counter (atomic), for enforcing memcap limit */
 SC_ATOMIC_DECLARE(long long unsigned int, flow_memuse);
 
+/** \internal
+ *  \brief Get the flow's state
+ *
+ *  \param f flow
+ *
+ *  \retval state either FLOW_STATE_NEW, FLOW_STATE_ESTABLISHED,
+ *                FLOW_STATE_CLOSED or FLOW_STATE_BYPASSED
+ */
+static inline int FlowGetFlowState(Flow *f) {
+    if (f->bypass_flags & FLOW_BYPASS_LOCAL)
+        return FLOW_STATE_BYPASSED;
+    if (flow_proto[f->protomap].GetProtoState != NULL) {
+        return flow_proto[f->protomap].GetProtoState(f->protoctx);
+    } else {
+        if ((f->flags & FLOW_TO_SRC_SEEN) && (f->flags & FLOW_TO_DST_SEEN))
+            return FLOW_STATE_ESTABLISHED;
+        else
+            return FLOW_STATE_NEW;
+    }
+}
+
+/** \internal
+ *  \brief get timeout for flow
+ *
+ *  \param f flow
+ *  \param state flow state
+ *  \param emergency bool indicating emergency mode 1 yes, 0 no
+ *
+ *  \retval timeout timeout in seconds
+ */
+static inline uint32_t FlowGetFlowTimeout(Flow *f, int state, int emergency) {
+    uint32_t timeout;
+
+    if (emergency) {
+        switch(state) {
+            default:
+            case FLOW_STATE_NEW:
+                timeout = flow_proto[f->protomap].emerg_new_timeout;
+                break;
+            case FLOW_STATE_ESTABLISHED:
+                timeout = flow_proto[f->protomap].emerg_est_timeout;
+                break;
+            case FLOW_STATE_CLOSED:
+                timeout = flow_proto[f->protomap].emerg_closed_timeout;
+                break;
+            case FLOW_STATE_BYPASSED:
+                timeout = flow_proto[f->protomap].emerg_bypassed_timeout;
+                break;
+        }
+    } else { /* implies no emergency */
+        switch(state) {
+            default:
+            case FLOW_STATE_NEW:
+                timeout = flow_proto[f->protomap].new_timeout;
+                break;
+            case FLOW_STATE_ESTABLISHED:
+                timeout = flow_proto[f->protomap].est_timeout;
+                break;
+            case FLOW_STATE_CLOSED:
+                timeout = flow_proto[f->protomap].closed_timeout;
+                break;
+            case FLOW_STATE_BYPASSED:
+                timeout = flow_proto[f->protomap].bypassed_timeout;
+                break;
+        }
+    }
+
+    return timeout;
+}
+
 //#define FLOWBITS_STATS
 #ifdef FLOWBITS_STATS
 uint64_t flowbits_memuse;
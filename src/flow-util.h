@@ -26,6 +26,7 @@
 
 #include "detect-engine-state.h"
 #include "tmqh-flow.h"
+#include "flow-bit.h"
 
 #define COPY_TIMESTAMP(src,dst) ((dst)->tv_sec = (src)->tv_sec, (dst)->tv_usec = (src)->tv_usec)
 
@@ -45,10 +46,16 @@
         SC_ATOMIC_INIT((f)->use_cnt); \
         (f)->probing_parser_toserver_al_proto_masks = 0; \
         (f)->probing_parser_toclient_al_proto_masks = 0; \
+        (f)->alproto_pm_pending[0] = 0; \
+        (f)->alproto_pm_pending[1] = 0; \
+        (f)->alproto_pm_searched[0] = 0; \
+        (f)->alproto_pm_searched[1] = 0; \
         (f)->flags = 0; \
         (f)->lastts_sec = 0; \
         FLOWLOCK_INIT((f)); \
         (f)->protoctx = NULL; \
+        (f)->alp_cache_flags = 0; \
+        (f)->bypass_flags = 0; \
         (f)->alproto = 0; \
         (f)->alproto_ts = 0; \
         (f)->alproto_tc = 0; \
@@ -61,9 +68,15 @@
         (f)->sgh_toserver = NULL; \
         (f)->sgh_toclient = NULL; \
         (f)->flowvar = NULL; \
+        (f)->flowbits = NULL; \
+        (f)->flowbits_size = 0; \
         SCMutexInit(&(f)->de_state_m, NULL); \
         (f)->hnext = NULL; \
         (f)->hprev = NULL; \
+        (f)->wnext = NULL; \
+        (f)->wprev = NULL; \
+        (f)->wheel_ts = 0; \
+        (f)->wheel_slot = 0; \
         (f)->lnext = NULL; \
         (f)->lprev = NULL; \
         SC_ATOMIC_INIT((f)->autofp_tmqh_flow_qid);  \
@@ -74,7 +87,8 @@
 /** \brief macro to recycle a flow before it goes into the spare queue for reuse.
  *
  *  Note that the lnext, lprev, hnext, hprev fields are untouched, those are
- *  managed by the queueing code. Same goes for fb (FlowBucket ptr) field.
+ *  managed by the queueing code. Same goes for fb (FlowBucket ptr) field
+ *  and the timing wheel fields.
  */
 #define FLOW_RECYCLE(f) do { \
         (f)->sp = 0; \
@@ -82,12 +96,18 @@
         SC_ATOMIC_RESET((f)->use_cnt); \
         (f)->probing_parser_toserver_al_proto_masks = 0; \
         (f)->probing_parser_toclient_al_proto_masks = 0; \
+        (f)->alproto_pm_pending[0] = 0; \
+        (f)->alproto_pm_pending[1] = 0; \
+        (f)->alproto_pm_searched[0] = 0; \
+        (f)->alproto_pm_searched[1] = 0; \
         (f)->flags = 0; \
         (f)->lastts_sec = 0; \
         (f)->protoctx = NULL; \
         FlowCleanupAppLayer((f)); \
         (f)->alparser = NULL; \
         (f)->alstate = NULL; \
+        (f)->alp_cache_flags = 0; \
+        (f)->bypass_flags = 0; \
         (f)->alproto = 0; \
         (f)->alproto_ts = 0; \
         (f)->alproto_tc = 0; \
@@ -101,6 +121,7 @@
         (f)->sgh_toclient = NULL; \
         GenericVarFree((f)->flowvar); \
         (f)->flowvar = NULL; \
+        FlowBitsFree((f)); \
         if (SC_ATOMIC_GET((f)->autofp_tmqh_flow_qid) != -1) {   \
             (void) SC_ATOMIC_SET((f)->autofp_tmqh_flow_qid, -1);   \
         }                                       \
@@ -116,6 +137,7 @@
             DetectEngineStateFree((f)->de_state); \
         } \
         GenericVarFree((f)->flowvar); \
+        FlowBitsFree((f)); \
         SCMutexDestroy(&(f)->de_state_m); \
         SC_ATOMIC_DESTROY((f)->autofp_tmqh_flow_qid);   \
     } while(0)
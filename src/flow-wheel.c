@@ -0,0 +1,444 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Hierarchical timing wheel for the flow timeouts.
+ *
+ * Flows are put in the slot of the second they expire at. The flow manager
+ * only visits the slots of the seconds that passed, so the cost of timing
+ * out flows depends on the number of expiring flows and not on the size of
+ * the hash.
+ *
+ * The wheel is updated lazily: when packets move the expiry of a flow
+ * forward the flow stays where it is, and when its slot fires the manager
+ * puts it back at its real expiry. Only a shorter timeout, e.g. a tcp
+ * session that closes, moves a flow right away.
+ *
+ * Locking order is flow bucket, flow, wheel. The manager holds the wheel
+ * lock while it walks a slot, so it only trylocks the bucket and flow.
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "debug.h"
+
+#include "flow.h"
+#include "flow-private.h"
+#include "flow-util.h"
+#include "flow-wheel.h"
+
+#include "util-debug.h"
+#include "util-unittest.h"
+
+/**
+ *  \brief setup a wheel per flow manager
+ */
+void FlowWheelInit(void)
+{
+    uint16_t i;
+
+    flow_wheels = NULL;
+
+    if (flow_config.wheel == 0)
+        return;
+
+    uint64_t size = flow_config.managers * sizeof(FlowWheel);
+    if (!(FLOW_CHECK_MEMCAP(size))) {
+        SCLogError(SC_ERR_FLOW_INIT, "allocating the flow timing wheels "
+                "would exceed the flow memcap, not using them");
+        return;
+    }
+
+    flow_wheels = SCCalloc(flow_config.managers, sizeof(FlowWheel));
+    if (unlikely(flow_wheels == NULL)) {
+        SCLogError(SC_ERR_FLOW_INIT, "allocating the flow timing wheels "
+                "failed, not using them");
+        return;
+    }
+
+    for (i = 0; i < flow_config.managers; i++) {
+        SCMutexInit(&flow_wheels[i].m, NULL);
+    }
+    (void) SC_ATOMIC_ADD(flow_memuse, size);
+}
+
+/**
+ *  \brief free the wheels. The flows in it are owned by the hash.
+ */
+void FlowWheelDestroy(void)
+{
+    uint16_t i;
+
+    if (flow_wheels == NULL)
+        return;
+
+    for (i = 0; i < flow_config.managers; i++) {
+        SCMutexDestroy(&flow_wheels[i].m);
+    }
+    SCFree(flow_wheels);
+    flow_wheels = NULL;
+
+    (void) SC_ATOMIC_SUB(flow_memuse, flow_config.managers * sizeof(FlowWheel));
+}
+
+/**
+ *  \brief get the wheel of the flow manager owning the flow's hash row
+ *
+ *  \param f flow that is in the hash
+ */
+FlowWheel *FlowWheelGet(Flow *f)
+{
+    uint32_t row = (uint32_t)(f->fb - flow_hash);
+    uint32_t idx = row / (flow_config.hash_size / flow_config.managers);
+
+    if (idx >= flow_config.managers)
+        idx = flow_config.managers - 1;
+
+    return &flow_wheels[idx];
+}
+
+/** \internal
+ *  \brief add a flow to the slot of expire
+ *
+ *  \param expire second to expire at, not before the current second
+ */
+static void FlowWheelLink(FlowWheel *w, Flow *f, uint32_t expire)
+{
+    uint32_t delta = expire - w->cur;
+    uint16_t slot;
+
+    if (delta < FLOW_WHEEL_SLOTS) {
+        slot = expire & FLOW_WHEEL_MASK;
+    } else {
+        /* park flows past the span in the last slot we cover */
+        if (delta >= FLOW_WHEEL_SPAN)
+            expire = w->cur + FLOW_WHEEL_SPAN - 1;
+        slot = FLOW_WHEEL_SLOTS + ((expire >> FLOW_WHEEL_BITS) & FLOW_WHEEL_MASK);
+    }
+
+    f->wheel_slot = slot;
+    f->wprev = NULL;
+    f->wnext = w->slots[slot];
+    if (f->wnext != NULL)
+        f->wnext->wprev = f;
+    w->slots[slot] = f;
+}
+
+/**
+ *  \brief add a flow to the wheel
+ *
+ *  \param w *LOCKED* wheel
+ *  \param f *LOCKED* flow, not in the wheel
+ *  \param expire second the flow times out at
+ */
+void FlowWheelInsertLocked(FlowWheel *w, Flow *f, uint32_t expire)
+{
+    f->wheel_ts = expire;
+
+    if (expire <= w->cur)
+        expire = w->cur + 1;
+
+    FlowWheelLink(w, f, expire);
+    w->cnt++;
+}
+
+/**
+ *  \brief put a flow that was unlinked, but that we couldn't lock,
+ *         back for the next second. wheel_ts is left alone.
+ *
+ *  \param w *LOCKED* wheel
+ */
+void FlowWheelRetryLocked(FlowWheel *w, Flow *f)
+{
+    FlowWheelLink(w, f, w->cur + 1);
+    w->cnt++;
+}
+
+/**
+ *  \brief remove a flow from its slot
+ *
+ *  \param w *LOCKED* wheel
+ */
+void FlowWheelUnlinkLocked(FlowWheel *w, Flow *f)
+{
+    if (f->wprev != NULL)
+        f->wprev->wnext = f->wnext;
+    else
+        w->slots[f->wheel_slot] = f->wnext;
+    if (f->wnext != NULL)
+        f->wnext->wprev = f->wprev;
+
+    f->wnext = NULL;
+    f->wprev = NULL;
+    w->cnt--;
+}
+
+/** \internal
+ *  \brief move the flows of the current second level slot to the first
+ *         level, or further out if they were parked
+ */
+static void FlowWheelCascade(FlowWheel *w)
+{
+    uint16_t slot = FLOW_WHEEL_SLOTS + ((w->cur >> FLOW_WHEEL_BITS) & FLOW_WHEEL_MASK);
+    Flow *f = w->slots[slot];
+    w->slots[slot] = NULL;
+
+    while (f != NULL) {
+        Flow *next = f->wnext;
+        FlowWheelLink(w, f, f->wheel_ts < w->cur ? w->cur : f->wheel_ts);
+        f = next;
+    }
+}
+
+/** \internal
+ *  \brief rebuild the wheel around a new current second, used when the
+ *         time jumped further than the wheel covers
+ */
+static void FlowWheelRebase(FlowWheel *w, uint32_t cur)
+{
+    Flow *list = NULL;
+    uint32_t i;
+
+    for (i = 0; i < FLOW_WHEEL_SLOTS * 2; i++) {
+        Flow *f = w->slots[i];
+        while (f != NULL) {
+            Flow *next = f->wnext;
+            f->wnext = list;
+            list = f;
+            f = next;
+        }
+        w->slots[i] = NULL;
+    }
+
+    w->cur = cur;
+    while (list != NULL) {
+        Flow *next = list->wnext;
+        FlowWheelLink(w, list, list->wheel_ts <= cur ? cur + 1 : list->wheel_ts);
+        list = next;
+    }
+}
+
+/**
+ *  \brief move the wheel one second forward if it is behind ts
+ *
+ *  \param w *LOCKED* wheel
+ *  \param ts current time in seconds
+ *
+ *  \retval slot first level slot holding the flows that expire now
+ *  \retval -1 the wheel is at ts
+ */
+int FlowWheelAdvanceLocked(FlowWheel *w, uint32_t ts)
+{
+    if (w->cur == 0) {
+        w->cur = ts;
+        return -1;
+    }
+    if (w->cur >= ts)
+        return -1;
+
+    if (ts - w->cur > FLOW_WHEEL_SPAN)
+        FlowWheelRebase(w, ts - 1);
+
+    w->cur++;
+    if ((w->cur & FLOW_WHEEL_MASK) == 0)
+        FlowWheelCascade(w);
+
+    return (int)(w->cur & FLOW_WHEEL_MASK);
+}
+
+/**
+ *  \brief (re)schedule a flow after a packet updated it
+ *
+ *  A flow is added if it is not in the wheel yet. A flow that is in the
+ *  wheel is only moved if it expires earlier than scheduled, a later
+ *  expiry is handled when its slot fires.
+ *
+ *  \param f *LOCKED* flow that is in the hash
+ *  \param now current time in seconds
+ */
+void FlowWheelSchedule(Flow *f, uint32_t now)
+{
+    if (flow_wheels == NULL || f->fb == NULL)
+        return;
+
+    int state = FlowGetFlowState(f);
+    uint32_t expire = (uint32_t)f->lastts_sec +
+        FlowGetFlowTimeout(f, state, 0) + 1;
+
+    if (f->wheel_ts != 0 && f->wheel_ts <= expire)
+        return;
+
+    FlowWheel *w = FlowWheelGet(f);
+    FWLOCK_LOCK(w);
+    if (f->wheel_ts != 0)
+        FlowWheelUnlinkLocked(w, f);
+    if (w->cur == 0 && now > 0)
+        w->cur = now - 1;
+    FlowWheelInsertLocked(w, f, expire);
+    FWLOCK_UNLOCK(w);
+}
+
+/**
+ *  \brief take a flow out of the wheel, when it's removed from the hash
+ *
+ *  \param f *LOCKED* flow, its bucket *LOCKED* as well
+ */
+void FlowWheelRemove(Flow *f)
+{
+    if (flow_wheels == NULL || f->wheel_ts == 0)
+        return;
+
+    FlowWheel *w = FlowWheelGet(f);
+    FWLOCK_LOCK(w);
+    FlowWheelUnlinkLocked(w, f);
+    f->wheel_ts = 0;
+    FWLOCK_UNLOCK(w);
+}
+
+#ifdef UNITTESTS
+
+/** \internal
+ *  \brief advance the wheel to ts and return the number of flows that
+ *         came up, unlinking them
+ */
+static uint32_t FlowWheelTestExpire(FlowWheel *w, uint32_t ts, Flow **last)
+{
+    uint32_t cnt = 0;
+    int slot;
+
+    while ((slot = FlowWheelAdvanceLocked(w, ts)) >= 0) {
+        Flow *f;
+        while ((f = w->slots[slot]) != NULL) {
+            FlowWheelUnlinkLocked(w, f);
+            *last = f;
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+/**
+ *  \test flows come up in the second they expire, also when they were
+ *        in the second level or past the span of the wheel
+ */
+static int FlowWheelTest01(void)
+{
+    FlowWheel w;
+    Flow f1, f2, f3;
+    Flow *last = NULL;
+    int result = 0;
+
+    memset(&w, 0, sizeof(w));
+    memset(&f1, 0, sizeof(f1));
+    memset(&f2, 0, sizeof(f2));
+    memset(&f3, 0, sizeof(f3));
+
+    w.cur = 1000;
+    FlowWheelInsertLocked(&w, &f1, 1030);
+    FlowWheelInsertLocked(&w, &f2, 1000 + 3600);
+    FlowWheelInsertLocked(&w, &f3, 1000 + FLOW_WHEEL_SPAN + 500);
+
+    if (w.cnt != 3 || f1.wheel_slot >= FLOW_WHEEL_SLOTS ||
+        f2.wheel_slot < FLOW_WHEEL_SLOTS) {
+        printf("cnt %u slots %u %u: ", w.cnt, f1.wheel_slot, f2.wheel_slot);
+        goto end;
+    }
+
+    if (FlowWheelTestExpire(&w, 1029, &last) != 0) {
+        printf("expired early: ");
+        goto end;
+    }
+    if (FlowWheelTestExpire(&w, 1030, &last) != 1 || last != &f1) {
+        printf("f1 not expired: ");
+        goto end;
+    }
+    if (FlowWheelTestExpire(&w, 1000 + 3599, &last) != 0) {
+        printf("f2 expired early: ");
+        goto end;
+    }
+    if (FlowWheelTestExpire(&w, 1000 + 3600, &last) != 1 || last != &f2) {
+        printf("f2 not expired: ");
+        goto end;
+    }
+    if (FlowWheelTestExpire(&w, 1000 + FLOW_WHEEL_SPAN + 499, &last) != 0) {
+        printf("f3 expired early: ");
+        goto end;
+    }
+    if (FlowWheelTestExpire(&w, 1000 + FLOW_WHEEL_SPAN + 500, &last) != 1 ||
+        last != &f3 || w.cnt != 0) {
+        printf("f3 not expired: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    return result;
+}
+
+/**
+ *  \test a time jump past the span of the wheel expires everything due
+ *        and keeps what is not
+ */
+static int FlowWheelTest02(void)
+{
+    FlowWheel w;
+    Flow f1, f2;
+    Flow *last = NULL;
+    int result = 0;
+
+    memset(&w, 0, sizeof(w));
+    memset(&f1, 0, sizeof(f1));
+    memset(&f2, 0, sizeof(f2));
+
+    w.cur = 1000;
+    FlowWheelInsertLocked(&w, &f1, 1100);
+    FlowWheelInsertLocked(&w, &f2, 1000 + 10 * FLOW_WHEEL_SPAN);
+
+    if (FlowWheelTestExpire(&w, 1000 + 2 * FLOW_WHEEL_SPAN, &last) != 1 ||
+        last != &f1) {
+        printf("f1 not expired: ");
+        goto end;
+    }
+
+    if (w.cnt != 1 || f2.wheel_ts != 1000 + 10 * FLOW_WHEEL_SPAN) {
+        printf("f2 lost: ");
+        goto end;
+    }
+
+    /* removing is a plain unlink */
+    FlowWheelUnlinkLocked(&w, &f2);
+    if (w.cnt != 0) {
+        printf("cnt %u: ", w.cnt);
+        goto end;
+    }
+
+    result = 1;
+end:
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void FlowWheelRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("FlowWheelTest01", FlowWheelTest01, 1);
+    UtRegisterTest("FlowWheelTest02", FlowWheelTest02, 1);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,62 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __FLOW_WHEEL_H__
+#define __FLOW_WHEEL_H__
+
+#include "suricata-common.h"
+#include "flow.h"
+
+/** slots per wheel level. The first level has a slot per second, the
+ *  second level a slot per FLOW_WHEEL_SLOTS seconds. */
+#define FLOW_WHEEL_BITS     8
+#define FLOW_WHEEL_SLOTS    (1 << FLOW_WHEEL_BITS)
+#define FLOW_WHEEL_MASK     (FLOW_WHEEL_SLOTS - 1)
+/** seconds covered by the wheel, flows expiring later are parked in the
+ *  last second level slot and rescheduled when it cascades */
+#define FLOW_WHEEL_SPAN     (FLOW_WHEEL_SLOTS * FLOW_WHEEL_SLOTS)
+
+/** timing wheel, one per flow manager covering the flows of its slice
+ *  of the hash */
+typedef struct FlowWheel_ {
+    SCMutex m;
+    uint32_t cur;       /**< last second that was expired, 0 if unset */
+    uint32_t cnt;       /**< flows in the wheel */
+    Flow *slots[FLOW_WHEEL_SLOTS * 2];
+} __attribute__((aligned(CLS))) FlowWheel;
+
+#define FWLOCK_LOCK(w) SCMutexLock(&(w)->m)
+#define FWLOCK_UNLOCK(w) SCMutexUnlock(&(w)->m)
+
+/** the wheels, flow_config.managers of them. NULL if disabled */
+FlowWheel *flow_wheels;
+
+void FlowWheelInit(void);
+void FlowWheelDestroy(void);
+
+void FlowWheelSchedule(Flow *, uint32_t);
+void FlowWheelRemove(Flow *);
+
+FlowWheel *FlowWheelGet(Flow *);
+void FlowWheelInsertLocked(FlowWheel *, Flow *, uint32_t);
+void FlowWheelRetryLocked(FlowWheel *, Flow *);
+void FlowWheelUnlinkLocked(FlowWheel *, Flow *);
+int FlowWheelAdvanceLocked(FlowWheel *, uint32_t);
+
+void FlowWheelRegisterTests(void);
+
+#endif /* __FLOW_WHEEL_H__ */
@@ -39,10 +39,12 @@
 #include "flow-hash.h"
 #include "flow-util.h"
 #include "flow-var.h"
+#include "flow-bit.h"
 #include "flow-private.h"
 #include "flow-timeout.h"
 #include "flow-manager.h"
 #include "flow-storage.h"
+#include "flow-wheel.h"
 
 #include "stream-tcp-private.h"
 #include "stream-tcp-reassemble.h"
@@ -70,6 +72,7 @@
 #define FLOW_DEFAULT_MEMCAP      (32 * 1024 * 1024) /* 32 MB */
 
 #define FLOW_DEFAULT_PREALLOC    10000
+#define FLOW_DEFAULT_MANAGERS    1
 
 /** atomic int that is used when freeing a flow from the hash. In this
  *  case we walk the hash to find a flow to free. This var records where
@@ -243,6 +246,21 @@ void FlowHandlePacket (ThreadVars *tv, Packet *p)
 
     /* update the last seen timestamp of this flow */
     f->lastts_sec = p->ts.tv_sec;
+    FlowWheelSchedule(f, (uint32_t)p->ts.tv_sec);
+
+    /* bypassed flow: nothing past the flow lookup needs to see the
+     * packet. Keep asking the capture method to take over, until it
+     * does the packets will keep coming in. */
+    if (f->bypass_flags & FLOW_BYPASS_LOCAL) {
+        p->flags |= PKT_FLOW_BYPASSED;
+        DecodeSetNoPacketInspectionFlag(p);
+        DecodeSetNoPayloadInspectionFlag(p);
+        (void)PacketBypassCallback(p);
+
+        FLOWLOCK_UNLOCK(f);
+        p->flags |= PKT_HAS_FLOW;
+        return;
+    }
 
     /* update flags and counters */
     if (FlowGetPacketDirection(f,p) == TOSERVER) {
@@ -288,6 +306,39 @@ void FlowHandlePacket (ThreadVars *tv, Packet *p)
     return;
 }
 
+/**
+ *  \brief Bypass a flow
+ *
+ *  From the next packet on the flow's packets skip the stream engine, the
+ *  app layer and detection. If the capture method supports it the rest of
+ *  the flow is bypassed there, so we won't even see its packets anymore.
+ *  Either way the flow is timed out by the flow manager using the
+ *  "bypassed" timeout.
+ *
+ *  \param f *LOCKED* flow
+ *  \param p packet of the flow, used to reach the capture method. Can be
+ *           NULL, then the flow is only bypassed locally.
+ */
+void FlowBypass(Flow *f, Packet *p)
+{
+    if (f->bypass_flags & FLOW_BYPASS_LOCAL)
+        return;
+
+    SCLogDebug("flow %p bypassed", f);
+    f->bypass_flags |= FLOW_BYPASS_LOCAL;
+
+    if (p != NULL) {
+        p->flags |= PKT_FLOW_BYPASSED;
+        if (PacketBypassCallback(p) == 1)
+            f->bypass_flags |= FLOW_BYPASS_CAPTURE;
+    }
+
+    /* the bypassed timeout may be shorter than the one we're scheduled
+     * for, and with the capture bypassing it we may not get another
+     * packet to reschedule on */
+    FlowWheelSchedule(f, (uint32_t)f->lastts_sec);
+}
+
 /** \brief initialize the configuration
  *  \warning Not thread safe */
 void FlowInitConfig(char quiet)
@@ -298,6 +349,7 @@ void FlowInitConfig(char quiet)
     SC_ATOMIC_INIT(flow_flags);
     SC_ATOMIC_INIT(flow_memuse);
     SC_ATOMIC_INIT(flow_prune_idx);
+    FlowBitInit();
     FlowQueueInit(&flow_spare_q);
 
     unsigned int seed = RandomTimePreseed();
@@ -307,6 +359,8 @@ void FlowInitConfig(char quiet)
     flow_config.hash_size   = FLOW_DEFAULT_HASHSIZE;
     flow_config.memcap      = FLOW_DEFAULT_MEMCAP;
     flow_config.prealloc    = FLOW_DEFAULT_PREALLOC;
+    flow_config.managers    = FLOW_DEFAULT_MANAGERS;
+    flow_config.wheel       = 1;
 
     /* If we have specific config, overwrite the defaults with them,
      * otherwise, leave the default values */
@@ -351,9 +405,37 @@ void FlowInitConfig(char quiet)
             flow_config.prealloc = configval;
         }
     }
+    if ((ConfGet("flow.managers", &conf_val)) == 1)
+    {
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                                    conf_val) > 0) {
+            if (configval >= 1 && configval <= FLOW_MAX_MANAGERS &&
+                configval <= flow_config.hash_size) {
+                flow_config.managers = (uint16_t)configval;
+            } else {
+                SCLogError(SC_ERR_INVALID_VALUE, "flow.managers must be in "
+                        "the range of 1 and %u, using default %u",
+                        FLOW_MAX_MANAGERS, FLOW_DEFAULT_MANAGERS);
+            }
+        }
+    }
+    if ((ConfGet("flow.rows-per-pass", &conf_val)) == 1)
+    {
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                                    conf_val) > 0) {
+            flow_config.rows_per_pass = configval;
+        }
+    }
+    int wheel = 1;
+    if ((ConfGetBool("flow.timeout-wheel", &wheel)) == 1)
+    {
+        flow_config.wheel = wheel ? 1 : 0;
+    }
     SCLogDebug("Flow config from suricata.yaml: memcap: %"PRIu64", hash-size: "
-               "%"PRIu32", prealloc: %"PRIu32, flow_config.memcap,
-               flow_config.hash_size, flow_config.prealloc);
+               "%"PRIu32", prealloc: %"PRIu32", managers: %"PRIu16", "
+               "rows-per-pass: %"PRIu32, flow_config.memcap,
+               flow_config.hash_size, flow_config.prealloc,
+               flow_config.managers, flow_config.rows_per_pass);
 
     /* alloc hash memory */
     uint64_t hash_size = flow_config.hash_size * sizeof(FlowBucket);
@@ -379,6 +461,8 @@ void FlowInitConfig(char quiet)
     }
     (void) SC_ATOMIC_ADD(flow_memuse, (flow_config.hash_size * sizeof(FlowBucket)));
 
+    FlowWheelInit();
+
     if (quiet == FALSE) {
         SCLogInfo("allocated %llu bytes of memory for the flow hash... "
                   "%" PRIu32 " buckets of size %" PRIuMAX "",
@@ -463,6 +547,7 @@ void FlowShutdown(void)
         SCFree(flow_hash);
         flow_hash = NULL;
     }
+    FlowWheelDestroy();
     (void) SC_ATOMIC_SUB(flow_memuse, flow_config.hash_size * sizeof(FlowBucket));
     FlowQueueDestroy(&flow_spare_q);
 
@@ -472,6 +557,34 @@ void FlowShutdown(void)
     return;
 }
 
+/**
+ *  \internal
+ *  \brief Get the bypassed timeouts of a flow-timeouts protocol node
+ *
+ *  \param proto conf node of the protocol, e.g. flow-timeouts.tcp
+ *  \param proto_map FLOW_PROTO_* to set the timeouts for
+ */
+static void FlowInitBypassedTimeouts(ConfNode *proto, uint8_t proto_map)
+{
+    uint32_t configval = 0;
+    const char *bypassed = ConfNodeLookupChildValue(proto, "bypassed");
+    const char *emergency_bypassed = ConfNodeLookupChildValue(proto,
+            "emergency-bypassed");
+
+    if (bypassed != NULL &&
+        ByteExtractStringUint32(&configval, 10, strlen(bypassed),
+                                bypassed) > 0) {
+
+        flow_proto[proto_map].bypassed_timeout = configval;
+    }
+    if (emergency_bypassed != NULL &&
+        ByteExtractStringUint32(&configval, 10, strlen(emergency_bypassed),
+                                emergency_bypassed) > 0) {
+
+        flow_proto[proto_map].emerg_bypassed_timeout = configval;
+    }
+}
+
 /**
  *  \brief  Function to set the default timeout, free function and flow state
  *          function for all supported flow_proto.
@@ -528,6 +641,13 @@ void FlowInitFlowProto(void)
         FLOW_DEFAULT_EMERG_CLOSED_TIMEOUT;
     flow_proto[FLOW_PROTO_ICMP].Freefunc = NULL;
     flow_proto[FLOW_PROTO_ICMP].GetProtoState = NULL;
+    /*Bypassed flows, all protocols*/
+    int i;
+    for (i = 0; i < FLOW_PROTO_MAX; i++) {
+        flow_proto[i].bypassed_timeout = FLOW_DEFAULT_BYPASSED_TIMEOUT;
+        flow_proto[i].emerg_bypassed_timeout =
+            FLOW_DEFAULT_EMERG_BYPASSED_TIMEOUT;
+    }
 
     /* Let's see if we have custom timeouts defined from config */
     const char *new = NULL;
@@ -545,6 +665,8 @@ void FlowInitFlowProto(void)
         /* Defaults. */
         proto = ConfNodeLookupChild(flow_timeouts, "default");
         if (proto != NULL) {
+            FlowInitBypassedTimeouts(proto, FLOW_PROTO_DEFAULT);
+
             new = ConfNodeLookupChildValue(proto, "new");
             established = ConfNodeLookupChildValue(proto, "established");
             closed = ConfNodeLookupChildValue(proto, "closed");
@@ -596,6 +718,8 @@ void FlowInitFlowProto(void)
         /* TCP. */
         proto = ConfNodeLookupChild(flow_timeouts, "tcp");
         if (proto != NULL) {
+            FlowInitBypassedTimeouts(proto, FLOW_PROTO_TCP);
+
             new = ConfNodeLookupChildValue(proto, "new");
             established = ConfNodeLookupChildValue(proto, "established");
             closed = ConfNodeLookupChildValue(proto, "closed");
@@ -647,6 +771,8 @@ void FlowInitFlowProto(void)
         /* UDP. */
         proto = ConfNodeLookupChild(flow_timeouts, "udp");
         if (proto != NULL) {
+            FlowInitBypassedTimeouts(proto, FLOW_PROTO_UDP);
+
             new = ConfNodeLookupChildValue(proto, "new");
             established = ConfNodeLookupChildValue(proto, "established");
             emergency_new = ConfNodeLookupChildValue(proto, "emergency-new");
@@ -681,6 +807,8 @@ void FlowInitFlowProto(void)
         /* ICMP. */
         proto = ConfNodeLookupChild(flow_timeouts, "icmp");
         if (proto != NULL) {
+            FlowInitBypassedTimeouts(proto, FLOW_PROTO_ICMP);
+
             new = ConfNodeLookupChildValue(proto, "new");
             established = ConfNodeLookupChildValue(proto, "established");
             emergency_new = ConfNodeLookupChildValue(proto, "emergency-new");
@@ -1047,6 +1175,93 @@ static int FlowTest09 (void) {
     return result;
 }
 
+static int FlowTestBypassCallback(Packet *p)
+{
+    return 1;
+}
+
+/**
+ *  \test   Test bypassing a flow: the next packet of the flow is short
+ *          circuited, the flow uses the bypassed timeout and the capture
+ *          callback is used.
+ *
+ *  \retval On success it returns 1 and on failure 0.
+ */
+
+static int FlowTest10 (void) {
+    int result = 0;
+    uint8_t payload[] = "Payload";
+    Packet *p = NULL;
+    Flow *f = NULL;
+
+    FlowInitConfig(FLOW_QUIET);
+
+    p = UTHBuildPacket(payload, sizeof(payload), IPPROTO_TCP);
+    if (p == NULL)
+        goto end;
+    FlowHandlePacket(NULL, p);
+    f = p->flow;
+    if (f == NULL) {
+        printf("no flow: ");
+        goto end;
+    }
+    if (p->flags & PKT_FLOW_BYPASSED) {
+        printf("packet of a new flow flagged as bypassed: ");
+        goto end;
+    }
+
+    p->BypassPacketsFlow = FlowTestBypassCallback;
+    FLOWLOCK_WRLOCK(f);
+    FlowBypass(f, p);
+    FLOWLOCK_UNLOCK(f);
+
+    if (f->bypass_flags != (FLOW_BYPASS_LOCAL|FLOW_BYPASS_CAPTURE)) {
+        printf("bypass flags %02x, expected %02x: ", f->bypass_flags,
+                FLOW_BYPASS_LOCAL|FLOW_BYPASS_CAPTURE);
+        goto end;
+    }
+    if (FlowGetFlowState(f) != FLOW_STATE_BYPASSED) {
+        printf("flow state %d, expected FLOW_STATE_BYPASSED: ",
+                FlowGetFlowState(f));
+        goto end;
+    }
+    if (FlowGetFlowTimeout(f, FLOW_STATE_BYPASSED, 0) !=
+            FLOW_DEFAULT_BYPASSED_TIMEOUT) {
+        printf("bypassed timeout not used: ");
+        goto end;
+    }
+
+    /* next packet of the flow */
+    p->flags &= ~(PKT_HAS_FLOW|PKT_FLOW_BYPASSED);
+    p->flowflags = 0;
+    FlowDeReference(&p->flow);
+    FlowHandlePacket(NULL, p);
+    if (p->flow != f) {
+        printf("packet not matched to the bypassed flow: ");
+        goto end;
+    }
+    if (!(p->flags & PKT_FLOW_BYPASSED) ||
+        !(p->flags & PKT_NOPACKET_INSPECTION) ||
+        !(p->flags & PKT_NOPAYLOAD_INSPECTION)) {
+        printf("packet not flagged as bypassed: ");
+        goto end;
+    }
+    if (p->flowflags != 0) {
+        printf("bypassed packet was processed past the flow lookup: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (p != NULL) {
+        if (p->flow != NULL)
+            SC_ATOMIC_RESET(p->flow->use_cnt);
+        UTHFreePacket(p);
+    }
+    FlowShutdown();
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 /**
@@ -1059,8 +1274,10 @@ void FlowRegisterTests (void) {
     UtRegisterTest("FlowTest07 -- Test flow Allocations when it reach memcap", FlowTest07, 1);
     UtRegisterTest("FlowTest08 -- Test flow Allocations when it reach memcap", FlowTest08, 1);
     UtRegisterTest("FlowTest09 -- Test flow Allocations when it reach memcap", FlowTest09, 1);
+    UtRegisterTest("FlowTest10 -- Test flow bypass", FlowTest10, 1);
 
     FlowMgrRegisterTests();
+    FlowWheelRegisterTests();
     RegisterFlowStorageTests();
 #endif /* UNITTESTS */
 }
@@ -42,7 +42,8 @@
 /** At least on packet from the destination address was seen */
 #define FLOW_TO_DST_SEEN                  0x00000002
 
-// vacany 1x
+/** no sha1 on files in this flow, toserver */
+#define FLOW_FILE_NO_SHA1_TS              0x00000004
 
 /** no magic on files in this flow */
 #define FLOW_FILE_NO_MAGIC_TS             0x00000008
@@ -61,6 +62,9 @@
 /** All packets in this flow should be dropped */
 #define FLOW_ACTION_DROP                  0x00000200
 
+/** no sha1 on files in this flow, toclient */
+#define FLOW_FILE_NO_SHA1_TC              0x00000400
+
 /** Sgh for toserver direction set (even if it's NULL) */
 #define FLOW_SGH_TOSERVER                 0x00000800
 /** Sgh for toclient direction set (even if it's NULL) */
@@ -78,10 +82,14 @@
 #define FLOW_TS_PM_ALPROTO_DETECT_DONE    0x00020000
 /** Probing parser alproto detection done */
 #define FLOW_TS_PP_ALPROTO_DETECT_DONE    0x00040000
+/** no sha256 on files in this flow, toserver */
+#define FLOW_FILE_NO_SHA256_TS            0x00080000
 /** Pattern matcher alproto detection done */
 #define FLOW_TC_PM_ALPROTO_DETECT_DONE    0x00100000
 /** Probing parser alproto detection done */
 #define FLOW_TC_PP_ALPROTO_DETECT_DONE    0x00200000
+/** no sha256 on files in this flow, toclient */
+#define FLOW_FILE_NO_SHA256_TC            0x00400000
 #define FLOW_TIMEOUT_REASSEMBLY_DONE      0x00800000
 /** even if the flow has files, don't store 'm */
 #define FLOW_FILE_NO_STORE_TS             0x01000000
@@ -173,6 +181,12 @@
 /** \todo only used by flow keyword internally. */
 #define FLOW_PKT_ONLYSTREAM             0x80
 
+/** Flow::bypass_flags */
+/** flow is bypassed, its packets skip stream, app layer and detection */
+#define FLOW_BYPASS_LOCAL               0x01
+/** the capture method was asked to stop passing us the flow's packets */
+#define FLOW_BYPASS_CAPTURE             0x02
+
 /** Mutex or RWLocks for the flow. */
 //#define FLOWLOCK_RWLOCK
 #define FLOWLOCK_MUTEX
@@ -203,6 +217,9 @@
     #error Enable FLOWLOCK_RWLOCK or FLOWLOCK_MUTEX
 #endif
 
+/** max number of flow manager threads (flow.managers) */
+#define FLOW_MAX_MANAGERS   64
+
 /* global flow config */
 typedef struct FlowCnf_
 {
@@ -219,6 +236,11 @@ typedef struct FlowCnf_
     uint32_t emerg_timeout_est;
     uint32_t emergency_recovery;
 
+    uint16_t managers;          /**< number of flow manager threads */
+    uint32_t rows_per_pass;     /**< hash rows a manager checks per wakeup,
+                                     0 means its whole slice */
+    uint8_t wheel;              /**< time out flows using the timing wheel */
+
 } FlowConfig;
 
 /* Hash key for the flow hash */
@@ -300,6 +322,11 @@ typedef struct Flow_
 
     uint32_t probing_parser_toserver_al_proto_masks;
     uint32_t probing_parser_toclient_al_proto_masks;
+    /** pattern hits per direction waiting for their probing parser, a bit
+     *  per alproto */
+    uint32_t alproto_pm_pending[2];
+    /** bytes of the stream the patterns were searched in per direction */
+    uint16_t alproto_pm_searched[2];
 
     uint32_t flags;
 
@@ -320,7 +347,10 @@ typedef struct Flow_
     /** mapping to Flow's protocol specific protocols for timeouts
         and state and free functions. */
     uint8_t protomap;
-    uint8_t pad0;
+    /** ALP_CACHE_* flags, see app-layer-detect-cache.h */
+    uint8_t alp_cache_flags;
+    /** FLOW_BYPASS_* flags */
+    uint8_t bypass_flags;
 
     uint16_t alproto; /**< \brief application level protocol */
     uint16_t alproto_ts;
@@ -352,6 +382,11 @@ typedef struct Flow_
     /* pointer to the var list */
     GenericVar *flowvar;
 
+    /** flowbits bitmap, indexed by flowbit name idx. NULL until the
+     *  first flowbit is set. */
+    uint8_t *flowbits;
+    uint16_t flowbits_size;     /**< size of flowbits in bytes */
+
     SCMutex de_state_m;          /**< mutex lock for the de_state object */
 
     /** hash list pointers, protected by fb->s */
@@ -359,6 +394,14 @@ typedef struct Flow_
     struct Flow_ *hprev;
     struct FlowBucket_ *fb;
 
+    /** timing wheel list pointers, protected by the wheel mutex */
+    struct Flow_ *wnext;
+    struct Flow_ *wprev;
+    /** second the flow is scheduled to expire at, 0 if it is not in a
+     *  wheel. Only changed with both the flow and wheel locked. */
+    uint32_t wheel_ts;
+    uint16_t wheel_slot;
+
     /** queue list pointers, protected by queue mutex */
     struct Flow_ *lnext; /* list */
     struct Flow_ *lprev;
@@ -374,6 +417,7 @@ enum {
     FLOW_STATE_NEW = 0,
     FLOW_STATE_ESTABLISHED,
     FLOW_STATE_CLOSED,
+    FLOW_STATE_BYPASSED,
 };
 
 typedef struct FlowProto_ {
@@ -383,11 +427,14 @@ typedef struct FlowProto_ {
     uint32_t emerg_new_timeout;
     uint32_t emerg_est_timeout;
     uint32_t emerg_closed_timeout;
+    uint32_t bypassed_timeout;
+    uint32_t emerg_bypassed_timeout;
     void (*Freefunc)(void *);
     int (*GetProtoState)(void *);
 } FlowProto;
 
 void FlowHandlePacket (ThreadVars *, Packet *);
+void FlowBypass(Flow *, Packet *);
 void FlowInitConfig (char);
 void FlowPrintQueueInfo (void);
 void FlowShutdown(void);
@@ -25,7 +25,6 @@
 #include "host.h"
 
 #include "detect-engine-tag.h"
-#include "detect-engine-threshold.h"
 #include "reputation.h"
 
 uint32_t HostGetSpareCount(void) {
@@ -47,7 +46,6 @@ uint32_t HostGetActiveCount(void) {
  */
 static int HostHostTimedOut(Host *h, struct timeval *ts) {
     int tags = 0;
-    int thresholds = 0;
 
     /** never prune a host that is used by a packet
      *  we are currently processing in one of the threads */
@@ -65,11 +63,7 @@ static int HostHostTimedOut(Host *h, struct timeval *ts) {
     if (TagHostHasTag(h) && TagTimeoutCheck(h, ts) == 0) {
         tags = 1;
     }
-    if (ThresholdHostHasThreshold(h) && ThresholdTimeoutCheck(h, ts) == 0) {
-        thresholds = 1;
-    }
-
-    if (tags || thresholds)
+    if (tags)
         return 0;
 
     SCLogDebug("host %p timed out", h);
@@ -94,7 +94,7 @@ typedef struct LogFileLogThread_ {
 
 static void LogFileMetaGetUri(FILE *fp, Packet *p, File *ff) {
     HtpState *htp_state = (HtpState *)p->flow->alstate;
-    if (htp_state != NULL) {
+    if (htp_state != NULL && p->flow->alproto == ALPROTO_HTTP) {
         htp_tx_t *tx = AppLayerGetTx(ALPROTO_HTTP, htp_state, ff->txid);
         if (tx != NULL) {
             HtpTxUserData *tx_ud = htp_tx_get_user_data(tx);
@@ -112,7 +112,7 @@ static void LogFileMetaGetUri(FILE *fp, Packet *p, File *ff) {
 
 static void LogFileMetaGetHost(FILE *fp, Packet *p, File *ff) {
     HtpState *htp_state = (HtpState *)p->flow->alstate;
-    if (htp_state != NULL) {
+    if (htp_state != NULL && p->flow->alproto == ALPROTO_HTTP) {
         htp_tx_t *tx = AppLayerGetTx(ALPROTO_HTTP, htp_state, ff->txid);
         if (tx != NULL && tx->request_hostname != NULL) {
             PrintRawJsonFp(fp, (uint8_t *)bstr_ptr(tx->request_hostname),
@@ -126,7 +126,7 @@ static void LogFileMetaGetHost(FILE *fp, Packet *p, File *ff) {
 
 static void LogFileMetaGetReferer(FILE *fp, Packet *p, File *ff) {
     HtpState *htp_state = (HtpState *)p->flow->alstate;
-    if (htp_state != NULL) {
+    if (htp_state != NULL && p->flow->alproto == ALPROTO_HTTP) {
         htp_tx_t *tx = AppLayerGetTx(ALPROTO_HTTP, htp_state, ff->txid);
         if (tx != NULL) {
             htp_header_t *h = NULL;
@@ -145,7 +145,7 @@ static void LogFileMetaGetReferer(FILE *fp, Packet *p, File *ff) {
 
 static void LogFileMetaGetUserAgent(FILE *fp, Packet *p, File *ff) {
     HtpState *htp_state = (HtpState *)p->flow->alstate;
-    if (htp_state != NULL) {
+    if (htp_state != NULL && p->flow->alproto == ALPROTO_HTTP) {
         htp_tx_t *tx = AppLayerGetTx(ALPROTO_HTTP, htp_state, ff->txid);
         if (tx != NULL) {
             htp_header_t *h = NULL;
@@ -0,0 +1,903 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Writer thread for the file-store dedup mode.
+ *
+ * The loggers queue open, data and close jobs. A single writer thread
+ * takes the whole queue at once, writev()s runs of data for the same file
+ * in one call and, at close, moves the file into the content store:
+ *
+ *   <dir>/tmp/file.<id>         while the file is being written
+ *   <dir>/<xx>/<sha256>         content, xx being the first hash byte
+ *   <dir>/file.<id>.meta        metadata, one per file seen
+ *
+ * The hash is only known when the file is complete, so the data is
+ * streamed to the tmp file first. If the content is already in the store
+ * the tmp file is dropped and only the meta file is added.
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "threadvars.h"
+#include "tm-threads.h"
+
+#include "log-filestore-writer.h"
+
+#include "util-debug.h"
+#include "util-signal.h"
+#include "util-error.h"
+#include "util-unittest.h"
+
+#include <sys/uio.h>
+
+#define FILESTORE_JOB_OPEN          0
+#define FILESTORE_JOB_DATA          1
+#define FILESTORE_JOB_CLOSE         2
+
+/** max number of data jobs combined in a single writev */
+#define FILESTORE_WRITER_IOV_MAX    64
+/** size of the hash of files open in the writer */
+#define FILESTORE_WRITER_FILES_SIZE 1024
+
+typedef struct FilestoreJob_ {
+    uint8_t type;
+    uint8_t has_hash;
+    unsigned int file_id;
+    uint8_t hash[FILESTORE_WRITER_HASH_LEN];
+    uint8_t *data;              /**< file data or meta text, follows the job */
+    uint32_t len;
+    struct FilestoreJob_ *next;
+} FilestoreJob;
+
+/** file being written, only used by the writer thread */
+typedef struct FilestoreWriterFile_ {
+    unsigned int file_id;
+    int fd;
+    uint64_t size;
+    char *meta;                 /**< meta text from the open job */
+    uint32_t meta_len;
+    struct FilestoreWriterFile_ *next;
+} FilestoreWriterFile;
+
+typedef struct FilestoreWriter_ {
+    SCMutex lock;
+    SCCondT cond;               /**< wakes up the writer */
+    SCCondT space_cond;         /**< wakes up loggers waiting for queue space */
+    FilestoreJob *head;
+    FilestoreJob *tail;
+    uint64_t memuse;            /**< memory of the queued jobs */
+    uint64_t memcap;
+    int running;
+    ThreadVars *tv;
+    char dir[PATH_MAX];
+
+    /* writer thread only */
+    FilestoreWriterFile *files[FILESTORE_WRITER_FILES_SIZE];
+
+    LogFilestoreWriterStats stats;
+} FilestoreWriter;
+
+static FilestoreWriter writer;
+
+static void FilestoreWriterTmpName(char *name, size_t size, unsigned int file_id)
+{
+    snprintf(name, size, "%s/tmp/file.%u", writer.dir, file_id);
+}
+
+static void FilestoreWriterFileFree(FilestoreWriterFile *wf)
+{
+    if (wf->meta != NULL)
+        SCFree(wf->meta);
+    SCFree(wf);
+}
+
+static FilestoreWriterFile *FilestoreWriterFileLookup(unsigned int file_id)
+{
+    FilestoreWriterFile *wf = writer.files[file_id % FILESTORE_WRITER_FILES_SIZE];
+    while (wf != NULL && wf->file_id != file_id)
+        wf = wf->next;
+    return wf;
+}
+
+static FilestoreWriterFile *FilestoreWriterFileRemove(unsigned int file_id)
+{
+    FilestoreWriterFile **pwf = &writer.files[file_id % FILESTORE_WRITER_FILES_SIZE];
+    while (*pwf != NULL) {
+        FilestoreWriterFile *wf = *pwf;
+        if (wf->file_id == file_id) {
+            *pwf = wf->next;
+            wf->next = NULL;
+            return wf;
+        }
+        pwf = &wf->next;
+    }
+    return NULL;
+}
+
+/**
+ *  \brief writev that deals with partial writes
+ *
+ *  \retval bytes written or -1 on error
+ */
+static int64_t FilestoreWriterWritev(int fd, struct iovec *iov, int cnt)
+{
+    int64_t total = 0;
+
+    while (cnt > 0) {
+        ssize_t r = writev(fd, iov, cnt);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        total += r;
+
+        while (cnt > 0 && (size_t)r >= iov->iov_len) {
+            r -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + r;
+            iov->iov_len -= r;
+        }
+    }
+    return total;
+}
+
+static void FilestoreWriterOpenFile(FilestoreJob *job)
+{
+    char tmpname[PATH_MAX];
+
+    FilestoreWriterFile *wf = SCMalloc(sizeof(FilestoreWriterFile));
+    if (unlikely(wf == NULL))
+        return;
+    memset(wf, 0, sizeof(FilestoreWriterFile));
+    wf->file_id = job->file_id;
+
+    if (job->len > 0) {
+        wf->meta = SCMalloc(job->len);
+        if (unlikely(wf->meta == NULL)) {
+            SCFree(wf);
+            return;
+        }
+        memcpy(wf->meta, job->data, job->len);
+        wf->meta_len = job->len;
+    }
+
+    FilestoreWriterTmpName(tmpname, sizeof(tmpname), job->file_id);
+    wf->fd = open(tmpname, O_CREAT | O_TRUNC | O_NOFOLLOW | O_WRONLY, 0644);
+    if (wf->fd == -1) {
+        SCLogError(SC_ERR_FOPEN, "failed to open %s: %s", tmpname, strerror(errno));
+        FilestoreWriterFileFree(wf);
+        return;
+    }
+
+    uint32_t idx = wf->file_id % FILESTORE_WRITER_FILES_SIZE;
+    wf->next = writer.files[idx];
+    writer.files[idx] = wf;
+}
+
+/**
+ *  \brief write the data of a run of data jobs for the same file
+ */
+static void FilestoreWriterWriteData(unsigned int file_id, struct iovec *iov, int cnt)
+{
+    FilestoreWriterFile *wf = FilestoreWriterFileLookup(file_id);
+    if (wf == NULL) {
+        /* open failed */
+        return;
+    }
+
+    int64_t r = FilestoreWriterWritev(wf->fd, iov, cnt);
+    if (r < 0) {
+        SCLogDebug("write failed: %s", strerror(errno));
+        return;
+    }
+    wf->size += r;
+    writer.stats.bytes += r;
+}
+
+static void FilestoreWriterWriteMeta(FilestoreWriterFile *wf, FilestoreJob *job,
+        const char *content, int dup)
+{
+    char metaname[PATH_MAX];
+    char trailer[PATH_MAX + 64];
+    struct iovec iov[3];
+    int offset = 0;
+
+    offset = snprintf(trailer, sizeof(trailer), "CONTENT:           %s\n", content);
+    if (job->has_hash && offset > 0 && offset < (int)sizeof(trailer)) {
+        snprintf(trailer + offset, sizeof(trailer) - offset,
+                "DUPLICATE:         %s\n", dup ? "yes" : "no");
+    }
+
+    snprintf(metaname, sizeof(metaname), "%s/file.%u.meta", writer.dir, wf->file_id);
+    int fd = open(metaname, O_CREAT | O_TRUNC | O_NOFOLLOW | O_WRONLY, 0644);
+    if (fd == -1) {
+        SCLogError(SC_ERR_FOPEN, "opening %s failed: %s", metaname, strerror(errno));
+        return;
+    }
+
+    iov[0].iov_base = wf->meta;
+    iov[0].iov_len = wf->meta_len;
+    iov[1].iov_base = job->data;
+    iov[1].iov_len = job->len;
+    iov[2].iov_base = trailer;
+    iov[2].iov_len = strlen(trailer);
+
+    if (FilestoreWriterWritev(fd, iov, 3) < 0) {
+        SCLogError(SC_ERR_FWRITE, "writing %s failed: %s", metaname, strerror(errno));
+    }
+    close(fd);
+}
+
+/**
+ *  \brief close a file and move it into the store
+ */
+static void FilestoreWriterCloseFile(FilestoreJob *job)
+{
+    char tmpname[PATH_MAX];
+    char content[PATH_MAX];
+    int dup = 0;
+    int stored = 0;
+
+    FilestoreWriterFile *wf = FilestoreWriterFileRemove(job->file_id);
+    if (wf == NULL) {
+        /* open failed */
+        return;
+    }
+    close(wf->fd);
+    writer.stats.files++;
+
+    FilestoreWriterTmpName(tmpname, sizeof(tmpname), wf->file_id);
+
+    if (job->has_hash) {
+        char hex[FILESTORE_WRITER_HASH_LEN * 2 + 1];
+        char dirname[PATH_MAX];
+        int i;
+
+        for (i = 0; i < FILESTORE_WRITER_HASH_LEN; i++) {
+            snprintf(hex + i * 2, 3, "%02x", job->hash[i]);
+        }
+
+        snprintf(dirname, sizeof(dirname), "%s/%c%c", writer.dir, hex[0], hex[1]);
+        /* if mkdir fails the link below fails too */
+        (void)mkdir(dirname, S_IRWXU|S_IXGRP|S_IRGRP);
+        snprintf(content, sizeof(content), "%s/%s", dirname, hex);
+
+        /* link won't replace an existing file, so racing stores of the same
+         * content are safe */
+        if (link(tmpname, content) == 0) {
+            writer.stats.unique++;
+            stored = 1;
+        } else if (errno == EEXIST) {
+            writer.stats.duplicates++;
+            writer.stats.bytes_dup += wf->size;
+            dup = 1;
+            stored = 1;
+        } else {
+            SCLogDebug("link %s -> %s failed: %s", tmpname, content, strerror(errno));
+        }
+
+        if (stored)
+            (void)unlink(tmpname);
+    }
+
+    if (!stored) {
+        snprintf(content, sizeof(content), "%s/file.%u", writer.dir, wf->file_id);
+        if (rename(tmpname, content) != 0) {
+            SCLogDebug("rename %s -> %s failed: %s", tmpname, content, strerror(errno));
+        }
+    }
+
+    FilestoreWriterWriteMeta(wf, job, content, dup);
+    FilestoreWriterFileFree(wf);
+}
+
+/**
+ *  \brief process a list of jobs taken from the queue
+ *
+ *  \retval size memory of the jobs processed and freed
+ */
+static uint64_t FilestoreWriterProcess(FilestoreJob *list)
+{
+    struct iovec iov[FILESTORE_WRITER_IOV_MAX];
+    uint64_t size = 0;
+
+    while (list != NULL) {
+        FilestoreJob *job = list;
+
+        if (job->type == FILESTORE_JOB_DATA) {
+            /* gather the run of data for this file */
+            FilestoreJob *j = job;
+            int cnt = 0;
+            while (j != NULL && j->type == FILESTORE_JOB_DATA &&
+                   j->file_id == job->file_id && cnt < FILESTORE_WRITER_IOV_MAX) {
+                iov[cnt].iov_base = j->data;
+                iov[cnt].iov_len = j->len;
+                cnt++;
+                j = j->next;
+            }
+            FilestoreWriterWriteData(job->file_id, iov, cnt);
+
+            while (list != j) {
+                job = list;
+                list = list->next;
+                size += sizeof(FilestoreJob) + job->len;
+                SCFree(job);
+            }
+            continue;
+        }
+
+        list = job->next;
+        if (job->type == FILESTORE_JOB_OPEN) {
+            FilestoreWriterOpenFile(job);
+        } else {
+            FilestoreWriterCloseFile(job);
+        }
+        size += sizeof(FilestoreJob) + job->len;
+        SCFree(job);
+    }
+
+    return size;
+}
+
+/**
+ *  \brief close the files still open at shutdown. They are stored by
+ *         their file id like in the normal mode and their meta says they
+ *         are truncated.
+ */
+static void FilestoreWriterCloseAll(void)
+{
+    char meta[128];
+    FilestoreJob job;
+    uint32_t i;
+
+    memset(&job, 0, sizeof(job));
+    job.type = FILESTORE_JOB_CLOSE;
+    job.data = (uint8_t *)meta;
+
+    for (i = 0; i < FILESTORE_WRITER_FILES_SIZE; i++) {
+        while (writer.files[i] != NULL) {
+            FilestoreWriterFile *wf = writer.files[i];
+            int len = snprintf(meta, sizeof(meta), "STATE:             TRUNCATED\n"
+                    "SIZE:              %"PRIu64"\n", wf->size);
+
+            job.file_id = wf->file_id;
+            job.len = (len > 0 && len < (int)sizeof(meta)) ? (uint32_t)len : 0;
+            FilestoreWriterCloseFile(&job);
+        }
+    }
+}
+
+/**
+ *  \brief wake up the writer so it sees the kill flag
+ */
+static void FilestoreWriterShutdownHandler(ThreadVars *tv)
+{
+    SCMutexLock(&writer.lock);
+    SCCondSignal(&writer.cond);
+    SCMutexUnlock(&writer.lock);
+}
+
+static void *FilestoreWriterThread(void *td)
+{
+    ThreadVars *tv = (ThreadVars *)td;
+
+    /* block usr2.  usr2 to be handled by the main thread only */
+    UtilSignalBlock(SIGUSR2);
+
+    if (SCSetThreadName(tv->name) < 0) {
+        SCLogWarning(SC_ERR_THREAD_INIT, "Unable to set thread name");
+    }
+
+    TmThreadsSetFlag(tv, THV_INIT_DONE);
+
+    SCMutexLock(&writer.lock);
+    while (1) {
+        while (writer.head == NULL && !TmThreadsCheckFlag(tv, THV_KILL))
+            SCCondWait(&writer.cond, &writer.lock);
+
+        /* when killed we still drain the queue */
+        if (writer.head == NULL)
+            break;
+
+        FilestoreJob *list = writer.head;
+        writer.head = writer.tail = NULL;
+        SCMutexUnlock(&writer.lock);
+
+        uint64_t size = FilestoreWriterProcess(list);
+
+        SCMutexLock(&writer.lock);
+        writer.memuse -= size;
+        SCCondBroadcast(&writer.space_cond);
+    }
+    /* refuse new jobs, wake up loggers still waiting for space */
+    writer.running = 0;
+    SCCondBroadcast(&writer.space_cond);
+    SCMutexUnlock(&writer.lock);
+
+    FilestoreWriterCloseAll();
+
+    TmThreadsSetFlag(tv, THV_RUNNING_DONE);
+    TmThreadWaitForFlag(tv, THV_DEINIT);
+    TmThreadsSetFlag(tv, THV_CLOSED);
+    return NULL;
+}
+
+static FilestoreJob *FilestoreJobAlloc(uint8_t type, unsigned int file_id,
+        const void *data, uint32_t len)
+{
+    FilestoreJob *job = SCMalloc(sizeof(FilestoreJob) + len);
+    if (unlikely(job == NULL))
+        return NULL;
+    memset(job, 0, sizeof(FilestoreJob));
+
+    job->type = type;
+    job->file_id = file_id;
+    job->data = (uint8_t *)job + sizeof(FilestoreJob);
+    job->len = len;
+    if (len > 0)
+        memcpy(job->data, data, len);
+    return job;
+}
+
+/**
+ *  \brief hand a job to the writer thread. Waits if the queue is over
+ *         its memcap.
+ *
+ *  \retval 0 ok
+ *  \retval -1 writer not running, job is freed
+ */
+static int FilestoreJobEnqueue(FilestoreJob *job)
+{
+    uint64_t size = sizeof(FilestoreJob) + job->len;
+
+    SCMutexLock(&writer.lock);
+    if (!writer.running) {
+        SCMutexUnlock(&writer.lock);
+        SCFree(job);
+        return -1;
+    }
+
+    /* a single job larger than the memcap is let through on an empty queue */
+    while (writer.running && writer.memuse > 0 &&
+           writer.memuse + size > writer.memcap) {
+        writer.stats.waits++;
+        SCCondWait(&writer.space_cond, &writer.lock);
+    }
+    if (!writer.running) {
+        SCMutexUnlock(&writer.lock);
+        SCFree(job);
+        return -1;
+    }
+
+    writer.memuse += size;
+    if (writer.tail == NULL) {
+        writer.head = job;
+    } else {
+        writer.tail->next = job;
+    }
+    writer.tail = job;
+
+    SCCondSignal(&writer.cond);
+    SCMutexUnlock(&writer.lock);
+    return 0;
+}
+
+/**
+ *  \brief queue the creation of a file
+ *
+ *  \param file_id id of the file
+ *  \param meta start of the meta file, written when the file is closed
+ *  \param meta_len length of meta
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int LogFilestoreWriterOpen(unsigned int file_id, const char *meta, uint32_t meta_len)
+{
+    FilestoreJob *job = FilestoreJobAlloc(FILESTORE_JOB_OPEN, file_id, meta, meta_len);
+    if (job == NULL)
+        return -1;
+    return FilestoreJobEnqueue(job);
+}
+
+/**
+ *  \brief queue a chunk of file data, the data is copied
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int LogFilestoreWriterData(unsigned int file_id, const uint8_t *data, uint32_t len)
+{
+    FilestoreJob *job = FilestoreJobAlloc(FILESTORE_JOB_DATA, file_id, data, len);
+    if (job == NULL)
+        return -1;
+    return FilestoreJobEnqueue(job);
+}
+
+/**
+ *  \brief queue the closing of a file
+ *
+ *  \param file_id id of the file
+ *  \param hash sha256 of the content or NULL if there is none, e.g. for
+ *              truncated files. Without a hash the file is stored by id.
+ *  \param meta end of the meta file
+ *  \param meta_len length of meta
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int LogFilestoreWriterClose(unsigned int file_id, const uint8_t *hash,
+        const char *meta, uint32_t meta_len)
+{
+    FilestoreJob *job = FilestoreJobAlloc(FILESTORE_JOB_CLOSE, file_id, meta, meta_len);
+    if (job == NULL)
+        return -1;
+
+    if (hash != NULL) {
+        memcpy(job->hash, hash, FILESTORE_WRITER_HASH_LEN);
+        job->has_hash = 1;
+    }
+    return FilestoreJobEnqueue(job);
+}
+
+/**
+ *  \brief start the writer thread
+ *
+ *  \param dir file-store directory
+ *  \param memcap max memory of the queued jobs
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int LogFilestoreWriterStart(const char *dir, uint64_t memcap)
+{
+    char tmpdir[PATH_MAX];
+
+    memset(&writer, 0, sizeof(writer));
+    strlcpy(writer.dir, dir, sizeof(writer.dir));
+    writer.memcap = memcap;
+
+    (void)mkdir(writer.dir, S_IRWXU|S_IXGRP|S_IRGRP);
+    snprintf(tmpdir, sizeof(tmpdir), "%s/tmp", writer.dir);
+    if (mkdir(tmpdir, S_IRWXU|S_IXGRP|S_IRGRP) != 0 && errno != EEXIST) {
+        SCLogError(SC_ERR_LOGDIR_CONFIG, "Cannot create file-store tmp "
+                "directory %s: %s", tmpdir, strerror(errno));
+        return -1;
+    }
+
+    ThreadVars *tv = TmThreadCreateMgmtThread("FilestoreWriter",
+            FilestoreWriterThread, 0);
+    if (tv == NULL) {
+        SCLogError(SC_ERR_THREAD_CREATE, "failed to create file-store writer "
+                "thread");
+        return -1;
+    }
+    tv->InShutdownHandler = FilestoreWriterShutdownHandler;
+
+    SCMutexInit(&writer.lock, NULL);
+    SCCondInit(&writer.cond, NULL);
+    SCCondInit(&writer.space_cond, NULL);
+    writer.running = 1;
+
+    if (TmThreadSpawn(tv) != TM_ECODE_OK) {
+        SCLogError(SC_ERR_THREAD_SPAWN, "failed to spawn file-store writer "
+                "thread");
+        TmThreadFree(tv);
+        writer.running = 0;
+        SCCondDestroy(&writer.space_cond);
+        SCCondDestroy(&writer.cond);
+        SCMutexDestroy(&writer.lock);
+        return -1;
+    }
+    /* the writer has to outlive the packet threads, as files are still
+     * closed when their flows are flushed at shutdown. So keep it out of
+     * the management threads that are killed before that and stop it in
+     * LogFilestoreWriterStop() instead. */
+    TmThreadRemove(tv, TVT_MGMT);
+    writer.tv = tv;
+
+    SCLogInfo("file-store writer started, queue memcap %"PRIu64, memcap);
+    return 0;
+}
+
+/**
+ *  \brief stop the writer thread after it wrote out what is queued. Has
+ *         to be called after the packet threads are gone, e.g. from the
+ *         output ctx deinit.
+ */
+void LogFilestoreWriterStop(void)
+{
+    if (writer.tv == NULL)
+        return;
+
+    TmThreadKillThread(writer.tv);
+    TmThreadFree(writer.tv);
+    writer.tv = NULL;
+
+    SCCondDestroy(&writer.space_cond);
+    SCCondDestroy(&writer.cond);
+    SCMutexDestroy(&writer.lock);
+}
+
+/**
+ *  \brief get the writer stats. Only exact after LogFilestoreWriterStop().
+ */
+void LogFilestoreWriterGetStats(LogFilestoreWriterStats *stats)
+{
+    *stats = writer.stats;
+}
+
+#ifdef UNITTESTS
+static int FilestoreWriterTestReadFile(const char *name, char *buf, size_t size)
+{
+    int fd = open(name, O_RDONLY);
+    if (fd == -1)
+        return -1;
+    ssize_t r = read(fd, buf, size - 1);
+    close(fd);
+    if (r < 0)
+        return -1;
+    buf[r] = '\0';
+    return (int)r;
+}
+
+/**
+ * \test identical content is stored once, each file gets its own meta
+ *       and files without a hash are stored by id.
+ */
+static int LogFilestoreWriterTest01(void)
+{
+    char dir[PATH_MAX];
+    char name[PATH_MAX];
+    char content[PATH_MAX];
+    char buf[1024];
+    uint8_t hash[FILESTORE_WRITER_HASH_LEN];
+    LogFilestoreWriterStats stats;
+    int result = 0;
+    int i;
+
+    memset(hash, 0xab, sizeof(hash));
+    snprintf(dir, sizeof(dir), "/tmp/filestore-writer-test.%d", (int)getpid());
+    snprintf(content, sizeof(content), "%s/ab/", dir);
+    for (i = 0; i < FILESTORE_WRITER_HASH_LEN; i++)
+        strlcat(content, "ab", sizeof(content));
+
+    if (LogFilestoreWriterStart(dir, 1024 * 1024) != 0)
+        goto end;
+
+    if (LogFilestoreWriterOpen(1, "META1\n", 6) != 0 ||
+        LogFilestoreWriterOpen(2, "META2\n", 6) != 0 ||
+        LogFilestoreWriterData(1, (uint8_t *)"con", 3) != 0 ||
+        LogFilestoreWriterData(2, (uint8_t *)"content", 7) != 0 ||
+        LogFilestoreWriterData(1, (uint8_t *)"tent", 4) != 0 ||
+        LogFilestoreWriterClose(1, hash, "END1\n", 5) != 0 ||
+        LogFilestoreWriterClose(2, hash, "END2\n", 5) != 0 ||
+        LogFilestoreWriterOpen(3, "META3\n", 6) != 0 ||
+        LogFilestoreWriterData(3, (uint8_t *)"other", 5) != 0 ||
+        LogFilestoreWriterClose(3, NULL, "END3\n", 5) != 0) {
+        printf("queueing failed: ");
+        LogFilestoreWriterStop();
+        goto end;
+    }
+
+    LogFilestoreWriterStop();
+    LogFilestoreWriterGetStats(&stats);
+
+    if (stats.files != 3 || stats.unique != 1 || stats.duplicates != 1 ||
+        stats.bytes != 19 || stats.bytes_dup != 7) {
+        printf("stats files %"PRIu64" unique %"PRIu64" dups %"PRIu64" bytes "
+                "%"PRIu64" dup bytes %"PRIu64": ", stats.files, stats.unique,
+                stats.duplicates, stats.bytes, stats.bytes_dup);
+        goto end;
+    }
+
+    if (FilestoreWriterTestReadFile(content, buf, sizeof(buf)) != 7 ||
+        strcmp(buf, "content") != 0) {
+        printf("content file %s: ", content);
+        goto end;
+    }
+
+    snprintf(name, sizeof(name), "%s/file.3", dir);
+    if (FilestoreWriterTestReadFile(name, buf, sizeof(buf)) != 5 ||
+        strcmp(buf, "other") != 0) {
+        printf("file %s: ", name);
+        goto end;
+    }
+
+    snprintf(name, sizeof(name), "%s/file.2.meta", dir);
+    if (FilestoreWriterTestReadFile(name, buf, sizeof(buf)) < 0 ||
+        strncmp(buf, "META2\nEND2\nCONTENT:", 19) != 0 ||
+        strstr(buf, content) == NULL ||
+        strstr(buf, "DUPLICATE:         yes") == NULL) {
+        printf("meta file %s: \"%s\": ", name, buf);
+        goto end;
+    }
+
+    snprintf(name, sizeof(name), "%s/file.1.meta", dir);
+    if (FilestoreWriterTestReadFile(name, buf, sizeof(buf)) < 0 ||
+        strstr(buf, "DUPLICATE:         no") == NULL) {
+        printf("meta file %s: \"%s\": ", name, buf);
+        goto end;
+    }
+
+    result = 1;
+end:
+    (void)unlink(content);
+    for (i = 1; i <= 3; i++) {
+        snprintf(name, sizeof(name), "%s/file.%d.meta", dir, i);
+        (void)unlink(name);
+    }
+    snprintf(name, sizeof(name), "%s/file.3", dir);
+    (void)unlink(name);
+    snprintf(name, sizeof(name), "%s/ab", dir);
+    (void)rmdir(name);
+    snprintf(name, sizeof(name), "%s/tmp", dir);
+    (void)rmdir(name);
+    (void)rmdir(dir);
+    return result;
+}
+
+/**
+ * \test a tiny memcap makes the logger wait for the writer, nothing is
+ *       lost. A file left open at stop is still stored, as truncated.
+ */
+static int LogFilestoreWriterTest02(void)
+{
+    char dir[PATH_MAX];
+    char name[PATH_MAX];
+    char buf[1024];
+    uint8_t data[1000];
+    LogFilestoreWriterStats stats;
+    struct stat st;
+    int result = 0;
+    int i;
+
+    memset(data, 'x', sizeof(data));
+    snprintf(dir, sizeof(dir), "/tmp/filestore-writer-test2.%d", (int)getpid());
+
+    if (LogFilestoreWriterStart(dir, 1) != 0)
+        goto end;
+
+    if (LogFilestoreWriterOpen(1, NULL, 0) != 0) {
+        LogFilestoreWriterStop();
+        goto end;
+    }
+    for (i = 0; i < 1000; i++) {
+        if (LogFilestoreWriterData(1, data, sizeof(data)) != 0) {
+            LogFilestoreWriterStop();
+            goto end;
+        }
+    }
+
+    LogFilestoreWriterStop();
+    LogFilestoreWriterGetStats(&stats);
+
+    if (stats.files != 1 || stats.bytes != 1000 * sizeof(data)) {
+        printf("files %"PRIu64", bytes %"PRIu64": ", stats.files, stats.bytes);
+        goto end;
+    }
+
+    snprintf(name, sizeof(name), "%s/file.1", dir);
+    if (stat(name, &st) != 0 || (uint64_t)st.st_size != 1000 * sizeof(data)) {
+        printf("file %s: ", name);
+        goto end;
+    }
+
+    snprintf(name, sizeof(name), "%s/file.1.meta", dir);
+    if (FilestoreWriterTestReadFile(name, buf, sizeof(buf)) < 0 ||
+        strstr(buf, "STATE:             TRUNCATED") == NULL) {
+        printf("meta file %s: \"%s\": ", name, buf);
+        goto end;
+    }
+
+    result = 1;
+end:
+    snprintf(name, sizeof(name), "%s/file.1", dir);
+    (void)unlink(name);
+    snprintf(name, sizeof(name), "%s/file.1.meta", dir);
+    (void)unlink(name);
+    snprintf(name, sizeof(name), "%s/tmp", dir);
+    (void)rmdir(name);
+    (void)rmdir(dir);
+    return result;
+}
+
+/**
+ * \test the unix socket teardown order: the management threads are killed
+ *       and freed first, then the flushed flows still close their files,
+ *       then the outputs are shut down.
+ */
+static int LogFilestoreWriterTest03(void)
+{
+    char dir[PATH_MAX];
+    char name[PATH_MAX];
+    char buf[1024];
+    LogFilestoreWriterStats stats;
+    int result = 0;
+
+    snprintf(dir, sizeof(dir), "/tmp/filestore-writer-test3.%d", (int)getpid());
+
+    if (LogFilestoreWriterStart(dir, 1024 * 1024) != 0)
+        goto end;
+
+    if (LogFilestoreWriterOpen(1, "META1\n", 6) != 0) {
+        LogFilestoreWriterStop();
+        goto end;
+    }
+
+    TmThreadKillThreadsFamily(TVT_MGMT);
+    TmThreadClearThreadsFamily(TVT_MGMT);
+
+    /* FlowForceReassembly() */
+    if (LogFilestoreWriterData(1, (uint8_t *)"flushed", 7) != 0 ||
+        LogFilestoreWriterClose(1, NULL, "END1\n", 5) != 0) {
+        printf("writer stopped with the management threads: ");
+        LogFilestoreWriterStop();
+        goto end;
+    }
+
+    /* RunModeShutDown() */
+    LogFilestoreWriterStop();
+    LogFilestoreWriterGetStats(&stats);
+
+    if (stats.files != 1 || stats.bytes != 7) {
+        printf("files %"PRIu64", bytes %"PRIu64": ", stats.files, stats.bytes);
+        goto end;
+    }
+
+    snprintf(name, sizeof(name), "%s/file.1", dir);
+    if (FilestoreWriterTestReadFile(name, buf, sizeof(buf)) != 7 ||
+        strcmp(buf, "flushed") != 0) {
+        printf("file %s: ", name);
+        goto end;
+    }
+
+    /* the next run starts a new writer */
+    if (LogFilestoreWriterStart(dir, 1024 * 1024) != 0) {
+        printf("restart failed: ");
+        goto end;
+    }
+    LogFilestoreWriterStop();
+
+    result = 1;
+end:
+    snprintf(name, sizeof(name), "%s/file.1", dir);
+    (void)unlink(name);
+    snprintf(name, sizeof(name), "%s/file.1.meta", dir);
+    (void)unlink(name);
+    snprintf(name, sizeof(name), "%s/tmp", dir);
+    (void)rmdir(name);
+    (void)rmdir(dir);
+    return result;
+}
+#endif /* UNITTESTS */
+
+void LogFilestoreWriterRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("LogFilestoreWriterTest01", LogFilestoreWriterTest01, 1);
+    UtRegisterTest("LogFilestoreWriterTest02", LogFilestoreWriterTest02, 1);
+    UtRegisterTest("LogFilestoreWriterTest03", LogFilestoreWriterTest03, 1);
+#endif /* UNITTESTS */
+}
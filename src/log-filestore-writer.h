@@ -0,0 +1,43 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __LOG_FILESTORE_WRITER_H__
+#define __LOG_FILESTORE_WRITER_H__
+
+#define FILESTORE_WRITER_HASH_LEN   32  /**< sha256 */
+
+typedef struct LogFilestoreWriterStats_ {
+    uint64_t files;         /**< files closed by the writer */
+    uint64_t unique;        /**< files stored as new content */
+    uint64_t duplicates;    /**< files whose content was already stored */
+    uint64_t bytes;         /**< bytes written */
+    uint64_t bytes_dup;     /**< bytes of duplicate content, not kept */
+    uint64_t waits;         /**< times a logger waited for queue space */
+} LogFilestoreWriterStats;
+
+int LogFilestoreWriterStart(const char *, uint64_t);
+void LogFilestoreWriterStop(void);
+
+int LogFilestoreWriterOpen(unsigned int, const char *, uint32_t);
+int LogFilestoreWriterData(unsigned int, const uint8_t *, uint32_t);
+int LogFilestoreWriterClose(unsigned int, const uint8_t *, const char *, uint32_t);
+
+void LogFilestoreWriterGetStats(LogFilestoreWriterStats *);
+
+void LogFilestoreWriterRegisterTests(void);
+
+#endif /* __LOG_FILESTORE_WRITER_H__ */
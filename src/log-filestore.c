@@ -50,7 +50,9 @@
 #include "output.h"
 
 #include "log-file.h"
+#include "log-filestore-writer.h"
 #include "util-logopenfile.h"
+#include "util-misc.h"
 
 #include "app-layer-htp.h"
 #include "util-memcmp.h"
@@ -71,6 +73,11 @@ static void LogFilestoreLogDeInitCtx(OutputCtx *);
 SC_ATOMIC_DECLARE(unsigned int, file_id);
 static char g_logfile_base_dir[PATH_MAX] = "/tmp";
 static char g_waldo[PATH_MAX] = "";
+/** store files by content through the writer thread */
+static int g_filestore_dedup = 0;
+
+/** default memcap of the dedup writer queue */
+#define FILESTORE_WRITER_DEFAULT_MEMCAP (64 * 1024 * 1024)
 
 void TmModuleLogFilestoreRegister (void) {
     tmm_modules[TMM_FILESTORE].name = MODULE_NAME;
@@ -95,73 +102,208 @@ typedef struct LogFilestoreLogThread_ {
     uint32_t file_cnt;
 } LogFilestoreLogThread;
 
-static void LogFilestoreMetaGetUri(FILE *fp, Packet *p, File *ff) {
+/** size of the buffers the meta data is built in */
+#define META_BUFFER_SIZE 8192
+
+/** \brief print raw data to the meta buffer, escaped like PrintRawUriFp */
+static void LogFilestoreMetaPrintRaw(char *buf, uint32_t *offset, uint32_t size,
+                                     uint8_t *data, uint32_t data_len) {
+    uint32_t u;
+
+    for (u = 0; u < data_len; u++) {
+        if (isprint(data[u]) && data[u] != '\"') {
+            PrintBufferData(buf, offset, size, "%c", data[u]);
+        } else {
+            PrintBufferData(buf, offset, size, "\\x%02X", data[u]);
+        }
+    }
+}
+
+static void LogFilestoreMetaGetUri(char *buf, uint32_t *offset, uint32_t size,
+                                   Packet *p, File *ff) {
     HtpState *htp_state = (HtpState *)p->flow->alstate;
-    if (htp_state != NULL) {
+    if (htp_state != NULL && p->flow->alproto == ALPROTO_HTTP) {
         htp_tx_t *tx = AppLayerGetTx(ALPROTO_HTTP, htp_state, ff->txid);
         if (tx != NULL) {
             HtpTxUserData *tx_ud = htp_tx_get_user_data(tx);
             if (tx_ud->request_uri_normalized != NULL) {
-                PrintRawUriFp(fp, bstr_ptr(tx_ud->request_uri_normalized),
-                              bstr_len(tx_ud->request_uri_normalized));
+                LogFilestoreMetaPrintRaw(buf, offset, size,
+                        bstr_ptr(tx_ud->request_uri_normalized),
+                        bstr_len(tx_ud->request_uri_normalized));
             }
             return;
         }
     }
 
-    fprintf(fp, "<unknown>");
+    PrintBufferData(buf, offset, size, "<unknown>");
 }
 
-static void LogFilestoreMetaGetHost(FILE *fp, Packet *p, File *ff) {
+static void LogFilestoreMetaGetHost(char *buf, uint32_t *offset, uint32_t size,
+                                    Packet *p, File *ff) {
     HtpState *htp_state = (HtpState *)p->flow->alstate;
-    if (htp_state != NULL) {
+    if (htp_state != NULL && p->flow->alproto == ALPROTO_HTTP) {
         htp_tx_t *tx = AppLayerGetTx(ALPROTO_HTTP, htp_state, ff->txid);
         if (tx != NULL && tx->request_hostname != NULL) {
-            PrintRawUriFp(fp, (uint8_t *)bstr_ptr(tx->request_hostname),
-                          bstr_len(tx->request_hostname));
+            LogFilestoreMetaPrintRaw(buf, offset, size,
+                    (uint8_t *)bstr_ptr(tx->request_hostname),
+                    bstr_len(tx->request_hostname));
             return;
         }
     }
 
-    fprintf(fp, "<unknown>");
+    PrintBufferData(buf, offset, size, "<unknown>");
 }
 
-static void LogFilestoreMetaGetReferer(FILE *fp, Packet *p, File *ff) {
+static void LogFilestoreMetaGetReferer(char *buf, uint32_t *offset, uint32_t size,
+                                       Packet *p, File *ff) {
     HtpState *htp_state = (HtpState *)p->flow->alstate;
-    if (htp_state != NULL) {
+    if (htp_state != NULL && p->flow->alproto == ALPROTO_HTTP) {
         htp_tx_t *tx = AppLayerGetTx(ALPROTO_HTTP, htp_state, ff->txid);
         if (tx != NULL) {
             htp_header_t *h = NULL;
             h = (htp_header_t *)htp_table_get_c(tx->request_headers,
                                                 "Referer");
             if (h != NULL) {
-                PrintRawUriFp(fp, (uint8_t *)bstr_ptr(h->value),
-                              bstr_len(h->value));
+                LogFilestoreMetaPrintRaw(buf, offset, size,
+                        (uint8_t *)bstr_ptr(h->value), bstr_len(h->value));
                 return;
             }
         }
     }
 
-    fprintf(fp, "<unknown>");
+    PrintBufferData(buf, offset, size, "<unknown>");
 }
 
-static void LogFilestoreMetaGetUserAgent(FILE *fp, Packet *p, File *ff) {
+static void LogFilestoreMetaGetUserAgent(char *buf, uint32_t *offset, uint32_t size,
+                                         Packet *p, File *ff) {
     HtpState *htp_state = (HtpState *)p->flow->alstate;
-    if (htp_state != NULL) {
+    if (htp_state != NULL && p->flow->alproto == ALPROTO_HTTP) {
         htp_tx_t *tx = AppLayerGetTx(ALPROTO_HTTP, htp_state, ff->txid);
         if (tx != NULL) {
             htp_header_t *h = NULL;
             h = (htp_header_t *)htp_table_get_c(tx->request_headers,
                                                 "User-Agent");
             if (h != NULL) {
-                PrintRawUriFp(fp, (uint8_t *)bstr_ptr(h->value),
-                              bstr_len(h->value));
+                LogFilestoreMetaPrintRaw(buf, offset, size,
+                        (uint8_t *)bstr_ptr(h->value), bstr_len(h->value));
                 return;
             }
         }
     }
 
-    fprintf(fp, "<unknown>");
+    PrintBufferData(buf, offset, size, "<unknown>");
+}
+
+/**
+ *  \brief build the part of the meta data that is known when the file
+ *         is opened: time, src/dst/sp/dp/proto and the http info.
+ *
+ *  \retval len length of the meta data in buf
+ */
+static uint32_t LogFilestoreLogBuildMeta(Packet *p, File *ff, int ipver,
+                                         char *buf, uint32_t size) {
+    uint32_t offset = 0;
+    char timebuf[64];
+
+    CreateTimeString(&p->ts, timebuf, sizeof(timebuf));
+
+    PrintBufferData(buf, &offset, size, "TIME:              %s\n", timebuf);
+    if (p->pcap_cnt > 0) {
+        PrintBufferData(buf, &offset, size, "PCAP PKT NUM:      %"PRIu64"\n", p->pcap_cnt);
+    }
+
+    char srcip[46], dstip[46];
+    Port sp, dp;
+    switch (ipver) {
+        case AF_INET:
+            PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p), srcip, sizeof(srcip));
+            PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p), dstip, sizeof(dstip));
+            break;
+        case AF_INET6:
+            PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p), srcip, sizeof(srcip));
+            PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p), dstip, sizeof(dstip));
+            break;
+        default:
+            strlcpy(srcip, "<unknown>", sizeof(srcip));
+            strlcpy(dstip, "<unknown>", sizeof(dstip));
+            break;
+    }
+    sp = p->sp;
+    dp = p->dp;
+
+    PrintBufferData(buf, &offset, size, "SRC IP:            %s\n", srcip);
+    PrintBufferData(buf, &offset, size, "DST IP:            %s\n", dstip);
+    PrintBufferData(buf, &offset, size, "PROTO:             %" PRIu32 "\n", p->proto);
+    if (PKT_IS_TCP(p) || PKT_IS_UDP(p)) {
+        PrintBufferData(buf, &offset, size, "SRC PORT:          %" PRIu16 "\n", sp);
+        PrintBufferData(buf, &offset, size, "DST PORT:          %" PRIu16 "\n", dp);
+    }
+    PrintBufferData(buf, &offset, size, "HTTP URI:          ");
+    LogFilestoreMetaGetUri(buf, &offset, size, p, ff);
+    PrintBufferData(buf, &offset, size, "\n");
+    PrintBufferData(buf, &offset, size, "HTTP HOST:         ");
+    LogFilestoreMetaGetHost(buf, &offset, size, p, ff);
+    PrintBufferData(buf, &offset, size, "\n");
+    PrintBufferData(buf, &offset, size, "HTTP REFERER:      ");
+    LogFilestoreMetaGetReferer(buf, &offset, size, p, ff);
+    PrintBufferData(buf, &offset, size, "\n");
+    PrintBufferData(buf, &offset, size, "HTTP USER AGENT:   ");
+    LogFilestoreMetaGetUserAgent(buf, &offset, size, p, ff);
+    PrintBufferData(buf, &offset, size, "\n");
+    PrintBufferData(buf, &offset, size, "FILENAME:          ");
+    LogFilestoreMetaPrintRaw(buf, &offset, size, ff->name, ff->name_len);
+    PrintBufferData(buf, &offset, size, "\n");
+
+    return offset;
+}
+
+/**
+ *  \brief build the part of the meta data that is known when the file
+ *         is closed: magic, state, hashes and size.
+ *
+ *  \retval len length of the meta data in buf
+ */
+static uint32_t LogFilestoreLogBuildCloseMeta(File *ff, char *buf, uint32_t size) {
+    uint32_t offset = 0;
+
+    PrintBufferData(buf, &offset, size, "MAGIC:             %s\n",
+            ff->magic ? ff->magic : "<unknown>");
+
+    switch (ff->state) {
+        case FILE_STATE_CLOSED:
+            PrintBufferData(buf, &offset, size, "STATE:             CLOSED\n");
+#ifdef HAVE_NSS
+            if (ff->flags & FILE_MD5) {
+                PrintBufferData(buf, &offset, size, "MD5:               ");
+                size_t x;
+                for (x = 0; x < sizeof(ff->md5); x++) {
+                    PrintBufferData(buf, &offset, size, "%02x", ff->md5[x]);
+                }
+                PrintBufferData(buf, &offset, size, "\n");
+            }
+            if (ff->flags & FILE_SHA256) {
+                PrintBufferData(buf, &offset, size, "SHA256:            ");
+                size_t x;
+                for (x = 0; x < sizeof(ff->sha256); x++) {
+                    PrintBufferData(buf, &offset, size, "%02x", ff->sha256[x]);
+                }
+                PrintBufferData(buf, &offset, size, "\n");
+            }
+#endif
+            break;
+        case FILE_STATE_TRUNCATED:
+            PrintBufferData(buf, &offset, size, "STATE:             TRUNCATED\n");
+            break;
+        case FILE_STATE_ERROR:
+            PrintBufferData(buf, &offset, size, "STATE:             ERROR\n");
+            break;
+        default:
+            PrintBufferData(buf, &offset, size, "STATE:             UNKNOWN\n");
+            break;
+    }
+    PrintBufferData(buf, &offset, size, "SIZE:              %"PRIu64"\n", ff->size);
+
+    return offset;
 }
 
 static void LogFilestoreLogCreateMetaFile(Packet *p, File *ff, char *filename, int ipver) {
@@ -169,57 +311,12 @@ static void LogFilestoreLogCreateMetaFile(Packet *p, File *ff, char *filename, i
     snprintf(metafilename, sizeof(metafilename), "%s.meta", filename);
     FILE *fp = fopen(metafilename, "w+");
     if (fp != NULL) {
-        char timebuf[64];
-
-        CreateTimeString(&p->ts, timebuf, sizeof(timebuf));
-
-        fprintf(fp, "TIME:              %s\n", timebuf);
-        if (p->pcap_cnt > 0) {
-            fprintf(fp, "PCAP PKT NUM:      %"PRIu64"\n", p->pcap_cnt);
-        }
+        char meta[META_BUFFER_SIZE];
+        uint32_t meta_len = LogFilestoreLogBuildMeta(p, ff, ipver, meta, sizeof(meta));
 
-        char srcip[46], dstip[46];
-        Port sp, dp;
-        switch (ipver) {
-            case AF_INET:
-                PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p), srcip, sizeof(srcip));
-                PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p), dstip, sizeof(dstip));
-                break;
-            case AF_INET6:
-                PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p), srcip, sizeof(srcip));
-                PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p), dstip, sizeof(dstip));
-                break;
-            default:
-                strlcpy(srcip, "<unknown>", sizeof(srcip));
-                strlcpy(dstip, "<unknown>", sizeof(dstip));
-                break;
+        if (fwrite(meta, meta_len, 1, fp) != 1) {
+            SCLogDebug("writing %s failed: %s", metafilename, strerror(errno));
         }
-        sp = p->sp;
-        dp = p->dp;
-
-        fprintf(fp, "SRC IP:            %s\n", srcip);
-        fprintf(fp, "DST IP:            %s\n", dstip);
-        fprintf(fp, "PROTO:             %" PRIu32 "\n", p->proto);
-        if (PKT_IS_TCP(p) || PKT_IS_UDP(p)) {
-            fprintf(fp, "SRC PORT:          %" PRIu16 "\n", sp);
-            fprintf(fp, "DST PORT:          %" PRIu16 "\n", dp);
-        }
-        fprintf(fp, "HTTP URI:          ");
-        LogFilestoreMetaGetUri(fp, p, ff);
-        fprintf(fp, "\n");
-        fprintf(fp, "HTTP HOST:         ");
-        LogFilestoreMetaGetHost(fp, p, ff);
-        fprintf(fp, "\n");
-        fprintf(fp, "HTTP REFERER:      ");
-        LogFilestoreMetaGetReferer(fp, p, ff);
-        fprintf(fp, "\n");
-        fprintf(fp, "HTTP USER AGENT:   ");
-        LogFilestoreMetaGetUserAgent(fp, p, ff);
-        fprintf(fp, "\n");
-        fprintf(fp, "FILENAME:          ");
-        PrintRawUriFp(fp, ff->name, ff->name_len);
-        fprintf(fp, "\n");
-
         fclose(fp);
     }
 }
@@ -232,41 +329,38 @@ static void LogFilestoreLogCloseMetaFile(File *ff) {
     snprintf(metafilename, sizeof(metafilename), "%s.meta", filename);
     FILE *fp = fopen(metafilename, "a");
     if (fp != NULL) {
-        fprintf(fp, "MAGIC:             %s\n",
-                ff->magic ? ff->magic : "<unknown>");
+        char meta[META_BUFFER_SIZE];
+        uint32_t meta_len = LogFilestoreLogBuildCloseMeta(ff, meta, sizeof(meta));
 
-        switch (ff->state) {
-            case FILE_STATE_CLOSED:
-                fprintf(fp, "STATE:             CLOSED\n");
-#ifdef HAVE_NSS
-                if (ff->flags & FILE_MD5) {
-                    fprintf(fp, "MD5:               ");
-                    size_t x;
-                    for (x = 0; x < sizeof(ff->md5); x++) {
-                        fprintf(fp, "%02x", ff->md5[x]);
-                    }
-                    fprintf(fp, "\n");
-                }
-#endif
-                break;
-            case FILE_STATE_TRUNCATED:
-                fprintf(fp, "STATE:             TRUNCATED\n");
-                break;
-            case FILE_STATE_ERROR:
-                fprintf(fp, "STATE:             ERROR\n");
-                break;
-            default:
-                fprintf(fp, "STATE:             UNKNOWN\n");
-                break;
+        if (fwrite(meta, meta_len, 1, fp) != 1) {
+            SCLogDebug("writing %s failed: %s", metafilename, strerror(errno));
         }
-        fprintf(fp, "SIZE:              %"PRIu64"\n", ff->size);
-
         fclose(fp);
     } else {
         SCLogInfo("opening %s failed: %s", metafilename, strerror(errno));
     }
 }
 
+/**
+ *  \brief finish storing a file: complete the meta file or, in dedup mode,
+ *         hand the file to the writer to move it into the content store.
+ */
+static void LogFilestoreLogCloseFile(File *ff) {
+    if (g_filestore_dedup) {
+        char meta[META_BUFFER_SIZE];
+        uint32_t meta_len = LogFilestoreLogBuildCloseMeta(ff, meta, sizeof(meta));
+        const uint8_t *hash = NULL;
+#ifdef HAVE_NSS
+        /* only complete files are stored by content */
+        if (ff->state == FILE_STATE_CLOSED && (ff->flags & FILE_SHA256))
+            hash = ff->sha256;
+#endif
+        (void)LogFilestoreWriterClose(ff->file_id, hash, meta, meta_len);
+    } else {
+        LogFilestoreLogCloseMetaFile(ff);
+    }
+}
+
 static TmEcode LogFilestoreLogWrap(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq, PacketQueue *postpq, int ipver)
 {
     SCEnter();
@@ -316,53 +410,74 @@ static TmEcode LogFilestoreLogWrap(ThreadVars *tv, Packet *p, void *data, Packet
                 SCLogDebug("ffd %p", ffd);
                 if (ffd->stored == 1) {
                     if (file_close == 1 && ffd->next == NULL) {
-                        LogFilestoreLogCloseMetaFile(ff);
+                        LogFilestoreLogCloseFile(ff);
                         ff->flags |= FILE_STORED;
                     }
                     continue;
                 }
 
-                /* store */
-                SCLogDebug("trying to open file");
-
-                char filename[PATH_MAX] = "";
-
-                if (ff->file_id == 0) {
-                    ff->file_id = SC_ATOMIC_ADD(file_id, 1);
-
-                    snprintf(filename, sizeof(filename), "%s/file.%u",
-                            g_logfile_base_dir, ff->file_id);
+                if (g_filestore_dedup) {
+                    if (ff->file_id == 0) {
+                        ff->file_id = SC_ATOMIC_ADD(file_id, 1);
+
+                        char meta[META_BUFFER_SIZE];
+                        uint32_t meta_len = LogFilestoreLogBuildMeta(p, ff,
+                                ipver, meta, sizeof(meta));
+                        if (LogFilestoreWriterOpen(ff->file_id, meta, meta_len) != 0) {
+                            /* the writer doesn't know the file, so none of
+                             * its data can be stored */
+                            ff->flags &= ~FILE_STORE;
+                            ff->flags |= FILE_NOSTORE;
+                            break;
+                        }
+                        aft->file_cnt++;
+                    }
 
-                    file_fd = open(filename, O_CREAT | O_TRUNC | O_NOFOLLOW | O_WRONLY, 0644);
-                    if (file_fd == -1) {
-                        SCLogDebug("failed to open file");
+                    if (LogFilestoreWriterData(ff->file_id, ffd->data, ffd->len) != 0)
                         continue;
+                } else {
+                    /* store */
+                    SCLogDebug("trying to open file");
+
+                    char filename[PATH_MAX] = "";
+
+                    if (ff->file_id == 0) {
+                        ff->file_id = SC_ATOMIC_ADD(file_id, 1);
+
+                        snprintf(filename, sizeof(filename), "%s/file.%u",
+                                g_logfile_base_dir, ff->file_id);
+
+                        file_fd = open(filename, O_CREAT | O_TRUNC | O_NOFOLLOW | O_WRONLY, 0644);
+                        if (file_fd == -1) {
+                            SCLogDebug("failed to open file");
+                            continue;
+                        }
+
+                        /* create a .meta file that contains time, src/dst/sp/dp/proto */
+                        LogFilestoreLogCreateMetaFile(p, ff, filename, ipver);
+                        aft->file_cnt++;
+                    } else {
+                        snprintf(filename, sizeof(filename), "%s/file.%u",
+                                g_logfile_base_dir, ff->file_id);
+
+                        file_fd = open(filename, O_APPEND | O_NOFOLLOW | O_WRONLY);
+                        if (file_fd == -1) {
+                            SCLogDebug("failed to open file %s: %s", filename, strerror(errno));
+                            continue;
+                        }
                     }
 
-                    /* create a .meta file that contains time, src/dst/sp/dp/proto */
-                    LogFilestoreLogCreateMetaFile(p, ff, filename, ipver);
-                    aft->file_cnt++;
-                } else {
-                    snprintf(filename, sizeof(filename), "%s/file.%u",
-                            g_logfile_base_dir, ff->file_id);
+                    ssize_t r = write(file_fd, (const void *)ffd->data, (size_t)ffd->len);
+                    if (r == -1) {
+                        SCLogDebug("write failed: %s", strerror(errno));
 
-                    file_fd = open(filename, O_APPEND | O_NOFOLLOW | O_WRONLY);
-                    if (file_fd == -1) {
-                        SCLogDebug("failed to open file %s: %s", filename, strerror(errno));
+                        close(file_fd);
                         continue;
                     }
-                }
-
-                ssize_t r = write(file_fd, (const void *)ffd->data, (size_t)ffd->len);
-                if (r == -1) {
-                    SCLogDebug("write failed: %s", strerror(errno));
 
                     close(file_fd);
-                    continue;
                 }
 
-                close(file_fd);
-
                 if (file_trunc && ff->state < FILE_STATE_CLOSED)
                     ff->state = FILE_STATE_TRUNCATED;
 
@@ -372,7 +487,7 @@ static TmEcode LogFilestoreLogWrap(ThreadVars *tv, Packet *p, void *data, Packet
                     (file_close == 1 && ff->state < FILE_STATE_CLOSED))
                 {
                     if (ffd->next == NULL) {
-                        LogFilestoreLogCloseMetaFile(ff);
+                        LogFilestoreLogCloseFile(ff);
 
                         ff->flags |= FILE_STORED;
                     }
@@ -591,6 +706,30 @@ static OutputCtx *LogFilestoreLogInitCtx(ConfNode *conf)
 #endif
     }
 
+    const char *dedup = ConfNodeLookupChildValue(conf, "dedup");
+    if (dedup != NULL && ConfValIsTrue(dedup)) {
+#ifdef HAVE_NSS
+        uint64_t memcap = FILESTORE_WRITER_DEFAULT_MEMCAP;
+        const char *s_memcap = ConfNodeLookupChildValue(conf, "writer-memcap");
+        if (s_memcap != NULL && ParseSizeStringU64(s_memcap, &memcap) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing file-store "
+                    "writer-memcap from conf file - %s", s_memcap);
+            exit(EXIT_FAILURE);
+        }
+
+        if (LogFilestoreWriterStart(g_logfile_base_dir, memcap) == 0) {
+            FileForceSha256Enable();
+            g_filestore_dedup = 1;
+            SCLogInfo("storing files by sha256 through the writer thread");
+        } else {
+            SCLogWarning(SC_ERR_THREAD_CREATE, "couldn't start the file-store "
+                    "writer, storing files without dedup");
+        }
+#else
+        SCLogInfo("dedup requires linking against libnss");
+#endif
+    }
+
     const char *waldo = ConfNodeLookupChildValue(conf, "waldo");
     if (waldo != NULL && strlen(waldo) > 0) {
         if (PathIsAbsolute(waldo)) {
@@ -620,6 +759,18 @@ static void LogFilestoreLogDeInitCtx(OutputCtx *output_ctx)
     LogFileFreeCtx(logfile_ctx);
     free(output_ctx);
 
+    if (g_filestore_dedup) {
+        LogFilestoreWriterStats stats;
+
+        LogFilestoreWriterStop();
+        LogFilestoreWriterGetStats(&stats);
+        SCLogInfo("file-store: %"PRIu64" files, %"PRIu64" unique, %"PRIu64
+                " duplicates (%"PRIu64" bytes not kept), logger waited %"PRIu64
+                " times for the writer", stats.files, stats.unique,
+                stats.duplicates, stats.bytes_dup, stats.waits);
+        g_filestore_dedup = 0;
+    }
+
     if (strlen(g_waldo) > 0) {
         LogFilestoreLogStoreWaldo(g_waldo);
     }
@@ -29,12 +29,14 @@
 #include "detect.h"
 #include "flow.h"
 #include "conf.h"
+#include "conf-yaml-loader.h"
 
 #include "threads.h"
 #include "threadvars.h"
 #include "tm-threads.h"
 
 #include "util-unittest.h"
+#include "util-unittest-helper.h"
 #include "log-pcap.h"
 #include "decode-ipv4.h"
 
@@ -43,6 +45,7 @@
 #include "util-time.h"
 #include "util-byte.h"
 #include "util-misc.h"
+#include "util-hash-lookup3.h"
 
 #include "source-pcap.h"
 
@@ -58,6 +61,7 @@
 
 #define LOGMODE_NORMAL                  0
 #define LOGMODE_SGUIL                   1
+#define LOGMODE_MULTI                   2
 
 #define RING_BUFFER_MODE_DISABLED       0
 #define RING_BUFFER_MODE_ENABLED        1
@@ -68,11 +72,71 @@
 #define USE_STREAM_DEPTH_DISABLED       0
 #define USE_STREAM_DEPTH_ENABLED        1
 
+#define DEFAULT_BUFFER_SIZE             4 * 1024 * 1024
+#define MIN_BUFFER_SIZE                 64 * 1024
+/** seconds buffered packets may wait for a full buffer in multi mode */
+#define DEFAULT_FLUSH_INTERVAL          10
+/** alignment of the multi mode write buffers and of the writes themselves,
+ *  as required for O_DIRECT */
+#define PCAP_LOG_BUFFER_ALIGN           4096
+
+#define PCAP_LOG_IDX_MAGIC              "SCPCAPIX"
+#define PCAP_LOG_IDX_VERSION            1
+#define PCAP_LOG_IDX_SUFFIX             ".idx"
+
 TmEcode PcapLog(ThreadVars *, Packet *, void *, PacketQueue *, PacketQueue *);
 TmEcode PcapLogDataInit(ThreadVars *, void *, void **);
 TmEcode PcapLogDataDeinit(ThreadVars *, void *);
 static void PcapLogFileDeInitCtx(OutputCtx *);
 
+/** pcap file header as written by the multi mode writer */
+typedef struct PcapLogFileHdr_ {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+} PcapLogFileHdr;
+
+/** on disk pcap record header. Unlike struct pcap_pkthdr it always uses
+ *  32 bit timestamps. */
+typedef struct PcapLogPktHdr_ {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t caplen;
+    uint32_t len;
+} PcapLogPktHdr;
+
+/** header of the index file written next to each multi mode pcap file */
+typedef struct PcapLogIdxHdr_ {
+    char magic[8];              /**< PCAP_LOG_IDX_MAGIC */
+    uint32_t version;           /**< PCAP_LOG_IDX_VERSION */
+    uint32_t entry_size;        /**< sizeof(PcapLogIdxEntry) */
+} PcapLogIdxHdr;
+
+/** index record, one per logged packet. The flow hash is direction
+ *  independent, see PcapLogFlowHash(). The offset points to the pcap
+ *  record header of the packet in the pcap file. */
+typedef struct PcapLogIdxEntry_ {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t flow_hash;
+    uint32_t caplen;
+    uint64_t offset;
+} PcapLogIdxEntry;
+
+/** buffered writer used by the multi mode */
+typedef struct PcapLogBuffer_ {
+    int fd;
+    int direct;                 /**< fd was opened with O_DIRECT */
+    uint8_t *buf;
+    uint32_t size;              /**< size of buf */
+    uint32_t len;               /**< bytes currently in buf */
+    uint64_t offset;            /**< file offset of the next byte appended */
+} PcapLogBuffer;
+
 typedef struct PcapFileName_ {
     char *filename;
     char *dirname;
@@ -102,11 +166,25 @@ typedef struct PcapLogData_ {
     int use_stream_depth;       /**< use stream depth i.e. ignore packets that reach limit */
     char dir[PATH_MAX];         /**< pcap log directory */
 
+    /* multi mode: every thread gets its own copy of this struct, so
+     * these are never shared between threads */
+    uint32_t thread_id;         /**< id used in this thread's file names */
+    uint32_t threads;           /**< number of thread copies handed out */
+    uint32_t buffer_size;       /**< size of the write buffers */
+    int use_direct_io;          /**< open the pcap files with O_DIRECT */
+    PcapLogBuffer *pcap_buf;    /**< writer for the current pcap file */
+    PcapLogBuffer *idx_buf;     /**< writer for the current index file */
+    uint32_t flush_interval;    /**< write out buffered packets at least
+                                     this often (sec), 0 to disable */
+    uint32_t flush_ts;          /**< time of the oldest packet not written
+                                     out, 0 if none */
+
     SCMutex plog_lock;
     TAILQ_HEAD(, PcapFileName_) pcap_file_list;
 } PcapLogData;
 
 int PcapLogOpenFileCtx(PcapLogData *);
+static void PcapLogRegisterTests(void);
 
 void TmModulePcapLogRegister(void)
 {
@@ -114,13 +192,217 @@ void TmModulePcapLogRegister(void)
     tmm_modules[TMM_PCAPLOG].ThreadInit = PcapLogDataInit;
     tmm_modules[TMM_PCAPLOG].Func = PcapLog;
     tmm_modules[TMM_PCAPLOG].ThreadDeinit = PcapLogDataDeinit;
-    tmm_modules[TMM_PCAPLOG].RegisterTests = NULL;
+    tmm_modules[TMM_PCAPLOG].RegisterTests = PcapLogRegisterTests;
 
     OutputRegisterModule(MODULE_NAME, "pcap-log", PcapLogInitCtx);
 
     return;
 }
 
+/**
+ * \brief Write a block of data to a fd, dealing with partial writes.
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int PcapLogWriteAll(int fd, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t r = write(fd, data, len);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += r;
+        len -= (size_t)r;
+    }
+    return 0;
+}
+
+/**
+ * \brief Write the buffered data to disk.
+ *
+ * With O_DIRECT only a multiple of PCAP_LOG_BUFFER_ALIGN can be written, so
+ * the tail is moved to the start of the buffer to go out with a later flush.
+ *
+ * \param b writer
+ * \param all write the unaligned tail as well
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int PcapLogBufferFlush(PcapLogBuffer *b, int all)
+{
+    uint32_t len = b->len;
+
+    if (b->direct && !all)
+        len &= ~(PCAP_LOG_BUFFER_ALIGN - 1);
+    if (len == 0)
+        return 0;
+
+    if (PcapLogWriteAll(b->fd, b->buf, len) < 0) {
+        SCLogError(SC_ERR_FWRITE, "writing pcap log failed: %s", strerror(errno));
+        return -1;
+    }
+
+    if (len < b->len)
+        memmove(b->buf, b->buf + len, b->len - len);
+    b->len -= len;
+    return 0;
+}
+
+/**
+ * \brief Append data to the buffer, flushing it to disk when it is full.
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int PcapLogBufferAppend(PcapLogBuffer *b, const void *data, uint32_t len)
+{
+    const uint8_t *d = (const uint8_t *)data;
+
+    while (len > 0) {
+        uint32_t space = b->size - b->len;
+        if (space == 0) {
+            if (PcapLogBufferFlush(b, 0) < 0)
+                return -1;
+            continue;
+        }
+
+        uint32_t n = (len < space) ? len : space;
+        memcpy(b->buf + b->len, d, n);
+        b->len += n;
+        b->offset += n;
+        d += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * \brief Create a file and a buffered writer for it.
+ *
+ * \param filename file to create, truncated if it exists
+ * \param size buffer size, a multiple of PCAP_LOG_BUFFER_ALIGN
+ * \param direct try to open the file with O_DIRECT
+ *
+ * \retval b writer or NULL on error
+ */
+static PcapLogBuffer *PcapLogBufferOpen(const char *filename, uint32_t size,
+                                        int direct)
+{
+    int flags = O_WRONLY|O_CREAT|O_TRUNC;
+
+    PcapLogBuffer *b = SCMalloc(sizeof(PcapLogBuffer));
+    if (unlikely(b == NULL))
+        return NULL;
+    memset(b, 0, sizeof(PcapLogBuffer));
+
+#ifdef O_DIRECT
+    if (direct) {
+        b->fd = open(filename, flags|O_DIRECT, 0640);
+        if (b->fd >= 0) {
+            b->direct = 1;
+        } else {
+            /* not all file systems support O_DIRECT */
+            SCLogWarning(SC_ERR_FOPEN, "opening %s with O_DIRECT failed: %s, "
+                    "falling back to buffered io", filename, strerror(errno));
+        }
+    }
+#endif
+    if (!b->direct) {
+        b->fd = open(filename, flags, 0640);
+        if (b->fd < 0) {
+            SCLogError(SC_ERR_FOPEN, "failed to open %s: %s", filename,
+                    strerror(errno));
+            SCFree(b);
+            return NULL;
+        }
+    }
+
+    b->buf = SCMallocAligned(size, PCAP_LOG_BUFFER_ALIGN);
+    if (b->buf == NULL) {
+        close(b->fd);
+        SCFree(b);
+        return NULL;
+    }
+    b->size = size;
+    return b;
+}
+
+/**
+ * \brief Flush and close a writer and free it.
+ *
+ * \retval 0 on success
+ * \retval -1 if the final flush failed
+ */
+static int PcapLogBufferClose(PcapLogBuffer *b)
+{
+    int r = 0;
+
+    if (b->direct) {
+        /* the tail isn't block sized: write what we can using O_DIRECT,
+         * then turn it off for the remainder */
+        if (PcapLogBufferFlush(b, 0) < 0)
+            r = -1;
+#ifdef O_DIRECT
+        int flags = fcntl(b->fd, F_GETFL);
+        if (flags != -1)
+            (void)fcntl(b->fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+    }
+    if (r == 0 && PcapLogBufferFlush(b, 1) < 0)
+        r = -1;
+
+    close(b->fd);
+    SCFreeAligned(b->buf);
+    SCFree(b);
+    return r;
+}
+
+/**
+ * \brief Direction independent hash of the packet's 5-tuple, as stored
+ *        in the index.
+ *
+ * This is lookup3's hashword() with an initval of 0 over 10 words: the
+ * lower of the two addresses (compared bytewise), the other address,
+ * (lower port << 16 | other port) and the ip protocol. Addresses are 16
+ * bytes in network order, IPv4 zero padded. Tools reading the index can
+ * compute the same value for the flow they are looking for.
+ *
+ * \retval hash or 0 for non-IP packets
+ */
+static uint32_t PcapLogFlowHash(const Packet *p)
+{
+    uint32_t key[10];
+    const Address *src = &p->src;
+    const Address *dst = &p->dst;
+    Port sp = p->sp;
+    Port dp = p->dp;
+
+    if (!PKT_IS_IPV4(p) && !PKT_IS_IPV6(p))
+        return 0;
+
+    int cmp = memcmp(src->addr_data32, dst->addr_data32, 16);
+    if (cmp > 0 || (cmp == 0 && sp > dp)) {
+        const Address *a = src;
+        src = dst;
+        dst = a;
+
+        Port tp = sp;
+        sp = dp;
+        dp = tp;
+    }
+
+    memcpy(&key[0], src->addr_data32, 16);
+    memcpy(&key[4], dst->addr_data32, 16);
+    key[8] = ((uint32_t)sp << 16) | (uint32_t)dp;
+    key[9] = (uint32_t)p->proto;
+
+    return hashword(key, 10, 0);
+}
+
 /**
  * \brief Function to close pcaplog file
  *
@@ -138,6 +420,14 @@ int PcapLogCloseFile(ThreadVars *t, PcapLogData *pl)
         if (pl->pcap_dead_handle != NULL)
             pcap_close(pl->pcap_dead_handle);
         pl->pcap_dead_handle = NULL;
+
+        if (pl->pcap_buf != NULL)
+            (void)PcapLogBufferClose(pl->pcap_buf);
+        pl->pcap_buf = NULL;
+
+        if (pl->idx_buf != NULL)
+            (void)PcapLogBufferClose(pl->idx_buf);
+        pl->idx_buf = NULL;
     }
 
     return 0;
@@ -188,6 +478,13 @@ int PcapLogRotateFile(ThreadVars *t, PcapLogData *pl)
             //           pf->filename, strerror( errno ));
         }
 
+        if (pl->mode == LOGMODE_MULTI) {
+            char idxname[PATH_MAX];
+            snprintf(idxname, sizeof(idxname), "%s" PCAP_LOG_IDX_SUFFIX,
+                    pf->filename);
+            (void)remove(idxname);
+        }
+
         /* Remove directory if Sguil mode and no files left in sguil dir */
         if (pl->mode == LOGMODE_SGUIL) {
             pfnext = TAILQ_NEXT(pf,next);
@@ -223,6 +520,162 @@ int PcapLogRotateFile(ThreadVars *t, PcapLogData *pl)
     return 0;
 }
 
+/**
+ * \brief Create the pcap file and its index for the multi mode and write
+ *        their headers.
+ *
+ * \param pl thread's PcapLogData, pl->filename is set
+ * \param datalink link type of the packets
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int PcapLogMultiOpen(PcapLogData *pl, int datalink)
+{
+    char idxname[PATH_MAX];
+    PcapLogFileHdr fh;
+    PcapLogIdxHdr ih;
+
+    memset(&fh, 0, sizeof(fh));
+    fh.magic = 0xa1b2c3d4;
+    fh.version_major = 2;
+    fh.version_minor = 4;
+    fh.snaplen = 262144;
+    fh.linktype = (uint32_t)datalink;
+
+    memset(&ih, 0, sizeof(ih));
+    memcpy(ih.magic, PCAP_LOG_IDX_MAGIC, sizeof(ih.magic));
+    ih.version = PCAP_LOG_IDX_VERSION;
+    ih.entry_size = sizeof(PcapLogIdxEntry);
+
+    pl->pcap_buf = PcapLogBufferOpen(pl->filename, pl->buffer_size,
+            pl->use_direct_io);
+    if (pl->pcap_buf == NULL)
+        return -1;
+
+    /* the index is much smaller than the pcap and written without O_DIRECT */
+    snprintf(idxname, sizeof(idxname), "%s" PCAP_LOG_IDX_SUFFIX, pl->filename);
+    uint32_t idx_size = pl->buffer_size / 16;
+    if (idx_size < PCAP_LOG_BUFFER_ALIGN)
+        idx_size = PCAP_LOG_BUFFER_ALIGN;
+    pl->idx_buf = PcapLogBufferOpen(idxname, idx_size, 0);
+    if (pl->idx_buf == NULL) {
+        (void)PcapLogBufferClose(pl->pcap_buf);
+        pl->pcap_buf = NULL;
+        return -1;
+    }
+
+    if (PcapLogBufferAppend(pl->pcap_buf, &fh, sizeof(fh)) < 0 ||
+        PcapLogBufferAppend(pl->idx_buf, &ih, sizeof(ih)) < 0) {
+        (void)PcapLogBufferClose(pl->idx_buf);
+        pl->idx_buf = NULL;
+        (void)PcapLogBufferClose(pl->pcap_buf);
+        pl->pcap_buf = NULL;
+        return -1;
+    }
+
+    pl->size_current = sizeof(fh);
+    pl->flush_ts = 0;
+    return 0;
+}
+
+/**
+ * \brief Write out the buffers of the multi mode if the oldest buffered
+ *        packet is older than the flush interval, so that on a quiet
+ *        link packets don't wait in the buffer until it fills up.
+ *
+ * With O_DIRECT only whole blocks are written, the last partial block
+ * stays buffered.
+ *
+ * \param pl thread's PcapLogData
+ * \param now packet time
+ *
+ * \retval 0 on success
+ * \retval -1 on failure
+ */
+static int PcapLogMultiFlushIfOld(PcapLogData *pl, uint32_t now)
+{
+    if (pl->flush_interval == 0)
+        return 0;
+
+    if (pl->flush_ts == 0) {
+        pl->flush_ts = now;
+        return 0;
+    }
+    if (now < pl->flush_ts + pl->flush_interval)
+        return 0;
+
+    /* pcap first, so the index never points past the end of the pcap */
+    if (PcapLogBufferFlush(pl->pcap_buf, 0) < 0 ||
+        PcapLogBufferFlush(pl->idx_buf, 0) < 0)
+        return -1;
+
+    pl->flush_ts = 0;
+    return 0;
+}
+
+/**
+ * \brief Log a packet in multi mode: the thread writes to its own files,
+ *        so no locking is needed.
+ *
+ * \param t threadvar
+ * \param p packet
+ * \param pl this thread's copy of the PcapLogData
+ *
+ * \retval TM_ECODE_OK on succes
+ * \retval TM_ECODE_FAILED on serious error
+ */
+static TmEcode PcapLogMulti(ThreadVars *t, Packet *p, PcapLogData *pl)
+{
+    PcapLogPktHdr h;
+    PcapLogIdxEntry e;
+    uint64_t len = sizeof(h) + GET_PKT_LEN(p);
+
+    pl->pkt_cnt++;
+
+    if (pl->filename == NULL) {
+        if (PcapLogOpenFileCtx(pl) < 0)
+            return TM_ECODE_FAILED;
+        SCLogDebug("Opening PCAP log file %s", pl->filename);
+    }
+
+    if ((pl->size_current + len) > pl->size_limit) {
+        if (PcapLogRotateFile(t, pl) < 0) {
+            SCLogDebug("rotation of pcap failed");
+            return TM_ECODE_FAILED;
+        }
+    }
+
+    if (pl->pcap_buf == NULL) {
+        if (PcapLogMultiOpen(pl, p->datalink) < 0)
+            return TM_ECODE_FAILED;
+    }
+
+    h.ts_sec = (uint32_t)p->ts.tv_sec;
+    h.ts_usec = (uint32_t)p->ts.tv_usec;
+    h.caplen = GET_PKT_LEN(p);
+    h.len = GET_PKT_LEN(p);
+
+    e.ts_sec = h.ts_sec;
+    e.ts_usec = h.ts_usec;
+    e.flow_hash = PcapLogFlowHash(p);
+    e.caplen = h.caplen;
+    e.offset = pl->pcap_buf->offset;
+
+    if (PcapLogBufferAppend(pl->pcap_buf, &h, sizeof(h)) < 0 ||
+        PcapLogBufferAppend(pl->pcap_buf, GET_PKT_DATA(p), GET_PKT_LEN(p)) < 0 ||
+        PcapLogBufferAppend(pl->idx_buf, &e, sizeof(e)) < 0)
+        return TM_ECODE_FAILED;
+
+    if (PcapLogMultiFlushIfOld(pl, h.ts_sec) < 0)
+        return TM_ECODE_FAILED;
+
+    pl->size_current += len;
+    SCLogDebug("pl->size_current %"PRIu64",  pl->size_limit %"PRIu64,
+               pl->size_current, pl->size_limit);
+    return TM_ECODE_OK;
+}
+
 /**
  * \brief Pcap logging main function
  *
@@ -252,6 +705,9 @@ TmEcode PcapLog (ThreadVars *t, Packet *p, void *data, PacketQueue *pq,
         return TM_ECODE_OK;
     }
 
+    if (pl->mode == LOGMODE_MULTI)
+        return PcapLogMulti(t, p, pl);
+
     SCMutexLock(&pl->plog_lock);
 
     pl->pkt_cnt++;
@@ -332,6 +788,33 @@ TmEcode PcapLogDataInit(ThreadVars *t, void *initdata, void **data)
 
     SCMutexLock(&pl->plog_lock);
 
+    if (pl->mode == LOGMODE_MULTI) {
+        /* each thread logs to its own files using its own copy of the
+         * settings */
+        PcapLogData *tpl = SCMalloc(sizeof(PcapLogData));
+        if (unlikely(tpl == NULL)) {
+            SCMutexUnlock(&pl->plog_lock);
+            return TM_ECODE_FAILED;
+        }
+        memcpy(tpl, pl, sizeof(PcapLogData));
+        /* a copied mutex is undefined, the thread gets its own */
+        SCMutexInit(&tpl->plog_lock, NULL);
+        tpl->h = NULL;
+        tpl->filename = NULL;
+        tpl->pkt_cnt = 0;
+        tpl->file_cnt = 1;
+        tpl->size_current = 0;
+        tpl->pcap_buf = NULL;
+        tpl->idx_buf = NULL;
+        tpl->thread_id = pl->threads++;
+        TAILQ_INIT(&tpl->pcap_file_list);
+
+        *data = (void *)tpl;
+
+        SCMutexUnlock(&pl->plog_lock);
+        return TM_ECODE_OK;
+    }
+
     /** Use the Ouptut Context (file pointer and mutex) */
     pl->pkt_cnt = 0;
     pl->pcap_dead_handle = NULL;
@@ -362,6 +845,25 @@ TmEcode PcapLogDataInit(ThreadVars *t, void *initdata, void **data)
 
 TmEcode PcapLogDataDeinit(ThreadVars *t, void *data)
 {
+    PcapLogData *pl = (PcapLogData *)data;
+
+    /* only the multi mode has per thread data, the other modes use the
+     * output ctx's PcapLogData that is freed in PcapLogFileDeInitCtx */
+    if (pl == NULL || pl->mode != LOGMODE_MULTI)
+        return TM_ECODE_OK;
+
+    PcapLogCloseFile(t, pl);
+
+    PcapFileName *pf;
+    while ((pf = TAILQ_FIRST(&pl->pcap_file_list)) != NULL) {
+        TAILQ_REMOVE(&pl->pcap_file_list, pf, next);
+        PcapFileNameFree(pf);
+    }
+    if (pl->filename != NULL)
+        SCFree(pl->filename);
+    SCMutexDestroy(&pl->plog_lock);
+    SCFree(pl);
+
     return TM_ECODE_OK;
 }
 
@@ -442,10 +944,12 @@ OutputCtx *PcapLogInitCtx(ConfNode *conf)
         if (s_mode != NULL) {
             if (strcasecmp(s_mode, "sguil") == 0) {
                 pl->mode = LOGMODE_SGUIL;
+            } else if (strcasecmp(s_mode, "multi") == 0) {
+                pl->mode = LOGMODE_MULTI;
             } else if (strcasecmp(s_mode, "normal") != 0) {
                 SCLogError(SC_ERR_INVALID_ARGUMENT,
-                    "log-pcap you must specify \"sguil\" or \"normal\" mode "
-                    "option to be set.");
+                    "log-pcap you must specify \"sguil\", \"multi\" or "
+                    "\"normal\" mode option to be set.");
                 exit(EXIT_FAILURE);
             }
         }
@@ -493,7 +997,54 @@ OutputCtx *PcapLogInitCtx(ConfNode *conf)
     }
 
     SCLogInfo("using %s logging", pl->mode == LOGMODE_SGUIL ?
-              "Sguil compatible" : "normal");
+              "Sguil compatible" : (pl->mode == LOGMODE_MULTI ?
+              "per thread (multi)" : "normal"));
+
+    pl->buffer_size = DEFAULT_BUFFER_SIZE;
+    pl->flush_interval = DEFAULT_FLUSH_INTERVAL;
+    if (conf != NULL) {
+        const char *s_bufsize = ConfNodeLookupChildValue(conf, "buffer-size");
+        if (s_bufsize != NULL) {
+            uint64_t bufsize = 0;
+            if (ParseSizeStringU64(s_bufsize, &bufsize) < 0 ||
+                bufsize < MIN_BUFFER_SIZE || bufsize > UINT32_MAX / 2) {
+                SCLogError(SC_ERR_INVALID_ARGUMENT,
+                    "Failed to initialize pcap-log output, invalid "
+                    "buffer-size: %s", s_bufsize);
+                exit(EXIT_FAILURE);
+            }
+            /* O_DIRECT needs block sized writes */
+            bufsize = (bufsize + PCAP_LOG_BUFFER_ALIGN - 1) &
+                ~((uint64_t)PCAP_LOG_BUFFER_ALIGN - 1);
+            pl->buffer_size = (uint32_t)bufsize;
+        }
+
+        const char *s_flush = ConfNodeLookupChildValue(conf, "flush-interval");
+        if (s_flush != NULL) {
+            if (ByteExtractStringUint32(&pl->flush_interval, 10, 0,
+                                        s_flush) == -1) {
+                SCLogError(SC_ERR_INVALID_ARGUMENT,
+                    "Failed to initialize pcap-log output, invalid "
+                    "flush-interval: %s", s_flush);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        const char *s_direct = ConfNodeLookupChildValue(conf, "use-direct-io");
+        if (s_direct != NULL && ConfValIsTrue(s_direct)) {
+#ifdef O_DIRECT
+            pl->use_direct_io = 1;
+#else
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "pcap-log \"use-direct-io\" "
+                    "is not supported on this platform, ignoring");
+#endif
+        }
+    }
+    if (pl->mode == LOGMODE_MULTI) {
+        SCLogInfo("pcap-log: per thread buffers of %"PRIu32" bytes%s, "
+                "flushed every %"PRIu32"s", pl->buffer_size,
+                pl->use_direct_io ? ", using O_DIRECT" : "", pl->flush_interval);
+    }
 
     uint32_t max_file_limit = DEFAULT_FILE_LIMIT;
     if (conf != NULL) {
@@ -533,6 +1084,12 @@ OutputCtx *PcapLogInitCtx(ConfNode *conf)
         }
     }
 
+    /* rotating within a second would reuse the file name, which is much
+     * more likely with the per thread files of the multi mode */
+    if (ts_format == NULL && pl->mode == LOGMODE_MULTI) {
+        pl->timestamp_format = TS_FORMAT_USEC;
+    }
+
     const char *use_stream_depth = NULL;
     if (conf != NULL) { /* To faciliate unit tests. */
         use_stream_depth = ConfNodeLookupChildValue(conf, "use-stream-depth");
@@ -574,6 +1131,22 @@ static void PcapLogFileDeInitCtx(OutputCtx *output_ctx)
         SCLogDebug("PCAP files left at exit: %s\n", pf->filename);
     }
 
+    PcapLogCloseFile(NULL, pl);
+
+    while ((pf = TAILQ_FIRST(&pl->pcap_file_list)) != NULL) {
+        TAILQ_REMOVE(&pl->pcap_file_list, pf, next);
+        PcapFileNameFree(pf);
+    }
+    if (pl->filename != NULL)
+        SCFree(pl->filename);
+    if (pl->h != NULL)
+        SCFree(pl->h);
+    if (pl->prefix != NULL)
+        SCFree(pl->prefix);
+    SCMutexDestroy(&pl->plog_lock);
+    SCFree(pl);
+    SCFree(output_ctx);
+
     return;
 }
 
@@ -642,6 +1215,17 @@ int PcapLogOpenFileCtx(PcapLogData *pl)
                      dirfull, pl->prefix, (uint32_t)ts.tv_sec, (uint32_t)ts.tv_usec);
         }
 
+    } else if (pl->mode == LOGMODE_MULTI) {
+        /* the thread id keeps the threads' files apart */
+        if (pl->timestamp_format == TS_FORMAT_SEC) {
+            snprintf(filename, PATH_MAX, "%s/%s.%" PRIu32 ".%" PRIu32, pl->dir,
+                     pl->prefix, pl->thread_id, (uint32_t)ts.tv_sec);
+        } else {
+            snprintf(filename, PATH_MAX, "%s/%s.%" PRIu32 ".%" PRIu32 ".%" PRIu32,
+                     pl->dir, pl->prefix, pl->thread_id, (uint32_t)ts.tv_sec,
+                     (uint32_t)ts.tv_usec);
+        }
+
     } else {
         /* create the filename to use */
         if (pl->timestamp_format == TS_FORMAT_SEC) {
@@ -666,3 +1250,372 @@ error:
     PcapFileNameFree(pf);
     return -1;
 }
+
+#ifdef UNITTESTS
+/** \brief read a whole file for the tests, caller frees */
+static uint8_t *PcapLogTestReadFile(const char *filename, long *len)
+{
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    uint8_t *buf = SCMalloc(*len + 1);
+    if (buf == NULL || fread(buf, 1, *len, fp) != (size_t)*len) {
+        if (buf != NULL)
+            SCFree(buf);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    return buf;
+}
+
+static OutputCtx *PcapLogTestInitCtx(const char *conf)
+{
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfYamlLoadString(conf, strlen(conf));
+
+    return PcapLogInitCtx(ConfGetNode("pcap-log"));
+}
+
+static void PcapLogTestDeInitCtx(OutputCtx *output_ctx)
+{
+    PcapLogFileDeInitCtx(output_ctx);
+
+    ConfDeInit();
+    ConfRestoreContextBackup();
+}
+
+/**
+ * \test multi mode: packets go to the thread's own file and can be found
+ *       back through the index, both directions of a flow sharing a hash.
+ */
+static int PcapLogTest01(void)
+{
+    char conf[] =
+        "%YAML 1.1\n"
+        "---\n"
+        "pcap-log:\n"
+        "  filename: pcaplogtest01\n"
+        "  dir: /tmp\n"
+        "  mode: multi\n"
+        "  buffer-size: 64kb\n";
+    uint8_t payload[] = "payload";
+    Packet *p[3] = { NULL, NULL, NULL };
+    ThreadVars tv;
+    void *data = NULL;
+    char pcapname[PATH_MAX] = "";
+    char idxname[PATH_MAX] = "";
+    uint8_t *pcap = NULL;
+    uint8_t *idx = NULL;
+    long pcap_len = 0, idx_len = 0;
+    int result = 0;
+    int i;
+
+    memset(&tv, 0, sizeof(tv));
+
+    OutputCtx *output_ctx = PcapLogTestInitCtx(conf);
+    if (output_ctx == NULL)
+        goto end;
+
+    if (PcapLogDataInit(&tv, output_ctx, &data) != TM_ECODE_OK)
+        goto end;
+    PcapLogData *pl = (PcapLogData *)data;
+    if (pl == output_ctx->data || pl->thread_id != 0) {
+        printf("expected per thread data with id 0: ");
+        goto end;
+    }
+
+    p[0] = UTHBuildPacketReal(payload, sizeof(payload), IPPROTO_TCP,
+            "192.168.1.1", "192.168.1.2", 1024, 80);
+    p[1] = UTHBuildPacketReal(payload, sizeof(payload), IPPROTO_TCP,
+            "192.168.1.2", "192.168.1.1", 80, 1024);
+    p[2] = UTHBuildPacketReal(payload, sizeof(payload), IPPROTO_TCP,
+            "192.168.1.1", "192.168.1.3", 1024, 80);
+    if (p[0] == NULL || p[1] == NULL || p[2] == NULL)
+        goto end;
+
+    for (i = 0; i < 3; i++) {
+        if (PcapLog(&tv, p[i], data, NULL, NULL) != TM_ECODE_OK) {
+            printf("logging packet %d failed: ", i);
+            goto end;
+        }
+    }
+
+    strlcpy(pcapname, pl->filename, sizeof(pcapname));
+    snprintf(idxname, sizeof(idxname), "%s" PCAP_LOG_IDX_SUFFIX, pcapname);
+
+    /* closes and flushes the files */
+    PcapLogDataDeinit(&tv, data);
+    data = NULL;
+
+    pcap = PcapLogTestReadFile(pcapname, &pcap_len);
+    idx = PcapLogTestReadFile(idxname, &idx_len);
+    if (pcap == NULL || idx == NULL) {
+        printf("reading back %s failed: ", pcapname);
+        goto end;
+    }
+
+    if (idx_len != (long)(sizeof(PcapLogIdxHdr) + 3 * sizeof(PcapLogIdxEntry))) {
+        printf("index size %ld: ", idx_len);
+        goto end;
+    }
+    PcapLogIdxHdr *ih = (PcapLogIdxHdr *)idx;
+    if (memcmp(ih->magic, PCAP_LOG_IDX_MAGIC, sizeof(ih->magic)) != 0 ||
+        ih->version != PCAP_LOG_IDX_VERSION ||
+        ih->entry_size != sizeof(PcapLogIdxEntry)) {
+        printf("bad index header: ");
+        goto end;
+    }
+
+    PcapLogIdxEntry *e = (PcapLogIdxEntry *)(idx + sizeof(PcapLogIdxHdr));
+    if (e[0].flow_hash != e[1].flow_hash || e[0].flow_hash == e[2].flow_hash) {
+        printf("flow hashes %08x %08x %08x: ", e[0].flow_hash,
+                e[1].flow_hash, e[2].flow_hash);
+        goto end;
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (e[i].offset + sizeof(PcapLogPktHdr) + e[i].caplen > (uint64_t)pcap_len) {
+            printf("entry %d points beyond the pcap: ", i);
+            goto end;
+        }
+        PcapLogPktHdr *h = (PcapLogPktHdr *)(pcap + e[i].offset);
+        if (h->caplen != GET_PKT_LEN(p[i]) || h->ts_sec != e[i].ts_sec ||
+            memcmp(pcap + e[i].offset + sizeof(PcapLogPktHdr),
+                   GET_PKT_DATA(p[i]), GET_PKT_LEN(p[i])) != 0) {
+            printf("entry %d doesn't point to its packet: ", i);
+            goto end;
+        }
+    }
+
+    result = 1;
+end:
+    if (data != NULL)
+        PcapLogDataDeinit(&tv, data);
+    if (output_ctx != NULL)
+        PcapLogTestDeInitCtx(output_ctx);
+    for (i = 0; i < 3; i++) {
+        if (p[i] != NULL)
+            UTHFreePacket(p[i]);
+    }
+    if (pcap != NULL)
+        SCFree(pcap);
+    if (idx != NULL)
+        SCFree(idx);
+    if (pcapname[0] != '\0')
+        (void)remove(pcapname);
+    if (idxname[0] != '\0')
+        (void)remove(idxname);
+    return result;
+}
+
+/**
+ * \test multi mode ring buffer: each thread rotates its own files and
+ *       removes the index together with the oldest pcap.
+ */
+static int PcapLogTest02(void)
+{
+    char conf[] =
+        "%YAML 1.1\n"
+        "---\n"
+        "pcap-log:\n"
+        "  filename: pcaplogtest02\n"
+        "  dir: /tmp\n"
+        "  mode: multi\n"
+        "  limit: 1mb\n"
+        "  max-files: 2\n"
+        "  buffer-size: 64kb\n";
+    uint8_t payload[1400];
+    ThreadVars tv1, tv2;
+    void *data1 = NULL, *data2 = NULL;
+    char first[PATH_MAX] = "";
+    char name[PATH_MAX];
+    Packet *p = NULL;
+    int result = 0;
+    int i;
+
+    memset(&tv1, 0, sizeof(tv1));
+    memset(&tv2, 0, sizeof(tv2));
+    memset(payload, 'A', sizeof(payload));
+
+    OutputCtx *output_ctx = PcapLogTestInitCtx(conf);
+    if (output_ctx == NULL)
+        goto end;
+
+    if (PcapLogDataInit(&tv1, output_ctx, &data1) != TM_ECODE_OK ||
+        PcapLogDataInit(&tv2, output_ctx, &data2) != TM_ECODE_OK)
+        goto end;
+    PcapLogData *pl1 = (PcapLogData *)data1;
+    PcapLogData *pl2 = (PcapLogData *)data2;
+    if (pl1->thread_id == pl2->thread_id) {
+        printf("threads share id %u: ", pl1->thread_id);
+        goto end;
+    }
+
+    p = UTHBuildPacket(payload, sizeof(payload), IPPROTO_TCP);
+    if (p == NULL)
+        goto end;
+
+    /* ~3.5 files worth of packets for thread 1, one for thread 2 */
+    for (i = 0; i < 2600; i++) {
+        if (PcapLog(&tv1, p, data1, NULL, NULL) != TM_ECODE_OK) {
+            printf("logging packet %d failed: ", i);
+            goto end;
+        }
+        if (i == 0) {
+            strlcpy(first, pl1->filename, sizeof(first));
+            if (PcapLog(&tv2, p, data2, NULL, NULL) != TM_ECODE_OK)
+                goto end;
+        }
+    }
+
+    if (pl1->file_cnt != 2 || pl2->file_cnt != 1) {
+        printf("file_cnt %u %u, expected 2 1: ", pl1->file_cnt, pl2->file_cnt);
+        goto end;
+    }
+
+    struct stat st;
+    snprintf(name, sizeof(name), "%s" PCAP_LOG_IDX_SUFFIX, first);
+    if (stat(first, &st) == 0 || stat(name, &st) == 0) {
+        printf("oldest pcap %s or its index still exists: ", first);
+        goto end;
+    }
+
+    PcapFileName *pf;
+    TAILQ_FOREACH(pf, &pl1->pcap_file_list, next) {
+        if (strcmp(pf->filename, pl2->filename) == 0) {
+            printf("threads share file %s: ", pf->filename);
+            goto end;
+        }
+    }
+
+    result = 1;
+end:
+    /* remove what is left of the rings */
+    if (data1 != NULL) {
+        PcapLogCloseFile(&tv1, (PcapLogData *)data1);
+        TAILQ_FOREACH(pf, &((PcapLogData *)data1)->pcap_file_list, next) {
+            snprintf(name, sizeof(name), "%s" PCAP_LOG_IDX_SUFFIX, pf->filename);
+            (void)remove(pf->filename);
+            (void)remove(name);
+        }
+        PcapLogDataDeinit(&tv1, data1);
+    }
+    if (data2 != NULL) {
+        PcapLogCloseFile(&tv2, (PcapLogData *)data2);
+        TAILQ_FOREACH(pf, &((PcapLogData *)data2)->pcap_file_list, next) {
+            snprintf(name, sizeof(name), "%s" PCAP_LOG_IDX_SUFFIX, pf->filename);
+            (void)remove(pf->filename);
+            (void)remove(name);
+        }
+        PcapLogDataDeinit(&tv2, data2);
+    }
+    if (output_ctx != NULL)
+        PcapLogTestDeInitCtx(output_ctx);
+    if (p != NULL)
+        UTHFreePacket(p);
+    return result;
+}
+
+/** \test multi mode: buffered packets are written out once the oldest is
+ *        flush-interval seconds old */
+static int PcapLogTest03(void)
+{
+    char conf[] =
+        "%YAML 1.1\n"
+        "---\n"
+        "pcap-log:\n"
+        "  filename: pcaplogtest03\n"
+        "  dir: /tmp\n"
+        "  mode: multi\n"
+        "  buffer-size: 64kb\n"
+        "  flush-interval: 2\n";
+    uint8_t payload[] = "payload";
+    uint32_t ts[4] = { 1000, 1001, 1002, 1003 };
+    /* file size on disk after each packet */
+    int on_disk[4] = { 0, 0, 3, 3 };
+    Packet *p = NULL;
+    ThreadVars tv;
+    void *data = NULL;
+    char pcapname[PATH_MAX] = "";
+    char idxname[PATH_MAX] = "";
+    struct stat st;
+    int result = 0;
+    int i;
+
+    memset(&tv, 0, sizeof(tv));
+
+    OutputCtx *output_ctx = PcapLogTestInitCtx(conf);
+    if (output_ctx == NULL)
+        goto end;
+    if (PcapLogDataInit(&tv, output_ctx, &data) != TM_ECODE_OK)
+        goto end;
+    PcapLogData *pl = (PcapLogData *)data;
+    if (pl->flush_interval != 2) {
+        printf("flush interval %"PRIu32": ", pl->flush_interval);
+        goto end;
+    }
+
+    p = UTHBuildPacketReal(payload, sizeof(payload), IPPROTO_TCP,
+            "192.168.1.1", "192.168.1.2", 1024, 80);
+    if (p == NULL)
+        goto end;
+
+    for (i = 0; i < 4; i++) {
+        p->ts.tv_sec = ts[i];
+        if (PcapLog(&tv, p, data, NULL, NULL) != TM_ECODE_OK) {
+            printf("logging packet %d failed: ", i);
+            goto end;
+        }
+        if (i == 0) {
+            strlcpy(pcapname, pl->filename, sizeof(pcapname));
+            snprintf(idxname, sizeof(idxname), "%s" PCAP_LOG_IDX_SUFFIX, pcapname);
+        }
+
+        off_t pcap_size = on_disk[i] ? (off_t)(sizeof(PcapLogFileHdr) +
+                on_disk[i] * (sizeof(PcapLogPktHdr) + GET_PKT_LEN(p))) : 0;
+        off_t idx_size = on_disk[i] ? (off_t)(sizeof(PcapLogIdxHdr) +
+                on_disk[i] * sizeof(PcapLogIdxEntry)) : 0;
+
+        if (stat(pcapname, &st) != 0 || st.st_size != pcap_size) {
+            printf("packet %d: pcap size %"PRIuMAX", expected %"PRIuMAX": ",
+                    i, (uintmax_t)st.st_size, (uintmax_t)pcap_size);
+            goto end;
+        }
+        if (stat(idxname, &st) != 0 || st.st_size != idx_size) {
+            printf("packet %d: index size %"PRIuMAX", expected %"PRIuMAX": ",
+                    i, (uintmax_t)st.st_size, (uintmax_t)idx_size);
+            goto end;
+        }
+    }
+
+    result = 1;
+end:
+    if (data != NULL)
+        PcapLogDataDeinit(&tv, data);
+    if (output_ctx != NULL)
+        PcapLogTestDeInitCtx(output_ctx);
+    if (p != NULL)
+        UTHFreePacket(p);
+    if (pcapname[0] != '\0')
+        (void)remove(pcapname);
+    if (idxname[0] != '\0')
+        (void)remove(idxname);
+    return result;
+}
+#endif /* UNITTESTS */
+
+static void PcapLogRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("PcapLogTest01", PcapLogTest01, 1);
+    UtRegisterTest("PcapLogTest02", PcapLogTest02, 1);
+    UtRegisterTest("PcapLogTest03", PcapLogTest03, 1);
+#endif /* UNITTESTS */
+}
@@ -28,10 +28,12 @@
 
 #include "detect-parse.h"
 #include "detect-engine.h"
+#include "detect-engine-rulestats.h"
 #include "detect-engine-address.h"
 #include "detect-engine-proto.h"
 #include "detect-engine-port.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-build.h"
 #include "detect-engine-sigorder.h"
 #include "detect-engine-payload.h"
 #include "detect-engine-dcepayload.h"
@@ -62,12 +64,14 @@
 #include "unix-manager.h"
 
 #include "app-layer-detect-proto.h"
+#include "app-layer-detect-cache.h"
 #include "app-layer-parser.h"
 #include "app-layer.h"
 #include "app-layer-smb.h"
 #include "app-layer-dcerpc.h"
 #include "app-layer-dcerpc-udp.h"
 #include "app-layer-htp.h"
+#include "app-layer-slab.h"
 #include "app-layer-ftp.h"
 #include "app-layer-ssl.h"
 #include "app-layer-ssh.h"
@@ -85,6 +89,7 @@
 #include "util-reference-config.h"
 #include "util-profiling.h"
 #include "util-magic.h"
+#include "util-magic-builtin.h"
 #include "util-memcmp.h"
 #include "util-misc.h"
 #include "util-ringbuffer.h"
@@ -95,6 +100,7 @@
 #include "util-spm.h"
 #include "util-hash.h"
 #include "util-hashlist.h"
+#include "util-file-hashlist.h"
 #include "util-bloomfilter.h"
 #include "util-bloomfilter-counting.h"
 #include "util-pool.h"
@@ -106,12 +112,14 @@
 #include "detect-engine-mpm.h"
 
 #include "util-decode-asn1.h"
+#include "util-decode-mime.h"
 
 #include "conf.h"
 #include "conf-yaml-loader.h"
 #include "tmqh-flow.h"
 #include "defrag.h"
 #include "detect-engine-siggroup.h"
+#include "log-filestore-writer.h"
 
 #endif /* UNITTESTS */
 
@@ -178,6 +186,7 @@ int RunUnittests(int list_unittests, char *regex_arg)
     SigTableRegisterTests();
     HashTableRegisterTests();
     HashListTableRegisterTests();
+    FileHashListRegisterTests();
     BloomFilterRegisterTests();
     BloomFilterCountingRegisterTests();
     PoolRegisterTests();
@@ -203,7 +212,9 @@ int RunUnittests(int list_unittests, char *regex_arg)
     DecodeUDPV4RegisterTests();
     DecodeGRERegisterTests();
     DecodeAsn1RegisterTests();
+    MimeDecRegisterTests();
     AlpDetectRegisterTests();
+    AlpCacheRegisterTests();
     ConfRegisterTests();
     ConfYamlRegisterTests();
     TmqhFlowRegisterTests();
@@ -215,6 +226,7 @@ int RunUnittests(int list_unittests, char *regex_arg)
     SCHInfoRegisterTests();
     SCRuleVarsRegisterTests();
     AppLayerParserRegisterTests();
+    AppLayerSlabRegisterTests();
     ThreadMacrosRegisterTests();
     UtilSpmSearchRegistertests();
     UtilActionRegisterTests();
@@ -230,7 +242,9 @@ int RunUnittests(int list_unittests, char *regex_arg)
 #ifdef PROFILING
     SCProfilingRegisterTests();
 #endif
+    SCProfilingSampleRegisterTests();
     DeStateRegisterTests();
+    DetectRuleStatsRegisterTests();
     DetectRingBufferRegisterTests();
     MemcmpRegisterTests();
     DetectEngineHttpClientBodyRegisterTests();
@@ -246,15 +260,18 @@ int RunUnittests(int list_unittests, char *regex_arg)
     DetectEngineHttpHHRegisterTests();
     DetectEngineHttpHRHRegisterTests();
     DetectEngineRegisterTests();
+    DetectEngineBuildRegisterTests();
     SCLogRegisterTests();
     SMTPParserRegisterTests();
     MagicRegisterTests();
+    MagicBuiltinRegisterTests();
     UtilMiscRegisterTests();
     DetectAddressTests();
     DetectProtoTests();
     DetectPortTests();
     SCAtomicRegisterTests();
     MemrchrRegisterTests();
+    LogFilestoreWriterRegisterTests();
 #ifdef __SC_CUDA_SUPPORT__
     CudaBufferRegisterUnittests();
 #endif
@@ -165,6 +165,8 @@ typedef struct NFQCnf_ {
     uint32_t mask;
     uint32_t next_queue;
     uint32_t flags;
+    uint32_t bypass_mark;
+    uint32_t bypass_mask;
     uint8_t batchcount;
 } NFQCnf;
 
@@ -253,6 +255,14 @@ void NFQInitConfig(char quiet)
         nfq_config.mask = (uint32_t)value;
     }
 
+    if ((ConfGetInt("nfq.bypass-mark", &value)) == 1) {
+        nfq_config.bypass_mark = (uint32_t)value;
+    }
+
+    if ((ConfGetInt("nfq.bypass-mask", &value)) == 1) {
+        nfq_config.bypass_mask = (uint32_t)value;
+    }
+
     if ((ConfGetInt("nfq.route-queue", &value)) == 1) {
         nfq_config.next_queue = ((uint32_t)value) << 16;
     }
@@ -285,6 +295,10 @@ void NFQInitConfig(char quiet)
                         nfq_config.next_queue);
             break;
         }
+        if (nfq_config.bypass_mask != 0) {
+            SCLogInfo("NFQ bypassing flows with mark %"PRIu32"/%"PRIu32,
+                    nfq_config.bypass_mark, nfq_config.bypass_mask);
+        }
     }
 
 }
@@ -473,6 +487,27 @@ int NFQSetupPkt (Packet *p, struct nfq_q_handle *qh, void *data)
     return 0;
 }
 
+/**
+ *  \brief Bypass the rest of the packet's flow in the kernel
+ *
+ *  The packet is verdicted with the bypass mark. The ruleset is expected
+ *  to save it to the connmark and to accept connections carrying it before
+ *  they hit the queue, e.g.
+ *
+ *  iptables -I FORWARD -m connmark --mark 1/1 -j ACCEPT
+ *  iptables -A FORWARD -j NFQUEUE
+ *  iptables -t mangle -A POSTROUTING -j CONNMARK --save-mark
+ *
+ *  \retval 1 always
+ */
+static int NFQBypassCallback(Packet *p)
+{
+    p->nfq_v.mark = (nfq_config.bypass_mark & nfq_config.bypass_mask) |
+        (p->nfq_v.mark & ~nfq_config.bypass_mask);
+    p->flags |= PKT_MARK_MODIFIED;
+    return 1;
+}
+
 static void NFQReleasePacket(Packet *p)
 {
     if (unlikely(!p->nfq_v.verdicted)) {
@@ -512,6 +547,8 @@ static int NFQCallBack(struct nfq_q_handle *qh, struct nfgenmsg *nfmsg,
     }
 
     p->ReleasePacket = NFQReleasePacket;
+    if (nfq_config.bypass_mask != 0)
+        p->BypassPacketsFlow = NFQBypassCallback;
 
 #ifdef COUNTERS
     NFQQueueVars *nfq_q = NFQGetQueue(ntv->nfq_index);
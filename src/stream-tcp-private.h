@@ -142,6 +142,14 @@ enum
  *  normal packet we assume 3whs to be completed. Only used for SYN/ACK resend
  *  event. */
 #define STREAMTCP_FLAG_3WHS_CONFIRMED               0x1000
+/** App layer bypassed the session: no more reassembly and payload
+ *  inspection. The rest of the session is accounted as bypassed. */
+#define STREAMTCP_FLAG_APP_LAYER_BYPASS             0x2000
+/** Bypassed session was counted */
+#define STREAMTCP_FLAG_APP_LAYER_BYPASS_COUNTED     0x4000
+/** App layer needs the rest of the session, it must not be bypassed even
+ *  if it's no longer reassembled */
+#define STREAMTCP_FLAG_NO_BYPASS                    0x8000
 
 /*
  * Per STREAM flags
@@ -387,6 +387,7 @@ void StreamTcpReassembleFreeThreadCtx(TcpReassemblyThreadCtx *ra_ctx)
 
     ra_ctx->stream_q = NULL;
     AlpProtoDeFinalize2Thread(&ra_ctx->dp_ctx);
+    AppLayerParserThreadCleanup();
     SCFree(ra_ctx);
     SCReturn;
 }
@@ -35,6 +35,7 @@
 
 #include "flow.h"
 #include "flow-util.h"
+#include "flow-wheel.h"
 
 #include "conf.h"
 #include "conf-yaml-loader.h"
@@ -402,6 +403,12 @@ void StreamTcpInitConfig(char quiet)
         SCLogInfo("stream \"async-oneside\": %s", stream_config.async_oneside ? "enabled" : "disabled");
     }
 
+    ConfGetBool("stream.bypass", &stream_config.bypass);
+
+    if (!quiet) {
+        SCLogInfo("stream \"bypass\": %s", stream_config.bypass ? "enabled" : "disabled");
+    }
+
     int csum = 0;
 
     if ((ConfGetBool("stream.checksum-validation", &csum)) == 1) {
@@ -656,6 +663,10 @@ static void StreamTcpPacketSetState(Packet *p, TcpSession *ssn,
         return;
 
     ssn->state = state;
+
+    /* a closing session has a shorter timeout, reschedule it */
+    if (p->flow != NULL)
+        FlowWheelSchedule(p->flow, (uint32_t)p->ts.tv_sec);
 }
 
 /**
@@ -4305,6 +4316,19 @@ int StreamTcpPacket (ThreadVars *tv, Packet *p, StreamTcpThread *stt,
         }
     skip:
 
+        if (ssn->flags & STREAMTCP_FLAG_APP_LAYER_BYPASS) {
+            if (!(ssn->flags & STREAMTCP_FLAG_APP_LAYER_BYPASS_COUNTED)) {
+                ssn->flags |= STREAMTCP_FLAG_APP_LAYER_BYPASS_COUNTED;
+                SCPerfCounterIncr(stt->counter_tcp_bypass, tv->sc_perf_pca);
+            }
+            SCPerfCounterAddUI64(stt->counter_tcp_bypass_bytes, tv->sc_perf_pca,
+                    p->payload_len);
+        }
+
+        if (StreamTcpCheckBypass(ssn)) {
+            FlowBypass(p->flow, p);
+        }
+
         if (ssn->state >= TCP_ESTABLISHED) {
             p->flags |= PKT_STREAM_EST;
         }
@@ -4448,6 +4472,11 @@ TmEcode StreamTcp (ThreadVars *tv, Packet *p, void *data, PacketQueue *pq, Packe
         return TM_ECODE_OK;
     }
 
+    /* flow is bypassed, nothing left to track */
+    if (p->flags & PKT_FLOW_BYPASSED) {
+        return TM_ECODE_OK;
+    }
+
     if (stream_config.flags & STREAMTCP_INIT_FLAG_CHECKSUM_VALIDATION) {
         if (StreamTcpValidateChecksum(p) == 0) {
             SCPerfCounterIncr(stt->counter_tcp_invalid_checksum, tv->sc_perf_pca);
@@ -4511,6 +4540,12 @@ TmEcode StreamTcpThreadInit(ThreadVars *tv, void *initdata, void **data)
     stt->counter_tcp_rst = SCPerfTVRegisterCounter("tcp.rst", tv,
                                                         SC_PERF_TYPE_UINT64,
                                                         "NULL");
+    stt->counter_tcp_bypass = SCPerfTVRegisterCounter("tcp.app_layer_bypass", tv,
+                                                        SC_PERF_TYPE_UINT64,
+                                                        "NULL");
+    stt->counter_tcp_bypass_bytes = SCPerfTVRegisterCounter("tcp.app_layer_bypass_bytes", tv,
+                                                        SC_PERF_TYPE_UINT64,
+                                                        "NULL");
 
     /* init reassembly ctx */
     stt->ra_ctx = StreamTcpReassembleInitThreadCtx();
@@ -5172,6 +5207,47 @@ void StreamTcpSetSessionNoReassemblyFlag (TcpSession *ssn, char direction)
                 (ssn->client.flags |= STREAMTCP_STREAM_FLAG_NOREASSEMBLY);
 }
 
+/** \brief  Set the bypass flag in the given TCP session: the app layer
+ *          stopped reassembly and inspection of the session, the rest of
+ *          it is accounted as bypassed.
+ *
+ * \param ssn TCP Session to set the flag in
+ */
+void StreamTcpSetSessionBypassFlag (TcpSession *ssn)
+{
+    ssn->flags |= STREAMTCP_FLAG_APP_LAYER_BYPASS;
+}
+
+/** \brief  Set the no bypass flag in the given TCP session: the app layer
+ *          needs the rest of the session, e.g. for tls.no_bypass rules.
+ *
+ * \param ssn TCP Session to set the flag in
+ */
+void StreamTcpSetSessionNoBypassFlag (TcpSession *ssn)
+{
+    ssn->flags |= STREAMTCP_FLAG_NO_BYPASS;
+}
+
+/** \brief  Check if the flow of a session should be bypassed: neither
+ *          direction is reassembled anymore, because the reassembly depth
+ *          was reached or the app layer lost interest, and the app layer
+ *          didn't ask to see the rest of the session.
+ *
+ * \param ssn TCP Session
+ *
+ * \retval 1 bypass
+ * \retval 0 don't bypass
+ */
+int StreamTcpCheckBypass(TcpSession *ssn)
+{
+    if (stream_config.bypass && ssn->state == TCP_ESTABLISHED &&
+        !(ssn->flags & STREAMTCP_FLAG_NO_BYPASS) &&
+        (ssn->client.flags & STREAMTCP_STREAM_FLAG_NOREASSEMBLY) &&
+        (ssn->server.flags & STREAMTCP_STREAM_FLAG_NOREASSEMBLY))
+        return 1;
+    return 0;
+}
+
 #define PSEUDO_PKT_SET_IPV4HDR(nipv4h,ipv4h) do { \
         IPV4_SET_RAW_VER(nipv4h, IPV4_GET_RAW_VER(ipv4h)); \
         IPV4_SET_RAW_HLEN(nipv4h, IPV4_GET_RAW_HLEN(ipv4h)); \
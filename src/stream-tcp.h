@@ -51,6 +51,7 @@ typedef struct TcpStreamCnf_ {
     uint32_t prealloc_sessions; /**< ssns to prealloc per stream thread */
     int midstream;
     int async_oneside;
+    int bypass;                 /**< bypass flows we no longer reassemble */
     uint32_t reassembly_depth;  /**< Depth until when we reassemble the stream */
 
     uint16_t reassembly_toserver_chunk_size;
@@ -96,6 +97,10 @@ typedef struct StreamTcpThread_ {
     uint16_t counter_tcp_synack;
     /** rst pkts */
     uint16_t counter_tcp_rst;
+    /** sessions bypassed by the app layer, e.g. encrypted tls */
+    uint16_t counter_tcp_bypass;
+    /** payload bytes of bypassed sessions */
+    uint16_t counter_tcp_bypass_bytes;
 
     /** tcp reassembly thread data */
     TcpReassemblyThreadCtx *ra_ctx;
@@ -207,6 +212,7 @@ TmEcode StreamTcpThreadDeinit(ThreadVars *tv, void *data);
 int StreamTcpPacket (ThreadVars *tv, Packet *p, StreamTcpThread *stt,
                      PacketQueue *pq);
 void StreamTcpSessionClear(void *ssnptr);
+int StreamTcpCheckBypass(TcpSession *);
 
 #endif /* __STREAM_TCP_H__ */
 
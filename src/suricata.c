@@ -55,6 +55,7 @@
 #include "util-running-modes.h"
 
 #include "detect-engine.h"
+#include "detect-engine-rulestats.h"
 #include "detect-parse.h"
 #include "detect-fast-pattern.h"
 #include "detect-engine-tag.h"
@@ -119,6 +120,7 @@
 #include "unix-manager.h"
 
 #include "app-layer-htp.h"
+#include "app-layer-slab.h"
 
 #include "util-radix-tree.h"
 #include "util-host-os-info.h"
@@ -1916,6 +1918,8 @@ int main(int argc, char **argv)
 #endif
 
     suri.rule_reload = IsRuleReloadSet(FALSE);
+    /* the pattern lists are used to share mpm ctxs on reload */
+    MpmSetRecordPatterns(suri.rule_reload);
 
     AppLayerDetectProtoThreadInit();
     AppLayerParsersInitPostProcess();
@@ -1982,6 +1986,8 @@ int main(int argc, char **argv)
     SCProfilingRulesGlobalInit();
     SCProfilingInit();
 #endif /* PROFILING */
+    SCProfilingSampleInit();
+    DetectRuleStatsGlobalInit();
     SCReputationInitCtx();
     SCProtoNameInit();
 
@@ -2214,6 +2220,7 @@ int main(int argc, char **argv)
         StreamTcpFreeConfig(STREAM_VERBOSE);
     }
     HostShutdown();
+    ThresholdShutdown();
 
     HTPFreeConfig();
     HTPAtExitPrintStats();
@@ -2233,6 +2240,7 @@ int main(int argc, char **argv)
         DetectEngineCtxFree(global_de_ctx);
     }
     AlpProtoDestroy();
+    AppLayerSlabDestroy();
 
     TagDestroyCtx();
 
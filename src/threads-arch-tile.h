@@ -45,6 +45,7 @@
 #define SCCtrlCondT pthread_cond_t
 #define SCCtrlCondInit pthread_cond_init
 #define SCCtrlCondSignal pthread_cond_signal
+#define SCCtrlCondBroadcast pthread_cond_broadcast
 #define SCCtrlCondTimedwait pthread_cond_timedwait
 #define SCCtrlCondDestroy pthread_cond_destroy
 
@@ -80,6 +81,7 @@
 #define SCCondT uint8_t
 #define SCCondInit(x,y) ({ 0; })
 #define SCCondSignal(x)
+#define SCCondBroadcast(x)
 #define SCCondDestroy(x)
 
 static inline void cycle_sleep(int cycles)
@@ -157,6 +157,7 @@ void *TmThreadsSlot1NoIn(void *td)
     memset(&s->slot_pre_pq, 0, sizeof(PacketQueue));
     memset(&s->slot_post_pq, 0, sizeof(PacketQueue));
 
+    PACKET_PROFILING_REGISTER_HISTOGRAMS(tv);
     tv->sc_perf_pca = SCPerfGetAllCountersArray(&tv->sc_perf_pctx);
     SCPerfAddToClubbedTMTable((tv->thread_group_name != NULL) ?
             tv->thread_group_name : tv->name, &tv->sc_perf_pctx);
@@ -267,6 +268,7 @@ void *TmThreadsSlot1NoOut(void *td)
     memset(&s->slot_pre_pq, 0, sizeof(PacketQueue));
     memset(&s->slot_post_pq, 0, sizeof(PacketQueue));
 
+    PACKET_PROFILING_REGISTER_HISTOGRAMS(tv);
     tv->sc_perf_pca = SCPerfGetAllCountersArray(&tv->sc_perf_pctx);
     SCPerfAddToClubbedTMTable((tv->thread_group_name != NULL) ?
             tv->thread_group_name : tv->name, &tv->sc_perf_pctx);
@@ -284,9 +286,11 @@ void *TmThreadsSlot1NoOut(void *td)
         p = tv->tmqh_in(tv);
 
         PACKET_PROFILING_TMM_START(p, s->tm_id);
+        PACKET_PROFILING_SAMPLE_TMM_START(p);
         r = SlotFunc(tv, p, SC_ATOMIC_GET(s->slot_data), /* no outqh no pq */ NULL,
                         /* no outqh no pq */ NULL);
         PACKET_PROFILING_TMM_END(p, s->tm_id);
+        PACKET_PROFILING_SAMPLE_TMM_END(p, s->tm_id);
 
         /* handle error */
         if (r == TM_ECODE_FAILED) {
@@ -360,6 +364,7 @@ void *TmThreadsSlot1NoInOut(void *td)
     memset(&s->slot_pre_pq, 0, sizeof(PacketQueue));
     memset(&s->slot_post_pq, 0, sizeof(PacketQueue));
 
+    PACKET_PROFILING_REGISTER_HISTOGRAMS(tv);
     tv->sc_perf_pca = SCPerfGetAllCountersArray(&tv->sc_perf_pctx);
     SCPerfAddToClubbedTMTable((tv->thread_group_name != NULL) ?
             tv->thread_group_name : tv->name, &tv->sc_perf_pctx);
@@ -450,6 +455,7 @@ void *TmThreadsSlot1(void *td)
     memset(&s->slot_post_pq, 0, sizeof(PacketQueue));
     SCMutexInit(&s->slot_post_pq.mutex_q, NULL);
 
+    PACKET_PROFILING_REGISTER_HISTOGRAMS(tv);
     tv->sc_perf_pca = SCPerfGetAllCountersArray(&tv->sc_perf_pctx);
     SCPerfAddToClubbedTMTable((tv->thread_group_name != NULL) ?
             tv->thread_group_name : tv->name, &tv->sc_perf_pctx);
@@ -469,9 +475,11 @@ void *TmThreadsSlot1(void *td)
         if (p != NULL) {
             TmSlotFunc SlotFunc = SC_ATOMIC_GET(s->SlotFunc);
             PACKET_PROFILING_TMM_START(p, s->tm_id);
+            PACKET_PROFILING_SAMPLE_TMM_START(p);
             r = SlotFunc(tv, p, SC_ATOMIC_GET(s->slot_data), &s->slot_pre_pq,
                             &s->slot_post_pq);
             PACKET_PROFILING_TMM_END(p, s->tm_id);
+            PACKET_PROFILING_SAMPLE_TMM_END(p, s->tm_id);
 
             /* handle error */
             if (r == TM_ECODE_FAILED) {
@@ -552,6 +560,7 @@ TmEcode TmThreadsSlotVarRun(ThreadVars *tv, Packet *p,
     for (s = slot; s != NULL; s = s->slot_next) {
         TmSlotFunc SlotFunc = SC_ATOMIC_GET(s->SlotFunc);
         PACKET_PROFILING_TMM_START(p, s->tm_id);
+        PACKET_PROFILING_SAMPLE_TMM_START(p);
 
         if (unlikely(s->id == 0)) {
             r = SlotFunc(tv, p, SC_ATOMIC_GET(s->slot_data), &s->slot_pre_pq, &s->slot_post_pq);
@@ -560,6 +569,7 @@ TmEcode TmThreadsSlotVarRun(ThreadVars *tv, Packet *p,
         }
 
         PACKET_PROFILING_TMM_END(p, s->tm_id);
+        PACKET_PROFILING_SAMPLE_TMM_END(p, s->tm_id);
 
         /* handle error */
         if (unlikely(r == TM_ECODE_FAILED)) {
@@ -687,6 +697,7 @@ void *TmThreadsSlotPktAcqLoop(void *td) {
         SCMutexInit(&slot->slot_post_pq.mutex_q, NULL);
     }
 
+    PACKET_PROFILING_REGISTER_HISTOGRAMS(tv);
     tv->sc_perf_pca = SCPerfGetAllCountersArray(&tv->sc_perf_pctx);
     SCPerfAddToClubbedTMTable((tv->thread_group_name != NULL) ?
             tv->thread_group_name : tv->name, &tv->sc_perf_pctx);
@@ -791,6 +802,7 @@ void *TmThreadsSlotVar(void *td)
         SCMutexInit(&s->slot_post_pq.mutex_q, NULL);
     }
 
+    PACKET_PROFILING_REGISTER_HISTOGRAMS(tv);
     tv->sc_perf_pca = SCPerfGetAllCountersArray(&tv->sc_perf_pctx);
     SCPerfAddToClubbedTMTable((tv->thread_group_name != NULL) ?
             tv->thread_group_name : tv->name, &tv->sc_perf_pctx);
@@ -1377,7 +1389,6 @@ ThreadVars *TmThreadCreate(char *name, char *inq_name, char *inqh_name,
     memset(tv, 0, sizeof(ThreadVars));
 
     SC_ATOMIC_INIT(tv->flags);
-    SCMutexInit(&tv->sc_perf_pctx.m, NULL);
 
     tv->name = name;
     /* default state for every newly created thread */
@@ -1857,8 +1868,6 @@ void TmThreadFree(ThreadVars *tv)
 
     SCLogDebug("Freeing thread '%s'.", tv->name);
 
-    SCMutexDestroy(&tv->sc_perf_pctx.m);
-
     s = (TmSlot *)tv->tm_slots;
     while (s) {
         ps = s;
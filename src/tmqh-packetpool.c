@@ -215,6 +215,7 @@ void TmqhOutputPacketpool(ThreadVars *t, Packet *p)
                 SCMutexUnlock(m);
 
                 PACKET_PROFILING_END(p);
+                PACKET_PROFILING_SAMPLE_END(p);
                 SCReturn;
             }
         } else {
@@ -282,6 +283,7 @@ void TmqhOutputPacketpool(ThreadVars *t, Packet *p)
     }
 
     PACKET_PROFILING_END(p);
+    PACKET_PROFILING_SAMPLE_END(p);
 
     p->ReleasePacket(p);
 
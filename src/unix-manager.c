@@ -25,6 +25,7 @@
 #include "suricata.h"
 #include "unix-manager.h"
 #include "detect-engine.h"
+#include "detect-engine-rulestats.h"
 #include "tm-threads.h"
 #include "runmodes.h"
 #include "conf.h"
@@ -32,6 +33,7 @@
 #include "util-privs.h"
 #include "util-debug.h"
 #include "util-signal.h"
+#include "util-profiling.h"
 
 #include <sys/un.h>
 #include <sys/stat.h>
@@ -858,6 +860,13 @@ void *UnixManagerThread(void *td)
     UnixManagerRegisterCommand("capture-mode", UnixManagerCaptureModeCommand, &command, 0);
     UnixManagerRegisterCommand("conf-get", UnixManagerConfGetCommand, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("dump-counters", SCPerfOutputCounterSocket, NULL, 0);
+    UnixManagerRegisterCommand("dump-metrics", SCPerfOutputMetricsSocket, NULL, 0);
+    UnixManagerRegisterCommand("profiling-sample-enable", SCProfilingSampleEnableSocket, NULL, 0);
+    UnixManagerRegisterCommand("profiling-sample-disable", SCProfilingSampleDisableSocket, NULL, 0);
+    UnixManagerRegisterCommand("profiling-sample-set", SCProfilingSampleSetSocket, NULL, UNIX_CMD_TAKE_ARGS);
+    UnixManagerRegisterCommand("profiling-sample-reset", SCProfilingSampleResetSocket, NULL, 0);
+    UnixManagerRegisterCommand("profiling-sample-dump", SCProfilingSampleDumpSocket, NULL, 0);
+    UnixManagerRegisterCommand("dump-rule-stats", DetectRuleStatsSocket, NULL, 0);
 #if 0
     UnixManagerRegisterCommand("reload-rules", UnixManagerReloadRules, NULL, 0);
 #endif
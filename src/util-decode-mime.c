@@ -0,0 +1,1088 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Streaming MIME parser. The lines of a message are parsed as they come
+ * in: headers of the entities, multipart boundaries (nested) and the
+ * bodies. Bodies of entities with a filename are decoded (base64 or
+ * quoted-printable) and passed to the file API, so the message is never
+ * buffered as a whole. Only the current header is buffered, up to the
+ * header depth.
+ */
+
+#include "suricata-common.h"
+
+#include "util-decode-mime.h"
+
+#include "util-debug.h"
+#include "util-unittest.h"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+/** size of the buffer decoded data is collected in before it is passed to
+ *  the file API */
+#define MIME_DEC_BUF_SIZE   1024
+
+static MimeDecConfig mime_dec_config = { 1, 1, MIME_DEC_DEFAULT_DECODE_DEPTH,
+    MIME_DEC_DEFAULT_HEADER_DEPTH, MIME_DEC_DEFAULT_FLOW_DEPTH };
+
+/** base64 alphabet value of a char, 0xff if not in the alphabet */
+static const uint8_t mime_dec_b64[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+void MimeDecSetConfig(MimeDecConfig *config)
+{
+    mime_dec_config = *config;
+    if (mime_dec_config.header_depth == 0)
+        mime_dec_config.header_depth = MIME_DEC_DEFAULT_HEADER_DEPTH;
+}
+
+MimeDecConfig *MimeDecGetConfig(void)
+{
+    return &mime_dec_config;
+}
+
+/**
+ *  \brief set up the parser of a message
+ *
+ *  \param f flow, used for the file flags
+ *  \param files container to add the attachments to
+ *  \param txid id the attachments get
+ *  \param flow_decoded counter of the bytes decoded from the flow, checked
+ *         against the flow depth, NULL for no flow limit
+ *
+ *  \retval mds parser state or NULL on alloc failure
+ */
+MimeDecParseState *MimeDecInitParser(Flow *f, FileContainer *files, uint64_t txid,
+        uint64_t *flow_decoded)
+{
+    MimeDecParseState *mds = SCMalloc(sizeof(MimeDecParseState));
+    if (unlikely(mds == NULL))
+        return NULL;
+    memset(mds, 0x00, sizeof(MimeDecParseState));
+
+    mds->f = f;
+    mds->files = files;
+    mds->txid = txid;
+    mds->flow_decoded = flow_decoded;
+    mds->state = MIME_DEC_STATE_HEADERS;
+    return mds;
+}
+
+void MimeDecDeInitParser(MimeDecParseState *mds)
+{
+    if (mds != NULL) {
+        if (mds->hdr != NULL)
+            SCFree(mds->hdr);
+        SCFree(mds);
+    }
+}
+
+static inline int MimeDecIsSpace(uint8_t c)
+{
+    return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+static inline int MimeDecHexValue(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ *  \internal
+ *  \brief get the file flags for a new attachment from the flow
+ */
+static uint16_t MimeDecFileFlags(Flow *f)
+{
+    uint16_t flags = 0;
+
+    if (f == NULL)
+        return 0;
+
+    if (f->flags & FLOW_FILE_NO_MAGIC_TS)
+        flags |= FILE_NOMAGIC;
+    if (f->flags & FLOW_FILE_NO_MD5_TS)
+        flags |= FILE_NOMD5;
+    if (f->flags & FLOW_FILE_NO_SHA1_TS)
+        flags |= FILE_NOSHA1;
+    if (f->flags & FLOW_FILE_NO_SHA256_TS)
+        flags |= FILE_NOSHA256;
+    if (f->flags & FLOW_FILE_NO_STORE_TS)
+        flags |= FILE_NOSTORE;
+
+    return flags;
+}
+
+/**
+ *  \internal
+ *  \brief check if the bytes decoded from the flow reached the flow depth
+ */
+static inline int MimeDecFlowDepthReached(MimeDecParseState *mds)
+{
+    return (mime_dec_config.flow_depth > 0 && mds->flow_decoded != NULL &&
+            *mds->flow_decoded >= mime_dec_config.flow_depth);
+}
+
+/**
+ *  \internal
+ *  \brief pass decoded data of the current attachment to the file API,
+ *         the file is closed as truncated when the decode depth or the
+ *         flow depth is reached
+ */
+static void MimeDecFileData(MimeDecParseState *mds, uint8_t *data, uint32_t data_len)
+{
+    if (!(mds->flags & MIME_DEC_FILE_OPEN) || data_len == 0)
+        return;
+
+    int truncate = 0;
+    if (mime_dec_config.decode_depth > 0 &&
+            mds->decoded + data_len >= mime_dec_config.decode_depth) {
+        data_len = mime_dec_config.decode_depth - mds->decoded;
+        truncate = 1;
+    }
+    if (MimeDecFlowDepthReached(mds)) {
+        data_len = 0;
+        truncate = 1;
+    } else if (mime_dec_config.flow_depth > 0 && mds->flow_decoded != NULL &&
+            *mds->flow_decoded + data_len >= mime_dec_config.flow_depth) {
+        data_len = mime_dec_config.flow_depth - *mds->flow_decoded;
+        truncate = 1;
+    }
+    mds->decoded += data_len;
+    if (mds->flow_decoded != NULL)
+        *mds->flow_decoded += data_len;
+
+    if (data_len > 0 && FileAppendData(mds->files, data, data_len) == -1) {
+        SCLogDebug("appending file data failed");
+        mds->flags &= ~MIME_DEC_FILE_OPEN;
+        return;
+    }
+
+    if (truncate) {
+        SCLogDebug("decode depth reached");
+        FileCloseFile(mds->files, NULL, 0, FILE_TRUNCATED);
+        mds->flags &= ~MIME_DEC_FILE_OPEN;
+    }
+}
+
+#if defined(__SSSE3__)
+/**
+ *  \internal
+ *  \brief decode a block of 16 base64 chars into 12 bytes
+ *
+ *  The chars are classified by their nibbles with two shuffle lookups, the
+ *  block is rejected if any of them is outside of the alphabet. A third
+ *  lookup gives the offset from char to value, then the 6 bit values are
+ *  packed with multiply-adds.
+ *
+ *  \retval 0 decoded
+ *  \retval -1 block has padding, whitespace or invalid chars, nothing is
+ *          written
+ */
+static inline int MimeDecBase64Block(const uint8_t *src, uint8_t *dst)
+{
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08,
+            0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+            0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+    __m128i in = _mm_loadu_si128((const __m128i *)src);
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+    __m128i lo_nibbles = _mm_and_si128(in, mask_2f);
+    __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+                    _mm_setzero_si128())) != 0)
+        return -1;
+
+    __m128i eq_2f = _mm_cmpeq_epi8(in, mask_2f);
+    __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+    __m128i v = _mm_add_epi8(in, roll);
+
+    v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+    v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                14, 13, 12, -1, -1, -1, -1));
+
+    uint8_t out[16];
+    _mm_storeu_si128((__m128i *)out, v);
+    memcpy(dst, out, 12);
+    return 0;
+}
+#endif /* __SSSE3__ */
+
+/**
+ *  \internal
+ *  \brief decode the base64 chars carried over at padding or at the end of
+ *         the part
+ */
+static void MimeDecBase64Final(MimeDecParseState *mds, uint8_t *out, uint32_t *out_len)
+{
+    uint8_t *b = mds->b64;
+
+    if (mds->b64_len == 1) {
+        mds->anomalies |= MIME_DEC_ANOM_INVALID_BASE64;
+    } else if (mds->b64_len >= 2) {
+        out[(*out_len)++] = (b[0] << 2) | (b[1] >> 4);
+        if (mds->b64_len == 3)
+            out[(*out_len)++] = (b[1] << 4) | (b[2] >> 2);
+    }
+    mds->b64_len = 0;
+}
+
+/**
+ *  \internal
+ *  \brief decode a base64 body line
+ *
+ *  Line breaks are not data in base64, so chars of an incomplete quad are
+ *  carried over to the next line. Whitespace is skipped, other chars outside
+ *  of the alphabet are skipped and flagged.
+ */
+static void MimeDecBase64Line(MimeDecParseState *mds, uint8_t *line, uint32_t len)
+{
+    uint8_t out[MIME_DEC_BUF_SIZE];
+    uint32_t out_len = 0;
+    uint32_t i = 0;
+
+    while (i < len) {
+#if defined(__SSSE3__)
+        if (mds->b64_len == 0) {
+            while (len - i >= 16 && out_len + 12 <= sizeof(out) &&
+                    MimeDecBase64Block(line + i, out + out_len) == 0) {
+                i += 16;
+                out_len += 12;
+            }
+            if (i == len)
+                break;
+        }
+#endif
+        uint8_t c = line[i++];
+        uint8_t v = mime_dec_b64[c];
+
+        if (v != 0xff) {
+            mds->b64[mds->b64_len++] = v;
+            if (mds->b64_len == 4) {
+                uint8_t *b = mds->b64;
+                out[out_len++] = (b[0] << 2) | (b[1] >> 4);
+                out[out_len++] = (b[1] << 4) | (b[2] >> 2);
+                out[out_len++] = (b[2] << 6) | b[3];
+                mds->b64_len = 0;
+            }
+        } else if (c == '=') {
+            MimeDecBase64Final(mds, out, &out_len);
+        } else if (!MimeDecIsSpace(c)) {
+            mds->anomalies |= MIME_DEC_ANOM_INVALID_BASE64;
+        }
+
+        if (out_len + 16 > sizeof(out)) {
+            MimeDecFileData(mds, out, out_len);
+            out_len = 0;
+        }
+    }
+
+    MimeDecFileData(mds, out, out_len);
+}
+
+/**
+ *  \internal
+ *  \brief decode a quoted-printable body line
+ *
+ *  The line break is data unless the line ends in a soft line break ('=').
+ *  It is passed on with the next line, as the line break before a boundary
+ *  belongs to the boundary.
+ */
+static void MimeDecQpLine(MimeDecParseState *mds, uint8_t *line, uint32_t len)
+{
+    uint8_t out[MIME_DEC_BUF_SIZE];
+    uint32_t out_len = 0;
+    uint32_t i;
+    int soft_break = 0;
+
+    if (mds->flags & MIME_DEC_CRLF_PENDING) {
+        out[out_len++] = '\r';
+        out[out_len++] = '\n';
+    }
+
+    /* trailing whitespace was added in transport */
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t'))
+        len--;
+
+    for (i = 0; i < len; i++) {
+        uint8_t c = line[i];
+
+        if (c == '=') {
+            if (i + 1 == len) {
+                soft_break = 1;
+                break;
+            }
+            int h1 = MimeDecHexValue(line[i + 1]);
+            int h2 = (i + 2 < len) ? MimeDecHexValue(line[i + 2]) : -1;
+            if (h1 >= 0 && h2 >= 0) {
+                out[out_len++] = (uint8_t)((h1 << 4) | h2);
+                i += 2;
+            } else {
+                mds->anomalies |= MIME_DEC_ANOM_INVALID_QP;
+                out[out_len++] = c;
+            }
+        } else {
+            out[out_len++] = c;
+        }
+
+        if (out_len + 2 > sizeof(out)) {
+            MimeDecFileData(mds, out, out_len);
+            out_len = 0;
+        }
+    }
+
+    if (soft_break)
+        mds->flags &= ~MIME_DEC_CRLF_PENDING;
+    else
+        mds->flags |= MIME_DEC_CRLF_PENDING;
+
+    MimeDecFileData(mds, out, out_len);
+}
+
+/**
+ *  \internal
+ *  \brief pass a body line of a 7bit, 8bit or binary part on as is
+ */
+static void MimeDecRawLine(MimeDecParseState *mds, uint8_t *line, uint32_t len)
+{
+    if (mds->flags & MIME_DEC_CRLF_PENDING)
+        MimeDecFileData(mds, (uint8_t *)"\r\n", 2);
+    MimeDecFileData(mds, line, len);
+    mds->flags |= MIME_DEC_CRLF_PENDING;
+}
+
+/**
+ *  \internal
+ *  \brief find a parameter in a header value, e.g. boundary="xyz"
+ *
+ *  \param value header value, the part after the ':'
+ *  \param name lowercase parameter name
+ *
+ *  \retval 1 found, the value is returned in ret and ret_len without quotes
+ *  \retval 0 not found
+ */
+static int MimeDecFindParam(uint8_t *value, uint32_t value_len,
+        const char *name, uint8_t **ret, uint32_t *ret_len)
+{
+    uint32_t name_len = strlen(name);
+    uint32_t i = 0;
+
+    while (i < value_len) {
+        /* parameters follow a ';' */
+        while (i < value_len && value[i] != ';')
+            i++;
+        if (i == value_len)
+            break;
+        i++;
+        while (i < value_len && MimeDecIsSpace(value[i]))
+            i++;
+
+        if (value_len - i <= name_len ||
+                strncasecmp((char *)value + i, name, name_len) != 0)
+            continue;
+
+        uint32_t j = i + name_len;
+        while (j < value_len && MimeDecIsSpace(value[j]))
+            j++;
+        if (j == value_len || value[j] != '=')
+            continue;
+        j++;
+        while (j < value_len && MimeDecIsSpace(value[j]))
+            j++;
+
+        uint32_t start, end;
+        if (j < value_len && value[j] == '"') {
+            start = ++j;
+            while (j < value_len && value[j] != '"')
+                j++;
+            end = j;
+        } else {
+            start = j;
+            while (j < value_len && value[j] != ';' && !MimeDecIsSpace(value[j]))
+                j++;
+            end = j;
+        }
+
+        *ret = value + start;
+        *ret_len = end - start;
+        return 1;
+    }
+
+    return 0;
+}
+
+static void MimeDecSetFilename(MimeDecParseState *mds, uint8_t *name, uint32_t name_len)
+{
+    if (name_len > MIME_DEC_MAX_FILENAME_LEN)
+        name_len = MIME_DEC_MAX_FILENAME_LEN;
+    memcpy(mds->filename, name, name_len);
+    mds->filename_len = (uint16_t)name_len;
+}
+
+/**
+ *  \internal
+ *  \brief process the header that was buffered: we're interested in the
+ *         content type, content disposition and transfer encoding
+ */
+static void MimeDecProcessHeader(MimeDecParseState *mds)
+{
+    uint8_t *hdr = mds->hdr;
+    uint32_t len = mds->hdr_len;
+    uint8_t *param;
+    uint32_t param_len;
+
+    if (len == 0)
+        return;
+    mds->hdr_len = 0;
+
+    uint8_t *colon = memchr(hdr, ':', len);
+    if (colon == NULL)
+        return;
+
+    uint32_t name_len = colon - hdr;
+    while (name_len > 0 && MimeDecIsSpace(hdr[name_len - 1]))
+        name_len--;
+
+    uint8_t *value = colon + 1;
+    uint32_t value_len = len - (value - hdr);
+    while (value_len > 0 && MimeDecIsSpace(*value)) {
+        value++;
+        value_len--;
+    }
+
+    if (name_len == 12 && strncasecmp((char *)hdr, "content-type", 12) == 0) {
+        if (value_len >= 10 && strncasecmp((char *)value, "multipart/", 10) == 0) {
+            if (MimeDecFindParam(value, value_len, "boundary", &param, &param_len) == 1 &&
+                    param_len > 0 && param_len <= MIME_DEC_MAX_BOUNDARY_LEN) {
+                memcpy(mds->boundary.str, param, param_len);
+                mds->boundary.len = (uint8_t)param_len;
+            }
+        } else if (mds->filename_len == 0 &&
+                MimeDecFindParam(value, value_len, "name", &param, &param_len) == 1) {
+            MimeDecSetFilename(mds, param, param_len);
+        }
+
+    } else if (name_len == 19 &&
+            strncasecmp((char *)hdr, "content-disposition", 19) == 0) {
+        if (MimeDecFindParam(value, value_len, "filename", &param, &param_len) == 1)
+            MimeDecSetFilename(mds, param, param_len);
+
+    } else if (name_len == 25 &&
+            strncasecmp((char *)hdr, "content-transfer-encoding", 25) == 0) {
+        if (value_len >= 6 && strncasecmp((char *)value, "base64", 6) == 0)
+            mds->encoding = MIME_DEC_ENC_BASE64;
+        else if (value_len >= 16 &&
+                strncasecmp((char *)value, "quoted-printable", 16) == 0)
+            mds->encoding = MIME_DEC_ENC_QP;
+    }
+}
+
+/**
+ *  \internal
+ *  \brief headers of an entity are complete: a multipart entity pushes its
+ *         boundary, an entity with a filename is extracted
+ */
+static void MimeDecHeadersDone(MimeDecParseState *mds)
+{
+    mds->state = MIME_DEC_STATE_BODY;
+
+    if (mds->boundary.len > 0) {
+        if (mds->depth < MIME_DEC_MAX_DEPTH) {
+            mds->stack[mds->depth++] = mds->boundary;
+        } else {
+            mds->anomalies |= MIME_DEC_ANOM_TOO_DEEP;
+        }
+        return;
+    }
+
+    if (mds->filename_len == 0 || mds->files == NULL)
+        return;
+    if (mds->encoding == MIME_DEC_ENC_BASE64 && !mime_dec_config.decode_base64)
+        return;
+    if (mds->encoding == MIME_DEC_ENC_QP && !mime_dec_config.decode_quoted_printable)
+        return;
+
+    /* the flow depth is used up, no more attachments are extracted */
+    if (MimeDecFlowDepthReached(mds))
+        return;
+
+    FilePrune(mds->files);
+
+    File *ff = FileOpenFile(mds->files, mds->filename, mds->filename_len,
+            NULL, 0, MimeDecFileFlags(mds->f));
+    if (ff == NULL) {
+        SCLogDebug("opening file failed");
+        return;
+    }
+    FileSetTx(ff, mds->txid);
+
+    mds->flags |= (MIME_DEC_FILE_OPEN|MIME_DEC_FILE_NEW);
+    mds->decoded = 0;
+}
+
+/**
+ *  \internal
+ *  \brief end the current entity: close the attachment, if any
+ */
+static void MimeDecEndEntity(MimeDecParseState *mds, uint8_t flags)
+{
+    if (mds->flags & MIME_DEC_FILE_OPEN) {
+        if (mds->encoding == MIME_DEC_ENC_BASE64 && mds->b64_len > 0) {
+            uint8_t out[3];
+            uint32_t out_len = 0;
+            MimeDecBase64Final(mds, out, &out_len);
+            MimeDecFileData(mds, out, out_len);
+        }
+    }
+    if (mds->flags & MIME_DEC_FILE_OPEN) {
+        FileCloseFile(mds->files, NULL, 0, flags);
+    }
+
+    /* keep the new file flag until the caller picked it up */
+    mds->flags &= MIME_DEC_FILE_NEW;
+    mds->encoding = MIME_DEC_ENC_NONE;
+    mds->b64_len = 0;
+    mds->filename_len = 0;
+    mds->boundary.len = 0;
+    mds->hdr_len = 0;
+}
+
+/**
+ *  \internal
+ *  \brief check if a line is a boundary of one of the enclosing multipart
+ *         entities: "--boundary" or "--boundary--", optionally followed by
+ *         whitespace
+ *
+ *  \retval idx stack index of the matching boundary, -1 if no match
+ */
+static int MimeDecMatchBoundary(MimeDecParseState *mds, uint8_t *line,
+        uint32_t len, int *close)
+{
+    int idx;
+
+    if (len < 2 || line[0] != '-' || line[1] != '-')
+        return -1;
+    line += 2;
+    len -= 2;
+
+    for (idx = (int)mds->depth - 1; idx >= 0; idx--) {
+        MimeDecBoundary *b = &mds->stack[idx];
+        if (len < b->len || memcmp(line, b->str, b->len) != 0)
+            continue;
+
+        uint32_t i = b->len;
+        *close = 0;
+        if (len - i >= 2 && line[i] == '-' && line[i + 1] == '-') {
+            *close = 1;
+            i += 2;
+        }
+        while (i < len && MimeDecIsSpace(line[i]))
+            i++;
+        if (i == len)
+            return idx;
+    }
+
+    return -1;
+}
+
+static void MimeDecHeaderAppend(MimeDecParseState *mds, uint8_t *line, uint32_t len)
+{
+    if (mds->hdr_len + len > mime_dec_config.header_depth) {
+        mds->anomalies |= MIME_DEC_ANOM_LONG_HEADER;
+        len = mime_dec_config.header_depth - mds->hdr_len;
+        if (len == 0)
+            return;
+    }
+
+    if (mds->hdr_len + len > mds->hdr_size) {
+        uint32_t size = mds->hdr_size ? mds->hdr_size : 256;
+        while (size < mds->hdr_len + len)
+            size *= 2;
+        uint8_t *ptr = SCRealloc(mds->hdr, size);
+        if (unlikely(ptr == NULL))
+            return;
+        mds->hdr = ptr;
+        mds->hdr_size = size;
+    }
+
+    memcpy(mds->hdr + mds->hdr_len, line, len);
+    mds->hdr_len += len;
+}
+
+/**
+ *  \brief parse a line of the message
+ *
+ *  \param mds parser state
+ *  \param line the line, without the line break
+ *  \param len length of the line
+ */
+void MimeDecParseLine(MimeDecParseState *mds, uint8_t *line, uint32_t len)
+{
+    if (mds->state == MIME_DEC_STATE_HEADERS) {
+        if (len == 0) {
+            MimeDecProcessHeader(mds);
+            MimeDecHeadersDone(mds);
+        } else if ((line[0] == ' ' || line[0] == '\t') && mds->hdr_len > 0) {
+            /* folded header */
+            MimeDecHeaderAppend(mds, line, len);
+        } else {
+            MimeDecProcessHeader(mds);
+            MimeDecHeaderAppend(mds, line, len);
+        }
+        return;
+    }
+
+    if (mds->depth > 0) {
+        int close = 0;
+        int idx = MimeDecMatchBoundary(mds, line, len, &close);
+        if (idx >= 0) {
+            SCLogDebug("boundary of level %d, close %d", idx, close);
+            MimeDecEndEntity(mds, 0);
+
+            if (close) {
+                /* rest is the epilogue of the multipart entity, which is
+                 * body of the enclosing one */
+                mds->depth = (uint8_t)idx;
+                mds->state = MIME_DEC_STATE_BODY;
+            } else {
+                mds->depth = (uint8_t)idx + 1;
+                mds->state = MIME_DEC_STATE_HEADERS;
+            }
+            return;
+        }
+    }
+
+    if (!(mds->flags & MIME_DEC_FILE_OPEN))
+        return;
+
+    switch (mds->encoding) {
+        case MIME_DEC_ENC_BASE64:
+            MimeDecBase64Line(mds, line, len);
+            break;
+        case MIME_DEC_ENC_QP:
+            MimeDecQpLine(mds, line, len);
+            break;
+        default:
+            MimeDecRawLine(mds, line, len);
+            break;
+    }
+}
+
+/**
+ *  \brief end of the message: close an attachment that is still open, as
+ *         truncated if the multipart entities weren't closed
+ */
+void MimeDecParseComplete(MimeDecParseState *mds)
+{
+    MimeDecEndEntity(mds, mds->depth > 0 ? FILE_TRUNCATED : 0);
+}
+
+#ifdef UNITTESTS
+
+static int MimeDecTestParse(MimeDecParseState *mds, char *msg)
+{
+    char *line = msg;
+    char *eol;
+
+    while ((eol = strstr(line, "\r\n")) != NULL) {
+        MimeDecParseLine(mds, (uint8_t *)line, eol - line);
+        line = eol + 2;
+    }
+    MimeDecParseComplete(mds);
+    return 0;
+}
+
+static int MimeDecTestFileData(File *ff, char *expected, uint32_t expected_len)
+{
+    uint8_t buf[512];
+    uint32_t len = 0;
+    FileData *fd;
+
+    for (fd = ff->chunks_head; fd != NULL; fd = fd->next) {
+        if (len + fd->len > sizeof(buf))
+            return 0;
+        memcpy(buf + len, fd->data, fd->len);
+        len += fd->len;
+    }
+
+    if (len != expected_len || memcmp(buf, expected, len) != 0) {
+        printf("file data mismatch, got %u bytes: ", len);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ *  \test multipart message with a base64 and a quoted-printable attachment
+ *        and a text part that is not extracted
+ */
+static int MimeDecTest01(void)
+{
+    int result = 0;
+    Flow f;
+    memset(&f, 0x00, sizeof(f));
+    char msg[] =
+        "From: a@example.com\r\n"
+        "Content-Type: multipart/mixed;\r\n"
+        "\tboundary=\"XXX\"\r\n"
+        "\r\n"
+        "preamble\r\n"
+        "--XXX\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n"
+        "hello\r\n"
+        "--XXX\r\n"
+        "Content-Type: application/octet-stream; name=\"a.bin\"\r\n"
+        "Content-Transfer-Encoding: base64\r\n"
+        "\r\n"
+        "VGhpcyBpcyBhIHRlc3Qgb2YgdGhlIGJhc2U2NCBkZWNvZGVyIQ==\r\n"
+        "--XXX\r\n"
+        "Content-Disposition: attachment; filename=b.txt\r\n"
+        "Content-Transfer-Encoding: quoted-printable\r\n"
+        "\r\n"
+        "caf=C3=A9 soft=\r\n"
+        "break\r\n"
+        "--XXX--\r\n"
+        "epilogue\r\n";
+
+    FileContainer *files = FileContainerAlloc();
+    if (files == NULL)
+        return 0;
+    MimeDecParseState *mds = MimeDecInitParser(&f, files, 0, NULL);
+    if (mds == NULL)
+        goto end;
+
+    MimeDecTestParse(mds, msg);
+
+    File *ff = files->head;
+    if (ff == NULL || ff->next == NULL || ff->next->next != NULL) {
+        printf("expected 2 files: ");
+        goto end;
+    }
+    if (ff->name_len != 5 || memcmp(ff->name, "a.bin", 5) != 0 ||
+            ff->state != FILE_STATE_CLOSED) {
+        printf("first file bad: ");
+        goto end;
+    }
+    if (!MimeDecTestFileData(ff, "This is a test of the base64 decoder!", 37))
+        goto end;
+
+    ff = ff->next;
+    if (ff->name_len != 5 || memcmp(ff->name, "b.txt", 5) != 0 ||
+            ff->state != FILE_STATE_CLOSED) {
+        printf("second file bad: ");
+        goto end;
+    }
+    if (!MimeDecTestFileData(ff, "caf\xc3\xa9 softbreak", 15))
+        goto end;
+
+    if (mds->anomalies != 0 || mds->depth != 0) {
+        printf("anomalies %02x depth %u: ", mds->anomalies, mds->depth);
+        goto end;
+    }
+
+    result = 1;
+end:
+    MimeDecDeInitParser(mds);
+    FileContainerFree(files);
+    return result;
+}
+
+/**
+ *  \test nested multipart, base64 quads split over lines and a message that
+ *        ends before the closing boundary
+ */
+static int MimeDecTest02(void)
+{
+    int result = 0;
+    Flow f;
+    memset(&f, 0x00, sizeof(f));
+    char msg[] =
+        "Content-Type: multipart/mixed; boundary=outer\r\n"
+        "\r\n"
+        "--outer\r\n"
+        "Content-Type: multipart/alternative; boundary=inner\r\n"
+        "\r\n"
+        "--inner\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n"
+        "--inner--\r\n"
+        "--outer\r\n"
+        "Content-Type: application/zip; name=c.zip\r\n"
+        "Content-Transfer-Encoding: base64\r\n"
+        "\r\n"
+        "QUJD\r\n"
+        "REVGR0hJSktMTU5PUFFSU1RVVldY\r\n"
+        "WVphYmNkZWZnaGlqa2xtbm9wcXJzdHV2d3h5ejAx\r\n"
+        "Mj\r\n"
+        "M0NTY3ODk\r\n";
+
+    FileContainer *files = FileContainerAlloc();
+    if (files == NULL)
+        return 0;
+    MimeDecParseState *mds = MimeDecInitParser(&f, files, 0, NULL);
+    if (mds == NULL)
+        goto end;
+
+    MimeDecTestParse(mds, msg);
+
+    File *ff = files->head;
+    if (ff == NULL || ff->next != NULL) {
+        printf("expected 1 file: ");
+        goto end;
+    }
+    if (ff->name_len != 5 || memcmp(ff->name, "c.zip", 5) != 0) {
+        printf("file name bad: ");
+        goto end;
+    }
+    if (ff->state != FILE_STATE_TRUNCATED) {
+        printf("file state %d, expected truncated: ", ff->state);
+        goto end;
+    }
+    if (!MimeDecTestFileData(ff,
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", 62))
+        goto end;
+
+    result = 1;
+end:
+    MimeDecDeInitParser(mds);
+    FileContainerFree(files);
+    return result;
+}
+
+/**
+ *  \test decode depth truncates the attachment, invalid base64 is flagged
+ */
+static int MimeDecTest03(void)
+{
+    int result = 0;
+    Flow f;
+    memset(&f, 0x00, sizeof(f));
+    MimeDecConfig saved = *MimeDecGetConfig();
+    MimeDecConfig config = saved;
+    config.decode_depth = 10;
+    MimeDecSetConfig(&config);
+
+    char msg[] =
+        "Content-Type: application/octet-stream; name=d\r\n"
+        "Content-Transfer-Encoding: base64\r\n"
+        "\r\n"
+        "QUJDREVGR0hJSktMTU5PUFFSU1RVVldYWVo*\r\n";
+
+    FileContainer *files = FileContainerAlloc();
+    if (files == NULL)
+        goto end;
+    MimeDecParseState *mds = MimeDecInitParser(&f, files, 0, NULL);
+    if (mds == NULL)
+        goto end;
+
+    MimeDecTestParse(mds, msg);
+
+    File *ff = files->head;
+    if (ff == NULL || ff->state != FILE_STATE_TRUNCATED) {
+        printf("expected truncated file: ");
+        goto cleanup;
+    }
+    if (!MimeDecTestFileData(ff, "ABCDEFGHIJ", 10))
+        goto cleanup;
+    if (!(mds->anomalies & MIME_DEC_ANOM_INVALID_BASE64)) {
+        printf("invalid base64 not flagged: ");
+        goto cleanup;
+    }
+
+    result = 1;
+cleanup:
+    MimeDecDeInitParser(mds);
+    FileContainerFree(files);
+end:
+    MimeDecSetConfig(&saved);
+    return result;
+}
+
+/**
+ *  \test the SIMD base64 block decoder agrees with the scalar one for every
+ *        char in every position
+ */
+static int MimeDecTest04(void)
+{
+#if defined(__SSSE3__)
+    const char *valid = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint8_t in[16];
+    uint8_t out[12];
+    int pos, c, i;
+
+    for (pos = 0; pos < 16; pos++) {
+        for (c = 0; c < 256; c++) {
+            for (i = 0; i < 16; i++)
+                in[i] = valid[(i * 7 + pos) % 64];
+            in[pos] = (uint8_t)c;
+
+            int r = MimeDecBase64Block(in, out);
+            if (mime_dec_b64[c] == 0xff) {
+                if (r != -1) {
+                    printf("char %02x at %d accepted: ", c, pos);
+                    return 0;
+                }
+                continue;
+            }
+            if (r != 0) {
+                printf("char %02x at %d rejected: ", c, pos);
+                return 0;
+            }
+            for (i = 0; i < 4; i++) {
+                uint8_t *b = in + i * 4;
+                uint8_t o0 = (mime_dec_b64[b[0]] << 2) | (mime_dec_b64[b[1]] >> 4);
+                uint8_t o1 = (mime_dec_b64[b[1]] << 4) | (mime_dec_b64[b[2]] >> 2);
+                uint8_t o2 = (mime_dec_b64[b[2]] << 6) | mime_dec_b64[b[3]];
+                if (out[i * 3] != o0 || out[i * 3 + 1] != o1 || out[i * 3 + 2] != o2) {
+                    printf("char %02x at %d decoded wrong: ", c, pos);
+                    return 0;
+                }
+            }
+        }
+    }
+#endif
+    return 1;
+}
+
+/**
+ *  \test the flow depth truncates the attachment that reaches it and no
+ *        attachments are extracted from later messages of the flow
+ */
+static int MimeDecTest05(void)
+{
+    int result = 0;
+    Flow f;
+    memset(&f, 0x00, sizeof(f));
+    MimeDecConfig saved = *MimeDecGetConfig();
+    MimeDecConfig config = saved;
+    config.decode_depth = 0;
+    config.flow_depth = 16;
+    MimeDecSetConfig(&config);
+    MimeDecParseState *mds = NULL;
+    uint64_t flow_decoded = 0;
+
+    char msg1[] =
+        "Content-Type: application/octet-stream; name=e\r\n"
+        "\r\n"
+        "0123456789\r\n";
+    char msg2[] =
+        "Content-Type: application/octet-stream; name=f\r\n"
+        "\r\n"
+        "0123456789\r\n";
+    char msg3[] =
+        "Content-Type: application/octet-stream; name=g\r\n"
+        "\r\n"
+        "0123456789\r\n";
+
+    FileContainer *files = FileContainerAlloc();
+    if (files == NULL)
+        goto end;
+
+    mds = MimeDecInitParser(&f, files, 0, &flow_decoded);
+    if (mds == NULL)
+        goto cleanup;
+    MimeDecTestParse(mds, msg1);
+    MimeDecDeInitParser(mds);
+
+    mds = MimeDecInitParser(&f, files, 1, &flow_decoded);
+    if (mds == NULL)
+        goto cleanup;
+    MimeDecTestParse(mds, msg2);
+    MimeDecDeInitParser(mds);
+
+    mds = MimeDecInitParser(&f, files, 2, &flow_decoded);
+    if (mds == NULL)
+        goto cleanup;
+    MimeDecTestParse(mds, msg3);
+    MimeDecDeInitParser(mds);
+    mds = NULL;
+
+    if (flow_decoded != 16) {
+        printf("flow decoded %"PRIu64", expected 16: ", flow_decoded);
+        goto cleanup;
+    }
+
+    File *ff = files->head;
+    if (ff == NULL || ff->next == NULL || ff->next->next != NULL) {
+        printf("expected 2 files: ");
+        goto cleanup;
+    }
+    if (ff->state != FILE_STATE_CLOSED || ff->size != 10) {
+        printf("first file state %d size %"PRIu64": ", ff->state, ff->size);
+        goto cleanup;
+    }
+    ff = ff->next;
+    if (ff->state != FILE_STATE_TRUNCATED || ff->size != 6) {
+        printf("second file state %d size %"PRIu64": ", ff->state, ff->size);
+        goto cleanup;
+    }
+
+    result = 1;
+cleanup:
+    MimeDecDeInitParser(mds);
+    FileContainerFree(files);
+end:
+    MimeDecSetConfig(&saved);
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void MimeDecRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("MimeDecTest01", MimeDecTest01, 1);
+    UtRegisterTest("MimeDecTest02", MimeDecTest02, 1);
+    UtRegisterTest("MimeDecTest03", MimeDecTest03, 1);
+    UtRegisterTest("MimeDecTest04", MimeDecTest04, 1);
+    UtRegisterTest("MimeDecTest05", MimeDecTest05, 1);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,117 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __UTIL_DECODE_MIME_H__
+#define __UTIL_DECODE_MIME_H__
+
+#include "flow.h"
+#include "util-file.h"
+
+/** multipart entities nested deeper than this are not parsed */
+#define MIME_DEC_MAX_DEPTH              8
+/** max boundary length, RFC 2046 */
+#define MIME_DEC_MAX_BOUNDARY_LEN       70
+/** filenames are truncated to this length */
+#define MIME_DEC_MAX_FILENAME_LEN       256
+/** default max length of a (folded) header */
+#define MIME_DEC_DEFAULT_HEADER_DEPTH   2048
+/** default max bytes decoded per attachment */
+#define MIME_DEC_DEFAULT_DECODE_DEPTH   (1024 * 1024)
+/** default max bytes decoded from all the messages of a flow */
+#define MIME_DEC_DEFAULT_FLOW_DEPTH     (10 * 1024 * 1024)
+
+/** content transfer encodings */
+#define MIME_DEC_ENC_NONE               0   /**< 7bit, 8bit or binary */
+#define MIME_DEC_ENC_BASE64             1
+#define MIME_DEC_ENC_QP                 2   /**< quoted-printable */
+
+/** parser states */
+#define MIME_DEC_STATE_HEADERS          0
+#define MIME_DEC_STATE_BODY             1
+
+/** MimeDecParseState::flags */
+#define MIME_DEC_FILE_OPEN              0x01    /**< attachment is extracted */
+#define MIME_DEC_CRLF_PENDING           0x02    /**< line break before the
+                                                     next line is data */
+#define MIME_DEC_FILE_NEW               0x04    /**< attachment was opened,
+                                                     cleared by the caller */
+
+/** MimeDecParseState::anomalies */
+#define MIME_DEC_ANOM_INVALID_BASE64    0x01
+#define MIME_DEC_ANOM_INVALID_QP        0x02
+#define MIME_DEC_ANOM_LONG_HEADER       0x04
+#define MIME_DEC_ANOM_TOO_DEEP          0x08
+
+typedef struct MimeDecConfig_ {
+    int decode_base64;
+    int decode_quoted_printable;
+    uint32_t decode_depth;      /**< max bytes decoded per attachment,
+                                     0 for no limit */
+    uint32_t header_depth;      /**< max length of a header */
+    uint64_t flow_depth;        /**< max bytes decoded from all the messages
+                                     of a flow, 0 for no limit */
+} MimeDecConfig;
+
+typedef struct MimeDecBoundary_ {
+    uint8_t len;
+    uint8_t str[MIME_DEC_MAX_BOUNDARY_LEN];
+} MimeDecBoundary;
+
+/** State of the parser of a single message. Lines of the message are fed
+ *  to it as they come in, attachments are passed to the file API. */
+typedef struct MimeDecParseState_ {
+    Flow *f;
+    FileContainer *files;       /**< container the attachments are added to */
+    uint64_t txid;
+    uint64_t *flow_decoded;     /**< bytes decoded from the flow, owned by
+                                     the caller, may be NULL */
+
+    uint8_t state;
+    uint8_t flags;
+    uint8_t anomalies;          /**< MIME_DEC_ANOM_*, cleared by the caller */
+    uint8_t depth;              /**< boundaries on the stack */
+
+    /* current entity */
+    uint8_t encoding;
+    uint8_t b64_len;            /**< base64 chars carried to the next line */
+    uint8_t b64[4];
+    uint16_t filename_len;
+    uint8_t filename[MIME_DEC_MAX_FILENAME_LEN];
+    MimeDecBoundary boundary;   /**< boundary if it is a multipart entity */
+    uint64_t decoded;           /**< bytes of the current attachment */
+
+    /** boundaries of the enclosing multipart entities, innermost last */
+    MimeDecBoundary stack[MIME_DEC_MAX_DEPTH];
+
+    /** current header, folded lines are appended */
+    uint8_t *hdr;
+    uint32_t hdr_len;
+    uint32_t hdr_size;
+} MimeDecParseState;
+
+void MimeDecSetConfig(MimeDecConfig *);
+MimeDecConfig *MimeDecGetConfig(void);
+
+MimeDecParseState *MimeDecInitParser(Flow *, FileContainer *, uint64_t,
+        uint64_t *);
+void MimeDecDeInitParser(MimeDecParseState *);
+void MimeDecParseLine(MimeDecParseState *, uint8_t *, uint32_t);
+void MimeDecParseComplete(MimeDecParseState *);
+
+void MimeDecRegisterTests(void);
+
+#endif /* __UTIL_DECODE_MIME_H__ */
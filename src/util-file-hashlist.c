@@ -0,0 +1,894 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Read only lists of file hashes for the filemd5, filesha1 and filesha256
+ * keywords.
+ *
+ * The hashes are kept sorted in a single array. A bucket index on the
+ * first FILE_HASHLIST_BUCKET_BITS bits of the hash narrows a lookup down
+ * to a small range that is then binary searched.
+ *
+ * The same layout is used on disk: header, bucket index, hashes. A binary
+ * list is mmap'd read only and used in place, so even very large lists
+ * load without parsing or copying. When a text list is loaded, a binary
+ * copy is stored next to it (FILE_HASHLIST_SUFFIX) and used on the next
+ * load as long as the text list is unchanged.
+ */
+
+#include "suricata-common.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-file-hashlist.h"
+
+#include <sys/mman.h>
+
+/** binary lists are only written for lists at least this large, smaller
+ *  lists load from text quickly enough */
+#define FILE_HASHLIST_CACHE_MIN     65536
+
+/** max supported hash length (sha512) */
+#define FILE_HASHLIST_MAX_HASH_LEN  64
+
+#define FILE_HASHLIST_BYTE_ORDER    0x01020304
+
+/** on disk header, followed by the bucket index and the sorted hashes */
+typedef struct FileHashListHdr_ {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        /**< FILE_HASHLIST_BYTE_ORDER in writer order */
+    uint32_t count;
+    uint16_t hash_len;
+    uint8_t bucket_bits;
+    uint8_t pad;
+    uint64_t src_size;          /**< size of the text list, 0 if none */
+    uint64_t src_mtime;         /**< mtime of the text list, 0 if none */
+    uint64_t src_mtime_nsec;    /**< nsec part of the mtime, 0 if none */
+    uint64_t src_ino;           /**< inode of the text list, 0 if none */
+} FileHashListHdr;
+
+/** \internal
+ *  \brief nsec part of the mtime, a list rewritten within the same second
+ *         keeps its mtime otherwise */
+static inline uint64_t FileHashListMtimeNsec(const struct stat *st)
+{
+#if defined(__APPLE__)
+    return (uint64_t)st->st_mtimespec.tv_nsec;
+#elif defined(OS_WIN32)
+    return 0;
+#else
+    return (uint64_t)st->st_mtim.tv_nsec;
+#endif
+}
+
+/** \internal
+ *  \brief set the text list info in a header */
+static void FileHashListHdrSetSrc(FileHashListHdr *hdr, const struct stat *src)
+{
+    hdr->src_size = (uint64_t)src->st_size;
+    hdr->src_mtime = (uint64_t)src->st_mtime;
+    hdr->src_mtime_nsec = FileHashListMtimeNsec(src);
+    hdr->src_ino = (uint64_t)src->st_ino;
+}
+
+/** \internal
+ *  \brief check if a binary list was written for this text list
+ *
+ *  Size and mtime alone miss a list that is replaced by one of the same
+ *  size within the same second, e.g. by a script, so the nsec part of the
+ *  mtime and the inode have to match as well.
+ */
+static int FileHashListHdrMatchesSrc(const FileHashListHdr *hdr,
+        const struct stat *src)
+{
+    FileHashListHdr cur;
+
+    memset(&cur, 0x00, sizeof(cur));
+    FileHashListHdrSetSrc(&cur, src);
+    return (hdr->src_size == cur.src_size && hdr->src_mtime == cur.src_mtime &&
+            hdr->src_mtime_nsec == cur.src_mtime_nsec &&
+            hdr->src_ino == cur.src_ino);
+}
+
+static inline uint32_t FileHashListBucket(const uint8_t *hash, uint8_t bits)
+{
+    uint32_t prefix = ((uint32_t)hash[0] << 16) | ((uint32_t)hash[1] << 8) |
+                      (uint32_t)hash[2];
+    return prefix >> (24 - bits);
+}
+
+static inline size_t FileHashListBucketsSize(uint8_t bits)
+{
+    return (((size_t)1 << bits) + 1) * sizeof(uint32_t);
+}
+
+static inline int FileHashListHexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ *  \brief parse the first hash_len * 2 chars of str as a hex hash
+ *
+ *  \param hash output buffer of hash_len bytes
+ *  \param hash_len length of the hash in bytes
+ *  \param str string to parse
+ *
+ *  \retval 0 ok
+ *  \retval -1 string too short or not hex
+ */
+int FileHashListParseHex(uint8_t *hash, uint16_t hash_len, const char *str)
+{
+    uint16_t i;
+
+    for (i = 0; i < hash_len; i++) {
+        int hi = FileHashListHexValue(str[i * 2]);
+        if (hi < 0)
+            return -1;
+        int lo = FileHashListHexValue(str[i * 2 + 1]);
+        if (lo < 0)
+            return -1;
+        hash[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief heap sort n hashes of len bytes in place
+ *
+ *  Used per bucket after the hashes were distributed over the buckets, so
+ *  n is small and no recursion or comparator context is needed.
+ */
+static void FileHashListSort(uint8_t *base, uint32_t n, uint16_t len)
+{
+    uint8_t tmp[FILE_HASHLIST_MAX_HASH_LEN];
+    uint32_t start, end;
+
+    if (n < 2)
+        return;
+
+#define HASH(i) (base + (size_t)(i) * len)
+#define SWAP(a, b) do {                 \
+        memcpy(tmp, HASH(a), len);      \
+        memcpy(HASH(a), HASH(b), len);  \
+        memcpy(HASH(b), tmp, len);      \
+    } while (0)
+
+    for (start = n / 2; start-- > 0; ) {
+        uint32_t root = start;
+        uint32_t child;
+        while ((child = root * 2 + 1) < n) {
+            if (child + 1 < n && memcmp(HASH(child), HASH(child + 1), len) < 0)
+                child++;
+            if (memcmp(HASH(root), HASH(child), len) >= 0)
+                break;
+            SWAP(root, child);
+            root = child;
+        }
+    }
+
+    for (end = n - 1; end > 0; end--) {
+        uint32_t root = 0;
+        uint32_t child;
+
+        SWAP(0, end);
+        while ((child = root * 2 + 1) < end) {
+            if (child + 1 < end && memcmp(HASH(child), HASH(child + 1), len) < 0)
+                child++;
+            if (memcmp(HASH(root), HASH(child), len) >= 0)
+                break;
+            SWAP(root, child);
+            root = child;
+        }
+    }
+#undef SWAP
+#undef HASH
+}
+
+/**
+ *  \brief build a list from an unsorted array of hashes
+ *
+ *  Duplicates are removed.
+ *
+ *  \param hashes array of count * hash_len bytes, always freed
+ *  \param count number of hashes in the array
+ *  \param hash_len length of a hash in bytes
+ *
+ *  \retval l the list or NULL on error
+ */
+FileHashList *FileHashListBuild(uint8_t *hashes, uint32_t count, uint16_t hash_len)
+{
+    FileHashList *l = NULL;
+    uint32_t *cnt = NULL;
+    uint32_t b, i;
+
+    if (hash_len < 3 || hash_len > FILE_HASHLIST_MAX_HASH_LEN)
+        goto error;
+
+    l = SCMalloc(sizeof(FileHashList));
+    if (unlikely(l == NULL))
+        goto error;
+    memset(l, 0x00, sizeof(FileHashList));
+    l->hash_len = hash_len;
+    l->bucket_bits = FILE_HASHLIST_BUCKET_BITS;
+
+    uint32_t nbuckets = 1U << l->bucket_bits;
+    size_t buckets_size = FileHashListBucketsSize(l->bucket_bits);
+
+    l->mem = SCMalloc(buckets_size + (size_t)count * hash_len);
+    if (unlikely(l->mem == NULL))
+        goto error;
+    uint32_t *buckets = (uint32_t *)l->mem;
+    uint8_t *sorted = l->mem + buckets_size;
+
+    cnt = SCMalloc(nbuckets * sizeof(uint32_t));
+    if (unlikely(cnt == NULL))
+        goto error;
+    memset(cnt, 0x00, nbuckets * sizeof(uint32_t));
+
+    /* distribute the hashes over the buckets */
+    for (i = 0; i < count; i++) {
+        cnt[FileHashListBucket(hashes + (size_t)i * hash_len, l->bucket_bits)]++;
+    }
+    uint32_t offset = 0;
+    for (b = 0; b < nbuckets; b++) {
+        uint32_t c = cnt[b];
+        cnt[b] = offset;
+        offset += c;
+    }
+    for (i = 0; i < count; i++) {
+        uint8_t *h = hashes + (size_t)i * hash_len;
+        b = FileHashListBucket(h, l->bucket_bits);
+        memcpy(sorted + (size_t)cnt[b]++ * hash_len, h, hash_len);
+    }
+    SCFree(hashes);
+    hashes = NULL;
+
+    /* sort each bucket and compact out the duplicates, cnt[b] is
+     * now the end of bucket b */
+    uint32_t in = 0, out = 0;
+    for (b = 0; b < nbuckets; b++) {
+        uint32_t bucket_end = cnt[b];
+
+        buckets[b] = out;
+        FileHashListSort(sorted + (size_t)in * hash_len, bucket_end - in, hash_len);
+        for ( ; in < bucket_end; in++) {
+            uint8_t *h = sorted + (size_t)in * hash_len;
+            if (out > buckets[b] &&
+                memcmp(sorted + (size_t)(out - 1) * hash_len, h, hash_len) == 0)
+                continue;
+            if (out != in)
+                memcpy(sorted + (size_t)out * hash_len, h, hash_len);
+            out++;
+        }
+    }
+    buckets[nbuckets] = out;
+    SCFree(cnt);
+
+    l->count = out;
+    l->buckets = buckets;
+    l->hashes = sorted;
+    return l;
+
+error:
+    if (hashes != NULL)
+        SCFree(hashes);
+    if (cnt != NULL)
+        SCFree(cnt);
+    FileHashListFree(l);
+    return NULL;
+}
+
+/**
+ *  \brief load a text list: one hex hash per line
+ *
+ *  Empty lines and lines starting with a '#' or whitespace are skipped.
+ *  Anything following the hash on a line, like the file name in md5sum
+ *  output, is ignored.
+ *
+ *  \retval l the list or NULL on error
+ */
+FileHashList *FileHashListLoadText(const char *filename, uint16_t hash_len)
+{
+    FILE *fp = NULL;
+    uint8_t *hashes = NULL;
+    uint32_t count = 0;
+    uint32_t size = 0;
+    char line[8192] = "";
+    int line_no = 0;
+
+    if (hash_len > FILE_HASHLIST_MAX_HASH_LEN)
+        return NULL;
+
+    fp = fopen(filename, "r");
+    if (fp == NULL) {
+        SCLogError(SC_ERR_OPENING_RULE_FILE, "opening hash file %s: %s",
+                filename, strerror(errno));
+        return NULL;
+    }
+
+    while (fgets(line, (int)sizeof(line), fp) != NULL) {
+        line_no++;
+
+        /* ignore comments and empty lines */
+        if (line[0] == '\n' || line [0] == '\r' || line[0] == ' ' ||
+            line[0] == '#' || line[0] == '\t' || line[0] == '\0')
+            continue;
+
+        if (count == size) {
+            uint32_t new_size = size ? size * 2 : 4096;
+            if (new_size < size) {
+                SCLogError(SC_ERR_INVALID_HASH, "%s: too many hashes", filename);
+                goto error;
+            }
+            uint8_t *ptr = SCRealloc(hashes, (size_t)new_size * hash_len);
+            if (unlikely(ptr == NULL))
+                goto error;
+            hashes = ptr;
+            size = new_size;
+        }
+
+        uint8_t *h = hashes + (size_t)count * hash_len;
+        size_t len = strlen(line);
+        if (len < (size_t)hash_len * 2 ||
+            FileHashListParseHex(h, hash_len, line) != 0 ||
+            (len > (size_t)hash_len * 2 && !isspace((unsigned char)line[hash_len * 2])))
+        {
+            SCLogError(SC_ERR_INVALID_HASH, "%s:%d not a valid %u byte hash",
+                    filename, line_no, hash_len);
+            goto error;
+        }
+        count++;
+    }
+    fclose(fp);
+    fp = NULL;
+
+    if (hashes == NULL) {
+        /* empty list, still allocate for the build */
+        hashes = SCMalloc(hash_len);
+        if (unlikely(hashes == NULL))
+            return NULL;
+    }
+    return FileHashListBuild(hashes, count, hash_len);
+
+error:
+    if (fp != NULL)
+        fclose(fp);
+    if (hashes != NULL)
+        SCFree(hashes);
+    return NULL;
+}
+
+/** \internal
+ *  \brief mmap and validate a binary list
+ *
+ *  \param src if not NULL the text list the binary list has to match
+ */
+static FileHashList *FileHashListMap(const char *filename, uint16_t hash_len,
+        const struct stat *src, int quiet)
+{
+    FileHashList *l = NULL;
+    void *map = MAP_FAILED;
+    struct stat st;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        if (!quiet)
+            SCLogError(SC_ERR_OPENING_RULE_FILE, "opening hash file %s: %s",
+                    filename, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FileHashListHdr))
+        goto invalid;
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        SCLogError(SC_ERR_MEM_ALLOC, "mmap of hash file %s failed: %s",
+                filename, strerror(errno));
+        goto error;
+    }
+
+    const FileHashListHdr *hdr = (const FileHashListHdr *)map;
+    if (memcmp(hdr->magic, FILE_HASHLIST_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != FILE_HASHLIST_VERSION ||
+        hdr->byte_order != FILE_HASHLIST_BYTE_ORDER ||
+        hdr->hash_len != hash_len ||
+        hdr->bucket_bits == 0 || hdr->bucket_bits > 24)
+        goto invalid;
+
+    if (src != NULL && !FileHashListHdrMatchesSrc(hdr, src))
+        goto invalid;
+
+    size_t buckets_size = FileHashListBucketsSize(hdr->bucket_bits);
+    if ((size_t)st.st_size != sizeof(FileHashListHdr) + buckets_size +
+            (size_t)hdr->count * hdr->hash_len)
+        goto invalid;
+
+    /* the bucket index has to be consistent or lookups could read
+     * outside of the map */
+    const uint32_t *buckets = (const uint32_t *)((uint8_t *)map + sizeof(FileHashListHdr));
+    uint32_t nbuckets = 1U << hdr->bucket_bits;
+    uint32_t b;
+    if (buckets[0] != 0 || buckets[nbuckets] != hdr->count)
+        goto invalid;
+    for (b = 0; b < nbuckets; b++) {
+        if (buckets[b] > buckets[b + 1])
+            goto invalid;
+    }
+
+    l = SCMalloc(sizeof(FileHashList));
+    if (unlikely(l == NULL))
+        goto error;
+    memset(l, 0x00, sizeof(FileHashList));
+    l->hash_len = hdr->hash_len;
+    l->bucket_bits = hdr->bucket_bits;
+    l->count = hdr->count;
+    l->buckets = buckets;
+    l->hashes = (const uint8_t *)buckets + buckets_size;
+    l->map = map;
+    l->map_len = (size_t)st.st_size;
+#ifdef MADV_RANDOM
+    (void)madvise(map, l->map_len, MADV_RANDOM);
+#endif
+    close(fd);
+    return l;
+
+invalid:
+    if (!quiet)
+        SCLogError(SC_ERR_INVALID_HASH, "hash file %s is not a valid %u byte "
+                "binary hash list", filename, hash_len);
+error:
+    if (map != MAP_FAILED)
+        munmap(map, (size_t)st.st_size);
+    close(fd);
+    return NULL;
+}
+
+/**
+ *  \brief load a binary list, the list is used in place through mmap
+ *
+ *  \retval l the list or NULL on error
+ */
+FileHashList *FileHashListLoadBinary(const char *filename, uint16_t hash_len)
+{
+    return FileHashListMap(filename, hash_len, NULL, 0);
+}
+
+/** \internal
+ *  \brief write the list, the list is written to a temp file first and
+ *         then renamed so that readers never see a partial list
+ */
+static int FileHashListWriteFile(const FileHashList *l, const char *filename,
+        const struct stat *src)
+{
+    char tmpname[PATH_MAX];
+    FileHashListHdr hdr;
+    FILE *fp;
+
+    snprintf(tmpname, sizeof(tmpname), "%s.tmp.%d", filename, (int)getpid());
+
+    memset(&hdr, 0x00, sizeof(hdr));
+    memcpy(hdr.magic, FILE_HASHLIST_MAGIC, sizeof(hdr.magic));
+    hdr.version = FILE_HASHLIST_VERSION;
+    hdr.byte_order = FILE_HASHLIST_BYTE_ORDER;
+    hdr.count = l->count;
+    hdr.hash_len = l->hash_len;
+    hdr.bucket_bits = l->bucket_bits;
+    if (src != NULL)
+        FileHashListHdrSetSrc(&hdr, src);
+
+    fp = fopen(tmpname, "wb");
+    if (fp == NULL) {
+        SCLogDebug("opening %s failed: %s", tmpname, strerror(errno));
+        return -1;
+    }
+
+    size_t hashes_size = (size_t)l->count * l->hash_len;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        fwrite(l->buckets, FileHashListBucketsSize(l->bucket_bits), 1, fp) != 1 ||
+        (hashes_size > 0 && fwrite(l->hashes, hashes_size, 1, fp) != 1))
+    {
+        SCLogDebug("writing %s failed: %s", tmpname, strerror(errno));
+        fclose(fp);
+        unlink(tmpname);
+        return -1;
+    }
+    if (fclose(fp) != 0 || rename(tmpname, filename) != 0) {
+        SCLogDebug("storing %s failed: %s", filename, strerror(errno));
+        unlink(tmpname);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  \brief write the list in the binary format
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int FileHashListWrite(const FileHashList *l, const char *filename)
+{
+    return FileHashListWriteFile(l, filename, NULL);
+}
+
+/**
+ *  \brief load a hash list
+ *
+ *  A binary list is used as is. For a text list a binary copy next to it
+ *  is used if it matches the text list. Otherwise the text list is parsed
+ *  and, if it is large, the binary copy is (re)written for the next load.
+ *
+ *  \param filename binary or text list
+ *  \param hash_len length of the hashes in bytes
+ *
+ *  \retval l the list or NULL on error
+ */
+FileHashList *FileHashListLoad(const char *filename, uint16_t hash_len)
+{
+    char binname[PATH_MAX];
+    char magic[8];
+    struct stat st;
+    FileHashList *l;
+
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        SCLogError(SC_ERR_OPENING_RULE_FILE, "opening hash file %s: %s",
+                filename, strerror(errno));
+        return NULL;
+    }
+    size_t r = fread(magic, 1, sizeof(magic), fp);
+    int fstat_r = fstat(fileno(fp), &st);
+    fclose(fp);
+    if (fstat_r != 0)
+        return NULL;
+
+    if (r == sizeof(magic) && memcmp(magic, FILE_HASHLIST_MAGIC, sizeof(magic)) == 0)
+        return FileHashListLoadBinary(filename, hash_len);
+
+    snprintf(binname, sizeof(binname), "%s%s", filename, FILE_HASHLIST_SUFFIX);
+    l = FileHashListMap(binname, hash_len, &st, 1);
+    if (l != NULL) {
+        SCLogDebug("using binary hash list %s", binname);
+        return l;
+    }
+
+    l = FileHashListLoadText(filename, hash_len);
+    if (l != NULL && l->count >= FILE_HASHLIST_CACHE_MIN) {
+        if (FileHashListWriteFile(l, binname, &st) == 0) {
+            SCLogInfo("stored binary hash list %s", binname);
+        } else {
+            SCLogInfo("couldn't store binary hash list %s, list will be "
+                    "parsed again on the next load", binname);
+        }
+    }
+    return l;
+}
+
+void FileHashListFree(FileHashList *l)
+{
+    if (l == NULL)
+        return;
+
+    if (l->map != NULL)
+        munmap(l->map, l->map_len);
+    if (l->mem != NULL)
+        SCFree(l->mem);
+    SCFree(l);
+}
+
+/** \brief heap memory used by the list, a mmap'd list uses none */
+uint64_t FileHashListMemorySize(const FileHashList *l)
+{
+    if (l->mem == NULL)
+        return 0;
+    return (uint64_t)FileHashListBucketsSize(l->bucket_bits) +
+           (uint64_t)l->count * l->hash_len;
+}
+
+/**
+ *  \brief look up a hash
+ *
+ *  \param hash hash of l->hash_len bytes
+ *
+ *  \retval 1 hash is in the list
+ *  \retval 0 hash is not in the list
+ */
+int FileHashListLookup(const FileHashList *l, const uint8_t *hash)
+{
+    uint32_t b = FileHashListBucket(hash, l->bucket_bits);
+    uint32_t lo = l->buckets[b];
+    uint32_t hi = l->buckets[b + 1];
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int r = memcmp(l->hashes + (size_t)mid * l->hash_len, hash, l->hash_len);
+        if (r == 0)
+            return 1;
+        if (r < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return 0;
+}
+
+#ifdef UNITTESTS
+
+static int FileHashListLookupString(FileHashList *l, const char *str)
+{
+    uint8_t hash[FILE_HASHLIST_MAX_HASH_LEN];
+    if (FileHashListParseHex(hash, l->hash_len, str) != 0)
+        return -1;
+    return FileHashListLookup(l, hash);
+}
+
+static FileHashList *FileHashListBuildStrings(const char **strs, uint32_t n,
+        uint16_t hash_len)
+{
+    uint8_t *hashes = SCMalloc((size_t)n * hash_len);
+    uint32_t i;
+
+    if (hashes == NULL)
+        return NULL;
+    for (i = 0; i < n; i++) {
+        if (FileHashListParseHex(hashes + i * hash_len, hash_len, strs[i]) != 0) {
+            SCFree(hashes);
+            return NULL;
+        }
+    }
+    return FileHashListBuild(hashes, n, hash_len);
+}
+
+static const char *file_hashlist_test_md5[] = {
+    "d80f93a93dc5f3ee945704754d6e0a36",
+    "92a49985b384f0d993a36e4c2d45e206",
+    "11adeaacc8c309815f7bc3e33888f281",
+    "22e10a8fe02344ade0bea8836a1714af",
+    "c3db2cbf02c68f073afcaee5634677bc",
+    "7ed095da259638f42402fb9e74287a17",
+    "92a49985b384f0d993a36e4c2d45e206", /* dup */
+    "92a49985b384f0d993a36e4c2d45e200", /* same bucket */
+    "00000000000000000000000000000000",
+    "ffffffffffffffffffffffffffffffff",
+};
+
+/** \test build, dedup and lookup */
+static int FileHashListTest01(void)
+{
+    int result = 0;
+    uint32_t i;
+    FileHashList *l = FileHashListBuildStrings(file_hashlist_test_md5,
+            sizeof(file_hashlist_test_md5) / sizeof(file_hashlist_test_md5[0]), 16);
+    if (l == NULL)
+        return 0;
+
+    if (l->count != 9) {
+        printf("count %u, expected 9: ", l->count);
+        goto end;
+    }
+    for (i = 0; i < sizeof(file_hashlist_test_md5) / sizeof(file_hashlist_test_md5[0]); i++) {
+        if (FileHashListLookupString(l, file_hashlist_test_md5[i]) != 1) {
+            printf("%s not found: ", file_hashlist_test_md5[i]);
+            goto end;
+        }
+    }
+    for (i = 1; i < l->count; i++) {
+        if (memcmp(l->hashes + (i - 1) * 16, l->hashes + i * 16, 16) >= 0) {
+            printf("list not sorted at %u: ", i);
+            goto end;
+        }
+    }
+    if (FileHashListLookupString(l, "33333333333333333333333333333333") != 0 ||
+        FileHashListLookupString(l, "92a49985b384f0d993a36e4c2d45e201") != 0 ||
+        FileHashListLookupString(l, "fffffffffffffffffffffffffffffffe") != 0) {
+        printf("unexpected match: ");
+        goto end;
+    }
+    result = 1;
+end:
+    FileHashListFree(l);
+    return result;
+}
+
+/** \test write a binary list and use it through mmap */
+static int FileHashListTest02(void)
+{
+    int result = 0;
+    char filename[] = "/tmp/suricata-fhl-test-XXXXXX";
+    FileHashList *l = NULL, *m = NULL;
+    uint32_t i;
+
+    int fd = mkstemp(filename);
+    if (fd < 0)
+        return 0;
+    close(fd);
+
+    l = FileHashListBuildStrings(file_hashlist_test_md5,
+            sizeof(file_hashlist_test_md5) / sizeof(file_hashlist_test_md5[0]), 16);
+    if (l == NULL)
+        goto end;
+    if (FileHashListWrite(l, filename) != 0) {
+        printf("write failed: ");
+        goto end;
+    }
+
+    /* hash length has to match */
+    m = FileHashListLoadBinary(filename, 32);
+    if (m != NULL) {
+        printf("loaded md5 list as sha256 list: ");
+        goto end;
+    }
+
+    m = FileHashListLoad(filename, 16);
+    if (m == NULL || m->map == NULL || m->count != l->count ||
+        FileHashListMemorySize(m) != 0) {
+        printf("load failed: ");
+        goto end;
+    }
+    for (i = 0; i < sizeof(file_hashlist_test_md5) / sizeof(file_hashlist_test_md5[0]); i++) {
+        if (FileHashListLookupString(m, file_hashlist_test_md5[i]) != 1) {
+            printf("%s not found: ", file_hashlist_test_md5[i]);
+            goto end;
+        }
+    }
+    if (FileHashListLookupString(m, "33333333333333333333333333333333") != 0)
+        goto end;
+
+    result = 1;
+end:
+    FileHashListFree(l);
+    FileHashListFree(m);
+    unlink(filename);
+    return result;
+}
+
+/** \test text list parsing */
+static int FileHashListTest03(void)
+{
+    int result = 0;
+    char filename[] = "/tmp/suricata-fhl-test-XXXXXX";
+    FileHashList *l = NULL;
+
+    int fd = mkstemp(filename);
+    if (fd < 0)
+        return 0;
+    FILE *fp = fdopen(fd, "w");
+    if (fp == NULL) {
+        close(fd);
+        goto end;
+    }
+    fprintf(fp, "# comment\n\n"
+            "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\n"
+            "60303AE22B998861BCE3B28F33EEC1BE758A213C86C93C076DBE9F558C11C752  file.exe\n"
+            "\t# indented comment\n");
+    fclose(fp);
+
+    l = FileHashListLoad(filename, 32);
+    if (l == NULL || l->count != 2) {
+        printf("load failed: ");
+        goto end;
+    }
+    if (FileHashListLookupString(l,
+            "60303ae22b998861bce3b28f33eec1be758a213c86c93c076dbe9f558c11c752") != 1 ||
+        FileHashListLookupString(l,
+            "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08") != 1) {
+        printf("hash not found: ");
+        goto end;
+    }
+    FileHashListFree(l);
+
+    /* md5 in a sha256 list */
+    fp = fopen(filename, "a");
+    if (fp == NULL)
+        goto end;
+    fprintf(fp, "d80f93a93dc5f3ee945704754d6e0a36\n");
+    fclose(fp);
+
+    l = FileHashListLoad(filename, 32);
+    if (l != NULL) {
+        printf("invalid list loaded: ");
+        goto end;
+    }
+    result = 1;
+end:
+    FileHashListFree(l);
+    unlink(filename);
+    return result;
+}
+
+/** \test a binary copy is only used for the text list it was written for */
+static int FileHashListTest04(void)
+{
+    int result = 0;
+    char filename[] = "/tmp/suricata-fhl-test-XXXXXX";
+    FileHashList *l = NULL, *m = NULL;
+    struct stat st;
+
+    int fd = mkstemp(filename);
+    if (fd < 0)
+        return 0;
+    close(fd);
+
+    memset(&st, 0x00, sizeof(st));
+    st.st_size = 1000;
+    st.st_mtime = 1400000000;
+    st.st_ino = 1234;
+
+    l = FileHashListBuildStrings(file_hashlist_test_md5,
+            sizeof(file_hashlist_test_md5) / sizeof(file_hashlist_test_md5[0]), 16);
+    if (l == NULL)
+        goto end;
+    if (FileHashListWriteFile(l, filename, &st) != 0) {
+        printf("write failed: ");
+        goto end;
+    }
+
+    m = FileHashListMap(filename, 16, &st, 1);
+    if (m == NULL) {
+        printf("map failed: ");
+        goto end;
+    }
+    FileHashListFree(m);
+
+    /* same size and mtime, but a different file */
+    st.st_ino = 1235;
+    m = FileHashListMap(filename, 16, &st, 1);
+    if (m != NULL) {
+        printf("binary list used for another inode: ");
+        goto end;
+    }
+    st.st_ino = 1234;
+
+#if !defined(__APPLE__) && !defined(OS_WIN32)
+    /* rewritten within the same second */
+    st.st_mtim.tv_nsec = 1;
+    m = FileHashListMap(filename, 16, &st, 1);
+    if (m != NULL) {
+        printf("binary list used for another mtime: ");
+        goto end;
+    }
+#endif
+
+    result = 1;
+end:
+    FileHashListFree(l);
+    FileHashListFree(m);
+    unlink(filename);
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void FileHashListRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("FileHashListTest01", FileHashListTest01, 1);
+    UtRegisterTest("FileHashListTest02", FileHashListTest02, 1);
+    UtRegisterTest("FileHashListTest03", FileHashListTest03, 1);
+    UtRegisterTest("FileHashListTest04", FileHashListTest04, 1);
+#endif /* UNITTESTS */
+}
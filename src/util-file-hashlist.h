@@ -0,0 +1,54 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __UTIL_FILE_HASHLIST_H__
+#define __UTIL_FILE_HASHLIST_H__
+
+#define FILE_HASHLIST_MAGIC         "SCFHLST"
+#define FILE_HASHLIST_VERSION       2
+/** suffix of the binary list stored next to a text list */
+#define FILE_HASHLIST_SUFFIX        ".fhl"
+/** bits of the hash used to select the bucket */
+#define FILE_HASHLIST_BUCKET_BITS   16
+
+/** read only, sorted list of file hashes (md5, sha1 or sha256) */
+typedef struct FileHashList_ {
+    uint16_t hash_len;
+    uint8_t bucket_bits;
+    uint32_t count;             /**< number of hashes */
+    const uint32_t *buckets;    /**< (1 << bucket_bits) + 1 start indexes */
+    const uint8_t *hashes;      /**< count * hash_len bytes, sorted */
+
+    void *map;                  /**< mmap of a binary list or NULL */
+    size_t map_len;
+    uint8_t *mem;               /**< heap memory if built from a text list */
+} FileHashList;
+
+FileHashList *FileHashListLoad(const char *, uint16_t);
+FileHashList *FileHashListLoadText(const char *, uint16_t);
+FileHashList *FileHashListLoadBinary(const char *, uint16_t);
+FileHashList *FileHashListBuild(uint8_t *, uint32_t, uint16_t);
+int FileHashListWrite(const FileHashList *, const char *);
+void FileHashListFree(FileHashList *);
+uint64_t FileHashListMemorySize(const FileHashList *);
+
+int FileHashListParseHex(uint8_t *, uint16_t, const char *);
+int FileHashListLookup(const FileHashList *, const uint8_t *);
+
+void FileHashListRegisterTests(void);
+
+#endif /* __UTIL_FILE_HASHLIST_H__ */
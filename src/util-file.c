@@ -45,6 +45,16 @@ static int g_file_force_magic = 0;
  */
 static int g_file_force_md5 = 0;
 
+/** \brief switch to force sha1 calculation on all files
+ *         regardless of the rules.
+ */
+static int g_file_force_sha1 = 0;
+
+/** \brief switch to force sha256 calculation on all files
+ *         regardless of the rules.
+ */
+static int g_file_force_sha256 = 0;
+
 /** \brief switch to force tracking off all files
  *         regardless of the rules.
  */
@@ -62,6 +72,22 @@ void FileForceMd5Enable(void) {
     g_file_force_md5 = 1;
 }
 
+void FileForceSha1Enable(void) {
+    g_file_force_sha1 = 1;
+}
+
+int FileForceSha1(void) {
+    return g_file_force_sha1;
+}
+
+void FileForceSha256Enable(void) {
+    g_file_force_sha256 = 1;
+}
+
+int FileForceSha256(void) {
+    return g_file_force_sha256;
+}
+
 int FileForceMagic(void) {
     return g_file_force_magic;
 }
@@ -79,6 +105,31 @@ int FileMagicSize(void) {
     return 512;
 }
 
+#ifdef HAVE_NSS
+/**
+ *  \brief Feed data to the hash contexts this file has.
+ *
+ *  \retval 1 if the file is being hashed, 0 if not
+ */
+static int FileHashUpdate(File *ff, uint8_t *data, uint32_t data_len) {
+    int r = 0;
+
+    if (ff->md5_ctx) {
+        HASH_Update(ff->md5_ctx, data, data_len);
+        r = 1;
+    }
+    if (ff->sha1_ctx) {
+        HASH_Update(ff->sha1_ctx, data, data_len);
+        r = 1;
+    }
+    if (ff->sha256_ctx) {
+        HASH_Update(ff->sha256_ctx, data, data_len);
+        r = 1;
+    }
+    return r;
+}
+#endif
+
 static int FileAppendFileDataFilePtr(File *ff, FileData *ffd) {
     SCEnter();
 
@@ -101,8 +152,7 @@ static int FileAppendFileDataFilePtr(File *ff, FileData *ffd) {
 #endif
 
 #ifdef HAVE_NSS
-    if (ff->md5_ctx)
-        HASH_Update(ff->md5_ctx, ffd->data, ffd->len);
+    (void)FileHashUpdate(ff, ffd->data, ffd->len);
 #endif
     SCReturnInt(0);
 }
@@ -328,6 +378,10 @@ static void FileFree(File *ff) {
 #ifdef HAVE_NSS
     if (ff->md5_ctx)
         HASH_Destroy(ff->md5_ctx);
+    if (ff->sha1_ctx)
+        HASH_Destroy(ff->sha1_ctx);
+    if (ff->sha256_ctx)
+        HASH_Destroy(ff->sha256_ctx);
 #endif
     SCLogDebug("ff chunks_cnt %"PRIu64", chunks_cnt_max %"PRIu64,
             ff->chunks_cnt, ff->chunks_cnt_max);
@@ -423,11 +477,8 @@ int FileAppendData(FileContainer *ffc, uint8_t *data, uint32_t data_len) {
 
     if (FileStoreNoStoreCheck(ffc->tail) == 1) {
 #ifdef HAVE_NSS
-        /* no storage but forced md5 */
-        if (ffc->tail->md5_ctx) {
-            if (ffc->tail->md5_ctx)
-                HASH_Update(ffc->tail->md5_ctx, data, data_len);
-
+        /* no storage but forced md5, sha1 or sha256 */
+        if (FileHashUpdate(ffc->tail, data, data_len) == 1) {
             SCReturnInt(0);
         }
 #endif
@@ -471,7 +522,7 @@ int FileAppendData(FileContainer *ffc, uint8_t *data, uint32_t data_len) {
  *  \note filename is not a string, so it's not nul terminated.
  */
 File *FileOpenFile(FileContainer *ffc, uint8_t *name,
-        uint16_t name_len, uint8_t *data, uint32_t data_len, uint8_t flags)
+        uint16_t name_len, uint8_t *data, uint32_t data_len, uint16_t flags)
 {
     SCEnter();
 
@@ -496,6 +547,14 @@ File *FileOpenFile(FileContainer *ffc, uint8_t *name,
         SCLogDebug("not doing md5 for this file");
         ff->flags |= FILE_NOMD5;
     }
+    if (flags & FILE_NOSHA1) {
+        SCLogDebug("not doing sha1 for this file");
+        ff->flags |= FILE_NOSHA1;
+    }
+    if (flags & FILE_NOSHA256) {
+        SCLogDebug("not doing sha256 for this file");
+        ff->flags |= FILE_NOSHA256;
+    }
 
 #ifdef HAVE_NSS
     if (!(ff->flags & FILE_NOMD5) || g_file_force_md5) {
@@ -504,6 +563,18 @@ File *FileOpenFile(FileContainer *ffc, uint8_t *name,
             HASH_Begin(ff->md5_ctx);
         }
     }
+    if (!(ff->flags & FILE_NOSHA1) || g_file_force_sha1) {
+        ff->sha1_ctx = HASH_Create(HASH_AlgSHA1);
+        if (ff->sha1_ctx != NULL) {
+            HASH_Begin(ff->sha1_ctx);
+        }
+    }
+    if (!(ff->flags & FILE_NOSHA256) || g_file_force_sha256) {
+        ff->sha256_ctx = HASH_Create(HASH_AlgSHA256);
+        if (ff->sha256_ctx != NULL) {
+            HASH_Begin(ff->sha256_ctx);
+        }
+    }
 #endif
 
     ff->state = FILE_STATE_OPENED;
@@ -554,9 +625,8 @@ static int FileCloseFilePtr(File *ff, uint8_t *data,
 
         if (ff->flags & FILE_NOSTORE) {
 #ifdef HAVE_NSS
-            /* no storage but md5 */
-            if (ff->md5_ctx)
-                HASH_Update(ff->md5_ctx, data, data_len);
+            /* no storage but md5, sha1 or sha256 */
+            (void)FileHashUpdate(ff, data, data_len);
 #endif
         } else {
             FileData *ffd = FileDataAlloc(data, data_len);
@@ -592,6 +662,16 @@ static int FileCloseFilePtr(File *ff, uint8_t *data,
             HASH_End(ff->md5_ctx, ff->md5, &len, sizeof(ff->md5));
             ff->flags |= FILE_MD5;
         }
+        if (ff->sha1_ctx) {
+            unsigned int len = 0;
+            HASH_End(ff->sha1_ctx, ff->sha1, &len, sizeof(ff->sha1));
+            ff->flags |= FILE_SHA1;
+        }
+        if (ff->sha256_ctx) {
+            unsigned int len = 0;
+            HASH_End(ff->sha256_ctx, ff->sha256, &len, sizeof(ff->sha256));
+            ff->flags |= FILE_SHA256;
+        }
 #endif
     }
 
@@ -724,6 +804,82 @@ void FileDisableMd5(Flow *f, uint8_t direction) {
     SCReturn;
 }
 
+/**
+ *  \brief disable file sha1 calc for this flow
+ *
+ *  \param f *LOCKED* flow
+ *  \param direction flow direction
+ */
+void FileDisableSha1(Flow *f, uint8_t direction) {
+    File *ptr = NULL;
+
+    SCEnter();
+
+    DEBUG_ASSERT_FLOW_LOCKED(f);
+
+    if (direction == STREAM_TOSERVER)
+        f->flags |= FLOW_FILE_NO_SHA1_TS;
+    else
+        f->flags |= FLOW_FILE_NO_SHA1_TC;
+
+    FileContainer *ffc = AppLayerGetFilesFromFlow(f, direction);
+    if (ffc != NULL) {
+        for (ptr = ffc->head; ptr != NULL; ptr = ptr->next) {
+            SCLogDebug("disabling sha1 for file %p from direction %s",
+                    ptr, direction == STREAM_TOSERVER ? "toserver":"toclient");
+            ptr->flags |= FILE_NOSHA1;
+
+#ifdef HAVE_NSS
+            /* destroy any ctx we may have so far */
+            if (ptr->sha1_ctx != NULL) {
+                HASH_Destroy(ptr->sha1_ctx);
+                ptr->sha1_ctx = NULL;
+            }
+#endif
+        }
+    }
+
+    SCReturn;
+}
+
+/**
+ *  \brief disable file sha256 calc for this flow
+ *
+ *  \param f *LOCKED* flow
+ *  \param direction flow direction
+ */
+void FileDisableSha256(Flow *f, uint8_t direction) {
+    File *ptr = NULL;
+
+    SCEnter();
+
+    DEBUG_ASSERT_FLOW_LOCKED(f);
+
+    if (direction == STREAM_TOSERVER)
+        f->flags |= FLOW_FILE_NO_SHA256_TS;
+    else
+        f->flags |= FLOW_FILE_NO_SHA256_TC;
+
+    FileContainer *ffc = AppLayerGetFilesFromFlow(f, direction);
+    if (ffc != NULL) {
+        for (ptr = ffc->head; ptr != NULL; ptr = ptr->next) {
+            SCLogDebug("disabling sha256 for file %p from direction %s",
+                    ptr, direction == STREAM_TOSERVER ? "toserver":"toclient");
+            ptr->flags |= FILE_NOSHA256;
+
+#ifdef HAVE_NSS
+            /* destroy any ctx we may have so far */
+            if (ptr->sha256_ctx != NULL) {
+                HASH_Destroy(ptr->sha256_ctx);
+                ptr->sha256_ctx = NULL;
+            }
+#endif
+        }
+    }
+
+    SCReturn;
+}
+
 /**
  *  \brief disable file size tracking for this flow
  *
@@ -38,6 +38,10 @@
 #define FILE_STORE      0x0040
 #define FILE_STORED     0x0080
 #define FILE_NOTRACK    0x0100 /**< track size of file */
+#define FILE_SHA256     0x0200
+#define FILE_NOSHA1     0x0400
+#define FILE_SHA1       0x0800
+#define FILE_NOSHA256   0x1000
 
 typedef enum FileState_ {
     FILE_STATE_NONE = 0,    /**< no state */
@@ -73,6 +77,10 @@ typedef struct File_ {
 #ifdef HAVE_NSS
     HASHContext *md5_ctx;
     uint8_t md5[MD5_LENGTH];
+    HASHContext *sha1_ctx;
+    uint8_t sha1[SHA1_LENGTH];
+    HASHContext *sha256_ctx;
+    uint8_t sha256[SHA256_LENGTH];
 #endif
 #ifdef DEBUG
     uint64_t chunks_cnt;
@@ -107,7 +115,7 @@ void FileContainerAdd(FileContainer *, File *);
  *  \note filename is not a string, so it's not nul terminated.
  */
 File *FileOpenFile(FileContainer *, uint8_t *name, uint16_t name_len,
-        uint8_t *data, uint32_t data_len, uint8_t flags);
+        uint8_t *data, uint32_t data_len, uint16_t flags);
 /**
  *  \brief Close a File
  *
@@ -178,6 +186,14 @@ void FileDisableMd5(Flow *f, uint8_t);
 void FileForceMd5Enable(void);
 int FileForceMd5(void);
 
+void FileDisableSha1(Flow *f, uint8_t);
+void FileForceSha1Enable(void);
+int FileForceSha1(void);
+
+void FileDisableSha256(Flow *f, uint8_t);
+void FileForceSha256Enable(void);
+int FileForceSha256(void);
+
 void FileForceTrackingEnable(void);
 
 void FileStoreAllFiles(FileContainer *);
@@ -0,0 +1,741 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Builtin file type identification for the common file types.
+ *
+ * The leading bytes of a file are matched against a trie that is compiled
+ * from the signature table at init. The trie is read only after that, so
+ * lookups need no locking. A signature can have a describe callback that
+ * checks the header further and builds a description like libmagic's.
+ *
+ * Only types whose full libmagic description can be built from the first
+ * bytes are in the table. Types that need a deeper look, like OLE2 or
+ * OpenDocument containers, or for which libmagic adds details like
+ * timestamps, image depth or linking info, are left to libmagic.
+ *
+ * The descriptions depend on the libmagic version and magic file in use,
+ * so the builtin answers are checked against the loaded libmagic first,
+ * see MagicBuiltinConfirm. A description is only returned on its own
+ * once libmagic returned the same string for it a number of times, and
+ * one that libmagic ever disagrees with is not used again.
+ */
+
+#include "suricata-common.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-magic-builtin.h"
+
+/** longest signature at offset 0 */
+#define MAGIC_BUILTIN_MAX_SIG_LEN   16
+
+/** describe callback results */
+#define MAGIC_BUILTIN_NOMATCH       0   /**< not this type, try shorter sigs */
+#define MAGIC_BUILTIN_DESCRIBED     1   /**< out is set */
+#define MAGIC_BUILTIN_DEFER         -1  /**< leave it to libmagic */
+
+/** descriptions a describe callback can build for a sig, each of them
+ *  is checked against libmagic on its own */
+#define MAGIC_BUILTIN_VARIANTS      8
+
+/** libmagic has to agree this many times before a description is trusted */
+#define MAGIC_BUILTIN_CONFIRM_CNT   32
+/** one in this many trusted answers is still checked against libmagic */
+#define MAGIC_BUILTIN_RECHECK_MASK  1023
+/** set in the state of a description libmagic disagreed with */
+#define MAGIC_BUILTIN_MISMATCH      0x80000000U
+
+typedef struct MagicBuiltinSig_ {
+    uint16_t offset;
+    uint8_t len;
+    const char *bytes;
+    const char *desc;
+    /** set out and the variant of the description, or return
+     *  MAGIC_BUILTIN_NOMATCH or MAGIC_BUILTIN_DEFER */
+    int (*Describe)(const uint8_t *, uint32_t, char *, size_t, int *);
+} MagicBuiltinSig;
+
+typedef struct MagicBuiltinEdge_ {
+    uint8_t byte;
+    uint16_t node;
+} MagicBuiltinEdge;
+
+typedef struct MagicBuiltinNode_ {
+    uint16_t edge_idx;          /**< first edge in the edge array */
+    uint16_t edge_cnt;
+    int16_t sig;                /**< sig ending at this node or -1 */
+} MagicBuiltinNode;
+
+typedef struct MagicBuiltinTrie_ {
+    uint16_t root[256];         /**< node for the first byte, 0 for none */
+    MagicBuiltinNode *nodes;
+    MagicBuiltinEdge *edges;
+    uint16_t node_cnt;
+} MagicBuiltinTrie;
+
+static MagicBuiltinTrie *g_magic_builtin = NULL;
+
+static inline uint16_t MagicLE16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static int MagicDescribePDF(const uint8_t *buf, uint32_t buflen, char *out, size_t outlen,
+        int *variant)
+{
+    if (buflen >= 8 && isdigit(buf[5]) && buf[6] == '.' && isdigit(buf[7])) {
+        snprintf(out, outlen, "PDF document, version %c.%c", buf[5], buf[7]);
+    } else {
+        strlcpy(out, "PDF document", outlen);
+        *variant = 1;
+    }
+    return MAGIC_BUILTIN_DESCRIBED;
+}
+
+/** \internal
+ *  \brief look for a string in the part of the buffer we have */
+static int MagicBufferHas(const uint8_t *buf, uint32_t buflen, const char *str)
+{
+    size_t len = strlen(str);
+    uint32_t i;
+
+    if (buflen < len)
+        return 0;
+    for (i = 0; i <= buflen - len; i++) {
+        if (buf[i] == (uint8_t)str[0] && memcmp(buf + i, str, len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static int MagicDescribeZip(const uint8_t *buf, uint32_t buflen, char *out, size_t outlen,
+        int *variant)
+{
+    if (buflen < 30)
+        return MAGIC_BUILTIN_DEFER;
+
+    uint16_t version = MagicLE16(buf + 4);
+    uint16_t name_len = MagicLE16(buf + 26);
+    const uint8_t *name = buf + 30;
+    if (name_len > buflen - 30)
+        return MAGIC_BUILTIN_DEFER;
+
+#define ZIP_NAME_IS(s) \
+    (name_len == sizeof(s) - 1 && memcmp(name, (s), sizeof(s) - 1) == 0)
+
+    /* OpenDocument and friends: libmagic reads the mimetype */
+    if (ZIP_NAME_IS("mimetype"))
+        return MAGIC_BUILTIN_DEFER;
+
+    if (ZIP_NAME_IS("[Content_Types].xml")) {
+        if (MagicBufferHas(buf, buflen, "word/")) {
+            strlcpy(out, "Microsoft Word 2007+", outlen);
+            *variant = 1;
+        } else if (MagicBufferHas(buf, buflen, "xl/")) {
+            strlcpy(out, "Microsoft Excel 2007+", outlen);
+            *variant = 2;
+        } else if (MagicBufferHas(buf, buflen, "ppt/")) {
+            strlcpy(out, "Microsoft PowerPoint 2007+", outlen);
+            *variant = 3;
+        } else {
+            return MAGIC_BUILTIN_DEFER;
+        }
+        return MAGIC_BUILTIN_DESCRIBED;
+    }
+
+    if (name_len >= 9 && memcmp(name, "META-INF/", 9) == 0) {
+        strlcpy(out, "Java archive data (JAR)", outlen);
+        *variant = 4;
+        return MAGIC_BUILTIN_DESCRIBED;
+    }
+#undef ZIP_NAME_IS
+
+    snprintf(out, outlen, "Zip archive data, at least v%u.%u to extract",
+            version / 10, version % 10);
+    return MAGIC_BUILTIN_DESCRIBED;
+}
+
+static int MagicDescribeGIF(const uint8_t *buf, uint32_t buflen, char *out, size_t outlen,
+        int *variant)
+{
+    if (buflen >= 10) {
+        snprintf(out, outlen, "GIF image data, version %c%c%c, %u x %u",
+                buf[3], buf[4], buf[5], MagicLE16(buf + 6), MagicLE16(buf + 8));
+    } else {
+        snprintf(out, outlen, "GIF image data, version %c%c%c",
+                buf[3], buf[4], buf[5]);
+        *variant = 1;
+    }
+    return MAGIC_BUILTIN_DESCRIBED;
+}
+
+static int MagicDescribeBzip2(const uint8_t *buf, uint32_t buflen, char *out, size_t outlen,
+        int *variant)
+{
+    if (buflen < 4 || buf[3] < '1' || buf[3] > '9')
+        return MAGIC_BUILTIN_NOMATCH;
+    snprintf(out, outlen, "bzip2 compressed data, block size = %c00k", buf[3]);
+    return MAGIC_BUILTIN_DESCRIBED;
+}
+
+static int MagicDescribe7z(const uint8_t *buf, uint32_t buflen, char *out, size_t outlen,
+        int *variant)
+{
+    if (buflen >= 8) {
+        snprintf(out, outlen, "7-zip archive data, version %u.%u", buf[6], buf[7]);
+    } else {
+        strlcpy(out, "7-zip archive data", outlen);
+        *variant = 1;
+    }
+    return MAGIC_BUILTIN_DESCRIBED;
+}
+
+static int MagicDescribeFlash(const uint8_t *buf, uint32_t buflen, char *out, size_t outlen,
+        int *variant)
+{
+    const char *type = "";
+    if (buf[0] == 'C')
+        type = " (compressed)";
+    else if (buf[0] == 'Z')
+        type = " (lzma compressed)";
+
+    if (buflen >= 4) {
+        snprintf(out, outlen, "Macromedia Flash data%s, version %u", type, buf[3]);
+    } else {
+        snprintf(out, outlen, "Macromedia Flash data%s", type);
+        *variant = 1;
+    }
+    return MAGIC_BUILTIN_DESCRIBED;
+}
+
+/** the builtin signatures. Descriptions follow libmagic's so rules
+ *  written against libmagic output keep matching. */
+static MagicBuiltinSig magic_builtin_sigs[] = {
+    /* documents */
+    { 0, 5, "%PDF-", NULL, MagicDescribePDF },
+    /* archives */
+    { 0, 4, "PK\x03\x04", NULL, MagicDescribeZip },
+    { 0, 3, "BZh", NULL, MagicDescribeBzip2 },
+    { 0, 6, "\xfd" "7zXZ\0", "XZ compressed data", NULL },
+    { 0, 6, "7z\xbc\xaf\x27\x1c", NULL, MagicDescribe7z },
+    { 0, 8, "Rar!\x1a\x07\x01\x00", "RAR archive data, v5", NULL },
+    { 257, 8, "ustar\0" "00", "POSIX tar archive", NULL },
+    { 257, 8, "ustar  \0", "POSIX tar archive (GNU)", NULL },
+    /* images */
+    { 0, 6, "GIF87a", NULL, MagicDescribeGIF },
+    { 0, 6, "GIF89a", NULL, MagicDescribeGIF },
+    /* flash */
+    { 0, 3, "FWS", NULL, MagicDescribeFlash },
+    { 0, 3, "CWS", NULL, MagicDescribeFlash },
+    { 0, 3, "ZWS", NULL, MagicDescribeFlash },
+};
+
+#define MAGIC_BUILTIN_SIG_CNT \
+    (int)(sizeof(magic_builtin_sigs) / sizeof(magic_builtin_sigs[0]))
+
+/** libmagic agreements per description (sig * MAGIC_BUILTIN_VARIANTS +
+ *  variant), with MAGIC_BUILTIN_MISMATCH set once libmagic disagreed */
+static uint32_t magic_builtin_state[MAGIC_BUILTIN_SIG_CNT * MAGIC_BUILTIN_VARIANTS];
+/** trusted answers per description, to pick the ones to recheck */
+static uint32_t magic_builtin_hits[MAGIC_BUILTIN_SIG_CNT * MAGIC_BUILTIN_VARIANTS];
+
+/**
+ *  \retval MAGIC_BUILTIN_DESCRIBED out and id are set
+ */
+static int MagicBuiltinDescribe(int sig, const uint8_t *buf, uint32_t buflen,
+        char *out, size_t outlen, int *id)
+{
+    const MagicBuiltinSig *s = &magic_builtin_sigs[sig];
+    int variant = 0;
+    int r = MAGIC_BUILTIN_DESCRIBED;
+
+    if (s->Describe != NULL)
+        r = s->Describe(buf, buflen, out, outlen, &variant);
+    else
+        strlcpy(out, s->desc, outlen);
+
+    BUG_ON(variant >= MAGIC_BUILTIN_VARIANTS);
+    *id = sig * MAGIC_BUILTIN_VARIANTS + variant;
+    return r;
+}
+
+/** \internal
+ *  \brief tell if a description can be returned without asking libmagic
+ *
+ *  \retval MAGIC_BUILTIN_TRUSTED libmagic agreed often enough
+ *  \retval MAGIC_BUILTIN_UNVERIFIED libmagic has to confirm it
+ *  \retval MAGIC_BUILTIN_UNKNOWN libmagic disagreed before
+ */
+static int MagicBuiltinVerdict(int id)
+{
+    uint32_t state = SCAtomicFetchAndAdd(&magic_builtin_state[id], 0);
+
+    if (state & MAGIC_BUILTIN_MISMATCH)
+        return MAGIC_BUILTIN_UNKNOWN;
+    if (state < MAGIC_BUILTIN_CONFIRM_CNT)
+        return MAGIC_BUILTIN_UNVERIFIED;
+    /* keep checking a sample, libmagic may still disagree on an input
+     * the confirmed ones didn't cover */
+    if ((SCAtomicAddAndFetch(&magic_builtin_hits[id], 1) & MAGIC_BUILTIN_RECHECK_MASK) == 0)
+        return MAGIC_BUILTIN_UNVERIFIED;
+    return MAGIC_BUILTIN_TRUSTED;
+}
+
+/**
+ *  \brief compile the signatures at offset 0 into the trie
+ *
+ *  The trie is first built with a full child table per node and then
+ *  compacted into sorted edge lists. Only the root keeps a full table.
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int MagicBuiltinInit(void)
+{
+    int16_t (*next)[256] = NULL;
+    int16_t *sig_at = NULL;
+    MagicBuiltinTrie *t = NULL;
+    int max_nodes = 1;
+    int node_cnt = 1;
+    int edge_cnt = 0;
+    int i, b;
+
+    if (g_magic_builtin != NULL)
+        return 0;
+
+    memset(magic_builtin_state, 0x00, sizeof(magic_builtin_state));
+    memset(magic_builtin_hits, 0x00, sizeof(magic_builtin_hits));
+
+    for (i = 0; i < MAGIC_BUILTIN_SIG_CNT; i++) {
+        BUG_ON(magic_builtin_sigs[i].offset == 0 &&
+               magic_builtin_sigs[i].len > MAGIC_BUILTIN_MAX_SIG_LEN);
+        if (magic_builtin_sigs[i].offset == 0)
+            max_nodes += magic_builtin_sigs[i].len;
+    }
+
+    next = SCMalloc(max_nodes * sizeof(*next));
+    sig_at = SCMalloc(max_nodes * sizeof(int16_t));
+    if (unlikely(next == NULL || sig_at == NULL))
+        goto error;
+    memset(next, 0x00, max_nodes * sizeof(*next));
+    for (i = 0; i < max_nodes; i++)
+        sig_at[i] = -1;
+
+    for (i = 0; i < MAGIC_BUILTIN_SIG_CNT; i++) {
+        const MagicBuiltinSig *s = &magic_builtin_sigs[i];
+        int node = 0;
+        int d;
+
+        if (s->offset != 0)
+            continue;
+
+        for (d = 0; d < s->len; d++) {
+            uint8_t c = (uint8_t)s->bytes[d];
+            if (next[node][c] == 0) {
+                next[node][c] = (int16_t)node_cnt++;
+                edge_cnt++;
+            }
+            node = next[node][c];
+        }
+        BUG_ON(sig_at[node] != -1);
+        sig_at[node] = (int16_t)i;
+    }
+
+    t = SCMalloc(sizeof(MagicBuiltinTrie));
+    if (unlikely(t == NULL))
+        goto error;
+    memset(t, 0x00, sizeof(MagicBuiltinTrie));
+    t->nodes = SCMalloc(node_cnt * sizeof(MagicBuiltinNode));
+    t->edges = SCMalloc((edge_cnt ? edge_cnt : 1) * sizeof(MagicBuiltinEdge));
+    if (unlikely(t->nodes == NULL || t->edges == NULL))
+        goto error;
+    t->node_cnt = (uint16_t)node_cnt;
+
+    for (b = 0; b < 256; b++)
+        t->root[b] = (uint16_t)next[0][b];
+
+    int e = 0;
+    for (i = 0; i < node_cnt; i++) {
+        t->nodes[i].sig = sig_at[i];
+        t->nodes[i].edge_idx = (uint16_t)e;
+        t->nodes[i].edge_cnt = 0;
+        if (i == 0)
+            continue;
+        for (b = 0; b < 256; b++) {
+            if (next[i][b] != 0) {
+                t->edges[e].byte = (uint8_t)b;
+                t->edges[e].node = (uint16_t)next[i][b];
+                t->nodes[i].edge_cnt++;
+                e++;
+            }
+        }
+    }
+
+    SCFree(next);
+    SCFree(sig_at);
+
+    g_magic_builtin = t;
+    SCLogDebug("builtin magic: %d sigs, %d trie nodes", MAGIC_BUILTIN_SIG_CNT,
+            node_cnt);
+    return 0;
+
+error:
+    if (next != NULL)
+        SCFree(next);
+    if (sig_at != NULL)
+        SCFree(sig_at);
+    if (t != NULL) {
+        if (t->nodes != NULL)
+            SCFree(t->nodes);
+        if (t->edges != NULL)
+            SCFree(t->edges);
+        SCFree(t);
+    }
+    return -1;
+}
+
+void MagicBuiltinDeinit(void)
+{
+    MagicBuiltinTrie *t = g_magic_builtin;
+
+    g_magic_builtin = NULL;
+    if (t != NULL) {
+        SCFree(t->nodes);
+        SCFree(t->edges);
+        SCFree(t);
+    }
+}
+
+/**
+ *  \brief identify a file by its first bytes
+ *
+ *  \param buf start of the file
+ *  \param buflen length of buf
+ *  \param out buffer for the description
+ *  \param outlen size of out, MAGIC_BUILTIN_DESC_MAX is enough
+ *  \param id set to the id of the description, for MagicBuiltinConfirm
+ *
+ *  \retval MAGIC_BUILTIN_TRUSTED type identified, description is in out
+ *  \retval MAGIC_BUILTIN_UNVERIFIED description is in out, but has to be
+ *          confirmed by libmagic before it can be used
+ *  \retval MAGIC_BUILTIN_UNKNOWN unknown, use libmagic
+ */
+int MagicBuiltinLookup(const uint8_t *buf, uint32_t buflen, char *out, size_t outlen,
+        int *id)
+{
+    const MagicBuiltinTrie *t = g_magic_builtin;
+    int16_t matches[MAGIC_BUILTIN_MAX_SIG_LEN];
+    int match_cnt = 0;
+    int i;
+
+    if (t == NULL || buf == NULL || buflen == 0 || outlen == 0)
+        return MAGIC_BUILTIN_UNKNOWN;
+
+    uint16_t node = t->root[buf[0]];
+    uint32_t d = 1;
+    while (node != 0) {
+        const MagicBuiltinNode *n = &t->nodes[node];
+        if (n->sig >= 0)
+            matches[match_cnt++] = n->sig;
+        if (d >= buflen)
+            break;
+
+        const MagicBuiltinEdge *e = &t->edges[n->edge_idx];
+        const MagicBuiltinEdge *end = e + n->edge_cnt;
+        node = 0;
+        for ( ; e < end && e->byte <= buf[d]; e++) {
+            if (e->byte == buf[d]) {
+                node = e->node;
+                break;
+            }
+        }
+        d++;
+    }
+
+    /* longest match first */
+    for (i = match_cnt - 1; i >= 0; i--) {
+        int r = MagicBuiltinDescribe(matches[i], buf, buflen, out, outlen, id);
+        if (r == MAGIC_BUILTIN_DESCRIBED)
+            return MagicBuiltinVerdict(*id);
+        if (r == MAGIC_BUILTIN_DEFER)
+            return MAGIC_BUILTIN_UNKNOWN;
+    }
+
+    for (i = 0; i < MAGIC_BUILTIN_SIG_CNT; i++) {
+        const MagicBuiltinSig *s = &magic_builtin_sigs[i];
+        if (s->offset == 0 || buflen < (uint32_t)s->offset + s->len)
+            continue;
+        if (memcmp(buf + s->offset, s->bytes, s->len) == 0) {
+            if (MagicBuiltinDescribe(i, buf, buflen, out, outlen, id) == MAGIC_BUILTIN_DESCRIBED)
+                return MagicBuiltinVerdict(*id);
+            return MAGIC_BUILTIN_UNKNOWN;
+        }
+    }
+    return MAGIC_BUILTIN_UNKNOWN;
+}
+
+/**
+ *  \brief check an unverified description against libmagic's
+ *
+ *  The description is trusted after MAGIC_BUILTIN_CONFIRM_CNT identical
+ *  answers from libmagic. If libmagic returns anything else, even once,
+ *  the description is not used anymore and these files go to libmagic.
+ *
+ *  \param id id set by MagicBuiltinLookup
+ *  \param desc the builtin description
+ *  \param libmagic_desc libmagic's description for the same buffer
+ */
+void MagicBuiltinConfirm(int id, const char *desc, const char *libmagic_desc)
+{
+    if (id < 0 || id >= MAGIC_BUILTIN_SIG_CNT * MAGIC_BUILTIN_VARIANTS)
+        return;
+    /* libmagic failed, no verdict */
+    if (libmagic_desc == NULL)
+        return;
+
+    if (strcmp(desc, libmagic_desc) == 0) {
+        if (SCAtomicFetchAndAdd(&magic_builtin_state[id], 0) < MAGIC_BUILTIN_CONFIRM_CNT)
+            (void)SCAtomicFetchAndAdd(&magic_builtin_state[id], 1);
+        return;
+    }
+
+    uint32_t old = SCAtomicFetchAndOr(&magic_builtin_state[id], MAGIC_BUILTIN_MISMATCH);
+    if (!(old & MAGIC_BUILTIN_MISMATCH)) {
+        SCLogInfo("builtin magic \"%s\" differs from libmagic's \"%s\", "
+                "leaving these files to libmagic", desc, libmagic_desc);
+    }
+}
+
+#ifdef UNITTESTS
+
+static int MagicBuiltinTestLookup(const uint8_t *buf, uint32_t buflen, const char *expect)
+{
+    char desc[MAGIC_BUILTIN_DESC_MAX];
+    int id = -1;
+
+    int r = MagicBuiltinLookup(buf, buflen, desc, sizeof(desc), &id);
+    if (expect == NULL) {
+        if (r != MAGIC_BUILTIN_UNKNOWN) {
+            printf("expected no match, got \"%s\": ", desc);
+            return 0;
+        }
+        return 1;
+    }
+    if (r == MAGIC_BUILTIN_UNKNOWN || strcmp(desc, expect) != 0) {
+        printf("expected \"%s\", got \"%s\": ", expect,
+                r != MAGIC_BUILTIN_UNKNOWN ? desc : "(none)");
+        return 0;
+    }
+    return 1;
+}
+
+/** \test common types */
+static int MagicBuiltinTest01(void)
+{
+    int result = 0;
+    uint8_t buf[512];
+
+    if (MagicBuiltinInit() != 0)
+        return 0;
+
+    uint8_t pdf[] = "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n";
+    if (!MagicBuiltinTestLookup(pdf, sizeof(pdf) - 1, "PDF document, version 1.4"))
+        goto end;
+
+    uint8_t gif[] = "GIF89a\x02\x00\x03\x00";
+    if (!MagicBuiltinTestLookup(gif, sizeof(gif) - 1, "GIF image data, version 89a, 2 x 3"))
+        goto end;
+
+    /* BZh without a block size is not bzip2 */
+    uint8_t bz[] = "BZh9";
+    if (!MagicBuiltinTestLookup(bz, sizeof(bz) - 1, "bzip2 compressed data, block size = 900k"))
+        goto end;
+    if (!MagicBuiltinTestLookup((uint8_t *)"BZhx", 4, NULL))
+        goto end;
+
+    /* tar, signature at offset 257 */
+    memset(buf, 0x00, sizeof(buf));
+    memcpy(buf + 257, "ustar  \0", 8);
+    if (!MagicBuiltinTestLookup(buf, sizeof(buf), "POSIX tar archive (GNU)"))
+        goto end;
+
+    /* unknown */
+    if (!MagicBuiltinTestLookup((uint8_t *)"hello world\n", 12, NULL))
+        goto end;
+    /* OLE2 is left to libmagic */
+    uint8_t ole[] = { 0xd0, 0xcf, 0x11, 0xe0, 0xa1, 0xb1, 0x1a, 0xe1 };
+    if (!MagicBuiltinTestLookup(ole, sizeof(ole), NULL))
+        goto end;
+    /* so are the types libmagic describes beyond the first bytes */
+    uint8_t gz[] = { 0x1f, 0x8b, 0x08, 0x00 };
+    if (!MagicBuiltinTestLookup(gz, sizeof(gz), NULL))
+        goto end;
+    uint8_t png[] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a,
+        0x00, 0x00, 0x00, 0x0d, 'I', 'H', 'D', 'R',
+        0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x20 };
+    if (!MagicBuiltinTestLookup(png, sizeof(png), NULL))
+        goto end;
+    memset(buf, 0x00, sizeof(buf));
+    buf[0] = 'M'; buf[1] = 'Z';
+    if (!MagicBuiltinTestLookup(buf, sizeof(buf), NULL))
+        goto end;
+
+    result = 1;
+end:
+    MagicBuiltinDeinit();
+    return result;
+}
+
+/** \test descriptions are only trusted once libmagic agrees */
+static int MagicBuiltinTest02(void)
+{
+    int result = 0;
+    char desc[MAGIC_BUILTIN_DESC_MAX];
+    int gif_id = -1, id = -1;
+    int i, r, rechecks = 0;
+
+    if (MagicBuiltinInit() != 0)
+        return 0;
+
+    uint8_t gif[] = "GIF89a\x02\x00\x03\x00";
+    r = MagicBuiltinLookup(gif, sizeof(gif) - 1, desc, sizeof(desc), &gif_id);
+    if (r != MAGIC_BUILTIN_UNVERIFIED) {
+        printf("expected an unverified answer, got %d: ", r);
+        goto end;
+    }
+
+    for (i = 0; i < MAGIC_BUILTIN_CONFIRM_CNT; i++) {
+        if (MagicBuiltinLookup(gif, sizeof(gif) - 1, desc, sizeof(desc), &id) !=
+                MAGIC_BUILTIN_UNVERIFIED || id != gif_id) {
+            printf("trusted after %d confirms: ", i);
+            goto end;
+        }
+        MagicBuiltinConfirm(id, desc, "GIF image data, version 89a, 2 x 3");
+    }
+
+    /* trusted now, with a sample still going to libmagic */
+    for (i = 0; i <= MAGIC_BUILTIN_RECHECK_MASK; i++) {
+        r = MagicBuiltinLookup(gif, sizeof(gif) - 1, desc, sizeof(desc), &id);
+        if (r == MAGIC_BUILTIN_UNVERIFIED)
+            rechecks++;
+        else if (r != MAGIC_BUILTIN_TRUSTED)
+            goto end;
+    }
+    if (rechecks != 1) {
+        printf("expected 1 recheck, got %d: ", rechecks);
+        goto end;
+    }
+
+    /* the short form without the size is a description of its own */
+    r = MagicBuiltinLookup(gif, 6, desc, sizeof(desc), &id);
+    if (r != MAGIC_BUILTIN_UNVERIFIED || id == gif_id) {
+        printf("short form shares the state of the full one: ");
+        goto end;
+    }
+
+    /* a libmagic with a different description disables it */
+    uint8_t bz[] = "BZh9";
+    r = MagicBuiltinLookup(bz, sizeof(bz) - 1, desc, sizeof(desc), &id);
+    if (r != MAGIC_BUILTIN_UNVERIFIED)
+        goto end;
+    MagicBuiltinConfirm(id, desc, "bzip2 compressed data, block size = 900k, "
+            "some newer detail");
+    r = MagicBuiltinLookup(bz, sizeof(bz) - 1, desc, sizeof(desc), &id);
+    if (r != MAGIC_BUILTIN_UNKNOWN) {
+        printf("expected the bzip2 description to be disabled, got %d: ", r);
+        goto end;
+    }
+    /* later agreements don't enable it again */
+    for (i = 0; i < MAGIC_BUILTIN_CONFIRM_CNT; i++)
+        MagicBuiltinConfirm(id, "bzip2 compressed data, block size = 900k",
+                "bzip2 compressed data, block size = 900k");
+    if (MagicBuiltinLookup(bz, sizeof(bz) - 1, desc, sizeof(desc), &id) !=
+            MAGIC_BUILTIN_UNKNOWN)
+        goto end;
+
+    /* others are not affected */
+    if (MagicBuiltinLookup(gif, sizeof(gif) - 1, desc, sizeof(desc), &id) ==
+            MAGIC_BUILTIN_UNKNOWN)
+        goto end;
+
+    result = 1;
+end:
+    MagicBuiltinDeinit();
+    return result;
+}
+
+/** \test zip containers */
+static int MagicBuiltinTest03(void)
+{
+    int result = 0;
+    uint8_t buf[512];
+
+    if (MagicBuiltinInit() != 0)
+        return 0;
+
+#define ZIP_ENTRY(name) do {                        \
+        memset(buf, 0x00, sizeof(buf));             \
+        memcpy(buf, "PK\x03\x04\x14\x00", 6);       \
+        buf[26] = (uint8_t)(sizeof(name) - 1);      \
+        memcpy(buf + 30, name, sizeof(name) - 1);   \
+    } while (0)
+
+    ZIP_ENTRY("readme.txt");
+    if (!MagicBuiltinTestLookup(buf, sizeof(buf),
+                "Zip archive data, at least v2.0 to extract"))
+        goto end;
+
+    ZIP_ENTRY("META-INF/MANIFEST.MF");
+    if (!MagicBuiltinTestLookup(buf, sizeof(buf), "Java archive data (JAR)"))
+        goto end;
+
+    ZIP_ENTRY("[Content_Types].xml");
+    if (!MagicBuiltinTestLookup(buf, sizeof(buf), NULL))
+        goto end;
+    memcpy(buf + 200, "PK\x03\x04", 4);
+    memcpy(buf + 230, "word/document.xml", 17);
+    if (!MagicBuiltinTestLookup(buf, sizeof(buf), "Microsoft Word 2007+"))
+        goto end;
+
+    /* OpenDocument */
+    ZIP_ENTRY("mimetype");
+    if (!MagicBuiltinTestLookup(buf, sizeof(buf), NULL))
+        goto end;
+#undef ZIP_ENTRY
+
+    /* truncated local header */
+    if (!MagicBuiltinTestLookup(buf, 10, NULL))
+        goto end;
+
+    result = 1;
+end:
+    MagicBuiltinDeinit();
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void MagicBuiltinRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("MagicBuiltinTest01", MagicBuiltinTest01, 1);
+    UtRegisterTest("MagicBuiltinTest02", MagicBuiltinTest02, 1);
+    UtRegisterTest("MagicBuiltinTest03", MagicBuiltinTest03, 1);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,35 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __UTIL_MAGIC_BUILTIN_H__
+#define __UTIL_MAGIC_BUILTIN_H__
+
+/** max length of a description returned by MagicBuiltinLookup */
+#define MAGIC_BUILTIN_DESC_MAX  128
+
+/** MagicBuiltinLookup results */
+#define MAGIC_BUILTIN_UNKNOWN       0   /**< not identified, use libmagic */
+#define MAGIC_BUILTIN_TRUSTED       1   /**< identified, libmagic agrees */
+#define MAGIC_BUILTIN_UNVERIFIED    2   /**< see MagicBuiltinConfirm */
+
+int MagicBuiltinInit(void);
+void MagicBuiltinDeinit(void);
+int MagicBuiltinLookup(const uint8_t *, uint32_t, char *, size_t, int *);
+void MagicBuiltinConfirm(int, const char *, const char *);
+void MagicBuiltinRegisterTests(void);
+
+#endif /* __UTIL_MAGIC_BUILTIN_H__ */
@@ -25,17 +25,59 @@
  * Libmagic's API is not thread safe. The data the pointer returned by
  * magic_buffer is overwritten by the next magic_buffer call. This is
  * why we need to lock calls and copy the returned string.
+ *
+ * To keep most lookups away from libmagic and its lock, the builtin
+ * matcher (util-magic-builtin.c) is tried first. Files it doesn't
+ * identify, and files with a description libmagic hasn't confirmed yet,
+ * are passed to libmagic.
  */
 
 #include "suricata-common.h"
 #include "conf.h"
 
 #include "util-unittest.h"
+#include "util-cpu.h"
+#include "util-magic.h"
+#include "util-magic-builtin.h"
 #include <magic.h>
 
 static magic_t g_magic_ctx = NULL;
 static SCMutex g_magic_lock;
 
+/** use the builtin matcher before libmagic */
+static int g_magic_builtin_enabled = 1;
+
+/* totals of the MagicCounters of all lookups */
+SC_ATOMIC_DECLARE(uint64_t, magic_builtin_cnt);
+SC_ATOMIC_DECLARE(uint64_t, magic_builtin_ticks);
+SC_ATOMIC_DECLARE(uint64_t, magic_libmagic_cnt);
+SC_ATOMIC_DECLARE(uint64_t, magic_libmagic_ticks);
+
+/**
+ *  \brief try the builtin matcher
+ *
+ *  \param desc buffer of MAGIC_BUILTIN_DESC_MAX bytes
+ *  \param id set if libmagic has to confirm the description in desc,
+ *         -1 otherwise
+ *
+ *  \retval magic strdup'd description or NULL if libmagic has to be used
+ */
+static char *MagicBuiltinTry(uint8_t *buf, uint32_t buflen, char *desc, int *id)
+{
+    char *magic = NULL;
+
+    int r = MagicBuiltinLookup(buf, buflen, desc, MAGIC_BUILTIN_DESC_MAX, id);
+    if (r != MAGIC_BUILTIN_UNVERIFIED)
+        *id = -1;
+    if (r == MAGIC_BUILTIN_TRUSTED) {
+        magic = SCStrdup(desc);
+        if (magic == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Unable to dup magic");
+        }
+    }
+    return magic;
+}
+
 /**
  *  \brief Initialize the "magic" context.
  */
@@ -51,6 +93,22 @@ int MagicInit(void)
     SCMutexInit(&g_magic_lock, NULL);
     SCMutexLock(&g_magic_lock);
 
+    SC_ATOMIC_INIT(magic_builtin_cnt);
+    SC_ATOMIC_INIT(magic_builtin_ticks);
+    SC_ATOMIC_INIT(magic_libmagic_cnt);
+    SC_ATOMIC_INIT(magic_libmagic_ticks);
+
+    int builtin = 1;
+    if (ConfGetBool("magic-builtin", &builtin) == 1 && builtin == 0) {
+        SCLogInfo("builtin magic disabled, using libmagic for all files");
+        g_magic_builtin_enabled = 0;
+    } else {
+        g_magic_builtin_enabled = 1;
+        if (MagicBuiltinInit() != 0) {
+            goto error;
+        }
+    }
+
     g_magic_ctx = magic_open(0);
     if (g_magic_ctx == NULL) {
         SCLogError(SC_ERR_MAGIC_OPEN, "magic_open failed: %s", magic_error(g_magic_ctx));
@@ -81,6 +139,7 @@ error:
         magic_close(g_magic_ctx);
         g_magic_ctx = NULL;
     }
+    MagicBuiltinDeinit();
 
     SCMutexUnlock(&g_magic_lock);
     SCReturnInt(-1);
@@ -98,58 +157,136 @@ char *MagicGlobalLookup(uint8_t *buf, uint32_t buflen)
 {
     const char *result = NULL;
     char *magic = NULL;
+    char desc[MAGIC_BUILTIN_DESC_MAX];
+    int id = -1;
+
+    if (buf == NULL || buflen == 0)
+        SCReturnPtr(NULL, "const char");
+
+    uint64_t ticks = UtilCpuGetTicks();
+
+    if (g_magic_builtin_enabled) {
+        magic = MagicBuiltinTry(buf, buflen, desc, &id);
+        if (magic != NULL) {
+            (void)SC_ATOMIC_ADD(magic_builtin_cnt, 1);
+            (void)SC_ATOMIC_ADD(magic_builtin_ticks, UtilCpuGetTicks() - ticks);
+            SCReturnPtr(magic, "const char");
+        }
+    }
 
     SCMutexLock(&g_magic_lock);
 
-    if (buf != NULL && buflen > 0) {
-        result = magic_buffer(g_magic_ctx, (void *)buf, (size_t)buflen);
-        if (result != NULL) {
-            magic = SCStrdup(result);
-            if (magic == NULL) {
-                SCLogError(SC_ERR_MEM_ALLOC, "Unable to dup magic");
-            }
+    result = magic_buffer(g_magic_ctx, (void *)buf, (size_t)buflen);
+    if (id >= 0)
+        MagicBuiltinConfirm(id, desc, result);
+    if (result != NULL) {
+        magic = SCStrdup(result);
+        if (magic == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Unable to dup magic");
         }
     }
 
     SCMutexUnlock(&g_magic_lock);
+
+    (void)SC_ATOMIC_ADD(magic_libmagic_cnt, 1);
+    (void)SC_ATOMIC_ADD(magic_libmagic_ticks, UtilCpuGetTicks() - ticks);
     SCReturnPtr(magic, "const char");
 }
 
 /**
  *  \brief Find the magic value for a buffer.
  *
+ *  \param ctx thread's libmagic ctx
  *  \param buf the buffer
  *  \param buflen length of the buffer
+ *  \param counters thread's counters, see MagicCountersMerge
  *
  *  \retval result pointer to null terminated string
  */
-char *MagicThreadLookup(magic_t *ctx, uint8_t *buf, uint32_t buflen)
+char *MagicThreadLookup(magic_t *ctx, uint8_t *buf, uint32_t buflen,
+        MagicCounters *counters)
 {
     const char *result = NULL;
     char *magic = NULL;
+    char desc[MAGIC_BUILTIN_DESC_MAX];
+    int id = -1;
+
+    if (buf == NULL || buflen == 0)
+        SCReturnPtr(NULL, "const char");
 
-    if (buf != NULL && buflen > 0) {
-        result = magic_buffer(*ctx, (void *)buf, (size_t)buflen);
-        if (result != NULL) {
-            magic = SCStrdup(result);
-            if (magic == NULL) {
-                SCLogError(SC_ERR_MEM_ALLOC, "Unable to dup magic");
-            }
+    uint64_t ticks = UtilCpuGetTicks();
+
+    if (g_magic_builtin_enabled) {
+        magic = MagicBuiltinTry(buf, buflen, desc, &id);
+        if (magic != NULL) {
+            counters->builtin++;
+            counters->builtin_ticks += (UtilCpuGetTicks() - ticks);
+            SCReturnPtr(magic, "const char");
         }
     }
 
+    result = magic_buffer(*ctx, (void *)buf, (size_t)buflen);
+    if (id >= 0)
+        MagicBuiltinConfirm(id, desc, result);
+    if (result != NULL) {
+        magic = SCStrdup(result);
+        if (magic == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Unable to dup magic");
+        }
+    }
+
+    counters->libmagic++;
+    counters->libmagic_ticks += (UtilCpuGetTicks() - ticks);
     SCReturnPtr(magic, "const char");
 }
 
+/**
+ *  \brief add a thread's counters to the totals
+ */
+void MagicCountersMerge(const MagicCounters *counters)
+{
+    (void)SC_ATOMIC_ADD(magic_builtin_cnt, counters->builtin);
+    (void)SC_ATOMIC_ADD(magic_builtin_ticks, counters->builtin_ticks);
+    (void)SC_ATOMIC_ADD(magic_libmagic_cnt, counters->libmagic);
+    (void)SC_ATOMIC_ADD(magic_libmagic_ticks, counters->libmagic_ticks);
+}
+
+/**
+ *  \brief get the totals of all lookups so far
+ */
+void MagicCountersGet(MagicCounters *counters)
+{
+    counters->builtin = SC_ATOMIC_GET(magic_builtin_cnt);
+    counters->builtin_ticks = SC_ATOMIC_GET(magic_builtin_ticks);
+    counters->libmagic = SC_ATOMIC_GET(magic_libmagic_cnt);
+    counters->libmagic_ticks = SC_ATOMIC_GET(magic_libmagic_ticks);
+}
+
 void MagicDeinit(void)
 {
+    MagicCounters c;
+
+    MagicCountersGet(&c);
+    if (c.builtin > 0 || c.libmagic > 0) {
+        SCLogInfo("magic: builtin %"PRIu64" lookups (avg %"PRIu64" ticks), "
+                "libmagic %"PRIu64" lookups (avg %"PRIu64" ticks)",
+                c.builtin, c.builtin ? c.builtin_ticks / c.builtin : 0,
+                c.libmagic, c.libmagic ? c.libmagic_ticks / c.libmagic : 0);
+    }
+
     SCMutexLock(&g_magic_lock);
     if (g_magic_ctx != NULL) {
         magic_close(g_magic_ctx);
         g_magic_ctx = NULL;
     }
+    MagicBuiltinDeinit();
     SCMutexUnlock(&g_magic_lock);
     SCMutexDestroy(&g_magic_lock);
+
+    SC_ATOMIC_DESTROY(magic_builtin_cnt);
+    SC_ATOMIC_DESTROY(magic_builtin_ticks);
+    SC_ATOMIC_DESTROY(magic_libmagic_cnt);
+    SC_ATOMIC_DESTROY(magic_libmagic_ticks);
 }
 
 #ifdef UNITTESTS
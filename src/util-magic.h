@@ -26,10 +26,21 @@
 
 #include <magic.h>
 
+/** lookup counters per path. A lookup the builtin matcher can't answer
+ *  is counted as a libmagic lookup, including the builtin attempt. */
+typedef struct MagicCounters_ {
+    uint64_t builtin;           /**< lookups answered by the builtin matcher */
+    uint64_t builtin_ticks;
+    uint64_t libmagic;          /**< lookups answered by libmagic */
+    uint64_t libmagic_ticks;
+} MagicCounters;
+
 int MagicInit(void);
 void MagicDeinit(void);
 char *MagicGlobalLookup(uint8_t *, uint32_t);
-char *MagicThreadLookup(magic_t *, uint8_t *, uint32_t);
+char *MagicThreadLookup(magic_t *, uint8_t *, uint32_t, MagicCounters *);
+void MagicCountersMerge(const MagicCounters *);
+void MagicCountersGet(MagicCounters *);
 void MagicRegisterTests(void);
 
 #endif /* __UTIL_MAGIC_H__ */
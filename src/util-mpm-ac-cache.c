@@ -0,0 +1,593 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * On disk cache for the prepared state tables of the "ac" mpm.
+ *
+ * Building the AC delta table is the most expensive part of the
+ * detection engine setup for large rulesets. After a table is built it
+ * is written to "mpm-cache-dir", in a file named after a hash of the
+ * pattern set, the cache format and the engine version. At the next
+ * start (or from another Suricata process on the same box) the file is
+ * mmap()ed read only and the tables are used in place, so only the
+ * contexts that have no cache entry have to be built.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+
+#include "conf.h"
+#include "util-debug.h"
+#include "util-mpm.h"
+#include "util-mpm-ac.h"
+#include "util-mpm-ac-cache.h"
+
+#include <sys/mman.h>
+
+#define SC_AC_CACHE_MAGIC       "SCACMPM"
+#define SC_AC_CACHE_ALIGN(x)    (((x) + 7) & ~((uint64_t)7))
+/** cs_offset value for entries without a case sensitive pattern */
+#define SC_AC_CACHE_NO_CS       0xFFFFFFFF
+
+typedef struct SCACCacheHeader_ {
+    char magic[8];
+    uint32_t version;
+    uint32_t hdr_size;
+    uint64_t key;
+    char prog_ver[32];
+
+    uint32_t pattern_cnt;
+    uint32_t state_count;
+    uint16_t max_pat_id;
+    uint16_t single_state_size;
+    uint32_t pids_cnt;
+
+    /* offsets are from the start of the file, 0 means not present */
+    uint64_t patterns_offset;
+    uint64_t patterns_size;
+    uint64_t state_table_u16_offset;
+    uint64_t state_table_u32_offset;
+    uint64_t output_offset;     /**< uint32_t no_of_entries per state */
+    uint64_t pids_offset;       /**< all pids, in state order */
+    uint64_t pid_pat_offset;    /**< SCACCachePatEntry per pattern id */
+    uint64_t cs_offset;
+    uint64_t cs_size;
+    uint64_t file_size;
+} SCACCacheHeader;
+
+typedef struct SCACCachePatEntry_ {
+    uint32_t cs_offset;         /**< relative to the cs area */
+    uint16_t patlen;
+    uint16_t case_state;
+} SCACCachePatEntry;
+
+/**
+ * \brief Get the cache directory from the config.
+ *
+ * \retval dir the directory or NULL if the cache is disabled
+ */
+const char *SCACCacheGetDir(void)
+{
+    char *dir = NULL;
+
+    if (ConfGet("mpm-cache-dir", &dir) != 1)
+        return NULL;
+    if (dir == NULL || strlen(dir) == 0)
+        return NULL;
+
+    return dir;
+}
+
+static int SCACCachePatternCmp(const void *a, const void *b)
+{
+    const SCACPattern *p1 = *(const SCACPattern **)a;
+    const SCACPattern *p2 = *(const SCACPattern **)b;
+
+    if (p1->id != p2->id)
+        return p1->id < p2->id ? -1 : 1;
+    if (p1->flags != p2->flags)
+        return p1->flags < p2->flags ? -1 : 1;
+    if (p1->len != p2->len)
+        return p1->len < p2->len ? -1 : 1;
+    return memcmp(p1->original_pat, p2->original_pat, p1->len);
+}
+
+/**
+ * \internal
+ * \brief Serialize the (sorted) pattern array. The result is both hashed
+ *        into the cache key and stored in the cache file, so that a hash
+ *        collision can never result in using the wrong tables.
+ */
+static uint8_t *SCACCacheSerializePatterns(MpmCtx *mpm_ctx, uint64_t *size)
+{
+    SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+    uint64_t len = 0;
+    uint32_t i;
+
+    for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
+        len += 8 + SC_AC_CACHE_ALIGN(ctx->parray[i]->len);
+    }
+
+    uint8_t *buf = SCMalloc(len);
+    if (buf == NULL)
+        return NULL;
+    memset(buf, 0, len);
+
+    uint8_t *ptr = buf;
+    for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
+        SCACPattern *p = ctx->parray[i];
+
+        memcpy(ptr, &p->id, sizeof(uint32_t));
+        memcpy(ptr + 4, &p->len, sizeof(uint16_t));
+        ptr[6] = p->flags;
+        memcpy(ptr + 8, p->original_pat, p->len);
+        ptr += 8 + SC_AC_CACHE_ALIGN(p->len);
+    }
+
+    *size = len;
+    return buf;
+}
+
+/** \internal \brief 64 bit FNV-1a */
+static uint64_t SCACCacheHash(uint64_t hash, const uint8_t *data, uint64_t len)
+{
+    uint64_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t SCACCacheKey(const uint8_t *patterns, uint64_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint32_t version = SC_AC_CACHE_VERSION;
+
+    hash = SCACCacheHash(hash, (uint8_t *)"ac", 2);
+    hash = SCACCacheHash(hash, (uint8_t *)PROG_VER, strlen(PROG_VER));
+    hash = SCACCacheHash(hash, (uint8_t *)&version, sizeof(version));
+    hash = SCACCacheHash(hash, patterns, size);
+    return hash;
+}
+
+static int SCACCacheGetPath(const char *dir, uint64_t key, char *path, size_t size)
+{
+    int r = snprintf(path, size, "%s/ac-%016"PRIx64".cache", dir, key);
+    if (r < 0 || (size_t)r >= size)
+        return -1;
+    return 0;
+}
+
+/** \internal \brief check that a section lies within the mapped file */
+static inline int SCACCacheSectionValid(const SCACCacheHeader *hdr,
+        uint64_t offset, uint64_t len)
+{
+    if (offset == 0 || (offset & 7) != 0)
+        return 0;
+    if (offset > hdr->file_size || len > hdr->file_size - offset)
+        return 0;
+    return 1;
+}
+
+/**
+ * \internal
+ * \brief Validate a mapped cache file against the patterns of the ctx.
+ *
+ * \retval 1 valid
+ * \retval 0 stale or corrupt
+ */
+static int SCACCacheValidate(MpmCtx *mpm_ctx, const uint8_t *map, uint64_t map_size,
+        uint64_t key, const uint8_t *patterns, uint64_t patterns_size)
+{
+    const SCACCacheHeader *hdr = (const SCACCacheHeader *)map;
+
+    if (memcmp(hdr->magic, SC_AC_CACHE_MAGIC, sizeof(SC_AC_CACHE_MAGIC)) != 0 ||
+        hdr->version != SC_AC_CACHE_VERSION ||
+        hdr->hdr_size != sizeof(SCACCacheHeader) ||
+        hdr->key != key ||
+        strncmp(hdr->prog_ver, PROG_VER, sizeof(hdr->prog_ver)) != 0 ||
+        hdr->file_size != map_size ||
+        hdr->pattern_cnt != mpm_ctx->pattern_cnt ||
+        hdr->state_count == 0)
+    {
+        return 0;
+    }
+
+    if (hdr->patterns_size != patterns_size ||
+        !SCACCacheSectionValid(hdr, hdr->patterns_offset, patterns_size) ||
+        memcmp(map + hdr->patterns_offset, patterns, patterns_size) != 0)
+    {
+        return 0;
+    }
+
+    /* the search function picks the table based on the state count */
+    if (hdr->state_count < 32767) {
+        if (!SCACCacheSectionValid(hdr, hdr->state_table_u16_offset,
+                    (uint64_t)hdr->state_count * sizeof(SC_AC_STATE_TYPE_U16) * 256))
+            return 0;
+    } else {
+        if (!SCACCacheSectionValid(hdr, hdr->state_table_u32_offset,
+                    (uint64_t)hdr->state_count * sizeof(SC_AC_STATE_TYPE_U32) * 256))
+            return 0;
+    }
+
+    if (!SCACCacheSectionValid(hdr, hdr->output_offset,
+                (uint64_t)hdr->state_count * sizeof(uint32_t)) ||
+        !SCACCacheSectionValid(hdr, hdr->pids_offset,
+                (uint64_t)hdr->pids_cnt * sizeof(uint32_t)) ||
+        !SCACCacheSectionValid(hdr, hdr->pid_pat_offset,
+                ((uint64_t)hdr->max_pat_id + 1) * sizeof(SCACCachePatEntry)) ||
+        !SCACCacheSectionValid(hdr, hdr->cs_offset, hdr->cs_size))
+    {
+        return 0;
+    }
+
+    uint64_t pids = 0;
+    const uint32_t *entries = (const uint32_t *)(map + hdr->output_offset);
+    uint32_t state;
+    for (state = 0; state < hdr->state_count; state++) {
+        pids += entries[state];
+    }
+    if (pids != hdr->pids_cnt)
+        return 0;
+
+    const SCACCachePatEntry *pe = (const SCACCachePatEntry *)(map + hdr->pid_pat_offset);
+    uint32_t i;
+    for (i = 0; i < (uint32_t)hdr->max_pat_id + 1; i++) {
+        if (pe[i].cs_offset == SC_AC_CACHE_NO_CS)
+            continue;
+        if ((uint64_t)pe[i].cs_offset + pe[i].patlen > hdr->cs_size)
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * \brief Try to load the prepared tables for the patterns of this ctx
+ *        from the cache.
+ *
+ *        Needs to be called with ctx->parray populated. The pattern array
+ *        is sorted so that the same pattern set always results in the same
+ *        key and tables, regardless of the order the patterns were added in.
+ *
+ * \retval 1 tables were loaded, the ctx is ready for searching
+ * \retval 0 no (valid) cache entry, the tables need to be built
+ */
+int SCACCacheLoad(MpmCtx *mpm_ctx)
+{
+    SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+    char path[PATH_MAX];
+    uint8_t *patterns = NULL;
+    uint64_t patterns_size = 0;
+    void *map = MAP_FAILED;
+    uint64_t map_size = 0;
+
+    if (ctx->cache_dir == NULL || ctx->parray == NULL)
+        return 0;
+
+    qsort(ctx->parray, mpm_ctx->pattern_cnt, sizeof(SCACPattern *),
+            SCACCachePatternCmp);
+
+    patterns = SCACCacheSerializePatterns(mpm_ctx, &patterns_size);
+    if (patterns == NULL)
+        return 0;
+
+    uint64_t key = SCACCacheKey(patterns, patterns_size);
+    if (SCACCacheGetPath(ctx->cache_dir, key, path, sizeof(path)) < 0)
+        goto miss;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        SCLogDebug("no cache entry %s", path);
+        goto miss;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(SCACCacheHeader)) {
+        close(fd);
+        goto miss;
+    }
+    map_size = (uint64_t)st.st_size;
+
+    map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        goto miss;
+
+    if (!SCACCacheValidate(mpm_ctx, map, map_size, key, patterns, patterns_size)) {
+        SCLogInfo("ignoring stale or corrupt mpm cache file %s", path);
+        goto miss;
+    }
+
+    const SCACCacheHeader *hdr = (const SCACCacheHeader *)map;
+    uint8_t *base = (uint8_t *)map;
+
+    ctx->output_table = SCMalloc(hdr->state_count * sizeof(SCACOutputTable));
+    if (ctx->output_table == NULL)
+        goto miss;
+    ctx->pid_pat_list = SCMalloc(((uint32_t)hdr->max_pat_id + 1) * sizeof(SCACPatternList));
+    if (ctx->pid_pat_list == NULL) {
+        SCFree(ctx->output_table);
+        ctx->output_table = NULL;
+        goto miss;
+    }
+
+    /* output table: the pids arrays point into the mapping */
+    const uint32_t *entries = (const uint32_t *)(base + hdr->output_offset);
+    uint32_t *pids = (uint32_t *)(base + hdr->pids_offset);
+    uint32_t state;
+    for (state = 0; state < hdr->state_count; state++) {
+        ctx->output_table[state].no_of_entries = entries[state];
+        ctx->output_table[state].pids = entries[state] ? pids : NULL;
+        pids += entries[state];
+    }
+
+    const SCACCachePatEntry *pe = (const SCACCachePatEntry *)(base + hdr->pid_pat_offset);
+    uint32_t i;
+    for (i = 0; i < (uint32_t)hdr->max_pat_id + 1; i++) {
+        ctx->pid_pat_list[i].cs = (pe[i].cs_offset == SC_AC_CACHE_NO_CS) ?
+            NULL : base + hdr->cs_offset + pe[i].cs_offset;
+        ctx->pid_pat_list[i].patlen = pe[i].patlen;
+        ctx->pid_pat_list[i].case_state = pe[i].case_state;
+    }
+
+    if (hdr->state_table_u16_offset != 0)
+        ctx->state_table_u16 = (void *)(base + hdr->state_table_u16_offset);
+    if (hdr->state_table_u32_offset != 0)
+        ctx->state_table_u32 = (void *)(base + hdr->state_table_u32_offset);
+
+    ctx->state_count = hdr->state_count;
+    ctx->max_pat_id = hdr->max_pat_id;
+    ctx->single_state_size = hdr->single_state_size;
+    ctx->cache_map = map;
+    ctx->cache_map_size = map_size;
+
+    SCLogDebug("loaded %"PRIu32" states for %"PRIu32" patterns from %s",
+            ctx->state_count, mpm_ctx->pattern_cnt, path);
+    SCFree(patterns);
+    return 1;
+
+miss:
+    if (map != MAP_FAILED)
+        munmap(map, map_size);
+    SCFree(patterns);
+    return 0;
+}
+
+/**
+ * \internal
+ * \brief Write len bytes of data at offset, padding the file up to the
+ *        offset with zeros.
+ */
+static int SCACCacheWriteAt(FILE *fp, uint64_t *pos, uint64_t offset,
+        const void *data, uint64_t len)
+{
+    static const uint8_t zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    while (*pos < offset) {
+        uint64_t pad = offset - *pos;
+        if (pad > sizeof(zeros))
+            pad = sizeof(zeros);
+        if (fwrite(zeros, 1, pad, fp) != pad)
+            return -1;
+        *pos += pad;
+    }
+
+    if (len > 0 && fwrite(data, 1, len, fp) != len)
+        return -1;
+    *pos += len;
+    return 0;
+}
+
+/**
+ * \brief Store the prepared tables of this ctx in the cache.
+ *
+ *        Called after the state table has been built, while the (sorted)
+ *        pattern array still exists. The file is written under a temporary
+ *        name and renamed, so concurrent readers never see a partial file.
+ *
+ * \retval 0 on success or if the cache is disabled
+ * \retval -1 on error
+ */
+int SCACCacheStore(MpmCtx *mpm_ctx)
+{
+    SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX];
+    uint8_t *patterns = NULL;
+    uint64_t patterns_size = 0;
+    FILE *fp = NULL;
+    uint32_t state, i;
+
+    if (ctx->cache_dir == NULL || ctx->cache_map != NULL || ctx->parray == NULL)
+        return 0;
+
+    patterns = SCACCacheSerializePatterns(mpm_ctx, &patterns_size);
+    if (patterns == NULL)
+        return -1;
+
+    uint64_t key = SCACCacheKey(patterns, patterns_size);
+    if (SCACCacheGetPath(ctx->cache_dir, key, path, sizeof(path)) < 0)
+        goto error;
+    /* unique per process and ctx, as contexts are prepared in parallel */
+    int r = snprintf(tmp_path, sizeof(tmp_path), "%s.%d.%lx.tmp", path,
+            (int)getpid(), (unsigned long)mpm_ctx);
+    if (r < 0 || (size_t)r >= sizeof(tmp_path))
+        goto error;
+
+    SCACCacheHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SC_AC_CACHE_MAGIC, sizeof(SC_AC_CACHE_MAGIC));
+    hdr.version = SC_AC_CACHE_VERSION;
+    hdr.hdr_size = sizeof(SCACCacheHeader);
+    hdr.key = key;
+    strlcpy(hdr.prog_ver, PROG_VER, sizeof(hdr.prog_ver));
+    hdr.pattern_cnt = mpm_ctx->pattern_cnt;
+    hdr.state_count = ctx->state_count;
+    hdr.max_pat_id = ctx->max_pat_id;
+    hdr.single_state_size = ctx->single_state_size;
+
+    uint64_t cs_size = 0;
+    for (i = 0; i < (uint32_t)ctx->max_pat_id + 1; i++) {
+        if (ctx->pid_pat_list[i].cs != NULL)
+            cs_size += ctx->pid_pat_list[i].patlen;
+    }
+    for (state = 0; state < ctx->state_count; state++) {
+        hdr.pids_cnt += ctx->output_table[state].no_of_entries;
+    }
+
+    /* layout */
+    uint64_t off = SC_AC_CACHE_ALIGN(sizeof(SCACCacheHeader));
+    hdr.patterns_offset = off;
+    hdr.patterns_size = patterns_size;
+    off = SC_AC_CACHE_ALIGN(off + patterns_size);
+    if (ctx->state_table_u16 != NULL) {
+        hdr.state_table_u16_offset = off;
+        off = SC_AC_CACHE_ALIGN(off + (uint64_t)ctx->state_count *
+                sizeof(SC_AC_STATE_TYPE_U16) * 256);
+    }
+    if (ctx->state_table_u32 != NULL) {
+        hdr.state_table_u32_offset = off;
+        off = SC_AC_CACHE_ALIGN(off + (uint64_t)ctx->state_count *
+                sizeof(SC_AC_STATE_TYPE_U32) * 256);
+    }
+    hdr.output_offset = off;
+    off = SC_AC_CACHE_ALIGN(off + (uint64_t)ctx->state_count * sizeof(uint32_t));
+    hdr.pids_offset = off;
+    off = SC_AC_CACHE_ALIGN(off + (uint64_t)hdr.pids_cnt * sizeof(uint32_t));
+    hdr.pid_pat_offset = off;
+    off = SC_AC_CACHE_ALIGN(off + ((uint64_t)ctx->max_pat_id + 1) *
+            sizeof(SCACCachePatEntry));
+    hdr.cs_offset = off;
+    hdr.cs_size = cs_size;
+    off = SC_AC_CACHE_ALIGN(off + cs_size);
+    hdr.file_size = off;
+
+    fp = fopen(tmp_path, "w");
+    if (fp == NULL) {
+        SCLogWarning(SC_ERR_FOPEN, "failed to open mpm cache file %s: %s",
+                tmp_path, strerror(errno));
+        goto error;
+    }
+
+    uint64_t pos = 0;
+    if (SCACCacheWriteAt(fp, &pos, 0, &hdr, sizeof(hdr)) < 0 ||
+        SCACCacheWriteAt(fp, &pos, hdr.patterns_offset, patterns, patterns_size) < 0)
+        goto write_error;
+    if (ctx->state_table_u16 != NULL &&
+        SCACCacheWriteAt(fp, &pos, hdr.state_table_u16_offset, ctx->state_table_u16,
+            (uint64_t)ctx->state_count * sizeof(SC_AC_STATE_TYPE_U16) * 256) < 0)
+        goto write_error;
+    if (ctx->state_table_u32 != NULL &&
+        SCACCacheWriteAt(fp, &pos, hdr.state_table_u32_offset, ctx->state_table_u32,
+            (uint64_t)ctx->state_count * sizeof(SC_AC_STATE_TYPE_U32) * 256) < 0)
+        goto write_error;
+
+    if (SCACCacheWriteAt(fp, &pos, hdr.output_offset, NULL, 0) < 0)
+        goto write_error;
+    for (state = 0; state < ctx->state_count; state++) {
+        uint32_t entries = ctx->output_table[state].no_of_entries;
+        if (SCACCacheWriteAt(fp, &pos, pos, &entries, sizeof(entries)) < 0)
+            goto write_error;
+    }
+    if (SCACCacheWriteAt(fp, &pos, hdr.pids_offset, NULL, 0) < 0)
+        goto write_error;
+    for (state = 0; state < ctx->state_count; state++) {
+        if (SCACCacheWriteAt(fp, &pos, pos, ctx->output_table[state].pids,
+                    (uint64_t)ctx->output_table[state].no_of_entries * sizeof(uint32_t)) < 0)
+            goto write_error;
+    }
+
+    uint32_t cs_off = 0;
+    if (SCACCacheWriteAt(fp, &pos, hdr.pid_pat_offset, NULL, 0) < 0)
+        goto write_error;
+    for (i = 0; i < (uint32_t)ctx->max_pat_id + 1; i++) {
+        SCACCachePatEntry pe;
+        pe.patlen = ctx->pid_pat_list[i].patlen;
+        pe.case_state = ctx->pid_pat_list[i].case_state;
+        if (ctx->pid_pat_list[i].cs != NULL) {
+            pe.cs_offset = cs_off;
+            cs_off += pe.patlen;
+        } else {
+            pe.cs_offset = SC_AC_CACHE_NO_CS;
+        }
+        if (SCACCacheWriteAt(fp, &pos, pos, &pe, sizeof(pe)) < 0)
+            goto write_error;
+    }
+    if (SCACCacheWriteAt(fp, &pos, hdr.cs_offset, NULL, 0) < 0)
+        goto write_error;
+    for (i = 0; i < (uint32_t)ctx->max_pat_id + 1; i++) {
+        if (ctx->pid_pat_list[i].cs == NULL)
+            continue;
+        if (SCACCacheWriteAt(fp, &pos, pos, ctx->pid_pat_list[i].cs,
+                    ctx->pid_pat_list[i].patlen) < 0)
+            goto write_error;
+    }
+    if (SCACCacheWriteAt(fp, &pos, hdr.file_size, NULL, 0) < 0)
+        goto write_error;
+
+    if (fclose(fp) != 0) {
+        fp = NULL;
+        goto write_error;
+    }
+    fp = NULL;
+
+    if (rename(tmp_path, path) != 0) {
+        SCLogWarning(SC_ERR_FWRITE, "failed to rename mpm cache file %s: %s",
+                tmp_path, strerror(errno));
+        unlink(tmp_path);
+        goto error;
+    }
+
+    SCLogDebug("stored %"PRIu32" states for %"PRIu32" patterns in %s",
+            ctx->state_count, mpm_ctx->pattern_cnt, path);
+    SCFree(patterns);
+    return 0;
+
+write_error:
+    SCLogWarning(SC_ERR_FWRITE, "failed to write mpm cache file %s", tmp_path);
+    if (fp != NULL)
+        fclose(fp);
+    unlink(tmp_path);
+error:
+    SCFree(patterns);
+    return -1;
+}
+
+/**
+ * \brief Release the cache mapping of a ctx. The tables pointing into it
+ *        are reset, the output table and pattern list arrays themselves
+ *        are freed by the caller.
+ */
+void SCACCacheUnmap(MpmCtx *mpm_ctx)
+{
+    SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+
+    if (ctx->cache_map == NULL)
+        return;
+
+    munmap(ctx->cache_map, ctx->cache_map_size);
+    ctx->cache_map = NULL;
+    ctx->cache_map_size = 0;
+    ctx->state_table_u16 = NULL;
+    ctx->state_table_u32 = NULL;
+}
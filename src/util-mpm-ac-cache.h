@@ -0,0 +1,30 @@
+/* Copyright (C) 2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef __UTIL_MPM_AC_CACHE_H__
+#define __UTIL_MPM_AC_CACHE_H__
+
+/** bump this whenever the layout of the cache file or of the tables
+ *  stored in it changes */
+#define SC_AC_CACHE_VERSION 1
+
+const char *SCACCacheGetDir(void);
+int SCACCacheLoad(MpmCtx *);
+int SCACCacheStore(MpmCtx *);
+void SCACCacheUnmap(MpmCtx *);
+
+#endif /* __UTIL_MPM_AC_CACHE_H__ */
@@ -58,6 +58,11 @@
 #include "util-unittest-helper.h"
 #include "util-memcmp.h"
 #include "util-mpm-ac.h"
+#include "util-mpm-ac-cache.h"
+
+#ifdef UNITTESTS
+#include <dirent.h>
+#endif
 
 #ifdef __SC_CUDA_SUPPORT__
 
@@ -104,16 +109,14 @@ typedef struct StateQueue_ {
 
 /**
  * \internal
- * \brief Initialize the AC context with user specified conf parameters.  We
- *        aren't retrieving anything for AC conf now, but we will certainly
- *        need it, when we customize AC.
+ * \brief Initialize the AC context with user specified conf parameters.
+ *        The only one for now is the directory of the state table cache.
+ *
+ * \param ctx Pointer to the AC context.
  */
-static void SCACGetConfig()
+static void SCACGetConfig(SCACCtx *ctx)
 {
-    //ConfNode *ac_conf;
-    //const char *hash_val = NULL;
-
-    //ConfNode *pm = ConfGetNode("pattern-matcher");
+    ctx->cache_dir = SCACCacheGetDir();
 
     return;
 }
@@ -1005,6 +1008,10 @@ int SCACPreparePatterns(MpmCtx *mpm_ctx)
     SCFree(ctx->init_hash);
     ctx->init_hash = NULL;
 
+    /* if an identical pattern set was prepared before, use its tables */
+    if (mpm_ctx->mpm_type == MPM_AC && SCACCacheLoad(mpm_ctx) == 1)
+        goto free_patterns;
+
     /* the memory consumed by a single state in our goto table */
     ctx->single_state_size = sizeof(int32_t) * 256;
 
@@ -1049,6 +1056,9 @@ int SCACPreparePatterns(MpmCtx *mpm_ctx)
     /* prepare the state table required by AC */
     SCACPrepareStateTable(mpm_ctx);
 
+    if (mpm_ctx->mpm_type == MPM_AC)
+        SCACCacheStore(mpm_ctx);
+
 #ifdef __SC_CUDA_SUPPORT__
     if (mpm_ctx->mpm_type == MPM_AC_CUDA) {
         int r = SCCudaMemAlloc(&ctx->state_table_u32_cuda,
@@ -1068,6 +1078,7 @@ int SCACPreparePatterns(MpmCtx *mpm_ctx)
     }
 #endif
 
+free_patterns:
     /* free all the stored patterns.  Should save us a good 100-200 mbs */
     for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
         if (ctx->parray[i] != NULL) {
@@ -1134,9 +1145,8 @@ void SCACInitCtx(MpmCtx *mpm_ctx)
     }
     memset(ctx->init_hash, 0, sizeof(SCACPattern *) * INIT_HASH_SIZE);
 
-    /* get conf values for AC from our yaml file.  We have no conf values for
-     * now.  We will certainly need this, as we develop the algo */
-    SCACGetConfig();
+    /* get conf values for AC from our yaml file */
+    SCACGetConfig(ctx);
 
     SCReturn;
 }
@@ -1193,6 +1203,12 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
         mpm_ctx->memory_size -= (mpm_ctx->pattern_cnt * sizeof(SCACPattern *));
     }
 
+    /* tables loaded from the cache live in the mapping */
+    int mapped = (ctx->cache_map != NULL);
+    if (mapped) {
+        SCACCacheUnmap(mpm_ctx);
+    }
+
     if (ctx->state_table_u16 != NULL) {
         SCFree(ctx->state_table_u16);
         ctx->state_table_u16 = NULL;
@@ -1213,7 +1229,7 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
     if (ctx->output_table != NULL) {
         uint32_t state_count;
         for (state_count = 0; state_count < ctx->state_count; state_count++) {
-            if (ctx->output_table[state_count].pids != NULL) {
+            if (ctx->output_table[state_count].pids != NULL && !mapped) {
                 SCFree(ctx->output_table[state_count].pids);
             }
         }
@@ -1223,7 +1239,7 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
     if (ctx->pid_pat_list != NULL) {
         int i;
         for (i = 0; i < (ctx->max_pat_id + 1); i++) {
-            if (ctx->pid_pat_list[i].cs != NULL)
+            if (ctx->pid_pat_list[i].cs != NULL && !mapped)
                 SCFree(ctx->pid_pat_list[i].cs);
         }
         SCFree(ctx->pid_pat_list);
@@ -3220,6 +3236,128 @@ end:
     return result;
 }
 
+/** \internal \brief remove the cache files created by a test */
+static void SCACTestCacheCleanup(const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (d != NULL) {
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL) {
+            if (de->d_name[0] == '.')
+                continue;
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+            unlink(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+static uint32_t SCACTestCacheSearch(const char *dir, int reverse, int extra,
+                                    int *from_cache)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+    PatternMatcherQueue pmq;
+
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx, MPM_AC);
+    SCACInitThreadCtx(&mpm_ctx, &mpm_thread_ctx, 0);
+    ((SCACCtx *)mpm_ctx.ctx)->cache_dir = dir;
+
+    if (reverse) {
+        SCACAddPatternCI(&mpm_ctx, (uint8_t *)"ABCD", 4, 0, 0, 2, 0, 0);
+        SCACAddPatternCS(&mpm_ctx, (uint8_t *)"bCd", 3, 0, 0, 1, 0, 0);
+        SCACAddPatternCS(&mpm_ctx, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    } else {
+        SCACAddPatternCS(&mpm_ctx, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+        SCACAddPatternCS(&mpm_ctx, (uint8_t *)"bCd", 3, 0, 0, 1, 0, 0);
+        SCACAddPatternCI(&mpm_ctx, (uint8_t *)"ABCD", 4, 0, 0, 2, 0, 0);
+    }
+    if (extra)
+        SCACAddPatternCS(&mpm_ctx, (uint8_t *)"xyz", 3, 0, 0, 3, 0, 0);
+    PmqSetup(&pmq, 0, 4);
+
+    SCACPreparePatterns(&mpm_ctx);
+    *from_cache = (((SCACCtx *)mpm_ctx.ctx)->cache_map != NULL);
+
+    char *buf = "abcdaBcdxyz";
+    uint32_t cnt = SCACSearch(&mpm_ctx, &mpm_thread_ctx, &pmq,
+                              (uint8_t *)buf, strlen(buf));
+
+    SCACDestroyCtx(&mpm_ctx);
+    SCACDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    return cnt;
+}
+
+/**
+ * \test Test that the prepared tables are stored in the cache and that
+ *       the same pattern set, added in a different order, is loaded from it.
+ */
+static int SCACTest30(void)
+{
+    int result = 0;
+    int from_cache = 0;
+    char dir[] = "/tmp/suricata-ac-cache-XXXXXX";
+
+    if (mkdtemp(dir) == NULL)
+        return 0;
+
+    uint32_t cnt = SCACTestCacheSearch(dir, 0, 0, &from_cache);
+    if (from_cache != 0 || cnt != 3) {
+        printf("first run: cnt %"PRIu32" from_cache %d: ", cnt, from_cache);
+        goto end;
+    }
+
+    cnt = SCACTestCacheSearch(dir, 1, 0, &from_cache);
+    if (from_cache != 1 || cnt != 3) {
+        printf("second run: cnt %"PRIu32" from_cache %d: ", cnt, from_cache);
+        goto end;
+    }
+
+    result = 1;
+end:
+    SCACTestCacheCleanup(dir);
+    return result;
+}
+
+/**
+ * \test Test that a different pattern set doesn't use the cached tables.
+ */
+static int SCACTest31(void)
+{
+    int result = 0;
+    int from_cache = 0;
+    char dir[] = "/tmp/suricata-ac-cache-XXXXXX";
+
+    if (mkdtemp(dir) == NULL)
+        return 0;
+
+    uint32_t cnt = SCACTestCacheSearch(dir, 0, 0, &from_cache);
+    if (from_cache != 0 || cnt != 3)
+        goto end;
+
+    cnt = SCACTestCacheSearch(dir, 0, 1, &from_cache);
+    if (from_cache != 0 || cnt != 4) {
+        printf("cnt %"PRIu32" from_cache %d: ", cnt, from_cache);
+        goto end;
+    }
+
+    cnt = SCACTestCacheSearch(dir, 1, 1, &from_cache);
+    if (from_cache != 1 || cnt != 4) {
+        printf("cnt %"PRIu32" from_cache %d: ", cnt, from_cache);
+        goto end;
+    }
+
+    result = 1;
+end:
+    SCACTestCacheCleanup(dir);
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 void SCACRegisterTests(void)
@@ -3255,6 +3393,8 @@ void SCACRegisterTests(void)
     UtRegisterTest("SCACTest27", SCACTest27, 1);
     UtRegisterTest("SCACTest28", SCACTest28, 1);
     UtRegisterTest("SCACTest29", SCACTest29, 1);
+    UtRegisterTest("SCACTest30", SCACTest30, 1);
+    UtRegisterTest("SCACTest31", SCACTest31, 1);
 #endif
 
     return;
@@ -89,6 +89,13 @@ typedef struct SCACCtx_ {
     uint16_t single_state_size;
     uint16_t max_pat_id;
 
+    /* directory of the on disk state table cache, NULL if disabled */
+    const char *cache_dir;
+    /* if the tables were loaded from the cache, they live in this read
+     * only mapping and must not be freed individually */
+    void *cache_map;
+    size_t cache_map_size;
+
 #ifdef __SC_CUDA_SUPPORT__
     CUdeviceptr state_table_u16_cuda;
     CUdeviceptr state_table_u32_cuda;
@@ -96,6 +96,8 @@ void MpmB2gcRegister (void) {
     mpm_table[MPM_B2GC].AddPattern = B2gcAddPatternCS;
     mpm_table[MPM_B2GC].AddPatternNocase = B2gcAddPatternCI;
     mpm_table[MPM_B2GC].Prepare = B2gcPreparePatterns;
+    /* B2gcHashPatternSortHash uses a static copy of ctx->m */
+    mpm_table[MPM_B2GC].flags |= MPM_TABLE_FLAG_PREPARE_SERIAL;
     mpm_table[MPM_B2GC].Search = B2gcSearchWrap;
     mpm_table[MPM_B2GC].Cleanup = NULL;
     mpm_table[MPM_B2GC].PrintCtx = B2gcPrintInfo;
@@ -234,7 +234,7 @@ void MpmFactoryReClaimMpmCtx(DetectEngineCtx *de_ctx, MpmCtx *mpm_ctx)
 
     if (!MpmFactoryIsMpmCtxAvailable(de_ctx, mpm_ctx)) {
         if (mpm_ctx->mpm_type != MPM_NOTSET)
-            mpm_table[mpm_ctx->mpm_type].DestroyCtx(mpm_ctx);
+            MpmDestroyCtx(mpm_ctx);
         SCFree(mpm_ctx);
     }
 
@@ -253,12 +253,12 @@ void MpmFactoryDeRegisterAllMpmCtxProfiles(DetectEngineCtx *de_ctx)
             SCFree(items[i].name);
         if (items[i].mpm_ctx_ts != NULL) {
             if (items[i].mpm_ctx_ts->mpm_type != MPM_NOTSET)
-                mpm_table[items[i].mpm_ctx_ts->mpm_type].DestroyCtx(items[i].mpm_ctx_ts);
+                MpmDestroyCtx(items[i].mpm_ctx_ts);
             SCFree(items[i].mpm_ctx_ts);
         }
         if (items[i].mpm_ctx_tc != NULL) {
             if (items[i].mpm_ctx_tc->mpm_type != MPM_NOTSET)
-                mpm_table[items[i].mpm_ctx_tc->mpm_type].DestroyCtx(items[i].mpm_ctx_tc);
+                MpmDestroyCtx(items[i].mpm_ctx_tc);
             SCFree(items[i].mpm_ctx_tc);
         }
     }
@@ -579,6 +579,325 @@ void MpmInitCtx (MpmCtx *mpm_ctx, uint16_t matcher) {
     mpm_table[matcher].InitCtx(mpm_ctx);
 }
 
+/** record the patterns added to ctxs, only needed if the detection engine
+ *  can be reloaded */
+static int mpm_record_patterns = 0;
+
+/**
+ *  \brief Enable or disable recording the patterns added to mpm ctxs. Ctxs
+ *         built while recording is disabled are never shared.
+ */
+void MpmSetRecordPatterns(int enable)
+{
+    mpm_record_patterns = enable;
+}
+
+/** \internal \brief Free the list of patterns recorded for a ctx */
+static void MpmCtxFreePatterns(MpmCtx *mpm_ctx)
+{
+    uint32_t u;
+
+    for (u = 0; u < mpm_ctx->patterns_cnt; u++)
+        SCFree(mpm_ctx->patterns[u].pat);
+    if (mpm_ctx->patterns != NULL)
+        SCFree(mpm_ctx->patterns);
+
+    mpm_ctx->patterns = NULL;
+    mpm_ctx->patterns_cnt = 0;
+    mpm_ctx->patterns_size = 0;
+    mpm_ctx->patterns_sorted = 0;
+}
+
+/**
+ *  \brief Destroy the matcher specific part of a mpm ctx. If the ctx is
+ *         shared with a ctx of another detection engine, only our
+ *         reference is dropped.
+ */
+void MpmDestroyCtx(MpmCtx *mpm_ctx)
+{
+    if (mpm_ctx->mpm_type == MPM_NOTSET)
+        return;
+
+    MpmCtxFreePatterns(mpm_ctx);
+    mpm_ctx->patterns_digest_set = 0;
+    mpm_ctx->patterns_incomplete = 0;
+
+    if (mpm_ctx->refcnt != NULL) {
+        if (--(*mpm_ctx->refcnt) > 0) {
+            mpm_ctx->ctx = NULL;
+            mpm_ctx->refcnt = NULL;
+            return;
+        }
+        SCFree(mpm_ctx->refcnt);
+        mpm_ctx->refcnt = NULL;
+    }
+
+    mpm_table[mpm_ctx->mpm_type].DestroyCtx(mpm_ctx);
+}
+
+/** \internal \brief 64 bit FNV-1a over a pattern and its settings */
+static uint64_t MpmPatternHash(uint8_t *pat, uint16_t patlen, uint16_t offset,
+        uint16_t depth, uint32_t pid, uint8_t flags)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint8_t meta[11];
+    uint16_t u;
+
+    memcpy(meta, &patlen, 2);
+    memcpy(meta + 2, &offset, 2);
+    memcpy(meta + 4, &depth, 2);
+    memcpy(meta + 6, &pid, 4);
+    meta[10] = flags;
+
+    for (u = 0; u < sizeof(meta); u++) {
+        hash ^= meta[u];
+        hash *= 0x100000001b3ULL;
+    }
+    for (u = 0; u < patlen; u++) {
+        hash ^= pat[u];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ *  \internal
+ *  \brief Record a pattern added to a ctx. If that fails the ctx is
+ *         marked as incomplete, so it's never considered equal to
+ *         another ctx.
+ */
+static void MpmCtxRecordPattern(MpmCtx *mpm_ctx, uint8_t *pat, uint16_t patlen,
+        uint16_t offset, uint16_t depth, uint32_t pid, uint8_t flags)
+{
+    if (mpm_ctx->patterns_incomplete)
+        return;
+    if (!mpm_record_patterns || mpm_ctx->patterns_digest_set) {
+        mpm_ctx->patterns_incomplete = 1;
+        return;
+    }
+
+    if (mpm_ctx->patterns_cnt == mpm_ctx->patterns_size) {
+        uint32_t size = mpm_ctx->patterns_size ? mpm_ctx->patterns_size * 2 : 16;
+        MpmPatternRecord *ptr = SCRealloc(mpm_ctx->patterns,
+                size * sizeof(MpmPatternRecord));
+        if (ptr == NULL)
+            goto error;
+        mpm_ctx->patterns = ptr;
+        mpm_ctx->patterns_size = size;
+    }
+
+    MpmPatternRecord *rec = &mpm_ctx->patterns[mpm_ctx->patterns_cnt];
+    rec->pat = SCMalloc(patlen ? patlen : 1);
+    if (rec->pat == NULL)
+        goto error;
+    memcpy(rec->pat, pat, patlen);
+    rec->patlen = patlen;
+    rec->offset = offset;
+    rec->depth = depth;
+    rec->pid = pid;
+    rec->flags = flags;
+
+    mpm_ctx->patterns_cnt++;
+    mpm_ctx->patterns_sorted = 0;
+    return;
+
+error:
+    MpmCtxFreePatterns(mpm_ctx);
+    mpm_ctx->patterns_incomplete = 1;
+}
+
+static int MpmPatternRecordCompare(const void *a, const void *b)
+{
+    const MpmPatternRecord *ra = (const MpmPatternRecord *)a;
+    const MpmPatternRecord *rb = (const MpmPatternRecord *)b;
+
+    if (ra->pid != rb->pid)
+        return ra->pid < rb->pid ? -1 : 1;
+    if (ra->flags != rb->flags)
+        return ra->flags < rb->flags ? -1 : 1;
+    if (ra->patlen != rb->patlen)
+        return ra->patlen < rb->patlen ? -1 : 1;
+    if (ra->offset != rb->offset)
+        return ra->offset < rb->offset ? -1 : 1;
+    if (ra->depth != rb->depth)
+        return ra->depth < rb->depth ? -1 : 1;
+    return memcmp(ra->pat, rb->pat, ra->patlen);
+}
+
+/** \internal \brief sort the recorded patterns, so the order in which
+ *            they were added doesn't matter when comparing ctxs */
+static void MpmCtxSortPatterns(MpmCtx *mpm_ctx)
+{
+    if (mpm_ctx->patterns_sorted)
+        return;
+
+    if (mpm_ctx->patterns_cnt > 1) {
+        qsort(mpm_ctx->patterns, mpm_ctx->patterns_cnt,
+                sizeof(MpmPatternRecord), MpmPatternRecordCompare);
+    }
+    mpm_ctx->patterns_sorted = 1;
+}
+
+/** \internal \brief 64 bit FNV-1a over the sorted pattern list */
+static void MpmCtxDigestPatterns(MpmCtx *mpm_ctx)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint32_t u;
+
+    if (mpm_ctx->patterns_digest_set)
+        return;
+
+    MpmCtxSortPatterns(mpm_ctx);
+
+    for (u = 0; u < mpm_ctx->patterns_cnt; u++) {
+        MpmPatternRecord *rec = &mpm_ctx->patterns[u];
+        hash ^= MpmPatternHash(rec->pat, rec->patlen, rec->offset,
+                rec->depth, rec->pid, rec->flags);
+        hash *= 0x100000001b3ULL;
+    }
+    mpm_ctx->patterns_digest = hash;
+    mpm_ctx->patterns_digest_set = 1;
+}
+
+/**
+ *  \brief Replace the recorded pattern list of a ctx by a digest of it.
+ *
+ *  Called once the engine the ctx belongs to is built, so that the copies
+ *  of the patterns don't stay around for the lifetime of the engine. The
+ *  digest is enough to compare the ctx with the ctxs of a reloaded engine.
+ */
+void MpmCtxReleasePatterns(MpmCtx *mpm_ctx)
+{
+    uint32_t cnt = mpm_ctx->patterns_cnt;
+
+    if (mpm_ctx->patterns_incomplete || mpm_ctx->patterns == NULL)
+        return;
+
+    MpmCtxDigestPatterns(mpm_ctx);
+    MpmCtxFreePatterns(mpm_ctx);
+    /* the count is still used as a quick check */
+    mpm_ctx->patterns_cnt = cnt;
+}
+
+/**
+ *  \brief Add a case sensitive pattern to a mpm ctx, keeping track of the
+ *         pattern hash and the pattern list of the ctx. The sid is not
+ *         part of either, as none of the matchers use it.
+ */
+int MpmAddPatternCS(MpmCtx *mpm_ctx, uint8_t *pat, uint16_t patlen,
+        uint16_t offset, uint16_t depth, uint32_t pid, uint32_t sid,
+        uint8_t flags)
+{
+    mpm_ctx->pattern_hash += MpmPatternHash(pat, patlen, offset, depth, pid, flags);
+    MpmCtxRecordPattern(mpm_ctx, pat, patlen, offset, depth, pid, flags);
+    return mpm_table[mpm_ctx->mpm_type].AddPattern(mpm_ctx, pat, patlen,
+            offset, depth, pid, sid, flags);
+}
+
+/**
+ *  \brief Add a case insensitive pattern to a mpm ctx, keeping track of the
+ *         pattern hash and the pattern list of the ctx.
+ */
+int MpmAddPatternCI(MpmCtx *mpm_ctx, uint8_t *pat, uint16_t patlen,
+        uint16_t offset, uint16_t depth, uint32_t pid, uint32_t sid,
+        uint8_t flags)
+{
+    mpm_ctx->pattern_hash += MpmPatternHash(pat, patlen, offset, depth, pid,
+            flags | MPM_PATTERN_FLAG_NOCASE);
+    MpmCtxRecordPattern(mpm_ctx, pat, patlen, offset, depth, pid,
+            flags | MPM_PATTERN_FLAG_NOCASE);
+    return mpm_table[mpm_ctx->mpm_type].AddPatternNocase(mpm_ctx, pat, patlen,
+            offset, depth, pid, sid, flags);
+}
+
+/**
+ *  \brief Check if a (not yet prepared) ctx has the same patterns as a
+ *         prepared one, so that it can use the prepared one instead.
+ *
+ *  The pattern hash is only a quick check. If both ctxs still have their
+ *  pattern list the lists are compared, otherwise the digests of the
+ *  sorted lists are.
+ *
+ *  \retval 1 equal
+ *  \retval 0 not equal
+ */
+int MpmCtxIsEqual(MpmCtx *mpm_ctx, MpmCtx *prepared)
+{
+    uint32_t u;
+
+    if (mpm_ctx->mpm_type != prepared->mpm_type ||
+        mpm_ctx->pattern_cnt != prepared->pattern_cnt ||
+        mpm_ctx->minlen != prepared->minlen ||
+        mpm_ctx->maxlen != prepared->maxlen ||
+        mpm_ctx->pattern_hash != prepared->pattern_hash)
+        return 0;
+
+    if (mpm_ctx->patterns_incomplete || prepared->patterns_incomplete ||
+        mpm_ctx->patterns_cnt != prepared->patterns_cnt)
+        return 0;
+
+    if (mpm_ctx->patterns == NULL || prepared->patterns == NULL) {
+        MpmCtxDigestPatterns(mpm_ctx);
+        MpmCtxDigestPatterns(prepared);
+        return (mpm_ctx->patterns_digest == prepared->patterns_digest);
+    }
+
+    MpmCtxSortPatterns(mpm_ctx);
+    MpmCtxSortPatterns(prepared);
+
+    for (u = 0; u < mpm_ctx->patterns_cnt; u++) {
+        if (MpmPatternRecordCompare(&mpm_ctx->patterns[u],
+                    &prepared->patterns[u]) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ *  \brief Make a not yet prepared ctx use the matcher specific part of an
+ *         equal, prepared ctx. The unprepared part of mpm_ctx is destroyed.
+ *
+ *  Only the detection engine (re)load thread touches the refcnt, so it
+ *  doesn't need to be atomic.
+ */
+void MpmCtxShare(MpmCtx *mpm_ctx, MpmCtx *prepared)
+{
+    /* keep our pattern list, it's released with those of the other ctxs
+     * of the engine once it's built */
+    MpmPatternRecord *patterns = mpm_ctx->patterns;
+    uint32_t patterns_cnt = mpm_ctx->patterns_cnt;
+    uint32_t patterns_size = mpm_ctx->patterns_size;
+    uint8_t patterns_sorted = mpm_ctx->patterns_sorted;
+    mpm_ctx->patterns = NULL;
+    mpm_ctx->patterns_cnt = 0;
+
+    MpmDestroyCtx(mpm_ctx);
+
+    mpm_ctx->patterns = patterns;
+    mpm_ctx->patterns_cnt = patterns_cnt;
+    mpm_ctx->patterns_size = patterns_size;
+    mpm_ctx->patterns_sorted = patterns_sorted;
+
+    if (prepared->refcnt == NULL) {
+        prepared->refcnt = SCMalloc(sizeof(uint32_t));
+        if (unlikely(prepared->refcnt == NULL)) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+            exit(EXIT_FAILURE);
+        }
+        *prepared->refcnt = 1;
+    }
+    (*prepared->refcnt)++;
+
+    mpm_ctx->ctx = prepared->ctx;
+    mpm_ctx->pattern_cnt = prepared->pattern_cnt;
+    mpm_ctx->minlen = prepared->minlen;
+    mpm_ctx->maxlen = prepared->maxlen;
+    mpm_ctx->memory_cnt = prepared->memory_cnt;
+    mpm_ctx->memory_size = prepared->memory_size;
+    mpm_ctx->pattern_hash = prepared->pattern_hash;
+    mpm_ctx->refcnt = prepared->refcnt;
+}
+
 void MpmTableSetup(void) {
     memset(mpm_table, 0, sizeof(mpm_table));
 
@@ -655,12 +974,117 @@ uint32_t MpmGetBloomSize(const char *conf_val)
 /************************************Unittests*********************************/
 
 #ifdef UNITTESTS
+/** \test ctxs with the same patterns in a different order are equal, ctxs
+ *        with a colliding pattern hash but different patterns are not */
+static int MpmCtxIsEqualTest01(void)
+{
+    MpmCtx a, b, c;
+    int result = 0;
+
+    MpmSetRecordPatterns(1);
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    memset(&c, 0, sizeof(c));
+    MpmInitCtx(&a, MPM_AC);
+    MpmInitCtx(&b, MPM_AC);
+    MpmInitCtx(&c, MPM_AC);
+
+    MpmAddPatternCS(&a, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(&a, (uint8_t *)"efgh", 4, 0, 0, 1, 0, 0);
+    mpm_table[MPM_AC].Prepare(&a);
+
+    MpmAddPatternCI(&b, (uint8_t *)"efgh", 4, 0, 0, 1, 0, 0);
+    MpmAddPatternCS(&b, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    if (!MpmCtxIsEqual(&b, &a)) {
+        printf("same patterns in a different order not equal: ");
+        goto end;
+    }
+
+    MpmAddPatternCS(&c, (uint8_t *)"abce", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(&c, (uint8_t *)"efgh", 4, 0, 0, 1, 0, 0);
+    /* fake a hash collision */
+    c.pattern_hash = a.pattern_hash;
+    if (MpmCtxIsEqual(&c, &a)) {
+        printf("different patterns considered equal: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    MpmDestroyCtx(&a);
+    MpmDestroyCtx(&b);
+    MpmDestroyCtx(&c);
+    MpmSetRecordPatterns(0);
+    return result;
+}
+
+/** \test a ctx whose pattern list was released is compared by its digest,
+ *        ctxs built without recording patterns are never equal */
+static int MpmCtxIsEqualTest02(void)
+{
+    MpmCtx a, b, c, d;
+    int result = 0;
+
+    MpmSetRecordPatterns(1);
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    memset(&c, 0, sizeof(c));
+    memset(&d, 0, sizeof(d));
+    MpmInitCtx(&a, MPM_AC);
+    MpmInitCtx(&b, MPM_AC);
+    MpmInitCtx(&c, MPM_AC);
+    MpmInitCtx(&d, MPM_AC);
+
+    MpmAddPatternCS(&a, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(&a, (uint8_t *)"efgh", 4, 0, 0, 1, 0, 0);
+    mpm_table[MPM_AC].Prepare(&a);
+    MpmCtxReleasePatterns(&a);
+    if (a.patterns != NULL || a.patterns_cnt != 2) {
+        printf("pattern list not released: ");
+        goto end;
+    }
+
+    MpmAddPatternCI(&b, (uint8_t *)"efgh", 4, 0, 0, 1, 0, 0);
+    MpmAddPatternCS(&b, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    if (!MpmCtxIsEqual(&b, &a)) {
+        printf("same patterns not equal after release: ");
+        goto end;
+    }
+
+    MpmAddPatternCS(&c, (uint8_t *)"abce", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(&c, (uint8_t *)"efgh", 4, 0, 0, 1, 0, 0);
+    c.pattern_hash = a.pattern_hash;
+    if (MpmCtxIsEqual(&c, &a)) {
+        printf("different patterns considered equal after release: ");
+        goto end;
+    }
+
+    MpmSetRecordPatterns(0);
+    MpmAddPatternCS(&d, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(&d, (uint8_t *)"efgh", 4, 0, 0, 1, 0, 0);
+    if (d.patterns != NULL || MpmCtxIsEqual(&d, &a)) {
+        printf("patterns recorded while disabled: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    MpmDestroyCtx(&a);
+    MpmDestroyCtx(&b);
+    MpmDestroyCtx(&c);
+    MpmDestroyCtx(&d);
+    MpmSetRecordPatterns(0);
+    return result;
+}
 #endif /* UNITTESTS */
 
 void MpmRegisterTests(void) {
 #ifdef UNITTESTS
     uint16_t i;
 
+    UtRegisterTest("MpmCtxIsEqualTest01", MpmCtxIsEqualTest01, 1);
+    UtRegisterTest("MpmCtxIsEqualTest02", MpmCtxIsEqualTest02, 1);
+
     for (i = 0; i < MPM_TABLE_SIZE; i++) {
         if (i == MPM_NOTSET)
             continue;
@@ -108,6 +108,16 @@ typedef struct PatternMatcherQueue_ {
     uint32_t pattern_id_bitarray_size; /**< size in bytes */
 } PatternMatcherQueue;
 
+/** copy of a pattern as it was added to a ctx, used to compare ctxs */
+typedef struct MpmPatternRecord_ {
+    uint8_t *pat;
+    uint16_t patlen;
+    uint16_t offset;
+    uint16_t depth;
+    uint8_t flags;
+    uint32_t pid;
+} MpmPatternRecord;
+
 typedef struct MpmCtx_ {
     void *ctx;
     uint16_t mpm_type;
@@ -123,6 +133,25 @@ typedef struct MpmCtx_ {
 
     uint32_t memory_cnt;
     uint32_t memory_size;
+
+    /** order independent hash of the patterns added to this ctx, used to
+     *  find identical ctxs of a previous detection engine on reload */
+    uint64_t pattern_hash;
+    /** the patterns added to this ctx, to verify that ctxs with the same
+     *  hash really are identical. Only recorded if rule reloads are
+     *  enabled, and released once the engine is built. */
+    MpmPatternRecord *patterns;
+    uint32_t patterns_cnt;
+    uint32_t patterns_size;
+    /** hash over the sorted pattern list, replaces the list when it's
+     *  released */
+    uint64_t patterns_digest;
+    uint8_t patterns_sorted;
+    uint8_t patterns_digest_set;
+    uint8_t patterns_incomplete;    /**< patterns were not recorded, so
+                                         this ctx is never shared */
+    /** number of MpmCtx's using 'ctx', NULL if it's not shared */
+    uint32_t *refcnt;
 } MpmCtx;
 
 /* if we want to retrieve an unique mpm context from the mpm context factory
@@ -185,6 +214,9 @@ typedef struct MpmTableElmt_ {
     uint8_t flags;
 } MpmTableElmt;
 
+/** Prepare() uses global state, so ctxs can't be prepared in parallel */
+#define MPM_TABLE_FLAG_PREPARE_SERIAL   0x01
+
 MpmTableElmt mpm_table[MPM_TABLE_SIZE];
 
 /* macros decides if cuda is enabled for the platform or not */
@@ -245,6 +277,15 @@ int32_t MpmMatcherGetMaxPatternLength(uint16_t);
 
 int MpmVerifyMatch(MpmThreadCtx *, PatternMatcherQueue *, uint32_t);
 void MpmInitCtx(MpmCtx *mpm_ctx, uint16_t matcher);
+void MpmDestroyCtx(MpmCtx *mpm_ctx);
+int MpmCtxIsEqual(MpmCtx *, MpmCtx *);
+void MpmCtxShare(MpmCtx *, MpmCtx *);
+void MpmCtxReleasePatterns(MpmCtx *);
+void MpmSetRecordPatterns(int);
+int MpmAddPatternCS(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
+        uint32_t, uint32_t, uint8_t);
+int MpmAddPatternCI(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
+        uint32_t, uint32_t, uint8_t);
 void MpmInitThreadCtx(MpmThreadCtx *mpm_thread_ctx, uint16_t, uint32_t);
 uint32_t MpmGetHashSize(const char *);
 uint32_t MpmGetBloomSize(const char *);
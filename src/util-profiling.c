@@ -38,6 +38,9 @@
 #include "util-profiling.h"
 #include "util-profiling-locks.h"
 
+#include "counters.h"
+#include "tm-modules.h"
+
 #ifdef PROFILING
 
 #ifndef MIN
@@ -88,6 +91,17 @@ SCProfilePacketData packet_profile_detect_data6[PROF_DETECT_SIZE][257];
 
 int profiling_packets_enabled = 0;
 int profiling_packets_csv_enabled = 0;
+static int profiling_histograms_enabled = 0;
+
+/** per thread ids of the histogram counters fed by the packet profiling */
+typedef struct SCProfileHistograms_ {
+    ThreadVars *tv;
+    uint16_t pkt;
+    uint16_t app;
+    uint16_t tmm[TMM_SIZE];
+} SCProfileHistograms;
+
+static __thread SCProfileHistograms profiling_histograms;
 
 int profiling_output_to_file = 0;
 int profiling_packets_output_to_file = 0;
@@ -128,6 +142,12 @@ SCProfilingInit(void)
         if (ConfNodeChildValueIsTrue(conf, "enabled")) {
             profiling_packets_enabled = 1;
 
+            /* histograms are on unless explicitly disabled */
+            profiling_histograms_enabled = 1;
+            const char *hist = ConfNodeLookupChildValue(conf, "histograms");
+            if (hist != NULL && ConfValIsFalse(hist))
+                profiling_histograms_enabled = 0;
+
             if (pthread_mutex_init(&packet_profile_lock, NULL) != 0) {
                 SCLogError(SC_ERR_MUTEX,
                         "Failed to initialize packet profiling mutex.");
@@ -763,10 +783,74 @@ void SCProfilingUpdatePacketTmmRecords(Packet *p) {
     }
 }
 
+/**
+ *  \brief register the per thread tick histograms of the packet profiling
+ *
+ *  Registers a histogram for the whole packet, one for the app layer and
+ *  one per module in the thread's slots. They are fed by the packet
+ *  profiling macros and show up in the stats like any other counter.
+ *
+ *  \param tv thread vars, called before the counter array is created
+ */
+void SCProfilingRegisterThreadHistograms(ThreadVars *tv)
+{
+    TmSlot *s = NULL;
+    char name[128];
+
+    if (!profiling_packets_enabled || !profiling_histograms_enabled)
+        return;
+
+    memset(&profiling_histograms, 0, sizeof(profiling_histograms));
+
+    profiling_histograms.pkt = SCPerfTVRegisterHistogramCounter(
+            "profiling.pkt_ticks", tv, "cpu ticks per packet");
+    profiling_histograms.app = SCPerfTVRegisterHistogramCounter(
+            "profiling.app_layer_ticks", tv, "cpu ticks per app layer call");
+
+    for (s = tv->tm_slots; s != NULL; s = s->slot_next) {
+        if (s->tm_id < 0 || s->tm_id >= TMM_SIZE ||
+                tmm_modules[s->tm_id].name == NULL)
+            continue;
+
+        snprintf(name, sizeof(name), "profiling.tmm.%s",
+                tmm_modules[s->tm_id].name);
+        profiling_histograms.tmm[s->tm_id] =
+            SCPerfTVRegisterHistogramCounter(name, tv, "cpu ticks per module call");
+    }
+
+    profiling_histograms.tv = tv;
+}
+
+static inline void SCProfilingHistogramRecord(uint16_t id, uint64_t ticks)
+{
+    ThreadVars *tv = profiling_histograms.tv;
+
+    if (tv == NULL || id == 0 || tv->sc_perf_pca == NULL)
+        return;
+
+    SCPerfCounterRecordHistogram(id, tv->sc_perf_pca, ticks);
+}
+
+void SCProfilingHistogramRecordTmm(int tmm_id, uint64_t ticks)
+{
+    if (tmm_id < 0 || tmm_id >= TMM_SIZE)
+        return;
+
+    SCProfilingHistogramRecord(profiling_histograms.tmm[tmm_id], ticks);
+}
+
+void SCProfilingHistogramRecordApp(uint64_t ticks)
+{
+    SCProfilingHistogramRecord(profiling_histograms.app, ticks);
+}
+
 void SCProfilingAddPacket(Packet *p) {
     if (p->profile.ticks_start == 0 || p->profile.ticks_end == 0 || p->profile.ticks_start > p->profile.ticks_end)
         return;
 
+    SCProfilingHistogramRecord(profiling_histograms.pkt,
+            p->profile.ticks_end - p->profile.ticks_start);
+
     pthread_mutex_lock(&packet_profile_lock);
     {
 
@@ -997,3 +1081,514 @@ SCProfilingRegisterTests(void)
 }
 
 #endif /* PROFILING */
+
+/*
+ * Sampling profiler
+ *
+ * Unlike the packet profiling above this is part of every build. When
+ * enabled it times 1 in 'rate' packets (count mode) or one packet per
+ * thread per 'interval' msec (time mode). Samples are accumulated in
+ * thread local storage and merged into the global table every
+ * PROFILING_SAMPLE_MERGE_CNT samples or once a second, so the lock is
+ * only touched by a tiny fraction of the packets.
+ */
+
+/** samples after which a thread merges its data into the global table */
+#define PROFILING_SAMPLE_MERGE_CNT  64
+/** in time mode the clock is only checked every this many packets */
+#define PROFILING_SAMPLE_TIME_CHECK 16
+
+typedef struct SCProfileSampleData_ {
+    uint64_t cnt;
+    uint64_t ticks;
+    uint64_t max;
+} SCProfileSampleData;
+
+typedef struct SCProfileSampleThread_ {
+    uint32_t generation;        /**< generation the data belongs to */
+    uint32_t samples;           /**< samples since the last merge */
+    time_t last_merge;
+    uint64_t last_sample_ms;    /**< time mode: time of the last sample */
+
+    SCProfileSampleData pkt;
+    SCProfileSampleData tmm[TMM_SIZE];
+} SCProfileSampleThread;
+
+int profiling_sample_enabled = 0;
+__thread uint32_t profiling_sample_countdown = 0;
+
+static int profiling_sample_mode = PROFILING_SAMPLE_MODE_COUNT;
+static uint32_t profiling_sample_rate = PROFILING_SAMPLE_DEFAULT_RATE;
+static uint32_t profiling_sample_interval = PROFILING_SAMPLE_DEFAULT_INTERVAL;
+
+/** protects the global table and the generation */
+static SCMutex profiling_sample_lock = SCMUTEX_INITIALIZER;
+/** bumped on reset, threads drop data of an older generation */
+static uint32_t profiling_sample_generation = 0;
+static SCProfileSampleData profiling_sample_pkt;
+static SCProfileSampleData profiling_sample_tmm[TMM_SIZE];
+
+static __thread SCProfileSampleThread profiling_sample_thread;
+
+static const char *SCProfilingSampleModeToString(int mode)
+{
+    return (mode == PROFILING_SAMPLE_MODE_TIME) ? "time" : "count";
+}
+
+static inline void SCProfilingSampleDataAdd(SCProfileSampleData *d, uint64_t ticks)
+{
+    d->cnt++;
+    d->ticks += ticks;
+    if (ticks > d->max)
+        d->max = ticks;
+}
+
+static inline void SCProfilingSampleDataMerge(SCProfileSampleData *dst,
+        const SCProfileSampleData *src)
+{
+    dst->cnt += src->cnt;
+    dst->ticks += src->ticks;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+/**
+ *  \brief merge the thread local samples into the global table
+ *
+ *  Data of a generation before the last reset is dropped.
+ */
+static void SCProfilingSampleMerge(SCProfileSampleThread *pt)
+{
+    int i;
+
+    SCMutexLock(&profiling_sample_lock);
+    if (pt->generation == profiling_sample_generation) {
+        SCProfilingSampleDataMerge(&profiling_sample_pkt, &pt->pkt);
+        for (i = 0; i < TMM_SIZE; i++) {
+            if (pt->tmm[i].cnt > 0)
+                SCProfilingSampleDataMerge(&profiling_sample_tmm[i], &pt->tmm[i]);
+        }
+    }
+    pt->generation = profiling_sample_generation;
+    SCMutexUnlock(&profiling_sample_lock);
+
+    memset(&pt->pkt, 0, sizeof(pt->pkt));
+    memset(&pt->tmm, 0, sizeof(pt->tmm));
+    pt->samples = 0;
+}
+
+static inline void SCProfilingSampleMergeCheck(SCProfileSampleThread *pt)
+{
+    if (++pt->samples >= PROFILING_SAMPLE_MERGE_CNT) {
+        SCProfilingSampleMerge(pt);
+        return;
+    }
+
+    time_t now = time(NULL);
+    if (now != pt->last_merge) {
+        pt->last_merge = now;
+        SCProfilingSampleMerge(pt);
+    }
+}
+
+/**
+ *  \brief decide if a packet is sampled, called by
+ *         PACKET_PROFILING_SAMPLE_START when the countdown expires
+ */
+void SCProfilingSampleStart(Packet *p)
+{
+    if (profiling_sample_mode == PROFILING_SAMPLE_MODE_TIME) {
+        SCProfileSampleThread *pt = &profiling_sample_thread;
+        struct timeval tv;
+        uint64_t now_ms;
+
+        profiling_sample_countdown = PROFILING_SAMPLE_TIME_CHECK - 1;
+
+        gettimeofday(&tv, NULL);
+        now_ms = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        if (now_ms - pt->last_sample_ms < profiling_sample_interval)
+            return;
+        pt->last_sample_ms = now_ms;
+    } else {
+        profiling_sample_countdown = profiling_sample_rate - 1;
+    }
+
+    p->profile_sample.tmm_ticks_start = 0;
+    p->profile_sample.ticks_start = UtilCpuGetTicks();
+}
+
+/**
+ *  \brief account the time a sampled packet spent in a module
+ */
+void SCProfilingSampleTmm(Packet *p, int tmm_id)
+{
+    SCProfileSampleThread *pt = &profiling_sample_thread;
+    uint64_t ticks_end = UtilCpuGetTicks();
+    uint64_t ticks_start = p->profile_sample.tmm_ticks_start;
+
+    p->profile_sample.tmm_ticks_start = 0;
+
+    if (tmm_id < 0 || tmm_id >= TMM_SIZE ||
+            ticks_start == 0 || ticks_start > ticks_end)
+        return;
+
+    SCProfilingSampleDataAdd(&pt->tmm[tmm_id], ticks_end - ticks_start);
+    SCProfilingSampleMergeCheck(pt);
+}
+
+/**
+ *  \brief account the total time of a sampled packet, called when the
+ *         packet is returned
+ */
+void SCProfilingSampleEnd(Packet *p)
+{
+    SCProfileSampleThread *pt = &profiling_sample_thread;
+    uint64_t ticks_end = UtilCpuGetTicks();
+    uint64_t ticks_start = p->profile_sample.ticks_start;
+
+    p->profile_sample.ticks_start = 0;
+    p->profile_sample.tmm_ticks_start = 0;
+
+    if (ticks_start > ticks_end)
+        return;
+
+    SCProfilingSampleDataAdd(&pt->pkt, ticks_end - ticks_start);
+    SCProfilingSampleMergeCheck(pt);
+}
+
+/**
+ *  \brief set the sampling mode and enable or disable it
+ *
+ *  \param enabled 1 to enable, 0 to disable
+ *  \param mode PROFILING_SAMPLE_MODE_COUNT or PROFILING_SAMPLE_MODE_TIME
+ *  \param rate count mode: sample 1 in 'rate' packets
+ *  \param interval time mode: msec between samples per thread
+ *
+ *  \retval 0 ok
+ *  \retval -1 invalid settings, nothing changed
+ */
+int SCProfilingSampleSet(int enabled, int mode, uint32_t rate, uint32_t interval)
+{
+    if ((mode != PROFILING_SAMPLE_MODE_COUNT && mode != PROFILING_SAMPLE_MODE_TIME) ||
+            rate == 0 || interval == 0)
+        return -1;
+
+    SCMutexLock(&profiling_sample_lock);
+    profiling_sample_mode = mode;
+    profiling_sample_rate = rate;
+    profiling_sample_interval = interval;
+    profiling_sample_enabled = enabled ? 1 : 0;
+    SCMutexUnlock(&profiling_sample_lock);
+
+    SCLogInfo("sampling profiler %s: mode %s, rate %"PRIu32", interval %"PRIu32"ms",
+            enabled ? "enabled" : "disabled", SCProfilingSampleModeToString(mode),
+            rate, interval);
+    return 0;
+}
+
+/**
+ *  \brief clear the global table
+ *
+ *  Threads notice the new generation on their next merge and drop what
+ *  they accumulated before the reset.
+ */
+void SCProfilingSampleReset(void)
+{
+    SCMutexLock(&profiling_sample_lock);
+    profiling_sample_generation++;
+    memset(&profiling_sample_pkt, 0, sizeof(profiling_sample_pkt));
+    memset(&profiling_sample_tmm, 0, sizeof(profiling_sample_tmm));
+    SCMutexUnlock(&profiling_sample_lock);
+}
+
+/**
+ *  \brief setup the sampling profiler from the 'profiling.sampling'
+ *         config section
+ */
+void SCProfilingSampleInit(void)
+{
+    ConfNode *conf = ConfGetNode("profiling.sampling");
+    int mode = PROFILING_SAMPLE_MODE_COUNT;
+    uint32_t rate = PROFILING_SAMPLE_DEFAULT_RATE;
+    uint32_t interval = PROFILING_SAMPLE_DEFAULT_INTERVAL;
+    const char *val;
+
+    if (conf == NULL)
+        return;
+
+    val = ConfNodeLookupChildValue(conf, "mode");
+    if (val != NULL) {
+        if (strcasecmp(val, "time") == 0) {
+            mode = PROFILING_SAMPLE_MODE_TIME;
+        } else if (strcasecmp(val, "count") != 0) {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "invalid profiling.sampling.mode "
+                    "\"%s\", using \"count\"", val);
+        }
+    }
+
+    val = ConfNodeLookupChildValue(conf, "rate");
+    if (val != NULL) {
+        if (ByteExtractStringUint32(&rate, 10, strlen(val), val) <= 0 || rate == 0) {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "invalid profiling.sampling.rate "
+                    "\"%s\", using %u", val, PROFILING_SAMPLE_DEFAULT_RATE);
+            rate = PROFILING_SAMPLE_DEFAULT_RATE;
+        }
+    }
+
+    val = ConfNodeLookupChildValue(conf, "interval");
+    if (val != NULL) {
+        if (ByteExtractStringUint32(&interval, 10, strlen(val), val) <= 0 || interval == 0) {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "invalid profiling.sampling.interval "
+                    "\"%s\", using %u", val, PROFILING_SAMPLE_DEFAULT_INTERVAL);
+            interval = PROFILING_SAMPLE_DEFAULT_INTERVAL;
+        }
+    }
+
+    profiling_sample_mode = mode;
+    profiling_sample_rate = rate;
+    profiling_sample_interval = interval;
+
+    if (ConfNodeChildValueIsTrue(conf, "enabled")) {
+        SCProfilingSampleSet(1, mode, rate, interval);
+    }
+}
+
+#ifdef BUILD_UNIX_SOCKET
+static json_t *SCProfilingSampleDataJson(const SCProfileSampleData *d)
+{
+    json_t *jd = json_object();
+    if (jd == NULL)
+        return NULL;
+
+    json_object_set_new(jd, "samples", json_integer(d->cnt));
+    json_object_set_new(jd, "ticks_total", json_integer(d->ticks));
+    json_object_set_new(jd, "ticks_avg", json_integer(d->cnt ? d->ticks / d->cnt : 0));
+    json_object_set_new(jd, "ticks_max", json_integer(d->max));
+    return jd;
+}
+
+TmEcode SCProfilingSampleEnableSocket(json_t *cmd, json_t *answer, void *data)
+{
+    SCProfilingSampleSet(1, profiling_sample_mode, profiling_sample_rate,
+            profiling_sample_interval);
+    json_object_set_new(answer, "message", json_string("sampling profiler enabled"));
+    return TM_ECODE_OK;
+}
+
+TmEcode SCProfilingSampleDisableSocket(json_t *cmd, json_t *answer, void *data)
+{
+    SCProfilingSampleSet(0, profiling_sample_mode, profiling_sample_rate,
+            profiling_sample_interval);
+    json_object_set_new(answer, "message", json_string("sampling profiler disabled"));
+    return TM_ECODE_OK;
+}
+
+TmEcode SCProfilingSampleResetSocket(json_t *cmd, json_t *answer, void *data)
+{
+    SCProfilingSampleReset();
+    json_object_set_new(answer, "message", json_string("sampling profiler reset"));
+    return TM_ECODE_OK;
+}
+
+/**
+ *  \brief change the sampling settings, takes the optional arguments
+ *         "mode" ("count" or "time"), "rate" and "interval"
+ */
+TmEcode SCProfilingSampleSetSocket(json_t *cmd, json_t *answer, void *data)
+{
+    int mode = profiling_sample_mode;
+    json_int_t rate = profiling_sample_rate;
+    json_int_t interval = profiling_sample_interval;
+    json_t *jarg;
+
+    jarg = json_object_get(cmd, "mode");
+    if (jarg != NULL) {
+        const char *m = json_is_string(jarg) ? json_string_value(jarg) : "";
+        if (strcmp(m, "count") == 0) {
+            mode = PROFILING_SAMPLE_MODE_COUNT;
+        } else if (strcmp(m, "time") == 0) {
+            mode = PROFILING_SAMPLE_MODE_TIME;
+        } else {
+            json_object_set_new(answer, "message",
+                    json_string("mode must be \"count\" or \"time\""));
+            return TM_ECODE_FAILED;
+        }
+    }
+    jarg = json_object_get(cmd, "rate");
+    if (jarg != NULL) {
+        if (!json_is_integer(jarg)) {
+            json_object_set_new(answer, "message", json_string("rate is not an integer"));
+            return TM_ECODE_FAILED;
+        }
+        rate = json_integer_value(jarg);
+    }
+    jarg = json_object_get(cmd, "interval");
+    if (jarg != NULL) {
+        if (!json_is_integer(jarg)) {
+            json_object_set_new(answer, "message", json_string("interval is not an integer"));
+            return TM_ECODE_FAILED;
+        }
+        interval = json_integer_value(jarg);
+    }
+
+    if (rate <= 0 || rate > UINT32_MAX || interval <= 0 || interval > UINT32_MAX ||
+            SCProfilingSampleSet(profiling_sample_enabled, mode,
+                (uint32_t)rate, (uint32_t)interval) != 0) {
+        json_object_set_new(answer, "message", json_string("invalid settings"));
+        return TM_ECODE_FAILED;
+    }
+
+    json_object_set_new(answer, "message", json_string("sampling profiler updated"));
+    return TM_ECODE_OK;
+}
+
+/**
+ *  \brief dump the merged samples: packet totals and per module
+ */
+TmEcode SCProfilingSampleDumpSocket(json_t *cmd, json_t *answer, void *data)
+{
+    json_t *jdata = json_object();
+    json_t *jtmm = json_object();
+    int i;
+
+    if (jdata == NULL || jtmm == NULL) {
+        if (jdata != NULL)
+            json_decref(jdata);
+        if (jtmm != NULL)
+            json_decref(jtmm);
+        json_object_set_new(answer, "message",
+                json_string("internal error at json object creation"));
+        return TM_ECODE_FAILED;
+    }
+
+    SCMutexLock(&profiling_sample_lock);
+    json_object_set_new(jdata, "enabled", profiling_sample_enabled ? json_true() : json_false());
+    json_object_set_new(jdata, "mode",
+            json_string(SCProfilingSampleModeToString(profiling_sample_mode)));
+    json_object_set_new(jdata, "rate", json_integer(profiling_sample_rate));
+    json_object_set_new(jdata, "interval", json_integer(profiling_sample_interval));
+    json_object_set_new(jdata, "packets", SCProfilingSampleDataJson(&profiling_sample_pkt));
+    for (i = 0; i < TMM_SIZE; i++) {
+        if (profiling_sample_tmm[i].cnt == 0 || tmm_modules[i].name == NULL)
+            continue;
+        json_object_set_new(jtmm, tmm_modules[i].name,
+                SCProfilingSampleDataJson(&profiling_sample_tmm[i]));
+    }
+    SCMutexUnlock(&profiling_sample_lock);
+
+    json_object_set_new(jdata, "modules", jtmm);
+    json_object_set_new(answer, "message", jdata);
+    return TM_ECODE_OK;
+}
+#endif /* BUILD_UNIX_SOCKET */
+
+#ifdef UNITTESTS
+
+/** \test count mode samples exactly 1 in 'rate' packets */
+static int SCProfilingSampleTest01(void)
+{
+    Packet *p = SCMalloc(SIZE_OF_PACKET);
+    int i, sampled = 0;
+    int result = 0;
+
+    if (unlikely(p == NULL))
+        return 0;
+    memset(p, 0, SIZE_OF_PACKET);
+
+    if (SCProfilingSampleSet(1, PROFILING_SAMPLE_MODE_COUNT, 10, 1) != 0)
+        goto end;
+    profiling_sample_countdown = 0;
+
+    for (i = 0; i < 100; i++) {
+        PACKET_PROFILING_SAMPLE_START(p);
+        if (p->profile_sample.ticks_start != 0) {
+            sampled++;
+            PACKET_PROFILING_SAMPLE_END(p);
+        }
+        if (p->profile_sample.ticks_start != 0)
+            goto end;
+    }
+
+    if (sampled != 10) {
+        printf("sampled %d, expected 10: ", sampled);
+        goto end;
+    }
+
+    if (SCProfilingSampleSet(1, 5, 10, 1) != -1 ||
+            SCProfilingSampleSet(1, PROFILING_SAMPLE_MODE_COUNT, 0, 1) != -1)
+        goto end;
+
+    result = 1;
+end:
+    SCProfilingSampleSet(0, PROFILING_SAMPLE_MODE_COUNT, PROFILING_SAMPLE_DEFAULT_RATE,
+            PROFILING_SAMPLE_DEFAULT_INTERVAL);
+    SCProfilingSampleReset();
+    SCFree(p);
+    return result;
+}
+
+/** \test thread local samples get merged, a reset drops them */
+static int SCProfilingSampleTest02(void)
+{
+    Packet *p = SCMalloc(SIZE_OF_PACKET);
+    int i;
+    int result = 0;
+
+    if (unlikely(p == NULL))
+        return 0;
+    memset(p, 0, SIZE_OF_PACKET);
+
+    SCProfilingSampleReset();
+    /* sync the thread's generation */
+    SCProfilingSampleMerge(&profiling_sample_thread);
+
+    if (SCProfilingSampleSet(1, PROFILING_SAMPLE_MODE_COUNT, 1, 1) != 0)
+        goto end;
+    profiling_sample_countdown = 0;
+
+    for (i = 0; i < PROFILING_SAMPLE_MERGE_CNT; i++) {
+        PACKET_PROFILING_SAMPLE_START(p);
+        PACKET_PROFILING_SAMPLE_TMM_START(p);
+        PACKET_PROFILING_SAMPLE_TMM_END(p, TMM_DECODEPCAPFILE);
+        PACKET_PROFILING_SAMPLE_END(p);
+    }
+    SCProfilingSampleMerge(&profiling_sample_thread);
+
+    if (profiling_sample_pkt.cnt != PROFILING_SAMPLE_MERGE_CNT ||
+            profiling_sample_tmm[TMM_DECODEPCAPFILE].cnt != PROFILING_SAMPLE_MERGE_CNT) {
+        printf("pkt %"PRIu64" tmm %"PRIu64": ", profiling_sample_pkt.cnt,
+                profiling_sample_tmm[TMM_DECODEPCAPFILE].cnt);
+        goto end;
+    }
+    if (profiling_sample_pkt.max == 0 ||
+            profiling_sample_pkt.max > profiling_sample_pkt.ticks)
+        goto end;
+
+    /* samples taken before a reset are dropped on merge */
+    PACKET_PROFILING_SAMPLE_START(p);
+    PACKET_PROFILING_SAMPLE_END(p);
+    SCProfilingSampleReset();
+    SCProfilingSampleMerge(&profiling_sample_thread);
+
+    if (profiling_sample_pkt.cnt != 0 ||
+            profiling_sample_tmm[TMM_DECODEPCAPFILE].cnt != 0)
+        goto end;
+
+    result = 1;
+end:
+    SCProfilingSampleSet(0, PROFILING_SAMPLE_MODE_COUNT, PROFILING_SAMPLE_DEFAULT_RATE,
+            PROFILING_SAMPLE_DEFAULT_INTERVAL);
+    SCProfilingSampleReset();
+    SCFree(p);
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void SCProfilingSampleRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCProfilingSampleTest01", SCProfilingSampleTest01, 1);
+    UtRegisterTest("SCProfilingSampleTest02", SCProfilingSampleTest02, 1);
+#endif /* UNITTESTS */
+}
@@ -25,10 +25,60 @@
 #ifndef __UTIL_PROFILE_H__
 #define __UTIL_PROFILE_H__
 
+#include "util-cpu.h"
+
+/* sampling profiler, part of all builds and enabled at runtime */
+
+#define PROFILING_SAMPLE_MODE_COUNT         0   /**< 1 in 'rate' packets */
+#define PROFILING_SAMPLE_MODE_TIME          1   /**< 1 per thread per 'interval' msec */
+
+#define PROFILING_SAMPLE_DEFAULT_RATE       1000
+#define PROFILING_SAMPLE_DEFAULT_INTERVAL   1
+
+extern int profiling_sample_enabled;
+extern __thread uint32_t profiling_sample_countdown;
+
+void SCProfilingSampleInit(void);
+int SCProfilingSampleSet(int, int, uint32_t, uint32_t);
+void SCProfilingSampleReset(void);
+void SCProfilingSampleStart(Packet *);
+void SCProfilingSampleTmm(Packet *, int);
+void SCProfilingSampleEnd(Packet *);
+void SCProfilingSampleRegisterTests(void);
+
+#ifdef BUILD_UNIX_SOCKET
+#include <jansson.h>
+TmEcode SCProfilingSampleEnableSocket(json_t *, json_t *, void *);
+TmEcode SCProfilingSampleDisableSocket(json_t *, json_t *, void *);
+TmEcode SCProfilingSampleSetSocket(json_t *, json_t *, void *);
+TmEcode SCProfilingSampleResetSocket(json_t *, json_t *, void *);
+TmEcode SCProfilingSampleDumpSocket(json_t *, json_t *, void *);
+#endif
+
+/** the countdown keeps the unsampled path at a compare and a decrement */
+#define PACKET_PROFILING_SAMPLE_START(p)                            \
+    if (profiling_sample_enabled && profiling_sample_countdown-- == 0) { \
+        SCProfilingSampleStart((p));                                \
+    }
+
+#define PACKET_PROFILING_SAMPLE_END(p)                              \
+    if ((p)->profile_sample.ticks_start != 0) {                     \
+        SCProfilingSampleEnd((p));                                  \
+    }
+
+#define PACKET_PROFILING_SAMPLE_TMM_START(p)                        \
+    if ((p) != NULL && (p)->profile_sample.ticks_start != 0) {      \
+        (p)->profile_sample.tmm_ticks_start = UtilCpuGetTicks();    \
+    }
+
+#define PACKET_PROFILING_SAMPLE_TMM_END(p, id)                      \
+    if ((p) != NULL && (p)->profile_sample.ticks_start != 0) {      \
+        SCProfilingSampleTmm((p), (id));                            \
+    }
+
 #ifdef PROFILING
 
 #include "util-profiling-locks.h"
-#include "util-cpu.h"
 
 extern int profiling_rules_enabled;
 extern int profiling_packets_enabled;
@@ -37,6 +87,15 @@ extern __thread int profiling_rules_entered;
 void SCProfilingPrintPacketProfile(Packet *);
 void SCProfilingAddPacket(Packet *);
 
+void SCProfilingRegisterThreadHistograms(ThreadVars *);
+void SCProfilingHistogramRecordTmm(int, uint64_t);
+void SCProfilingHistogramRecordApp(uint64_t);
+
+#define PACKET_PROFILING_REGISTER_HISTOGRAMS(tv)                    \
+    if (profiling_packets_enabled) {                                \
+        SCProfilingRegisterThreadHistograms((tv));                  \
+    }
+
 #define RULE_PROFILING_START \
     uint64_t profile_rule_start_ = 0; \
     uint64_t profile_rule_end_ = 0; \
@@ -120,6 +179,11 @@ void SCProfilingAddPacket(Packet *);
         if ((id) < TMM_SIZE) {                                      \
             PACKET_PROFILING_COPY_LOCKS((p), (id));                 \
             (p)->profile.tmm[(id)].ticks_end = UtilCpuGetTicks();   \
+            if ((p)->profile.tmm[(id)].ticks_start != 0 &&          \
+                    (p)->profile.tmm[(id)].ticks_start < (p)->profile.tmm[(id)].ticks_end) { \
+                SCProfilingHistogramRecordTmm((id),                 \
+                    (p)->profile.tmm[(id)].ticks_end - (p)->profile.tmm[(id)].ticks_start); \
+            }                                                       \
         }                                                           \
     }
 
@@ -140,6 +204,7 @@ void SCProfilingAddPacket(Packet *);
         (dp)->ticks_end = UtilCpuGetTicks();                        \
         if ((dp)->ticks_start != 0 && (dp)->ticks_start < ((dp)->ticks_end)) {  \
             (dp)->ticks_spent = ((dp)->ticks_end - (dp)->ticks_start);  \
+            SCProfilingHistogramRecordApp((dp)->ticks_spent);       \
         }                                                           \
     }
 
@@ -220,6 +285,8 @@ void SCProfilingDump(void);
 #define PACKET_PROFILING_TMM_START(p, id)
 #define PACKET_PROFILING_TMM_END(p, id)
 
+#define PACKET_PROFILING_REGISTER_HISTOGRAMS(tv)
+
 #define PACKET_PROFILING_RESET(p)
 
 #define PACKET_PROFILING_APP_START(dp, id)
@@ -38,6 +38,7 @@
 #include "detect-engine.h"
 #include "detect-engine-address.h"
 #include "detect-threshold.h"
+#include "detect-engine-threshold.h"
 #include "detect-parse.h"
 
 #include "conf.h"
@@ -1810,7 +1811,7 @@ int SCThresholdConfTest09(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     Packet *p = UTHBuildPacket((uint8_t*)"lalala", 6, IPPROTO_TCP);
     ThreadVars th_v;
@@ -1917,7 +1918,7 @@ end:
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -1933,7 +1934,7 @@ int SCThresholdConfTest10(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     Packet *p = UTHBuildPacket((uint8_t*)"lalala", 6, IPPROTO_TCP);
     Packet *p2 = UTHBuildPacketSrcDst((uint8_t*)"lalala", 6, IPPROTO_TCP, "172.26.0.1", "172.26.0.10");
@@ -2017,7 +2018,7 @@ end:
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2033,7 +2034,7 @@ int SCThresholdConfTest11(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     Packet *p = UTHBuildPacket((uint8_t*)"lalala", 6, IPPROTO_TCP);
     ThreadVars th_v;
@@ -2136,7 +2137,7 @@ end:
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2152,7 +2153,7 @@ int SCThresholdConfTest12(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     Packet *p = UTHBuildPacket((uint8_t*)"lalala", 6, IPPROTO_TCP);
     ThreadVars th_v;
@@ -2256,7 +2257,7 @@ end:
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2275,7 +2276,7 @@ int SCThresholdConfTest13(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     if (de_ctx == NULL)
         return result;
@@ -2304,7 +2305,7 @@ end:
     SigGroupCleanup(de_ctx);
     SigCleanSignatures(de_ctx);
     DetectEngineCtxFree(de_ctx);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2320,7 +2321,7 @@ int SCThresholdConfTest14(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     Packet *p = UTHBuildPacketReal((uint8_t*)"lalala", 6, IPPROTO_TCP, "192.168.0.10",
                                     "192.168.0.100", 1234, 24);
@@ -2369,7 +2370,7 @@ end:
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2385,7 +2386,7 @@ static int SCThresholdConfTest15(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     Packet *p = UTHBuildPacketReal((uint8_t*)"lalala", 6, IPPROTO_TCP, "192.168.0.10",
                                     "192.168.0.100", 1234, 24);
@@ -2438,7 +2439,7 @@ end:
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2454,7 +2455,7 @@ static int SCThresholdConfTest16(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     Packet *p = UTHBuildPacketReal((uint8_t*)"lalala", 6, IPPROTO_TCP, "192.168.1.1",
                                     "192.168.0.100", 1234, 24);
@@ -2507,7 +2508,7 @@ end:
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2523,7 +2524,7 @@ static int SCThresholdConfTest17(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     Packet *p = UTHBuildPacketReal((uint8_t*)"lalala", 6, IPPROTO_TCP, "192.168.0.10",
                                     "192.168.0.100", 1234, 24);
@@ -2576,7 +2577,7 @@ end:
     DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
     DetectEngineCtxFree(de_ctx);
 
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2613,7 +2614,7 @@ static int SCThresholdConfTest18(void)
     SigMatch *sm = NULL;
     DetectThresholdData *de = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
     DetectEngineCtx *de_ctx = DetectEngineCtxInit();
     if (de_ctx == NULL)
         return result;
@@ -2651,7 +2652,7 @@ static int SCThresholdConfTest18(void)
     result = 1;
 end:
     DetectEngineCtxFree(de_ctx);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2688,7 +2689,7 @@ static int SCThresholdConfTest19(void)
     SigMatch *sm = NULL;
     DetectThresholdData *de = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
     DetectEngineCtx *de_ctx = DetectEngineCtxInit();
     if (de_ctx == NULL)
         return result;
@@ -2726,7 +2727,7 @@ static int SCThresholdConfTest19(void)
     result = 1;
 end:
     DetectEngineCtxFree(de_ctx);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2765,7 +2766,7 @@ static int SCThresholdConfTest20(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     if (de_ctx == NULL)
         return result;
@@ -2805,7 +2806,7 @@ end:
     SigGroupCleanup(de_ctx);
     SigCleanSignatures(de_ctx);
     DetectEngineCtxFree(de_ctx);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -2825,7 +2826,7 @@ static int SCThresholdConfTest21(void)
     int result = 0;
     FILE *fd = NULL;
 
-    HostInitConfig(HOST_QUIET);
+    ThresholdInit();
 
     if (de_ctx == NULL)
         return result;
@@ -2865,7 +2866,7 @@ end:
     SigGroupCleanup(de_ctx);
     SigCleanSignatures(de_ctx);
     DetectEngineCtxFree(de_ctx);
-    HostShutdown();
+    ThresholdShutdown();
     return result;
 }
 
@@ -110,6 +110,7 @@ int VariableNameInitHash(DetectEngineCtx *de_ctx) {
         return -1;
 
     de_ctx->variable_names_idx = 0;
+    de_ctx->variable_flowbits_idx = 0;
     return 0;
 }
 
@@ -124,6 +125,49 @@ void VariableNameFreeHash(DetectEngineCtx *de_ctx) {
     return;
 }
 
+/** \brief Copy the name idx mappings of another detection engine, so that
+ *         names used in both engines map to the same idx. Used on rule
+ *         reload to keep the flowbits and flowvars of existing flows valid.
+ *
+ *  \param de_ctx engine to copy to, with an empty name hash
+ *  \param src engine to copy from
+ *
+ *  \retval -1 in case of error
+ *  \retval 0 in case of success
+ */
+int VariableNameCopyHash(DetectEngineCtx *de_ctx, DetectEngineCtx *src) {
+    HashListTableBucket *b;
+
+    if (src->variable_names == NULL || de_ctx->variable_names == NULL)
+        return -1;
+
+    for (b = HashListTableGetListHead(src->variable_names); b != NULL;
+            b = HashListTableGetListNext(b)) {
+        VariableName *sfn = (VariableName *)HashListTableGetListData(b);
+
+        VariableName *fn = SCMalloc(sizeof(VariableName));
+        if (unlikely(fn == NULL))
+            return -1;
+        memset(fn, 0, sizeof(VariableName));
+
+        fn->type = sfn->type;
+        fn->idx = sfn->idx;
+        fn->flags = sfn->flags;
+        fn->name = SCStrdup(sfn->name);
+        if (fn->name == NULL) {
+            VariableNameFree(fn);
+            return -1;
+        }
+
+        HashListTableAdd(de_ctx->variable_names, (void *)fn, 0);
+        HashListTableAdd(de_ctx->variable_idxs, (void *)fn, 0);
+    }
+
+    de_ctx->variable_names_idx = src->variable_names_idx;
+    de_ctx->variable_flowbits_idx = src->variable_flowbits_idx;
+    return 0;
+}
+
 /** \brief Get a name idx for a name. If the name is already used reuse the idx.
  *  \param name nul terminated string with the name
  *  \param type variable type (DETECT_FLOWBITS, DETECT_PKTVAR, etc)
@@ -146,9 +190,13 @@ uint16_t VariableNameGetIdx(DetectEngineCtx *de_ctx, char *name, uint8_t type) {
 
     VariableName *lookup_fn = (VariableName *)HashListTableLookup(de_ctx->variable_names, (void *)fn, 0);
     if (lookup_fn == NULL) {
-        de_ctx->variable_names_idx++;
-
-        idx = fn->idx = de_ctx->variable_names_idx;
+        if (type == DETECT_FLOWBITS) {
+            de_ctx->variable_flowbits_idx++;
+            idx = fn->idx = de_ctx->variable_flowbits_idx;
+        } else {
+            de_ctx->variable_names_idx++;
+            idx = fn->idx = de_ctx->variable_names_idx;
+        }
         HashListTableAdd(de_ctx->variable_names, (void *)fn, 0);
         HashListTableAdd(de_ctx->variable_idxs, (void *)fn, 0);
     } else {
@@ -26,6 +26,7 @@
 
 int VariableNameInitHash(DetectEngineCtx *);
 void VariableNameFreeHash(DetectEngineCtx *);
+int VariableNameCopyHash(DetectEngineCtx *, DetectEngineCtx *);
 
 uint16_t VariableNameGetIdx(DetectEngineCtx *, char *, uint8_t);
 char * VariableIdxGetName(DetectEngineCtx *, uint16_t , uint8_t);